@@ -0,0 +1,136 @@
+#include "beacon_power.h"
+
+namespace beacon_power {
+
+ReportWindow::ReportWindow(uint32_t periodMs, uint32_t urgentMs,
+                           uint32_t slowPeriodMs, float fastSignal)
+    : periodMs_(periodMs), urgentMs_(urgentMs),
+      slowPeriodMs_(slowPeriodMs != 0 ? slowPeriodMs : periodMs),
+      fastSignal_(fastSignal) {}
+
+bool ReportWindow::add(float beaconSignal, bool saturated, uint32_t now) {
+  if (!started_) {
+    started_ = true;
+    startedAtMs_ = now;
+  }
+  if (beaconSignal > peakSignal_) {
+    peakSignal_ = beaconSignal;
+  }
+  if (ticks_ < UINT16_MAX) {
+    saturated_ += saturated ? 1 : 0;
+    ticks_++;
+  }
+  const uint32_t elapsed = now - startedAtMs_;
+  const uint32_t period =
+      peakSignal_ >= fastSignal_ ? periodMs_ : slowPeriodMs_;
+  return elapsed >= period || (saturated_ > 0 && elapsed >= urgentMs_);
+}
+
+bool ReportWindow::empty() const { return ticks_ == 0; }
+
+void ReportWindow::reset() {
+  started_ = false;
+  peakSignal_ = 0.0f;
+  saturated_ = 0;
+  ticks_ = 0;
+}
+
+BeaconReport ReportWindow::take(uint32_t node, uint16_t duty) {
+  BeaconReport report;
+  report.node = node;
+  report.duty = duty;
+  report.signal = static_cast<uint32_t>(peakSignal_ + 0.5f);
+  report.saturated = saturated_;
+  report.ticks = ticks_;
+  reset();
+  return report;
+}
+
+BeaconPowerController::BeaconPowerController(const BeaconPowerConfig &config)
+    : config_(config), duty_(config.referenceDuty) {}
+
+bool BeaconPowerController::onReport(const BeaconReport &report,
+                                     uint32_t now) {
+  if (following_ && report.node != node_) {
+    return false;
+  }
+  following_ = true;
+  node_ = report.node;
+  lastReportAtMs_ = now;
+  if (report.ticks == 0) {
+    return false;
+  }
+
+  if (report.saturated > 0) {
+    headroom_ *= config_.saturationBackoff;
+    if (headroom_ < config_.minHeadroom) {
+      headroom_ = config_.minHeadroom;
+    }
+  } else {
+    headroom_ *= config_.saturationRecovery;
+    if (headroom_ > 1.0f) {
+      headroom_ = 1.0f;
+    }
+  }
+
+  // The reported signal is normalized, so it stands for the distance; the
+  // duty that puts targetSignal at the slave follows directly from it.
+  // Headroom scales the target down where that still saturates, e.g. with
+  // the beacon right on one channel's axis.
+  const float signal = report.signal > 0 ? static_cast<float>(report.signal)
+                                         : 1.0f;
+  float target = static_cast<float>(config_.referenceDuty) *
+                 config_.targetSignal * headroom_ / signal;
+  // Saturation is measured at the duty the slave last saw, which may lag
+  // the one applied; either way the duty has to come down from there.
+  if (report.saturated > 0) {
+    const float seen = static_cast<float>(report.duty != 0 ? report.duty
+                                                           : duty_);
+    const float below = seen * config_.maxStepDown;
+    if (target > below) {
+      target = below;
+    }
+  }
+  return apply(target);
+}
+
+bool BeaconPowerController::service(uint32_t now) {
+  if (!following_ || now - lastReportAtMs_ < config_.reportTimeoutMs) {
+    return false;
+  }
+  following_ = false;
+  headroom_ = 1.0f;
+  const bool changed = duty_ != config_.referenceDuty;
+  duty_ = config_.referenceDuty;
+  return changed;
+}
+
+bool BeaconPowerController::apply(float target) {
+  const float current = static_cast<float>(duty_);
+  const float highest = current * config_.maxStepUp;
+  const float lowest = current * config_.maxStepDown;
+  target = target > highest ? highest : target;
+  target = target < lowest ? lowest : target;
+  target = target > config_.maxDuty ? config_.maxDuty : target;
+  target = target < config_.minDuty ? config_.minDuty : target;
+
+  const float change = target > current ? target - current : current - target;
+  if (change < config_.deadband * current) {
+    return false;
+  }
+  const uint16_t next = static_cast<uint16_t>(target + 0.5f);
+  if (next == duty_) {
+    return false;
+  }
+  duty_ = next;
+  return true;
+}
+
+uint16_t BeaconPowerController::duty() const { return duty_; }
+
+bool BeaconPowerController::following() const { return following_; }
+
+uint32_t BeaconPowerController::followedNode() const { return node_; }
+
+float BeaconPowerController::headroom() const { return headroom_; }
+} // namespace beacon_power
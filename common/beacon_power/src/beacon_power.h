@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Closed-loop beacon power. While a slave walks to the charger it reports
+// what it sees of the beacon a few times per second; the master turns the
+// beacon duty down as the slave closes in, so its sensors stay below the
+// ADC ceiling near the dock, and up while it is far away. The master
+// advertises every duty it applies, and the slave's tracker scales the
+// beacon part of its amplitudes back to the reference duty, so thresholds
+// and the arrival signal keep their meaning.
+//
+// Both messages are mesh broadcasts, BEACON_REPORT (slave -> master) and
+// BEACON_DUTY (master -> all) frames of common/mesh_proto.
+namespace beacon_power {
+constexpr uint16_t DUTY_MAX = 1023;
+
+// What a slave saw of the beacon over one report window.
+struct BeaconReport {
+  uint32_t node = 0;
+  // Duty the slave normalized with.
+  uint16_t duty = 0;
+  // Largest beaconSignal of the window, normalized to the reference duty,
+  // so it depends on the distance and not on the duty.
+  uint32_t signal = 0;
+  // Ticks with a saturated raw channel, out of `ticks`.
+  uint16_t saturated = 0;
+  uint16_t ticks = 0;
+};
+
+// Collects one report window on the slave, one tracker tick at a time. A
+// report is due every periodMs, or after urgentMs once a tick saturated, so
+// the master hears about saturation without waiting for the full window.
+// Far from the beacon, while the peak stays below fastSignal, windows last
+// slowPeriodMs instead (0: always periodMs); the signal changes slowly there.
+class ReportWindow {
+public:
+  explicit ReportWindow(uint32_t periodMs = 200, uint32_t urgentMs = 40,
+                        uint32_t slowPeriodMs = 0, float fastSignal = 0.0f);
+
+  // Returns true when a report is due; take() it.
+  bool add(float beaconSignal, bool saturated, uint32_t now);
+  bool empty() const;
+  void reset();
+  // Returns the window as a report and starts the next one.
+  BeaconReport take(uint32_t node, uint16_t duty);
+
+private:
+  uint32_t periodMs_;
+  uint32_t urgentMs_;
+  uint32_t slowPeriodMs_;
+  float fastSignal_;
+  bool started_ = false;
+  uint32_t startedAtMs_ = 0;
+  float peakSignal_ = 0.0f;
+  uint16_t saturated_ = 0;
+  uint16_t ticks_ = 0;
+};
+
+struct BeaconPowerConfig {
+  // Duty the slave thresholds are tuned at, used while no slave reports.
+  uint16_t referenceDuty = 256;
+  uint16_t minDuty = 32;
+  uint16_t maxDuty = DUTY_MAX;
+  // beaconSignal the controller aims for at the applied duty: the strongest
+  // channel then peaks well below saturation over the front channel's room
+  // light.
+  float targetSignal = 1800.0f;
+  // Largest change per report. Until the new duty reaches the slave, a cut
+  // reads as a drop in its signal; at 0.7 that stays under the slave's
+  // signalDropGuardRatio (0.22) of a totalSignal that includes room light.
+  float maxStepUp = 1.25f;
+  float maxStepDown = 0.7f;
+  // Changes smaller than this fraction of the duty are not applied.
+  float deadband = 0.06f;
+  // Every report with saturated ticks multiplies the signal target by
+  // saturationBackoff, down to minHeadroom; clean reports recover it by
+  // saturationRecovery.
+  float saturationBackoff = 0.8f;
+  float saturationRecovery = 1.05f;
+  float minHeadroom = 0.25f;
+  // Back to referenceDuty after this long without a report from the slave
+  // being followed.
+  uint32_t reportTimeoutMs = 1500;
+};
+
+// Runs on the master. Follows one slave at a time, the first to report,
+// until it falls silent.
+class BeaconPowerController {
+public:
+  explicit BeaconPowerController(
+      const BeaconPowerConfig &config = BeaconPowerConfig());
+
+  // Both return true when the duty changed and has to be applied and
+  // advertised.
+  bool onReport(const BeaconReport &report, uint32_t now);
+  bool service(uint32_t now);
+
+  uint16_t duty() const;
+  bool following() const;
+  uint32_t followedNode() const;
+  float headroom() const;
+
+private:
+  bool apply(float target);
+
+  BeaconPowerConfig config_;
+  uint16_t duty_;
+  bool following_ = false;
+  uint32_t node_ = 0;
+  uint32_t lastReportAtMs_ = 0;
+  float headroom_ = 1.0f;
+};
+} // namespace beacon_power
@@ -0,0 +1,389 @@
+#include "beacon_tracker.h"
+
+#include <cmath>
+
+namespace {
+// Background samples needed before their statistics replace the priors.
+constexpr size_t MIN_BACKGROUND_SAMPLES = 32;
+constexpr float RECENT_PROFILE_ALPHA = 1.0f / 16.0f;
+constexpr float BACKGROUND_PROFILE_ALPHA = 1.0f / 64.0f;
+// Channel gains are applied in fixed point with this many fraction bits.
+constexpr uint8_t GAIN_FRACTION_BITS = 12;
+constexpr float GAIN_ONE = static_cast<float>(1U << GAIN_FRACTION_BITS);
+constexpr float MAX_GAIN = 65535.0f / GAIN_ONE;
+// Lowest duty the amplitudes are normalized for, as a fraction of the
+// reference duty; keeps the scale factor within 16x.
+constexpr uint32_t MIN_DUTY_DIVISOR = 16;
+constexpr float kPi = 3.14159265358979323846f;
+constexpr float kTwoPi = 2.0f * kPi;
+
+float wrapAngle(float angle) {
+  while (angle > kPi) {
+    angle -= kTwoPi;
+  }
+  while (angle < -kPi) {
+    angle += kTwoPi;
+  }
+  return angle;
+}
+
+BeaconTracker::ChannelScale toScale(const SensorCalibration &calibration) {
+  const float gain = calibration.gain < 0.0f ? 0.0f
+                     : calibration.gain > MAX_GAIN ? MAX_GAIN
+                                                   : calibration.gain;
+  BeaconTracker::ChannelScale scale;
+  scale.offset = static_cast<int32_t>(std::lround(calibration.offset));
+  scale.gainQ12 = static_cast<uint32_t>(std::lround(gain * GAIN_ONE));
+  scale.ambient = calibration.ambient > 0.0f
+                      ? static_cast<uint32_t>(std::lround(calibration.ambient))
+                      : 0U;
+  return scale;
+}
+
+// Calibrated amplitude with the part above the channel's ambient level
+// scaled for the beacon duty.
+float calibrate(uint32_t raw, const BeaconTracker::ChannelScale &scale,
+                uint32_t dutyScaleQ12) {
+  const int32_t counts = static_cast<int32_t>(raw) - scale.offset;
+  if (counts <= 0) {
+    return 0.0f;
+  }
+  const uint32_t half = 1U << (GAIN_FRACTION_BITS - 1);
+  const uint32_t scaled =
+      (static_cast<uint32_t>(counts) * scale.gainQ12 + half) >>
+      GAIN_FRACTION_BITS;
+  if (scaled <= scale.ambient) {
+    return static_cast<float>(scaled);
+  }
+  const uint64_t beacon =
+      (static_cast<uint64_t>(scaled - scale.ambient) * dutyScaleQ12 + half) >>
+      GAIN_FRACTION_BITS;
+  return static_cast<float>(scale.ambient + beacon);
+}
+
+float aboveAmbient(float amplitude, const BeaconTracker::ChannelScale &scale) {
+  const float ambient = static_cast<float>(scale.ambient);
+  return amplitude > ambient ? amplitude - ambient : 0.0f;
+}
+
+// 1 at `ok`, 0 at `bad`, linear in between; either may be the larger.
+float score(float value, float ok, float bad) {
+  if (ok == bad) {
+    return value == ok ? 1.0f : 0.0f;
+  }
+  const float share = (bad - value) / (bad - ok);
+  return share < 0.0f ? 0.0f : share > 1.0f ? 1.0f : share;
+}
+} // namespace
+
+BeaconTracker::BeaconTracker(const BeaconTrackerConfig &config)
+    : config_(config), state_(),
+      hampel7_(window_filters::HAMPEL_DEFAULT_THRESHOLD_Q8,
+               config.hampelMinDeviation) {
+  scale_[0] = toScale(config.front);
+  scale_[1] = toScale(config.back);
+  scale_[2] = toScale(config.left);
+  scale_[3] = toScale(config.right);
+  setBeaconDuty(config.referenceDuty);
+}
+
+float BeaconTracker::clampf(float value, float low, float high) {
+  if (value < low) {
+    return low;
+  }
+  if (value > high) {
+    return high;
+  }
+  return value;
+}
+
+bool BeaconTracker::isBefore(uint32_t now, uint32_t deadline) {
+  return static_cast<int32_t>(now - deadline) < 0;
+}
+
+void BeaconTracker::prefilter(const uint32_t (&raw)[4],
+                              uint32_t (&filtered)[4]) {
+  switch (config_.rawPrefilter) {
+  case RawPrefilter::MEDIAN3:
+    median3_.push(raw, filtered);
+    break;
+  case RawPrefilter::MEDIAN5:
+    median5_.push(raw, filtered);
+    break;
+  case RawPrefilter::HAMPEL7:
+    hampel7_.push(raw, filtered);
+    break;
+  }
+}
+
+void BeaconTracker::updateDetection(uint32_t now) {
+  if (config_.detectionMode == DetectionMode::FIXED) {
+    state_.noiseFloor = 0.0f;
+    state_.signalThreshold = config_.signalMin;
+    state_.detected = state_.totalSignal >= config_.signalMin;
+    return;
+  }
+
+  const int32_t sample = static_cast<int32_t>(std::lround(state_.totalSignal));
+  const int32_t step = recentRange_.empty() ? 0 : sample - previousSample_;
+  previousSample_ = sample;
+  recentRange_.push(sample);
+  recentSignal_.push(sample);
+  recentSteps_.push(step);
+  const float channels[4] = {state_.front, state_.back, state_.left,
+                             state_.right};
+  float profile[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  if (state_.totalSignal > 0.0f) {
+    for (size_t i = 0; i < 4; ++i) {
+      profile[i] = channels[i] / state_.totalSignal;
+      recentProfile_[i] += RECENT_PROFILE_ALPHA * (profile[i] - recentProfile_[i]);
+    }
+  }
+
+  float floor = config_.floorPrior;
+  float sigma = config_.noiseSigmaPrior;
+  if (backgroundSignal_.size() >= MIN_BACKGROUND_SAMPLES) {
+    floor = backgroundSignal_.mean();
+    // Steps between independent samples have twice the sample variance.
+    sigma = std::sqrt(0.5f * backgroundSteps_.variance());
+  }
+  // The signal never falls below the ambient light, so a recent minimum
+  // under the estimate means the room got darker.
+  const float recentMin = static_cast<float>(recentRange_.min());
+  if (recentMin < floor) {
+    floor = recentMin;
+  }
+
+  const float onThreshold =
+      floor + std::fmax(config_.detectOnMargin, config_.detectOnSigma * sigma);
+  const float offThreshold =
+      floor +
+      std::fmax(config_.detectOffMargin, config_.detectOffSigma * sigma);
+  state_.signalThreshold = state_.detected ? offThreshold : onThreshold;
+  state_.detected = state_.totalSignal >= state_.signalThreshold;
+  state_.noiseFloor = floor;
+
+  const bool quiet = recentRange_.full() &&
+                     static_cast<float>(recentRange_.max() -
+                                        recentRange_.min()) <=
+                         config_.quietSpread;
+  if (!quiet) {
+    loudAtMs_ = now;
+    adoptedQuiet_ = false;
+  }
+  const uint32_t quietMs = now - loudAtMs_;
+  const bool adopt =
+      quietMs >= config_.quietForceMs ||
+      (quietMs >= config_.quietHoldMs && matchesBackgroundProfile());
+  if (state_.detected && adopt && !adoptedQuiet_) {
+    // Flat for too long to be the beacon: the room got brighter. Take the
+    // recent window over as background in one go.
+    backgroundSignal_ = recentSignal_;
+    backgroundSteps_ = recentSteps_;
+    for (size_t i = 0; i < 4; ++i) {
+      backgroundProfile_[i] = recentProfile_[i];
+    }
+    adoptedQuiet_ = true;
+  } else if (!state_.detected || adoptedQuiet_) {
+    backgroundSignal_.push(sample);
+    backgroundSteps_.push(step);
+    for (size_t i = 0; i < 4; ++i) {
+      backgroundProfile_[i] +=
+          BACKGROUND_PROFILE_ALPHA * (profile[i] - backgroundProfile_[i]);
+    }
+  }
+}
+
+bool BeaconTracker::matchesBackgroundProfile() const {
+  if (backgroundSignal_.size() < MIN_BACKGROUND_SAMPLES) {
+    return true;
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    if (std::fabs(recentProfile_[i] - backgroundProfile_[i]) >
+        config_.profileTolerance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void BeaconTracker::updateConfidence(const float (&beacon)[4],
+                                     bool saturated) {
+  const bool turnKnown = turnKnown_;
+  const float turn = turnRad_;
+  const bool havePrevious = havePreviousTheta_;
+  const float previousTheta = previousTheta_;
+  turnRad_ = 0.0f;
+  turnKnown_ = false;
+  previousTheta_ = state_.theta;
+  havePreviousTheta_ = true;
+
+  state_.opposingRatio = 0.0f;
+  state_.vectorShare = 0.0f;
+  state_.turnMismatch = 0.0f;
+  if (!config_.multipathCheck) {
+    state_.confidence = 1.0f;
+    state_.reflected = false;
+    return;
+  }
+
+  // A clipped channel says nothing about where the light comes from; the
+  // saturation guard holds the heading meanwhile.
+  if (saturated) {
+    return;
+  }
+  float measured = 1.0f;
+  if (state_.detected && state_.beaconSignal >= config_.multipathMinSignal) {
+    // Front/back and left/right are pairs: index ^ 1 is the opposite
+    // channel.
+    size_t brightest = 0;
+    for (size_t i = 1; i < 4; ++i) {
+      if (beacon[i] > beacon[brightest]) {
+        brightest = i;
+      }
+    }
+    state_.opposingRatio = beacon[brightest ^ 1U] / beacon[brightest];
+    state_.vectorShare = std::sqrt((beacon[0] - beacon[1]) *
+                                       (beacon[0] - beacon[1]) +
+                                   (beacon[2] - beacon[3]) *
+                                       (beacon[2] - beacon[3])) /
+                         state_.beaconSignal;
+    measured = std::fmin(score(state_.opposingRatio, config_.opposingRatioOk,
+                               config_.opposingRatioBad),
+                         score(state_.vectorShare, config_.vectorShareOk,
+                               config_.vectorShareBad));
+    if (turnKnown && havePrevious) {
+      // Turning left moves the beacon right, toward negative bearings.
+      state_.turnMismatch =
+          std::fabs(wrapAngle(state_.theta - previousTheta + turn));
+      measured = std::fmin(measured, score(state_.turnMismatch,
+                                           config_.turnMismatchOkRad,
+                                           config_.turnMismatchBadRad));
+    }
+  }
+
+  if (measured < state_.confidence) {
+    state_.confidence = measured;
+  } else {
+    state_.confidence +=
+        config_.confidenceRecovery * (measured - state_.confidence);
+  }
+  state_.reflected = state_.confidence < config_.confidenceReject;
+}
+
+bool BeaconTracker::extendGuard(uint32_t now, uint16_t holdMs) {
+  const uint32_t deadline = now + static_cast<uint32_t>(holdMs);
+  if (isBefore(guardUntilMs_, deadline)) {
+    guardUntilMs_ = deadline;
+  }
+  return guardActive(now);
+}
+
+bool BeaconTracker::guardActive(uint32_t now) const {
+  return isBefore(now, guardUntilMs_);
+}
+
+const BeaconTrackerState &BeaconTracker::update(uint32_t rawFront,
+                                                uint32_t rawBack,
+                                                uint32_t rawLeft,
+                                                uint32_t rawRight,
+                                                uint32_t timestampMs) {
+  const uint32_t raw[4] = {rawFront, rawBack, rawLeft, rawRight};
+  uint32_t filtered[4];
+  prefilter(raw, filtered);
+
+  state_.timestampMs = timestampMs;
+  state_.rawFront = rawFront;
+  state_.rawBack = rawBack;
+  state_.rawLeft = rawLeft;
+  state_.rawRight = rawRight;
+
+  state_.front = calibrate(filtered[0], scale_[0], dutyScaleQ12_);
+  state_.back = calibrate(filtered[1], scale_[1], dutyScaleQ12_);
+  state_.left = calibrate(filtered[2], scale_[2], dutyScaleQ12_);
+  state_.right = calibrate(filtered[3], scale_[3], dutyScaleQ12_);
+
+  state_.vx = state_.front - state_.back;
+  state_.vy = state_.left - state_.right;
+  state_.theta = std::atan2(state_.vy, state_.vx);
+  state_.totalSignal = state_.front + state_.back + state_.left + state_.right;
+  const float beacon[4] = {aboveAmbient(state_.front, scale_[0]),
+                           aboveAmbient(state_.back, scale_[1]),
+                           aboveAmbient(state_.left, scale_[2]),
+                           aboveAmbient(state_.right, scale_[3])};
+  state_.beaconSignal = beacon[0] + beacon[1] + beacon[2] + beacon[3];
+  updateDetection(timestampMs);
+
+  const bool saturated =
+      rawFront >= config_.saturationRawThreshold ||
+      rawBack >= config_.saturationRawThreshold ||
+      rawLeft >= config_.saturationRawThreshold ||
+      rawRight >= config_.saturationRawThreshold;
+  updateConfidence(beacon, saturated);
+
+  bool dropped = false;
+  if (previousSignal_ > 1.0f && state_.totalSignal < previousSignal_) {
+    const float ratio = (previousSignal_ - state_.totalSignal) / previousSignal_;
+    dropped = ratio >= config_.signalDropGuardRatio;
+  }
+  if (saturated || dropped) {
+    extendGuard(timestampMs, config_.guardHoldMs);
+  }
+  const bool freezeHeading = guardActive(timestampMs);
+  state_.saturated = saturated;
+  state_.headingHeld = freezeHeading;
+
+  if (state_.detected) {
+    if (!state_.initialized) {
+      state_.filteredTheta = state_.theta;
+      state_.initialized = true;
+    } else if (!freezeHeading && !state_.reflected) {
+      const float delta = wrapAngle(state_.theta - state_.filteredTheta);
+      const float boundedDelta =
+          clampf(delta, -config_.maxAngleStepRad, config_.maxAngleStepRad);
+      state_.filteredTheta = wrapAngle(
+          state_.filteredTheta +
+          config_.angleAlpha * state_.confidence * boundedDelta);
+    }
+  } else if (!state_.initialized) {
+    state_.filteredTheta = 0.0f;
+  }
+
+  previousSignal_ = state_.totalSignal;
+
+  return state_;
+}
+
+const BeaconTrackerState &BeaconTracker::state() const { return state_; }
+
+void BeaconTracker::setBeaconDuty(uint16_t duty) {
+  const uint32_t reference = config_.referenceDuty;
+  const uint32_t lowest = (reference + MIN_DUTY_DIVISOR - 1) / MIN_DUTY_DIVISOR;
+  const uint32_t clamped = duty < lowest ? lowest : duty;
+  beaconDuty_ = duty;
+  dutyScaleQ12_ = reference == 0
+                      ? (1U << GAIN_FRACTION_BITS)
+                      : static_cast<uint32_t>(
+                            ((reference << GAIN_FRACTION_BITS) + clamped / 2) /
+                            clamped);
+}
+
+uint16_t BeaconTracker::beaconDuty() const { return beaconDuty_; }
+
+void BeaconTracker::addTurn(float radians) {
+  turnRad_ += radians;
+  turnKnown_ = true;
+}
+
+void BeaconTracker::reset() {
+  state_ = BeaconTrackerState();
+  median3_.reset();
+  median5_.reset();
+  hampel7_.reset();
+  previousSignal_ = 0.0f;
+  guardUntilMs_ = 0;
+  turnRad_ = 0.0f;
+  turnKnown_ = false;
+  previousTheta_ = 0.0f;
+  havePreviousTheta_ = false;
+}
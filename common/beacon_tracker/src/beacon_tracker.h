@@ -0,0 +1,217 @@
+#pragma once
+
+#include <sliding_window.h>
+#include <window_filters.h>
+
+#include <cstdint>
+
+// amplitude = max(raw - offset, 0) * gain. The tracker converts both to
+// integers once (whole counts, gain in 1/4096 steps) and scales each sample
+// in integer math.
+struct SensorCalibration {
+  float gain = 1.0f;
+  float offset = 0.0f;
+  // Calibrated room light on this channel. Only the amplitude above it
+  // comes from the beacon and is scaled for the beacon duty.
+  float ambient = 0.0f;
+};
+
+// Outlier rejection on the raw ADC counts, before calibration.
+enum class RawPrefilter : uint8_t {
+  // Median of the last 3 samples: rejects single-sample spikes, one sample of
+  // delay.
+  MEDIAN3,
+  // Median of the last 5 samples: rejects runs of two, two samples of delay.
+  MEDIAN5,
+  // Hampel check over the last 7 samples: replaces samples further than
+  // 3 sigma (MAD-estimated, at least hampelMinDeviation counts) from the
+  // window median by the median and passes everything else undelayed.
+  HAMPEL7
+};
+
+enum class DetectionMode : uint8_t {
+  // Detected while totalSignal >= signalMin.
+  FIXED,
+  // The threshold sits a few noise sigmas above the ambient floor, which is
+  // learned at runtime from samples without the beacon. Detection turns on
+  // above floor + max(detectOnMargin, detectOnSigma * sigma) and off below
+  // floor + max(detectOffMargin, detectOffSigma * sigma).
+  ADAPTIVE_FLOOR
+};
+
+struct BeaconTrackerConfig {
+  SensorCalibration front;
+  SensorCalibration back;
+  SensorCalibration left;
+  SensorCalibration right;
+  float signalMin = 800.0f;
+  float angleAlpha = 0.18f;
+  float maxAngleStepRad = 0.35f;
+  float signalDropGuardRatio = 0.22f;
+  uint16_t saturationRawThreshold = 4080;
+  uint16_t guardHoldMs = 120;
+  // Beacon duty the signal thresholds are tuned at. At any other duty (see
+  // setBeaconDuty) the amplitude above each channel's ambient level is
+  // scaled by referenceDuty / duty, so totalSignal reads the same at the
+  // same distance whatever power the master drives the beacon with.
+  uint16_t referenceDuty = 256;
+  RawPrefilter rawPrefilter = RawPrefilter::MEDIAN3;
+  uint16_t hampelMinDeviation = 60;
+  DetectionMode detectionMode = DetectionMode::FIXED;
+  // Ambient floor and noise of totalSignal assumed until enough samples
+  // without the beacon have been seen.
+  float floorPrior = 1300.0f;
+  float noiseSigmaPrior = 30.0f;
+  float detectOnSigma = 5.0f;
+  float detectOffSigma = 2.5f;
+  float detectOnMargin = 120.0f;
+  float detectOffMargin = 60.0f;
+  // While detected, a signal that stays within quietSpread is taken as
+  // ambient light so the floor can follow the room getting brighter: after
+  // quietHoldMs if the channels keep the background's proportions (brighter
+  // light, same sources) within profileTolerance, after quietForceMs
+  // otherwise. A beacon that stays that steady in front of a robot that is
+  // not moving is lost after quietForceMs.
+  float quietSpread = 150.0f;
+  uint32_t quietHoldMs = 3000;
+  uint32_t quietForceMs = 30000;
+  float profileTolerance = 0.005f;
+  // Multipath checks (see BeaconTrackerState::confidence), on the amplitudes
+  // above ambient once beaconSignal reaches multipathMinSignal. Each check
+  // scores 1 at its Ok value, 0 at its Bad value and linear in between:
+  // - the channel opposite the brightest one, over the brightest: light
+  //   from the beacon barely reaches the far side of the robot, a
+  //   reflection behind it does;
+  // - |(front - back, left - right)| over beaconSignal: light from two
+  //   sides cancels in the vector but not in the sum;
+  // - the bearing change less the robot's own turn, per tick (addTurn):
+  //   a reflection taking over moves the bearing without the robot turning.
+  // The lowest score is taken at once and recovered from by
+  // confidenceRecovery per tick; saturated ticks are skipped. Off,
+  // confidence stays at 1.
+  bool multipathCheck = false;
+  float multipathMinSignal = 60.0f;
+  float opposingRatioOk = 0.25f;
+  float opposingRatioBad = 0.60f;
+  float vectorShareOk = 0.45f;
+  float vectorShareBad = 0.20f;
+  float turnMismatchOkRad = 0.10f;
+  float turnMismatchBadRad = 0.40f;
+  float confidenceRecovery = 0.10f;
+  // The bearing filter moves by angleAlpha * confidence; below
+  // confidenceReject the bearing is taken as reflected and held.
+  float confidenceReject = 0.30f;
+};
+
+struct BeaconTrackerState {
+  uint32_t timestampMs = 0;
+  uint32_t rawFront = 0;
+  uint32_t rawBack = 0;
+  uint32_t rawLeft = 0;
+  uint32_t rawRight = 0;
+
+  float front = 0.0f;
+  float back = 0.0f;
+  float left = 0.0f;
+  float right = 0.0f;
+
+  float vx = 0.0f;
+  float vy = 0.0f;
+  float theta = 0.0f;
+  float filteredTheta = 0.0f;
+  float totalSignal = 0.0f;
+  // Part of totalSignal above the channels' ambient levels.
+  float beaconSignal = 0.0f;
+  // Ambient floor estimate and the threshold totalSignal was compared with
+  // (signalMin in FIXED mode).
+  float noiseFloor = 0.0f;
+  float signalThreshold = 0.0f;
+  bool detected = false;
+  bool initialized = false;
+  // A raw channel reached saturationRawThreshold this tick.
+  bool saturated = false;
+  // The saturation/drop guard held the heading this tick.
+  bool headingHeld = false;
+  // How far the bearing can be trusted to come from the beacon itself and
+  // not a wall reflection, 0..1, with the inputs of the multipath checks;
+  // reflected when below confidenceReject, and the bearing is held.
+  float confidence = 1.0f;
+  float opposingRatio = 0.0f;
+  float vectorShare = 0.0f;
+  float turnMismatch = 0.0f;
+  bool reflected = false;
+};
+
+class BeaconTracker {
+public:
+  // Integer form of a SensorCalibration.
+  struct ChannelScale {
+    int32_t offset = 0;
+    uint32_t gainQ12 = 4096;
+    uint32_t ambient = 0;
+  };
+
+  explicit BeaconTracker(const BeaconTrackerConfig &config = BeaconTrackerConfig());
+
+  const BeaconTrackerState &update(uint32_t rawFront, uint32_t rawBack,
+                                   uint32_t rawLeft, uint32_t rawRight,
+                                   uint32_t timestampMs);
+
+  const BeaconTrackerState &state() const;
+  // Duty (/1023) the beacon is currently driven with, as advertised by the
+  // master. Takes effect from the next update.
+  void setBeaconDuty(uint16_t duty);
+  uint16_t beaconDuty() const;
+  // Robot heading change in radians, counter-clockwise positive, from the
+  // gyro; summed until the next update. Without it the bearing check of
+  // the multipath checks is skipped.
+  void addTurn(float radians);
+  // Starts a new track. The learned ambient floor is kept: it describes the
+  // room, not the walk.
+  void reset();
+
+private:
+  static float clampf(float value, float low, float high);
+  static bool isBefore(uint32_t now, uint32_t deadline);
+  // Channels are in front, back, left, right order.
+  void prefilter(const uint32_t (&raw)[4], uint32_t (&filtered)[4]);
+  void updateDetection(uint32_t now);
+  void updateConfidence(const float (&beacon)[4], bool saturated);
+  bool matchesBackgroundProfile() const;
+  bool extendGuard(uint32_t now, uint16_t holdMs);
+  bool guardActive(uint32_t now) const;
+
+  BeaconTrackerConfig config_;
+  BeaconTrackerState state_;
+  // Front, back, left, right.
+  ChannelScale scale_[4];
+  uint16_t beaconDuty_ = 0;
+  // referenceDuty / beaconDuty_ in 1/4096 steps.
+  uint32_t dutyScaleQ12_ = 4096;
+  window_filters::MedianFilter<uint32_t, 3> median3_;
+  window_filters::MedianFilter<uint32_t, 5> median5_;
+  window_filters::HampelFilter<uint32_t, 7> hampel7_;
+  // totalSignal over the last SIGNAL_WINDOW samples (~1.3 s at 50 Hz), and
+  // over the last SIGNAL_WINDOW samples that looked like ambient light. The
+  // noise comes from the sample-to-sample steps, so a drifting room light
+  // does not inflate it.
+  static constexpr size_t SIGNAL_WINDOW = 64;
+  window_filters::SlidingMinMax<int32_t, SIGNAL_WINDOW> recentRange_;
+  window_filters::SlidingMoments<SIGNAL_WINDOW> recentSignal_;
+  window_filters::SlidingMoments<SIGNAL_WINDOW> recentSteps_;
+  window_filters::SlidingMoments<SIGNAL_WINDOW> backgroundSignal_;
+  window_filters::SlidingMoments<SIGNAL_WINDOW> backgroundSteps_;
+  // Share of each channel in totalSignal, smoothed over all samples and over
+  // the background samples.
+  float recentProfile_[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  float backgroundProfile_[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  int32_t previousSample_ = 0;
+  bool adoptedQuiet_ = false;
+  uint32_t loudAtMs_ = 0;
+  float previousSignal_ = 0.0f;
+  uint32_t guardUntilMs_ = 0;
+  float turnRad_ = 0.0f;
+  bool turnKnown_ = false;
+  float previousTheta_ = 0.0f;
+  bool havePreviousTheta_ = false;
+};
@@ -0,0 +1,108 @@
+#include "boot_timing.h"
+
+#include <cstdio>
+
+namespace boot_timing {
+const char *phaseName(Phase phase) {
+  switch (phase) {
+  case Phase::SERIAL_READY:
+    return "serial";
+  case Phase::BEGIN_DONE:
+    return "begin";
+  case Phase::SETTINGS_LOADED:
+    return "settings";
+  case Phase::SETUP_DONE:
+    return "setup";
+  case Phase::FIRST_TICK:
+    return "first_tick";
+  case Phase::MESH_READY:
+    return "mesh_ready";
+  case Phase::DEFERRED_DONE:
+    return "deferred";
+  case Phase::COUNT:
+    break;
+  }
+  return "unknown";
+}
+
+const char *resetReasonName(uint8_t reason) {
+  static const char *const NAMES[] = {
+      "unknown", "poweron",  "external", "software",  "panic",   "int_wdt",
+      "task_wdt", "wdt",     "deepsleep", "brownout", "sdio"};
+  return reason < sizeof(NAMES) / sizeof(NAMES[0]) ? NAMES[reason]
+                                                   : "unknown";
+}
+
+void BootTimeline::mark(Phase phase, uint64_t sinceResetUs) {
+  const uint32_t value = static_cast<uint32_t>(sinceResetUs / 1000U) + 1U;
+  uint32_t unmarked = 0;
+  marks_[static_cast<size_t>(phase)].compare_exchange_strong(
+      unmarked, value, std::memory_order_relaxed);
+}
+
+bool BootTimeline::marked(Phase phase) const {
+  return marks_[static_cast<size_t>(phase)].load(std::memory_order_relaxed) !=
+         0;
+}
+
+uint32_t BootTimeline::atMs(Phase phase) const {
+  const uint32_t value =
+      marks_[static_cast<size_t>(phase)].load(std::memory_order_relaxed);
+  return value == 0 ? 0 : value - 1U;
+}
+
+bool BootTimeline::due(uint64_t sinceResetUs, uint32_t timeoutMs) {
+  if (reported_) {
+    return false;
+  }
+  const bool complete =
+      marked(Phase::FIRST_TICK) && marked(Phase::MESH_READY);
+  if (!complete && sinceResetUs / 1000U < timeoutMs) {
+    return false;
+  }
+  reported_ = true;
+  return true;
+}
+
+size_t BootTimeline::format(uint32_t node, const char *resetReason, char *out,
+                            size_t size) const {
+  int written = snprintf(out, size, "boot,%lu,%s",
+                         static_cast<unsigned long>(node), resetReason);
+  if (written <= 0 || static_cast<size_t>(written) >= size) {
+    return 0;
+  }
+  size_t used = static_cast<size_t>(written);
+  // Phases in the order they were marked, unmarked ones last.
+  uint32_t keys[PHASE_COUNT];
+  size_t order[PHASE_COUNT];
+  for (size_t i = 0; i < PHASE_COUNT; ++i) {
+    const uint32_t value = marks_[i].load(std::memory_order_relaxed);
+    keys[i] = value == 0 ? UINT32_MAX : value;
+    size_t at = i;
+    while (at > 0 && keys[order[at - 1]] > keys[i]) {
+      order[at] = order[at - 1];
+      at--;
+    }
+    order[at] = i;
+  }
+  for (size_t i = 0; i < PHASE_COUNT; ++i) {
+    const Phase phase = static_cast<Phase>(order[i]);
+    written = keys[order[i]] != UINT32_MAX
+                  ? snprintf(out + used, size - used, ",%s=%lu",
+                             phaseName(phase),
+                             static_cast<unsigned long>(keys[order[i]] - 1U))
+                  : snprintf(out + used, size - used, ",%s=-",
+                             phaseName(phase));
+    if (written <= 0 || static_cast<size_t>(written) >= size - used) {
+      return 0;
+    }
+    used += static_cast<size_t>(written);
+  }
+  if (size - used < 2) {
+    return 0;
+  }
+  out[used++] = '\n';
+  out[used] = '\0';
+  return used;
+}
+} // namespace boot_timing
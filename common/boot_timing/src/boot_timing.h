@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// How long a node takes to come back after a reset. Phases are marked with
+// the time since reset (esp_timer) as boot gets to them; the two that
+// matter for the fleet are the first control tick, from when the node acts
+// on its state again, and mesh ready, from when it hears the mesh. Once
+// both are in, or the report timeout has passed, the timeline goes out as
+// one line:
+//
+//   boot,<node>,<reset_reason>,<phase>=<ms>,...
+//
+// in the order the phases were marked, `-` for a phase that never came.
+namespace boot_timing {
+enum class Phase : uint8_t {
+  // Serial port up: setup() got going.
+  SERIAL_READY,
+  // Dezibot's begin(): every subsystem and the mesh join.
+  BEGIN_DONE,
+  // Settings from flash (NVS) loaded.
+  SETTINGS_LOADED,
+  SETUP_DONE,
+  FIRST_TICK,
+  MESH_READY,
+  // Peripherals deferred past the first tick, e.g. the flight recorder's
+  // file system.
+  DEFERRED_DONE,
+  COUNT
+};
+constexpr size_t PHASE_COUNT = static_cast<size_t>(Phase::COUNT);
+const char *phaseName(Phase phase);
+
+// esp_reset_reason_t of ESP-IDF, by value.
+const char *resetReasonName(uint8_t reason);
+
+constexpr size_t LINE_CAPACITY = 192;
+
+class BootTimeline {
+public:
+  // Only the first mark of a phase counts. Safe from any task.
+  void mark(Phase phase, uint64_t sinceResetUs);
+  bool marked(Phase phase) const;
+  uint32_t atMs(Phase phase) const;
+
+  // True once, when the line is due: FIRST_TICK and MESH_READY are in, or
+  // timeoutMs has passed since reset.
+  bool due(uint64_t sinceResetUs, uint32_t timeoutMs);
+  size_t format(uint32_t node, const char *resetReason, char *out,
+                size_t size) const;
+
+private:
+  // Ms since reset + 1, 0 while unmarked; a boot takes far less than the
+  // 49 days these wrap after.
+  std::atomic<uint32_t> marks_[PHASE_COUNT] = {};
+  bool reported_ = false;
+};
+} // namespace boot_timing
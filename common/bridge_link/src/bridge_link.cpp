@@ -0,0 +1,81 @@
+#include "bridge_link.h"
+
+#include <cstring>
+
+namespace bridge_link {
+const char *statusText(Status status) {
+  switch (status) {
+  case Status::IDLE:
+    return "IDLE";
+  case Status::BUSY_LOWER_WALK_IN:
+    return "BUSY:LOWER_WALK_IN";
+  case Status::BUSY_LOWER_CHARGE:
+    return "BUSY:LOWER_CHARGE";
+  case Status::BUSY_RAISE:
+    return "BUSY:RAISE";
+  case Status::DONE_LOWER_WALK_IN:
+    return "DONE:LOWER_WALK_IN";
+  case Status::DONE_LOWER_CHARGE:
+    return "DONE:LOWER_CHARGE";
+  case Status::DONE_RAISE:
+    return "DONE:RAISE";
+  case Status::FAULT_LOWER_WALK_IN:
+    return "FAULT:LOWER_WALK_IN";
+  case Status::FAULT_LOWER_CHARGE:
+    return "FAULT:LOWER_CHARGE";
+  case Status::FAULT_RAISE:
+    return "FAULT:RAISE";
+  case Status::COUNT:
+    break;
+  }
+  return "IDLE";
+}
+
+bool parseStatus(const char *text, size_t length, Status &status) {
+  for (uint8_t i = 0; i < static_cast<uint8_t>(Status::COUNT); ++i) {
+    const char *candidate = statusText(static_cast<Status>(i));
+    if (strlen(candidate) == length && memcmp(candidate, text, length) == 0) {
+      status = static_cast<Status>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool isTerminal(Status status) {
+  return status >= Status::DONE_LOWER_WALK_IN && status < Status::COUNT;
+}
+
+bool isFault(Status status) {
+  return status >= Status::FAULT_LOWER_WALK_IN && status < Status::COUNT;
+}
+
+bool StatusNotifier::set(Status status) {
+  const uint8_t value = static_cast<uint8_t>(status);
+  if (status_.exchange(value, std::memory_order_acq_rel) == value) {
+    return false;
+  }
+  // A new motion takes the line back; a finished one raises it.
+  asserted_.store(isTerminal(status), std::memory_order_release);
+  if (isTerminal(status)) {
+    raised_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+Status StatusNotifier::status() const {
+  return static_cast<Status>(status_.load(std::memory_order_acquire));
+}
+
+void StatusNotifier::acknowledge() {
+  asserted_.store(false, std::memory_order_release);
+}
+
+bool StatusNotifier::asserted() const {
+  return asserted_.load(std::memory_order_acquire);
+}
+
+uint32_t StatusNotifier::raised() const {
+  return raised_.load(std::memory_order_relaxed);
+}
+} // namespace bridge_link
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Status of the motor controller's bridge, as it answers an I2C read
+// (`bridge_status`), and the interrupt line that tells the master when to
+// read it. Master only has to read once a motion has finished or failed.
+// Until then it can leave the bus alone.
+//
+// The controller pulls the line low (open drain, pulled up on the master)
+// when the status turns terminal, DONE:* or FAULT:*. It lets go when the
+// status has been read or the next motion starts. The master wakes on the
+// falling edge and reads the status once. A missed edge costs no more than
+// the master's fallback poll.
+namespace bridge_link {
+enum class Status : uint8_t {
+  IDLE,
+  BUSY_LOWER_WALK_IN,
+  BUSY_LOWER_CHARGE,
+  BUSY_RAISE,
+  DONE_LOWER_WALK_IN,
+  DONE_LOWER_CHARGE,
+  DONE_RAISE,
+  // The motion ran past its time limit and was stopped where it was.
+  FAULT_LOWER_WALK_IN,
+  FAULT_LOWER_CHARGE,
+  FAULT_RAISE,
+  COUNT
+};
+
+// What the controller sends over I2C, e.g. "DONE:RAISE".
+const char *statusText(Status status);
+// The longest statusText().
+constexpr size_t STATUS_TEXT_CAPACITY = 20;
+bool parseStatus(const char *text, size_t length, Status &status);
+bool isTerminal(Status status);
+bool isFault(Status status);
+
+// Runs on the controller. set() is called from its loop and
+// acknowledge() from the I2C request callback, on another task.
+class StatusNotifier {
+public:
+  // Returns true if the status changed.
+  bool set(Status status);
+  Status status() const;
+  // Called when the master reads the status: releases the line.
+  void acknowledge();
+  // The line is to be held low.
+  bool asserted() const;
+  // Changes to a terminal status, since boot.
+  uint32_t raised() const;
+
+private:
+  std::atomic<uint8_t> status_{static_cast<uint8_t>(Status::IDLE)};
+  std::atomic<bool> asserted_{false};
+  std::atomic<uint32_t> raised_{0};
+};
+} // namespace bridge_link
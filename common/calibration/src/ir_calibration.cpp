@@ -0,0 +1,311 @@
+#include "ir_calibration.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+void putLe16(uint8_t *out, uint16_t value) {
+  out[0] = static_cast<uint8_t>(value);
+  out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+uint16_t getLe16(const uint8_t *in) {
+  return static_cast<uint16_t>(in[0] | (in[1] << 8));
+}
+
+uint16_t aboveBaseline(uint16_t raw, uint16_t baseline) {
+  return raw > baseline ? static_cast<uint16_t>(raw - baseline) : 0;
+}
+} // namespace
+
+namespace ir_calibration {
+
+void encode(const Calibration &calibration, uint8_t (&record)[RECORD_SIZE]) {
+  record[0] = RECORD_VERSION;
+  record[1] = calibration.flags;
+  uint8_t *out = record + 2;
+  for (uint8_t i = 0; i < CHANNELS; ++i) {
+    putLe16(out + 2 * i, calibration.offset[i]);
+    putLe16(out + 2 * (CHANNELS + i), calibration.gainQ12[i]);
+    putLe16(out + 2 * (2 * CHANNELS + i), calibration.ambient[i]);
+  }
+}
+
+bool decode(const uint8_t (&record)[RECORD_SIZE], Calibration &calibration) {
+  if (record[0] != RECORD_VERSION) {
+    return false;
+  }
+  calibration.flags = record[1];
+  const uint8_t *in = record + 2;
+  for (uint8_t i = 0; i < CHANNELS; ++i) {
+    calibration.offset[i] = getLe16(in + 2 * i);
+    calibration.gainQ12[i] = getLe16(in + 2 * (CHANNELS + i));
+    calibration.ambient[i] = getLe16(in + 2 * (2 * CHANNELS + i));
+  }
+  return true;
+}
+
+const char *fitStatusName(FitStatus status) {
+  switch (status) {
+  case FitStatus::OK:
+    return "ok";
+  case FitStatus::TOO_FEW_SAMPLES:
+    return "too_few_samples";
+  case FitStatus::NOT_DARK:
+    return "not_dark";
+  case FitStatus::NOISY:
+    return "noisy";
+  case FitStatus::SATURATED:
+    return "saturated";
+  case FitStatus::WEAK_SIGNAL:
+    return "weak_signal";
+  case FitStatus::INCOMPLETE_SPIN:
+    return "incomplete_spin";
+  case FitStatus::GAIN_OUT_OF_RANGE:
+    return "gain_out_of_range";
+  case FitStatus::AMBIENT_HIGH:
+    return "ambient_high";
+  case FitStatus::AMBIENT_UNEVEN:
+    return "ambient_uneven";
+  }
+  return "unknown";
+}
+
+void DarkCapture::add(const uint16_t (&raw)[CHANNELS]) {
+  for (uint8_t i = 0; i < CHANNELS; ++i) {
+    sum_[i] += raw[i];
+    sumSquares_[i] += static_cast<uint64_t>(raw[i]) * raw[i];
+  }
+  count_++;
+}
+
+void DarkCapture::reset() { *this = DarkCapture(); }
+
+uint32_t DarkCapture::samples() const { return count_; }
+
+float DarkCapture::mean(uint8_t channel) const {
+  return count_ == 0 ? 0.0f
+                     : static_cast<float>(sum_[channel]) /
+                           static_cast<float>(count_);
+}
+
+float DarkCapture::noise(uint8_t channel) const {
+  if (count_ < 2) {
+    return 0.0f;
+  }
+  const double n = static_cast<double>(count_);
+  const double sum = static_cast<double>(sum_[channel]);
+  const double variance =
+      (static_cast<double>(sumSquares_[channel]) - sum * sum / n) / (n - 1.0);
+  return variance > 0.0 ? static_cast<float>(std::sqrt(variance)) : 0.0f;
+}
+
+FitStatus DarkCapture::fit(Calibration &calibration) const {
+  if (count_ < MIN_DARK_SAMPLES) {
+    return FitStatus::TOO_FEW_SAMPLES;
+  }
+  uint16_t offsets[CHANNELS];
+  for (uint8_t i = 0; i < CHANNELS; ++i) {
+    const float offset = mean(i);
+    if (offset > MAX_DARK_OFFSET) {
+      return FitStatus::NOT_DARK;
+    }
+    if (noise(i) > MAX_DARK_NOISE) {
+      return FitStatus::NOISY;
+    }
+    offsets[i] = static_cast<uint16_t>(offset + 0.5f);
+  }
+  std::memcpy(calibration.offset, offsets, sizeof(offsets));
+  calibration.flags |= FLAG_DARK;
+  return FitStatus::OK;
+}
+
+SpinCapture::SpinCapture() {
+  const uint16_t zero[CHANNELS] = {0, 0, 0, 0};
+  reset(zero);
+}
+
+void SpinCapture::reset(const uint16_t (&baseline)[CHANNELS]) {
+  std::memcpy(baseline_, baseline, sizeof(baseline_));
+  std::memset(histogram_, 0, sizeof(histogram_));
+  std::memset(dominant_, 0, sizeof(dominant_));
+  count_ = 0;
+  saturated_ = 0;
+}
+
+void SpinCapture::add(const uint16_t (&raw)[CHANNELS], uint8_t pivot) {
+  pivot = pivot < PIVOTS ? pivot : PIVOTS - 1;
+  uint8_t strongest = 0;
+  uint16_t strongestCounts = 0;
+  bool saturated = false;
+  for (uint8_t i = 0; i < CHANNELS; ++i) {
+    const uint16_t value = raw[i] > ADC_MAX ? ADC_MAX : raw[i];
+    const uint16_t counts = aboveBaseline(value, baseline_[i]);
+    uint16_t &bin = histogram_[pivot][i][counts >> BIN_SHIFT];
+    if (bin < UINT16_MAX) {
+      bin++;
+    }
+    if (counts > strongestCounts) {
+      strongest = i;
+      strongestCounts = counts;
+    }
+    saturated = saturated || value >= SPIN_SATURATION_RAW;
+  }
+  dominant_[strongest]++;
+  saturated_ += saturated ? 1 : 0;
+  count_++;
+}
+
+uint32_t SpinCapture::samples() const { return count_; }
+
+float SpinCapture::peak(uint8_t channel) const {
+  float product = 1.0f;
+  uint8_t used = 0;
+  for (uint8_t pivot = 0; pivot < PIVOTS; ++pivot) {
+    const float value = pivotPeak(pivot, channel);
+    if (value >= 0.0f) {
+      product *= value;
+      used++;
+    }
+  }
+  if (used == 0) {
+    return 0.0f;
+  }
+  return used == 1 ? product : std::sqrt(product);
+}
+
+// Negative when the pivot has no samples.
+float SpinCapture::pivotPeak(uint8_t pivot, uint8_t channel) const {
+  const uint16_t *histogram = histogram_[pivot][channel];
+  uint32_t total = 0;
+  for (uint16_t b = 0; b < BINS; ++b) {
+    total += histogram[b];
+  }
+  if (total == 0) {
+    return -1.0f;
+  }
+  // Walk down from the top until the samples above reach 1 - percentile,
+  // then interpolate inside that bin.
+  const float target = (1.0f - SPIN_PEAK_PERCENTILE) * static_cast<float>(total);
+  float above = 0.0f;
+  for (uint16_t b = BINS; b-- > 0;) {
+    const float inBin = histogram[b];
+    if (inBin > 0.0f && above + inBin >= target) {
+      const float fromTop = (target - above) / inBin;
+      return (static_cast<float>(b + 1) - fromTop) *
+             static_cast<float>(1U << BIN_SHIFT);
+    }
+    above += inBin;
+  }
+  return 0.0f;
+}
+
+float SpinCapture::dominantShare(uint8_t channel) const {
+  return count_ == 0 ? 0.0f
+                     : static_cast<float>(dominant_[channel]) /
+                           static_cast<float>(count_);
+}
+
+float SpinCapture::saturatedShare() const {
+  return count_ == 0 ? 0.0f
+                     : static_cast<float>(saturated_) /
+                           static_cast<float>(count_);
+}
+
+FitStatus SpinCapture::fit(Calibration &calibration) const {
+  if (count_ < MIN_SPIN_SAMPLES) {
+    return FitStatus::TOO_FEW_SAMPLES;
+  }
+  if (saturatedShare() > MAX_SATURATED_SHARE) {
+    return FitStatus::SATURATED;
+  }
+
+  float peaks[CHANNELS];
+  float meanPeak = 0.0f;
+  for (uint8_t i = 0; i < CHANNELS; ++i) {
+    if (dominantShare(i) < MIN_DOMINANT_SHARE) {
+      return FitStatus::INCOMPLETE_SPIN;
+    }
+    peaks[i] = peak(i);
+    if (peaks[i] < MIN_SPIN_PEAK) {
+      return FitStatus::WEAK_SIGNAL;
+    }
+    meanPeak += peaks[i] / CHANNELS;
+  }
+
+  uint16_t gains[CHANNELS];
+  for (uint8_t i = 0; i < CHANNELS; ++i) {
+    const float gain = meanPeak / peaks[i];
+    if (gain < MIN_GAIN || gain > MAX_GAIN) {
+      return FitStatus::GAIN_OUT_OF_RANGE;
+    }
+    gains[i] = static_cast<uint16_t>(gain * GAIN_ONE + 0.5f);
+  }
+  for (uint8_t i = 0; i < CHANNELS; ++i) {
+    const uint32_t rescaled =
+        (static_cast<uint32_t>(calibration.ambient[i]) * gains[i] +
+         calibration.gainQ12[i] / 2) /
+        calibration.gainQ12[i];
+    calibration.ambient[i] =
+        static_cast<uint16_t>(rescaled > UINT16_MAX ? UINT16_MAX : rescaled);
+  }
+  std::memcpy(calibration.gainQ12, gains, sizeof(gains));
+  calibration.flags |= FLAG_SPIN;
+  return FitStatus::OK;
+}
+
+void AmbientCheck::add(const uint16_t (&raw)[CHANNELS]) {
+  for (uint8_t i = 0; i < CHANNELS; ++i) {
+    sum_[i] += raw[i];
+  }
+  count_++;
+}
+
+void AmbientCheck::reset() { *this = AmbientCheck(); }
+
+uint32_t AmbientCheck::samples() const { return count_; }
+
+void AmbientCheck::rawMean(uint16_t (&mean)[CHANNELS]) const {
+  for (uint8_t i = 0; i < CHANNELS; ++i) {
+    mean[i] = count_ == 0 ? 0
+                          : static_cast<uint16_t>((sum_[i] + count_ / 2) /
+                                                  count_);
+  }
+}
+
+uint16_t AmbientCheck::level(const Calibration &calibration,
+                             uint8_t channel) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  const uint32_t raw =
+      static_cast<uint32_t>((sum_[channel] + count_ / 2) / count_);
+  const uint32_t calibrated = apply(raw, calibration.offset[channel],
+                                    calibration.gainQ12[channel]);
+  return static_cast<uint16_t>(calibrated > UINT16_MAX ? UINT16_MAX
+                                                       : calibrated);
+}
+
+FitStatus AmbientCheck::fit(Calibration &calibration) const {
+  if (count_ < MIN_AMBIENT_SAMPLES) {
+    return FitStatus::TOO_FEW_SAMPLES;
+  }
+  uint16_t levels[CHANNELS];
+  uint16_t lowest = UINT16_MAX;
+  uint16_t highest = 0;
+  for (uint8_t i = 0; i < CHANNELS; ++i) {
+    levels[i] = level(calibration, i);
+    lowest = levels[i] < lowest ? levels[i] : lowest;
+    highest = levels[i] > highest ? levels[i] : highest;
+  }
+  if (highest > MAX_AMBIENT) {
+    return FitStatus::AMBIENT_HIGH;
+  }
+  if (highest - lowest > MAX_AMBIENT_SPREAD) {
+    return FitStatus::AMBIENT_UNEVEN;
+  }
+  std::memcpy(calibration.ambient, levels, sizeof(levels));
+  calibration.flags |= FLAG_AMBIENT;
+  return FitStatus::OK;
+}
+} // namespace ir_calibration
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Per-channel calibration of the four IR phototransistors (front, back,
+// left, right). Each channel gets a dark offset and a gain that equalizes
+// its on-axis response to the beacon:
+//
+//   amplitude = max(raw - offset, 0) * gainQ12 / 4096
+//
+// Everything is stored as integers so a calibration can be kept in NVS as
+// is and applied without float math. It is fitted in three captures, each
+// fed one raw sample per control tick, in this order:
+//
+//   DarkCapture   sensors covered (or a dark room, beacon off) -> offsets
+//   AmbientCheck  room light on, beacon off -> ambient per channel
+//   SpinCapture   one or more full turns close to the beacon -> gains
+//
+// The spin measures each channel against its beacon-off level from the
+// ambient check, so room light does not dilute the beacon response.
+namespace ir_calibration {
+constexpr uint8_t CHANNELS = 4;
+constexpr uint8_t GAIN_FRACTION_BITS = 12;
+constexpr uint16_t GAIN_ONE = 1U << GAIN_FRACTION_BITS;
+constexpr uint16_t ADC_MAX = 4095;
+
+enum Flags : uint8_t {
+  // Offsets come from a dark capture.
+  FLAG_DARK = 1U << 0,
+  // Gains come from a spin.
+  FLAG_SPIN = 1U << 1,
+  // Ambient levels come from an ambient check.
+  FLAG_AMBIENT = 1U << 2,
+};
+
+struct Calibration {
+  uint16_t offset[CHANNELS] = {0, 0, 0, 0};
+  uint16_t gainQ12[CHANNELS] = {GAIN_ONE, GAIN_ONE, GAIN_ONE, GAIN_ONE};
+  // Calibrated room light per channel with the beacon off.
+  uint16_t ambient[CHANNELS] = {0, 0, 0, 0};
+  uint8_t flags = 0;
+};
+
+inline uint32_t apply(uint32_t raw, uint16_t offset, uint16_t gainQ12) {
+  const uint32_t counts = raw > offset ? raw - offset : 0;
+  return (counts * gainQ12 + (GAIN_ONE / 2)) >> GAIN_FRACTION_BITS;
+}
+
+// Versioned little-endian record: version, flags, then offset, gainQ12 and
+// ambient per channel as u16.
+constexpr uint8_t RECORD_VERSION = 1;
+constexpr size_t RECORD_SIZE = 2 + 3 * CHANNELS * 2;
+
+void encode(const Calibration &calibration, uint8_t (&record)[RECORD_SIZE]);
+// Returns false for a record of another version.
+bool decode(const uint8_t (&record)[RECORD_SIZE], Calibration &calibration);
+
+enum class FitStatus : uint8_t {
+  OK,
+  TOO_FEW_SAMPLES,
+  // Dark capture: a channel reads too high to be covered.
+  NOT_DARK,
+  // Dark capture: a channel moved too much; light leaking in or a loose
+  // cover.
+  NOISY,
+  // Spin: a channel hit the ADC ceiling; start further from the beacon.
+  SATURATED,
+  // Spin: the weakest channel peak is too low to fit a gain; start closer.
+  WEAK_SIGNAL,
+  // Spin: some channel never faced the beacon.
+  INCOMPLETE_SPIN,
+  // Spin: a gain outside [MIN_GAIN, MAX_GAIN]; a sensor is likely broken or
+  // blocked.
+  GAIN_OUT_OF_RANGE,
+  // Ambient: the room light uses up too much of the ADC range.
+  AMBIENT_HIGH,
+  // Ambient: the channels see very different room light, which biases the
+  // bearing toward the light source.
+  AMBIENT_UNEVEN,
+};
+
+const char *fitStatusName(FitStatus status);
+
+constexpr uint32_t MIN_DARK_SAMPLES = 50;
+constexpr uint16_t MAX_DARK_OFFSET = 600;
+constexpr float MAX_DARK_NOISE = 40.0f;
+
+constexpr uint32_t MIN_SPIN_SAMPLES = 150;
+// The gain equalizes this percentile of each channel's response over the
+// spin, i.e. the top ~18 degrees around its axis, so one noisy sample or
+// a reflection does not set the gain.
+constexpr float SPIN_PEAK_PERCENTILE = 0.95f;
+constexpr uint16_t SPIN_SATURATION_RAW = 4080;
+constexpr float MAX_SATURATED_SHARE = 0.01f;
+constexpr uint16_t MIN_SPIN_PEAK = 200;
+// Each channel must be the strongest for at least this share of the spin.
+constexpr float MIN_DOMINANT_SHARE = 0.10f;
+constexpr float MIN_GAIN = 0.5f;
+constexpr float MAX_GAIN = 2.0f;
+
+constexpr uint32_t MIN_AMBIENT_SAMPLES = 50;
+constexpr uint16_t MAX_AMBIENT = 2000;
+constexpr uint16_t MAX_AMBIENT_SPREAD = 400;
+
+class DarkCapture {
+public:
+  void add(const uint16_t (&raw)[CHANNELS]);
+  void reset();
+
+  uint32_t samples() const;
+  float mean(uint8_t channel) const;
+  float noise(uint8_t channel) const;
+  // Sets the offsets and FLAG_DARK on success; leaves `calibration` alone
+  // otherwise.
+  FitStatus fit(Calibration &calibration) const;
+
+private:
+  uint32_t count_ = 0;
+  uint64_t sum_[CHANNELS] = {0, 0, 0, 0};
+  uint64_t sumSquares_[CHANNELS] = {0, 0, 0, 0};
+};
+
+// Keeps a histogram of raw - baseline per channel and pivot wheel (16-count
+// bins, 4 KiB), so spins of any length fit in fixed memory. The baseline is
+// the raw beacon-off level of each channel.
+//
+// Pivoting on one wheel carries the sensors on the far side closer to the
+// beacon when they face it, which reads as extra gain. Pivoting on the
+// other wheel reverses that, so the peaks of the two pivots are combined by
+// their geometric mean.
+class SpinCapture {
+public:
+  static constexpr uint8_t PIVOTS = 2;
+
+  SpinCapture();
+
+  void add(const uint16_t (&raw)[CHANNELS], uint8_t pivot = 0);
+  void reset(const uint16_t (&baseline)[CHANNELS]);
+
+  uint32_t samples() const;
+  // SPIN_PEAK_PERCENTILE of raw - baseline, in counts, combined over the
+  // pivots that have samples.
+  float peak(uint8_t channel) const;
+  float dominantShare(uint8_t channel) const;
+  float saturatedShare() const;
+  // Sets the gains, scaled so their mean is one, and FLAG_SPIN on success.
+  // Stored ambient levels are rescaled to the new gains.
+  FitStatus fit(Calibration &calibration) const;
+
+private:
+  static constexpr uint8_t BIN_SHIFT = 4;
+  static constexpr uint16_t BINS = (ADC_MAX >> BIN_SHIFT) + 1;
+
+  float pivotPeak(uint8_t pivot, uint8_t channel) const;
+
+  uint16_t baseline_[CHANNELS];
+  uint16_t histogram_[PIVOTS][CHANNELS][BINS];
+  uint32_t count_ = 0;
+  uint32_t dominant_[CHANNELS] = {0, 0, 0, 0};
+  uint32_t saturated_ = 0;
+};
+
+class AmbientCheck {
+public:
+  void add(const uint16_t (&raw)[CHANNELS]);
+  void reset();
+
+  uint32_t samples() const;
+  // Mean raw level of each channel, the baseline for a SpinCapture.
+  void rawMean(uint16_t (&mean)[CHANNELS]) const;
+  // Mean calibrated level of `channel` under `calibration`.
+  uint16_t level(const Calibration &calibration, uint8_t channel) const;
+  // Sets the ambient levels and FLAG_AMBIENT when the room light is low and
+  // even enough to navigate in.
+  FitStatus fit(Calibration &calibration) const;
+
+private:
+  uint32_t count_ = 0;
+  uint64_t sum_[CHANNELS] = {0, 0, 0, 0};
+};
+} // namespace ir_calibration
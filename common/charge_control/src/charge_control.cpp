@@ -0,0 +1,224 @@
+#include "charge_control.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace charge_control {
+namespace {
+constexpr uint8_t HALF_WINDOW = WINDOW_SLOTS / 2;
+
+uint32_t remainingOf(uint32_t limitMs, uint32_t elapsedMs) {
+  return elapsedMs < limitMs ? limitMs - elapsedMs : 0;
+}
+
+size_t finish(int written, size_t size) {
+  return written > 0 && static_cast<size_t>(written) < size
+             ? static_cast<size_t>(written)
+             : 0;
+}
+} // namespace
+
+const char *endReasonName(EndReason reason) {
+  switch (reason) {
+  case EndReason::NONE:
+    return "none";
+  case EndReason::TARGET:
+    return "target";
+  case EndReason::PLATEAU:
+    return "plateau";
+  case EndReason::TIME_LIMIT:
+    return "time_limit";
+  case EndReason::NO_GAUGE:
+    return "no_gauge";
+  }
+  return "unknown";
+}
+
+ChargeTerminator::ChargeTerminator(const ChargeConfig &config)
+    : config_(config) {}
+
+void ChargeTerminator::begin(uint32_t now) {
+  startedMs_ = now;
+  started_ = true;
+  reason_ = EndReason::NONE;
+  filteredMv_ = 0.0f;
+  haveSample_ = false;
+  startMv_ = 0;
+  windowCount_ = 0;
+  windowHead_ = 0;
+}
+
+bool ChargeTerminator::update(uint32_t now, uint16_t batteryMv) {
+  if (!started_) {
+    begin(now);
+  }
+  if (done()) {
+    return true;
+  }
+  const uint32_t elapsed = elapsedMs(now);
+
+  if (batteryMv >= config_.minValidMv) {
+    if (!haveSample_) {
+      filteredMv_ = static_cast<float>(batteryMv);
+      startMv_ = batteryMv;
+      haveSample_ = true;
+    } else {
+      filteredMv_ += config_.filterAlpha *
+                     (static_cast<float>(batteryMv) - filteredMv_);
+    }
+    if (windowCount_ == 0 || now - slot(0).atMs >= slotSpacingMs()) {
+      window_[windowHead_] = Slot{filteredMv_, now};
+      windowHead_ = (windowHead_ + 1) % (WINDOW_SLOTS + 1);
+      if (windowCount_ < WINDOW_SLOTS + 1) {
+        windowCount_++;
+      }
+    }
+  }
+
+  if (elapsed >= config_.maxChargeMs) {
+    end(EndReason::TIME_LIMIT);
+  } else if (!haveSample_) {
+    if (elapsed >= config_.noGaugeChargeMs) {
+      end(EndReason::NO_GAUGE);
+    }
+  } else if (elapsed >= config_.minChargeMs) {
+    if (config_.targetMv != 0 && filteredMv_ >= config_.targetMv) {
+      end(EndReason::TARGET);
+    } else if (windowCount_ == WINDOW_SLOTS + 1 &&
+               windowRiseMv() < config_.plateauRiseMv) {
+      end(EndReason::PLATEAU);
+    }
+  }
+  return done();
+}
+
+uint32_t ChargeTerminator::elapsedMs(uint32_t now) const {
+  return started_ ? now - startedMs_ : 0;
+}
+
+uint16_t ChargeTerminator::filteredMv() const {
+  return haveSample_ ? static_cast<uint16_t>(filteredMv_ + 0.5f) : 0;
+}
+
+int32_t ChargeTerminator::windowRiseMv() const {
+  if (windowCount_ < 2) {
+    return 0;
+  }
+  return static_cast<int32_t>(
+      std::lround(slot(0).mv - slot(windowCount_ - 1).mv));
+}
+
+uint32_t ChargeTerminator::remainingMs(uint32_t now) const {
+  const uint32_t elapsed = elapsedMs(now);
+  if (done()) {
+    return 0;
+  }
+  if (!haveSample_) {
+    // Either a reading turns up or the fixed charge runs out.
+    return elapsed < config_.noGaugeChargeMs / 2
+               ? REMAINING_UNKNOWN
+               : remainingOf(config_.noGaugeChargeMs, elapsed);
+  }
+  if (windowCount_ < HALF_WINDOW + 1) {
+    return REMAINING_UNKNOWN;
+  }
+
+  const float halfMs =
+      static_cast<float>(slot(0).atMs - slot(HALF_WINDOW).atMs);
+  // Rise over the newest half window, and the half before it.
+  const float newer = slot(0).mv - slot(HALF_WINDOW).mv;
+  float estimateMs = -1.0f;
+
+  if (config_.targetMv != 0 && newer > 0.0f) {
+    const float toTarget = static_cast<float>(config_.targetMv) - filteredMv_;
+    estimateMs = toTarget > 0.0f ? toTarget / newer * halfMs : 0.0f;
+  }
+  if (windowCount_ == WINDOW_SLOTS + 1) {
+    // The rise slows down by about the same ratio every half window once
+    // the charger holds its voltage; the plateau is where two halves in a
+    // row add up to less than the threshold.
+    const float older = slot(HALF_WINDOW).mv - slot(WINDOW_SLOTS).mv;
+    const float threshold = static_cast<float>(config_.plateauRiseMv);
+    float plateauMs = -1.0f;
+    if (newer <= 0.0f) {
+      plateauMs = halfMs;
+    } else if (older > newer) {
+      const float ratio = newer / older;
+      const float halves =
+          1.0f + std::log(threshold / (newer * (1.0f + ratio))) /
+                     std::log(ratio);
+      plateauMs = (halves > 1.0f ? halves : 1.0f) * halfMs;
+    }
+    if (plateauMs >= 0.0f && (estimateMs < 0.0f || plateauMs < estimateMs)) {
+      estimateMs = plateauMs;
+    }
+  }
+  if (estimateMs < 0.0f) {
+    return REMAINING_UNKNOWN;
+  }
+
+  uint32_t remaining = remainingOf(config_.maxChargeMs, elapsed);
+  if (estimateMs < static_cast<float>(remaining)) {
+    remaining = static_cast<uint32_t>(estimateMs);
+  }
+  const uint32_t settle = remainingOf(config_.minChargeMs, elapsed);
+  return remaining > settle ? remaining : settle;
+}
+
+uint8_t ChargeTerminator::progressPercent(uint32_t now) const {
+  if (done()) {
+    return 100;
+  }
+  const uint32_t remaining = remainingMs(now);
+  if (remaining == REMAINING_UNKNOWN) {
+    return PROGRESS_UNKNOWN;
+  }
+  const uint64_t elapsed = elapsedMs(now);
+  const uint64_t total = elapsed + remaining;
+  return total == 0 ? 100 : static_cast<uint8_t>(elapsed * 100U / total);
+}
+
+const ChargeTerminator::Slot &ChargeTerminator::slot(uint8_t back) const {
+  const uint8_t slots = WINDOW_SLOTS + 1;
+  return window_[(windowHead_ + slots - 1 - back) % slots];
+}
+
+uint32_t ChargeTerminator::slotSpacingMs() const {
+  const uint32_t spacing = config_.plateauWindowMs / WINDOW_SLOTS;
+  return spacing > 0 ? spacing : 1;
+}
+
+void ChargeTerminator::end(EndReason reason) { reason_ = reason; }
+
+size_t formatProgress(const ChargeTerminator &charge, uint32_t now,
+                      char *out, size_t size) {
+  const uint32_t remaining = charge.remainingMs(now);
+  const uint8_t percent = charge.progressPercent(now);
+  char remainingText[12] = "-";
+  char percentText[4] = "-";
+  if (remaining != REMAINING_UNKNOWN) {
+    snprintf(remainingText, sizeof(remainingText), "%lu",
+             static_cast<unsigned long>(remaining));
+  }
+  if (percent != PROGRESS_UNKNOWN) {
+    snprintf(percentText, sizeof(percentText), "%u",
+             static_cast<unsigned>(percent));
+  }
+  return finish(snprintf(out, size, "charge,%lu,%u,%ld,%s,%s\n",
+                         static_cast<unsigned long>(charge.elapsedMs(now)),
+                         static_cast<unsigned>(charge.filteredMv()),
+                         static_cast<long>(charge.windowRiseMv()),
+                         remainingText, percentText),
+                size);
+}
+
+size_t formatEnd(const ChargeTerminator &charge, uint32_t now, char *out,
+                 size_t size) {
+  return finish(snprintf(out, size, "charge_end,%s,%lu,%u,%u\n",
+                         endReasonName(charge.reason()),
+                         static_cast<unsigned long>(charge.elapsedMs(now)),
+                         static_cast<unsigned>(charge.startMv()),
+                         static_cast<unsigned>(charge.filteredMv())),
+                size);
+}
+} // namespace charge_control
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Ends a slave's charge from its battery voltage instead of after a fixed
+// time, so a robot that arrives nearly full leaves the bay again at once
+// and one that arrives flat gets a full charge.
+//
+// The slave samples the battery through the charger. During constant
+// current the voltage climbs; once the charger holds its constant voltage
+// the reading flattens out and the rest of the charge is the slow taper.
+// The charge ends on whichever comes first:
+// - the filtered voltage reaches `targetMv`;
+// - a plateau: it rose less than `plateauRiseMv` over the last
+//   `plateauWindowMs`;
+// - `maxChargeMs`, as a limit;
+// - `noGaugeChargeMs` without a single valid reading: no gauge is wired,
+//   and the old fixed charge applies.
+// Nothing but the time limit ends a charge before `minChargeMs`, while the
+// contacts settle.
+//
+// From the same window it estimates the time left, for the heartbeat and
+// the station's scheduling: to the target at the current slope, or to the
+// plateau, from how fast the rise is slowing down.
+namespace charge_control {
+constexpr uint32_t REMAINING_UNKNOWN = 0xFFFFFFFF;
+constexpr uint8_t PROGRESS_UNKNOWN = 0xFF;
+// Slots of the slope window; the estimate compares its two halves.
+constexpr uint8_t WINDOW_SLOTS = 8;
+
+struct ChargeConfig {
+  uint32_t samplePeriodMs = 500;
+  // 0: no target, only the plateau ends the charge.
+  uint16_t targetMv = 4150;
+  uint32_t plateauWindowMs = 10000;
+  uint16_t plateauRiseMv = 5;
+  uint32_t minChargeMs = 3000;
+  uint32_t maxChargeMs = 120000;
+  uint32_t noGaugeChargeMs = 15000;
+  // Readings below this are no battery (an open sense input).
+  uint16_t minValidMv = 2500;
+  // Exponential filter over the samples, 0..1.
+  float filterAlpha = 0.4f;
+};
+
+enum class EndReason : uint8_t {
+  NONE,
+  TARGET,
+  PLATEAU,
+  TIME_LIMIT,
+  NO_GAUGE
+};
+const char *endReasonName(EndReason reason);
+
+class ChargeTerminator {
+public:
+  explicit ChargeTerminator(const ChargeConfig &config = ChargeConfig());
+
+  // The slave is on the charger.
+  void begin(uint32_t now);
+  // One battery sample, 0 if there is none; returns true once the charge
+  // is to end, and keeps returning true.
+  bool update(uint32_t now, uint16_t batteryMv);
+
+  bool done() const { return reason_ != EndReason::NONE; }
+  EndReason reason() const { return reason_; }
+  const ChargeConfig &config() const { return config_; }
+  uint32_t elapsedMs(uint32_t now) const;
+  // Filtered voltage, 0 before the first valid sample.
+  uint16_t filteredMv() const;
+  uint16_t startMv() const { return startMv_; }
+  // Rise over the filled part of the window.
+  int32_t windowRiseMv() const;
+  // Time until the charge ends, or REMAINING_UNKNOWN while the window has
+  // too little to go by.
+  uint32_t remainingMs(uint32_t now) const;
+  // Elapsed share of elapsed + remaining, PROGRESS_UNKNOWN without an
+  // estimate.
+  uint8_t progressPercent(uint32_t now) const;
+
+private:
+  uint32_t slotSpacingMs() const;
+  void end(EndReason reason);
+
+  ChargeConfig config_;
+  uint32_t startedMs_ = 0;
+  bool started_ = false;
+  EndReason reason_ = EndReason::NONE;
+  float filteredMv_ = 0.0f;
+  bool haveSample_ = false;
+  uint16_t startMv_ = 0;
+  struct Slot {
+    float mv;
+    uint32_t atMs;
+  };
+  const Slot &slot(uint8_t back) const;
+
+  // Filtered voltage at least slotSpacingMs() apart, a ring.
+  Slot window_[WINDOW_SLOTS + 1] = {};
+  uint8_t windowCount_ = 0;
+  uint8_t windowHead_ = 0;
+};
+
+// `charge,<elapsed_ms>,<filtered_mv>,<window_rise_mv>,<remaining_ms|->,
+// <percent|->`
+size_t formatProgress(const ChargeTerminator &charge, uint32_t now,
+                      char *out, size_t size);
+// `charge_end,<reason>,<elapsed_ms>,<start_mv>,<end_mv>`
+size_t formatEnd(const ChargeTerminator &charge, uint32_t now, char *out,
+                 size_t size);
+} // namespace charge_control
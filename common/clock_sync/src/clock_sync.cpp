@@ -0,0 +1,305 @@
+#include "clock_sync.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+bool startsWith(const char *text, const char *prefix, const char *&rest) {
+  const size_t length = strlen(prefix);
+  if (strncmp(text, prefix, length) != 0) {
+    return false;
+  }
+  rest = text + length;
+  return true;
+}
+
+// Reads one unsigned field terminated by `separator`; a line end counts as
+// the end of the message.
+bool readField(const char *&text, char separator, uint64_t &value) {
+  char *end = nullptr;
+  const unsigned long long parsed = strtoull(text, &end, 10);
+  if (end == text || *text == '-') {
+    return false;
+  }
+  if (separator == '\0' && (*end == '\r' || *end == '\n')) {
+    end += strlen(end);
+  }
+  if (*end != separator) {
+    return false;
+  }
+  value = static_cast<uint64_t>(parsed);
+  text = *end == '\0' ? end : end + 1;
+  return true;
+}
+
+bool readField32(const char *&text, char separator, uint32_t &value) {
+  uint64_t wide = 0;
+  if (!readField(text, separator, wide) || wide > UINT32_MAX) {
+    return false;
+  }
+  value = static_cast<uint32_t>(wide);
+  return true;
+}
+
+size_t written(int length, size_t size) {
+  return length > 0 && static_cast<size_t>(length) < size
+             ? static_cast<size_t>(length)
+             : 0;
+}
+
+int64_t difference(uint64_t later, uint64_t earlier) {
+  return static_cast<int64_t>(later) - static_cast<int64_t>(earlier);
+}
+} // namespace
+
+namespace clock_sync {
+
+constexpr uint8_t ClockSyncClient::WINDOW;
+constexpr uint8_t ClockSyncClient::ANCHORS;
+
+ClockSyncClient::ClockSyncClient(const ClockSyncConfig &config)
+    : config_(config) {}
+
+bool ClockSyncClient::poll(uint32_t node, uint64_t nowUs,
+                           ClockRequest &request) {
+  if (pending_) {
+    if (nowUs - pendingSentUs_ < config_.maxDelayUs) {
+      return false;
+    }
+    pending_ = false;
+    rejected_++;
+  }
+  if (nowUs < nextRequestAtUs_) {
+    return false;
+  }
+  const uint32_t periodMs = synced() ? config_.periodMs : config_.fastPeriodMs;
+  seq_++;
+  pending_ = true;
+  pendingSentUs_ = nowUs;
+  nextRequestAtUs_ = nowUs + static_cast<uint64_t>(periodMs) * 1000U;
+  request.node = node;
+  request.seq = seq_;
+  request.sentUs = nowUs;
+  return true;
+}
+
+bool ClockSyncClient::onResponse(const ClockResponse &response,
+                                 uint64_t receivedUs) {
+  // Answers to other slaves, and late answers to a request given up on.
+  if (!pending_ || response.seq != seq_ ||
+      response.requestSentUs != pendingSentUs_) {
+    return false;
+  }
+  pending_ = false;
+  if (receivedUs < pendingSentUs_ || response.sentUs < response.receivedUs) {
+    rejected_++;
+    return false;
+  }
+  const uint64_t roundTrip = receivedUs - pendingSentUs_;
+  const uint64_t held = response.sentUs - response.receivedUs;
+  if (held > roundTrip || roundTrip - held > config_.maxDelayUs) {
+    rejected_++;
+    return false;
+  }
+
+  Sample sample;
+  sample.delayUs = static_cast<uint32_t>(roundTrip - held);
+  sample.offsetUs = (difference(response.receivedUs, pendingSentUs_) +
+                     difference(response.sentUs, receivedUs)) /
+                    2;
+  sample.localUs = pendingSentUs_ + roundTrip / 2;
+  lastDelayUs_ = sample.delayUs;
+  exchanges_++;
+
+  if (synced()) {
+    const int64_t error = sample.offsetUs - offsetUs(sample.localUs);
+    if (static_cast<uint64_t>(error < 0 ? -error : error) >
+        config_.stepThresholdUs) {
+      outliers_++;
+      if (outliers_ < config_.stepConfirmations) {
+        rejected_++;
+        return false;
+      }
+      reset();
+    }
+  }
+  outliers_ = 0;
+  addSample(sample);
+  return true;
+}
+
+bool ClockSyncClient::synced() const { return count_ >= config_.minSamples; }
+
+uint64_t ClockSyncClient::toMesh(uint64_t localUs) const {
+  return static_cast<uint64_t>(static_cast<int64_t>(localUs) +
+                               offsetUs(localUs));
+}
+
+int64_t ClockSyncClient::offsetUs(uint64_t localUs) const {
+  return static_cast<int64_t>(llround(
+      intercept_ +
+      slope_ * static_cast<double>(difference(localUs, reference_))));
+}
+
+float ClockSyncClient::skewPpm() const {
+  return static_cast<float>(slope_ * 1e6);
+}
+
+uint32_t ClockSyncClient::errorUs() const { return errorUs_; }
+
+uint32_t ClockSyncClient::lastDelayUs() const { return lastDelayUs_; }
+
+uint32_t ClockSyncClient::exchanges() const { return exchanges_; }
+
+uint32_t ClockSyncClient::rejected() const { return rejected_; }
+
+void ClockSyncClient::reset() {
+  count_ = 0;
+  next_ = 0;
+  bestOf_ = 0;
+  anchorCount_ = 0;
+  nextAnchor_ = 0;
+  outliers_ = 0;
+  reference_ = 0;
+  intercept_ = 0.0;
+  slope_ = 0.0;
+  errorUs_ = 0;
+}
+
+void ClockSyncClient::addSample(const Sample &sample) {
+  samples_[next_] = sample;
+  next_ = static_cast<uint8_t>((next_ + 1) % WINDOW);
+  if (count_ < WINDOW) {
+    count_++;
+  }
+  if (bestOf_ == 0 || sample.delayUs < best_.delayUs) {
+    best_ = sample;
+  }
+  if (++bestOf_ == WINDOW) {
+    anchors_[nextAnchor_] = best_;
+    nextAnchor_ = static_cast<uint8_t>((nextAnchor_ + 1) % ANCHORS);
+    if (anchorCount_ < ANCHORS) {
+      anchorCount_++;
+    }
+    bestOf_ = 0;
+    fitDrift();
+  }
+  fitOffset();
+}
+
+// Least-squares slope through the anchors, relative to the newest one so
+// the doubles stay small. Until they span minDriftSpanMs the drift stays at
+// its last value, zero at first.
+void ClockSyncClient::fitDrift() {
+  const Sample &newest = anchors_[(nextAnchor_ + ANCHORS - 1) % ANCHORS];
+  const Sample &oldest =
+      anchors_[anchorCount_ < ANCHORS ? 0 : nextAnchor_];
+  if (difference(newest.localUs, oldest.localUs) <
+      static_cast<int64_t>(config_.minDriftSpanMs) * 1000) {
+    return;
+  }
+  double sumX = 0.0;
+  double sumY = 0.0;
+  for (uint8_t i = 0; i < anchorCount_; ++i) {
+    sumX += static_cast<double>(difference(anchors_[i].localUs,
+                                           newest.localUs));
+    sumY += static_cast<double>(anchors_[i].offsetUs - newest.offsetUs);
+  }
+  const double meanX = sumX / anchorCount_;
+  const double meanY = sumY / anchorCount_;
+  double sxx = 0.0;
+  double sxy = 0.0;
+  for (uint8_t i = 0; i < anchorCount_; ++i) {
+    const double x = static_cast<double>(difference(anchors_[i].localUs,
+                                                    newest.localUs)) -
+                     meanX;
+    const double y =
+        static_cast<double>(anchors_[i].offsetUs - newest.offsetUs) - meanY;
+    sxx += x * x;
+    sxy += x * y;
+  }
+  const double maxSlope = static_cast<double>(config_.maxSkewPpm) * 1e-6;
+  double slope = sxy / sxx;
+  slope = slope > maxSlope ? maxSlope : slope;
+  slope = slope < -maxSlope ? -maxSlope : slope;
+  slope_ = slope;
+}
+
+// Mean offset of the fast exchanges in the window, at the newest one.
+void ClockSyncClient::fitOffset() {
+  const Sample &newest = samples_[(next_ + WINDOW - 1) % WINDOW];
+  uint32_t minDelay = UINT32_MAX;
+  for (uint8_t i = 0; i < count_; ++i) {
+    if (samples_[i].delayUs < minDelay) {
+      minDelay = samples_[i].delayUs;
+    }
+  }
+  const uint64_t maxDelay =
+      static_cast<uint64_t>(minDelay) + config_.delaySlackUs;
+
+  double n = 0.0;
+  double sumY = 0.0;
+  for (uint8_t i = 0; i < count_; ++i) {
+    if (samples_[i].delayUs > maxDelay) {
+      continue;
+    }
+    const double x =
+        static_cast<double>(difference(samples_[i].localUs, newest.localUs));
+    n += 1.0;
+    // Offsets moved to the newest sample's time along the drift.
+    sumY += static_cast<double>(samples_[i].offsetUs - newest.offsetUs) -
+            slope_ * x;
+  }
+  reference_ = newest.localUs;
+  intercept_ = static_cast<double>(newest.offsetUs) + sumY / n;
+
+  double squares = 0.0;
+  for (uint8_t i = 0; i < count_; ++i) {
+    if (samples_[i].delayUs > maxDelay) {
+      continue;
+    }
+    const double residual =
+        static_cast<double>(samples_[i].offsetUs) -
+        static_cast<double>(offsetUs(samples_[i].localUs));
+    squares += residual * residual;
+  }
+  errorUs_ = minDelay / 2U + static_cast<uint32_t>(sqrt(squares / n) + 0.5);
+}
+
+size_t formatEvent(uint32_t node, uint64_t meshUs, uint32_t errorUs,
+                   const char *name, uint32_t subject, char *out,
+                   size_t size) {
+  return written(snprintf(out, size, "%s%lu,%llu,%lu,%s,%lu", EVENT_PREFIX,
+                          static_cast<unsigned long>(node),
+                          static_cast<unsigned long long>(meshUs),
+                          static_cast<unsigned long>(errorUs), name,
+                          static_cast<unsigned long>(subject)),
+                 size);
+}
+
+bool parseEvent(const char *line, Event &event) {
+  const char *text = nullptr;
+  Event parsed;
+  if (!startsWith(line, EVENT_PREFIX, text) ||
+      !readField32(text, ',', parsed.node) ||
+      !readField(text, ',', parsed.meshUs) ||
+      !readField32(text, ',', parsed.errorUs)) {
+    return false;
+  }
+  const char *comma = strchr(text, ',');
+  const size_t length = comma == nullptr ? 0 : static_cast<size_t>(comma - text);
+  if (length == 0 || length >= sizeof(parsed.name)) {
+    return false;
+  }
+  memcpy(parsed.name, text, length);
+  parsed.name[length] = '\0';
+  text = comma + 1;
+  if (!readField32(text, '\0', parsed.subject)) {
+    return false;
+  }
+  event = parsed;
+  return true;
+}
+} // namespace clock_sync
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Mesh timebase. The master's esp_timer clock (us since its boot) is the
+// reference; every slave estimates the offset and drift of its own clock
+// against it from NTP-style exchanges, so events from all nodes can be put
+// on one time axis. The exchanges are mesh broadcasts, CLOCK_REQUEST and
+// CLOCK_RESPONSE frames of common/mesh_proto:
+//
+//   request   <node>,<seq>,<t1>                 slave -> all
+//   response  <node>,<seq>,<t1>,<t2>,<t3>       master -> all
+//
+// t1 is the slave's clock when it sent the request, t2 and t3 the master's
+// when it received it and sent the answer, and t4 the slave's when the
+// answer arrived. Then
+//
+//   offset = ((t2 - t1) + (t3 - t4)) / 2,   delay = (t4 - t1) - (t3 - t2)
+//
+// and the offset is off by at most delay / 2 if the two directions take
+// different times.
+namespace clock_sync {
+struct ClockRequest {
+  uint32_t node = 0;
+  uint32_t seq = 0;
+  uint64_t sentUs = 0;
+};
+
+struct ClockResponse {
+  uint32_t node = 0;
+  uint32_t seq = 0;
+  uint64_t requestSentUs = 0;
+  uint64_t receivedUs = 0;
+  uint64_t sentUs = 0;
+};
+
+struct ClockSyncConfig {
+  // Request period once synchronized, and until then.
+  uint32_t periodMs = 2000;
+  uint32_t fastPeriodMs = 250;
+  // Synchronized after this many accepted exchanges.
+  uint8_t minSamples = 4;
+  // Exchanges slower than this round trip are dropped, and an unanswered
+  // request is given up after it.
+  uint32_t maxDelayUs = 60000;
+  // The offset only uses exchanges within this much of the fastest round
+  // trip in the window; slower ones waited in a queue on one leg.
+  uint32_t delaySlackUs = 2000;
+  // Drift is fitted once the best exchanges of past windows span this
+  // long. Mesh jitter of a millisecond or so hides drift over shorter spans.
+  uint32_t minDriftSpanMs = 60000;
+  // An offset this far from the estimate is an outlier. That many in a row
+  // mean the master restarted: the window starts over.
+  uint32_t stepThresholdUs = 50000;
+  uint8_t stepConfirmations = 3;
+  // Fitted drift is clamped to this; crystals stay within tens of ppm.
+  float maxSkewPpm = 100.0f;
+};
+
+// Runs on a slave. Sends one request at a time. The offset comes from the
+// last WINDOW exchanges, the drift from the fastest exchange of each of the
+// last ANCHORS windows, so the estimate holds between exchanges and across
+// the seconds the slave state machine blocks.
+class ClockSyncClient {
+public:
+  static constexpr uint8_t WINDOW = 8;
+  static constexpr uint8_t ANCHORS = 8;
+
+  explicit ClockSyncClient(const ClockSyncConfig &config = ClockSyncConfig());
+
+  // Returns true with `request` filled when one is due at nowUs.
+  bool poll(uint32_t node, uint64_t nowUs, ClockRequest &request);
+  // Returns true when the exchange was used. receivedUs is this node's
+  // clock when the response arrived, not when it is handled.
+  bool onResponse(const ClockResponse &response, uint64_t receivedUs);
+
+  bool synced() const;
+  // Mesh time for a time of this node's clock.
+  uint64_t toMesh(uint64_t localUs) const;
+  int64_t offsetUs(uint64_t localUs) const;
+  float skewPpm() const;
+  // Bound on the error of toMesh(): half the fastest round trip in the
+  // window plus the spread of the fit.
+  uint32_t errorUs() const;
+  uint32_t lastDelayUs() const;
+  uint32_t exchanges() const;
+  uint32_t rejected() const;
+  void reset();
+
+private:
+  struct Sample {
+    uint64_t localUs;
+    int64_t offsetUs;
+    uint32_t delayUs;
+  };
+
+  void addSample(const Sample &sample);
+  void fitDrift();
+  void fitOffset();
+
+  ClockSyncConfig config_;
+  Sample samples_[WINDOW];
+  uint8_t count_ = 0;
+  uint8_t next_ = 0;
+  // Fastest exchange of the window being filled, and of past ones.
+  Sample best_;
+  uint8_t bestOf_ = 0;
+  Sample anchors_[ANCHORS];
+  uint8_t anchorCount_ = 0;
+  uint8_t nextAnchor_ = 0;
+  uint8_t outliers_ = 0;
+  bool pending_ = false;
+  uint32_t seq_ = 0;
+  uint64_t pendingSentUs_ = 0;
+  uint64_t nextRequestAtUs_ = 0;
+  // offset(local) = intercept_ + slope_ * (local - reference_)
+  uint64_t reference_ = 0;
+  double intercept_ = 0.0;
+  double slope_ = 0.0;
+  uint32_t errorUs_ = 0;
+  uint32_t lastDelayUs_ = 0;
+  uint32_t exchanges_ = 0;
+  uint32_t rejected_ = 0;
+};
+
+// Charging-cycle milestones in the mesh timebase, one per line:
+//
+//   evt,<node>,<mesh_us>,<err_us>,<name>,<subject>
+//
+// `node` stamped the event, `subject` is the slave it is about (the
+// master's enjoin/cancel name the slave they are for).
+constexpr const char *EVENT_PREFIX = "evt,";
+constexpr size_t EVENT_NAME_CAPACITY = 24;
+constexpr size_t EVENT_CAPACITY = 96;
+
+struct Event {
+  uint32_t node = 0;
+  uint64_t meshUs = 0;
+  uint32_t errorUs = 0;
+  char name[EVENT_NAME_CAPACITY] = {};
+  uint32_t subject = 0;
+};
+
+// Returns the length written, 0 if it does not fit.
+size_t formatEvent(uint32_t node, uint64_t meshUs, uint32_t errorUs,
+                   const char *name, uint32_t subject, char *out,
+                   size_t size);
+// Accepts the line with or without a trailing newline.
+bool parseEvent(const char *line, Event &event);
+} // namespace clock_sync
@@ -1,13 +1,17 @@
 #pragma once
 
-#include <cstddef>
+#include "window_filters.h"
+
 #include <cstdint>
 
 class IRValue {
+  static constexpr uint8_t averagePeriod = 4;
+
   uint32_t value = 0;
   uint8_t counter = 0;
   uint8_t maxCounter = 5;
   uint32_t minThreshold = 20;
+  window_filters::MovingAverage<uint32_t, averagePeriod, 1> averageBuffer;
 
 public:
   IRValue() {}
@@ -20,11 +24,14 @@ public:
         counter++;
         return value;
       }
-    } else {
-      counter = 0;
     }
+    counter = 0;
 
-    value = v;
+    const uint32_t sample[1] = {v};
+    averageBuffer.push(sample);
+    uint32_t average[1];
+    averageBuffer.average(average);
+    value = average[0];
     return value;
   }
 
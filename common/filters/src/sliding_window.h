@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// O(1) statistics over the last Capacity samples of a stream.
+namespace window_filters {
+
+// Sliding minimum and maximum with two monotonic deques kept in fixed rings.
+// Each entry carries its sample number so it expires once it falls out of
+// the window. Every sample enters and leaves each deque at most once, so
+// push is amortized O(1) and min/max are O(1).
+template <typename T, size_t Capacity> class SlidingMinMax {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "SlidingMinMax capacity must be a power of two");
+
+public:
+  void push(T value) {
+    const uint32_t sample = pushed_++;
+    lows_.expire(sample);
+    highs_.expire(sample);
+    while (!lows_.empty() && !(lows_.back().value < value)) {
+      lows_.popBack();
+    }
+    while (!highs_.empty() && !(value < highs_.back().value)) {
+      highs_.popBack();
+    }
+    lows_.pushBack(value, sample);
+    highs_.pushBack(value, sample);
+  }
+
+  bool empty() const { return pushed_ == 0; }
+  // Samples currently in the window.
+  size_t size() const { return pushed_ < Capacity ? pushed_ : Capacity; }
+  bool full() const { return pushed_ >= Capacity; }
+  T min() const { return lows_.front().value; }
+  T max() const { return highs_.front().value; }
+
+  void reset() { *this = SlidingMinMax(); }
+
+private:
+  struct Entry {
+    T value;
+    uint32_t sample;
+  };
+
+  class Deque {
+  public:
+    bool empty() const { return head_ == tail_; }
+    const Entry &front() const { return entries_[head_ & (Capacity - 1)]; }
+    const Entry &back() const { return entries_[(tail_ - 1) & (Capacity - 1)]; }
+    void popBack() { tail_--; }
+    void pushBack(T value, uint32_t sample) {
+      Entry &entry = entries_[tail_ & (Capacity - 1)];
+      entry.value = value;
+      entry.sample = sample;
+      tail_++;
+    }
+    // Drops the front entry once `sample` pushes it out of the window; at
+    // most one entry can expire per push.
+    void expire(uint32_t sample) {
+      if (!empty() && sample - front().sample >= Capacity) {
+        head_++;
+      }
+    }
+
+  private:
+    Entry entries_[Capacity] = {};
+    uint32_t head_ = 0;
+    uint32_t tail_ = 0;
+  };
+
+  Deque lows_;
+  Deque highs_;
+  uint32_t pushed_ = 0;
+};
+
+// Sliding mean and variance of integer samples. Sums are kept exactly in
+// 64 bits, so they never drift however long the stream runs.
+template <size_t Capacity> class SlidingMoments {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "SlidingMoments capacity must be a power of two");
+
+public:
+  void push(int32_t value) {
+    const int64_t old = values_[index_];
+    sum_ += value - old;
+    sumSquares_ += static_cast<int64_t>(value) * value - old * old;
+    values_[index_] = value;
+    index_ = (index_ + 1) & (Capacity - 1);
+    if (count_ < Capacity) {
+      count_++;
+    }
+  }
+
+  size_t size() const { return count_; }
+
+  float mean() const {
+    return count_ == 0 ? 0.0f
+                       : static_cast<float>(static_cast<double>(sum_) /
+                                            static_cast<double>(count_));
+  }
+
+  float variance() const {
+    if (count_ < 2) {
+      return 0.0f;
+    }
+    const double n = static_cast<double>(count_);
+    const double centered = static_cast<double>(sumSquares_) -
+                            static_cast<double>(sum_) *
+                                static_cast<double>(sum_) / n;
+    return centered > 0.0 ? static_cast<float>(centered / (n - 1.0)) : 0.0f;
+  }
+
+  void reset() { *this = SlidingMoments(); }
+
+private:
+  int32_t values_[Capacity] = {};
+  int64_t sum_ = 0;
+  int64_t sumSquares_ = 0;
+  size_t index_ = 0;
+  size_t count_ = 0;
+};
+} // namespace window_filters
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Fixed-window filters for the IR channels. Every filter runs `Lanes`
+// channels side by side (the tracker uses four: front, back, left, right)
+// and stores its window lane-minor, so each step is a short loop over the
+// lanes made of min/max and selects only. That maps onto MINU/MAXU on the
+// ESP32-S3 and onto packed min/max on the host, without data-dependent
+// branches.
+namespace window_filters {
+
+// Lane-wise compare-exchange: a receives the minimum, b the maximum.
+template <typename T, size_t Lanes>
+inline void compareExchange(T (&a)[Lanes], T (&b)[Lanes]) {
+  for (size_t lane = 0; lane < Lanes; ++lane) {
+    const T low = a[lane] < b[lane] ? a[lane] : b[lane];
+    const T high = a[lane] < b[lane] ? b[lane] : a[lane];
+    a[lane] = low;
+    b[lane] = high;
+  }
+}
+
+// Median selection networks (Paeth, Devillard): only the exchanges that
+// decide the middle element are kept, 3/7/13/19 for N = 3/5/7/9. The rows
+// are permuted in place and row N / 2 ends up holding the median.
+template <size_t N> struct MedianNetwork;
+
+template <> struct MedianNetwork<3> {
+  template <typename T, size_t Lanes> static void select(T (&v)[3][Lanes]) {
+    compareExchange(v[0], v[1]);
+    compareExchange(v[1], v[2]);
+    compareExchange(v[0], v[1]);
+  }
+};
+
+template <> struct MedianNetwork<5> {
+  template <typename T, size_t Lanes> static void select(T (&v)[5][Lanes]) {
+    compareExchange(v[0], v[1]);
+    compareExchange(v[3], v[4]);
+    compareExchange(v[0], v[3]);
+    compareExchange(v[1], v[4]);
+    compareExchange(v[1], v[2]);
+    compareExchange(v[2], v[3]);
+    compareExchange(v[1], v[2]);
+  }
+};
+
+template <> struct MedianNetwork<7> {
+  template <typename T, size_t Lanes> static void select(T (&v)[7][Lanes]) {
+    compareExchange(v[0], v[5]);
+    compareExchange(v[0], v[3]);
+    compareExchange(v[1], v[6]);
+    compareExchange(v[2], v[4]);
+    compareExchange(v[0], v[1]);
+    compareExchange(v[3], v[5]);
+    compareExchange(v[2], v[6]);
+    compareExchange(v[2], v[3]);
+    compareExchange(v[3], v[6]);
+    compareExchange(v[4], v[5]);
+    compareExchange(v[1], v[4]);
+    compareExchange(v[1], v[3]);
+    compareExchange(v[3], v[4]);
+  }
+};
+
+template <> struct MedianNetwork<9> {
+  template <typename T, size_t Lanes> static void select(T (&v)[9][Lanes]) {
+    compareExchange(v[1], v[2]);
+    compareExchange(v[4], v[5]);
+    compareExchange(v[7], v[8]);
+    compareExchange(v[0], v[1]);
+    compareExchange(v[3], v[4]);
+    compareExchange(v[6], v[7]);
+    compareExchange(v[1], v[2]);
+    compareExchange(v[4], v[5]);
+    compareExchange(v[7], v[8]);
+    compareExchange(v[0], v[3]);
+    compareExchange(v[5], v[8]);
+    compareExchange(v[4], v[7]);
+    compareExchange(v[3], v[6]);
+    compareExchange(v[1], v[4]);
+    compareExchange(v[2], v[5]);
+    compareExchange(v[4], v[7]);
+    compareExchange(v[4], v[2]);
+    compareExchange(v[6], v[4]);
+    compareExchange(v[4], v[2]);
+  }
+};
+
+// Lane-wise median of the N rows of `window`, which is left untouched.
+template <size_t N, typename T, size_t Lanes>
+inline void median(const T (&window)[N][Lanes], T (&out)[Lanes]) {
+  T scratch[N][Lanes];
+  for (size_t row = 0; row < N; ++row) {
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+      scratch[row][lane] = window[row][lane];
+    }
+  }
+  MedianNetwork<N>::select(scratch);
+  for (size_t lane = 0; lane < Lanes; ++lane) {
+    out[lane] = scratch[N / 2][lane];
+  }
+}
+
+template <typename T> inline T absoluteDifference(T a, T b) {
+  return a < b ? b - a : a - b;
+}
+
+// Sliding median over the last N samples. Until the window has filled the
+// input is passed through, so the filter adds no start-up transient. Delays
+// steps by N / 2 samples and removes runs of up to N / 2 outliers.
+template <typename T, size_t N, size_t Lanes = 4> class MedianFilter {
+  static_assert(N == 3 || N == 5 || N == 7 || N == 9,
+                "MedianFilter supports windows of 3, 5, 7 or 9 samples");
+
+public:
+  void push(const T (&in)[Lanes], T (&out)[Lanes]) {
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+      window_[index_][lane] = in[lane];
+    }
+    index_ = static_cast<uint8_t>(index_ + 1U == N ? 0U : index_ + 1U);
+
+    if (count_ < N) {
+      count_++;
+    }
+    if (count_ < N) {
+      for (size_t lane = 0; lane < Lanes; ++lane) {
+        out[lane] = in[lane];
+      }
+      return;
+    }
+    median(window_, out);
+  }
+
+  void reset() { *this = MedianFilter(); }
+
+private:
+  T window_[N][Lanes] = {};
+  uint8_t index_ = 0;
+  uint8_t count_ = 0;
+};
+
+// 3 * 1.4826 in Q8: the usual Hampel threshold of three standard deviations,
+// with the MAD scaled to a Gaussian sigma.
+constexpr uint16_t HAMPEL_DEFAULT_THRESHOLD_Q8 = 1139;
+
+// Causal Hampel identifier over the last N samples (including the new one).
+// A sample further than threshold * MAD from the window median, and further
+// than `minDeviation`, is replaced by the median; every other sample passes
+// through undelayed. The floor keeps a perfectly flat window (MAD = 0) from
+// flagging the first bit of noise.
+template <typename T, size_t N, size_t Lanes = 4> class HampelFilter {
+  static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value,
+                "HampelFilter works on unsigned ADC counts");
+
+public:
+  explicit HampelFilter(uint16_t thresholdQ8 = HAMPEL_DEFAULT_THRESHOLD_Q8,
+                        T minDeviation = 0)
+      : thresholdQ8_(thresholdQ8), minDeviation_(minDeviation) {}
+
+  void push(const T (&in)[Lanes], T (&out)[Lanes]) {
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+      window_[index_][lane] = in[lane];
+    }
+    index_ = static_cast<uint8_t>(index_ + 1U == N ? 0U : index_ + 1U);
+
+    if (count_ < N) {
+      count_++;
+    }
+    if (count_ < N) {
+      for (size_t lane = 0; lane < Lanes; ++lane) {
+        out[lane] = in[lane];
+      }
+      return;
+    }
+
+    T center[Lanes];
+    median(window_, center);
+    T deviations[N][Lanes];
+    for (size_t row = 0; row < N; ++row) {
+      for (size_t lane = 0; lane < Lanes; ++lane) {
+        deviations[row][lane] = absoluteDifference(window_[row][lane],
+                                                   center[lane]);
+      }
+    }
+    T mad[Lanes];
+    median(deviations, mad);
+
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+      const uint64_t scaled =
+          (static_cast<uint64_t>(mad[lane]) * thresholdQ8_) >> 8;
+      const uint64_t limit =
+          scaled > minDeviation_ ? scaled : static_cast<uint64_t>(minDeviation_);
+      const bool outlier = absoluteDifference(in[lane], center[lane]) > limit;
+      out[lane] = outlier ? center[lane] : in[lane];
+    }
+  }
+
+  void reset() { *this = HampelFilter(thresholdQ8_, minDeviation_); }
+
+private:
+  uint16_t thresholdQ8_;
+  T minDeviation_;
+  T window_[N][Lanes] = {};
+  uint8_t index_ = 0;
+  uint8_t count_ = 0;
+};
+
+constexpr size_t log2Exact(size_t value) {
+  return value <= 1 ? 0 : 1 + log2Exact(value / 2);
+}
+
+// Moving average over the last Capacity samples with a running sum. The
+// capacity is a power of two, so the index wraps with a mask and the full
+// window divides with a shift. While filling it averages what it has.
+template <typename T, size_t Capacity, size_t Lanes = 4,
+          typename SumT = uint64_t>
+class MovingAverage {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "MovingAverage capacity must be a power of two");
+
+public:
+  void push(const T (&in)[Lanes]) {
+    // Unfilled slots hold zero, so the subtraction is unconditional.
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+      sum_[lane] -= static_cast<SumT>(window_[index_][lane]);
+      sum_[lane] += static_cast<SumT>(in[lane]);
+      window_[index_][lane] = in[lane];
+    }
+    index_ = (index_ + 1) & (Capacity - 1);
+    if (count_ < Capacity) {
+      count_++;
+    }
+  }
+
+  void average(T (&out)[Lanes]) const {
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+      if (count_ == Capacity) {
+        out[lane] = static_cast<T>(sum_[lane] >> log2Exact(Capacity));
+      } else {
+        out[lane] = count_ == 0 ? T() : static_cast<T>(sum_[lane] / count_);
+      }
+    }
+  }
+
+  size_t size() const { return count_; }
+
+  void reset() { *this = MovingAverage(); }
+
+private:
+  T window_[Capacity][Lanes] = {};
+  SumT sum_[Lanes] = {};
+  size_t index_ = 0;
+  size_t count_ = 0;
+};
+} // namespace window_filters
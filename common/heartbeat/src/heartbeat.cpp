@@ -0,0 +1,246 @@
+#include "heartbeat.h"
+
+namespace heartbeat {
+namespace {
+constexpr uint8_t REQUEST_FLAGS = FLAG_WANTS_CHARGE | FLAG_WANTS_STOP;
+// A sequence number further back than this is a slave that rebooted, not a
+// heartbeat the mesh delivered late. Slaves that send a boot id are told
+// apart by it instead, also when they rebooted before reaching this.
+constexpr int16_t REORDER_WINDOW = 64;
+
+uint32_t mix(uint32_t value) {
+  value ^= value >> 16;
+  value *= 0x7feb352du;
+  value ^= value >> 15;
+  value *= 0x846ca68bu;
+  value ^= value >> 16;
+  return value;
+}
+} // namespace
+
+const char *stateName(SlaveState state) {
+  switch (state) {
+  case SlaveState::WORK:
+    return "work";
+  case SlaveState::WALKING_TO_CHARGE:
+    return "walking_to_charge";
+  case SlaveState::WAIT_CHARGE:
+    return "wait_charge";
+  case SlaveState::WALKING_INTO_CHARGE:
+    return "walking_into_charge";
+  case SlaveState::CHARGE:
+    return "charge";
+  case SlaveState::EXITING_CHARGE:
+    return "exiting_charge";
+  case SlaveState::COUNT:
+    break;
+  }
+  return "unknown";
+}
+
+bool isUrgent(SlaveState from, SlaveState to) {
+  if (from == to) {
+    return false;
+  }
+  // The master lowers the gear for a slave in wait, starts the charge
+  // timer for one in charge and frees the bay for one back at work; the
+  // other transitions follow from its own enjoin/stop messages.
+  return to == SlaveState::WAIT_CHARGE || to == SlaveState::CHARGE ||
+         to == SlaveState::WORK;
+}
+
+HeartbeatScheduler::HeartbeatScheduler(const HeartbeatConfig &config)
+    : config_(config) {}
+
+bool HeartbeatScheduler::setState(SlaveState state, uint32_t now) {
+  if (!started_) {
+    started_ = true;
+    state_ = state;
+    stateSinceMs_ = now;
+    urgent_ = true;
+    return true;
+  }
+  if (state == state_) {
+    return false;
+  }
+  const bool urgent = isUrgent(state_, state);
+  state_ = state;
+  stateSinceMs_ = now;
+  urgent_ = urgent_ || urgent;
+  return urgent;
+}
+
+bool HeartbeatScheduler::setRequest(uint8_t flag, bool pending) {
+  flag &= REQUEST_FLAGS;
+  const bool raised = pending && (requests_ & flag) != flag;
+  requests_ = pending ? requests_ | flag : requests_ & ~flag;
+  urgent_ = urgent_ || raised;
+  return raised;
+}
+
+bool HeartbeatScheduler::due(uint32_t now) const {
+  if (!started_) {
+    return false;
+  }
+  return urgent_ || static_cast<int32_t>(now - nextDueAt()) >= 0;
+}
+
+uint32_t HeartbeatScheduler::nextDueAt() const {
+  const int32_t period =
+      static_cast<int32_t>(config_.periodMs[static_cast<size_t>(state_)]);
+  return lastSentMs_ +
+         static_cast<uint32_t>(period + period * jitterPermille_ / 1000);
+}
+
+void HeartbeatScheduler::take(uint32_t node, uint32_t now, Status &status) {
+  status.node = node;
+  status.seq = seq_++;
+  status.state = state_;
+  status.flags = static_cast<uint8_t>((status.flags & ~REQUEST_FLAGS) |
+                                      requests_);
+  status.stateAgeMs = now - stateSinceMs_;
+  if (hasBootId_) {
+    status.flags |= FLAG_BOOT_ID;
+    status.bootId = bootId_;
+  }
+  lastSentMs_ = now;
+  urgent_ = false;
+  const uint32_t span = config_.jitterPercent * 10U;
+  jitterPermille_ = static_cast<int16_t>(
+      static_cast<int32_t>(mix(node ^ (static_cast<uint32_t>(seq_) << 16)) %
+                           (2 * span + 1)) -
+      static_cast<int32_t>(span));
+}
+
+void HeartbeatScheduler::setBootId(uint16_t bootId) {
+  hasBootId_ = true;
+  bootId_ = bootId;
+}
+
+SlaveState HeartbeatScheduler::state() const { return state_; }
+
+uint8_t HeartbeatScheduler::requests() const { return requests_; }
+
+SlaveTable::SlaveTable() {
+  for (uint16_t i = 0; i < SLOTS; ++i) {
+    slots_[i] = EMPTY;
+  }
+}
+
+uint16_t SlaveTable::slotOf(uint32_t node) const {
+  // Fibonacci hashing spreads the mesh node ids, which share their high
+  // bits, over the table; probing is linear from there.
+  uint16_t slot = static_cast<uint16_t>((node * 2654435769u) >> 24);
+  while (slots_[slot] != EMPTY &&
+         entries_[slots_[slot]].status.node != node) {
+    slot = static_cast<uint16_t>((slot + 1) % SLOTS);
+  }
+  return slot;
+}
+
+uint8_t SlaveTable::ingest(const Status &status, uint32_t now) {
+  const uint16_t slot = slotOf(status.node);
+  if (slots_[slot] == EMPTY) {
+    if (count_ >= MAX_SLAVES) {
+      return CHANGE_STALE;
+    }
+    slots_[slot] = count_;
+    Entry &entry = entries_[count_++];
+    entry.status = status;
+    entry.lastSeenMs = now;
+    entry.received = 1;
+    entry.stateEnteredMs = now - status.stateAgeMs;
+    return CHANGE_NEW_SLAVE | CHANGE_STATE |
+           ((status.flags & REQUEST_FLAGS) != 0 ? CHANGE_REQUESTS : 0);
+  }
+
+  Entry &entry = entries_[slots_[slot]];
+  const bool bootIds = (status.flags & FLAG_BOOT_ID) != 0 &&
+                       (entry.status.flags & FLAG_BOOT_ID) != 0;
+  if (bootIds && status.bootId != entry.status.bootId) {
+    if (entry.restarts > 0 && status.bootId == entry.previousBootId) {
+      return CHANGE_STALE;
+    }
+    restart(entry, status, now);
+    return CHANGE_RESTART | CHANGE_STATE |
+           ((status.flags & REQUEST_FLAGS) != 0 ? CHANGE_REQUESTS : 0);
+  }
+  const int16_t gap = static_cast<int16_t>(status.seq - entry.status.seq);
+  if (gap <= 0 && gap > -REORDER_WINDOW) {
+    return CHANGE_STALE;
+  }
+  if (gap > 1) {
+    entry.missed += static_cast<uint32_t>(gap - 1);
+  }
+  uint8_t changes = 0;
+  if (status.state != entry.status.state) {
+    changes |= CHANGE_STATE;
+    if (closeState(entry, status, now)) {
+      changes |= CHANGE_CYCLE;
+    }
+  }
+  if ((status.flags & REQUEST_FLAGS) != (entry.status.flags & REQUEST_FLAGS)) {
+    changes |= CHANGE_REQUESTS;
+  }
+  entry.status = status;
+  entry.lastSeenMs = now;
+  entry.received++;
+  return changes;
+}
+
+void SlaveTable::restart(Entry &entry, const Status &status, uint32_t now) {
+  entry.previousBootId = entry.status.bootId;
+  entry.restarts++;
+  entry.status = status;
+  entry.lastSeenMs = now;
+  entry.received++;
+  entry.stateEnteredMs = now - status.stateAgeMs;
+  for (uint32_t &ms : entry.cycleMs) {
+    ms = 0;
+  }
+  entry.charged = false;
+}
+
+bool SlaveTable::closeState(Entry &entry, const Status &status, uint32_t now) {
+  const SlaveState left = entry.status.state;
+  // Heartbeats reach the master a few ms after the slave's clock says;
+  // the age puts the change where the slave made it.
+  const uint32_t enteredMs = now - status.stateAgeMs;
+  const int32_t spentMs =
+      static_cast<int32_t>(enteredMs - entry.stateEnteredMs);
+  entry.stateEnteredMs = enteredMs;
+  if (left == SlaveState::WORK) {
+    for (uint32_t &ms : entry.cycleMs) {
+      ms = 0;
+    }
+    entry.charged = false;
+  } else {
+    entry.cycleMs[static_cast<size_t>(left)] +=
+        spentMs > 0 ? static_cast<uint32_t>(spentMs) : 0;
+  }
+  if (status.state == SlaveState::CHARGE) {
+    entry.charged = true;
+  }
+  // A walk that gave up is not a cycle.
+  return status.state == SlaveState::WORK && entry.charged;
+}
+
+const SlaveTable::Entry *SlaveTable::find(uint32_t node) const {
+  const uint16_t slot = slotOf(node);
+  return slots_[slot] == EMPTY ? nullptr : &entries_[slots_[slot]];
+}
+
+uint8_t SlaveTable::count() const { return count_; }
+
+uint8_t SlaveTable::silent(uint32_t now, uint32_t timeoutMs) const {
+  uint8_t silent = 0;
+  for (uint8_t i = 0; i < count_; ++i) {
+    silent += now - entries_[i].lastSeenMs >= timeoutMs ? 1 : 0;
+  }
+  return silent;
+}
+
+const SlaveTable::Entry &SlaveTable::at(uint8_t index) const {
+  return entries_[index];
+}
+} // namespace heartbeat
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <beacon_power.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// One small status message per slave instead of a message per event. A
+// heartbeat carries the slave state, how long it has been in it, the
+// battery, the bearing to the beacon and, while walking, the beacon report
+// (common/beacon_power). It goes out at a rate that follows the state:
+// often while walking or docking, rarely at work or on the charger. A state
+// change the master has to act on goes out at once; the others ride on the
+// next heartbeat, which comes soon in the states they lead to.
+//
+// Every heartbeat repeats the whole status, so a lost one costs nothing but
+// staleness: the next one brings the master up to date.
+namespace heartbeat {
+// SlaveState of the dezibot autocharge library, by value.
+enum class SlaveState : uint8_t {
+  WORK,
+  WALKING_TO_CHARGE,
+  WAIT_CHARGE,
+  WALKING_INTO_CHARGE,
+  CHARGE,
+  EXITING_CHARGE,
+  COUNT
+};
+constexpr size_t STATE_COUNT = static_cast<size_t>(SlaveState::COUNT);
+const char *stateName(SlaveState state);
+
+constexpr uint16_t BATTERY_UNKNOWN = 0;
+constexpr uint16_t CHARGE_REMAINING_UNKNOWN = 0xFFFF;
+constexpr uint8_t CHARGE_PERCENT_UNKNOWN = 0xFF;
+
+enum Flag : uint8_t {
+  // `report` holds a beacon report window.
+  FLAG_REPORT = 1 << 0,
+  // The tracker sees the beacon; `thetaCentiDeg` is its bearing.
+  FLAG_DETECTED = 1 << 1,
+  // requestCharge / stopCharge are pending with the master.
+  FLAG_WANTS_CHARGE = 1 << 2,
+  FLAG_WANTS_STOP = 1 << 3,
+  // On the charger: `chargeRemainingS` and `chargePercent` are its
+  // estimate (common/charge_control).
+  FLAG_CHARGE_ESTIMATE = 1 << 4,
+  // `bootId` is set.
+  FLAG_BOOT_ID = 1 << 5
+};
+
+struct Status {
+  uint32_t node = 0;
+  // Per heartbeat; gaps tell the master how many it missed.
+  uint16_t seq = 0;
+  SlaveState state = SlaveState::WORK;
+  uint8_t flags = 0;
+  uint32_t stateAgeMs = 0;
+  uint16_t batteryMv = BATTERY_UNKNOWN;
+  int16_t thetaCentiDeg = 0;
+  beacon_power::BeaconReport report;
+  // Until the slave asks to stop charging, and how far along it is.
+  uint16_t chargeRemainingS = CHARGE_REMAINING_UNKNOWN;
+  uint8_t chargePercent = CHARGE_PERCENT_UNKNOWN;
+  // Drawn at boot. A slave that restarts starts `seq` over under a new id,
+  // which tells the master a restart from a heartbeat delivered late.
+  uint16_t bootId = 0;
+};
+
+struct HeartbeatConfig {
+  // Heartbeat period per state, indexed by SlaveState. While walking to the
+  // charger the beacon report window sets the pace and this is the longest
+  // gap.
+  uint32_t periodMs[STATE_COUNT] = {10000, 1000, 2000, 500, 5000, 1000};
+  // Each period is stretched or shrunk by up to this share, differently
+  // per node and heartbeat, so slaves switched on together drift apart
+  // instead of all reporting in the same second.
+  uint8_t jitterPercent = 10;
+};
+
+// Runs on a slave.
+class HeartbeatScheduler {
+public:
+  explicit HeartbeatScheduler(
+      const HeartbeatConfig &config = HeartbeatConfig());
+
+  // Call with the current state every step; returns true when the change
+  // has to reach the master now.
+  bool setState(SlaveState state, uint32_t now);
+  // Sets or clears a FLAG_WANTS_* request; a new one is urgent.
+  bool setRequest(uint8_t flag, bool pending);
+  // A heartbeat is due at `now`.
+  bool due(uint32_t now) const;
+  // When the periodic heartbeat of the current state falls due.
+  uint32_t nextDueAt() const;
+  // Fills the status for sending and starts the next period.
+  void take(uint32_t node, uint32_t now, Status &status);
+  // Sends `bootId` with every heartbeat from now on.
+  void setBootId(uint16_t bootId);
+
+  SlaveState state() const;
+  uint8_t requests() const;
+
+private:
+  HeartbeatConfig config_;
+  SlaveState state_ = SlaveState::WORK;
+  bool started_ = false;
+  uint32_t stateSinceMs_ = 0;
+  uint32_t lastSentMs_ = 0;
+  bool urgent_ = false;
+  uint8_t requests_ = 0;
+  uint16_t seq_ = 0;
+  bool hasBootId_ = false;
+  uint16_t bootId_ = 0;
+  // Applied to the current period, in 1/1000.
+  int16_t jitterPermille_ = 0;
+};
+
+// Transitions the master acts on: notifyInWait, notifyInCharge and the
+// return to WORK that follows notifyExitCharge.
+bool isUrgent(SlaveState from, SlaveState to);
+
+enum Change : uint8_t {
+  CHANGE_NEW_SLAVE = 1 << 0,
+  CHANGE_STATE = 1 << 1,
+  CHANGE_REQUESTS = 1 << 2,
+  // Older than the last heartbeat seen, e.g. reordered by the mesh.
+  CHANGE_STALE = 1 << 3,
+  // Back at WORK after a charge; the entry's cycleMs holds the cycle.
+  CHANGE_CYCLE = 1 << 4,
+  // A new boot id: the slave restarted and its seq started over. The
+  // cycle in progress is dropped.
+  CHANGE_RESTART = 1 << 5
+};
+
+// Runs on the master: the last status of every slave, found by node id in
+// an open-addressed table.
+class SlaveTable {
+public:
+  static constexpr uint8_t MAX_SLAVES = 128;
+
+  struct Entry {
+    Status status;
+    uint32_t lastSeenMs = 0;
+    // Heartbeats seen and missed (sequence gaps).
+    uint32_t received = 0;
+    uint32_t missed = 0;
+    uint32_t restarts = 0;
+    // The boot id before the last restart; heartbeats still carrying it
+    // are late.
+    uint16_t previousBootId = 0;
+    // Time per state of the charging cycle since the slave left WORK, on
+    // the master's clock. A state whose heartbeats were all missed counts
+    // towards the one before it.
+    uint32_t cycleMs[STATE_COUNT] = {};
+    uint32_t stateEnteredMs = 0;
+    bool charged = false;
+  };
+
+  SlaveTable();
+
+  // Returns a CHANGE_* mask; 0 for a repeat of what is known. A slave
+  // beyond MAX_SLAVES is dropped (CHANGE_STALE).
+  uint8_t ingest(const Status &status, uint32_t now);
+  const Entry *find(uint32_t node) const;
+  uint8_t count() const;
+  // Slaves not heard from for timeoutMs.
+  uint8_t silent(uint32_t now, uint32_t timeoutMs) const;
+  // For iterating: index < count().
+  const Entry &at(uint8_t index) const;
+
+private:
+  static constexpr uint16_t SLOTS = 256;
+  static constexpr uint8_t EMPTY = 0xFF;
+
+  uint16_t slotOf(uint32_t node) const;
+  // Starts the entry over for a slave that came back under a new boot id.
+  static void restart(Entry &entry, const Status &status, uint32_t now);
+  // Books the time spent in the state the slave left; true when the
+  // change completes a charging cycle.
+  static bool closeState(Entry &entry, const Status &status, uint32_t now);
+
+  Entry entries_[MAX_SLAVES];
+  uint8_t count_ = 0;
+  // Index into entries_ per hash slot, EMPTY if unused.
+  uint8_t slots_[SLOTS];
+};
+} // namespace heartbeat
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear histogram of latencies in us: each power of two is split into
+// 8 buckets, so a percentile is at most 12.5% above the true value. Covers
+// up to 2^26 us (67 s); larger values land in the last bucket.
+class LatencyHistogram {
+public:
+  static constexpr uint8_t SUB_BITS = 3;
+  static constexpr uint8_t OCTAVES = 24;
+  static constexpr size_t BUCKETS = static_cast<size_t>(OCTAVES)
+                                    << SUB_BITS;
+
+  void add(uint32_t us) {
+    buckets_[bucketOf(us)]++;
+    count_++;
+    sum_ += us;
+    max_ = us > max_ ? us : max_;
+  }
+
+  void reset() {
+    for (uint32_t &bucket : buckets_) {
+      bucket = 0;
+    }
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+  }
+
+  uint32_t count() const { return count_; }
+  uint32_t max() const { return max_; }
+  uint32_t mean() const {
+    return count_ == 0 ? 0 : static_cast<uint32_t>(sum_ / count_);
+  }
+
+  // Upper edge of the bucket holding the given fraction of the samples,
+  // capped at the largest sample.
+  uint32_t percentile(float fraction) const {
+    if (count_ == 0) {
+      return 0;
+    }
+    uint32_t rank = static_cast<uint32_t>(fraction * count_ + 0.999f);
+    rank = rank == 0 ? 1 : rank;
+    uint32_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        const uint32_t upper = upperOf(i);
+        return upper < max_ ? upper : max_;
+      }
+    }
+    return max_;
+  }
+
+  static size_t bucketOf(uint32_t us) {
+    constexpr uint32_t SUB = 1U << SUB_BITS;
+    if (us < SUB) {
+      return us;
+    }
+    const uint8_t octave = static_cast<uint8_t>(31 - __builtin_clz(us));
+    const size_t index =
+        (static_cast<size_t>(octave - SUB_BITS + 1) << SUB_BITS) +
+        ((us >> (octave - SUB_BITS)) & (SUB - 1));
+    return index < BUCKETS ? index : BUCKETS - 1;
+  }
+
+  static uint32_t upperOf(size_t index) {
+    constexpr uint32_t SUB = 1U << SUB_BITS;
+    if (index < SUB) {
+      return static_cast<uint32_t>(index);
+    }
+    const uint8_t shift = static_cast<uint8_t>((index >> SUB_BITS) - 1);
+    const uint32_t lower = (SUB + (index & (SUB - 1))) << shift;
+    return lower + (1U << shift) - 1;
+  }
+
+private:
+  uint32_t buckets_[BUCKETS] = {};
+  uint32_t count_ = 0;
+  uint64_t sum_ = 0;
+  uint32_t max_ = 0;
+};
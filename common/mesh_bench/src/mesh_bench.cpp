@@ -0,0 +1,322 @@
+#include "mesh_bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+// requestCharge and enjoinCharge fit in the shortest ping; a navz uplink
+// batch of about ten frames is around 230 bytes.
+constexpr size_t CONTROL_LENGTH = 48;
+constexpr size_t LOG_LENGTH = 230;
+
+bool startsWith(const char *text, const char *prefix, const char *&rest) {
+  const size_t length = strlen(prefix);
+  if (strncmp(text, prefix, length) != 0) {
+    return false;
+  }
+  rest = text + length;
+  return true;
+}
+
+// Reads one unsigned field terminated by `separator`, or by the end of the
+// message when the separator is ','.
+bool readField(const char *&text, char separator, uint64_t &value) {
+  char *end = nullptr;
+  if (*text < '0' || *text > '9') {
+    return false;
+  }
+  const unsigned long long parsed = strtoull(text, &end, 10);
+  if (*end != separator && !(separator == ',' && *end == '\0')) {
+    return false;
+  }
+  value = static_cast<uint64_t>(parsed);
+  text = *end == '\0' ? end : end + 1;
+  return true;
+}
+
+bool readField32(const char *&text, uint32_t &value) {
+  uint64_t wide = 0;
+  if (!readField(text, ',', wide) || wide > UINT32_MAX) {
+    return false;
+  }
+  value = static_cast<uint32_t>(wide);
+  return true;
+}
+
+bool readKind(const char *&text, mesh_bench::Kind &kind) {
+  uint32_t index = 0;
+  if (!readField32(text, index) || index >= mesh_bench::KIND_COUNT) {
+    return false;
+  }
+  kind = static_cast<mesh_bench::Kind>(index);
+  return true;
+}
+
+// Pads a formatted message with 'x' up to `length`; returns the final
+// length, 0 if it does not fit.
+size_t padded(int length, size_t target, char *out, size_t size) {
+  if (length <= 0 || static_cast<size_t>(length) >= size) {
+    return 0;
+  }
+  size_t used = static_cast<size_t>(length);
+  if (used < target) {
+    if (target >= size) {
+      return 0;
+    }
+    out[used++] = ',';
+    while (used < target) {
+      out[used++] = 'x';
+    }
+    out[used] = '\0';
+  }
+  return used;
+}
+} // namespace
+
+namespace mesh_bench {
+
+const char *kindName(Kind kind) {
+  switch (kind) {
+  case Kind::CONTROL:
+    return "control";
+  case Kind::LOG:
+    return "log";
+  case Kind::COUNT:
+    break;
+  }
+  return "unknown";
+}
+
+size_t kindLength(Kind kind) {
+  return kind == Kind::LOG ? LOG_LENGTH : CONTROL_LENGTH;
+}
+
+size_t formatPing(const Ping &ping, char *out, size_t size) {
+  return padded(snprintf(out, size, "%s%u,%lu,%lu,%llu", PING_PREFIX,
+                         static_cast<unsigned>(ping.kind),
+                         static_cast<unsigned long>(ping.node),
+                         static_cast<unsigned long>(ping.seq),
+                         static_cast<unsigned long long>(ping.sentUs)),
+                kindLength(ping.kind), out, size);
+}
+
+size_t formatPong(const Ping &ping, uint64_t receivedUs, uint64_t answeredUs,
+                  char *out, size_t size) {
+  return padded(snprintf(out, size, "%s%u,%lu,%lu,%llu,%llu,%llu",
+                         PONG_PREFIX, static_cast<unsigned>(ping.kind),
+                         static_cast<unsigned long>(ping.node),
+                         static_cast<unsigned long>(ping.seq),
+                         static_cast<unsigned long long>(ping.sentUs),
+                         static_cast<unsigned long long>(receivedUs),
+                         static_cast<unsigned long long>(answeredUs)),
+                kindLength(ping.kind), out, size);
+}
+
+size_t formatLoad(uint32_t node, uint32_t seq, size_t length, char *out,
+                  size_t size) {
+  return padded(snprintf(out, size, "%s%lu,%lu", LOAD_PREFIX,
+                         static_cast<unsigned long>(node),
+                         static_cast<unsigned long>(seq)),
+                length, out, size);
+}
+
+bool parsePing(const char *message, Ping &ping) {
+  const char *text = nullptr;
+  Ping parsed;
+  if (!startsWith(message, PING_PREFIX, text) || !readKind(text, parsed.kind) ||
+      !readField32(text, parsed.node) || !readField32(text, parsed.seq) ||
+      !readField(text, ',', parsed.sentUs)) {
+    return false;
+  }
+  ping = parsed;
+  return true;
+}
+
+bool parsePong(const char *message, Pong &pong) {
+  const char *text = nullptr;
+  Pong parsed;
+  if (!startsWith(message, PONG_PREFIX, text) ||
+      !readKind(text, parsed.ping.kind) ||
+      !readField32(text, parsed.ping.node) ||
+      !readField32(text, parsed.ping.seq) ||
+      !readField(text, ',', parsed.ping.sentUs) ||
+      !readField(text, ',', parsed.receivedUs) ||
+      !readField(text, ',', parsed.answeredUs)) {
+    return false;
+  }
+  pong = parsed;
+  return true;
+}
+
+constexpr uint8_t PingBench::MAX_OUTSTANDING;
+
+PingBench::PingBench() { stop(); }
+
+void PingBench::start(const BenchConfig &config, uint64_t nowUs) {
+  stop();
+  config_ = config;
+  for (KindStats &stats : stats_) {
+    stats.roundTrip.reset();
+    stats.uplink.reset();
+    stats.downlink.reset();
+    stats.sent = 0;
+    stats.lost = 0;
+  }
+  active_ = true;
+  startedAtUs_ = nowUs;
+  nextPingAtUs_ = nowUs;
+  nextLoadAtUs_ = nowUs;
+  loadSeq_ = 0;
+}
+
+void PingBench::stop() {
+  active_ = false;
+  for (Outstanding &slot : outstanding_) {
+    slot.used = false;
+  }
+}
+
+bool PingBench::active() const { return active_; }
+
+bool PingBench::finished(uint64_t nowUs) {
+  if (!active_ ||
+      nowUs - startedAtUs_ <
+          static_cast<uint64_t>(config_.durationMs + config_.timeoutMs) *
+              1000U) {
+    return false;
+  }
+  expire(UINT64_MAX);
+  active_ = false;
+  return true;
+}
+
+PingBench::Send PingBench::poll(uint32_t node, uint64_t nowUs, char *out,
+                                size_t size) {
+  if (!active_) {
+    return Send::NONE;
+  }
+  expire(nowUs);
+  // Pings stop at durationMs; the timeout after it lets the last ones
+  // come back.
+  const bool sending =
+      nowUs - startedAtUs_ < static_cast<uint64_t>(config_.durationMs) * 1000U;
+
+  if (sending && nowUs >= nextPingAtUs_) {
+    // After a stall, carry on from now instead of sending the missed ones.
+    nextPingAtUs_ += static_cast<uint64_t>(config_.pingPeriodMs) * 1000U;
+    nextPingAtUs_ = nextPingAtUs_ < nowUs ? nowUs : nextPingAtUs_;
+    Outstanding *slot = nullptr;
+    for (Outstanding &candidate : outstanding_) {
+      if (!candidate.used) {
+        slot = &candidate;
+        break;
+      }
+    }
+    Ping ping;
+    ping.kind = static_cast<Kind>(nextKind_);
+    ping.node = node;
+    ping.seq = ++seq_;
+    ping.sentUs = nowUs;
+    nextKind_ = static_cast<uint8_t>((nextKind_ + 1) % KIND_COUNT);
+    KindStats &stats = stats_[static_cast<size_t>(ping.kind)];
+    stats.sent++;
+    if (slot == nullptr) {
+      // More pings in flight than slots: the link is far behind already.
+      stats.lost++;
+      return Send::NONE;
+    }
+    if (formatPing(ping, out, size) == 0) {
+      stats.sent--;
+      return Send::NONE;
+    }
+    slot->used = true;
+    slot->seq = ping.seq;
+    slot->sentUs = ping.sentUs;
+    slot->kind = ping.kind;
+    return Send::PING;
+  }
+
+  if (sending && config_.loadHz > 0 && nowUs >= nextLoadAtUs_) {
+    nextLoadAtUs_ += 1000000U / config_.loadHz;
+    nextLoadAtUs_ = nextLoadAtUs_ < nowUs ? nowUs : nextLoadAtUs_;
+    if (formatLoad(node, ++loadSeq_, config_.loadLength, out, size) > 0) {
+      return Send::LOAD;
+    }
+  }
+  return Send::NONE;
+}
+
+bool PingBench::onPong(const Pong &pong, uint64_t receivedUs,
+                       const int64_t *meshOffsetUs) {
+  for (Outstanding &slot : outstanding_) {
+    if (!slot.used || slot.seq != pong.ping.seq ||
+        slot.sentUs != pong.ping.sentUs || slot.kind != pong.ping.kind) {
+      continue;
+    }
+    slot.used = false;
+    KindStats &stats = stats_[static_cast<size_t>(slot.kind)];
+    const uint64_t roundTrip = receivedUs - slot.sentUs;
+    stats.roundTrip.add(roundTrip > UINT32_MAX
+                            ? UINT32_MAX
+                            : static_cast<uint32_t>(roundTrip));
+    if (meshOffsetUs != nullptr) {
+      const int64_t up = static_cast<int64_t>(pong.receivedUs) -
+                         (static_cast<int64_t>(slot.sentUs) + *meshOffsetUs);
+      const int64_t down =
+          (static_cast<int64_t>(receivedUs) + *meshOffsetUs) -
+          static_cast<int64_t>(pong.answeredUs);
+      // Clock error can push a short leg below zero.
+      stats.uplink.add(up > 0 ? static_cast<uint32_t>(up) : 0U);
+      stats.downlink.add(down > 0 ? static_cast<uint32_t>(down) : 0U);
+    }
+    return true;
+  }
+  return false;
+}
+
+const KindStats &PingBench::stats(Kind kind) const {
+  return stats_[static_cast<size_t>(kind)];
+}
+
+uint32_t PingBench::loadSent() const { return loadSeq_; }
+
+void PingBench::expire(uint64_t nowUs) {
+  const uint64_t timeoutUs = static_cast<uint64_t>(config_.timeoutMs) * 1000U;
+  for (Outstanding &slot : outstanding_) {
+    if (slot.used && (nowUs == UINT64_MAX || nowUs - slot.sentUs >= timeoutUs)) {
+      slot.used = false;
+      stats_[static_cast<size_t>(slot.kind)].lost++;
+    }
+  }
+}
+
+size_t answerPing(const char *message, uint64_t receivedUs,
+                  uint64_t answeredUs, char *out, size_t size) {
+  Ping ping;
+  if (!parsePing(message, ping)) {
+    return 0;
+  }
+  return formatPong(ping, receivedUs, answeredUs, out, size);
+}
+
+size_t formatSummary(Kind kind, const char *direction,
+                     const LatencyHistogram &histogram,
+                     const KindStats &stats, char *out, size_t size) {
+  const int length = snprintf(
+      out, size,
+      "mesh_bench,%s,%s,n=%lu,p50_us=%lu,p90_us=%lu,p99_us=%lu,max_us=%lu,"
+      "sent=%lu,lost=%lu",
+      kindName(kind), direction,
+      static_cast<unsigned long>(histogram.count()),
+      static_cast<unsigned long>(histogram.percentile(0.50f)),
+      static_cast<unsigned long>(histogram.percentile(0.90f)),
+      static_cast<unsigned long>(histogram.percentile(0.99f)),
+      static_cast<unsigned long>(histogram.max()),
+      static_cast<unsigned long>(stats.sent),
+      static_cast<unsigned long>(stats.lost));
+  return length > 0 && static_cast<size_t>(length) < size
+             ? static_cast<size_t>(length)
+             : 0;
+}
+} // namespace mesh_bench
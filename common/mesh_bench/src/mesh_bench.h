@@ -0,0 +1,139 @@
+#pragma once
+
+#include "latency_histogram.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Mesh latency benchmark. A slave broadcasts timestamped pings padded to
+// the size of real traffic, the master echoes each one as soon as its
+// mesh callback sees it, and the slave sorts the round trips (and, with a
+// synchronized clock, each direction) into histograms per message kind.
+// Optional load messages stand in for other slaves logging to the master.
+//
+//   png:<kind>,<node>,<seq>,<t1>,<padding>                  slave -> all
+//   pong:<kind>,<node>,<seq>,<t1>,<t2>,<t3>,<padding>       master -> all
+//   log:bench_load,<node>,<seq>,<padding>                   slave -> master
+namespace mesh_bench {
+enum class Kind : uint8_t {
+  // The size of requestCharge / enjoinCharge.
+  CONTROL,
+  // The size of a navz uplink batch.
+  LOG,
+  COUNT
+};
+constexpr size_t KIND_COUNT = static_cast<size_t>(Kind::COUNT);
+
+const char *kindName(Kind kind);
+// Length of a ping (and its pong) of this kind, prefix included.
+size_t kindLength(Kind kind);
+
+constexpr const char *PING_PREFIX = "png:";
+constexpr const char *PONG_PREFIX = "pong:";
+constexpr const char *LOAD_PREFIX = "log:bench_load,";
+constexpr size_t MESSAGE_CAPACITY = 256;
+
+struct Ping {
+  Kind kind = Kind::CONTROL;
+  uint32_t node = 0;
+  uint32_t seq = 0;
+  uint64_t sentUs = 0;
+};
+
+struct Pong {
+  Ping ping;
+  // Master clock when the ping arrived and when the pong left.
+  uint64_t receivedUs = 0;
+  uint64_t answeredUs = 0;
+};
+
+// All return the length written, 0 if it does not fit.
+size_t formatPing(const Ping &ping, char *out, size_t size);
+size_t formatPong(const Ping &ping, uint64_t receivedUs, uint64_t answeredUs,
+                  char *out, size_t size);
+size_t formatLoad(uint32_t node, uint32_t seq, size_t length, char *out,
+                  size_t size);
+// Both return false for other messages or malformed fields.
+bool parsePing(const char *message, Ping &ping);
+bool parsePong(const char *message, Pong &pong);
+
+struct BenchConfig {
+  // One ping every pingPeriodMs, alternating kinds.
+  uint32_t pingPeriodMs = 100;
+  // A ping without a pong after this long is lost.
+  uint32_t timeoutMs = 2000;
+  // Simulated logging load: loadHz messages of loadLength bytes per second.
+  uint32_t loadHz = 0;
+  uint16_t loadLength = 200;
+  uint32_t durationMs = 30000;
+};
+
+struct KindStats {
+  LatencyHistogram roundTrip;
+  // Only filled while the caller passes a mesh clock offset.
+  LatencyHistogram uplink;
+  LatencyHistogram downlink;
+  uint32_t sent = 0;
+  uint32_t lost = 0;
+};
+
+// Runs on the benchmarking slave.
+class PingBench {
+public:
+  enum class Send : uint8_t { NONE, PING, LOAD };
+
+  static constexpr uint8_t MAX_OUTSTANDING = 32;
+
+  PingBench();
+
+  // Clears the statistics and starts a run.
+  void start(const BenchConfig &config, uint64_t nowUs);
+  void stop();
+  bool active() const;
+  // True once durationMs has passed; remaining pings are counted as lost.
+  bool finished(uint64_t nowUs);
+
+  // Returns what to send now: PING as a broadcast, LOAD as a unicast to
+  // the master. Call until it returns NONE.
+  Send poll(uint32_t node, uint64_t nowUs, char *out, size_t size);
+  // meshOffsetUs, if known, maps this node's clock to the master's; then
+  // each direction is measured as well. Returns false for foreign pongs.
+  bool onPong(const Pong &pong, uint64_t receivedUs,
+              const int64_t *meshOffsetUs = nullptr);
+
+  const KindStats &stats(Kind kind) const;
+  uint32_t loadSent() const;
+
+private:
+  struct Outstanding {
+    bool used;
+    uint32_t seq;
+    uint64_t sentUs;
+    Kind kind;
+  };
+
+  void expire(uint64_t nowUs);
+
+  BenchConfig config_;
+  bool active_ = false;
+  uint64_t startedAtUs_ = 0;
+  uint64_t nextPingAtUs_ = 0;
+  uint64_t nextLoadAtUs_ = 0;
+  uint32_t seq_ = 0;
+  uint32_t loadSeq_ = 0;
+  uint8_t nextKind_ = 0;
+  Outstanding outstanding_[MAX_OUTSTANDING];
+  KindStats stats_[KIND_COUNT];
+};
+
+// Runs on the master: the pong for `message`, or 0 if it is not a ping.
+size_t answerPing(const char *message, uint64_t receivedUs,
+                  uint64_t answeredUs, char *out, size_t size);
+
+// Formats one summary line per kind and direction:
+//   mesh_bench,<kind>,<rtt|up|down>,n=..,p50_us=..,p90_us=..,p99_us=..,
+//   max_us=..,sent=..,lost=..
+size_t formatSummary(Kind kind, const char *direction,
+                     const LatencyHistogram &histogram,
+                     const KindStats &stats, char *out, size_t size);
+} // namespace mesh_bench
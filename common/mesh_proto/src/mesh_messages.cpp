@@ -0,0 +1,214 @@
+#include "mesh_messages.h"
+
+namespace mesh_proto {
+namespace {
+constexpr size_t FRAME_CAPACITY = 48;
+
+size_t armored(const Writer &writer, const uint8_t *frame, char *out,
+               size_t size) {
+  return writer.ok() ? armor(frame, writer.length(), out, size) : 0;
+}
+} // namespace
+
+size_t encodeSignal(Type type, char *out, size_t size) {
+  if (payloadSize(type) != 0) {
+    return 0;
+  }
+  uint8_t frame[FRAME_CAPACITY];
+  Writer writer(type, frame, sizeof(frame));
+  return armored(writer, frame, out, size);
+}
+
+size_t encodeClockRequest(const clock_sync::ClockRequest &request, char *out,
+                          size_t size) {
+  uint8_t frame[FRAME_CAPACITY];
+  Writer writer(Type::CLOCK_REQUEST, frame, sizeof(frame));
+  writer.u32(request.node).u32(request.seq).u64(request.sentUs);
+  return armored(writer, frame, out, size);
+}
+
+bool readClockRequest(Reader &payload, clock_sync::ClockRequest &request) {
+  clock_sync::ClockRequest parsed;
+  parsed.node = payload.u32();
+  parsed.seq = payload.u32();
+  parsed.sentUs = payload.u64();
+  if (!payload.ok()) {
+    return false;
+  }
+  request = parsed;
+  return true;
+}
+
+size_t encodeClockResponse(const clock_sync::ClockRequest &request,
+                           uint64_t receivedUs, uint64_t sentUs, char *out,
+                           size_t size) {
+  uint8_t frame[FRAME_CAPACITY];
+  Writer writer(Type::CLOCK_RESPONSE, frame, sizeof(frame));
+  writer.u32(request.node)
+      .u32(request.seq)
+      .u64(request.sentUs)
+      .u64(receivedUs)
+      .u64(sentUs);
+  return armored(writer, frame, out, size);
+}
+
+bool readClockResponse(Reader &payload, clock_sync::ClockResponse &response) {
+  clock_sync::ClockResponse parsed;
+  parsed.node = payload.u32();
+  parsed.seq = payload.u32();
+  parsed.requestSentUs = payload.u64();
+  parsed.receivedUs = payload.u64();
+  parsed.sentUs = payload.u64();
+  if (!payload.ok()) {
+    return false;
+  }
+  response = parsed;
+  return true;
+}
+
+size_t encodeBeaconReport(const beacon_power::BeaconReport &report, char *out,
+                          size_t size) {
+  uint8_t frame[FRAME_CAPACITY];
+  Writer writer(Type::BEACON_REPORT, frame, sizeof(frame));
+  writer.u32(report.node)
+      .u16(report.duty)
+      .u32(report.signal)
+      .u16(report.saturated)
+      .u16(report.ticks);
+  return armored(writer, frame, out, size);
+}
+
+bool readBeaconReport(Reader &payload, beacon_power::BeaconReport &report) {
+  beacon_power::BeaconReport parsed;
+  parsed.node = payload.u32();
+  parsed.duty = payload.u16();
+  parsed.signal = payload.u32();
+  parsed.saturated = payload.u16();
+  parsed.ticks = payload.u16();
+  if (!payload.ok() || parsed.duty > beacon_power::DUTY_MAX ||
+      parsed.saturated > parsed.ticks) {
+    return false;
+  }
+  report = parsed;
+  return true;
+}
+
+size_t encodeBeaconDuty(uint16_t duty, char *out, size_t size) {
+  return encodeBeaconDuty(duty, 0, out, size);
+}
+
+size_t encodeBeaconDuty(uint16_t duty, uint32_t master, char *out,
+                        size_t size) {
+  uint8_t frame[FRAME_CAPACITY];
+  Writer writer(Type::BEACON_DUTY, frame, sizeof(frame));
+  writer.u16(duty);
+  if (master != 0) {
+    writer.u32(master);
+  }
+  return armored(writer, frame, out, size);
+}
+
+bool readBeaconDuty(Reader &payload, uint16_t &duty) {
+  uint32_t master = 0;
+  return readBeaconDuty(payload, duty, master);
+}
+
+bool readBeaconDuty(Reader &payload, uint16_t &duty, uint32_t &master) {
+  const uint16_t parsed = payload.u16();
+  const uint32_t sender = payload.remaining() >= 4 ? payload.u32() : 0;
+  if (!payload.ok() || parsed > beacon_power::DUTY_MAX) {
+    return false;
+  }
+  duty = parsed;
+  master = sender;
+  return true;
+}
+
+size_t encodeHeartbeat(const heartbeat::Status &status, char *out,
+                       size_t size) {
+  const bool hasReport = (status.flags & heartbeat::FLAG_REPORT) != 0;
+  uint8_t frame[FRAME_CAPACITY];
+  Writer writer(Type::HEARTBEAT, frame, sizeof(frame));
+  writer.u32(status.node)
+      .u16(status.seq)
+      .u8(static_cast<uint8_t>(status.state))
+      .u8(status.flags)
+      .u32(status.stateAgeMs)
+      .u16(status.batteryMv)
+      .u16(static_cast<uint16_t>(status.thetaCentiDeg))
+      .u16(hasReport ? status.report.duty : 0)
+      .u32(hasReport ? status.report.signal : 0)
+      .u16(hasReport ? status.report.saturated : 0)
+      .u16(hasReport ? status.report.ticks : 0);
+  if ((status.flags & heartbeat::FLAG_CHARGE_ESTIMATE) != 0) {
+    writer.u16(status.chargeRemainingS).u8(status.chargePercent);
+  }
+  if ((status.flags & heartbeat::FLAG_BOOT_ID) != 0) {
+    writer.u16(status.bootId);
+  }
+  return armored(writer, frame, out, size);
+}
+
+bool readHeartbeat(Reader &payload, heartbeat::Status &status) {
+  heartbeat::Status parsed;
+  parsed.node = payload.u32();
+  parsed.seq = payload.u16();
+  const uint8_t state = payload.u8();
+  parsed.flags = payload.u8();
+  parsed.stateAgeMs = payload.u32();
+  parsed.batteryMv = payload.u16();
+  parsed.thetaCentiDeg = static_cast<int16_t>(payload.u16());
+  parsed.report.node = parsed.node;
+  parsed.report.duty = payload.u16();
+  parsed.report.signal = payload.u32();
+  parsed.report.saturated = payload.u16();
+  parsed.report.ticks = payload.u16();
+  if ((parsed.flags & heartbeat::FLAG_CHARGE_ESTIMATE) != 0 &&
+      payload.remaining() >= 3) {
+    parsed.chargeRemainingS = payload.u16();
+    parsed.chargePercent = payload.u8();
+  } else {
+    parsed.flags = static_cast<uint8_t>(parsed.flags &
+                                        ~heartbeat::FLAG_CHARGE_ESTIMATE);
+  }
+  if ((parsed.flags & heartbeat::FLAG_BOOT_ID) != 0 &&
+      payload.remaining() >= 2) {
+    parsed.bootId = payload.u16();
+  } else {
+    parsed.flags =
+        static_cast<uint8_t>(parsed.flags & ~heartbeat::FLAG_BOOT_ID);
+  }
+  if (!payload.ok() || state >= heartbeat::STATE_COUNT ||
+      parsed.report.duty > beacon_power::DUTY_MAX ||
+      parsed.report.saturated > parsed.report.ticks) {
+    return false;
+  }
+  parsed.state = static_cast<heartbeat::SlaveState>(state);
+  status = parsed;
+  return true;
+}
+
+size_t encodeNavBatch(uint32_t node, uint8_t frames, const uint8_t *stream,
+                      size_t length, char *out, size_t size) {
+  if (length > NAV_BATCH_CAPACITY) {
+    return 0;
+  }
+  uint8_t frame[HEADER_SIZE + 5 + NAV_BATCH_CAPACITY];
+  Writer writer(Type::NAV_BATCH, frame, sizeof(frame));
+  writer.u32(node).u8(frames).bytes(stream, length);
+  return armored(writer, frame, out, size);
+}
+
+bool readNavBatch(Reader &payload, NavBatch &batch) {
+  NavBatch parsed;
+  parsed.node = payload.u32();
+  parsed.frames = payload.u8();
+  if (!payload.ok() || payload.remaining() > NAV_BATCH_CAPACITY) {
+    return false;
+  }
+  parsed.stream = payload.data();
+  parsed.length = payload.remaining();
+  batch = parsed;
+  return true;
+}
+} // namespace mesh_proto
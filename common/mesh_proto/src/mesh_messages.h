@@ -0,0 +1,72 @@
+#pragma once
+
+#include "mesh_proto.h"
+
+#include <beacon_power.h>
+#include <clock_sync.h>
+#include <heartbeat.h>
+#include <nav_line.h>
+
+// Payload layouts of the typed messages. Each encode* writes a whole
+// armored frame, ready for Communication::sendMessage(), and returns its
+// length (0 if it does not fit); each read* takes the payload Reader a
+// Dispatcher handler is given and returns false if a field is out of range.
+namespace mesh_proto {
+// Any frame of this library armored, with its terminator.
+constexpr size_t MESSAGE_CAPACITY = 64;
+
+// Payload-less types (the charge protocol, reserved in mesh_proto.h).
+size_t encodeSignal(Type type, char *out, size_t size);
+
+// [node:4][seq:4][sent_us:8]
+size_t encodeClockRequest(const clock_sync::ClockRequest &request, char *out,
+                          size_t size);
+bool readClockRequest(Reader &payload, clock_sync::ClockRequest &request);
+
+// [node:4][seq:4][request_sent_us:8][received_us:8][sent_us:8]
+// Answers `request`; receivedUs and sentUs are the master's clock.
+size_t encodeClockResponse(const clock_sync::ClockRequest &request,
+                           uint64_t receivedUs, uint64_t sentUs, char *out,
+                           size_t size);
+bool readClockResponse(Reader &payload, clock_sync::ClockResponse &response);
+
+// [node:4][duty:2][signal:4][saturated:2][ticks:2]
+size_t encodeBeaconReport(const beacon_power::BeaconReport &report, char *out,
+                          size_t size);
+bool readBeaconReport(Reader &payload, beacon_power::BeaconReport &report);
+
+// [duty:2], then [master:4] if the master gives its node id. Slaves
+// remember that id across reboots, so they know the master before it is
+// heard from again.
+size_t encodeBeaconDuty(uint16_t duty, char *out, size_t size);
+size_t encodeBeaconDuty(uint16_t duty, uint32_t master, char *out,
+                        size_t size);
+bool readBeaconDuty(Reader &payload, uint16_t &duty);
+// `master` is 0 for a frame without it.
+bool readBeaconDuty(Reader &payload, uint16_t &duty, uint32_t &master);
+
+// [node:4][seq:2][state:1][flags:1][state_age_ms:4][battery_mv:2]
+// [theta_centideg:2][duty:2][signal:4][saturated:2][ticks:2], then
+// [charge_remaining_s:2][charge_percent:1] with FLAG_CHARGE_ESTIMATE and
+// [boot_id:2] with FLAG_BOOT_ID, in that order.
+// The report fields are zero without FLAG_REPORT; its node is the sender's.
+// Frames from slaves without the charge estimate or boot id read as unknown.
+size_t encodeHeartbeat(const heartbeat::Status &status, char *out,
+                       size_t size);
+bool readHeartbeat(Reader &payload, heartbeat::Status &status);
+
+// [node:4][frames:1][nav stream:..NAV_BATCH_CAPACITY]
+// The stream is NavLineWriter::take() output; armored it needs up to
+// TEXT_CAPACITY.
+constexpr size_t NAV_BATCH_CAPACITY = NavLineWriter::PAYLOAD_CAPACITY;
+struct NavBatch {
+  uint32_t node = 0;
+  uint8_t frames = 0;
+  // Points into the payload the batch was read from.
+  const uint8_t *stream = nullptr;
+  size_t length = 0;
+};
+size_t encodeNavBatch(uint32_t node, uint8_t frames, const uint8_t *stream,
+                      size_t length, char *out, size_t size);
+bool readNavBatch(Reader &payload, NavBatch &batch);
+} // namespace mesh_proto
@@ -0,0 +1,265 @@
+#include "mesh_proto.h"
+
+#include <base64.h>
+#include <string.h>
+
+namespace mesh_proto {
+namespace {
+struct TypeInfo {
+  uint8_t size;
+  const char *name;
+  // Optional trailing fields, bytes past `size`.
+  uint8_t optional;
+};
+
+// Indexed by tag; keep in step with Type.
+const TypeInfo TYPES[TYPE_COUNT] = {
+    {INVALID, "invalid", 0},
+    {0, "request_charge", 0},
+    {0, "stop_charge", 0},
+    {0, "notify_work", 0},
+    {0, "notify_walk_to_charge", 0},
+    {0, "notify_in_wait", 0},
+    {0, "notify_walk_into_charge", 0},
+    {0, "notify_in_charge", 0},
+    {0, "notify_exit_charge", 0},
+    {0, "enjoin_charge", 0},
+    {0, "cancel_charge", 0},
+    {VARIABLE, "log", 0},
+    {16, "clock_request", 0},
+    {32, "clock_response", 0},
+    {14, "beacon_report", 0},
+    {2, "beacon_duty", 4},
+    {26, "heartbeat", 5},
+    {VARIABLE, "nav_batch", 0},
+};
+} // namespace
+
+uint8_t payloadSize(Type type) {
+  const size_t tag = static_cast<size_t>(type);
+  return tag < TYPE_COUNT ? TYPES[tag].size : INVALID;
+}
+
+uint8_t optionalSize(Type type) {
+  const size_t tag = static_cast<size_t>(type);
+  return tag < TYPE_COUNT ? TYPES[tag].optional : 0;
+}
+
+const char *typeName(Type type) {
+  const size_t tag = static_cast<size_t>(type);
+  return tag < TYPE_COUNT ? TYPES[tag].name : "unknown";
+}
+
+Writer::Writer(Type type, uint8_t *buffer, size_t capacity)
+    : buffer_(buffer), capacity_(capacity), ok_(capacity >= HEADER_SIZE) {
+  if (ok_) {
+    buffer_[0] = VERSION;
+    buffer_[1] = static_cast<uint8_t>(type);
+    length_ = HEADER_SIZE;
+  }
+}
+
+bool Writer::reserve(size_t length) {
+  if (!ok_ || capacity_ - length_ < length) {
+    ok_ = false;
+    return false;
+  }
+  return true;
+}
+
+Writer &Writer::u8(uint8_t value) {
+  if (reserve(1)) {
+    buffer_[length_++] = value;
+  }
+  return *this;
+}
+
+Writer &Writer::u16(uint16_t value) {
+  if (reserve(2)) {
+    buffer_[length_++] = static_cast<uint8_t>(value);
+    buffer_[length_++] = static_cast<uint8_t>(value >> 8);
+  }
+  return *this;
+}
+
+Writer &Writer::u32(uint32_t value) {
+  if (reserve(4)) {
+    for (uint8_t i = 0; i < 4; ++i) {
+      buffer_[length_++] = static_cast<uint8_t>(value >> (8 * i));
+    }
+  }
+  return *this;
+}
+
+Writer &Writer::u64(uint64_t value) {
+  if (reserve(8)) {
+    for (uint8_t i = 0; i < 8; ++i) {
+      buffer_[length_++] = static_cast<uint8_t>(value >> (8 * i));
+    }
+  }
+  return *this;
+}
+
+Writer &Writer::bytes(const void *data, size_t length) {
+  if (reserve(length)) {
+    memcpy(buffer_ + length_, data, length);
+    length_ += length;
+  }
+  return *this;
+}
+
+bool Writer::ok() const { return ok_; }
+
+size_t Writer::length() const { return ok_ ? length_ : 0; }
+
+Reader::Reader(const uint8_t *payload, size_t length)
+    : payload_(payload), length_(length) {}
+
+bool Reader::take(size_t length) {
+  if (!ok_ || length_ - offset_ < length) {
+    ok_ = false;
+    return false;
+  }
+  return true;
+}
+
+uint8_t Reader::u8() { return take(1) ? payload_[offset_++] : 0; }
+
+uint16_t Reader::u16() {
+  if (!take(2)) {
+    return 0;
+  }
+  const uint16_t value = static_cast<uint16_t>(
+      payload_[offset_] | (static_cast<uint16_t>(payload_[offset_ + 1]) << 8));
+  offset_ += 2;
+  return value;
+}
+
+uint32_t Reader::u32() {
+  if (!take(4)) {
+    return 0;
+  }
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+    value |= static_cast<uint32_t>(payload_[offset_++]) << (8 * i);
+  }
+  return value;
+}
+
+uint64_t Reader::u64() {
+  if (!take(8)) {
+    return 0;
+  }
+  uint64_t value = 0;
+  for (uint8_t i = 0; i < 8; ++i) {
+    value |= static_cast<uint64_t>(payload_[offset_++]) << (8 * i);
+  }
+  return value;
+}
+
+const uint8_t *Reader::data() const { return payload_ + offset_; }
+
+size_t Reader::remaining() const { return length_ - offset_; }
+
+bool Reader::ok() const { return ok_; }
+
+size_t armor(const uint8_t *frame, size_t length, char *out, size_t size) {
+  if (length == 0 || size < 2) {
+    return 0;
+  }
+  out[0] = TEXT_MARK;
+  const size_t encoded = base64::encode(frame, length, out + 1, size - 1);
+  return encoded > 0 ? encoded + 1 : 0;
+}
+
+size_t unarmor(const char *text, size_t length, uint8_t *out, size_t size) {
+  if (length < 2 || text[0] != TEXT_MARK) {
+    return 0;
+  }
+  return base64::decode(text + 1, length - 1, out, size);
+}
+
+const char *dispatchStatusName(DispatchStatus status) {
+  switch (status) {
+  case DispatchStatus::HANDLED:
+    return "handled";
+  case DispatchStatus::NOT_A_FRAME:
+    return "not_a_frame";
+  case DispatchStatus::BAD_VERSION:
+    return "bad_version";
+  case DispatchStatus::UNKNOWN_TYPE:
+    return "unknown_type";
+  case DispatchStatus::BAD_LENGTH:
+    return "bad_length";
+  case DispatchStatus::NO_HANDLER:
+    return "no_handler";
+  }
+  return "unknown";
+}
+
+Dispatcher::Dispatcher() {
+  for (size_t i = 0; i < TYPE_COUNT; ++i) {
+    table_[i].handler = nullptr;
+    table_[i].context = nullptr;
+  }
+}
+
+bool Dispatcher::on(Type type, Handler handler, void *context) {
+  const size_t tag = static_cast<size_t>(type);
+  if (tag == 0 || tag >= TYPE_COUNT) {
+    return false;
+  }
+  table_[tag].handler = handler;
+  table_[tag].context = context;
+  return true;
+}
+
+DispatchStatus Dispatcher::dispatch(const Envelope &envelope,
+                                    const uint8_t *frame,
+                                    size_t length) const {
+  if (length < HEADER_SIZE) {
+    return DispatchStatus::NOT_A_FRAME;
+  }
+  if (frame[0] != VERSION) {
+    return DispatchStatus::BAD_VERSION;
+  }
+  const uint8_t tag = frame[1];
+  if (tag == 0 || tag >= TYPE_COUNT) {
+    return DispatchStatus::UNKNOWN_TYPE;
+  }
+  const size_t payload = length - HEADER_SIZE;
+  const uint8_t size = TYPES[tag].size;
+  if (size != VARIABLE &&
+      (payload < size || payload > size + TYPES[tag].optional)) {
+    return DispatchStatus::BAD_LENGTH;
+  }
+  const Entry &entry = table_[tag];
+  if (entry.handler == nullptr) {
+    return DispatchStatus::NO_HANDLER;
+  }
+  Reader reader(frame + HEADER_SIZE, payload);
+  entry.handler(entry.context, envelope, reader);
+  return DispatchStatus::HANDLED;
+}
+
+DispatchStatus Dispatcher::dispatchText(const Envelope &envelope,
+                                        const char *text,
+                                        size_t length) const {
+  if (length == 0 || text[0] != TEXT_MARK) {
+    return DispatchStatus::NOT_A_FRAME;
+  }
+  // The first base64 quantum holds version and tag.
+  uint8_t header[3];
+  if (length > 4 && base64::decode(text + 1, 4, header, sizeof(header)) == 3 &&
+      header[0] == VERSION && header[1] != 0 && header[1] < TYPE_COUNT &&
+      table_[header[1]].handler == nullptr) {
+    return DispatchStatus::NO_HANDLER;
+  }
+  uint8_t frame[MAX_FRAME];
+  const size_t decoded = unarmor(text, length, frame, sizeof(frame));
+  if (decoded == 0) {
+    return DispatchStatus::NOT_A_FRAME;
+  }
+  return dispatch(envelope, frame, decoded);
+}
+} // namespace mesh_proto
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary mesh messages. A frame is
+//
+//   [version:1][type:1][payload]
+//
+// with a fixed payload layout per type (little-endian fields), so a
+// receiver checks the length once and reads fields at known offsets.
+// Dispatch is one table lookup by type instead of comparing strings.
+//
+// painlessMesh carries text, so frames travel armored: TEXT_MARK followed
+// by the base64 of the frame. The mark tells them apart from the remaining
+// text messages with a single character compare.
+namespace mesh_proto {
+constexpr uint8_t VERSION = 1;
+constexpr size_t HEADER_SIZE = 2;
+constexpr char TEXT_MARK = '~';
+
+// Tags are dense so the dispatch table stays small. Never reuse or
+// renumber one; retire it and append instead.
+enum class Type : uint8_t {
+  // Charge protocol of the dezibot Master/Slave classes. No payload.
+  // Reserved: those classes still send it as their own text messages, so
+  // no firmware sends or handles tags 1-11 yet; only the benches use them
+  // as traffic. They keep their numbers for when it moves to frames.
+  REQUEST_CHARGE = 1,
+  STOP_CHARGE = 2,
+  NOTIFY_WORK = 3,
+  NOTIFY_WALK_TO_CHARGE = 4,
+  NOTIFY_IN_WAIT = 5,
+  NOTIFY_WALK_INTO_CHARGE = 6,
+  NOTIFY_IN_CHARGE = 7,
+  NOTIFY_EXIT_CHARGE = 8,
+  ENJOIN_CHARGE = 9,
+  CANCEL_CHARGE = 10,
+  // A log line for the master to relay; the payload is the text.
+  // Reserved like the charge protocol: slaves still relay their lines as
+  // "log:" text messages.
+  LOG = 11,
+  // common/clock_sync
+  CLOCK_REQUEST = 12,
+  CLOCK_RESPONSE = 13,
+  // common/beacon_power
+  BEACON_REPORT = 14,
+  BEACON_DUTY = 15,
+  // common/heartbeat
+  HEARTBEAT = 16,
+  // A batch of the slave's navigation frames (common/telemetry).
+  NAV_BATCH = 17,
+  COUNT
+};
+constexpr size_t TYPE_COUNT = static_cast<size_t>(Type::COUNT);
+
+// Payload size of each type; VARIABLE for LOG and NAV_BATCH, INVALID for
+// tag 0. A type may end in optional fields that older senders leave out:
+// its payload is payloadSize() up to payloadSize() + optionalSize() bytes.
+constexpr uint8_t VARIABLE = 0xFE;
+constexpr uint8_t INVALID = 0xFF;
+uint8_t payloadSize(Type type);
+uint8_t optionalSize(Type type);
+const char *typeName(Type type);
+
+// Largest frame: a LOG line as long as the navz uplink batches.
+constexpr size_t MAX_FRAME = 256;
+// TEXT_MARK, base64 of MAX_FRAME and the terminator.
+constexpr size_t TEXT_CAPACITY = 1 + ((MAX_FRAME + 2) / 3) * 4 + 1;
+
+// Writes one frame. Every write past the capacity is dropped and clears
+// ok(), so callers check once at the end.
+class Writer {
+public:
+  Writer(Type type, uint8_t *buffer, size_t capacity);
+
+  Writer &u8(uint8_t value);
+  Writer &u16(uint16_t value);
+  Writer &u32(uint32_t value);
+  Writer &u64(uint64_t value);
+  Writer &bytes(const void *data, size_t length);
+
+  bool ok() const;
+  // Frame length, 0 if anything did not fit.
+  size_t length() const;
+
+private:
+  bool reserve(size_t length);
+
+  uint8_t *buffer_;
+  size_t capacity_;
+  size_t length_ = 0;
+  bool ok_;
+};
+
+// Reads a payload. Reads past the end return 0 and clear ok().
+class Reader {
+public:
+  Reader(const uint8_t *payload, size_t length);
+
+  uint8_t u8();
+  uint16_t u16();
+  uint32_t u32();
+  uint64_t u64();
+  const uint8_t *data() const;
+  size_t remaining() const;
+  bool ok() const;
+
+private:
+  bool take(size_t length);
+
+  const uint8_t *payload_;
+  size_t length_;
+  size_t offset_ = 0;
+  bool ok_ = true;
+};
+
+// Both return the length written, 0 if it does not fit or (unarmor) the
+// text is not an armored frame.
+size_t armor(const uint8_t *frame, size_t length, char *out, size_t size);
+size_t unarmor(const char *text, size_t length, uint8_t *out, size_t size);
+
+// What the receiving callback knows about a message.
+struct Envelope {
+  // Sender for unicasts, 0 for broadcasts (the mesh does not say).
+  uint32_t from = 0;
+  // Receiver's clock when the callback ran, for timestamped exchanges.
+  uint64_t receivedUs = 0;
+};
+
+enum class DispatchStatus : uint8_t {
+  HANDLED,
+  NOT_A_FRAME,
+  BAD_VERSION,
+  UNKNOWN_TYPE,
+  BAD_LENGTH,
+  NO_HANDLER
+};
+const char *dispatchStatusName(DispatchStatus status);
+
+typedef void (*Handler)(void *context, const Envelope &envelope,
+                        Reader &payload);
+
+class Dispatcher {
+public:
+  Dispatcher();
+
+  // Replaces the handler for `type`; false for tag 0 or out of range.
+  bool on(Type type, Handler handler, void *context = nullptr);
+  DispatchStatus dispatch(const Envelope &envelope, const uint8_t *frame,
+                          size_t length) const;
+  // NOT_A_FRAME for text that does not start with TEXT_MARK. A frame
+  // without a handler is turned away from its header, so nodes pay little
+  // for the broadcasts meant for someone else.
+  DispatchStatus dispatchText(const Envelope &envelope, const char *text,
+                              size_t length) const;
+
+private:
+  struct Entry {
+    Handler handler;
+    void *context;
+  };
+
+  Entry table_[TYPE_COUNT];
+};
+} // namespace mesh_proto
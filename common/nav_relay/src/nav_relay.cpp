@@ -0,0 +1,318 @@
+#include "nav_relay.h"
+
+#include <base64.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace nav_relay {
+namespace {
+constexpr const char *RAW_PREFIX = "wireless_log,";
+constexpr size_t RAW_PREFIX_LENGTH = 13;
+constexpr const char *RAW_TAG = ",navz,";
+constexpr size_t RAW_TAG_LENGTH = 6;
+// Longest decimal node id.
+constexpr size_t NODE_DIGITS = 10;
+constexpr int32_t CENTI_DEG_TURN = 36000;
+
+int32_t wrapCentiDeg(int32_t value) {
+  value %= CENTI_DEG_TURN;
+  if (value >= CENTI_DEG_TURN / 2) {
+    value -= CENTI_DEG_TURN;
+  } else if (value < -CENTI_DEG_TURN / 2) {
+    value += CENTI_DEG_TURN;
+  }
+  return value;
+}
+
+void start(Range &range, int32_t value) {
+  range.min = value;
+  range.max = value;
+  range.sum = value;
+}
+
+void extend(Range &range, int32_t value) {
+  range.min = value < range.min ? value : range.min;
+  range.max = value > range.max ? value : range.max;
+  range.sum += value;
+}
+
+int32_t mean(const Range &range, uint16_t count) {
+  if (count == 0) {
+    return 0;
+  }
+  const int64_t half = range.sum < 0 ? -(count / 2) : count / 2;
+  return static_cast<int32_t>((range.sum + half) / count);
+}
+
+uint16_t addSaturating(uint16_t value, uint32_t add) {
+  const uint32_t sum = value + add;
+  return sum > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(sum);
+}
+} // namespace
+
+TokenBucket::TokenBucket(uint32_t ratePerS, uint32_t burst)
+    : ratePerS_(ratePerS), burstMilli_(static_cast<uint64_t>(burst) * 1000U),
+      levelMilli_(burstMilli_) {}
+
+void TokenBucket::refill(uint32_t now) {
+  if (!started_) {
+    started_ = true;
+    lastRefillMs_ = now;
+    return;
+  }
+  // ratePerS tokens per second are ratePerS milli-tokens per ms.
+  const uint64_t gained =
+      static_cast<uint64_t>(now - lastRefillMs_) * ratePerS_;
+  lastRefillMs_ = now;
+  levelMilli_ = levelMilli_ + gained > burstMilli_ ? burstMilli_
+                                                   : levelMilli_ + gained;
+}
+
+bool TokenBucket::take(uint32_t cost, uint32_t now) {
+  refill(now);
+  const uint64_t costMilli = static_cast<uint64_t>(cost) * 1000U;
+  if (costMilli > levelMilli_) {
+    return false;
+  }
+  levelMilli_ -= costMilli;
+  return true;
+}
+
+uint32_t TokenBucket::available(uint32_t now) {
+  refill(now);
+  return static_cast<uint32_t>(levelMilli_ / 1000U);
+}
+
+size_t formatSummary(const WindowSummary &summary, char *out, size_t size) {
+  const int32_t thetaMin = wrapCentiDeg(summary.thetaCentiDeg.min);
+  const int32_t thetaMean =
+      wrapCentiDeg(mean(summary.thetaCentiDeg, summary.frames));
+  const int32_t thetaMax = wrapCentiDeg(summary.thetaCentiDeg.max);
+  const int written = snprintf(
+      out, size,
+      "nav_win,%lu,%lu,%lu,%u,%u,%u,%u,%.1f,%.1f,%.1f,%.2f,%.2f,%.2f,%ld,%ld,"
+      "%ld,%ld,%ld,%ld,%u\n",
+      static_cast<unsigned long>(summary.node),
+      static_cast<unsigned long>(summary.firstMs),
+      static_cast<unsigned long>(summary.lastMs),
+      static_cast<unsigned>(summary.frames),
+      static_cast<unsigned>(summary.lost),
+      static_cast<unsigned>(summary.detected),
+      static_cast<unsigned>(summary.search),
+      static_cast<double>(summary.signalDeci.min) * 0.1,
+      static_cast<double>(mean(summary.signalDeci, summary.frames)) * 0.1,
+      static_cast<double>(summary.signalDeci.max) * 0.1,
+      static_cast<double>(thetaMin) * 0.01,
+      static_cast<double>(thetaMean) * 0.01,
+      static_cast<double>(thetaMax) * 0.01,
+      static_cast<long>(summary.dutyLeft.min),
+      static_cast<long>(mean(summary.dutyLeft, summary.frames)),
+      static_cast<long>(summary.dutyLeft.max),
+      static_cast<long>(summary.dutyRight.min),
+      static_cast<long>(mean(summary.dutyRight, summary.frames)),
+      static_cast<long>(summary.dutyRight.max),
+      static_cast<unsigned>(summary.refused));
+  if (written <= 0 || static_cast<size_t>(written) >= size) {
+    return 0;
+  }
+  return static_cast<size_t>(written);
+}
+
+size_t rawLineBytes(size_t streamLength) {
+  return RAW_PREFIX_LENGTH + NODE_DIGITS + RAW_TAG_LENGTH +
+         base64::encodedLength(streamLength) + 1;
+}
+
+size_t formatRaw(uint32_t node, const uint8_t *stream, size_t length,
+                 char *out, size_t size) {
+  const int head = snprintf(out, size, "%s%lu%s", RAW_PREFIX,
+                            static_cast<unsigned long>(node), RAW_TAG);
+  if (head <= 0 || static_cast<size_t>(head) >= size) {
+    return 0;
+  }
+  size_t used = static_cast<size_t>(head);
+  // Room for the newline that replaces the terminator, plus a new one.
+  if (size - used < 2) {
+    return 0;
+  }
+  const size_t encoded =
+      base64::encode(stream, length, out + used, size - used - 1);
+  if (encoded == 0 && length > 0) {
+    return 0;
+  }
+  used += encoded;
+  out[used++] = '\n';
+  out[used] = '\0';
+  return used;
+}
+
+NavRelay::NavRelay(const RelayConfig &config)
+    : config_(config), link_(config.linkBytesPerS, config.linkBurstBytes) {}
+
+void NavRelay::setPassthrough(uint32_t node) {
+  const uint32_t previous = passthrough_;
+  passthrough_ = node;
+  for (Slave &slave : slaves_) {
+    if (slave.node == 0 || (slave.node != previous && slave.node != node)) {
+      continue;
+    }
+    slave.bucket = slave.node == node
+                       ? TokenBucket(config_.passthroughBytesPerS,
+                                     config_.passthroughBurstBytes)
+                       : TokenBucket(config_.slaveBytesPerS,
+                                     config_.slaveBurstBytes);
+  }
+}
+
+uint32_t NavRelay::passthrough() const { return passthrough_; }
+
+NavRelay::Slave *NavRelay::slaveFor(uint32_t node, uint32_t now) {
+  Slave *free = nullptr;
+  for (Slave &slave : slaves_) {
+    if (slave.node == node) {
+      return &slave;
+    }
+    // An idle slave's slot is reused once its last window went out.
+    if (free == nullptr &&
+        (slave.node == 0 ||
+         (!slave.open && now - slave.lastHeardMs >= config_.idleMs))) {
+      free = &slave;
+    }
+  }
+  if (free == nullptr) {
+    return nullptr;
+  }
+  *free = Slave();
+  free->node = node;
+  free->bucket = node == passthrough_
+                     ? TokenBucket(config_.passthroughBytesPerS,
+                                   config_.passthroughBurstBytes)
+                     : TokenBucket(config_.slaveBytesPerS,
+                                   config_.slaveBurstBytes);
+  return free;
+}
+
+void NavRelay::add(Slave &slave, const NavFrame &frame) {
+  WindowSummary &window = slave.window;
+  const int32_t signal = static_cast<int32_t>(frame.signalDeci);
+  if (window.frames == 0) {
+    window.firstMs = frame.tMs;
+    start(window.signalDeci, signal);
+    start(window.thetaCentiDeg, frame.thetaCentiDeg);
+    slave.thetaReference = frame.thetaCentiDeg;
+    start(window.dutyLeft, frame.dutyLeft);
+    start(window.dutyRight, frame.dutyRight);
+  } else {
+    // Unwrapped around the window's first bearing.
+    const int32_t reference = slave.thetaReference;
+    extend(window.thetaCentiDeg,
+           reference + wrapCentiDeg(frame.thetaCentiDeg - reference));
+    extend(window.signalDeci, signal);
+    extend(window.dutyLeft, frame.dutyLeft);
+    extend(window.dutyRight, frame.dutyRight);
+  }
+  window.lastMs = frame.tMs;
+  window.frames = addSaturating(window.frames, 1);
+  window.detected = addSaturating(
+      window.detected, (frame.flags & NavFrame::FLAG_DETECTED) != 0 ? 1 : 0);
+  window.search = addSaturating(
+      window.search, (frame.flags & NavFrame::FLAG_SEARCH) != 0 ? 1 : 0);
+}
+
+uint32_t NavRelay::openWindows() const {
+  uint32_t open = 0;
+  for (const Slave &slave : slaves_) {
+    open += slave.open ? 1 : 0;
+  }
+  return open;
+}
+
+bool NavRelay::onBatch(uint32_t node, const uint8_t *stream, size_t length,
+                       uint32_t now) {
+  batches_++;
+  Slave *slave = slaveFor(node, now);
+  if (slave == nullptr) {
+    untracked_++;
+    return false;
+  }
+  slave->lastHeardMs = now;
+  if (!slave->open) {
+    slave->open = true;
+    slave->openedAtMs = now;
+    slave->window = WindowSummary();
+    slave->window.node = node;
+  }
+
+  // A raw line is only any use to a reader that missed the ones before it
+  // if it carries a keyframe.
+  bool keyframe = false;
+  size_t offset = 0;
+  while (offset < length) {
+    NavFrame frame;
+    size_t used = 0;
+    const NavDecodeStatus status =
+        slave->decoder.decode(stream + offset, length - offset, frame, used);
+    if (status == NavDecodeStatus::MALFORMED) {
+      malformed_++;
+      break;
+    }
+    offset += used;
+    if (status == NavDecodeStatus::FRAME) {
+      keyframe = keyframe || slave->decoder.keyframe();
+      add(*slave, frame);
+    }
+  }
+  const uint32_t lost = slave->decoder.lostFrames();
+  slave->window.lost = addSaturating(slave->window.lost,
+                                     lost - slave->lostBefore);
+  slave->lostBefore = lost;
+
+  const bool selected = node == passthrough_;
+  if (!selected && !keyframe) {
+    return false;
+  }
+  // The selected slave comes before the summaries; other raw lines only
+  // get what the summaries still due leave of the link.
+  const uint32_t cost = static_cast<uint32_t>(rawLineBytes(length));
+  const uint32_t reserve = selected ? 0 : openWindows() * SUMMARY_COST_BYTES;
+  if (slave->bucket.available(now) < cost ||
+      link_.available(now) < cost + reserve) {
+    refused_++;
+    slave->window.refused = addSaturating(slave->window.refused, 1);
+    return false;
+  }
+  slave->bucket.take(cost, now);
+  link_.take(cost, now);
+  relayed_++;
+  return true;
+}
+
+bool NavRelay::poll(uint32_t now, WindowSummary &summary) {
+  for (uint8_t i = 0; i < MAX_SLAVES; ++i) {
+    Slave &slave = slaves_[(cursor_ + i) % MAX_SLAVES];
+    if (!slave.open || now - slave.openedAtMs < config_.windowMs) {
+      continue;
+    }
+    if (!link_.take(SUMMARY_COST_BYTES, now)) {
+      return false;
+    }
+    // The next poll starts after this slave, so none waits behind a busy one.
+    cursor_ = static_cast<uint8_t>((cursor_ + i + 1) % MAX_SLAVES);
+    slave.open = false;
+    summary = slave.window;
+    return true;
+  }
+  return false;
+}
+
+uint32_t NavRelay::batches() const { return batches_; }
+
+uint32_t NavRelay::relayed() const { return relayed_; }
+
+uint32_t NavRelay::refused() const { return refused_; }
+
+uint32_t NavRelay::untracked() const { return untracked_; }
+
+uint32_t NavRelay::malformed() const { return malformed_; }
+} // namespace nav_relay
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <nav_frame.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// The master's relay of the slaves' navigation telemetry to its serial
+// port. Every walking slave streams a NAV_BATCH (common/mesh_proto) five
+// times a second; relayed line by line, a few of them fill the serial link
+// and the charge control lines queue behind them. Instead every slave's
+// frames are folded into one summary line per window (min/mean/max of
+// signal, bearing and duties), and raw batches are relayed only as fast as
+// token buckets allow: a small one per slave, a larger one for a single
+// selected slave, and one for the whole relay that keeps part of the link
+// free for everything else. The selected slave's lines go first, then the
+// summaries; other raw lines only use what the pending summaries leave,
+// and only batches with a keyframe qualify, so a reader can decode every
+// raw line it gets.
+namespace nav_relay {
+// Admits `cost` units (serial bytes here) at ratePerS on average, up to
+// `burst` at once. Starts full.
+class TokenBucket {
+public:
+  explicit TokenBucket(uint32_t ratePerS = 0, uint32_t burst = 0);
+
+  bool take(uint32_t cost, uint32_t now);
+  uint32_t available(uint32_t now);
+
+private:
+  void refill(uint32_t now);
+
+  uint32_t ratePerS_;
+  // In 1/1000 tokens, so slow rates still refill between frequent calls.
+  uint64_t burstMilli_;
+  uint64_t levelMilli_;
+  bool started_ = false;
+  uint32_t lastRefillMs_ = 0;
+};
+
+struct Range {
+  int32_t min = 0;
+  int32_t max = 0;
+  int64_t sum = 0;
+};
+
+struct WindowSummary {
+  uint32_t node = 0;
+  // Slave clock of the first and last frame.
+  uint32_t firstMs = 0;
+  uint32_t lastMs = 0;
+  uint16_t frames = 0;
+  // Frames missing from the stream (mesh losses), and frames with the
+  // beacon detected or in search mode.
+  uint16_t lost = 0;
+  uint16_t detected = 0;
+  uint16_t search = 0;
+  // Raw batches of this slave the buckets turned away.
+  uint16_t refused = 0;
+  // NavFrame units: signal in 0.1 counts, bearing in 0.01 deg. The bearing
+  // is unwrapped around the window's first frame, so its min/max/mean stay
+  // right across +-180 deg; the formatted line wraps them back.
+  Range signalDeci;
+  Range thetaCentiDeg;
+  Range dutyLeft;
+  Range dutyRight;
+};
+
+// `nav_win,<from>,<t0_ms>,<t1_ms>,<frames>,<lost>,<detected>,<search>,
+// <S min,mean,max>,<theta_deg min,mean,max>,<duty_l min,mean,max>,
+// <duty_r min,mean,max>,<refused>`, newline-terminated.
+constexpr size_t SUMMARY_CAPACITY = 192;
+size_t formatSummary(const WindowSummary &summary, char *out, size_t size);
+
+// `wireless_log,<from>,navz,<base64>`, newline-terminated: the line the
+// master relayed for every batch before, read by tools/nav_decode and the
+// dashboard.
+size_t rawLineBytes(size_t streamLength);
+size_t formatRaw(uint32_t node, const uint8_t *stream, size_t length,
+                 char *out, size_t size);
+
+struct RelayConfig {
+  uint32_t windowMs = 1000;
+  // The whole relay. The master's 115200 baud link carries 11520 B/s; the
+  // rest is left to control and state lines.
+  uint32_t linkBytesPerS = 6000;
+  uint32_t linkBurstBytes = 1500;
+  // Raw lines of any one slave: the keyframe batches, about one a second.
+  uint32_t slaveBytesPerS = 300;
+  uint32_t slaveBurstBytes = 600;
+  // Raw lines of the selected slave: every batch.
+  uint32_t passthroughBytesPerS = 2000;
+  uint32_t passthroughBurstBytes = 1000;
+  // A slave not heard from for this long gives up its slot.
+  uint32_t idleMs = 10000;
+};
+
+class NavRelay {
+public:
+  // Slaves walking at the same time; a batch from one more is dropped.
+  static constexpr uint8_t MAX_SLAVES = 32;
+  // What a summary line is charged against the link bucket.
+  static constexpr uint32_t SUMMARY_COST_BYTES = 130;
+
+  explicit NavRelay(const RelayConfig &config = RelayConfig());
+
+  // Relays every batch of `node` at full fidelity; 0 selects none.
+  void setPassthrough(uint32_t node);
+  uint32_t passthrough() const;
+
+  // Folds a batch into its slave's window. Returns true when the batch is
+  // also to be relayed raw (formatRaw()).
+  bool onBatch(uint32_t node, const uint8_t *stream, size_t length,
+               uint32_t now);
+  // Returns one window that has ended, if the link bucket admits it. A
+  // window that is not admitted keeps collecting until it is.
+  bool poll(uint32_t now, WindowSummary &summary);
+
+  uint32_t batches() const;
+  uint32_t relayed() const;
+  uint32_t refused() const;
+  uint32_t untracked() const;
+  // Batches with an undecodable frame; the rest of such a batch is lost.
+  uint32_t malformed() const;
+
+private:
+  struct Slave {
+    uint32_t node = 0;
+    NavStreamDecoder decoder;
+    TokenBucket bucket;
+    uint32_t lastHeardMs = 0;
+    uint32_t lostBefore = 0;
+    bool open = false;
+    uint32_t openedAtMs = 0;
+    int16_t thetaReference = 0;
+    WindowSummary window;
+  };
+
+  Slave *slaveFor(uint32_t node, uint32_t now);
+  void add(Slave &slave, const NavFrame &frame);
+  uint32_t openWindows() const;
+
+  RelayConfig config_;
+  TokenBucket link_;
+  Slave slaves_[MAX_SLAVES];
+  uint32_t passthrough_ = 0;
+  uint8_t cursor_ = 0;
+  uint32_t batches_ = 0;
+  uint32_t relayed_ = 0;
+  uint32_t refused_ = 0;
+  uint32_t untracked_ = 0;
+  uint32_t malformed_ = 0;
+};
+} // namespace nav_relay
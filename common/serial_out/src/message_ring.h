@@ -0,0 +1,220 @@
+#pragma once
+
+#include <atomic>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+enum class OverflowPolicy : uint8_t {
+  // Keep what is queued; the new message is dropped.
+  DROP_NEWEST,
+  // Evict the oldest queued message to make room (keeps the log current).
+  DROP_OLDEST
+};
+
+// Bounded lock-free multi-producer queue of text messages (Vyukov-style
+// sequence per slot). Producers format straight into a claimed slot and
+// never wait: when the ring is full the overflow policy decides what is
+// lost, and every loss is counted. Messages longer than SlotSize are
+// truncated.
+template <uint16_t SlotCount, uint16_t SlotSize> class MessageRing {
+  static_assert(SlotCount >= 2 && (SlotCount & (SlotCount - 1)) == 0,
+                "MessageRing slot count must be a power of two");
+  static_assert(SlotSize >= 16, "MessageRing slots are too small");
+
+public:
+  static constexpr uint16_t SLOT_COUNT = SlotCount;
+  static constexpr uint16_t SLOT_SIZE = SlotSize;
+
+  explicit MessageRing(OverflowPolicy policy = OverflowPolicy::DROP_OLDEST)
+      : policy_(policy) {
+    for (uint32_t i = 0; i < SlotCount; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool push(const char *text, size_t length) {
+    Slot *slot = claim();
+    if (slot == nullptr) {
+      return false;
+    }
+    if (length > SlotSize) {
+      length = SlotSize;
+      truncated_.fetch_add(1, std::memory_order_relaxed);
+    }
+    memcpy(slot->data, text, length);
+    slot->length = static_cast<uint16_t>(length);
+    publish(slot);
+    return true;
+  }
+
+  bool push(const char *text) { return push(text, strlen(text)); }
+
+  bool vprintf(const char *format, va_list args) {
+    Slot *slot = claim();
+    if (slot == nullptr) {
+      return false;
+    }
+    // One extra byte for the terminator vsnprintf always writes.
+    char *out = slot->data;
+    const int written = vsnprintf(out, SlotSize + 1, format, args);
+    if (written < 0) {
+      slot->length = 0;
+    } else if (written > SlotSize) {
+      slot->length = SlotSize;
+      truncated_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      slot->length = static_cast<uint16_t>(written);
+    }
+    publish(slot);
+    return true;
+  }
+
+  bool printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+    va_list args;
+    va_start(args, format);
+    const bool queued = vprintf(format, args);
+    va_end(args);
+    return queued;
+  }
+
+  // Copies the oldest message into `out` (SlotSize bytes) and frees its
+  // slot. Returns the message length, or -1 if nothing is ready.
+  int pop(char *out) {
+    Slot *slot = nullptr;
+    uint32_t position = 0;
+    if (!acquireOldest(slot, position)) {
+      return -1;
+    }
+    const uint16_t length = slot->length;
+    memcpy(out, slot->data, length);
+    release(slot, position);
+    return length;
+  }
+
+  bool empty() const {
+    const uint32_t position = dequeuePosition_.load(std::memory_order_relaxed);
+    const uint32_t sequence =
+        slots_[position & (SlotCount - 1)].sequence.load(
+            std::memory_order_acquire);
+    return static_cast<int32_t>(sequence - (position + 1)) < 0;
+  }
+
+  // Claimed slots, including ones still being written; a snapshot that
+  // low-priority producers use to leave room for the others.
+  uint16_t queued() const {
+    const uint32_t used = enqueuePosition_.load(std::memory_order_relaxed) -
+                          dequeuePosition_.load(std::memory_order_relaxed);
+    return used > SlotCount ? SlotCount : static_cast<uint16_t>(used);
+  }
+
+  uint32_t droppedNewest() const {
+    return droppedNewest_.load(std::memory_order_relaxed);
+  }
+  uint32_t droppedOldest() const {
+    return droppedOldest_.load(std::memory_order_relaxed);
+  }
+  uint32_t truncated() const {
+    return truncated_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> sequence;
+    uint32_t position = 0; // owned by the producer between claim and publish
+    uint16_t length = 0;
+    char data[SlotSize + 1];
+  };
+
+  // Evicting can race with the consumer or other producers; a few rounds
+  // are enough in practice, after that the new message is dropped.
+  static constexpr uint8_t MAX_EVICTIONS = 4;
+
+  bool tryClaim(Slot *&slot) {
+    uint32_t position = enqueuePosition_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &candidate = slots_[position & (SlotCount - 1)];
+      const uint32_t sequence =
+          candidate.sequence.load(std::memory_order_acquire);
+      const int32_t diff = static_cast<int32_t>(sequence - position);
+      if (diff == 0) {
+        if (enqueuePosition_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          slot = &candidate;
+          slot->position = position;
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // full
+      } else {
+        position = enqueuePosition_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  Slot *claim() {
+    Slot *slot = nullptr;
+    if (tryClaim(slot)) {
+      return slot;
+    }
+    if (policy_ == OverflowPolicy::DROP_OLDEST) {
+      for (uint8_t i = 0; i < MAX_EVICTIONS; ++i) {
+        Slot *oldest = nullptr;
+        uint32_t position = 0;
+        if (acquireOldest(oldest, position)) {
+          release(oldest, position);
+          droppedOldest_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (tryClaim(slot)) {
+          return slot;
+        }
+      }
+    }
+    droppedNewest_.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  void publish(Slot *slot) {
+    slot->sequence.store(slot->position + 1, std::memory_order_release);
+  }
+
+  bool acquireOldest(Slot *&slot, uint32_t &position) {
+    position = dequeuePosition_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &candidate = slots_[position & (SlotCount - 1)];
+      const uint32_t sequence =
+          candidate.sequence.load(std::memory_order_acquire);
+      const int32_t diff = static_cast<int32_t>(sequence - (position + 1));
+      if (diff == 0) {
+        if (dequeuePosition_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          slot = &candidate;
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // empty, or the oldest slot is still being written
+      } else {
+        position = dequeuePosition_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void release(Slot *slot, uint32_t position) {
+    slot->sequence.store(position + SlotCount, std::memory_order_release);
+  }
+
+  OverflowPolicy policy_;
+  Slot slots_[SlotCount];
+  std::atomic<uint32_t> enqueuePosition_{0};
+  std::atomic<uint32_t> dequeuePosition_{0};
+  std::atomic<uint32_t> droppedNewest_{0};
+  std::atomic<uint32_t> droppedOldest_{0};
+  std::atomic<uint32_t> truncated_{0};
+};
+
+template <uint16_t SlotCount, uint16_t SlotSize>
+constexpr uint16_t MessageRing<SlotCount, SlotSize>::SLOT_COUNT;
+template <uint16_t SlotCount, uint16_t SlotSize>
+constexpr uint16_t MessageRing<SlotCount, SlotSize>::SLOT_SIZE;
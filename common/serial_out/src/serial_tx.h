@@ -0,0 +1,109 @@
+#pragma once
+
+#include "message_ring.h"
+
+#include <Arduino.h>
+
+// Drains a MessageRing to a Print (normally Serial) from a low-priority
+// task. A stalled or absent USB host then only blocks this task; callers on
+// the control path just format into the ring and return.
+//
+// Code that must write to the port directly (binary dumps) brackets the
+// writes with lockOutput()/unlockOutput() so lines from the task cannot end
+// up in the middle.
+template <uint16_t SlotCount, uint16_t SlotSize> class SerialTx {
+public:
+  explicit SerialTx(OverflowPolicy policy = OverflowPolicy::DROP_OLDEST)
+      : ring_(policy) {}
+
+  bool begin(Print &out, UBaseType_t priority = 1) {
+    out_ = &out;
+    outputMutex_ = xSemaphoreCreateMutex();
+    if (outputMutex_ == nullptr) {
+      return false;
+    }
+    return xTaskCreate(task, "serial_tx", TASK_STACK_SIZE, this, priority,
+                       nullptr) == pdPASS;
+  }
+
+  bool printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+    va_list args;
+    va_start(args, format);
+    const bool queued = ring_.vprintf(format, args);
+    va_end(args);
+    return queued;
+  }
+
+  bool print(const char *text) { return ring_.push(text); }
+
+  bool println(const char *text) { return printf("%s\n", text); }
+
+  void lockOutput() {
+    if (outputMutex_ != nullptr) {
+      xSemaphoreTake(outputMutex_, portMAX_DELAY);
+    }
+  }
+
+  void unlockOutput() {
+    if (outputMutex_ != nullptr) {
+      xSemaphoreGive(outputMutex_);
+    }
+  }
+
+  const MessageRing<SlotCount, SlotSize> &ring() const { return ring_; }
+
+private:
+  static constexpr uint32_t TASK_STACK_SIZE = 3072;
+  static constexpr TickType_t IDLE_POLL_TICKS = 1;
+  static constexpr uint32_t DROP_REPORT_PERIOD_MS = 1000;
+
+  static void task(void *arg) { static_cast<SerialTx *>(arg)->drain(); }
+
+  void write(const char *data, size_t length) {
+    lockOutput();
+    out_->write(reinterpret_cast<const uint8_t *>(data), length);
+    unlockOutput();
+  }
+
+  // Losses are reported in-band, at most once per second.
+  void reportDrops() {
+    const uint32_t dropped = ring_.droppedOldest() + ring_.droppedNewest();
+    const uint32_t now = millis();
+    if (dropped == reportedDrops_ ||
+        now - lastReportAtMs_ < DROP_REPORT_PERIOD_MS) {
+      return;
+    }
+    reportedDrops_ = dropped;
+    lastReportAtMs_ = now;
+    const int length = snprintf(
+        buffer_, sizeof(buffer_), "serial_out,dropped_oldest=%lu,"
+                                  "dropped_newest=%lu,truncated=%lu\n",
+        static_cast<unsigned long>(ring_.droppedOldest()),
+        static_cast<unsigned long>(ring_.droppedNewest()),
+        static_cast<unsigned long>(ring_.truncated()));
+    if (length > 0) {
+      write(buffer_, static_cast<size_t>(length) < sizeof(buffer_)
+                         ? static_cast<size_t>(length)
+                         : sizeof(buffer_) - 1);
+    }
+  }
+
+  void drain() {
+    for (;;) {
+      const int length = ring_.pop(buffer_);
+      if (length < 0) {
+        reportDrops();
+        vTaskDelay(IDLE_POLL_TICKS);
+        continue;
+      }
+      write(buffer_, static_cast<size_t>(length));
+    }
+  }
+
+  MessageRing<SlotCount, SlotSize> ring_;
+  Print *out_ = nullptr;
+  SemaphoreHandle_t outputMutex_ = nullptr;
+  char buffer_[SlotSize < 96 ? 96 : SlotSize];
+  uint32_t reportedDrops_ = 0;
+  uint32_t lastReportAtMs_ = 0;
+};
@@ -0,0 +1,341 @@
+#include "session_stats.h"
+
+#include <cstdio>
+
+namespace session_stats {
+namespace {
+using heartbeat::SlaveState;
+
+// A slave state ends where the next state seen in cycle order starts, or
+// with the return to WORK; a state that was missed counts towards the one
+// before it.
+uint32_t slaveEndMs(const SessionRecord &record, SlaveState state) {
+  for (size_t next = static_cast<size_t>(state) + 1;
+       next < heartbeat::STATE_COUNT; ++next) {
+    if (record.slaveAtMs[next] != NOT_SEEN) {
+      return record.slaveAtMs[next];
+    }
+  }
+  return record.slaveAtMs[static_cast<size_t>(SlaveState::WORK)];
+}
+
+uint32_t spanMs(uint32_t fromMs, uint32_t toMs) {
+  return fromMs == NOT_SEEN || toMs == NOT_SEEN || toMs < fromMs
+             ? NOT_SEEN
+             : toMs - fromMs;
+}
+
+// Heartbeat ages can put a transition a few ms before the session began.
+uint32_t offsetOf(const SessionRecord &session, uint32_t atMs) {
+  const int32_t offsetMs = static_cast<int32_t>(atMs - session.startedMs);
+  return offsetMs > 0 ? static_cast<uint32_t>(offsetMs) : 0;
+}
+
+size_t terminate(char *out, size_t size, size_t used) {
+  if (size - used < 2) {
+    return 0;
+  }
+  out[used++] = '\n';
+  out[used] = '\0';
+  return used;
+}
+} // namespace
+
+const char *stationStateName(StationState state) {
+  switch (state) {
+  case StationState::OPEN:
+    return "open";
+  case StationState::LOWERING_GEAR:
+    return "lowering_gear";
+  case StationState::CLOSED:
+    return "closed";
+  case StationState::ATTACHING_GEAR:
+    return "attaching_gear";
+  case StationState::SLAVE_CHARGE:
+    return "slave_charge";
+  case StationState::LIFTING_GEAR:
+    return "lifting_gear";
+  case StationState::COUNT:
+    break;
+  }
+  return "unknown";
+}
+
+const char *phaseName(Phase phase) {
+  switch (phase) {
+  case Phase::WALK:
+    return "walk";
+  case Phase::WAIT:
+    return "wait";
+  case Phase::WALK_INTO:
+    return "walk_into";
+  case Phase::CHARGE:
+    return "charge";
+  case Phase::EXIT:
+    return "exit";
+  case Phase::LOWER:
+    return "lower";
+  case Phase::ATTACH:
+    return "attach";
+  case Phase::LIFT:
+    return "lift";
+  case Phase::TURNAROUND:
+    return "turnaround";
+  case Phase::COUNT:
+    break;
+  }
+  return "unknown";
+}
+
+const char *outcomeName(Outcome outcome) {
+  switch (outcome) {
+  case Outcome::OPEN:
+    return "open";
+  case Outcome::CHARGED:
+    return "charged";
+  case Outcome::ABANDONED:
+    return "abandoned";
+  case Outcome::EVICTED:
+    return "evicted";
+  }
+  return "unknown";
+}
+
+SessionRecord::SessionRecord() {
+  for (uint32_t &at : slaveAtMs) {
+    at = NOT_SEEN;
+  }
+  for (uint32_t &at : stationAtMs) {
+    at = NOT_SEEN;
+  }
+}
+
+uint32_t SessionRecord::phaseMs(Phase phase) const {
+  const auto slave = [this](SlaveState state) {
+    return spanMs(slaveAtMs[static_cast<size_t>(state)],
+                  slaveEndMs(*this, state));
+  };
+  const auto station = [this](StationState from, StationState to) {
+    return spanMs(stationAtMs[static_cast<size_t>(from)],
+                  stationAtMs[static_cast<size_t>(to)]);
+  };
+  switch (phase) {
+  case Phase::WALK:
+    return slave(SlaveState::WALKING_TO_CHARGE);
+  case Phase::WAIT:
+    return slave(SlaveState::WAIT_CHARGE);
+  case Phase::WALK_INTO:
+    return slave(SlaveState::WALKING_INTO_CHARGE);
+  case Phase::CHARGE:
+    return slave(SlaveState::CHARGE);
+  case Phase::EXIT:
+    return slave(SlaveState::EXITING_CHARGE);
+  case Phase::LOWER:
+    return station(StationState::LOWERING_GEAR, StationState::CLOSED);
+  case Phase::ATTACH:
+    return station(StationState::ATTACHING_GEAR, StationState::SLAVE_CHARGE);
+  case Phase::LIFT:
+    return station(StationState::LIFTING_GEAR, StationState::OPEN);
+  case Phase::TURNAROUND:
+    return partial ? NOT_SEEN
+                   : slaveAtMs[static_cast<size_t>(SlaveState::WORK)];
+  case Phase::COUNT:
+    break;
+  }
+  return NOT_SEEN;
+}
+
+void SessionStats::reset(uint32_t now) {
+  for (LatencyHistogram &histogram : phases_) {
+    histogram.reset();
+  }
+  sinceMs_ = now;
+  sessions_ = 0;
+  charged_ = 0;
+  abandoned_ = 0;
+  evicted_ = 0;
+  chargeMs_ = 0;
+}
+
+void SessionStats::onSlaveState(uint32_t node, SlaveState state,
+                                uint32_t atMs, uint16_t batteryMv) {
+  SessionRecord *session = findOpen(node);
+  if (state == SlaveState::WORK) {
+    if (session != nullptr) {
+      session->slaveAtMs[static_cast<size_t>(state)] =
+          offsetOf(*session, atMs);
+      session->endBatteryMv = batteryMv;
+      close(*session,
+            session->slaveAtMs[static_cast<size_t>(SlaveState::CHARGE)] !=
+                    NOT_SEEN
+                ? Outcome::CHARGED
+                : Outcome::ABANDONED);
+    }
+    return;
+  }
+
+  if (session == nullptr) {
+    if (openCount_ == OPEN_CAPACITY) {
+      // The oldest session is most likely one whose return to WORK was
+      // never heard.
+      uint8_t oldest = 0;
+      for (uint8_t i = 1; i < openCount_; ++i) {
+        if (static_cast<int32_t>(open_[i].startedMs -
+                                 open_[oldest].startedMs) < 0) {
+          oldest = i;
+        }
+      }
+      close(open_[oldest], Outcome::EVICTED);
+    }
+    session = &open_[openCount_++];
+    *session = SessionRecord();
+    session->node = node;
+    session->startedMs = atMs;
+    session->startBatteryMv = batteryMv;
+    session->partial = state != SlaveState::WALKING_TO_CHARGE;
+  }
+  session->slaveAtMs[static_cast<size_t>(state)] = offsetOf(*session, atMs);
+}
+
+void SessionStats::onStationState(uint32_t node, StationState state,
+                                  uint32_t atMs) {
+  SessionRecord *session = findOpen(node);
+  if (session == nullptr) {
+    return;
+  }
+  session->stationAtMs[static_cast<size_t>(state)] = offsetOf(*session, atMs);
+}
+
+Summary SessionStats::summary(uint32_t now) const {
+  Summary summary;
+  summary.elapsedMs = now - sinceMs_;
+  summary.sessions = sessions_;
+  summary.charged = charged_;
+  summary.abandoned = abandoned_;
+  summary.evicted = evicted_;
+  summary.open = openCount_;
+  if (summary.elapsedMs > 0) {
+    const float elapsed = static_cast<float>(summary.elapsedMs);
+    summary.chargesPerHour =
+        static_cast<float>(charged_) * 3600000.0f / elapsed;
+    summary.utilizationPercent =
+        static_cast<float>(chargeMs_) * 100.0f / elapsed;
+  }
+  return summary;
+}
+
+const LatencyHistogram &SessionStats::phase(Phase phase) const {
+  return phases_[static_cast<size_t>(phase)];
+}
+
+uint8_t SessionStats::recordCount() const { return ringCount_; }
+
+const SessionRecord &SessionStats::record(uint8_t newest) const {
+  return ring_[(ringHead_ + RING_CAPACITY - 1 - newest) % RING_CAPACITY];
+}
+
+const SessionRecord *SessionStats::openSession(uint32_t node) const {
+  for (uint8_t i = 0; i < openCount_; ++i) {
+    if (open_[i].node == node) {
+      return &open_[i];
+    }
+  }
+  return nullptr;
+}
+
+SessionRecord *SessionStats::findOpen(uint32_t node) {
+  return const_cast<SessionRecord *>(openSession(node));
+}
+
+void SessionStats::close(SessionRecord &session, Outcome outcome) {
+  session.outcome = outcome;
+  sessions_++;
+  switch (outcome) {
+  case Outcome::CHARGED:
+    charged_++;
+    for (size_t i = 0; i < PHASE_COUNT; ++i) {
+      const uint32_t ms = session.phaseMs(static_cast<Phase>(i));
+      if (ms != NOT_SEEN) {
+        phases_[i].add(ms);
+      }
+    }
+    if (session.phaseMs(Phase::CHARGE) != NOT_SEEN) {
+      chargeMs_ += session.phaseMs(Phase::CHARGE);
+    }
+    break;
+  case Outcome::ABANDONED:
+    abandoned_++;
+    break;
+  case Outcome::EVICTED:
+    evicted_++;
+    break;
+  case Outcome::OPEN:
+    break;
+  }
+
+  ring_[ringHead_] = session;
+  ringHead_ = static_cast<uint8_t>((ringHead_ + 1) % RING_CAPACITY);
+  ringCount_ = ringCount_ < RING_CAPACITY ? ringCount_ + 1 : RING_CAPACITY;
+  // The last open session takes the freed slot.
+  session = open_[--openCount_];
+}
+
+size_t formatSummary(const Summary &summary, char *out, size_t size) {
+  const int written = snprintf(
+      out, size, "stats,%lu,%lu,%lu,%lu,%lu,%u,%.2f,%.1f\n",
+      static_cast<unsigned long>(summary.elapsedMs / 1000U),
+      static_cast<unsigned long>(summary.sessions),
+      static_cast<unsigned long>(summary.charged),
+      static_cast<unsigned long>(summary.abandoned),
+      static_cast<unsigned long>(summary.evicted),
+      static_cast<unsigned>(summary.open),
+      static_cast<double>(summary.chargesPerHour),
+      static_cast<double>(summary.utilizationPercent));
+  return written > 0 && static_cast<size_t>(written) < size
+             ? static_cast<size_t>(written)
+             : 0;
+}
+
+size_t formatPhase(Phase phase, const LatencyHistogram &histogram, char *out,
+                   size_t size) {
+  const int written =
+      snprintf(out, size, "stats_phase,%s,%lu,%lu,%lu,%lu,%lu\n",
+               phaseName(phase), static_cast<unsigned long>(histogram.count()),
+               static_cast<unsigned long>(histogram.percentile(0.50f)),
+               static_cast<unsigned long>(histogram.percentile(0.90f)),
+               static_cast<unsigned long>(histogram.percentile(0.99f)),
+               static_cast<unsigned long>(histogram.max()));
+  return written > 0 && static_cast<size_t>(written) < size
+             ? static_cast<size_t>(written)
+             : 0;
+}
+
+size_t formatRecord(const SessionRecord &record, char *out, size_t size) {
+  int written = snprintf(out, size, "session,%lu,%lu,%s",
+                         static_cast<unsigned long>(record.node),
+                         static_cast<unsigned long>(record.startedMs),
+                         outcomeName(record.outcome));
+  if (written <= 0 || static_cast<size_t>(written) >= size) {
+    return 0;
+  }
+  size_t used = static_cast<size_t>(written);
+  for (size_t i = 0; i < PHASE_COUNT; ++i) {
+    const uint32_t ms = record.phaseMs(static_cast<Phase>(i));
+    written = ms != NOT_SEEN
+                  ? snprintf(out + used, size - used, ",%lu",
+                             static_cast<unsigned long>(ms))
+                  : snprintf(out + used, size - used, ",-");
+    if (written <= 0 || static_cast<size_t>(written) >= size - used) {
+      return 0;
+    }
+    used += static_cast<size_t>(written);
+  }
+  written = snprintf(out + used, size - used, ",%u,%u",
+                     static_cast<unsigned>(record.startBatteryMv),
+                     static_cast<unsigned>(record.endBatteryMv));
+  if (written <= 0 || static_cast<size_t>(written) >= size - used) {
+    return 0;
+  }
+  return terminate(out, size, used + static_cast<size_t>(written));
+}
+} // namespace session_stats
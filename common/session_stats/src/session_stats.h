@@ -0,0 +1,155 @@
+#pragma once
+
+#include <heartbeat.h>
+#include <latency_histogram.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Charging sessions as the master sees them: one record per slave from
+// leaving WORK to being back at it, with the time it entered each
+// SlaveState and each ChargingStationState of the bay it used. Closed
+// records go into a fixed ring; the phase durations of every charged
+// session go into one log-linear histogram per phase (LatencyHistogram of
+// common/mesh_bench, in ms here: p50/p90/p99 at most 12.5% high, up to
+// 18 h). Nothing is allocated after construction.
+//
+// The store is fed transitions with the time they happened; it keeps no
+// clock of its own. The single-bay master only sees its station states
+// through the slaves and its own callbacks, so some of them may never
+// come: a phase whose start or end is missing is left out of its
+// histogram.
+namespace session_stats {
+// ChargingStationState of the dezibot autocharge library, by value.
+enum class StationState : uint8_t {
+  OPEN,
+  LOWERING_GEAR,
+  CLOSED,
+  ATTACHING_GEAR,
+  SLAVE_CHARGE,
+  LIFTING_GEAR,
+  COUNT
+};
+constexpr size_t STATION_STATE_COUNT = static_cast<size_t>(StationState::COUNT);
+const char *stationStateName(StationState state);
+
+// What the query reports tail latencies of.
+enum class Phase : uint8_t {
+  // Slave states, entry to the next state seen.
+  WALK,
+  WAIT,
+  WALK_INTO,
+  CHARGE,
+  EXIT,
+  // Bridge motions: LOWERING_GEAR to CLOSED, ATTACHING_GEAR to
+  // SLAVE_CHARGE, LIFTING_GEAR to OPEN.
+  LOWER,
+  ATTACH,
+  LIFT,
+  // Leaving WORK to being back at it.
+  TURNAROUND,
+  COUNT
+};
+constexpr size_t PHASE_COUNT = static_cast<size_t>(Phase::COUNT);
+const char *phaseName(Phase phase);
+
+constexpr uint32_t NOT_SEEN = 0xFFFFFFFFu;
+
+enum class Outcome : uint8_t {
+  OPEN,
+  CHARGED,
+  // Back at WORK without charging: a walk that gave up or a cancel.
+  ABANDONED,
+  // Pushed out of the open table by a newer session.
+  EVICTED
+};
+const char *outcomeName(Outcome outcome);
+
+struct SessionRecord {
+  uint32_t node = 0;
+  uint32_t startedMs = 0;
+  // Ms after startedMs, NOT_SEEN if the transition never came. slaveAtMs
+  // is indexed by SlaveState, WORK being the return; stationAtMs by
+  // StationState, OPEN being the bay reopening after the session.
+  uint32_t slaveAtMs[heartbeat::STATE_COUNT];
+  uint32_t stationAtMs[STATION_STATE_COUNT];
+  uint16_t startBatteryMv = heartbeat::BATTERY_UNKNOWN;
+  uint16_t endBatteryMv = heartbeat::BATTERY_UNKNOWN;
+  Outcome outcome = Outcome::OPEN;
+  // First seen past WALKING_TO_CHARGE, e.g. after a master reset.
+  bool partial = false;
+
+  SessionRecord();
+  // Duration of a phase, NOT_SEEN if it is not complete in the record.
+  uint32_t phaseMs(Phase phase) const;
+};
+
+struct Summary {
+  uint32_t elapsedMs = 0;
+  uint32_t sessions = 0;
+  uint32_t charged = 0;
+  uint32_t abandoned = 0;
+  uint32_t evicted = 0;
+  uint8_t open = 0;
+  // Charged sessions per hour of elapsedMs.
+  float chargesPerHour = 0.0f;
+  // Share of elapsedMs a slave spent in CHARGE, in percent.
+  float utilizationPercent = 0.0f;
+};
+
+class SessionStats {
+public:
+  static constexpr uint8_t RING_CAPACITY = 64;
+  // Sessions under way at once; a multi-bay station has one per bay and
+  // one per walking slave.
+  static constexpr uint8_t OPEN_CAPACITY = 16;
+
+  // Statistics count from `now`.
+  void reset(uint32_t now);
+
+  // The slave entered `state` at atMs. Leaving WORK opens a session,
+  // returning to it closes the session. batteryMv may be BATTERY_UNKNOWN.
+  void onSlaveState(uint32_t node, heartbeat::SlaveState state, uint32_t atMs,
+                    uint16_t batteryMv);
+  // The bay serving `node` entered `state` at atMs; ignored if the slave
+  // has no session under way.
+  void onStationState(uint32_t node, StationState state, uint32_t atMs);
+
+  Summary summary(uint32_t now) const;
+  const LatencyHistogram &phase(Phase phase) const;
+
+  // Closed sessions in the ring, newest first: index 0 is the last one.
+  uint8_t recordCount() const;
+  const SessionRecord &record(uint8_t newest) const;
+  // Session under way for `node`, nullptr if none.
+  const SessionRecord *openSession(uint32_t node) const;
+
+private:
+  SessionRecord *findOpen(uint32_t node);
+  void close(SessionRecord &session, Outcome outcome);
+
+  SessionRecord open_[OPEN_CAPACITY];
+  uint8_t openCount_ = 0;
+  SessionRecord ring_[RING_CAPACITY];
+  uint8_t ringHead_ = 0;
+  uint8_t ringCount_ = 0;
+  LatencyHistogram phases_[PHASE_COUNT];
+  uint32_t sinceMs_ = 0;
+  uint32_t sessions_ = 0;
+  uint32_t charged_ = 0;
+  uint32_t abandoned_ = 0;
+  uint32_t evicted_ = 0;
+  uint64_t chargeMs_ = 0;
+};
+
+// `stats,<elapsed_s>,<sessions>,<charged>,<abandoned>,<evicted>,<open>,
+// <charges_per_h>,<utilization_pct>`
+size_t formatSummary(const Summary &summary, char *out, size_t size);
+// `stats_phase,<phase>,<n>,<p50_ms>,<p90_ms>,<p99_ms>,<max_ms>`
+size_t formatPhase(Phase phase, const LatencyHistogram &histogram, char *out,
+                   size_t size);
+// `session,<node>,<started_ms>,<outcome>,<walk>,<wait>,<walk_into>,
+// <charge>,<exit>,<lower>,<attach>,<lift>,<turnaround>,<battery_start>,
+// <battery_end>`, durations in ms, `-` where not seen.
+size_t formatRecord(const SessionRecord &record, char *out, size_t size);
+} // namespace session_stats
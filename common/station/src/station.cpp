@@ -0,0 +1,424 @@
+#include "station.h"
+
+namespace station {
+
+const char *bayStateName(BayState state) {
+  switch (state) {
+  case BayState::OPEN:
+    return "open";
+  case BayState::LOWERING_GEAR:
+    return "lowering_gear";
+  case BayState::CLOSED:
+    return "closed";
+  case BayState::ATTACHING_GEAR:
+    return "attaching_gear";
+  case BayState::SLAVE_CHARGE:
+    return "slave_charge";
+  case BayState::LIFTING_GEAR:
+    return "lifting_gear";
+  case BayState::DETACHING_GEAR:
+    return "detaching_gear";
+  }
+  return "unknown";
+}
+
+const char *actionName(ActionKind kind) {
+  switch (kind) {
+  case ActionKind::ENJOIN:
+    return "enjoin";
+  case ActionKind::CANCEL:
+    return "cancel";
+  case ActionKind::LOWER_GEAR:
+    return "lower_gear";
+  case ActionKind::ATTACH_GEAR:
+    return "attach_gear";
+  case ActionKind::LIFT_GEAR:
+    return "lift_gear";
+  case ActionKind::DETACH_GEAR:
+    return "detach_gear";
+  }
+  return "unknown";
+}
+
+Station::Station(const BayConfig *bays, uint8_t count,
+                 const StationConfig &config)
+    : config_(config), bayCount_(count > MAX_BAYS ? MAX_BAYS : count) {
+  for (uint8_t i = 0; i < bayCount_; ++i) {
+    bays_[i].config = bays[i];
+  }
+}
+
+bool Station::onRequestCharge(uint32_t slave, uint32_t now) {
+  (void)now;
+  if (slave == 0 || bayOf(slave) != NO_BAY || queuedAlready(slave) ||
+      queueCount_ == QUEUE_CAPACITY) {
+    return false;
+  }
+  queue_[(queueHead_ + queueCount_) % QUEUE_CAPACITY] = slave;
+  queueCount_++;
+  return true;
+}
+
+void Station::onWalkToCharge(uint32_t slave, uint32_t now) {
+  const uint8_t bay = bayOf(slave);
+  if (bay != NO_BAY) {
+    walks_.start(slave, now);
+  }
+  if (!config_.pipelined || bay == NO_BAY) {
+    return;
+  }
+  Bay &entry = bays_[bay];
+  if (entry.occupant == slave && entry.state == BayState::OPEN) {
+    move(bay, BayState::LOWERING_GEAR, ActionKind::LOWER_GEAR);
+  }
+}
+
+void Station::onExitingCharge(uint32_t slave, uint32_t now) {
+  const uint8_t bay = bayOf(slave);
+  if (config_.pipelined && bay != NO_BAY && bays_[bay].occupant == slave &&
+      (bays_[bay].state == BayState::OPEN ||
+       bays_[bay].state == BayState::CLOSED)) {
+    bays_[bay].exiting = true;
+    bays_[bay].exitingMs = now;
+  }
+}
+
+void Station::onInWait(uint32_t slave, uint32_t now) {
+  const uint8_t bay = bayOf(slave);
+  if (bay == NO_BAY) {
+    return;
+  }
+  walks_.finish(slave, now);
+  Bay &entry = bays_[bay];
+  if (entry.next == slave) {
+    // Walks in once the occupant is out.
+    entry.nextInWait = true;
+    return;
+  }
+  entry.inWait = true;
+  if (entry.state == BayState::OPEN) {
+    move(bay, BayState::LOWERING_GEAR, ActionKind::LOWER_GEAR);
+  } else if (entry.state == BayState::CLOSED && !entry.abandoned) {
+    // Lowered while the slave walked.
+    push(ActionKind::ENJOIN, bay, slave);
+  }
+}
+
+void Station::onInCharge(uint32_t slave, uint32_t now) {
+  const uint8_t bay = bayOf(slave);
+  if (bay != NO_BAY && bays_[bay].occupant == slave &&
+      bays_[bay].state == BayState::CLOSED) {
+    bays_[bay].inWait = false;
+    bays_[bay].chargeStartedMs = now;
+    bays_[bay].chargeEndKnown = false;
+    move(bay, BayState::ATTACHING_GEAR, ActionKind::ATTACH_GEAR);
+  }
+}
+
+void Station::onStopCharge(uint32_t slave, uint32_t now) {
+  const uint8_t bay = bayOf(slave);
+  if (bay == NO_BAY || bays_[bay].state != BayState::SLAVE_CHARGE) {
+    return;
+  }
+  Bay &entry = bays_[bay];
+  charge_.add(now - entry.chargeStartedMs);
+  entry.chargeEndKnown = false;
+  entry.detachStartedMs = now;
+  if (config_.pipelined && (queueCount_ > 0 || entry.next != 0)) {
+    move(bay, BayState::DETACHING_GEAR, ActionKind::DETACH_GEAR);
+  } else {
+    move(bay, BayState::LIFTING_GEAR, ActionKind::LIFT_GEAR);
+  }
+}
+
+void Station::onChargeEstimate(uint32_t slave, uint32_t remainingMs,
+                               uint32_t now) {
+  const uint8_t bay = bayOf(slave);
+  if (bay == NO_BAY || bays_[bay].occupant != slave ||
+      (bays_[bay].state != BayState::ATTACHING_GEAR &&
+       bays_[bay].state != BayState::SLAVE_CHARGE)) {
+    return;
+  }
+  bays_[bay].chargeEndKnown = true;
+  bays_[bay].chargeEndMs = now + remainingMs;
+}
+
+void Station::onExitCharge(uint32_t slave, uint32_t now) {
+  const uint8_t bay = bayOf(slave);
+  if (bay != NO_BAY && bays_[bay].occupant == slave &&
+      (bays_[bay].state == BayState::OPEN ||
+       bays_[bay].state == BayState::CLOSED)) {
+    if (bays_[bay].exiting) {
+      exit_.add(now - bays_[bay].exitingMs);
+    }
+    handOver(bay);
+  }
+}
+
+void Station::onWork(uint32_t slave, uint32_t now) {
+  (void)now;
+  unqueue(slave);
+  walks_.abandon(slave);
+  const uint8_t bay = bayOf(slave);
+  if (bay == NO_BAY) {
+    return;
+  }
+  Bay &entry = bays_[bay];
+  if (entry.next == slave) {
+    // Gave up on the walk to a bay still in use: the bay goes on as if it
+    // had never been sent.
+    entry.next = 0;
+    entry.nextInWait = false;
+    return;
+  }
+  switch (entry.state) {
+  case BayState::OPEN:
+  case BayState::CLOSED:
+    handOver(bay);
+    break;
+  case BayState::LIFTING_GEAR:
+  case BayState::DETACHING_GEAR:
+    // Finishes the motion; the bay is handed over then.
+    entry.occupant = 0;
+    entry.inWait = false;
+    break;
+  case BayState::LOWERING_GEAR:
+  case BayState::ATTACHING_GEAR:
+    entry.occupant = 0;
+    entry.inWait = false;
+    entry.abandoned = true;
+    break;
+  case BayState::SLAVE_CHARGE:
+    entry.occupant = 0;
+    entry.inWait = false;
+    move(bay, BayState::LIFTING_GEAR, ActionKind::LIFT_GEAR);
+    break;
+  }
+}
+
+void Station::onBridgeDone(uint8_t bay, uint32_t now) {
+  if (bay >= bayCount_) {
+    return;
+  }
+  Bay &entry = bays_[bay];
+  switch (entry.state) {
+  case BayState::LOWERING_GEAR:
+  case BayState::ATTACHING_GEAR:
+    if (entry.abandoned) {
+      entry.abandoned = false;
+      move(bay, BayState::LIFTING_GEAR, ActionKind::LIFT_GEAR);
+    } else if (entry.state == BayState::LOWERING_GEAR) {
+      entry.state = BayState::CLOSED;
+      if (entry.inWait) {
+        push(ActionKind::ENJOIN, bay, entry.occupant);
+      }
+    } else {
+      entry.state = BayState::SLAVE_CHARGE;
+    }
+    break;
+  case BayState::LIFTING_GEAR:
+    entry.state = BayState::OPEN;
+    if (entry.occupant != 0) {
+      push(ActionKind::CANCEL, bay, entry.occupant);
+    }
+    break;
+  case BayState::DETACHING_GEAR:
+    detach_.add(now - entry.detachStartedMs);
+    entry.state = BayState::CLOSED;
+    if (entry.occupant != 0) {
+      push(ActionKind::CANCEL, bay, entry.occupant);
+    } else {
+      handOver(bay);
+    }
+    break;
+  case BayState::OPEN:
+  case BayState::CLOSED:
+  case BayState::SLAVE_CHARGE:
+    break;
+  }
+}
+
+void Station::dispatch(uint32_t now) {
+  for (uint8_t bay = 0; bay < bayCount_ && queueCount_ > 0; ++bay) {
+    Bay &entry = bays_[bay];
+    if (entry.abandoned) {
+      continue;
+    }
+    if (entry.state == BayState::OPEN && entry.occupant == 0) {
+      entry.occupant = pop();
+      push(ActionKind::ENJOIN, bay, entry.occupant);
+      continue;
+    }
+    if (!config_.pipelined || entry.occupant == 0 || entry.next != 0) {
+      continue;
+    }
+    bool send = entry.exiting;
+    uint32_t freeMs = 0;
+    uint32_t walkMs = 0;
+    if (!send && config_.predictive && freeAt(entry, freeMs) &&
+        walkEstimate(queue_[queueHead_], walkMs)) {
+      // Sent once the walk would not end before the bay frees up.
+      send = static_cast<int32_t>(now + walkMs - freeMs) >= 0;
+      earlyDispatches_ += send ? 1 : 0;
+    }
+    if (send) {
+      entry.next = pop();
+      push(ActionKind::ENJOIN, bay, entry.next);
+    }
+  }
+}
+
+bool Station::nextAction(Action &action) {
+  if (actionCount_ == 0) {
+    return false;
+  }
+  action = actions_[actionHead_];
+  actionHead_ = (actionHead_ + 1) % ACTION_CAPACITY;
+  actionCount_--;
+  return true;
+}
+
+uint8_t Station::bayCount() const { return bayCount_; }
+
+const BayConfig &Station::bay(uint8_t bay) const { return bays_[bay].config; }
+
+BayState Station::state(uint8_t bay) const { return bays_[bay].state; }
+
+uint32_t Station::occupant(uint8_t bay) const { return bays_[bay].occupant; }
+
+uint32_t Station::next(uint8_t bay) const { return bays_[bay].next; }
+
+uint8_t Station::bayOf(uint32_t slave) const {
+  for (uint8_t bay = 0; slave != 0 && bay < bayCount_; ++bay) {
+    if (bays_[bay].occupant == slave || bays_[bay].next == slave) {
+      return bay;
+    }
+  }
+  return NO_BAY;
+}
+
+uint8_t Station::queued() const { return queueCount_; }
+
+uint32_t Station::droppedActions() const { return droppedActions_; }
+
+const WalkStats &Station::walkStats() const { return walks_; }
+
+const DurationEstimate &Station::chargeTime() const { return charge_; }
+
+const DurationEstimate &Station::detachTime() const { return detach_; }
+
+const DurationEstimate &Station::exitTime() const { return exit_; }
+
+uint32_t Station::earlyDispatches() const { return earlyDispatches_; }
+
+bool Station::queuedAlready(uint32_t slave) const {
+  for (uint8_t i = 0; i < queueCount_; ++i) {
+    if (queue_[(queueHead_ + i) % QUEUE_CAPACITY] == slave) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Removes the slave and closes the gap, keeping the order of the others.
+void Station::unqueue(uint32_t slave) {
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < queueCount_; ++i) {
+    const uint32_t entry = queue_[(queueHead_ + i) % QUEUE_CAPACITY];
+    if (entry != slave) {
+      queue_[(queueHead_ + kept) % QUEUE_CAPACITY] = entry;
+      kept++;
+    }
+  }
+  queueCount_ = kept;
+}
+
+void Station::push(ActionKind kind, uint8_t bay, uint32_t slave) {
+  if (actionCount_ == ACTION_CAPACITY) {
+    droppedActions_++;
+    return;
+  }
+  Action &action = actions_[(actionHead_ + actionCount_) % ACTION_CAPACITY];
+  action.kind = kind;
+  action.bay = bay;
+  action.slave = slave;
+  actionCount_++;
+}
+
+void Station::move(uint8_t bay, BayState state, ActionKind motion) {
+  bays_[bay].state = state;
+  push(motion, bay, 0);
+}
+
+uint32_t Station::pop() {
+  const uint32_t slave = queue_[queueHead_];
+  queueHead_ = (queueHead_ + 1) % QUEUE_CAPACITY;
+  queueCount_--;
+  return slave;
+}
+
+bool Station::freeAt(const Bay &entry, uint32_t &atMs) const {
+  if (exit_.samples == 0) {
+    return false;
+  }
+  switch (entry.state) {
+  case BayState::ATTACHING_GEAR:
+  case BayState::SLAVE_CHARGE:
+    if (detach_.samples == 0 ||
+        (!entry.chargeEndKnown && charge_.samples == 0)) {
+      return false;
+    }
+    atMs = (entry.chargeEndKnown ? entry.chargeEndMs
+                                 : entry.chargeStartedMs + charge_.meanMs) +
+           detach_.meanMs + exit_.meanMs;
+    return true;
+  case BayState::DETACHING_GEAR:
+    if (detach_.samples == 0) {
+      return false;
+    }
+    atMs = entry.detachStartedMs + detach_.meanMs + exit_.meanMs;
+    return true;
+  case BayState::OPEN:
+  case BayState::LOWERING_GEAR:
+  case BayState::CLOSED:
+  case BayState::LIFTING_GEAR:
+    // Not charging yet, or already exiting, which dispatch() handles.
+    return false;
+  }
+  return false;
+}
+
+// A slave without walks of its own is taken to walk like the fleet.
+bool Station::walkEstimate(uint32_t slave, uint32_t &walkMs) const {
+  DurationEstimate walk;
+  if (!walks_.estimate(slave, walk)) {
+    walk = walks_.fleet();
+  }
+  if (walk.samples == 0) {
+    return false;
+  }
+  walkMs = walk.upperMs(config_.walkSpreadPercent);
+  return true;
+}
+
+void Station::handOver(uint8_t bay) {
+  Bay &entry = bays_[bay];
+  entry.occupant = entry.next;
+  entry.inWait = entry.nextInWait;
+  entry.exiting = false;
+  entry.next = 0;
+  entry.nextInWait = false;
+  if (entry.state == BayState::OPEN) {
+    // The new occupant is already walking.
+    if (entry.occupant != 0) {
+      move(bay, BayState::LOWERING_GEAR, ActionKind::LOWER_GEAR);
+    }
+  } else if (entry.state == BayState::CLOSED) {
+    if (entry.occupant == 0) {
+      move(bay, BayState::LIFTING_GEAR, ActionKind::LIFT_GEAR);
+    } else if (entry.inWait) {
+      push(ActionKind::ENJOIN, bay, entry.occupant);
+    }
+  }
+}
+} // namespace station
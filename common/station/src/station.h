@@ -0,0 +1,200 @@
+#pragma once
+
+#include "walk_stats.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Charging station with several bays. Each bay has its own bridge
+// controller, beacon and gear state machine, the one `Master` runs for its
+// single bay (docs: Charging State Machine). Slaves that request a charge
+// queue up; the dispatcher hands the head of the queue the first free bay
+// and sends it towards that bay's beacon.
+//
+// Station is driven by the slave messages and bridge completions it is
+// given and answers with actions for the caller to carry out: mesh
+// commands to a slave or motions for a bay's bridge controller. It does no
+// I/O and keeps no clock of its own. Only the fleet simulator runs it so
+// far; the master firmware still drives its single bay through Dezibot's
+// Master. What wiring it in takes is tracked in master/README.md, Station
+// Scheduler.
+//
+// Pipelined, a bay overlaps its bridge motions with the slaves' walks:
+// - it lowers the gear as soon as its slave reports walking to charge, so
+//   the gear is down by the time the slave waits at the bay;
+// - with slaves queued, it only detaches the gear after a charge, which
+//   leaves it at walk-in level for the next slave instead of lifting it
+//   and lowering it again;
+// - once the slave on the charger reports exiting, the next queued slave
+//   is sent to the bay, and walks while the first one leaves. It only
+//   walks in after the first one is back at work.
+// A slave that gives up rolls its bay back: the gear comes up again, or
+// the next slave in line takes over.
+//
+// Predictive, on top of that, the next slave is sent early: the station
+// learns every slave's walk time and the bay's charge, detach and exit
+// times, and enjoins the head of the queue once its walk would end after
+// the bay is expected to free up. It then waits at the bay for the
+// handover rather than the bay waiting for it. A slave that reports how
+// long its charge has left is taken at its word instead of the mean.
+namespace station {
+constexpr uint8_t MAX_BAYS = 8;
+constexpr uint8_t QUEUE_CAPACITY = 32;
+constexpr uint8_t ACTION_CAPACITY = 32;
+constexpr uint8_t NO_BAY = 0xFF;
+
+// ChargingStationState, per bay.
+enum class BayState : uint8_t {
+  OPEN,
+  LOWERING_GEAR,
+  CLOSED,
+  ATTACHING_GEAR,
+  SLAVE_CHARGE,
+  LIFTING_GEAR,
+  // Pipelined: from the charge back to walk-in level, gear detached.
+  DETACHING_GEAR
+};
+const char *bayStateName(BayState state);
+
+struct BayConfig {
+  // I2C address of the bay's bridge controller.
+  uint8_t bridgeAddress = 0;
+  // Beacon the slave follows to this bay.
+  uint8_t beacon = 0;
+};
+
+struct StationConfig {
+  bool pipelined = false;
+  // Needs `pipelined`.
+  bool predictive = false;
+  // Predictive: the walk is taken as its mean plus this share of its mean
+  // deviation, so most slaves are in wait when the bay frees up. An idle
+  // bay costs the whole station; a slave in wait only itself.
+  uint8_t walkSpreadPercent = 100;
+};
+
+enum class ActionKind : uint8_t {
+  // enjoinCharge: walk to the bay's beacon, or into the bay once it is
+  // closed, depending on where the slave is.
+  ENJOIN,
+  // cancelCharge: leave the bay, or give up on it.
+  CANCEL,
+  // Bridge motions; the bay waits for onBridgeDone().
+  LOWER_GEAR,
+  ATTACH_GEAR,
+  LIFT_GEAR,
+  // To walk-in level from the charge: the motor's LOWER_WALK_IN target is
+  // 100 steps above LOWER_CHARGE.
+  DETACH_GEAR
+};
+const char *actionName(ActionKind kind);
+
+struct Action {
+  ActionKind kind = ActionKind::ENJOIN;
+  uint8_t bay = NO_BAY;
+  // The slave for ENJOIN and CANCEL, 0 for bridge motions.
+  uint32_t slave = 0;
+};
+
+class Station {
+public:
+  // Copies `count` bay configurations, at most MAX_BAYS.
+  Station(const BayConfig *bays, uint8_t count,
+          const StationConfig &config = StationConfig());
+
+  // Slave messages, by node id, with the time in ms they arrived.
+  // onRequestCharge() returns false if the slave is already queued or
+  // assigned, or the queue is full.
+  bool onRequestCharge(uint32_t slave, uint32_t now);
+  // State reports that only a pipelined station acts on.
+  void onWalkToCharge(uint32_t slave, uint32_t now);
+  void onExitingCharge(uint32_t slave, uint32_t now);
+  void onInWait(uint32_t slave, uint32_t now);
+  void onInCharge(uint32_t slave, uint32_t now);
+  void onStopCharge(uint32_t slave, uint32_t now);
+  void onExitCharge(uint32_t slave, uint32_t now);
+  // The charging slave expects to ask to stop in `remainingMs`
+  // (common/charge_control). Predictive, this takes the place of the
+  // learned charge time for its bay until the charge ends.
+  void onChargeEstimate(uint32_t slave, uint32_t remainingMs, uint32_t now);
+  // The slave went back to work without charging (it gave up on the walk
+  // or was reset): its place in the queue or its bay is released.
+  void onWork(uint32_t slave, uint32_t now);
+  // The bridge controller of `bay` finished its motion.
+  void onBridgeDone(uint8_t bay, uint32_t now);
+
+  // Assigns queued slaves to free bays; call once per master step.
+  void dispatch(uint32_t now);
+  // Pops the oldest pending action.
+  bool nextAction(Action &action);
+
+  uint8_t bayCount() const;
+  const BayConfig &bay(uint8_t bay) const;
+  BayState state(uint8_t bay) const;
+  // Slave the bay is assigned to, 0 while it is free.
+  uint32_t occupant(uint8_t bay) const;
+  // Pipelined: the slave sent to the bay while its occupant leaves.
+  uint32_t next(uint8_t bay) const;
+  uint8_t bayOf(uint32_t slave) const;
+  uint8_t queued() const;
+  // Actions lost because the caller did not drain them.
+  uint32_t droppedActions() const;
+  const WalkStats &walkStats() const;
+  // Learned over all bays.
+  const DurationEstimate &chargeTime() const;
+  const DurationEstimate &detachTime() const;
+  const DurationEstimate &exitTime() const;
+  // Predictive: slaves sent before the occupant of their bay was exiting.
+  uint32_t earlyDispatches() const;
+
+private:
+  struct Bay {
+    BayConfig config;
+    BayState state = BayState::OPEN;
+    uint32_t occupant = 0;
+    // The occupant waits at the bay for the gear.
+    bool inWait = false;
+    // The occupant reported exiting the charger; the bay may take `next`.
+    bool exiting = false;
+    uint32_t next = 0;
+    bool nextInWait = false;
+    // The gear has to come up again once the current motion ends.
+    bool abandoned = false;
+    // When the charge, detach and exit of the occupant started.
+    uint32_t chargeStartedMs = 0;
+    uint32_t detachStartedMs = 0;
+    uint32_t exitingMs = 0;
+    // The occupant's own estimate of when its charge ends.
+    bool chargeEndKnown = false;
+    uint32_t chargeEndMs = 0;
+  };
+
+  bool queuedAlready(uint32_t slave) const;
+  void unqueue(uint32_t slave);
+  void push(ActionKind kind, uint8_t bay, uint32_t slave);
+  void move(uint8_t bay, BayState state, ActionKind motion);
+  uint32_t pop();
+  // The occupant left: `next` takes the bay, or the gear comes up.
+  void handOver(uint8_t bay);
+  // Predictive: when the occupant is expected out of the bay, false if
+  // there is nothing to go by yet.
+  bool freeAt(const Bay &entry, uint32_t &atMs) const;
+  bool walkEstimate(uint32_t slave, uint32_t &walkMs) const;
+
+  StationConfig config_;
+  Bay bays_[MAX_BAYS];
+  uint8_t bayCount_;
+  uint32_t queue_[QUEUE_CAPACITY];
+  uint8_t queueHead_ = 0;
+  uint8_t queueCount_ = 0;
+  Action actions_[ACTION_CAPACITY];
+  uint8_t actionHead_ = 0;
+  uint8_t actionCount_ = 0;
+  uint32_t droppedActions_ = 0;
+  WalkStats walks_;
+  DurationEstimate charge_;
+  DurationEstimate detach_;
+  DurationEstimate exit_;
+  uint32_t earlyDispatches_ = 0;
+};
+} // namespace station
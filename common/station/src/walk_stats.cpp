@@ -0,0 +1,138 @@
+#include "walk_stats.h"
+
+namespace station {
+namespace {
+// Samples averaged plainly before the weight settles at 1/WEIGHT.
+constexpr uint32_t WEIGHT = 4;
+constexpr uint32_t MS_PER_UNIT = 10;
+constexpr uint32_t UNIT_MAX = UINT16_MAX;
+
+uint32_t absDiff(uint32_t a, uint32_t b) { return a > b ? a - b : b - a; }
+
+// Moves `value` by 1/weight of the way to `sample`, rounding to nearest.
+uint32_t blend(uint32_t value, uint32_t sample, uint32_t weight) {
+  const int64_t step = static_cast<int64_t>(sample) - value;
+  const int64_t half = step < 0 ? -static_cast<int64_t>(weight / 2)
+                                 : static_cast<int64_t>(weight / 2);
+  return static_cast<uint32_t>(value + (step + half) / weight);
+}
+
+// One sample into a mean and deviation that have seen `samples` before it.
+void update(uint32_t &mean, uint32_t &deviation, uint32_t samples,
+            uint32_t sample) {
+  if (samples == 0) {
+    mean = sample;
+    deviation = 0;
+    return;
+  }
+  const uint32_t weight = samples + 1 < WEIGHT ? samples + 1 : WEIGHT;
+  const uint32_t error = absDiff(sample, mean);
+  mean = blend(mean, sample, weight);
+  deviation = blend(deviation, error, weight);
+}
+
+uint16_t toUnits(uint32_t ms) {
+  const uint32_t units = (ms + MS_PER_UNIT / 2) / MS_PER_UNIT;
+  return static_cast<uint16_t>(units > UNIT_MAX ? UNIT_MAX : units);
+}
+} // namespace
+
+void DurationEstimate::add(uint32_t ms) {
+  update(meanMs, deviationMs, samples, ms);
+  if (samples < UINT16_MAX) {
+    samples++;
+  }
+}
+
+uint32_t DurationEstimate::upperMs(uint8_t spreadPercent) const {
+  return meanMs + deviationMs * spreadPercent / 100U;
+}
+
+void WalkStats::start(uint32_t slave, uint32_t now) {
+  Entry &entry = claim(slave);
+  entry.startedMs = now;
+  entry.walking = true;
+  entry.touched = ++clock_;
+}
+
+void WalkStats::finish(uint32_t slave, uint32_t now) {
+  Entry *entry = find(slave);
+  if (entry == nullptr || !entry->walking) {
+    return;
+  }
+  entry->walking = false;
+  entry->touched = ++clock_;
+  const uint32_t walkMs = now - entry->startedMs;
+  uint32_t mean = entry->meanCs * MS_PER_UNIT;
+  uint32_t deviation = entry->deviationCs * MS_PER_UNIT;
+  update(mean, deviation, entry->samples, walkMs);
+  entry->meanCs = toUnits(mean);
+  entry->deviationCs = toUnits(deviation);
+  if (entry->samples < UINT8_MAX) {
+    entry->samples++;
+  }
+  fleet_.add(walkMs);
+}
+
+void WalkStats::abandon(uint32_t slave) {
+  Entry *entry = find(slave);
+  if (entry != nullptr) {
+    entry->walking = false;
+  }
+}
+
+bool WalkStats::estimate(uint32_t slave, DurationEstimate &walk) const {
+  const Entry *entry = find(slave);
+  if (entry == nullptr || entry->samples == 0) {
+    return false;
+  }
+  walk.meanMs = entry->meanCs * MS_PER_UNIT;
+  walk.deviationMs = entry->deviationCs * MS_PER_UNIT;
+  walk.samples = entry->samples;
+  return true;
+}
+
+const DurationEstimate &WalkStats::fleet() const { return fleet_; }
+
+uint8_t WalkStats::count() const { return count_; }
+
+WalkStats::Entry *WalkStats::find(uint32_t slave) {
+  for (uint8_t i = 0; i < count_; ++i) {
+    if (entries_[i].slave == slave) {
+      return &entries_[i];
+    }
+  }
+  return nullptr;
+}
+
+const WalkStats::Entry *WalkStats::find(uint32_t slave) const {
+  for (uint8_t i = 0; i < count_; ++i) {
+    if (entries_[i].slave == slave) {
+      return &entries_[i];
+    }
+  }
+  return nullptr;
+}
+
+WalkStats::Entry &WalkStats::claim(uint32_t slave) {
+  Entry *entry = find(slave);
+  if (entry != nullptr) {
+    return *entry;
+  }
+  if (count_ < CAPACITY) {
+    entry = &entries_[count_++];
+  } else {
+    // Evicts the entry touched longest ago; the counter wraps, so the
+    // age is taken relative to it.
+    entry = &entries_[0];
+    for (uint8_t i = 1; i < CAPACITY; ++i) {
+      if (static_cast<uint16_t>(clock_ - entries_[i].touched) >
+          static_cast<uint16_t>(clock_ - entry->touched)) {
+        entry = &entries_[i];
+      }
+    }
+  }
+  *entry = Entry{slave, 0, 0, 0, 0, false, clock_};
+  return *entry;
+}
+} // namespace station
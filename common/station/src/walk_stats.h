@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+namespace station {
+// Running estimate of a duration: the mean and mean absolute deviation of
+// the first samples, then exponentially weighted so it follows a robot or
+// a floor that changes.
+struct DurationEstimate {
+  uint32_t meanMs = 0;
+  uint32_t deviationMs = 0;
+  uint16_t samples = 0;
+
+  void add(uint32_t ms);
+  // mean + spreadPercent/100 deviations.
+  uint32_t upperMs(uint8_t spreadPercent) const;
+};
+
+// Walk times to the charger per slave, from WALKING_TO_CHARGE to
+// WAIT_CHARGE. Entries are 16 bytes, times in 10 ms units (up to 655 s);
+// when the table is full the slave not heard from longest gives up its
+// entry.
+class WalkStats {
+public:
+  static constexpr uint8_t CAPACITY = 64;
+
+  // A walk starts; a walk already under way is restarted.
+  void start(uint32_t slave, uint32_t now);
+  // The slave reached its bay: the walk counts.
+  void finish(uint32_t slave, uint32_t now);
+  // The walk gave up; it does not count.
+  void abandon(uint32_t slave);
+
+  // False while the slave has no finished walk.
+  bool estimate(uint32_t slave, DurationEstimate &walk) const;
+  // Every finished walk of every slave.
+  const DurationEstimate &fleet() const;
+  uint8_t count() const;
+
+private:
+  struct Entry {
+    uint32_t slave;
+    // Start of the walk under way, or of the last one.
+    uint32_t startedMs;
+    uint16_t meanCs;
+    uint16_t deviationCs;
+    uint8_t samples;
+    bool walking;
+    // Table-wide counter at the last update, for eviction.
+    uint16_t touched;
+  };
+
+  Entry *find(uint32_t slave);
+  const Entry *find(uint32_t slave) const;
+  Entry &claim(uint32_t slave);
+
+  Entry entries_[CAPACITY];
+  uint8_t count_ = 0;
+  uint16_t clock_ = 0;
+  DurationEstimate fleet_;
+};
+} // namespace station
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// RFC 4648 base64, used to carry binary telemetry through text-only links
+// (painlessMesh messages, line-based serial logs).
+namespace base64 {
+inline size_t encodedLength(size_t length) { return ((length + 2) / 3) * 4; }
+
+// Writes a NUL-terminated string; returns its length, or 0 if it does not
+// fit `capacity` (including the terminator).
+inline size_t encode(const uint8_t *in, size_t length, char *out,
+                     size_t capacity) {
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  const size_t needed = encodedLength(length);
+  if (needed + 1 > capacity) {
+    return 0;
+  }
+  size_t o = 0;
+  for (size_t i = 0; i < length; i += 3) {
+    const uint32_t b0 = in[i];
+    const uint32_t b1 = i + 1 < length ? in[i + 1] : 0;
+    const uint32_t b2 = i + 2 < length ? in[i + 2] : 0;
+    const uint32_t triple = (b0 << 16) | (b1 << 8) | b2;
+    out[o++] = alphabet[(triple >> 18) & 0x3F];
+    out[o++] = alphabet[(triple >> 12) & 0x3F];
+    out[o++] = i + 1 < length ? alphabet[(triple >> 6) & 0x3F] : '=';
+    out[o++] = i + 2 < length ? alphabet[triple & 0x3F] : '=';
+  }
+  out[o] = '\0';
+  return o;
+}
+
+// Value of each base64 character, -1 for anything else. A table rather than
+// range compares: the mesh_proto frames decode every received message.
+inline int decodeChar(char ch) {
+  static const int8_t VALUES[256] = {
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+      52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+      -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+      15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+      -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+      41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  };
+  return VALUES[static_cast<uint8_t>(ch)];
+}
+
+// Returns the number of bytes written, or 0 on malformed input or overflow.
+inline size_t decode(const char *in, size_t length, uint8_t *out,
+                     size_t capacity) {
+  if (length % 4 != 0) {
+    return 0;
+  }
+  size_t o = 0;
+  for (size_t i = 0; i < length; i += 4) {
+    const int v0 = decodeChar(in[i]);
+    const int v1 = decodeChar(in[i + 1]);
+    int v2 = decodeChar(in[i + 2]);
+    int v3 = decodeChar(in[i + 3]);
+    size_t bytes = 3;
+    // '=' only pads the last group, and only its last one or two places.
+    if (i + 4 == length && in[i + 3] == '=') {
+      v3 = 0;
+      bytes = 2;
+      if (in[i + 2] == '=') {
+        v2 = 0;
+        bytes = 1;
+      }
+    }
+    if ((v0 | v1 | v2 | v3) < 0 || o + bytes > capacity) {
+      return 0;
+    }
+    const uint32_t triple =
+        (static_cast<uint32_t>(v0) << 18) | (static_cast<uint32_t>(v1) << 12) |
+        (static_cast<uint32_t>(v2) << 6) | static_cast<uint32_t>(v3);
+    out[o++] = static_cast<uint8_t>(triple >> 16);
+    if (bytes > 1) {
+      out[o++] = static_cast<uint8_t>(triple >> 8);
+    }
+    if (bytes > 2) {
+      out[o++] = static_cast<uint8_t>(triple);
+    }
+  }
+  return o;
+}
+} // namespace base64
@@ -0,0 +1,124 @@
+#include "capture_block.h"
+
+#include "crc32.h"
+
+#include <cstring>
+
+namespace {
+void putLe(uint8_t *out, uint32_t value, uint8_t bytes) {
+  for (uint8_t i = 0; i < bytes; ++i) {
+    out[i] = static_cast<uint8_t>(value >> (8U * i));
+  }
+}
+
+uint32_t getLe(const uint8_t *in, uint8_t bytes) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < bytes; ++i) {
+    value |= static_cast<uint32_t>(in[i]) << (8U * i);
+  }
+  return value;
+}
+} // namespace
+
+namespace capture_block {
+
+size_t seal(const Header &header, uint8_t *frame) {
+  const size_t payload = HEADER_SIZE + header.sampleCount * CHANNELS * 2;
+  frame[0] = SYNC0;
+  frame[1] = SYNC1;
+  putLe(frame + 2, static_cast<uint32_t>(payload), 2);
+
+  uint8_t *h = frame + PREFIX_SIZE;
+  putLe(h, header.sequence, 4);
+  putLe(h + 4, header.firstSampleUs, 4);
+  putLe(h + 8, header.periodUs, 2);
+  putLe(h + 10, header.sampleCount, 2);
+  h[12] = header.channelCount;
+  h[13] = header.flags;
+  putLe(h + 14, header.reserved, 2);
+
+  const uint32_t crc = crc32::compute(frame + 2, 2 + payload);
+  putLe(frame + PREFIX_SIZE + payload, crc, 4);
+  return PREFIX_SIZE + payload + CRC_SIZE;
+}
+
+FrameParser::FrameParser(FrameCallback callback, void *context)
+    : callback_(callback), context_(context) {}
+
+void FrameParser::consume(size_t count) {
+  memmove(buffer_, buffer_ + count, fill_ - count);
+  fill_ -= count;
+}
+
+// Returns false when more bytes are needed.
+bool FrameParser::tryParse() {
+  // Find the sync pair.
+  size_t start = 0;
+  while (start + 1 < fill_ &&
+         !(buffer_[start] == SYNC0 && buffer_[start + 1] == SYNC1)) {
+    start++;
+  }
+  if (start > 0) {
+    skippedBytes_ += start;
+    consume(start);
+  }
+  if (fill_ < PREFIX_SIZE + HEADER_SIZE) {
+    return false;
+  }
+
+  const size_t payload = getLe(buffer_ + 2, 2);
+  const uint16_t sampleCount = static_cast<uint16_t>(getLe(buffer_ + 14, 2));
+  const uint8_t channelCount = buffer_[16];
+  if (channelCount != CHANNELS || sampleCount > MAX_SAMPLES ||
+      payload != HEADER_SIZE + sampleCount * CHANNELS * 2) {
+    // Not a frame start; resume the search one byte later.
+    skippedBytes_ += 1;
+    consume(1);
+    return true;
+  }
+
+  const size_t total = PREFIX_SIZE + payload + CRC_SIZE;
+  if (fill_ < total) {
+    return false;
+  }
+
+  const uint32_t expected = getLe(buffer_ + PREFIX_SIZE + payload, 4);
+  if (crc32::compute(buffer_ + 2, 2 + payload) != expected) {
+    crcErrors_++;
+    skippedBytes_ += 1;
+    consume(1);
+    return true;
+  }
+
+  const uint8_t *h = buffer_ + PREFIX_SIZE;
+  Header header;
+  header.sequence = getLe(h, 4);
+  header.firstSampleUs = getLe(h + 4, 4);
+  header.periodUs = static_cast<uint16_t>(getLe(h + 8, 2));
+  header.sampleCount = sampleCount;
+  header.channelCount = channelCount;
+  header.flags = h[13];
+  header.reserved = static_cast<uint16_t>(getLe(h + 14, 2));
+  callback_(header, h + HEADER_SIZE, context_);
+  consume(total);
+  return true;
+}
+
+void FrameParser::feed(const uint8_t *data, size_t length) {
+  while (length > 0) {
+    const size_t chunk =
+        length < BUFFER_SIZE - fill_ ? length : BUFFER_SIZE - fill_;
+    memcpy(buffer_ + fill_, data, chunk);
+    fill_ += chunk;
+    data += chunk;
+    length -= chunk;
+    while (tryParse()) {
+    }
+  }
+}
+
+uint32_t FrameParser::crcErrors() const { return crcErrors_; }
+
+uint64_t FrameParser::skippedBytes() const { return skippedBytes_; }
+
+} // namespace capture_block
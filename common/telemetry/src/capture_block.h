@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Framing of the ir_meter high-rate capture stream:
+//
+//   sync (A5 5A) | length u16 | header (16 B) | samples | crc32 u32
+//
+// `length` counts header + samples; the CRC covers length, header and
+// samples. Samples are little-endian u16, channels interleaved
+// (front, back, left, right). All fields are little-endian.
+namespace capture_block {
+constexpr uint8_t SYNC0 = 0xA5;
+constexpr uint8_t SYNC1 = 0x5A;
+constexpr size_t PREFIX_SIZE = 4; // sync + length
+constexpr size_t HEADER_SIZE = 16;
+constexpr size_t CRC_SIZE = 4;
+constexpr uint8_t CHANNELS = 4;
+constexpr uint16_t MAX_SAMPLES = 256;
+
+enum Flags : uint8_t {
+  // The sampler missed at least one timer tick inside this block.
+  FLAG_TICK_OVERRUN = 1U << 0,
+};
+
+struct Header {
+  uint32_t sequence = 0;
+  uint32_t firstSampleUs = 0;
+  uint16_t periodUs = 0;
+  uint16_t sampleCount = 0;
+  uint8_t channelCount = CHANNELS;
+  uint8_t flags = 0;
+  uint16_t reserved = 0;
+};
+
+constexpr size_t samplesOffset() { return PREFIX_SIZE + HEADER_SIZE; }
+
+constexpr size_t frameSize(uint16_t sampleCount) {
+  return PREFIX_SIZE + HEADER_SIZE + sampleCount * CHANNELS * 2 + CRC_SIZE;
+}
+
+// Writes prefix, header and CRC around samples already stored at
+// `frame + samplesOffset()`. Returns the frame size.
+size_t seal(const Header &header, uint8_t *frame);
+
+// Incremental receiver: feed raw bytes (possibly mixed with text lines),
+// get a callback for every frame whose CRC checks out.
+class FrameParser {
+public:
+  typedef void (*FrameCallback)(const Header &header, const uint8_t *samples,
+                                void *context);
+
+  FrameParser(FrameCallback callback, void *context);
+
+  void feed(const uint8_t *data, size_t length);
+
+  uint32_t crcErrors() const;
+  // Bytes skipped while searching for a frame start.
+  uint64_t skippedBytes() const;
+
+private:
+  static constexpr size_t BUFFER_SIZE = frameSize(MAX_SAMPLES);
+
+  void consume(size_t count);
+  bool tryParse();
+
+  FrameCallback callback_;
+  void *context_;
+  uint8_t buffer_[BUFFER_SIZE];
+  size_t fill_ = 0;
+  uint32_t crcErrors_ = 0;
+  uint64_t skippedBytes_ = 0;
+};
+} // namespace capture_block
@@ -0,0 +1,81 @@
+#include "delta_fields.h"
+
+#include "varint.h"
+
+size_t delta_fields::encode(uint8_t headPayload, bool keyframe,
+                            const uint32_t *current, const uint32_t *previous,
+                            uint8_t count, uint8_t *out, size_t capacity) {
+  if (capacity < 1 || count > MAX_FIELDS) {
+    return 0;
+  }
+
+  uint32_t mask = 0;
+  for (uint8_t i = 0; i < count; ++i) {
+    if (keyframe || current[i] != previous[i]) {
+      mask |= 1UL << i;
+    }
+  }
+
+  out[0] = static_cast<uint8_t>((headPayload & HEAD_PAYLOAD_MASK) |
+                                (keyframe ? KEYFRAME_BIT : 0));
+  size_t length = 1;
+  size_t written = varint::write(mask, out + length, capacity - length);
+  if (written == 0) {
+    return 0;
+  }
+  length += written;
+
+  for (uint8_t i = 0; i < count; ++i) {
+    if ((mask & (1UL << i)) == 0) {
+      continue;
+    }
+    const uint32_t base = keyframe ? 0 : previous[i];
+    const int32_t delta = static_cast<int32_t>(current[i] - base);
+    written = varint::write(varint::zigzagEncode(delta), out + length,
+                            capacity - length);
+    if (written == 0) {
+      return 0;
+    }
+    length += written;
+  }
+  return length;
+}
+
+size_t delta_fields::decode(const uint8_t *in, size_t length, uint32_t *fields,
+                            uint8_t count, uint8_t &headPayload,
+                            bool &keyframe) {
+  if (length < 1 || count > MAX_FIELDS) {
+    return 0;
+  }
+  const bool isKeyframe = (in[0] & KEYFRAME_BIT) != 0;
+  size_t used = 1;
+
+  uint32_t mask = 0;
+  size_t consumed = varint::read(in + used, length - used, mask);
+  if (consumed == 0 || (count < MAX_FIELDS && (mask >> count) != 0)) {
+    return 0;
+  }
+  used += consumed;
+
+  uint32_t decoded[MAX_FIELDS];
+  for (uint8_t i = 0; i < count; ++i) {
+    decoded[i] = isKeyframe ? 0 : fields[i];
+    if ((mask & (1UL << i)) == 0) {
+      continue;
+    }
+    uint32_t encoded = 0;
+    consumed = varint::read(in + used, length - used, encoded);
+    if (consumed == 0) {
+      return 0;
+    }
+    used += consumed;
+    decoded[i] += static_cast<uint32_t>(varint::zigzagDecode(encoded));
+  }
+
+  for (uint8_t i = 0; i < count; ++i) {
+    fields[i] = decoded[i];
+  }
+  headPayload = static_cast<uint8_t>(in[0] & HEAD_PAYLOAD_MASK);
+  keyframe = isKeyframe;
+  return used;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "varint.h"
+
+// Record layout shared by the telemetry codecs: one head byte (bit 7 marks a
+// keyframe, bits 0-6 belong to the caller), a varint bitmask of the fields
+// that changed, then the zig-zag varint delta of each changed field. A
+// keyframe carries every field as a delta against zero.
+namespace delta_fields {
+constexpr uint8_t KEYFRAME_BIT = 0x80;
+constexpr uint8_t HEAD_PAYLOAD_MASK = 0x7F;
+constexpr uint8_t MAX_FIELDS = 32;
+
+// Upper bound on one record of `count` fields: the head byte, the mask
+// varint (7 fields per byte) and a full-width delta for every field.
+constexpr size_t maxEncodedSize(uint8_t count) {
+  return 1 + (count == 0 ? 1 : (count + 6) / 7) +
+         static_cast<size_t>(count) * varint::MAX_BYTES_32;
+}
+
+// Returns the encoded size, or 0 if the record does not fit `capacity`.
+size_t encode(uint8_t headPayload, bool keyframe, const uint32_t *current,
+              const uint32_t *previous, uint8_t count, uint8_t *out,
+              size_t capacity);
+
+// Applies one record to `fields` (the previous values on entry). Returns the
+// number of bytes consumed, or 0 on malformed input; `fields` is then left
+// untouched.
+size_t decode(const uint8_t *in, size_t length, uint32_t *fields,
+              uint8_t count, uint8_t &headPayload, bool &keyframe);
+} // namespace delta_fields
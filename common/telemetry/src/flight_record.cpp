@@ -0,0 +1,111 @@
+#include "flight_record.h"
+
+#include "delta_fields.h"
+
+namespace {
+constexpr uint8_t FIELD_COUNT = 16;
+
+void toFields(const FlightRecord &record, uint32_t fields[FIELD_COUNT]) {
+  fields[0] = record.tMs;
+  for (uint8_t i = 0; i < 4; ++i) {
+    fields[1 + i] = record.raw[i];
+    fields[5 + i] = record.amplitude[i];
+  }
+  fields[9] = static_cast<uint32_t>(static_cast<int32_t>(record.thetaCentiDeg));
+  fields[10] = record.signal;
+  fields[11] = record.dutyLeft;
+  fields[12] = record.dutyRight;
+  fields[13] = record.tickUs;
+  fields[14] = record.slaveState;
+  fields[15] = record.flags;
+}
+
+void fromFields(const uint32_t fields[FIELD_COUNT], FlightRecord &record) {
+  record.tMs = fields[0];
+  for (uint8_t i = 0; i < 4; ++i) {
+    record.raw[i] = static_cast<uint16_t>(fields[1 + i]);
+    record.amplitude[i] = static_cast<uint16_t>(fields[5 + i]);
+  }
+  record.thetaCentiDeg = static_cast<int16_t>(fields[9]);
+  record.signal = static_cast<uint16_t>(fields[10]);
+  record.dutyLeft = static_cast<uint16_t>(fields[11]);
+  record.dutyRight = static_cast<uint16_t>(fields[12]);
+  record.tickUs = static_cast<uint16_t>(fields[13]);
+  record.slaveState = static_cast<uint8_t>(fields[14]);
+  record.flags = static_cast<uint8_t>(fields[15]);
+}
+
+void putLe(uint8_t *out, uint32_t value, uint8_t bytes) {
+  for (uint8_t i = 0; i < bytes; ++i) {
+    out[i] = static_cast<uint8_t>(value >> (8U * i));
+  }
+}
+
+uint32_t getLe(const uint8_t *in, uint8_t bytes) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < bytes; ++i) {
+    value |= static_cast<uint32_t>(in[i]) << (8U * i);
+  }
+  return value;
+}
+} // namespace
+
+void flight_block::writeHeader(const Header &header, uint8_t *block) {
+  putLe(block, MAGIC, 4);
+  putLe(block + 4, header.sequence, 4);
+  putLe(block + 8, header.usedBytes, 2);
+  putLe(block + 10, header.recordCount, 2);
+  putLe(block + 12, header.firstTMs, 4);
+}
+
+bool flight_block::readHeader(const uint8_t *block, size_t length,
+                              Header &header) {
+  if (length < HEADER_SIZE || getLe(block, 4) != MAGIC) {
+    return false;
+  }
+  header.sequence = getLe(block + 4, 4);
+  header.usedBytes = static_cast<uint16_t>(getLe(block + 8, 2));
+  header.recordCount = static_cast<uint16_t>(getLe(block + 10, 2));
+  header.firstTMs = getLe(block + 12, 4);
+  return header.usedBytes <= length - HEADER_SIZE;
+}
+
+void FlightRecordEncoder::reset() {
+  previous_ = FlightRecord();
+  keyframePending_ = true;
+}
+
+size_t FlightRecordEncoder::encode(const FlightRecord &record, uint8_t *out,
+                                   size_t capacity) {
+  uint32_t current[FIELD_COUNT];
+  uint32_t previous[FIELD_COUNT];
+  toFields(record, current);
+  toFields(previous_, previous);
+
+  const size_t length = delta_fields::encode(
+      0, keyframePending_, current, previous, FIELD_COUNT, out, capacity);
+  if (length == 0) {
+    return 0;
+  }
+  previous_ = record;
+  keyframePending_ = false;
+  return length;
+}
+
+void FlightRecordDecoder::reset() { previous_ = FlightRecord(); }
+
+size_t FlightRecordDecoder::decode(const uint8_t *in, size_t length,
+                                   FlightRecord &record) {
+  uint32_t fields[FIELD_COUNT];
+  toFields(previous_, fields);
+  uint8_t headPayload = 0;
+  bool keyframe = false;
+  const size_t used = delta_fields::decode(in, length, fields, FIELD_COUNT,
+                                           headPayload, keyframe);
+  if (used == 0) {
+    return 0;
+  }
+  fromFields(fields, record);
+  previous_ = record;
+  return used;
+}
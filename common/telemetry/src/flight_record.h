@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// One slave control tick as kept by the on-robot flight recorder.
+struct FlightRecord {
+  enum Flags : uint8_t {
+    FLAG_DETECTED = 1U << 0,
+    FLAG_SEARCH = 1U << 1,
+    FLAG_SATURATED = 1U << 2,
+    FLAG_EVENT = 1U << 3,
+  };
+
+  uint32_t tMs = 0;
+  uint16_t raw[4] = {0, 0, 0, 0};       // front, back, left, right
+  uint16_t amplitude[4] = {0, 0, 0, 0}; // calibrated, median-filtered counts
+  int16_t thetaCentiDeg = 0;            // filteredTheta in 0.01 deg
+  uint16_t signal = 0;                  // totalSignal in counts
+  uint16_t dutyLeft = 0;
+  uint16_t dutyRight = 0;
+  uint16_t tickUs = 0; // time spent in the control tick
+  uint8_t slaveState = 0;
+  uint8_t flags = 0;
+};
+
+// Fixed-size blocks make up the recorder ring. Every block starts with a
+// keyframe, so any block can be decoded on its own after the ring wrapped.
+namespace flight_block {
+constexpr uint32_t MAGIC = 0x31524C46; // "FLR1"
+constexpr size_t SIZE = 2048;
+constexpr size_t HEADER_SIZE = 16;
+
+struct Header {
+  uint32_t sequence = 0;
+  uint16_t usedBytes = 0; // payload bytes after the header
+  uint16_t recordCount = 0;
+  uint32_t firstTMs = 0;
+};
+
+void writeHeader(const Header &header, uint8_t *block);
+bool readHeader(const uint8_t *block, size_t length, Header &header);
+} // namespace flight_block
+
+// Each record stores a bitmask of the fields that changed since the
+// previous record followed by their zig-zag varint deltas. Unchanged fields
+// cost nothing; a 20 ms tick typically encodes to 12-16 bytes instead of 32.
+class FlightRecordEncoder {
+public:
+  // The next record is written as a keyframe (delta against zero).
+  void reset();
+  // Returns the encoded size, or 0 if the record does not fit `capacity`.
+  size_t encode(const FlightRecord &record, uint8_t *out, size_t capacity);
+
+private:
+  FlightRecord previous_;
+  bool keyframePending_ = true;
+};
+
+class FlightRecordDecoder {
+public:
+  void reset();
+  // Returns the number of bytes consumed, or 0 on malformed input.
+  size_t decode(const uint8_t *in, size_t length, FlightRecord &record);
+
+private:
+  FlightRecord previous_;
+};
@@ -0,0 +1,101 @@
+#include "nav_frame.h"
+
+namespace {
+constexpr uint8_t FIELD_COUNT = NAV_FRAME_FIELD_COUNT;
+constexpr uint8_t SEQUENCE_MASK = delta_fields::HEAD_PAYLOAD_MASK;
+
+void toFields(const NavFrame &frame, uint32_t fields[FIELD_COUNT]) {
+  fields[0] = frame.tMs;
+  for (uint8_t i = 0; i < 4; ++i) {
+    fields[1 + i] = frame.raw[i];
+    fields[5 + i] = frame.amplitudeDeci[i];
+  }
+  fields[9] = static_cast<uint32_t>(static_cast<int32_t>(frame.thetaCentiDeg));
+  fields[10] = frame.signalDeci;
+  fields[11] = frame.dutyLeft;
+  fields[12] = frame.dutyRight;
+  fields[13] = frame.flags;
+}
+
+void fromFields(const uint32_t fields[FIELD_COUNT], NavFrame &frame) {
+  frame.tMs = fields[0];
+  for (uint8_t i = 0; i < 4; ++i) {
+    frame.raw[i] = static_cast<uint16_t>(fields[1 + i]);
+    frame.amplitudeDeci[i] = static_cast<uint16_t>(fields[5 + i]);
+  }
+  frame.thetaCentiDeg = static_cast<int16_t>(fields[9]);
+  frame.signalDeci = fields[10];
+  frame.dutyLeft = static_cast<uint16_t>(fields[11]);
+  frame.dutyRight = static_cast<uint16_t>(fields[12]);
+  frame.flags = static_cast<uint8_t>(fields[13]);
+}
+} // namespace
+
+NavStreamEncoder::NavStreamEncoder(uint16_t keyframeInterval)
+    : keyframeInterval_(keyframeInterval == 0 ? 1 : keyframeInterval) {}
+
+void NavStreamEncoder::reset() { keyframePending_ = true; }
+
+size_t NavStreamEncoder::encode(const NavFrame &frame, uint8_t *out,
+                                size_t capacity) {
+  const bool keyframe = keyframePending_ || sinceKeyframe_ >= keyframeInterval_;
+  uint32_t current[FIELD_COUNT];
+  uint32_t previous[FIELD_COUNT];
+  toFields(frame, current);
+  toFields(previous_, previous);
+
+  const size_t length = delta_fields::encode(
+      sequence_, keyframe, current, previous, FIELD_COUNT, out, capacity);
+  if (length == 0) {
+    return 0;
+  }
+
+  previous_ = frame;
+  keyframePending_ = false;
+  sinceKeyframe_ = keyframe ? 1 : static_cast<uint16_t>(sinceKeyframe_ + 1);
+  sequence_ = static_cast<uint8_t>((sequence_ + 1) & SEQUENCE_MASK);
+  return length;
+}
+
+void NavStreamDecoder::reset() {
+  previous_ = NavFrame();
+  synced_ = false;
+  expectedSequence_ = 0;
+}
+
+NavDecodeStatus NavStreamDecoder::decode(const uint8_t *in, size_t length,
+                                         NavFrame &frame, size_t &used) {
+  uint32_t fields[FIELD_COUNT];
+  toFields(previous_, fields);
+  uint8_t sequence = 0;
+  bool keyframe = false;
+  used = delta_fields::decode(in, length, fields, FIELD_COUNT, sequence,
+                              keyframe);
+  if (used == 0) {
+    synced_ = false;
+    return NavDecodeStatus::MALFORMED;
+  }
+
+  keyframe_ = keyframe;
+  if (synced_ && sequence != expectedSequence_) {
+    lostFrames_ += (sequence - expectedSequence_) & SEQUENCE_MASK;
+    synced_ = false;
+  }
+  expectedSequence_ = static_cast<uint8_t>((sequence + 1) & SEQUENCE_MASK);
+
+  if (!synced_ && !keyframe) {
+    skippedFrames_++;
+    return NavDecodeStatus::WAITING_FOR_KEYFRAME;
+  }
+
+  synced_ = true;
+  fromFields(fields, frame);
+  previous_ = frame;
+  return NavDecodeStatus::FRAME;
+}
+
+bool NavStreamDecoder::keyframe() const { return keyframe_; }
+
+uint32_t NavStreamDecoder::lostFrames() const { return lostFrames_; }
+
+uint32_t NavStreamDecoder::skippedFrames() const { return skippedFrames_; }
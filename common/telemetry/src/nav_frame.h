@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "delta_fields.h"
+
+// One beacon_nav telemetry frame, quantized to the precision of the ASCII
+// log (amplitudes and signal to 0.1 counts, bearing to 0.01 deg).
+struct NavFrame {
+  enum Flags : uint8_t {
+    FLAG_DETECTED = 1U << 0,
+    FLAG_SEARCH = 1U << 1,
+  };
+
+  uint32_t tMs = 0;
+  uint16_t raw[4] = {0, 0, 0, 0}; // front, back, left, right
+  uint16_t amplitudeDeci[4] = {0, 0, 0, 0};
+  int16_t thetaCentiDeg = 0;
+  uint32_t signalDeci = 0;
+  uint16_t dutyLeft = 0;
+  uint16_t dutyRight = 0;
+  uint8_t flags = 0;
+};
+
+// Fields the codec carries per frame: tMs, raw[4], amplitudeDeci[4],
+// thetaCentiDeg, signalDeci, dutyLeft, dutyRight, flags.
+constexpr uint8_t NAV_FRAME_FIELD_COUNT = 14;
+static_assert(NAV_FRAME_FIELD_COUNT <= delta_fields::MAX_FIELDS,
+              "NavFrame has more fields than a delta record can carry");
+
+// Worst-case encoded size of one frame (73 bytes): every field changed by a
+// full-width delta.
+constexpr size_t NAV_FRAME_MAX_BYTES =
+    delta_fields::maxEncodedSize(NAV_FRAME_FIELD_COUNT);
+static_assert(NAV_FRAME_MAX_BYTES ==
+                  1 + 2 + NAV_FRAME_FIELD_COUNT * varint::MAX_BYTES_32,
+              "head byte, two mask bytes and a 5-byte delta per field");
+
+// Streaming delta codec for NavFrame. Every frame carries a 7-bit sequence
+// number; a keyframe every `keyframeInterval` frames lets a receiver that
+// missed frames resynchronize.
+class NavStreamEncoder {
+public:
+  explicit NavStreamEncoder(uint16_t keyframeInterval = 50);
+
+  // Forces the next frame to be a keyframe.
+  void reset();
+  // Returns the encoded size, or 0 if the frame does not fit `capacity`.
+  size_t encode(const NavFrame &frame, uint8_t *out, size_t capacity);
+
+private:
+  NavFrame previous_;
+  uint16_t keyframeInterval_;
+  uint16_t sinceKeyframe_ = 0;
+  bool keyframePending_ = true;
+  uint8_t sequence_ = 0;
+};
+
+enum class NavDecodeStatus : uint8_t {
+  FRAME,
+  // A delta frame arrived while out of sync; it was skipped.
+  WAITING_FOR_KEYFRAME,
+  MALFORMED
+};
+
+class NavStreamDecoder {
+public:
+  void reset();
+  // Decodes one frame from `in`; `used` is the number of bytes consumed and
+  // is valid for FRAME and WAITING_FOR_KEYFRAME.
+  NavDecodeStatus decode(const uint8_t *in, size_t length, NavFrame &frame,
+                         size_t &used);
+
+  // The last decoded frame was a keyframe: a decoder that starts there is
+  // in sync.
+  bool keyframe() const;
+  // Frames known to be missing from sequence gaps (modulo 128).
+  uint32_t lostFrames() const;
+  uint32_t skippedFrames() const;
+
+private:
+  NavFrame previous_;
+  bool synced_ = false;
+  bool keyframe_ = false;
+  uint8_t expectedSequence_ = 0;
+  uint32_t lostFrames_ = 0;
+  uint32_t skippedFrames_ = 0;
+};
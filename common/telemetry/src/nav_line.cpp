@@ -0,0 +1,55 @@
+#include "nav_line.h"
+
+#include <cstring>
+
+constexpr const char *NavLineWriter::PREFIX;
+
+NavLineWriter::NavLineWriter(uint16_t keyframeInterval)
+    : encoder_(keyframeInterval) {
+  line_[0] = '\0';
+}
+
+void NavLineWriter::reset() {
+  encoder_.reset();
+  used_ = 0;
+  frameCount_ = 0;
+}
+
+bool NavLineWriter::add(const NavFrame &frame) {
+  const size_t length =
+      encoder_.encode(frame, payload_ + used_, PAYLOAD_CAPACITY - used_);
+  if (length == 0) {
+    return false;
+  }
+  used_ += length;
+  frameCount_++;
+  return true;
+}
+
+bool NavLineWriter::full() const {
+  return used_ + NAV_FRAME_MAX_BYTES > PAYLOAD_CAPACITY;
+}
+
+bool NavLineWriter::empty() const { return frameCount_ == 0; }
+
+uint16_t NavLineWriter::frameCount() const { return frameCount_; }
+
+const char *NavLineWriter::flush() {
+  memcpy(line_, PREFIX, PREFIX_LENGTH);
+  base64::encode(payload_, used_, line_ + PREFIX_LENGTH,
+                 LINE_CAPACITY - PREFIX_LENGTH);
+  used_ = 0;
+  frameCount_ = 0;
+  return line_;
+}
+
+size_t NavLineWriter::take(uint8_t *out, size_t capacity) {
+  if (used_ > capacity) {
+    return 0;
+  }
+  const size_t length = used_;
+  memcpy(out, payload_, length);
+  used_ = 0;
+  frameCount_ = 0;
+  return length;
+}
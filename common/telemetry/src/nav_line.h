@@ -0,0 +1,42 @@
+#pragma once
+
+#include "base64.h"
+#include "nav_frame.h"
+
+// Batches encoded NavFrames into one text line, `navz,<base64>`, for links
+// that only carry text: mesh log messages and the line-based serial log.
+class NavLineWriter {
+public:
+  static constexpr const char *PREFIX = "navz,";
+  static constexpr size_t PREFIX_LENGTH = 5;
+  static constexpr size_t PAYLOAD_CAPACITY = 180;
+  static constexpr size_t LINE_CAPACITY =
+      PREFIX_LENGTH + ((PAYLOAD_CAPACITY + 2) / 3) * 4 + 1;
+  static_assert(PAYLOAD_CAPACITY >= 2 * NAV_FRAME_MAX_BYTES,
+                "a line must hold at least two worst-case frames");
+
+  explicit NavLineWriter(uint16_t keyframeInterval = 50);
+
+  // Drops pending frames; the next frame is a keyframe.
+  void reset();
+  // Returns false when the frame does not fit; flush() and add it again.
+  bool add(const NavFrame &frame);
+  // True when another worst-case frame might not fit.
+  bool full() const;
+  bool empty() const;
+  uint16_t frameCount() const;
+
+  // Renders the pending frames and empties the batch. The returned line is
+  // valid until the next flush().
+  const char *flush();
+  // Copies the pending frames' encoded bytes, for links that carry binary,
+  // and empties the batch. Returns 0 if `capacity` is too small.
+  size_t take(uint8_t *out, size_t capacity);
+
+private:
+  NavStreamEncoder encoder_;
+  uint8_t payload_[PAYLOAD_CAPACITY];
+  size_t used_ = 0;
+  uint16_t frameCount_ = 0;
+  char line_[LINE_CAPACITY];
+};
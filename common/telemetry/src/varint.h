@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// LEB128-style unsigned varints and zig-zag mapping for signed deltas.
+namespace varint {
+constexpr size_t MAX_BYTES_32 = 5;
+
+inline uint32_t zigzagEncode(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^
+         static_cast<uint32_t>(value >> 31);
+}
+
+inline int32_t zigzagDecode(uint32_t value) {
+  return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1U);
+}
+
+// Returns the number of bytes written, or 0 if `capacity` is too small.
+inline size_t write(uint32_t value, uint8_t *out, size_t capacity) {
+  size_t length = 0;
+  do {
+    if (length >= capacity) {
+      return 0;
+    }
+    uint8_t byte = static_cast<uint8_t>(value & 0x7FU);
+    value >>= 7;
+    if (value != 0) {
+      byte |= 0x80U;
+    }
+    out[length++] = byte;
+  } while (value != 0);
+  return length;
+}
+
+// Returns the number of bytes consumed, or 0 on truncated/overlong input.
+inline size_t read(const uint8_t *in, size_t length, uint32_t &value) {
+  value = 0;
+  for (size_t i = 0; i < length && i < MAX_BYTES_32; ++i) {
+    value |= static_cast<uint32_t>(in[i] & 0x7FU) << (7U * i);
+    if ((in[i] & 0x80U) == 0) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+} // namespace varint
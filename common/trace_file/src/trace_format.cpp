@@ -0,0 +1,98 @@
+#include "trace_format.h"
+
+#include <cstring>
+
+namespace trace_file {
+namespace {
+struct KnownColumn {
+  const char *name;
+  ColumnType type;
+  const char *unit;
+};
+
+// The columns of ir_meter recordings and capture_recv (--raw adds block),
+// and nav_decode's duties.
+const KnownColumn KNOWN_COLUMNS[] = {
+    {"t_ms", ColumnType::F64, "ms"},
+    {"raw_f", ColumnType::U16, "counts"},
+    {"raw_b", ColumnType::U16, "counts"},
+    {"raw_l", ColumnType::U16, "counts"},
+    {"raw_r", ColumnType::U16, "counts"},
+    {"A_F", ColumnType::F32, "counts"},
+    {"A_B", ColumnType::F32, "counts"},
+    {"A_L", ColumnType::F32, "counts"},
+    {"A_R", ColumnType::F32, "counts"},
+    {"vx", ColumnType::F32, "counts"},
+    {"vy", ColumnType::F32, "counts"},
+    {"theta_rad", ColumnType::F32, "rad"},
+    {"theta_deg", ColumnType::F32, "deg"},
+    {"S", ColumnType::F32, "counts"},
+    {"detected", ColumnType::U8, ""},
+    {"block", ColumnType::U32, ""},
+    {"node", ColumnType::U32, ""},
+    {"duty_l", ColumnType::U16, "duty"},
+    {"duty_r", ColumnType::U16, "duty"},
+};
+
+std::string fixedText(const char *text, size_t capacity) {
+  return std::string(text, strnlen(text, capacity));
+}
+} // namespace
+
+size_t typeSize(ColumnType type) {
+  switch (type) {
+  case ColumnType::U8:
+    return 1;
+  case ColumnType::U16:
+    return 2;
+  case ColumnType::U32:
+  case ColumnType::F32:
+    return 4;
+  case ColumnType::F64:
+    return 8;
+  }
+  return 0;
+}
+
+const char *typeName(ColumnType type) {
+  switch (type) {
+  case ColumnType::U8:
+    return "u8";
+  case ColumnType::U16:
+    return "u16";
+  case ColumnType::U32:
+    return "u32";
+  case ColumnType::F32:
+    return "f32";
+  case ColumnType::F64:
+    return "f64";
+  }
+  return "unknown";
+}
+
+bool validType(uint8_t type) {
+  return type >= static_cast<uint8_t>(ColumnType::U8) &&
+         type <= static_cast<uint8_t>(ColumnType::F64);
+}
+
+Column beaconColumn(const std::string &name) {
+  Column column;
+  column.name = name;
+  for (const KnownColumn &known : KNOWN_COLUMNS) {
+    if (name == known.name) {
+      column.type = known.type;
+      column.unit = known.unit;
+      break;
+    }
+  }
+  return column;
+}
+
+std::string columnName(const ColumnDesc &desc) {
+  return fixedText(desc.name, NAME_CAPACITY);
+}
+
+std::string columnUnit(const ColumnDesc &desc) {
+  return fixedText(desc.unit, UNIT_CAPACITY);
+}
+} // namespace trace_file
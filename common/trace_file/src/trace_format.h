@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// On-disk layout of a beacon trace (.btr): the columns of a recording CSV
+// (evaluation/data, capture_recv) as typed arrays a reader can use straight
+// from a memory map. Everything is little-endian.
+//
+//   FileHeader
+//   ColumnDesc[columnCount]
+//   meta text, metaBytes long: "key=value\n" lines, zero padded
+//   chunk*: ChunkHeader, then per column `rows` values, each array zero
+//           padded to ALIGNMENT
+//
+// Every section is a multiple of ALIGNMENT long, so each column array is
+// aligned for its type in a mapping. A writer appends whole chunks; a
+// reader ignores a last chunk that is cut short, as a live capture or a
+// crash leaves it.
+namespace trace_file {
+constexpr char FILE_MAGIC[4] = {'B', 'T', 'R', 'C'};
+constexpr char CHUNK_MAGIC[4] = {'C', 'H', 'N', 'K'};
+constexpr uint16_t VERSION = 1;
+constexpr size_t ALIGNMENT = 8;
+constexpr size_t NAME_CAPACITY = 20;
+constexpr size_t UNIT_CAPACITY = 10;
+
+enum class ColumnType : uint8_t { U8 = 1, U16, U32, F32, F64 };
+
+struct FileHeader {
+  char magic[4];
+  uint16_t version;
+  uint16_t columnCount;
+  uint32_t metaBytes;
+  uint32_t reserved;
+};
+
+struct ColumnDesc {
+  char name[NAME_CAPACITY]; // zero padded, not terminated when full
+  char unit[UNIT_CAPACITY];
+  uint8_t type;
+  uint8_t reserved;
+};
+
+struct ChunkHeader {
+  char magic[4];
+  uint32_t rows;
+  uint32_t payloadBytes;
+  uint32_t crc; // crc32 of the payload
+};
+
+static_assert(sizeof(FileHeader) == 16, "FileHeader layout");
+static_assert(sizeof(ColumnDesc) == 32, "ColumnDesc layout");
+static_assert(sizeof(ChunkHeader) == 16, "ChunkHeader layout");
+
+struct Column {
+  std::string name;
+  ColumnType type = ColumnType::F64;
+  std::string unit;
+};
+
+size_t typeSize(ColumnType type);
+const char *typeName(ColumnType type);
+bool validType(uint8_t type);
+
+inline size_t padded(size_t bytes) {
+  return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// Bytes of one column array of `rows` values, padding included.
+inline size_t arrayBytes(ColumnType type, uint32_t rows) {
+  return padded(typeSize(type) * rows);
+}
+
+// The type and unit of a recording column by its CSV name (t_ms, raw_f,
+// A_F, theta_deg, detected, duty_l, ...). Columns it does not know are
+// stored as F64 without a unit.
+Column beaconColumn(const std::string &name);
+
+std::string columnName(const ColumnDesc &desc);
+std::string columnUnit(const ColumnDesc &desc);
+
+template <typename T> struct TypeOf;
+template <> struct TypeOf<uint8_t> {
+  static constexpr ColumnType value = ColumnType::U8;
+};
+template <> struct TypeOf<uint16_t> {
+  static constexpr ColumnType value = ColumnType::U16;
+};
+template <> struct TypeOf<uint32_t> {
+  static constexpr ColumnType value = ColumnType::U32;
+};
+template <> struct TypeOf<float> {
+  static constexpr ColumnType value = ColumnType::F32;
+};
+template <> struct TypeOf<double> {
+  static constexpr ColumnType value = ColumnType::F64;
+};
+} // namespace trace_file
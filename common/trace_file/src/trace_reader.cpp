@@ -0,0 +1,196 @@
+#include "trace_reader.h"
+
+#include <crc32.h>
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace trace_file {
+namespace {
+bool littleEndianHost() {
+  const uint16_t probe = 1;
+  uint8_t first;
+  memcpy(&first, &probe, 1);
+  return first == 1;
+}
+} // namespace
+
+TraceReader::~TraceReader() { close(); }
+
+bool TraceReader::open(const char *path) {
+  close();
+  error_.clear();
+  if (!littleEndianHost()) {
+    return fail("big-endian host");
+  }
+  const int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    return fail("cannot open");
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size < 0) {
+    ::close(fd);
+    return fail("cannot stat");
+  }
+  size_ = static_cast<size_t>(info.st_size);
+  if (size_ < sizeof(FileHeader)) {
+    ::close(fd);
+    return fail("too short for a header");
+  }
+  void *mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd); // the mapping keeps the file
+  if (mapped == MAP_FAILED) {
+    size_ = 0;
+    return fail("cannot map");
+  }
+  base_ = static_cast<const uint8_t *>(mapped);
+
+  header_ = reinterpret_cast<const FileHeader *>(base_);
+  if (memcmp(header_->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+    return fail("not a trace file");
+  }
+  if (header_->version != VERSION) {
+    return fail("unsupported version");
+  }
+  const size_t directoryBytes =
+      sizeof(FileHeader) + header_->columnCount * sizeof(ColumnDesc);
+  if (header_->columnCount == 0 || header_->metaBytes % ALIGNMENT != 0 ||
+      size_ < directoryBytes + header_->metaBytes) {
+    return fail("bad header");
+  }
+  columns_ = reinterpret_cast<const ColumnDesc *>(base_ + sizeof(FileHeader));
+  for (size_t i = 0; i < header_->columnCount; ++i) {
+    if (!validType(columns_[i].type)) {
+      return fail("bad column type");
+    }
+  }
+  meta_ = reinterpret_cast<const char *>(base_ + directoryBytes);
+
+  size_t at = directoryBytes + header_->metaBytes;
+  while (size_ - at >= sizeof(ChunkHeader)) {
+    const ChunkHeader *chunk = reinterpret_cast<const ChunkHeader *>(base_ + at);
+    if (memcmp(chunk->magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0 ||
+        chunk->rows == 0 ||
+        chunk->payloadBytes != chunkPayloadBytes(chunk->rows) ||
+        size_ - at - sizeof(ChunkHeader) < chunk->payloadBytes) {
+      break;
+    }
+    const size_t payload = at + sizeof(ChunkHeader);
+    chunks_.push_back(
+        Chunk{payload, chunk->rows, chunk->crc, chunk->payloadBytes});
+    size_t offset = 0;
+    for (size_t i = 0; i < header_->columnCount; ++i) {
+      offsets_.push_back(offset);
+      offset += arrayBytes(columnType(i), chunk->rows);
+    }
+    rows_ += chunk->rows;
+    at = payload + chunk->payloadBytes;
+  }
+  end_ = at;
+  return true;
+}
+
+void TraceReader::close() {
+  if (base_ != nullptr) {
+    munmap(const_cast<uint8_t *>(base_), size_);
+  }
+  base_ = nullptr;
+  size_ = 0;
+  end_ = 0;
+  header_ = nullptr;
+  columns_ = nullptr;
+  meta_ = nullptr;
+  chunks_.clear();
+  offsets_.clear();
+  rows_ = 0;
+}
+
+size_t TraceReader::columnCount() const {
+  return header_ != nullptr ? header_->columnCount : 0;
+}
+
+const ColumnDesc &TraceReader::column(size_t index) const {
+  return columns_[index];
+}
+
+ColumnType TraceReader::columnType(size_t index) const {
+  return static_cast<ColumnType>(columns_[index].type);
+}
+
+int TraceReader::find(const char *name) const {
+  for (size_t i = 0; i < columnCount(); ++i) {
+    if (columnName(columns_[i]) == name) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+std::string TraceReader::meta() const {
+  return meta_ != nullptr ? std::string(meta_, strnlen(meta_, header_->metaBytes))
+                          : std::string();
+}
+
+std::string TraceReader::metaValue(const char *key) const {
+  const std::string text = meta();
+  const size_t keyLength = strlen(key);
+  size_t line = 0;
+  while (line < text.size()) {
+    size_t lineEnd = text.find('\n', line);
+    if (lineEnd == std::string::npos) {
+      lineEnd = text.size();
+    }
+    if (lineEnd - line > keyLength &&
+        text.compare(line, keyLength, key) == 0 &&
+        text[line + keyLength] == '=') {
+      return text.substr(line + keyLength + 1, lineEnd - line - keyLength - 1);
+    }
+    line = lineEnd + 1;
+  }
+  return std::string();
+}
+
+const void *TraceReader::data(size_t chunk, size_t column) const {
+  return base_ + chunks_[chunk].payload +
+         offsets_[chunk * header_->columnCount + column];
+}
+
+double TraceReader::value(size_t chunk, size_t column, uint32_t row) const {
+  const void *values = data(chunk, column);
+  switch (columnType(column)) {
+  case ColumnType::U8:
+    return static_cast<const uint8_t *>(values)[row];
+  case ColumnType::U16:
+    return static_cast<const uint16_t *>(values)[row];
+  case ColumnType::U32:
+    return static_cast<const uint32_t *>(values)[row];
+  case ColumnType::F32:
+    return static_cast<const float *>(values)[row];
+  case ColumnType::F64:
+    return static_cast<const double *>(values)[row];
+  }
+  return 0.0;
+}
+
+bool TraceReader::verifyChunk(size_t chunk) const {
+  return crc32::compute(base_ + chunks_[chunk].payload,
+                        chunks_[chunk].payloadBytes) == chunks_[chunk].crc;
+}
+
+bool TraceReader::fail(const std::string &error) {
+  close();
+  error_ = error;
+  return false;
+}
+
+size_t TraceReader::chunkPayloadBytes(uint32_t rows) const {
+  size_t bytes = 0;
+  for (size_t i = 0; i < header_->columnCount; ++i) {
+    bytes += arrayBytes(columnType(i), rows);
+  }
+  return bytes;
+}
+} // namespace trace_file
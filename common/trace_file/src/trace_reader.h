@@ -0,0 +1,79 @@
+#pragma once
+
+#include "trace_format.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace trace_file {
+// Maps a trace file read-only and hands out its column arrays in place:
+// opening reads the header and walks the chunk headers, nothing else.
+// Pointers stay valid until close().
+class TraceReader {
+public:
+  TraceReader() = default;
+  TraceReader(const TraceReader &) = delete;
+  TraceReader &operator=(const TraceReader &) = delete;
+  ~TraceReader();
+
+  bool open(const char *path);
+  void close();
+  // Why open() failed.
+  const std::string &error() const { return error_; }
+
+  size_t columnCount() const;
+  const ColumnDesc &column(size_t index) const;
+  ColumnType columnType(size_t index) const;
+  // Index of the named column, or -1.
+  int find(const char *name) const;
+
+  // The meta text, and the value of one of its keys ("" if it has none).
+  std::string meta() const;
+  std::string metaValue(const char *key) const;
+
+  size_t chunkCount() const { return chunks_.size(); }
+  uint32_t chunkRows(size_t chunk) const { return chunks_[chunk].rows; }
+  uint64_t rows() const { return rows_; }
+  // Bytes after the last complete chunk: an append cut short.
+  size_t tailBytes() const { return size_ - end_; }
+
+  const void *data(size_t chunk, size_t column) const;
+  // A column array of one chunk, or nullptr if the column is not a T.
+  template <typename T> const T *array(size_t chunk, size_t column) const {
+    return columnType(column) == TypeOf<T>::value
+               ? static_cast<const T *>(data(chunk, column))
+               : nullptr;
+  }
+  // One value of any column type, for tools that do not care.
+  double value(size_t chunk, size_t column, uint32_t row) const;
+
+  // Checks a chunk's payload against its CRC.
+  bool verifyChunk(size_t chunk) const;
+
+private:
+  struct Chunk {
+    size_t payload; // offset in the file
+    uint32_t rows;
+    uint32_t crc;
+    uint32_t payloadBytes;
+  };
+
+  bool fail(const std::string &error);
+  size_t chunkPayloadBytes(uint32_t rows) const;
+
+  const uint8_t *base_ = nullptr;
+  size_t size_ = 0;
+  size_t end_ = 0;
+  const FileHeader *header_ = nullptr;
+  const ColumnDesc *columns_ = nullptr;
+  const char *meta_ = nullptr;
+  std::vector<Chunk> chunks_;
+  // Offset of each column array within its chunk's payload,
+  // chunk * columnCount + column.
+  std::vector<size_t> offsets_;
+  uint64_t rows_ = 0;
+  std::string error_;
+};
+} // namespace trace_file
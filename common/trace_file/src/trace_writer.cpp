@@ -0,0 +1,166 @@
+#include "trace_writer.h"
+
+#include <crc32.h>
+
+#include <cmath>
+#include <cstring>
+
+namespace trace_file {
+namespace {
+const uint8_t PADDING[ALIGNMENT] = {};
+
+template <typename T> T toUnsigned(double value) {
+  const double max = static_cast<double>(static_cast<T>(~T(0)));
+  if (!(value > 0.0)) {
+    return 0; // negative or NaN
+  }
+  return value >= max ? static_cast<T>(~T(0))
+                      : static_cast<T>(std::lround(value));
+}
+
+void copyFixed(char *out, size_t capacity, const std::string &text) {
+  memset(out, 0, capacity);
+  memcpy(out, text.data(), text.size() < capacity ? text.size() : capacity);
+}
+} // namespace
+
+void addMeta(std::string &meta, const std::string &key,
+             const std::string &value) {
+  meta += key;
+  meta += '=';
+  meta += value;
+  meta += '\n';
+}
+
+TraceWriter::~TraceWriter() { close(); }
+
+bool TraceWriter::create(const char *path, const std::vector<Column> &columns,
+                         const std::string &meta, uint32_t chunkRows) {
+  close();
+  if (columns.empty() || columns.size() > UINT16_MAX || chunkRows == 0) {
+    return false;
+  }
+  file_ = std::fopen(path, "wb");
+  if (file_ == nullptr) {
+    return false;
+  }
+  columns_ = columns;
+  chunkRows_ = chunkRows;
+  stagedRows_ = 0;
+  rows_ = 0;
+  chunks_ = 0;
+  failed_ = false;
+  staged_.assign(columns_.size(), std::vector<uint8_t>());
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    staged_[i].assign(typeSize(columns_[i].type) * chunkRows_, 0);
+  }
+
+  FileHeader header = {};
+  memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+  header.version = VERSION;
+  header.columnCount = static_cast<uint16_t>(columns_.size());
+  header.metaBytes = static_cast<uint32_t>(padded(meta.size()));
+  failed_ = std::fwrite(&header, sizeof(header), 1, file_) != 1;
+  for (const Column &column : columns_) {
+    ColumnDesc desc = {};
+    copyFixed(desc.name, NAME_CAPACITY, column.name);
+    copyFixed(desc.unit, UNIT_CAPACITY, column.unit);
+    desc.type = static_cast<uint8_t>(column.type);
+    failed_ |= std::fwrite(&desc, sizeof(desc), 1, file_) != 1;
+  }
+  failed_ |= std::fwrite(meta.data(), 1, meta.size(), file_) != meta.size();
+  const size_t pad = header.metaBytes - meta.size();
+  failed_ |= std::fwrite(PADDING, 1, pad, file_) != pad;
+  failed_ |= std::fflush(file_) != 0;
+  return !failed_;
+}
+
+void TraceWriter::set(size_t column, double value) {
+  if (file_ == nullptr || column >= columns_.size()) {
+    return;
+  }
+  uint8_t *slot = staged_[column].data() +
+                  typeSize(columns_[column].type) * stagedRows_;
+  switch (columns_[column].type) {
+  case ColumnType::U8: {
+    const uint8_t v = toUnsigned<uint8_t>(value);
+    memcpy(slot, &v, sizeof(v));
+    break;
+  }
+  case ColumnType::U16: {
+    const uint16_t v = toUnsigned<uint16_t>(value);
+    memcpy(slot, &v, sizeof(v));
+    break;
+  }
+  case ColumnType::U32: {
+    const uint32_t v = toUnsigned<uint32_t>(value);
+    memcpy(slot, &v, sizeof(v));
+    break;
+  }
+  case ColumnType::F32: {
+    const float v = static_cast<float>(value);
+    memcpy(slot, &v, sizeof(v));
+    break;
+  }
+  case ColumnType::F64:
+    memcpy(slot, &value, sizeof(value));
+    break;
+  }
+}
+
+bool TraceWriter::endRow() {
+  if (file_ == nullptr) {
+    return false;
+  }
+  stagedRows_++;
+  rows_++;
+  return stagedRows_ < chunkRows_ || flush();
+}
+
+bool TraceWriter::flush() {
+  if (file_ == nullptr) {
+    return false;
+  }
+  if (stagedRows_ == 0) {
+    return !failed_;
+  }
+  ChunkHeader header = {};
+  memcpy(header.magic, CHUNK_MAGIC, sizeof(header.magic));
+  header.rows = stagedRows_;
+  uint32_t crc = 0;
+  size_t payloadBytes = 0;
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    const size_t bytes = typeSize(columns_[i].type) * stagedRows_;
+    const size_t pad = arrayBytes(columns_[i].type, stagedRows_) - bytes;
+    crc = crc32::update(crc, staged_[i].data(), bytes);
+    crc = crc32::update(crc, PADDING, pad);
+    payloadBytes += bytes + pad;
+  }
+  header.payloadBytes = static_cast<uint32_t>(payloadBytes);
+  header.crc = crc;
+
+  failed_ |= std::fwrite(&header, sizeof(header), 1, file_) != 1;
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    const size_t bytes = typeSize(columns_[i].type) * stagedRows_;
+    const size_t pad = arrayBytes(columns_[i].type, stagedRows_) - bytes;
+    failed_ |= std::fwrite(staged_[i].data(), 1, bytes, file_) != bytes;
+    failed_ |= std::fwrite(PADDING, 1, pad, file_) != pad;
+    memset(staged_[i].data(), 0, bytes);
+  }
+  failed_ |= std::fflush(file_) != 0;
+  stagedRows_ = 0;
+  chunks_++;
+  return !failed_;
+}
+
+bool TraceWriter::close() {
+  if (file_ == nullptr) {
+    return !failed_;
+  }
+  flush();
+  failed_ |= std::fclose(file_) != 0;
+  file_ = nullptr;
+  staged_.clear();
+  return !failed_;
+}
+} // namespace trace_file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "trace_format.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace trace_file {
+// Adds a "key=value" line to a trace's meta text.
+void addMeta(std::string &meta, const std::string &key,
+             const std::string &value);
+
+// Writes a trace row by row and appends it to the file a chunk at a time.
+// Each flushed chunk is complete on disk, so a reader can map the file
+// while a capture is still running.
+class TraceWriter {
+public:
+  static constexpr uint32_t DEFAULT_CHUNK_ROWS = 4096;
+
+  TraceWriter() = default;
+  TraceWriter(const TraceWriter &) = delete;
+  TraceWriter &operator=(const TraceWriter &) = delete;
+  ~TraceWriter();
+
+  // Creates the file (replacing one that is there) and writes the header.
+  bool create(const char *path, const std::vector<Column> &columns,
+              const std::string &meta,
+              uint32_t chunkRows = DEFAULT_CHUNK_ROWS);
+
+  size_t columnCount() const { return columns_.size(); }
+
+  // Sets a value of the row being built, converted to the column's type:
+  // unsigned columns round and clamp. Columns not set are 0.
+  void set(size_t column, double value);
+  // Ends the row; appends a chunk once chunkRows rows are staged.
+  bool endRow();
+  // Appends the staged rows as a chunk and flushes the file.
+  bool flush();
+  // Flushes and closes; false if anything failed to write.
+  bool close();
+
+  uint64_t rows() const { return rows_; }
+  uint32_t chunks() const { return chunks_; }
+
+private:
+  std::FILE *file_ = nullptr;
+  std::vector<Column> columns_;
+  std::vector<std::vector<uint8_t>> staged_;
+  uint32_t chunkRows_ = DEFAULT_CHUNK_ROWS;
+  uint32_t stagedRows_ = 0;
+  uint64_t rows_ = 0;
+  uint32_t chunks_ = 0;
+  bool failed_ = false;
+};
+} // namespace trace_file
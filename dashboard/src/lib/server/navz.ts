@@ -0,0 +1,118 @@
+// Decoder for `navz,<base64>` telemetry lines: batches of delta-encoded
+// beacon_nav frames (see common/telemetry/src/nav_frame.h for the format).
+
+export const NAVZ_PREFIX = "navz,";
+
+const FIELD_COUNT = 14;
+const KEYFRAME_BIT = 0x80;
+const SEQUENCE_MASK = 0x7f;
+const MAX_VARINT_BYTES = 5;
+
+export interface NavzFrame {
+	tMs: number;
+	mode: string;
+	rawF: number;
+	rawB: number;
+	rawL: number;
+	rawR: number;
+	ampF: number;
+	ampB: number;
+	ampL: number;
+	ampR: number;
+	thetaDeg: number;
+	signal: number;
+	detected: boolean;
+	dutyL: number;
+	dutyR: number;
+}
+
+function readVarint(
+	bytes: Uint8Array,
+	offset: number,
+): { value: number; next: number } | null {
+	let value = 0;
+	for (let i = 0; i < MAX_VARINT_BYTES && offset + i < bytes.length; i++) {
+		const byte = bytes[offset + i];
+		value += (byte & 0x7f) * 2 ** (7 * i);
+		if ((byte & 0x80) === 0) {
+			return { value: value >>> 0, next: offset + i + 1 };
+		}
+	}
+	return null;
+}
+
+function zigzagDecode(value: number): number {
+	return (value >>> 1) ^ -(value & 1);
+}
+
+function toFrame(fields: number[]): NavzFrame {
+	const flags = fields[13];
+	return {
+		tMs: fields[0],
+		mode: (flags & 0x02) !== 0 ? "search" : "track",
+		rawF: fields[1],
+		rawB: fields[2],
+		rawL: fields[3],
+		rawR: fields[4],
+		ampF: fields[5] / 10,
+		ampB: fields[6] / 10,
+		ampL: fields[7] / 10,
+		ampR: fields[8] / 10,
+		thetaDeg: ((fields[9] << 16) >> 16) / 100,
+		signal: fields[10] / 10,
+		detected: (flags & 0x01) !== 0,
+		dutyL: fields[11],
+		dutyR: fields[12],
+	};
+}
+
+// Keeps the delta state of one sender; use one decoder per node.
+export class NavzDecoder {
+	private fields: number[] = new Array(FIELD_COUNT).fill(0);
+	private synced = false;
+	private expectedSequence = 0;
+
+	decodePayload(base64: string): NavzFrame[] {
+		const bytes = new Uint8Array(Buffer.from(base64, "base64"));
+		const frames: NavzFrame[] = [];
+		let offset = 0;
+		while (offset < bytes.length) {
+			const head = bytes[offset];
+			const keyframe = (head & KEYFRAME_BIT) !== 0;
+			const sequence = head & SEQUENCE_MASK;
+			const mask = readVarint(bytes, offset + 1);
+			if (!mask) {
+				this.synced = false;
+				return frames;
+			}
+			offset = mask.next;
+
+			const decoded = this.fields.map((value) => (keyframe ? 0 : value));
+			for (let i = 0; i < FIELD_COUNT; i++) {
+				if ((mask.value & (1 << i)) === 0) {
+					continue;
+				}
+				const delta = readVarint(bytes, offset);
+				if (!delta) {
+					this.synced = false;
+					return frames;
+				}
+				offset = delta.next;
+				decoded[i] = (decoded[i] + zigzagDecode(delta.value)) >>> 0;
+			}
+
+			if (this.synced && sequence !== this.expectedSequence) {
+				this.synced = false;
+			}
+			this.expectedSequence = (sequence + 1) & SEQUENCE_MASK;
+			if (!this.synced && !keyframe) {
+				continue;
+			}
+
+			this.synced = true;
+			this.fields = decoded;
+			frames.push(toFrame(decoded));
+		}
+		return frames;
+	}
+}
@@ -5,6 +5,7 @@ import type {
 	TelemetryStatus,
 	UartRawLine,
 } from "$lib/telemetry";
+import { NAVZ_PREFIX, NavzDecoder } from "./navz";
 
 type FrameListener = (frame: TelemetryFrame) => void;
 type RawLineListener = (raw: UartRawLine) => void;
@@ -113,32 +114,72 @@ function parseBeaconPayload(
 	};
 }
 
-function parseTelemetryLine(line: string): TelemetryFrame | null {
-	if (line.startsWith("beacon_nav,")) {
-		return parseBeaconPayload(line, "local", null);
+// Delta-decoding state per sender, keyed by node id ("local" for USB).
+const navzDecoders = new Map<string, NavzDecoder>();
+
+function parseNavzPayload(
+	payload: string,
+	source: TelemetryFrame["source"],
+	fromNode: number | null,
+): TelemetryFrame[] {
+	const key = fromNode === null ? "local" : String(fromNode);
+	let decoder = navzDecoders.get(key);
+	if (!decoder) {
+		decoder = new NavzDecoder();
+		navzDecoders.set(key, decoder);
+	}
+
+	const receivedAtMs = Date.now();
+	return decoder
+		.decodePayload(payload.slice(NAVZ_PREFIX.length))
+		.map((frame) => ({
+			source,
+			fromNode,
+			receivedAtMs,
+			rawLine: payload,
+			...frame,
+		}));
+}
+
+function parsePayload(
+	payload: string,
+	source: TelemetryFrame["source"],
+	fromNode: number | null,
+): TelemetryFrame[] {
+	if (payload.startsWith(NAVZ_PREFIX)) {
+		return parseNavzPayload(payload, source, fromNode);
+	}
+
+	const frame = parseBeaconPayload(payload, source, fromNode);
+	return frame ? [frame] : [];
+}
+
+function parseTelemetryLine(line: string): TelemetryFrame[] {
+	if (line.startsWith("beacon_nav,") || line.startsWith(NAVZ_PREFIX)) {
+		return parsePayload(line, "local", null);
 	}
 
 	if (line.startsWith("wireless_log,")) {
 		const rest = line.slice("wireless_log,".length);
 		const separator = rest.indexOf(",");
 		if (separator <= 0) {
-			return null;
+			return [];
 		}
 
 		const fromNode = parseInteger(rest.slice(0, separator));
 		const payload = rest.slice(separator + 1);
 		if (fromNode === null) {
-			return null;
+			return [];
 		}
 
-		return parseBeaconPayload(payload, "wireless", fromNode);
+		return parsePayload(payload, "wireless", fromNode);
 	}
 
-	if (line.startsWith("log:beacon_nav,")) {
-		return parseBeaconPayload(line.slice(4), "wireless", null);
+	if (line.startsWith("log:")) {
+		return parsePayload(line.slice(4), "wireless", null);
 	}
 
-	return null;
+	return [];
 }
 
 class UartTelemetryService {
@@ -316,13 +357,13 @@ class UartTelemetryService {
 
 		const receivedAtMs = Date.now();
 		this.status.lastLineAtMs = receivedAtMs;
-		const frame = parseTelemetryLine(line);
+		const frames = parseTelemetryLine(line);
 		this.status.rawLinesReceived++;
 
 		const raw: UartRawLine = {
 			receivedAtMs,
 			line,
-			parsed: frame !== null,
+			parsed: frames.length > 0,
 		};
 		this.rawLines.push(raw);
 		if (this.rawLines.length > MAX_RAW_BUFFER) {
@@ -330,17 +371,14 @@ class UartTelemetryService {
 		}
 		this.emitRawLine(raw);
 
-		if (!frame) {
-			return;
+		for (const frame of frames) {
+			this.status.framesReceived++;
+			this.frames.push(frame);
+			this.emitFrame(frame);
 		}
-
-		this.status.framesReceived++;
-		this.frames.push(frame);
 		if (this.frames.length > MAX_FRAME_BUFFER) {
 			this.frames.splice(0, this.frames.length - MAX_FRAME_BUFFER);
 		}
-
-		this.emitFrame(frame);
 	}
 }
 
@@ -0,0 +1,77 @@
+"""Read beacon traces (.btr, common/trace_file) as numpy arrays.
+
+The arrays of a single-chunk trace (trace_convert) are views into the
+memory-mapped file; traces with several chunks (capture_recv --trace) are
+concatenated per column.
+"""
+
+from __future__ import annotations
+
+import mmap
+import struct
+from pathlib import Path
+
+import numpy as np
+import pandas as pd
+
+FILE_MAGIC = b"BTRC"
+CHUNK_MAGIC = b"CHNK"
+VERSION = 1
+ALIGNMENT = 8
+FILE_HEADER = struct.Struct("<4sHHII")
+COLUMN_DESC = struct.Struct("<20s10sBB")
+CHUNK_HEADER = struct.Struct("<4sIII")
+DTYPES = {1: "<u1", 2: "<u2", 3: "<u4", 4: "<f4", 5: "<f8"}
+
+
+def padded(size: int) -> int:
+    return (size + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+
+def read_trace(path: Path) -> tuple[dict[str, np.ndarray], dict[str, str], dict[str, str]]:
+    """Returns (columns, units, meta) of a trace file."""
+    with open(path, "rb") as file:
+        data = mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ)
+
+    magic, version, column_count, meta_bytes, _ = FILE_HEADER.unpack_from(data, 0)
+    if magic != FILE_MAGIC or version != VERSION:
+        raise ValueError(f"{path}: not a version {VERSION} trace file")
+    names, units, dtypes = [], {}, []
+    offset = FILE_HEADER.size
+    for _ in range(column_count):
+        name, unit, type_id, _ = COLUMN_DESC.unpack_from(data, offset)
+        name = name.rstrip(b"\0").decode()
+        names.append(name)
+        units[name] = unit.rstrip(b"\0").decode()
+        dtypes.append(np.dtype(DTYPES[type_id]))
+        offset += COLUMN_DESC.size
+    meta_text = bytes(data[offset : offset + meta_bytes]).rstrip(b"\0").decode()
+    meta = dict(line.split("=", 1) for line in meta_text.splitlines() if "=" in line)
+    offset += meta_bytes
+
+    chunks: list[list[np.ndarray]] = [[] for _ in names]
+    while len(data) - offset >= CHUNK_HEADER.size:
+        magic, rows, payload_bytes, _ = CHUNK_HEADER.unpack_from(data, offset)
+        expected = sum(padded(dtype.itemsize * rows) for dtype in dtypes)
+        payload = offset + CHUNK_HEADER.size
+        # A chunk cut short is an append still in progress.
+        if magic != CHUNK_MAGIC or payload_bytes != expected or len(data) - payload < expected:
+            break
+        for i, dtype in enumerate(dtypes):
+            chunks[i].append(np.frombuffer(data, dtype=dtype, count=rows, offset=payload))
+            payload += padded(dtype.itemsize * rows)
+        offset = payload
+
+    columns = {
+        name: parts[0] if len(parts) == 1 else np.concatenate(parts) if parts else np.empty(0, dtype)
+        for name, parts, dtype in zip(names, chunks, dtypes)
+    }
+    return columns, units, meta
+
+
+def load_recording(path: Path) -> pd.DataFrame:
+    """A recording as a DataFrame, from a CSV or a trace file."""
+    if path.suffix == ".btr":
+        columns, _, _ = read_trace(path)
+        return pd.DataFrame(columns, copy=False)
+    return pd.read_csv(path)
@@ -1,5 +1,5 @@
 #!/usr/bin/env python3
-"""Visualize beacon tracking CSV recordings."""
+"""Visualize beacon tracking recordings (CSV or .btr trace)."""
 
 from __future__ import annotations
 
@@ -9,6 +9,8 @@ from pathlib import Path
 import matplotlib.pyplot as plt
 import pandas as pd
 
+from trace_file import load_recording
+
 
 def parse_args() -> argparse.Namespace:
     parser = argparse.ArgumentParser(description="Plot recorded beacon tracking CSV data")
@@ -16,7 +18,7 @@ def parse_args() -> argparse.Namespace:
         "--input",
         type=Path,
         default=Path("data/test1.csv"),
-        help="Path to input CSV file",
+        help="Path to input CSV or .btr trace file",
     )
     parser.add_argument(
         "--output",
@@ -55,9 +57,9 @@ def validate_columns(df: pd.DataFrame) -> None:
 def main() -> None:
     args = parse_args()
     if not args.input.exists():
-        raise FileNotFoundError(f"Input CSV not found: {args.input}")
+        raise FileNotFoundError(f"Input recording not found: {args.input}")
 
-    df = pd.read_csv(args.input)
+    df = load_recording(args.input)
     validate_columns(df)
 
     time_s = (df["t_ms"] - df["t_ms"].iloc[0]) / 1000.0
@@ -0,0 +1,135 @@
+#include "capture_stream.h"
+
+#include <Dezibot.h>
+
+namespace {
+constexpr uint32_t SAMPLER_STACK_SIZE = 3072;
+constexpr UBaseType_t SAMPLER_PRIORITY = configMAX_PRIORITIES - 2;
+constexpr BaseType_t SAMPLER_CORE = 0;
+constexpr uint32_t STOP_SETTLE_MS = 5;
+} // namespace
+
+constexpr size_t CaptureStream::FRAME_SIZE;
+
+bool CaptureStream::begin() {
+  freeQueue_ = xQueueCreate(2, sizeof(uint8_t));
+  filledQueue_ = xQueueCreate(2, sizeof(uint8_t));
+  if (freeQueue_ == nullptr || filledQueue_ == nullptr) {
+    return false;
+  }
+
+  if (xTaskCreatePinnedToCore(samplerTask, "ir_capture", SAMPLER_STACK_SIZE,
+                              this, SAMPLER_PRIORITY, &task_,
+                              SAMPLER_CORE) != pdPASS) {
+    return false;
+  }
+
+  esp_timer_create_args_t args = {};
+  args.callback = timerCallback;
+  args.arg = this;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "ir_capture";
+  return esp_timer_create(&args, &timer_) == ESP_OK;
+}
+
+bool CaptureStream::start(uint32_t rateHz) {
+  if (timer_ == nullptr || rateHz < MIN_RATE_HZ || rateHz > MAX_RATE_HZ) {
+    return false;
+  }
+  if (active_) {
+    stop();
+  }
+
+  xQueueReset(freeQueue_);
+  xQueueReset(filledQueue_);
+  const uint8_t spare = 1;
+  xQueueSend(freeQueue_, &spare, 0);
+  current_ = 0;
+  sampleIndex_ = 0;
+  periodUs_ = static_cast<uint16_t>(1000000UL / rateHz);
+
+  active_ = true;
+  return esp_timer_start_periodic(timer_, periodUs_) == ESP_OK;
+}
+
+void CaptureStream::stop() {
+  if (!active_) {
+    return;
+  }
+  esp_timer_stop(timer_);
+  active_ = false;
+  // Let a sample in progress finish before the buffers are reused.
+  delay(STOP_SETTLE_MS);
+}
+
+bool CaptureStream::active() const { return active_; }
+
+void CaptureStream::timerCallback(void *arg) {
+  CaptureStream *self = static_cast<CaptureStream *>(arg);
+  xTaskNotifyGive(self->task_);
+}
+
+void CaptureStream::samplerTask(void *arg) {
+  static_cast<CaptureStream *>(arg)->sampleLoop();
+}
+
+void CaptureStream::completeBlock() {
+  capture_block::Header &header = headers_[current_];
+  header.sequence = sequence_++;
+  header.periodUs = periodUs_;
+  header.sampleCount = SAMPLES_PER_BLOCK;
+
+  uint8_t next = 0;
+  if (xQueueReceive(freeQueue_, &next, 0) == pdTRUE) {
+    xQueueSend(filledQueue_, &current_, 0);
+    current_ = next;
+  } else {
+    // USB is behind: overwrite this block, its sequence number stays unused.
+    droppedBlocks_ = droppedBlocks_ + 1;
+  }
+  sampleIndex_ = 0;
+}
+
+void CaptureStream::sampleLoop() {
+  for (;;) {
+    const uint32_t ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!active_) {
+      continue;
+    }
+
+    capture_block::Header &header = headers_[current_];
+    if (sampleIndex_ == 0) {
+      header.firstSampleUs = static_cast<uint32_t>(esp_timer_get_time());
+      header.flags = 0;
+    }
+    if (ticks > 1) {
+      header.flags |= capture_block::FLAG_TICK_OVERRUN;
+    }
+
+    uint16_t *samples = reinterpret_cast<uint16_t *>(
+        frames_[current_] + capture_block::samplesOffset());
+    uint16_t *sample = samples + sampleIndex_ * capture_block::CHANNELS;
+    sample[0] = LightDetection::getValue(IR_FRONT);
+    sample[1] = LightDetection::getValue(IR_BACK);
+    sample[2] = LightDetection::getValue(IR_LEFT);
+    sample[3] = LightDetection::getValue(IR_RIGHT);
+
+    if (++sampleIndex_ == SAMPLES_PER_BLOCK) {
+      completeBlock();
+    }
+  }
+}
+
+void CaptureStream::service(Stream &out) {
+  uint8_t index = 0;
+  while (xQueueReceive(filledQueue_, &index, 0) == pdTRUE) {
+    const size_t size = capture_block::seal(headers_[index], frames_[index]);
+    out.write(frames_[index], size);
+    sentBlocks_++;
+    xQueueSend(freeQueue_, &index, 0);
+  }
+}
+
+uint32_t CaptureStream::sentBlocks() const { return sentBlocks_; }
+
+uint32_t CaptureStream::droppedBlocks() const { return droppedBlocks_; }
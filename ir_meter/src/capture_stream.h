@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+#include <capture_block.h>
+#include <esp_timer.h>
+
+// High-rate raw capture of the four IR channels. A timer wakes a sampler
+// task on core 0 that fills one of two frame buffers; loop() seals the
+// other one (header + CRC) and writes it to USB. If USB falls behind, the
+// sampler reuses its buffer and the block's sequence number is skipped, so
+// the receiver sees exactly which blocks were lost.
+class CaptureStream {
+public:
+  static constexpr uint32_t MIN_RATE_HZ = 100;
+  static constexpr uint32_t MAX_RATE_HZ = 4000;
+  static constexpr uint16_t SAMPLES_PER_BLOCK = 128;
+
+  bool begin();
+  // Returns false if the rate is out of range or begin() failed.
+  bool start(uint32_t rateHz);
+  void stop();
+  bool active() const;
+
+  // Writes completed blocks; call from loop().
+  void service(Stream &out);
+
+  uint32_t sentBlocks() const;
+  uint32_t droppedBlocks() const;
+
+private:
+  static constexpr size_t FRAME_SIZE =
+      capture_block::frameSize(SAMPLES_PER_BLOCK);
+
+  static void timerCallback(void *arg);
+  static void samplerTask(void *arg);
+  void sampleLoop();
+  void completeBlock();
+
+  uint8_t frames_[2][FRAME_SIZE];
+  capture_block::Header headers_[2];
+  QueueHandle_t freeQueue_ = nullptr;
+  QueueHandle_t filledQueue_ = nullptr;
+  TaskHandle_t task_ = nullptr;
+  esp_timer_handle_t timer_ = nullptr;
+
+  volatile bool active_ = false;
+  uint16_t periodUs_ = 0;
+  uint8_t current_ = 0;
+  uint16_t sampleIndex_ = 0;
+  uint32_t sequence_ = 0;
+  volatile uint32_t droppedBlocks_ = 0;
+  uint32_t sentBlocks_ = 0;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+
+#include <beacon_tracker.h>
+#include <cstdint>
+
+// Tracker tuning of the IR meter. Shared with the native capture receiver in
+// tools/ so replayed captures are filtered exactly like the live output.
+namespace ir_meter_config {
+constexpr uint32_t LOOP_PERIOD_MS = 20;
+
+constexpr float TRACKER_SIGNAL_MIN = 800.0f;
+constexpr float TRACKER_ANGLE_ALPHA = 0.18f;
+constexpr float TRACKER_MAX_ANGLE_STEP_RAD = 0.35f;
+constexpr float TRACKER_SIGNAL_DROP_GUARD_RATIO = 0.22f;
+constexpr uint16_t TRACKER_SATURATION_RAW_THRESHOLD = 4080;
+constexpr uint16_t TRACKER_GUARD_HOLD_MS = 120;
+
+inline BeaconTrackerConfig trackerConfig() {
+  BeaconTrackerConfig config;
+  config.signalMin = TRACKER_SIGNAL_MIN;
+  config.angleAlpha = TRACKER_ANGLE_ALPHA;
+  config.maxAngleStepRad = TRACKER_MAX_ANGLE_STEP_RAD;
+  config.signalDropGuardRatio = TRACKER_SIGNAL_DROP_GUARD_RATIO;
+  config.saturationRawThreshold = TRACKER_SATURATION_RAW_THRESHOLD;
+  config.guardHoldMs = TRACKER_GUARD_HOLD_MS;
+  return config;
+}
+} // namespace ir_meter_config
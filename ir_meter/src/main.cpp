@@ -1,24 +1,155 @@
-#include "beacon_tracker.h"
+#include "capture_stream.h"
+#include "ir_meter_config.h"
 #include <Arduino.h>
 #include <Dezibot.h>
 #include <autocharge/Autocharge.hpp>
+#include <beacon_tracker.h>
 #include <cmath>
+#include <nav_line.h>
+#include <serial_tx.h>
 
 auto dezibot = Dezibot();
-BeaconTrackerConfig trackerConfig;
 BeaconTracker tracker;
+CaptureStream capture;
 
-constexpr uint32_t LOOP_PERIOD_MS = 20;
+using ir_meter_config::LOOP_PERIOD_MS;
 constexpr float RADIANS_TO_DEG = 57.29577951308232f;
+constexpr float RADIANS_TO_CENTI_DEG = 5729.577951308232f;
 
-constexpr float TRACKER_SIGNAL_MIN = 800.0f;
-constexpr float TRACKER_ANGLE_ALPHA = 0.18f;
-constexpr float TRACKER_MAX_ANGLE_STEP_RAD = 0.35f;
-constexpr float TRACKER_SIGNAL_DROP_GUARD_RATIO = 0.22f;
-constexpr uint16_t TRACKER_SATURATION_RAW_THRESHOLD = 4080;
-constexpr uint16_t TRACKER_GUARD_HOLD_MS = 120;
+enum class UsbOutputFormat : uint8_t {
+  // One evaluation/data CSV row per tick.
+  CSV,
+  // Delta-encoded `navz,<base64>` lines, ~10 ticks each; decode with
+  // tools/ nav_decode.
+  NAVZ
+};
+constexpr UsbOutputFormat USB_OUTPUT_FORMAT = UsbOutputFormat::CSV;
+constexpr uint32_t NAVZ_FLUSH_PERIOD_MS = 200;
+constexpr uint16_t NAVZ_KEYFRAME_INTERVAL = 50;
 
+constexpr uint32_t CAPTURE_DEFAULT_RATE_HZ = 1000;
+constexpr uint8_t COMMAND_LINE_SIZE = 32;
+constexpr uint16_t SERIAL_OUT_SLOTS = 32;
+constexpr uint16_t SERIAL_OUT_SLOT_SIZE = 256; // fits a navz line
+
+SerialTx<SERIAL_OUT_SLOTS, SERIAL_OUT_SLOT_SIZE> serialOut;
 uint32_t nextLoopAtMs = 0;
+char commandLine[COMMAND_LINE_SIZE];
+uint8_t commandLength = 0;
+NavLineWriter navzOutput(NAVZ_KEYFRAME_INTERVAL);
+uint32_t lastNavzFlushAtMs = 0;
+
+uint16_t toDeci(float value) {
+  return static_cast<uint16_t>(value <= 0.0f ? 0.0f : value * 10.0f + 0.5f);
+}
+
+void printCsv(const BeaconTrackerState &state) {
+  serialOut.printf(
+      "%lu,%lu,%lu,%lu,%lu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.4f,%.2f,%.1f,%u\n",
+      static_cast<unsigned long>(state.timestampMs),
+      static_cast<unsigned long>(state.rawFront),
+      static_cast<unsigned long>(state.rawBack),
+      static_cast<unsigned long>(state.rawLeft),
+      static_cast<unsigned long>(state.rawRight), state.front, state.back,
+      state.left, state.right, state.vx, state.vy, state.filteredTheta,
+      state.filteredTheta * RADIANS_TO_DEG, state.totalSignal,
+      static_cast<unsigned>(state.detected ? 1 : 0));
+}
+
+void queueNavz(const BeaconTrackerState &state, uint32_t now) {
+  NavFrame frame;
+  frame.tMs = state.timestampMs;
+  frame.raw[0] = static_cast<uint16_t>(state.rawFront);
+  frame.raw[1] = static_cast<uint16_t>(state.rawBack);
+  frame.raw[2] = static_cast<uint16_t>(state.rawLeft);
+  frame.raw[3] = static_cast<uint16_t>(state.rawRight);
+  frame.amplitudeDeci[0] = toDeci(state.front);
+  frame.amplitudeDeci[1] = toDeci(state.back);
+  frame.amplitudeDeci[2] = toDeci(state.left);
+  frame.amplitudeDeci[3] = toDeci(state.right);
+  frame.thetaCentiDeg =
+      static_cast<int16_t>(lroundf(state.filteredTheta * RADIANS_TO_CENTI_DEG));
+  frame.signalDeci = static_cast<uint32_t>(state.totalSignal * 10.0f + 0.5f);
+  frame.flags = state.detected ? NavFrame::FLAG_DETECTED : 0;
+
+  if (!navzOutput.add(frame)) {
+    serialOut.println(navzOutput.flush());
+    navzOutput.add(frame);
+  }
+  if (navzOutput.full() || now - lastNavzFlushAtMs >= NAVZ_FLUSH_PERIOD_MS) {
+    serialOut.println(navzOutput.flush());
+    lastNavzFlushAtMs = now;
+  }
+}
+
+// Binary blocks bypass the ring; hold the port so no text line splits one.
+void serviceCapture() {
+  serialOut.lockOutput();
+  capture.service(Serial);
+  serialOut.unlockOutput();
+}
+
+void startCapture(const char *argument) {
+  uint32_t rateHz = CAPTURE_DEFAULT_RATE_HZ;
+  if (*argument != '\0') {
+    rateHz = static_cast<uint32_t>(strtoul(argument, nullptr, 10));
+  }
+  // The line goes out before the first binary block; receivers skip text.
+  if (!capture.start(rateHz)) {
+    serialOut.printf("capture,error,rate must be %lu-%lu Hz\n",
+                     static_cast<unsigned long>(CaptureStream::MIN_RATE_HZ),
+                     static_cast<unsigned long>(CaptureStream::MAX_RATE_HZ));
+    return;
+  }
+  serialOut.printf("capture,start,%lu,%u\n",
+                   static_cast<unsigned long>(rateHz),
+                   static_cast<unsigned>(CaptureStream::SAMPLES_PER_BLOCK));
+}
+
+void stopCapture() {
+  capture.stop();
+  serviceCapture();
+  serialOut.printf("\ncapture,stop,sent=%lu,dropped=%lu\n",
+                   static_cast<unsigned long>(capture.sentBlocks()),
+                   static_cast<unsigned long>(capture.droppedBlocks()));
+  tracker.reset();
+  navzOutput.reset();
+  nextLoopAtMs = millis();
+}
+
+void handleCommand(const char *command) {
+  if (strncmp(command, "capture start", 13) == 0) {
+    const char *argument = command + 13;
+    while (*argument == ' ') {
+      argument++;
+    }
+    startCapture(argument);
+  } else if (strcmp(command, "capture stop") == 0) {
+    stopCapture();
+  } else if (!capture.active()) {
+    serialOut.printf("Unknown command: %s\n", command);
+  }
+}
+
+void pollCommands() {
+  while (Serial.available() > 0) {
+    const char ch = static_cast<char>(Serial.read());
+    if (ch == '\r') {
+      continue;
+    }
+    if (ch != '\n') {
+      if (commandLength < COMMAND_LINE_SIZE - 1) {
+        commandLine[commandLength++] = ch;
+      }
+      continue;
+    }
+    commandLine[commandLength] = '\0';
+    if (commandLength > 0) {
+      handleCommand(commandLine);
+    }
+    commandLength = 0;
+  }
+}
 
 void setup() {
   delay(2000);
@@ -29,21 +160,25 @@ void setup() {
   Serial.println("+---------------------------+");
   Serial.println();
   dezibot.begin();
-  trackerConfig.signalMin = TRACKER_SIGNAL_MIN;
-  trackerConfig.angleAlpha = TRACKER_ANGLE_ALPHA;
-  trackerConfig.maxAngleStepRad = TRACKER_MAX_ANGLE_STEP_RAD;
-  trackerConfig.signalDropGuardRatio = TRACKER_SIGNAL_DROP_GUARD_RATIO;
-  trackerConfig.saturationRawThreshold = TRACKER_SATURATION_RAW_THRESHOLD;
-  trackerConfig.guardHoldMs = TRACKER_GUARD_HOLD_MS;
-  tracker = BeaconTracker(trackerConfig);
+  tracker = BeaconTracker(ir_meter_config::trackerConfig());
+  if (!capture.begin()) {
+    Serial.println("Capture mode unavailable");
+  }
   nextLoopAtMs = millis();
   Serial.println(
       "t_ms,raw_f,raw_b,raw_l,raw_r,A_F,A_B,A_L,A_R,vx,vy,theta_rad,theta_deg,S,"
       "detected");
   Serial.println("Setup complete");
+  serialOut.begin(Serial);
 }
 
 void loop() {
+  pollCommands();
+  if (capture.active()) {
+    serviceCapture();
+    return;
+  }
+
   const uint32_t now = millis();
   if (static_cast<int32_t>(now - nextLoopAtMs) < 0) {
     return;
@@ -61,14 +196,9 @@ void loop() {
   const BeaconTrackerState &state =
       tracker.update(rawFront, rawBack, rawLeft, rawRight, now);
 
-  Serial.printf(
-      "%lu,%lu,%lu,%lu,%lu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.4f,%.2f,%.1f,%u\n",
-      static_cast<unsigned long>(state.timestampMs),
-      static_cast<unsigned long>(state.rawFront),
-      static_cast<unsigned long>(state.rawBack),
-      static_cast<unsigned long>(state.rawLeft),
-      static_cast<unsigned long>(state.rawRight), state.front, state.back,
-      state.left, state.right, state.vx, state.vy, state.filteredTheta,
-      state.filteredTheta * RADIANS_TO_DEG, state.totalSignal,
-      static_cast<unsigned>(state.detected ? 1 : 0));
+  if (USB_OUTPUT_FORMAT == UsbOutputFormat::NAVZ) {
+    queueNavz(state, now);
+  } else {
+    printCsv(state);
+  }
 }
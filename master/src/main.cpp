@@ -1,54 +1,662 @@
 #include <Arduino.h>
 #include <Dezibot.h>
+#include <atomic>
 #include <autocharge/Autocharge.hpp>
+#include <beacon_power.h>
+#include <boot_timing.h>
+#include <bridge_link.h>
+#include <clock_sync.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <heartbeat.h>
+#include <mesh_bench.h>
+#include <mesh_messages.h>
+#include <nav_relay.h>
+#include <serial_tx.h>
+#include <session_stats.h>
 
 namespace {
 constexpr uint16_t BEACON_CARRIER_HZ = 10000;
-constexpr uint16_t BEACON_DUTY = 256;
+// Re-sent while unchanged so slaves that missed a change catch up.
+constexpr uint32_t BEACON_ADVERTISE_PERIOD_MS = 1000;
+constexpr uint8_t BEACON_REPORT_QUEUE_LENGTH = 8;
+constexpr uint8_t HEARTBEAT_QUEUE_LENGTH = 16;
+// A slave is counted as silent after this long without a heartbeat; the
+// slowest heartbeat period is 10 s.
+constexpr uint32_t HEARTBEAT_TIMEOUT_MS = 30000;
+constexpr uint32_t FLEET_SUMMARY_PERIOD_MS = 10000;
+constexpr uint8_t NAV_BATCH_QUEUE_LENGTH = 8;
+constexpr uint32_t NAV_RELAY_STATS_PERIOD_MS = 10000;
+constexpr uint16_t SERIAL_OUT_SLOTS = 16;
+// A raw nav_relay line is up to 270 bytes.
+constexpr uint16_t SERIAL_OUT_SLOT_SIZE = 288;
+// Relay lines are only queued while this many slots are free, so a burst of
+// telemetry never evicts a control line from the ring.
+constexpr uint16_t SERIAL_OUT_CONTROL_SLOTS = 6;
+constexpr uint8_t COMMAND_LINE_SIZE = 32;
+// The boot line goes out once the master runs and hears a slave, or after
+// this long without one.
+constexpr uint32_t BOOT_REPORT_TIMEOUT_MS = 30000;
+// Status interrupt of the motor controller (common/bridge_link), wired to
+// its GPIO 18 and pulled up here. Without the wire the line stays high and
+// the master runs on its loop period alone.
+constexpr uint8_t BRIDGE_IRQ_PIN = 3;
+// loop() runs this often, or at once when the bridge interrupt fires.
+constexpr uint32_t LOOP_PERIOD_MS = 5;
+// `stats last` without a count.
+constexpr uint8_t STATS_LAST_DEFAULT = 8;
 } // namespace
 
+// Logs from the charge callbacks run inside master.step(); keep them off
+// the blocking USB write path.
+SerialTx<SERIAL_OUT_SLOTS, SERIAL_OUT_SLOT_SIZE> serialOut;
+
+// The beacon duty follows the beacon reports of the walking slave. They
+// arrive as mesh broadcasts on the mesh task and are handled in loop().
+beacon_power::BeaconPowerController beaconPower;
+QueueHandle_t beaconReports = nullptr;
+uint32_t lastBeaconAdvertAtMs = 0;
+
+// Last status of every slave, from their heartbeats; see common/heartbeat.
+heartbeat::SlaveTable slaveTable;
+QueueHandle_t heartbeatQueue = nullptr;
+uint32_t lastFleetSummaryAtMs = 0;
+
+// Navigation telemetry of the walking slaves, summarized per slave and
+// relayed within a share of the serial link; see common/nav_relay. The
+// batches are copied off the mesh task and handled in loop(), after the
+// control work.
+struct NavBatchCopy {
+  uint32_t node;
+  uint8_t length;
+  uint8_t stream[mesh_proto::NAV_BATCH_CAPACITY];
+};
+nav_relay::NavRelay navRelay;
+QueueHandle_t navBatches = nullptr;
+std::atomic<uint32_t> navBatchesDropped(0);
+uint32_t lastNavRelayStatsAtMs = 0;
+
+// Charging sessions and per-phase percentiles; see common/session_stats.
+// The slave states come from the heartbeats. Master keeps its station state
+// to itself, so the bay's transitions are taken from what leads to them:
+// - LOWERING_GEAR: the bay is open and a slave is in wait;
+// - CLOSED: the bridge interrupt, or start_chg for that slave;
+// - ATTACHING_GEAR: the slave entered CHARGE;
+// - SLAVE_CHARGE: the bridge interrupt;
+// - LIFTING_GEAR: the slave asks to stop;
+// - OPEN: the bridge interrupt, or end_chg.
+// Without the interrupt the end of the attach is not visible from here.
+session_stats::SessionStats sessionStats;
+// Slave the bay is lowered for or serving, 0 while it is open.
+uint32_t bayNode = 0;
+session_stats::StationState bayState = session_stats::StationState::OPEN;
+uint32_t bayOpenedAtMs = 0;
+
+// The bridge interrupt wakes loop() out of its wait, so master.step() reads
+// the finished motion right away instead of up to a loop period later.
+TaskHandle_t loopTask = nullptr;
+std::atomic<uint32_t> bridgeIrqs(0);
+std::atomic<uint32_t> bridgeIrqAtUs(0);
+std::atomic<uint32_t> bridgeIrqAtMs(0);
+uint32_t bridgeIrqsSeen = 0;
+// Lines of a `stats` query still to print; they go out a few per loop
+// within the relay's share of the serial ring, so a query never pushes out
+// a control line.
+bool statsSummaryPending = false;
+uint8_t statsPhaseCursor = session_stats::PHASE_COUNT;
+uint8_t statsRecordCursor = 0;
+uint8_t statsRecordsLeft = 0;
+
+char commandLine[COMMAND_LINE_SIZE];
+uint8_t commandLength = 0;
+
+// See common/boot_timing.
+boot_timing::BootTimeline bootTimeline;
+bool firstTickDone = false;
+
+// The master's clock is the mesh timebase; see common/clock_sync.
+void logEvent(Master *master, const char *name, uint32_t subject) {
+  char line[clock_sync::EVENT_CAPACITY];
+  if (clock_sync::formatEvent(master->communication.getNodeId(),
+                              static_cast<uint64_t>(esp_timer_get_time()), 0,
+                              name, subject, line, sizeof(line)) > 0) {
+    serialOut.println(line);
+  }
+}
+
+void markStation(uint32_t node, session_stats::StationState state,
+                 uint32_t atMs) {
+  bayState = state;
+  if (state == session_stats::StationState::OPEN) {
+    bayOpenedAtMs = atMs;
+  }
+  sessionStats.onStationState(node, state, atMs);
+}
+
+// The open bay takes the slave that has waited longest, from when it
+// reopened or the slave came, whichever was later.
+void lowerForWaitingSlave() {
+  if (bayNode != 0) {
+    return;
+  }
+  const heartbeat::SlaveTable::Entry *next = nullptr;
+  for (uint8_t i = 0; i < slaveTable.count(); ++i) {
+    const heartbeat::SlaveTable::Entry &entry = slaveTable.at(i);
+    if (entry.status.state == heartbeat::SlaveState::WAIT_CHARGE &&
+        (next == nullptr || static_cast<int32_t>(entry.stateEnteredMs -
+                                                 next->stateEnteredMs) < 0)) {
+      next = &entry;
+    }
+  }
+  if (next != nullptr) {
+    bayNode = next->status.node;
+    markStation(bayNode, session_stats::StationState::LOWERING_GEAR,
+                static_cast<int32_t>(next->stateEnteredMs - bayOpenedAtMs) > 0
+                    ? next->stateEnteredMs
+                    : bayOpenedAtMs);
+  }
+}
+
 // put function declarations here:
 void start_chg(Master *master, SlaveData *slave) {
   if (slave == nullptr) {
-    Serial.println("start_chg skipped: slave is null");
+    serialOut.println("start_chg skipped: slave is null");
     return;
   }
-  Serial.printf("Execute 'start_chg for slave %u'\n", slave->id);
+  serialOut.printf("Execute 'start_chg for slave %u'\n", slave->id);
+  logEvent(master, "enjoin", slave->id);
+  if (slave->id == bayNode &&
+      bayState == session_stats::StationState::LOWERING_GEAR) {
+    markStation(bayNode, session_stats::StationState::CLOSED, millis());
+  }
   master->enjoinCharge(slave);
 }
 void end_chg(Master *master, SlaveData *slave) {
   if (slave == nullptr) {
-    Serial.println("end_chg skipped: slave is null");
+    serialOut.println("end_chg skipped: slave is null");
     return;
   }
-  Serial.printf("Execute 'end_chg for slave %u'\n", slave->id);
+  serialOut.printf("Execute 'end_chg for slave %u'\n", slave->id);
+  logEvent(master, "cancel", slave->id);
+  if (slave->id == bayNode) {
+    if (bayState != session_stats::StationState::OPEN) {
+      markStation(bayNode, session_stats::StationState::OPEN, millis());
+    }
+    bayNode = 0;
+    lowerForWaitingSlave();
+  }
   master->cancelCharge(slave);
 }
 
+void IRAM_ATTR onBridgeIrq() {
+  bridgeIrqAtUs.store(static_cast<uint32_t>(esp_timer_get_time()),
+                      std::memory_order_relaxed);
+  bridgeIrqAtMs.store(millis(), std::memory_order_relaxed);
+  bridgeIrqs.fetch_add(1, std::memory_order_release);
+  BaseType_t woken = pdFALSE;
+  if (loopTask != nullptr) {
+    vTaskNotifyGiveFromISR(loopTask, &woken);
+  }
+  portYIELD_FROM_ISR(woken);
+}
+
+// After master.step(): the motion the interrupt ended is the one the bay
+// was in. Logs `bridge_irq,<t_ms>,<wake_us>,<state>` with the time from the
+// edge to the step that read it and the state the bay moved to.
+void serviceBridgeIrq(uint32_t stepStartedUs) {
+  const uint32_t irqs = bridgeIrqs.load(std::memory_order_acquire);
+  const uint32_t irqAtUs = bridgeIrqAtUs.load(std::memory_order_relaxed);
+  // An edge during the step is for the next one, which comes at once.
+  if (irqs == bridgeIrqsSeen ||
+      static_cast<int32_t>(stepStartedUs - irqAtUs) < 0) {
+    return;
+  }
+  bridgeIrqsSeen = irqs;
+  const uint32_t atMs = bridgeIrqAtMs.load(std::memory_order_relaxed);
+  const uint32_t wakeUs = stepStartedUs - irqAtUs;
+  session_stats::StationState next = bayState;
+  if (bayNode != 0) {
+    if (bayState == session_stats::StationState::LOWERING_GEAR) {
+      next = session_stats::StationState::CLOSED;
+    } else if (bayState == session_stats::StationState::ATTACHING_GEAR) {
+      next = session_stats::StationState::SLAVE_CHARGE;
+    } else if (bayState == session_stats::StationState::LIFTING_GEAR) {
+      next = session_stats::StationState::OPEN;
+    }
+    if (next != bayState) {
+      markStation(bayNode, next, atMs);
+    }
+  }
+  serialOut.printf("bridge_irq,%lu,%lu,%s\n", static_cast<unsigned long>(atMs),
+                   static_cast<unsigned long>(wakeUs),
+                   session_stats::stationStateName(next));
+}
+
+Master *meshMaster = nullptr;
+// Typed mesh frames, routed by their tag; see common/mesh_proto.
+mesh_proto::Dispatcher meshMessages;
+
+// Clock requests and benchmark pings are answered right here on the mesh
+// task: time spent queued on the master would count as one-way delay.
+void onClockRequest(void *context, const mesh_proto::Envelope &envelope,
+                    mesh_proto::Reader &payload) {
+  (void)context;
+  clock_sync::ClockRequest request;
+  char message[mesh_proto::MESSAGE_CAPACITY];
+  if (meshMaster != nullptr && mesh_proto::readClockRequest(payload, request) &&
+      mesh_proto::encodeClockResponse(
+          request, envelope.receivedUs,
+          static_cast<uint64_t>(esp_timer_get_time()), message,
+          sizeof(message)) > 0) {
+    meshMaster->communication.sendMessage(message);
+  }
+}
+
+void onBeaconReport(void *context, const mesh_proto::Envelope &envelope,
+                    mesh_proto::Reader &payload) {
+  (void)context;
+  (void)envelope;
+  beacon_power::BeaconReport report;
+  if (beaconReports != nullptr &&
+      mesh_proto::readBeaconReport(payload, report)) {
+    xQueueSend(beaconReports, &report, 0);
+  }
+}
+
+// A heartbeat's beacon report joins the stand-alone reports.
+void onHeartbeat(void *context, const mesh_proto::Envelope &envelope,
+                 mesh_proto::Reader &payload) {
+  (void)context;
+  (void)envelope;
+  heartbeat::Status status;
+  if (heartbeatQueue == nullptr ||
+      !mesh_proto::readHeartbeat(payload, status)) {
+    return;
+  }
+  if ((status.flags & heartbeat::FLAG_REPORT) != 0) {
+    xQueueSend(beaconReports, &status.report, 0);
+  }
+  xQueueSend(heartbeatQueue, &status, 0);
+}
+
+void onNavBatch(void *context, const mesh_proto::Envelope &envelope,
+                mesh_proto::Reader &payload) {
+  (void)context;
+  (void)envelope;
+  mesh_proto::NavBatch batch;
+  if (navBatches == nullptr || !mesh_proto::readNavBatch(payload, batch)) {
+    return;
+  }
+  NavBatchCopy copy;
+  copy.node = batch.node;
+  copy.length = static_cast<uint8_t>(batch.length);
+  memcpy(copy.stream, batch.stream, batch.length);
+  if (xQueueSend(navBatches, &copy, 0) != pdTRUE) {
+    navBatchesDropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void onBroadcast(String &message) {
+  mesh_proto::Envelope envelope;
+  envelope.receivedUs = static_cast<uint64_t>(esp_timer_get_time());
+  bootTimeline.mark(boot_timing::Phase::MESH_READY, envelope.receivedUs);
+  if (meshMessages.dispatchText(envelope, message.c_str(), message.length()) !=
+      mesh_proto::DispatchStatus::NOT_A_FRAME) {
+    return;
+  }
+  char pong[mesh_bench::MESSAGE_CAPACITY];
+  if (meshMaster != nullptr &&
+      mesh_bench::answerPing(message.c_str(), envelope.receivedUs,
+                             static_cast<uint64_t>(esp_timer_get_time()), pong,
+                             sizeof(pong)) > 0) {
+    meshMaster->communication.sendMessage(pong);
+  }
+}
+
+void advertiseBeaconDuty(Master *master, uint32_t now) {
+  char message[mesh_proto::MESSAGE_CAPACITY];
+  if (mesh_proto::encodeBeaconDuty(beaconPower.duty(),
+                                   master->communication.getNodeId(), message,
+                                   sizeof(message)) > 0) {
+    master->communication.sendMessage(message);
+  }
+  lastBeaconAdvertAtMs = now;
+}
+
+void applyBeaconDuty(Master *master, uint32_t now) {
+  master->infraredLight.front.setDutyCycle(beaconPower.duty());
+  advertiseBeaconDuty(master, now);
+  serialOut.printf("beacon_duty,%u,%s,%lu\n",
+                   static_cast<unsigned>(beaconPower.duty()),
+                   beaconPower.following() ? "follow" : "idle",
+                   static_cast<unsigned long>(beaconPower.followedNode()));
+}
+
+void serviceBeaconPower(Master *master) {
+  const uint32_t now = millis();
+  bool changed = false;
+  beacon_power::BeaconReport report;
+  while (xQueueReceive(beaconReports, &report, 0) == pdTRUE) {
+    changed = beaconPower.onReport(report, now) || changed;
+  }
+  changed = beaconPower.service(now) || changed;
+  if (changed) {
+    applyBeaconDuty(master, now);
+  } else if (now - lastBeaconAdvertAtMs >= BEACON_ADVERTISE_PERIOD_MS) {
+    advertiseBeaconDuty(master, now);
+  }
+}
+
+// `cycle,<node>,<walk>,<wait>,<walk_into>,<charge>,<exiting>,<total>` in
+// ms, once per charging cycle, from leaving work to being back at it.
+void logCycle(const heartbeat::SlaveTable::Entry &entry) {
+  uint32_t totalMs = 0;
+  for (uint32_t ms : entry.cycleMs) {
+    totalMs += ms;
+  }
+  serialOut.printf(
+      "cycle,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+      static_cast<unsigned long>(entry.status.node),
+      static_cast<unsigned long>(entry.cycleMs[static_cast<size_t>(
+          heartbeat::SlaveState::WALKING_TO_CHARGE)]),
+      static_cast<unsigned long>(
+          entry.cycleMs[static_cast<size_t>(heartbeat::SlaveState::WAIT_CHARGE)]),
+      static_cast<unsigned long>(entry.cycleMs[static_cast<size_t>(
+          heartbeat::SlaveState::WALKING_INTO_CHARGE)]),
+      static_cast<unsigned long>(
+          entry.cycleMs[static_cast<size_t>(heartbeat::SlaveState::CHARGE)]),
+      static_cast<unsigned long>(entry.cycleMs[static_cast<size_t>(
+          heartbeat::SlaveState::EXITING_CHARGE)]),
+      static_cast<unsigned long>(totalMs));
+}
+
+void trackSession(const heartbeat::Status &status, uint8_t changes,
+                  uint32_t now) {
+  const uint32_t enteredMs = now - status.stateAgeMs;
+  if ((changes & heartbeat::CHANGE_STATE) != 0) {
+    sessionStats.onSlaveState(status.node, status.state, enteredMs,
+                              status.batteryMv);
+    if (status.state == heartbeat::SlaveState::CHARGE &&
+        status.node == bayNode) {
+      markStation(bayNode, session_stats::StationState::ATTACHING_GEAR,
+                  enteredMs);
+    } else if (status.state == heartbeat::SlaveState::WORK &&
+               status.node == bayNode) {
+      // Gave up on the bay; Master reopens it.
+      if (bayState != session_stats::StationState::OPEN) {
+        markStation(bayNode, session_stats::StationState::OPEN, enteredMs);
+      }
+      bayNode = 0;
+    }
+  }
+  if ((changes & heartbeat::CHANGE_REQUESTS) != 0 &&
+      (status.flags & heartbeat::FLAG_WANTS_STOP) != 0 &&
+      status.state == heartbeat::SlaveState::CHARGE && status.node == bayNode) {
+    markStation(bayNode, session_stats::StationState::LIFTING_GEAR, now);
+  }
+  lowerForWaitingSlave();
+}
+
+void serviceHeartbeats() {
+  const uint32_t now = millis();
+  heartbeat::Status status;
+  while (xQueueReceive(heartbeatQueue, &status, 0) == pdTRUE) {
+    const uint8_t changes = slaveTable.ingest(status, now);
+    if ((changes & heartbeat::CHANGE_RESTART) != 0) {
+      serialOut.printf("slave_restart,%lu,%lu\n",
+                       static_cast<unsigned long>(status.node),
+                       static_cast<unsigned long>(
+                           slaveTable.find(status.node)->restarts));
+    }
+    if ((changes & (heartbeat::CHANGE_STATE | heartbeat::CHANGE_REQUESTS)) !=
+        0) {
+      serialOut.printf("slave_state,%lu,%s,%lu,%u,%u\n",
+                       static_cast<unsigned long>(status.node),
+                       heartbeat::stateName(status.state),
+                       static_cast<unsigned long>(status.stateAgeMs),
+                       static_cast<unsigned>(status.batteryMv),
+                       static_cast<unsigned>(status.flags));
+    }
+    if ((changes & heartbeat::CHANGE_CYCLE) != 0) {
+      logCycle(*slaveTable.find(status.node));
+    }
+    // The slave's own estimate of when it asks to stop charging.
+    if ((status.flags & heartbeat::FLAG_CHARGE_ESTIMATE) != 0 &&
+        status.state == heartbeat::SlaveState::CHARGE) {
+      serialOut.printf("charge_eta,%lu,%u,%u,%u\n",
+                       static_cast<unsigned long>(status.node),
+                       static_cast<unsigned>(status.chargeRemainingS),
+                       static_cast<unsigned>(status.chargePercent),
+                       static_cast<unsigned>(status.batteryMv));
+    }
+    trackSession(status, changes, now);
+  }
+  if (now - lastFleetSummaryAtMs >= FLEET_SUMMARY_PERIOD_MS &&
+      slaveTable.count() > 0) {
+    uint32_t missed = 0;
+    for (uint8_t i = 0; i < slaveTable.count(); ++i) {
+      missed += slaveTable.at(i).missed;
+    }
+    serialOut.printf("fleet,%u,%u,%lu\n",
+                     static_cast<unsigned>(slaveTable.count()),
+                     static_cast<unsigned>(
+                         slaveTable.silent(now, HEARTBEAT_TIMEOUT_MS)),
+                     static_cast<unsigned long>(missed));
+    lastFleetSummaryAtMs = now;
+  }
+}
+
+bool serialRoomForRelay() {
+  return serialOut.ring().queued() + SERIAL_OUT_CONTROL_SLOTS <=
+         SERIAL_OUT_SLOTS;
+}
+
+// Runs last in loop(): whatever the relay does not get to stays queued, and
+// batches beyond the queue are dropped on the mesh task.
+void serviceNavRelay() {
+  const uint32_t now = millis();
+  NavBatchCopy copy;
+  char line[SERIAL_OUT_SLOT_SIZE];
+  while (xQueueReceive(navBatches, &copy, 0) == pdTRUE) {
+    if (navRelay.onBatch(copy.node, copy.stream, copy.length, now) &&
+        serialRoomForRelay() &&
+        nav_relay::formatRaw(copy.node, copy.stream, copy.length, line,
+                             sizeof(line)) > 0) {
+      serialOut.print(line);
+    }
+  }
+  nav_relay::WindowSummary summary;
+  while (serialRoomForRelay() && navRelay.poll(now, summary)) {
+    if (nav_relay::formatSummary(summary, line, sizeof(line)) > 0) {
+      serialOut.print(line);
+    }
+  }
+  if (now - lastNavRelayStatsAtMs >= NAV_RELAY_STATS_PERIOD_MS &&
+      navRelay.batches() > 0) {
+    serialOut.printf("nav_relay,%lu,%lu,%lu,%lu,%lu,%lu\n",
+                     static_cast<unsigned long>(navRelay.batches()),
+                     static_cast<unsigned long>(navRelay.relayed()),
+                     static_cast<unsigned long>(navRelay.refused()),
+                     static_cast<unsigned long>(navRelay.untracked()),
+                     static_cast<unsigned long>(navRelay.malformed()),
+                     static_cast<unsigned long>(navBatchesDropped.load(
+                         std::memory_order_relaxed)));
+    lastNavRelayStatsAtMs = now;
+  }
+}
+
+void serviceStatsQuery() {
+  char line[SERIAL_OUT_SLOT_SIZE];
+  if (statsSummaryPending && serialRoomForRelay()) {
+    statsSummaryPending = false;
+    if (session_stats::formatSummary(sessionStats.summary(millis()), line,
+                                     sizeof(line)) > 0) {
+      serialOut.print(line);
+    }
+  }
+  while (statsPhaseCursor < session_stats::PHASE_COUNT &&
+         serialRoomForRelay()) {
+    const session_stats::Phase phase =
+        static_cast<session_stats::Phase>(statsPhaseCursor++);
+    if (session_stats::formatPhase(phase, sessionStats.phase(phase), line,
+                                   sizeof(line)) > 0) {
+      serialOut.print(line);
+    }
+  }
+  while (statsRecordsLeft > 0 && serialRoomForRelay()) {
+    statsRecordsLeft--;
+    if (statsRecordCursor < sessionStats.recordCount() &&
+        session_stats::formatRecord(sessionStats.record(statsRecordCursor++),
+                                    line, sizeof(line)) > 0) {
+      serialOut.print(line);
+    }
+  }
+}
+
+void printBootTimeline() {
+  const char *reason =
+      boot_timing::resetReasonName(static_cast<uint8_t>(esp_reset_reason()));
+  char line[boot_timing::LINE_CAPACITY];
+  if (meshMaster != nullptr &&
+      bootTimeline.format(meshMaster->communication.getNodeId(), reason, line,
+                          sizeof(line)) > 0) {
+    serialOut.print(line);
+  }
+}
+
+void serviceBoot() {
+  const uint64_t now = static_cast<uint64_t>(esp_timer_get_time());
+  if (!firstTickDone) {
+    firstTickDone = true;
+    bootTimeline.mark(boot_timing::Phase::FIRST_TICK, now);
+  }
+  if (bootTimeline.due(now, BOOT_REPORT_TIMEOUT_MS)) {
+    printBootTimeline();
+  }
+}
+
+void handleCommand(const char *command) {
+  if (strcmp(command, "boot") == 0) {
+    printBootTimeline();
+  } else if (strcmp(command, "stats") == 0) {
+    statsSummaryPending = true;
+    statsPhaseCursor = 0;
+  } else if (strcmp(command, "stats reset") == 0) {
+    sessionStats.reset(millis());
+    serialOut.println("stats: reset");
+  } else if (strncmp(command, "stats last", 10) == 0) {
+    unsigned long count = STATS_LAST_DEFAULT;
+    if (command[10] != '\0') {
+      char *end = nullptr;
+      count = strtoul(command + 10, &end, 10);
+      if (command[10] != ' ' || end == command + 10 || *end != '\0' ||
+          count == 0) {
+        serialOut.printf("Usage: stats [last [n]|reset]\n");
+        return;
+      }
+    }
+    statsRecordCursor = 0;
+    statsRecordsLeft = static_cast<uint8_t>(
+        count < session_stats::SessionStats::RING_CAPACITY
+            ? count
+            : session_stats::SessionStats::RING_CAPACITY);
+  } else if (strcmp(command, "relay off") == 0) {
+    navRelay.setPassthrough(0);
+    serialOut.println("nav_relay: passthrough off");
+  } else if (strncmp(command, "relay ", 6) == 0) {
+    char *end = nullptr;
+    const unsigned long node = strtoul(command + 6, &end, 10);
+    if (end == command + 6 || *end != '\0' || node == 0) {
+      serialOut.printf("Usage: relay <node>|off\n");
+      return;
+    }
+    navRelay.setPassthrough(static_cast<uint32_t>(node));
+    serialOut.printf("nav_relay: passthrough %lu\n", node);
+  } else {
+    serialOut.printf("Unknown command: %s\n", command);
+  }
+}
+
+void pollCommands() {
+  while (Serial.available() > 0) {
+    const char ch = static_cast<char>(Serial.read());
+    if (ch == '\r') {
+      continue;
+    }
+    if (ch != '\n') {
+      if (commandLength < COMMAND_LINE_SIZE - 1) {
+        commandLine[commandLength++] = ch;
+      }
+      continue;
+    }
+    commandLine[commandLength] = '\0';
+    if (commandLength > 0) {
+      handleCommand(commandLine);
+    }
+    commandLength = 0;
+  }
+}
+
 auto chargingSlaves = Fifo<SlaveData *>();
 
 Master master = Master(chargingSlaves, start_chg, end_chg);
 
 void setup() {
-  // put your setup code here, to run once:
-  delay(2000);
+  // No wait for a USB host: boot lines queue in serialOut until one reads
+  // them.
   Serial.begin(115200);
-  Serial.println("+-------------------------+");
-  Serial.println("| Charging Station Master |");
-  Serial.println("+-------------------------+");
-  Serial.println();
+  serialOut.begin(Serial);
+  bootTimeline.mark(boot_timing::Phase::SERIAL_READY,
+                    static_cast<uint64_t>(esp_timer_get_time()));
+  serialOut.println("+-------------------------+");
+  serialOut.println("| Charging Station Master |");
+  serialOut.println("+-------------------------+");
+  // Ready before the mesh is, so nothing that arrives early is lost.
+  beaconReports = xQueueCreate(BEACON_REPORT_QUEUE_LENGTH,
+                               sizeof(beacon_power::BeaconReport));
+  heartbeatQueue =
+      xQueueCreate(HEARTBEAT_QUEUE_LENGTH, sizeof(heartbeat::Status));
+  navBatches = xQueueCreate(NAV_BATCH_QUEUE_LENGTH, sizeof(NavBatchCopy));
+  meshMessages.on(mesh_proto::Type::CLOCK_REQUEST, onClockRequest);
+  meshMessages.on(mesh_proto::Type::BEACON_REPORT, onBeaconReport);
+  meshMessages.on(mesh_proto::Type::HEARTBEAT, onHeartbeat);
+  meshMessages.on(mesh_proto::Type::NAV_BATCH, onNavBatch);
+
+  loopTask = xTaskGetCurrentTaskHandle();
+  pinMode(BRIDGE_IRQ_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(BRIDGE_IRQ_PIN), onBridgeIrq, FALLING);
+
   master.begin();
-  Serial.printf("NodeID '%u'\n", master.communication.getNodeId());
+  bootTimeline.mark(boot_timing::Phase::BEGIN_DONE,
+                    static_cast<uint64_t>(esp_timer_get_time()));
+  meshMaster = &master;
+  master.communication.onReceive(onBroadcast);
+  serialOut.printf("NodeID '%u'\n", master.communication.getNodeId());
   master.infraredLight.front.sendFrequency(BEACON_CARRIER_HZ);
-  master.infraredLight.front.setDutyCycle(BEACON_DUTY);
-  Serial.printf("Beacon config: front=%u Hz duty=%u/1023\n", BEACON_CARRIER_HZ,
-                BEACON_DUTY);
-  Serial.println(
+  master.infraredLight.front.setDutyCycle(beaconPower.duty());
+  serialOut.printf("Beacon config: front=%u Hz duty=%u/1023\n",
+                   BEACON_CARRIER_HZ, beaconPower.duty());
+  serialOut.println(
       "wireless_log,from,t_ms,mode,raw_f,raw_b,raw_l,raw_r,A_F,A_B,A_L,A_R,"
       "theta_deg,S,detected,duty_l,duty_r");
+  serialOut.println(
+      "nav_win,from,t0_ms,t1_ms,frames,lost,detected,search,S_min,S_mean,"
+      "S_max,theta_min,theta_mean,theta_max,duty_l_min,duty_l_mean,"
+      "duty_l_max,duty_r_min,duty_r_mean,duty_r_max,refused");
+  bootTimeline.mark(boot_timing::Phase::SETUP_DONE,
+                    static_cast<uint64_t>(esp_timer_get_time()));
 }
 
 void loop() {
+  const uint32_t stepStartedUs = static_cast<uint32_t>(esp_timer_get_time());
   master.step();
-  delay(5);
+  serviceBridgeIrq(stepStartedUs);
+  serviceBoot();
+  serviceHeartbeats();
+  serviceBeaconPower(&master);
+  pollCommands();
+  serviceStatsQuery();
+  serviceNavRelay();
+  // delay() that the bridge interrupt cuts short.
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOOP_PERIOD_MS));
 }
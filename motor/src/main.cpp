@@ -2,6 +2,7 @@
 #include <Arduino.h>
 #include <MultiStepper.h>
 #include <Wire.h>
+#include <bridge_link.h>
 
 static const uint8_t LEFT_PIN1 = 14;
 static const uint8_t LEFT_PIN2 = 27;
@@ -21,6 +22,13 @@ static const uint8_t I2C_SLAVE_ADDRESS = 0x12;
 static const int I2C_SDA_PIN = 21;
 static const int I2C_SCL_PIN = 22;
 static const uint32_t I2C_FREQUENCY_HZ = 100000;
+// Open-drain status interrupt to the master, low while a finished or
+// failed motion waits to be read (common/bridge_link).
+static const uint8_t BRIDGE_IRQ_PIN = 18;
+// A motion is stopped and reported as a fault after twice its time at the
+// current speed plus this slack, or after the cap, whichever is shorter.
+static const uint32_t MOTION_SLACK_MS = 2000;
+static const uint32_t MOTION_LIMIT_CAP_MS = 60000;
 
 static const long BRIDGE_RAISED_STEPS = 3500;
 static const long BRIDGE_LOWERED_WALK_IN_STEPS = 2300;
@@ -56,8 +64,11 @@ AccelStepper stepperRight(AccelStepper::FULL4WIRE, RIGHT_PIN1, RIGHT_PIN2,
 MultiStepper stepperMgr;
 
 static String rx_line;
-static String bridge_status = "IDLE";
+static bridge_link::StatusNotifier bridge_status;
+static bool bridge_irq_low = false;
 static BridgeMotion bridge_motion = BridgeMotion::IDLE;
+static uint32_t bridge_motion_started_ms = 0;
+static uint32_t bridge_motion_limit_ms = 0;
 
 static void append_rx_char(char ch) {
   if (ch == '\r') {
@@ -79,7 +90,29 @@ static void i2c_receive(int bytes_available) {
   }
 }
 
-static void i2c_request() { Wire.print(bridge_status); }
+// Runs on the I2C task: the read releases the interrupt line.
+static void i2c_request() {
+  Wire.print(bridge_link::statusText(bridge_status.status()));
+  bridge_status.acknowledge();
+}
+
+static void update_irq_line() {
+  const bool low = bridge_status.asserted();
+  if (low != bridge_irq_low) {
+    digitalWrite(BRIDGE_IRQ_PIN, low ? LOW : HIGH);
+    bridge_irq_low = low;
+  }
+}
+
+static uint32_t motion_limit_ms(long steps) {
+  const float speed = max_speed_steps_per_sec(max_rpm);
+  const float distance = static_cast<float>(steps < 0 ? -steps : steps);
+  if (speed <= 0.0f ||
+      2000.0f * distance / speed + MOTION_SLACK_MS >= MOTION_LIMIT_CAP_MS) {
+    return MOTION_LIMIT_CAP_MS;
+  }
+  return static_cast<uint32_t>(2000.0f * distance / speed) + MOTION_SLACK_MS;
+}
 
 static void init_i2c_slave() {
   pinMode(I2C_SDA_PIN, INPUT_PULLUP);
@@ -113,24 +146,45 @@ static void start_bridge_motion(BridgeMotion motion) {
   if (motion == BridgeMotion::LOWERING_TO_WALK_IN) {
     position[0] = BRIDGE_LOWERED_WALK_IN_STEPS;
     position[1] = BRIDGE_LOWERED_WALK_IN_STEPS;
-    bridge_status = "BUSY:LOWER_WALK_IN";
+    bridge_status.set(bridge_link::Status::BUSY_LOWER_WALK_IN);
     Serial.println("Bridge lowering to walk-in started");
   } else if (motion == BridgeMotion::LOWERING_TO_CHARGE) {
     position[0] = BRIDGE_LOWERED_CHARGE_STEPS;
     position[1] = BRIDGE_LOWERED_CHARGE_STEPS;
-    bridge_status = "BUSY:LOWER_CHARGE";
+    bridge_status.set(bridge_link::Status::BUSY_LOWER_CHARGE);
     Serial.println("Bridge lowering to charge started");
   } else {
     position[0] = BRIDGE_RAISED_STEPS;
     position[1] = BRIDGE_RAISED_STEPS;
-    bridge_status = "BUSY:RAISE";
+    bridge_status.set(bridge_link::Status::BUSY_RAISE);
     Serial.println("Bridge raising started");
   }
 
   bridge_motion = motion;
+  bridge_motion_started_ms = millis();
+  bridge_motion_limit_ms =
+      motion_limit_ms(position[0] - stepperLeft.currentPosition());
   stepperMgr.moveTo(position);
 }
 
+// Stops where the steppers are; the next motion starts from there.
+static void fail_bridge_motion() {
+  long here[STEPPER_AMOUNT] = {stepperLeft.currentPosition(),
+                               stepperRight.currentPosition()};
+  stepperMgr.moveTo(here);
+  if (bridge_motion == BridgeMotion::LOWERING_TO_WALK_IN) {
+    bridge_status.set(bridge_link::Status::FAULT_LOWER_WALK_IN);
+  } else if (bridge_motion == BridgeMotion::LOWERING_TO_CHARGE) {
+    bridge_status.set(bridge_link::Status::FAULT_LOWER_CHARGE);
+  } else {
+    bridge_status.set(bridge_link::Status::FAULT_RAISE);
+  }
+  Serial.printf("Bridge motion timed out after %lu ms at (%ld,%ld)\n",
+                static_cast<unsigned long>(millis() - bridge_motion_started_ms),
+                here[0], here[1]);
+  bridge_motion = BridgeMotion::IDLE;
+}
+
 static void process_command(const String &command_in) {
   String command = command_in;
   command.trim();
@@ -175,17 +229,20 @@ static void update_bridge_motion() {
   }
 
   if (stepperMgr.run()) {
+    if (millis() - bridge_motion_started_ms >= bridge_motion_limit_ms) {
+      fail_bridge_motion();
+    }
     return;
   }
 
   if (bridge_motion == BridgeMotion::LOWERING_TO_WALK_IN) {
-    bridge_status = "DONE:LOWER_WALK_IN";
+    bridge_status.set(bridge_link::Status::DONE_LOWER_WALK_IN);
     Serial.println("Bridge lowering to walk-in finished");
   } else if (bridge_motion == BridgeMotion::LOWERING_TO_CHARGE) {
-    bridge_status = "DONE:LOWER_CHARGE";
+    bridge_status.set(bridge_link::Status::DONE_LOWER_CHARGE);
     Serial.println("Bridge lowering to charge finished");
   } else {
-    bridge_status = "DONE:RAISE";
+    bridge_status.set(bridge_link::Status::DONE_RAISE);
     Serial.println("Bridge raising finished");
   }
   bridge_motion = BridgeMotion::IDLE;
@@ -215,13 +272,18 @@ static void home_bridge_to_walk_in_on_boot() {
 
   position[0] = BRIDGE_LOWERED_WALK_IN_STEPS;
   position[1] = BRIDGE_LOWERED_WALK_IN_STEPS;
-  bridge_status = "IDLE";
+  // Homing is not the master's to hear about: the line stayed released,
+  // and IDLE keeps it so.
+  bridge_status.set(bridge_link::Status::IDLE);
 
   Serial.println("Startup homing complete: bridge at walk-in position");
 }
 
 void setup() {
   Serial.begin(115200);
+  // Released until there is something to read.
+  pinMode(BRIDGE_IRQ_PIN, OUTPUT_OPEN_DRAIN);
+  digitalWrite(BRIDGE_IRQ_PIN, HIGH);
 
   Serial.println("+------------------+");
   Serial.println("| Motor Controller |");
@@ -257,4 +319,5 @@ void loop() {
   }
 
   update_bridge_motion();
+  update_irq_line();
 }
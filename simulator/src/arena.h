@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cmath>
+
+constexpr float kPi = 3.14159265358979323846f;
+constexpr float kTwoPi = 2.0f * kPi;
+
+struct Pose {
+  float x = 0.0f;
+  float y = 0.0f;
+  float heading = 0.0f;
+};
+
+// Rectangular mat with the charging-station beacon mounted on the x = 0 wall,
+// shining into the arena along +x. Units are metres and radians.
+struct ArenaConfig {
+  float widthM = 1.20f;
+  float depthM = 0.60f;
+  float beaconX = 0.0f;
+  float beaconY = 0.30f;
+  float beaconHeading = 0.0f;
+  float robotRadiusM = 0.035f;
+  float arrivalRadiusM = 0.12f;
+  float minStartDistanceM = 0.35f;
+};
+
+inline float wrapAngle(float angle) {
+  while (angle > kPi) {
+    angle -= kTwoPi;
+  }
+  while (angle < -kPi) {
+    angle += kTwoPi;
+  }
+  return angle;
+}
+
+inline float distanceToBeacon(const ArenaConfig &arena, const Pose &pose) {
+  return std::hypot(pose.x - arena.beaconX, pose.y - arena.beaconY);
+}
@@ -0,0 +1,94 @@
+#include "battery_model.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double CHARGE_STEP_S = 0.05;
+
+struct OcvPoint {
+  float soc;
+  float mv;
+};
+
+const OcvPoint OCV_CURVE[] = {
+    {0.00f, 3300.0f}, {0.05f, 3500.0f}, {0.10f, 3600.0f},
+    {0.20f, 3700.0f}, {0.40f, 3780.0f}, {0.60f, 3870.0f},
+    {0.80f, 4000.0f}, {0.90f, 4080.0f}, {1.00f, 4200.0f},
+};
+
+float ocvAt(float soc) {
+  const size_t count = sizeof(OCV_CURVE) / sizeof(OCV_CURVE[0]);
+  if (soc <= OCV_CURVE[0].soc) {
+    return OCV_CURVE[0].mv;
+  }
+  for (size_t i = 1; i < count; ++i) {
+    if (soc <= OCV_CURVE[i].soc) {
+      const OcvPoint &a = OCV_CURVE[i - 1];
+      const OcvPoint &b = OCV_CURVE[i];
+      return a.mv + (b.mv - a.mv) * (soc - a.soc) / (b.soc - a.soc);
+    }
+  }
+  return OCV_CURVE[count - 1].mv;
+}
+} // namespace
+
+BatteryModel::BatteryModel(const BatteryModelConfig &config, float soc)
+    : config_(config),
+      chargeAs_(static_cast<double>(std::min(std::max(soc, 0.0f), 1.0f)) *
+                config.capacityAs) {}
+
+double BatteryModel::drain(double seconds, float currentA) {
+  currentA_ = 0.0f;
+  if (seconds <= 0.0 || currentA <= 0.0f) {
+    return 0.0;
+  }
+  const double used = seconds * currentA;
+  if (used <= chargeAs_) {
+    chargeAs_ -= used;
+    return 0.0;
+  }
+  const double flatS = (used - chargeAs_) / currentA;
+  chargeAs_ = 0.0;
+  return flatS;
+}
+
+void BatteryModel::charge(double seconds) {
+  const float ohm = config_.internalOhm;
+  for (double done = 0.0; done < seconds; done += CHARGE_STEP_S) {
+    const double step = std::min(CHARGE_STEP_S, seconds - done);
+    const float ocvV = ocvAt(soc()) / 1000.0f;
+    const float cvV = config_.cvMv / 1000.0f;
+    float current = config_.chargeCurrentA;
+    if (ocvV + current * ohm > cvV) {
+      current = std::max(0.0f, (cvV - ocvV) / ohm);
+    }
+    if (terminated_ || current < config_.terminationA) {
+      terminated_ = true;
+      current = 0.0f;
+    }
+    currentA_ = current;
+    chargeAs_ = std::min<double>(chargeAs_ + current * step,
+                                 config_.capacityAs);
+  }
+}
+
+void BatteryModel::detach() {
+  currentA_ = 0.0f;
+  terminated_ = false;
+}
+
+float BatteryModel::soc() const {
+  return static_cast<float>(chargeAs_ / config_.capacityAs);
+}
+
+uint16_t BatteryModel::openCircuitMv() const {
+  return static_cast<uint16_t>(std::lround(ocvAt(soc())));
+}
+
+uint16_t BatteryModel::senseMv(std::mt19937_64 &rng) const {
+  std::normal_distribution<float> noise(0.0f, config_.senseNoiseMv);
+  const float mv =
+      ocvAt(soc()) + currentA_ * config_.internalOhm * 1000.0f + noise(rng);
+  return static_cast<uint16_t>(std::lround(std::max(mv, 0.0f)));
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+// Li-ion cell on a CC/CV charger, at the fleet simulator's time scale: a
+// full charge takes about a minute instead of hours, like the 15 s charge
+// of the firmware's charging cycle. The open-circuit voltage follows a
+// typical LiCoO2 curve; on the charger the cell reads its open-circuit
+// voltage plus the charge current across its internal resistance, until
+// the charger holds cvMv and the current tapers off to terminationA.
+struct BatteryModelConfig {
+  float capacityAs = 40.0f;
+  float chargeCurrentA = 1.0f;
+  uint16_t cvMv = 4200;
+  float internalOhm = 0.15f;
+  float terminationA = 0.1f;
+  // Sense noise per sample, after the slave averages its ADC reads.
+  float senseNoiseMv = 3.0f;
+  // Drawn from the battery by the robot, per activity.
+  float workA = 0.06f;
+  float walkA = 0.1f;
+  float idleA = 0.02f;
+};
+
+class BatteryModel {
+public:
+  explicit BatteryModel(const BatteryModelConfig &config =
+                            BatteryModelConfig(),
+                        float soc = 1.0f);
+
+  // Runs the robot off the battery for `seconds` at `currentA`; returns
+  // the part of it the battery was flat.
+  double drain(double seconds, float currentA);
+  // On the charger for `seconds`.
+  void charge(double seconds);
+  // Off the charger again; the next charge starts in constant current.
+  void detach();
+
+  // State of charge, 0..1.
+  float soc() const;
+  uint16_t openCircuitMv() const;
+  // What the slave's sense input reads: the terminal voltage, on the
+  // charger while it is attached.
+  uint16_t senseMv(std::mt19937_64 &rng) const;
+  float chargeCurrentA() const { return currentA_; }
+
+private:
+  BatteryModelConfig config_;
+  double chargeAs_;
+  float currentA_ = 0.0f;
+  bool terminated_ = false;
+};
@@ -0,0 +1,124 @@
+#include "beacon_recording.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+enum Column : uint8_t {
+  COL_T_MS,
+  COL_RAW_F,
+  COL_RAW_B,
+  COL_RAW_L,
+  COL_RAW_R,
+  COL_A_F,
+  COL_A_B,
+  COL_A_L,
+  COL_A_R,
+  COL_THETA_DEG,
+  COL_S,
+  COL_DETECTED,
+  COL_COUNT
+};
+
+const char *const kColumnNames[COL_COUNT] = {
+    "t_ms", "raw_f", "raw_b", "raw_l",     "raw_r", "A_F",
+    "A_B",  "A_L",   "A_R",   "theta_deg", "S",     "detected"};
+
+std::vector<std::string> splitCsv(const std::string &line) {
+  std::vector<std::string> fields;
+  std::stringstream stream(line);
+  std::string field;
+  while (std::getline(stream, field, ',')) {
+    if (!field.empty() && field.back() == '\r') {
+      field.pop_back();
+    }
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+bool parseNumber(const std::string &text, double &value) {
+  if (text.empty()) {
+    return false;
+  }
+  char *end = nullptr;
+  value = std::strtod(text.c_str(), &end);
+  return end != nullptr && *end == '\0';
+}
+} // namespace
+
+bool loadBeaconRecording(const std::string &path,
+                         std::vector<BeaconSample> &samples,
+                         std::string *error) {
+  std::ifstream input(path);
+  if (!input) {
+    if (error != nullptr) {
+      *error = "cannot open " + path;
+    }
+    return false;
+  }
+
+  std::string line;
+  int index[COL_COUNT];
+  for (int &i : index) {
+    i = -1;
+  }
+  size_t headerWidth = 0;
+  while (std::getline(input, line)) {
+    const std::vector<std::string> header = splitCsv(line);
+    for (size_t i = 0; i < header.size(); ++i) {
+      for (uint8_t c = 0; c < COL_COUNT; ++c) {
+        if (header[i] == kColumnNames[c]) {
+          index[c] = static_cast<int>(i);
+        }
+      }
+    }
+    if (index[COL_T_MS] >= 0) {
+      headerWidth = header.size();
+      break;
+    }
+  }
+
+  for (uint8_t c = COL_T_MS; c <= COL_RAW_R; ++c) {
+    if (index[c] < 0) {
+      if (error != nullptr) {
+        *error = path + ": missing column " + kColumnNames[c];
+      }
+      return false;
+    }
+  }
+
+  while (std::getline(input, line)) {
+    const std::vector<std::string> fields = splitCsv(line);
+    if (fields.size() != headerWidth) {
+      continue;
+    }
+
+    double values[COL_COUNT] = {};
+    bool valid = true;
+    for (uint8_t c = 0; c < COL_COUNT && valid; ++c) {
+      if (index[c] >= 0) {
+        valid = parseNumber(fields[static_cast<size_t>(index[c])], values[c]);
+      }
+    }
+    if (!valid) {
+      continue;
+    }
+
+    BeaconSample sample;
+    sample.tMs = static_cast<uint32_t>(values[COL_T_MS]);
+    for (uint8_t ch = 0; ch < 4; ++ch) {
+      sample.raw[ch] = static_cast<uint32_t>(values[COL_RAW_F + ch]);
+      sample.amplitude[ch] = index[COL_A_F + ch] >= 0
+                                 ? static_cast<float>(values[COL_A_F + ch])
+                                 : static_cast<float>(sample.raw[ch]);
+    }
+    sample.thetaDeg = static_cast<float>(values[COL_THETA_DEG]);
+    sample.signal = static_cast<float>(values[COL_S]);
+    sample.detected = values[COL_DETECTED] != 0.0;
+    samples.push_back(sample);
+  }
+
+  return true;
+}
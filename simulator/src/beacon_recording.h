@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One row of an ir_meter / beacon_nav recording (evaluation/data/*.csv).
+struct BeaconSample {
+  uint32_t tMs = 0;
+  uint32_t raw[4] = {0, 0, 0, 0}; // front, back, left, right
+  float amplitude[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  float thetaDeg = 0.0f;
+  float signal = 0.0f;
+  bool detected = false;
+};
+
+// Loads a recording by column name. Rows with a missing or truncated field
+// are skipped, which happens when a capture is cut off mid-line.
+bool loadBeaconRecording(const std::string &path,
+                         std::vector<BeaconSample> &samples,
+                         std::string *error = nullptr);
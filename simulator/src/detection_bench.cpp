@@ -0,0 +1,168 @@
+#include "detection_bench.h"
+
+#include "ir_sensor_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+constexpr uint32_t TICK_MS = 20;
+constexpr float WANDER_SPEED_MPS = 0.10f;
+constexpr float WANDER_TURN_RATE_RADPS = 2.0f;
+constexpr float WAYPOINT_REACHED_M = 0.03f;
+constexpr float AMBIENT_SCALE_MIN = 0.5f;
+constexpr float AMBIENT_SCALE_MAX = 2.5f;
+
+float rate(uint64_t count, uint64_t total) {
+  return total == 0 ? 0.0f
+                    : static_cast<float>(count) / static_cast<float>(total);
+}
+
+Pose randomPose(const ArenaConfig &arena, std::mt19937 &rng) {
+  const float margin = arena.robotRadiusM;
+  std::uniform_real_distribution<float> x(margin, arena.widthM - margin);
+  std::uniform_real_distribution<float> y(margin, arena.depthM - margin);
+  std::uniform_real_distribution<float> heading(-kPi, kPi);
+  Pose pose;
+  pose.x = x(rng);
+  pose.y = y(rng);
+  pose.heading = heading(rng);
+  return pose;
+}
+
+// Turns toward the waypoint, then drives; a new waypoint is drawn on arrival.
+void wander(Pose &pose, Pose &waypoint, const ArenaConfig &arena,
+            std::mt19937 &rng) {
+  const float dt = static_cast<float>(TICK_MS) * 0.001f;
+  const float dx = waypoint.x - pose.x;
+  const float dy = waypoint.y - pose.y;
+  if (std::hypot(dx, dy) < WAYPOINT_REACHED_M) {
+    waypoint = randomPose(arena, rng);
+    return;
+  }
+  const float error = wrapAngle(std::atan2(dy, dx) - pose.heading);
+  const float maxTurn = WANDER_TURN_RATE_RADPS * dt;
+  pose.heading =
+      wrapAngle(pose.heading + std::max(-maxTurn, std::min(maxTurn, error)));
+  if (std::fabs(error) < 0.5f) {
+    pose.x += WANDER_SPEED_MPS * dt * std::cos(pose.heading);
+    pose.y += WANDER_SPEED_MPS * dt * std::sin(pose.heading);
+  }
+}
+
+void score(bool truthKnown, bool beaconVisible, bool strong, bool detected,
+           DetectionScore &result) {
+  if (!truthKnown) {
+    result.unscored++;
+  } else if (beaconVisible) {
+    result.positives++;
+    result.falseNegatives += detected ? 0 : 1;
+    result.strongPositives += strong ? 1 : 0;
+    result.strongFalseNegatives += strong && !detected ? 1 : 0;
+  } else {
+    result.negatives++;
+    result.falsePositives += detected ? 1 : 0;
+  }
+}
+} // namespace
+
+float DetectionScore::falseNegativeRate() const {
+  return rate(falseNegatives, positives);
+}
+
+float DetectionScore::falsePositiveRate() const {
+  return rate(falsePositives, negatives);
+}
+
+float DetectionScore::strongFalseNegativeRate() const {
+  return rate(strongFalseNegatives, strongPositives);
+}
+
+DetectionScore scoreDetectionScenarios(const SimulationConfig &config,
+                                       const BeaconTrackerConfig &tracker,
+                                       uint32_t trials, float durationS,
+                                       uint64_t seed) {
+  DetectionScore result;
+  const uint32_t durationMs = static_cast<uint32_t>(durationS * 1000.0f);
+  for (uint32_t trial = 0; trial < trials; ++trial) {
+    std::seed_seq seq{static_cast<uint32_t>(seed),
+                      static_cast<uint32_t>(seed >> 32), trial};
+    std::mt19937 rng(seq);
+    std::uniform_int_distribution<uint32_t> beaconPeriodMs(5000, 20000);
+    std::uniform_int_distribution<uint32_t> lightPeriodMs(15000, 40000);
+    std::uniform_real_distribution<float> lightLevel(AMBIENT_SCALE_MIN,
+                                                     AMBIENT_SCALE_MAX);
+    std::bernoulli_distribution coin(0.5);
+
+    IrSensorModel sensor(config.sensor, config.arena, rng);
+    BeaconTracker detector(tracker);
+    Pose pose = randomPose(config.arena, rng);
+    Pose waypoint = randomPose(config.arena, rng);
+
+    bool beaconOn = coin(rng);
+    uint32_t beaconToggleAtMs = beaconPeriodMs(rng);
+    float light = lightLevel(rng);
+    float lightFrom = light;
+    float lightTo = light;
+    uint32_t lightChangeAtMs = lightPeriodMs(rng);
+    uint32_t rampStartMs = 0;
+    uint32_t rampMs = 0;
+
+    for (uint32_t nowMs = 0; nowMs < durationMs; nowMs += TICK_MS) {
+      if (nowMs >= beaconToggleAtMs) {
+        beaconOn = !beaconOn;
+        beaconToggleAtMs = nowMs + beaconPeriodMs(rng);
+      }
+      if (nowMs >= lightChangeAtMs) {
+        // Half the changes are a light switch, half drift over a minute.
+        lightFrom = light;
+        lightTo = lightLevel(rng);
+        rampStartMs = nowMs;
+        rampMs = coin(rng) ? 0 : 60000;
+        lightChangeAtMs = nowMs + lightPeriodMs(rng);
+      }
+      light = rampMs == 0 || nowMs - rampStartMs >= rampMs
+                  ? lightTo
+                  : lightFrom + (lightTo - lightFrom) *
+                                    static_cast<float>(nowMs - rampStartMs) /
+                                    static_cast<float>(rampMs);
+
+      wander(pose, waypoint, config.arena, rng);
+      sensor.setBeaconDuty(beaconOn ? config.sensor.beaconDuty : 0.0f);
+      sensor.setAmbientScale(light);
+      const IrReading reading = sensor.sample(pose);
+
+      float beaconCounts = 0.0f;
+      for (uint8_t channel = 0; channel < IR_CHANNEL_COUNT; ++channel) {
+        beaconCounts += sensor.expected(pose, static_cast<IrChannel>(channel));
+      }
+      const BeaconTrackerState &state = detector.update(
+          reading.raw[IR_CH_FRONT], reading.raw[IR_CH_BACK],
+          reading.raw[IR_CH_LEFT], reading.raw[IR_CH_RIGHT], nowMs);
+      const bool visible = beaconCounts >= DETECTION_VISIBLE_COUNTS;
+      score(!beaconOn || visible, beaconOn,
+            beaconCounts >= DETECTION_STRONG_COUNTS, state.detected, result);
+    }
+  }
+  return result;
+}
+
+DetectionScore scoreDetectionRecording(const std::vector<BeaconSample> &samples,
+                                       const BeaconTrackerConfig &tracker) {
+  DetectionScore result;
+  BeaconTracker detector(tracker);
+  uint32_t previousMs = 0;
+  for (const BeaconSample &sample : samples) {
+    // Recordings are concatenated; start over where the clock jumps back.
+    if (sample.tMs < previousMs) {
+      detector = BeaconTracker(tracker);
+    }
+    previousMs = sample.tMs;
+    const BeaconTrackerState &state =
+        detector.update(sample.raw[0], sample.raw[1], sample.raw[2],
+                        sample.raw[3], sample.tMs);
+    score(true, true, true, state.detected, result);
+  }
+  return result;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "beacon_recording.h"
+#include "monte_carlo.h"
+
+#include <beacon_tracker.h>
+#include <cstdint>
+#include <vector>
+
+// Detection error rates of one tracker configuration. A tick is a positive
+// while the beacon is on and delivers at least DETECTION_VISIBLE_COUNTS over
+// the ambient light (about 5 noise sigmas of totalSignal), a negative while
+// it is off; ticks with the beacon on but weaker than that are not scored.
+// Positives of at least DETECTION_STRONG_COUNTS are also counted apart.
+struct DetectionScore {
+  uint64_t positives = 0;
+  uint64_t negatives = 0;
+  uint64_t falseNegatives = 0;
+  uint64_t falsePositives = 0;
+  uint64_t unscored = 0;
+  uint64_t strongPositives = 0;
+  uint64_t strongFalseNegatives = 0;
+
+  float falseNegativeRate() const;
+  float falsePositiveRate() const;
+  float strongFalseNegativeRate() const;
+};
+
+constexpr float DETECTION_VISIBLE_COUNTS = 150.0f;
+constexpr float DETECTION_STRONG_COUNTS = 500.0f;
+
+// Wanders the robot around the arena for `trials` runs of `durationS`
+// while the beacon switches on and off every 5-20 s and the room light
+// steps or drifts between 0.5x and 2.5x the configured ambient floor.
+DetectionScore scoreDetectionScenarios(const SimulationConfig &config,
+                                       const BeaconTrackerConfig &tracker,
+                                       uint32_t trials, float durationS,
+                                       uint64_t seed);
+
+// Replays recordings (beacon on throughout, so every tick is a positive).
+DetectionScore scoreDetectionRecording(const std::vector<BeaconSample> &samples,
+                                       const BeaconTrackerConfig &tracker);
@@ -0,0 +1,61 @@
+#include "drive_model.h"
+
+#include <algorithm>
+#include <cmath>
+
+DriveModel::DriveModel(const DriveModelConfig &config,
+                       const ArenaConfig &arena, std::mt19937 &rng)
+    : config_(config), arena_(arena), rng_(rng), headingNoise_(0.0f, 1.0f) {
+  std::uniform_real_distribution<float> gain(1.0f - config_.motorGainSpread,
+                                             1.0f + config_.motorGainSpread);
+  leftGain_ = gain(rng_);
+  rightGain_ = gain(rng_);
+}
+
+void DriveModel::setPose(const Pose &pose) { pose_ = pose; }
+
+const Pose &DriveModel::pose() const { return pose_; }
+
+void DriveModel::setLeftDuty(uint16_t duty) { leftDuty_ = duty; }
+
+void DriveModel::setRightDuty(uint16_t duty) { rightDuty_ = duty; }
+
+void DriveModel::stop() {
+  leftDuty_ = 0;
+  rightDuty_ = 0;
+}
+
+float DriveModel::targetSpeed(uint16_t duty, float gain) const {
+  if (duty <= config_.stallDuty) {
+    return 0.0f;
+  }
+  const float span =
+      static_cast<float>(config_.referenceDuty - config_.stallDuty);
+  const float normalized = static_cast<float>(duty - config_.stallDuty) / span;
+  return gain * config_.speedAtReferenceMps * normalized;
+}
+
+void DriveModel::step(float dtMs) {
+  const float blend = 1.0f - std::exp(-dtMs / config_.motorTimeConstantMs);
+  leftSpeed_ += (targetSpeed(leftDuty_, leftGain_) - leftSpeed_) * blend;
+  rightSpeed_ += (targetSpeed(rightDuty_, rightGain_) - rightSpeed_) * blend;
+
+  const float dt = dtMs * 0.001f;
+  const float v = 0.5f * (leftSpeed_ + rightSpeed_);
+  const float w = (rightSpeed_ - leftSpeed_) / config_.wheelBaseM;
+  yawRate_ = w;
+  const bool moving = leftSpeed_ > 1e-4f || rightSpeed_ > 1e-4f;
+  const float slip =
+      moving ? config_.headingNoise * std::sqrt(dt) * headingNoise_(rng_)
+             : 0.0f;
+
+  pose_.heading = wrapAngle(pose_.heading + w * dt + slip);
+  pose_.x += v * std::cos(pose_.heading) * dt;
+  pose_.y += v * std::sin(pose_.heading) * dt;
+
+  const float r = arena_.robotRadiusM;
+  pose_.x = std::min(std::max(pose_.x, r), arena_.widthM - r);
+  pose_.y = std::min(std::max(pose_.y, r), arena_.depthM - r);
+}
+
+float DriveModel::yawRate() const { return yawRate_; }
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "arena.h"
+
+#include <cstdint>
+#include <random>
+
+struct DriveModelConfig {
+  float wheelBaseM = 0.045f;
+  uint16_t stallDuty = 3150;
+  uint16_t referenceDuty = 4600;
+  float speedAtReferenceMps = 0.06f;
+  float motorTimeConstantMs = 60.0f;
+  // Per-run left/right gain mismatch, drawn uniformly from +-spread.
+  float motorGainSpread = 0.10f;
+  // Random walk on the heading (floor slip, wheel bounce), rad/sqrt(s).
+  float headingNoise = 0.05f;
+};
+
+// Differential drive with a stall duty, first-order motor lag and wall
+// contact. Positive angular velocity turns the robot left (counter-clockwise),
+// which is what raising the right motor duty does on the Dezibot.
+class DriveModel {
+public:
+  DriveModel(const DriveModelConfig &config, const ArenaConfig &arena,
+             std::mt19937 &rng);
+
+  void setPose(const Pose &pose);
+  const Pose &pose() const;
+
+  void setLeftDuty(uint16_t duty);
+  void setRightDuty(uint16_t duty);
+  void stop();
+
+  void step(float dtMs);
+  // Turn rate of the last step from the wheel speeds, rad/s, counter-
+  // clockwise positive: what the IMU gyro reads, before its noise.
+  float yawRate() const;
+
+private:
+  float targetSpeed(uint16_t duty, float gain) const;
+
+  DriveModelConfig config_;
+  ArenaConfig arena_;
+  std::mt19937 &rng_;
+  std::normal_distribution<float> headingNoise_;
+  Pose pose_;
+  float leftGain_ = 1.0f;
+  float rightGain_ = 1.0f;
+  uint16_t leftDuty_ = 0;
+  uint16_t rightDuty_ = 0;
+  float leftSpeed_ = 0.0f;
+  float rightSpeed_ = 0.0f;
+  float yawRate_ = 0.0f;
+};
@@ -0,0 +1,447 @@
+#include "fleet_sim.h"
+
+#include <heartbeat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <random>
+
+namespace {
+enum class EventKind : uint8_t {
+  REQUEST_CHARGE,
+  // State reports only a pipelined station acts on.
+  WALK_TO_CHARGE,
+  EXITING_CHARGE,
+  // The walk to the charger gave up.
+  WORK,
+  IN_WAIT,
+  IN_CHARGE,
+  STOP_CHARGE,
+  EXIT_CHARGE,
+  BRIDGE_DONE,
+  // A charging heartbeat with the slave's estimate.
+  CHARGE_ESTIMATE,
+  // Master-to-slave commands, delivered after the mesh latency.
+  ENJOIN,
+  CANCEL
+};
+
+struct Event {
+  double atS;
+  uint64_t order;
+  EventKind kind;
+  // Robot index, or bay for BRIDGE_DONE.
+  uint32_t target;
+
+  bool operator>(const Event &other) const {
+    return atS != other.atS ? atS > other.atS : order > other.order;
+  }
+};
+
+enum class RobotPhase : uint8_t {
+  WORK,
+  QUEUED,
+  WALKING_TO_CHARGE,
+  WAIT_CHARGE,
+  WALKING_INTO_CHARGE,
+  CHARGE,
+  EXITING_CHARGE
+};
+
+struct Robot {
+  RobotPhase phase = RobotPhase::WORK;
+  float walkScale = 1.0f;
+  double requestedAtS = 0.0;
+  double dispatchedAtS = 0.0;
+  double inWaitAtS = 0.0;
+  BatteryModel battery;
+  // What the robot draws from the battery since drawSinceS.
+  float drawA = 0.0f;
+  double drawSinceS = 0.0;
+  float socIn = 0.0f;
+  double chargeS = 0.0;
+  // Remaining charge time in each of the charge's heartbeats, in order.
+  std::vector<uint32_t> estimatesMs;
+  size_t nextEstimate = 0;
+};
+
+struct BayTiming {
+  // When the last charge ended, if slaves were queued then.
+  bool handingOver = false;
+  double stoppedAtS = 0.0;
+};
+
+constexpr uint64_t BATTERY_SEED = 0x6261747465727931ULL;
+
+float percentileOf(std::vector<float> values, float fraction) {
+  if (values.empty()) {
+    return 0.0f;
+  }
+  std::sort(values.begin(), values.end());
+  const size_t rank = static_cast<size_t>(
+      std::ceil(fraction * static_cast<float>(values.size())) - 1.0f);
+  return values[std::min(rank, values.size() - 1)];
+}
+
+class Fleet {
+public:
+  Fleet(const FleetConfig &config, uint64_t seed,
+        const SlaveEventCallback &onEvent)
+      : config_(config), onEvent_(onEvent), rng_(seed),
+        batteryRng_(seed ^ BATTERY_SEED), station_(makeStation(config)),
+        robots_(config.robots), bays_(station_.bayCount()) {
+    std::lognormal_distribution<float> scale(0.0f, config.walkRobotSigma);
+    std::uniform_real_distribution<float> soc(config.initialSocMin,
+                                              config.initialSocMax);
+    for (uint32_t robot = 0; robot < config.robots; ++robot) {
+      robots_[robot].walkScale = scale(rng_);
+      robots_[robot].battery = BatteryModel(config.battery, soc(batteryRng_));
+      robots_[robot].drawA = config.battery.workA;
+      schedule(workS(), EventKind::REQUEST_CHARGE, robot);
+    }
+  }
+
+  FleetResult run() {
+    const double endS = static_cast<double>(config_.hours) * 3600.0;
+    while (!events_.empty() && events_.top().atS <= endS) {
+      const Event event = events_.top();
+      events_.pop();
+      nowS_ = event.atS;
+      handle(event);
+      station_.dispatch(nowMs());
+      station::Action action;
+      while (station_.nextAction(action)) {
+        carryOut(action);
+      }
+    }
+
+    FleetResult result;
+    result.bays = station_.bayCount();
+    result.charges = charges_;
+    result.chargesPerHour = static_cast<float>(charges_) / config_.hours;
+    result.chargeUtilization = static_cast<float>(
+        chargingS_ / (endS * static_cast<double>(station_.bayCount())));
+    result.queueP50S = percentileOf(queueS_, 0.50f);
+    result.queueP90S = percentileOf(queueS_, 0.90f);
+    result.turnaroundP50S = percentileOf(turnaroundS_, 0.50f);
+    result.turnaroundP90S = percentileOf(turnaroundS_, 0.90f);
+    result.handoverP50S = percentileOf(handoverS_, 0.50f);
+    result.handoverP90S = percentileOf(handoverS_, 0.90f);
+    result.waitP50S = percentileOf(waitS_, 0.50f);
+    result.waitP90S = percentileOf(waitS_, 0.90f);
+    result.earlyDispatches = station_.earlyDispatches();
+    result.aborts = aborts_;
+    result.droppedActions = station_.droppedActions();
+
+    nowS_ = endS;
+    for (Robot &robot : robots_) {
+      draw(robot, 0.0f);
+    }
+    result.chargeP50S = percentileOf(chargeS_, 0.50f);
+    result.chargeP90S = percentileOf(chargeS_, 0.90f);
+    result.socInP50 = percentileOf(socIn_, 0.50f);
+    result.socOutP50 = percentileOf(socOut_, 0.50f);
+    result.fillsPerHour = static_cast<float>(
+        deliveredAs_ / config_.battery.capacityAs / config_.hours);
+    result.flatShare = static_cast<float>(
+        flatS_ / (endS * static_cast<double>(config_.robots)));
+    return result;
+  }
+
+private:
+  // Bay i answers at I2C 0x12 + i and has beacon i.
+  static station::Station makeStation(const FleetConfig &config) {
+    station::BayConfig bays[station::MAX_BAYS];
+    const uint8_t count = std::min<uint8_t>(config.bays, station::MAX_BAYS);
+    for (uint8_t bay = 0; bay < count; ++bay) {
+      bays[bay].bridgeAddress = static_cast<uint8_t>(0x12 + bay);
+      bays[bay].beacon = bay;
+    }
+    station::StationConfig station;
+    station.pipelined = config.pipelined || config.predictive;
+    station.predictive = config.predictive;
+    station.walkSpreadPercent = config.walkSpreadPercent;
+    return station::Station(bays, count, station);
+  }
+
+  // Station node ids start at 1; 0 means "no slave".
+  static uint32_t nodeOf(uint32_t robot) { return robot + 1; }
+
+  double workS() {
+    std::exponential_distribution<double> work(1.0 / config_.workMeanS);
+    return work(rng_);
+  }
+
+  double walkS(const Robot &robot) {
+    std::lognormal_distribution<double> trip(0.0, config_.walkTripSigma);
+    return config_.walkMedianS * robot.walkScale * trip(rng_);
+  }
+
+  bool givesUp() {
+    std::uniform_real_distribution<float> draw(0.0f, 1.0f);
+    return draw(rng_) < config_.walkAbortRate;
+  }
+
+  void note(uint32_t robot, SlaveEvent event) {
+    if (onEvent_) {
+      onEvent_(nowS_, robot, event);
+    }
+  }
+
+  uint32_t nowMs() const { return static_cast<uint32_t>(nowS_ * 1000.0); }
+
+  // The robot draws `currentA` from now on.
+  void draw(Robot &robot, float currentA) {
+    flatS_ += robot.battery.drain(nowS_ - robot.drawSinceS, robot.drawA);
+    robot.drawSinceS = nowS_;
+    robot.drawA = currentA;
+  }
+
+  // What step_charge() does on the charger: a battery sample every
+  // samplePeriodMs until ChargeTerminator ends the charge, and the estimate
+  // in every charging heartbeat. Returns the charge time.
+  double chargeOnBattery(Robot &robot, uint32_t index) {
+    charge_control::ChargeTerminator terminator(config_.charge);
+    terminator.begin(0);
+    robot.estimatesMs.clear();
+    robot.nextEstimate = 0;
+    const uint32_t periodMs = config_.charge.samplePeriodMs;
+    const uint32_t heartbeatMs = heartbeat::HeartbeatConfig().periodMs[
+        static_cast<size_t>(heartbeat::SlaveState::CHARGE)];
+    uint32_t nextHeartbeatMs = heartbeatMs;
+    uint32_t elapsedMs = 0;
+    for (;;) {
+      elapsedMs += periodMs;
+      robot.battery.charge(periodMs / 1000.0);
+      if (terminator.update(elapsedMs,
+                            robot.battery.senseMv(batteryRng_))) {
+        break;
+      }
+      if (elapsedMs >= nextHeartbeatMs) {
+        nextHeartbeatMs += heartbeatMs;
+        const uint32_t remaining = terminator.remainingMs(elapsedMs);
+        if (remaining != charge_control::REMAINING_UNKNOWN) {
+          robot.estimatesMs.push_back(remaining);
+          send(elapsedMs / 1000.0, EventKind::CHARGE_ESTIMATE, index);
+        }
+      }
+    }
+    return elapsedMs / 1000.0;
+  }
+
+  void schedule(double delayS, EventKind kind, uint32_t target) {
+    events_.push(Event{nowS_ + delayS, order_++, kind, target});
+  }
+
+  // Slave messages reach the master after the mesh latency.
+  void send(double delayS, EventKind kind, uint32_t robot) {
+    schedule(delayS + config_.meshLatencyS, kind, robot);
+  }
+
+  void handle(const Event &event) {
+    if (event.kind == EventKind::BRIDGE_DONE) {
+      station_.onBridgeDone(static_cast<uint8_t>(event.target), nowMs());
+      return;
+    }
+    Robot &robot = robots_[event.target];
+    const uint32_t node = nodeOf(event.target);
+    switch (event.kind) {
+    case EventKind::REQUEST_CHARGE:
+      note(event.target, SlaveEvent::REQUEST_CHARGE);
+      if (station_.onRequestCharge(node, nowMs())) {
+        robot.phase = RobotPhase::QUEUED;
+        robot.requestedAtS = nowS_;
+      } else {
+        // Queue full: try again after another stint of work.
+        schedule(workS(), EventKind::REQUEST_CHARGE, event.target);
+      }
+      break;
+    case EventKind::WALK_TO_CHARGE:
+      station_.onWalkToCharge(node, nowMs());
+      break;
+    case EventKind::EXITING_CHARGE:
+      station_.onExitingCharge(node, nowMs());
+      break;
+    case EventKind::WORK:
+      draw(robot, config_.battery.workA);
+      robot.phase = RobotPhase::WORK;
+      note(event.target, SlaveEvent::WORK);
+      aborts_++;
+      station_.onWork(node, nowMs());
+      schedule(workS(), EventKind::REQUEST_CHARGE, event.target);
+      break;
+    case EventKind::IN_WAIT:
+      if (robot.phase == RobotPhase::WALKING_TO_CHARGE) {
+        draw(robot, config_.battery.idleA);
+        robot.phase = RobotPhase::WAIT_CHARGE;
+        robot.inWaitAtS = nowS_;
+        note(event.target, SlaveEvent::IN_WAIT);
+      }
+      station_.onInWait(node, nowMs());
+      break;
+    case EventKind::IN_CHARGE:
+      robot.phase = RobotPhase::CHARGE;
+      note(event.target, SlaveEvent::IN_CHARGE);
+      noteHandover(node);
+      station_.onInCharge(node, nowMs());
+      draw(robot, 0.0f);
+      robot.socIn = robot.battery.soc();
+      if (config_.batteryCharge) {
+        robot.chargeS = chargeOnBattery(robot, event.target);
+      } else {
+        // step_charge() waits, then asks to stop.
+        robot.chargeS = config_.chargeS;
+        robot.battery.charge(robot.chargeS);
+      }
+      send(robot.chargeS, EventKind::STOP_CHARGE, event.target);
+      break;
+    case EventKind::CHARGE_ESTIMATE:
+      if (config_.chargeEstimates && robot.phase == RobotPhase::CHARGE &&
+          robot.nextEstimate < robot.estimatesMs.size()) {
+        station_.onChargeEstimate(node,
+                                  robot.estimatesMs[robot.nextEstimate++],
+                                  nowMs());
+      }
+      break;
+    case EventKind::STOP_CHARGE:
+      note(event.target, SlaveEvent::STOP_CHARGE);
+      charges_++;
+      chargingS_ += robot.chargeS;
+      chargeS_.push_back(static_cast<float>(robot.chargeS));
+      socIn_.push_back(robot.socIn);
+      socOut_.push_back(robot.battery.soc());
+      deliveredAs_ += static_cast<double>(robot.battery.soc() - robot.socIn) *
+                      config_.battery.capacityAs;
+      robot.battery.detach();
+      if (station_.bayOf(node) != station::NO_BAY) {
+        const uint8_t index = station_.bayOf(node);
+        BayTiming &bay = bays_[index];
+        bay.handingOver = station_.queued() > 0 || station_.next(index) != 0;
+        bay.stoppedAtS = nowS_;
+      }
+      station_.onStopCharge(node, nowMs());
+      break;
+    case EventKind::EXIT_CHARGE:
+      note(event.target, SlaveEvent::WORK);
+      station_.onExitCharge(node, nowMs());
+      draw(robot, config_.battery.workA);
+      turnaroundS_.push_back(static_cast<float>(nowS_ - robot.dispatchedAtS));
+      schedule(workS(), EventKind::REQUEST_CHARGE, event.target);
+      break;
+    case EventKind::BRIDGE_DONE:
+      break;
+    case EventKind::ENJOIN:
+      enjoin(robot, event.target);
+      break;
+    case EventKind::CANCEL:
+      if (robot.phase == RobotPhase::CHARGE) {
+        draw(robot, config_.battery.walkA);
+        robot.phase = RobotPhase::EXITING_CHARGE;
+        note(event.target, SlaveEvent::EXIT_CHARGE);
+        send(0.0, EventKind::EXITING_CHARGE, event.target);
+        send(config_.exitS, EventKind::EXIT_CHARGE, event.target);
+      }
+      break;
+    }
+  }
+
+  // What the slave state machine does with enjoinCharge.
+  void enjoin(Robot &robot, uint32_t index) {
+    switch (robot.phase) {
+    case RobotPhase::QUEUED:
+      draw(robot, config_.battery.walkA);
+      robot.phase = RobotPhase::WALKING_TO_CHARGE;
+      note(index, SlaveEvent::WALK_TO_CHARGE);
+      send(0.0, EventKind::WALK_TO_CHARGE, index);
+      if (config_.walkAbortRate > 0.0f && givesUp()) {
+        // Somewhere along the way.
+        std::uniform_real_distribution<double> along(0.0, 1.0);
+        send(walkS(robot) * along(rng_), EventKind::WORK, index);
+      } else {
+        send(walkS(robot), EventKind::IN_WAIT, index);
+      }
+      break;
+    case RobotPhase::WAIT_CHARGE:
+      waitS_.push_back(static_cast<float>(nowS_ - robot.inWaitAtS));
+      draw(robot, config_.battery.walkA);
+      robot.phase = RobotPhase::WALKING_INTO_CHARGE;
+      note(index, SlaveEvent::WALK_INTO_CHARGE);
+      send(config_.walkIntoS, EventKind::IN_CHARGE, index);
+      break;
+    default:
+      break;
+    }
+  }
+
+  void noteHandover(uint32_t node) {
+    const uint8_t index = station_.bayOf(node);
+    if (index == station::NO_BAY || !bays_[index].handingOver) {
+      return;
+    }
+    bays_[index].handingOver = false;
+    handoverS_.push_back(static_cast<float>(nowS_ - bays_[index].stoppedAtS));
+  }
+
+  void carryOut(const station::Action &action) {
+    switch (action.kind) {
+    case station::ActionKind::ENJOIN: {
+      const uint32_t index = action.slave - 1;
+      Robot &robot = robots_[index];
+      if (robot.phase == RobotPhase::QUEUED) {
+        robot.dispatchedAtS = nowS_;
+        queueS_.push_back(static_cast<float>(nowS_ - robot.requestedAtS));
+      }
+      schedule(config_.meshLatencyS, EventKind::ENJOIN, index);
+      break;
+    }
+    case station::ActionKind::CANCEL:
+      schedule(config_.meshLatencyS, EventKind::CANCEL, action.slave - 1);
+      break;
+    case station::ActionKind::LOWER_GEAR:
+      schedule(config_.lowerGearS, EventKind::BRIDGE_DONE, action.bay);
+      break;
+    case station::ActionKind::ATTACH_GEAR:
+      schedule(config_.attachGearS, EventKind::BRIDGE_DONE, action.bay);
+      break;
+    case station::ActionKind::LIFT_GEAR:
+      schedule(config_.liftGearS, EventKind::BRIDGE_DONE, action.bay);
+      break;
+    case station::ActionKind::DETACH_GEAR:
+      schedule(config_.detachGearS, EventKind::BRIDGE_DONE, action.bay);
+      break;
+    }
+  }
+
+  const FleetConfig &config_;
+  const SlaveEventCallback &onEvent_;
+  std::mt19937_64 rng_;
+  // Sense noise and starting charge, apart from rng_ so the cycle is the
+  // same with and without batteryCharge.
+  std::mt19937_64 batteryRng_;
+  station::Station station_;
+  std::vector<Robot> robots_;
+  std::vector<BayTiming> bays_;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+  double nowS_ = 0.0;
+  uint64_t order_ = 0;
+  uint32_t charges_ = 0;
+  double chargingS_ = 0.0;
+  std::vector<float> queueS_;
+  std::vector<float> turnaroundS_;
+  std::vector<float> handoverS_;
+  std::vector<float> waitS_;
+  uint32_t aborts_ = 0;
+  std::vector<float> chargeS_;
+  std::vector<float> socIn_;
+  std::vector<float> socOut_;
+  double deliveredAs_ = 0.0;
+  double flatS_ = 0.0;
+};
+} // namespace
+
+FleetResult simulateFleet(const FleetConfig &config, uint64_t seed,
+                          const SlaveEventCallback &onEvent) {
+  return Fleet(config, seed, onEvent).run();
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "battery_model.h"
+
+#include <charge_config.h>
+#include <charge_control.h>
+#include <station.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Durations of one charging cycle. The bridge motions follow from the step
+// counts and speed in motor/src/main.cpp (MultiStepper runs at max_rpm, 267
+// steps/s): 1200 steps down to walk-in, 100 more to charge, 1300 back up.
+// The walk to the beacon is lognormal around the navigation Monte Carlo
+// (p50 25 s, p90 52 s); every robot has its own typical distance, and each
+// trip varies around it. The slave's step functions fix the rest.
+// Every robot runs off a battery model; it charges for chargeS, or, with
+// batteryCharge, until the slave's charge_control ends the charge.
+// Pipelined (common/station), the bay detaches the gear instead of lifting
+// it when slaves are queued, 100 steps up at the same speed.
+struct FleetConfig {
+  uint32_t robots = 24;
+  uint8_t bays = 1;
+  float hours = 8.0f;
+  // Time at work between charges, exponential.
+  float workMeanS = 120.0f;
+  float walkMedianS = 25.0f;
+  float walkRobotSigma = 0.4f;
+  float walkTripSigma = 0.4f;
+  float walkIntoS = 3.0f;
+  float chargeS = 15.0f;
+  float exitS = 6.0f;
+  float lowerGearS = 4.5f;
+  float attachGearS = 0.4f;
+  float liftGearS = 4.9f;
+  float detachGearS = 0.4f;
+  // One way, every mesh message.
+  float meshLatencyS = 0.03f;
+  bool pipelined = false;
+  // Pipelined, and the next robot is sent from its walk estimate.
+  bool predictive = false;
+  uint8_t walkSpreadPercent = 100;
+  // Share of walks to the charger that give up on the way, back to work.
+  float walkAbortRate = 0.0f;
+  bool batteryCharge = false;
+  // With batteryCharge: the estimates in the slave's charging heartbeats
+  // reach the station (Station::onChargeEstimate).
+  bool chargeEstimates = true;
+  BatteryModelConfig battery;
+  charge_control::ChargeConfig charge = charge_config::chargeConfig();
+  // Each robot starts with a state of charge drawn from this range.
+  float initialSocMin = 0.4f;
+  float initialSocMax = 0.9f;
+};
+
+struct FleetResult {
+  uint8_t bays = 0;
+  uint32_t charges = 0;
+  float chargesPerHour = 0.0f;
+  // Share of bay time spent charging a robot.
+  float chargeUtilization = 0.0f;
+  // requestCharge until the robot is sent to a bay.
+  float queueP50S = 0.0f;
+  float queueP90S = 0.0f;
+  // From sending a robot to the bay until the bay is free again.
+  float turnaroundP50S = 0.0f;
+  float turnaroundP90S = 0.0f;
+  // From a charge ending to the next one starting on the same bay, for
+  // charges that ended with slaves queued: the bay time one cycle costs
+  // beyond the charge itself.
+  float handoverP50S = 0.0f;
+  float handoverP90S = 0.0f;
+  // Robot idle time at the bay: waiting for the gear or the handover.
+  float waitP50S = 0.0f;
+  float waitP90S = 0.0f;
+  uint32_t earlyDispatches = 0;
+  uint32_t aborts = 0;
+  uint32_t droppedActions = 0;
+  float chargeP50S = 0.0f;
+  float chargeP90S = 0.0f;
+  // State of charge robots come to the charger with and leave with, 0..1.
+  float socInP50 = 0.0f;
+  float socOutP50 = 0.0f;
+  // Charge delivered, in full batteries per hour.
+  float fillsPerHour = 0.0f;
+  // Share of robot time with a flat battery.
+  float flatShare = 0.0f;
+};
+
+// What a simulated slave does, at the time the master hears of it; state
+// changes and the two requests, for traffic models of the slave side.
+enum class SlaveEvent : uint8_t {
+  REQUEST_CHARGE,
+  WALK_TO_CHARGE,
+  IN_WAIT,
+  WALK_INTO_CHARGE,
+  IN_CHARGE,
+  STOP_CHARGE,
+  EXIT_CHARGE,
+  WORK
+};
+using SlaveEventCallback =
+    std::function<void(double atS, uint32_t robot, SlaveEvent event)>;
+
+// Runs the station scheduler (common/station) against `robots` simulated
+// slaves and `bays` bridges, message by message. Deterministic for a seed.
+FleetResult simulateFleet(const FleetConfig &config, uint64_t seed,
+                          const SlaveEventCallback &onEvent = nullptr);
@@ -0,0 +1,86 @@
+#include "heading_bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+constexpr float DISTANCE_MIN_M = 0.18f;
+constexpr float DISTANCE_MAX_M = 0.28f;
+constexpr float AXIS_SPREAD_RAD = 0.61f;
+constexpr float STEP_MIN_RAD = 0.785f;
+constexpr float STEP_MAX_RAD = 2.356f;
+
+Pose stepStartPose(const ArenaConfig &arena, std::mt19937 &rng) {
+  std::uniform_real_distribution<float> distance(DISTANCE_MIN_M,
+                                                 DISTANCE_MAX_M);
+  std::uniform_real_distribution<float> axis(-AXIS_SPREAD_RAD,
+                                             AXIS_SPREAD_RAD);
+  std::uniform_real_distribution<float> step(STEP_MIN_RAD, STEP_MAX_RAD);
+  std::bernoulli_distribution left(0.5);
+
+  const float r = distance(rng);
+  const float along = arena.beaconHeading + axis(rng);
+  Pose pose;
+  pose.x = arena.beaconX + r * std::cos(along);
+  pose.y = arena.beaconY + r * std::sin(along);
+  const float toBeacon =
+      std::atan2(arena.beaconY - pose.y, arena.beaconX - pose.x);
+  pose.heading = wrapAngle(toBeacon + (left(rng) ? step(rng) : -step(rng)));
+  return pose;
+}
+
+float percentileOf(std::vector<float> &values, float fraction) {
+  if (values.empty()) {
+    return 0.0f;
+  }
+  std::sort(values.begin(), values.end());
+  const size_t rank = static_cast<size_t>(
+      std::ceil(fraction * static_cast<float>(values.size())) - 1.0f);
+  return values[std::min(rank, values.size() - 1)];
+}
+} // namespace
+
+HeadingStepSummary runHeadingSteps(const SimulationConfig &config,
+                                   uint32_t trials, uint64_t seed) {
+  HeadingStepSummary summary;
+  summary.trials = trials;
+  std::vector<float> settle;
+  std::vector<float> arrival;
+  std::vector<float> efficiency;
+  // Start poses come from their own generator, so every configuration
+  // gets the same ones.
+  std::mt19937 poses(static_cast<uint32_t>(seed ^ (seed >> 32)));
+  for (uint32_t i = 0; i < trials; ++i) {
+    const Pose start = stepStartPose(config.arena, poses);
+    const RunResult result = simulateRun(config, i, seed, nullptr, &start);
+    if (result.headingSettled) {
+      summary.settled++;
+      settle.push_back(static_cast<float>(result.headingSettleMs) * 0.001f);
+    }
+    if (result.outcome == RunOutcome::ARRIVED) {
+      summary.arrived++;
+      arrival.push_back(static_cast<float>(result.timeMs) * 0.001f);
+      if (result.pathM > 0.0f) {
+        efficiency.push_back(
+            (result.startDistanceM - result.finalDistanceM) / result.pathM);
+      }
+    }
+  }
+
+  summary.settleP50S = percentileOf(settle, 0.50f);
+  summary.settleP90S = percentileOf(settle, 0.90f);
+  summary.arrivalP50S = percentileOf(arrival, 0.50f);
+  summary.arrivalP90S = percentileOf(arrival, 0.90f);
+  if (!efficiency.empty()) {
+    double total = 0.0;
+    for (float value : efficiency) {
+      total += value;
+    }
+    summary.pathEfficiencyMean =
+        static_cast<float>(total / static_cast<double>(efficiency.size()));
+    summary.pathEfficiencyP10 = percentileOf(efficiency, 0.10f);
+  }
+  return summary;
+}
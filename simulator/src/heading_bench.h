@@ -0,0 +1,27 @@
+#pragma once
+
+#include "monte_carlo.h"
+
+#include <cstdint>
+
+// Steering response of the navigator: each trial starts the robot where the
+// beacon is in clear view, 18-28 cm out and within 35 deg of its axis, but
+// turned 45-135 deg away from it, and drives it to arrival. A Monte Carlo
+// run spends most of its time finding the beacon from afar, where the
+// bearing is mostly ambient light; here the bearing step is the whole test.
+struct HeadingStepSummary {
+  uint32_t trials = 0;
+  uint32_t arrived = 0;
+  uint32_t settled = 0;
+  // Over settled trials (RunResult::headingSettleMs).
+  float settleP50S = 0.0f;
+  float settleP90S = 0.0f;
+  // Over arrived trials.
+  float arrivalP50S = 0.0f;
+  float arrivalP90S = 0.0f;
+  float pathEfficiencyMean = 0.0f;
+  float pathEfficiencyP10 = 0.0f;
+};
+
+HeadingStepSummary runHeadingSteps(const SimulationConfig &config,
+                                   uint32_t trials, uint64_t seed);
@@ -0,0 +1,398 @@
+#include "heartbeat_bench.h"
+
+#include <beacon_power.h>
+#include <heartbeat.h>
+#include <mesh_messages.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+struct Frame {
+  double atS;
+  uint32_t node;
+  std::string text;
+};
+
+struct Transition {
+  double atS;
+  SlaveEvent event;
+};
+
+// Station node ids, as in fleet_sim.
+uint32_t nodeOf(uint32_t robot) { return robot + 1; }
+
+uint32_t toMs(double seconds) {
+  return static_cast<uint32_t>(std::llround(seconds * 1000.0));
+}
+
+// A report as seen midway through a walk; the content only matters for
+// the work the master does with it.
+beacon_power::BeaconReport sampleReport(uint32_t node, uint32_t index) {
+  beacon_power::BeaconReport report;
+  report.node = node;
+  report.duty = 256;
+  report.signal = 600 + (index % 16) * 40;
+  report.ticks = 10;
+  return report;
+}
+
+void addSignal(std::vector<Frame> &frames, double atS, uint32_t node,
+               mesh_proto::Type type) {
+  char message[mesh_proto::MESSAGE_CAPACITY];
+  if (mesh_proto::encodeSignal(type, message, sizeof(message)) > 0) {
+    frames.push_back(Frame{atS, node, message});
+  }
+}
+
+void addReport(std::vector<Frame> &frames, double atS, uint32_t node,
+               uint32_t index) {
+  char message[mesh_proto::MESSAGE_CAPACITY];
+  if (mesh_proto::encodeBeaconReport(sampleReport(node, index), message,
+                                     sizeof(message)) > 0) {
+    frames.push_back(Frame{atS, node, message});
+  }
+}
+
+// The firmware before heartbeats, one robot.
+void perEventFrames(const std::vector<Transition> &transitions, uint32_t node,
+                    double endS, const HeartbeatBenchConfig &config,
+                    std::vector<Frame> &frames) {
+  double requestedAtS = -1.0;
+  double walkStartS = 0.0;
+  uint32_t reports = 0;
+  auto repeatRequests = [&](double untilS) {
+    if (requestedAtS < 0.0) {
+      return;
+    }
+    for (double t = requestedAtS + config.requestRepeatS; t < untilS;
+         t += config.requestRepeatS) {
+      addSignal(frames, t, node, mesh_proto::Type::REQUEST_CHARGE);
+    }
+    requestedAtS = -1.0;
+  };
+
+  for (const Transition &transition : transitions) {
+    const double t = transition.atS;
+    switch (transition.event) {
+    case SlaveEvent::REQUEST_CHARGE:
+      repeatRequests(t);
+      addSignal(frames, t, node, mesh_proto::Type::REQUEST_CHARGE);
+      requestedAtS = t;
+      break;
+    case SlaveEvent::WALK_TO_CHARGE:
+      repeatRequests(t);
+      addSignal(frames, t, node, mesh_proto::Type::NOTIFY_WALK_TO_CHARGE);
+      walkStartS = t;
+      break;
+    case SlaveEvent::IN_WAIT:
+      for (double r = walkStartS + config.reportPeriodS; r < t;
+           r += config.reportPeriodS) {
+        addReport(frames, r, node, reports++);
+      }
+      addSignal(frames, t, node, mesh_proto::Type::NOTIFY_IN_WAIT);
+      break;
+    case SlaveEvent::WALK_INTO_CHARGE:
+      addSignal(frames, t, node, mesh_proto::Type::NOTIFY_WALK_INTO_CHARGE);
+      break;
+    case SlaveEvent::IN_CHARGE:
+      addSignal(frames, t, node, mesh_proto::Type::NOTIFY_IN_CHARGE);
+      break;
+    case SlaveEvent::STOP_CHARGE:
+      addSignal(frames, t, node, mesh_proto::Type::STOP_CHARGE);
+      break;
+    case SlaveEvent::EXIT_CHARGE:
+      addSignal(frames, t, node, mesh_proto::Type::NOTIFY_EXIT_CHARGE);
+      break;
+    case SlaveEvent::WORK:
+      addSignal(frames, t, node, mesh_proto::Type::NOTIFY_WORK);
+      break;
+    }
+  }
+  repeatRequests(endS);
+}
+
+// The same robot with heartbeats, state handling as in slave/src/main.cpp.
+class HeartbeatSlave {
+public:
+  HeartbeatSlave(uint32_t node, double bootS,
+                 const HeartbeatBenchConfig &config,
+                 std::vector<Frame> &frames)
+      : node_(node), config_(config), frames_(frames) {
+    // The first state goes out at once.
+    scheduler_.setState(heartbeat::SlaveState::WORK, toMs(bootS));
+    send(bootS, nullptr);
+  }
+
+  void run(const std::vector<Transition> &transitions, double endS) {
+    for (const Transition &transition : transitions) {
+      advance(transition.atS);
+      apply(transition);
+    }
+    advance(endS);
+  }
+
+  uint64_t urgent() const { return urgent_; }
+
+private:
+  // Heartbeats between events. While walking the report windows pace
+  // them, and a walk always ends with the next event.
+  void advance(double untilS) {
+    if (scheduler_.state() == heartbeat::SlaveState::WALKING_TO_CHARGE) {
+      const double fastFromS = untilS - config_.reportFastS;
+      double t = stateSinceS_;
+      while (true) {
+        const bool fast = t + config_.reportPeriodS > fastFromS;
+        t += fast ? config_.reportPeriodS : config_.reportSlowPeriodS;
+        if (t >= untilS) {
+          break;
+        }
+        const beacon_power::BeaconReport report =
+            sampleReport(node_, reports_++);
+        send(t, &report);
+      }
+      return;
+    }
+    while (true) {
+      const double t = static_cast<double>(scheduler_.nextDueAt()) * 0.001;
+      if (t >= untilS) {
+        return;
+      }
+      send(t, nullptr);
+    }
+  }
+
+  void apply(const Transition &transition) {
+    const double t = transition.atS;
+    const uint32_t nowMs = toMs(t);
+    bool urgent = false;
+    switch (transition.event) {
+    case SlaveEvent::REQUEST_CHARGE:
+      urgent = scheduler_.setRequest(heartbeat::FLAG_WANTS_CHARGE, true);
+      break;
+    case SlaveEvent::STOP_CHARGE:
+      urgent = scheduler_.setRequest(heartbeat::FLAG_WANTS_STOP, true);
+      break;
+    default: {
+      const heartbeat::SlaveState state = stateAfter(transition.event);
+      if (state != heartbeat::SlaveState::WORK) {
+        scheduler_.setRequest(heartbeat::FLAG_WANTS_CHARGE, false);
+      }
+      if (state != heartbeat::SlaveState::CHARGE) {
+        scheduler_.setRequest(heartbeat::FLAG_WANTS_STOP, false);
+      }
+      if (state != scheduler_.state()) {
+        stateSinceS_ = t;
+      }
+      urgent = scheduler_.setState(state, nowMs);
+      break;
+    }
+    }
+    if (urgent) {
+      urgent_++;
+      send(t, nullptr);
+    }
+  }
+
+  static heartbeat::SlaveState stateAfter(SlaveEvent event) {
+    switch (event) {
+    case SlaveEvent::WALK_TO_CHARGE:
+      return heartbeat::SlaveState::WALKING_TO_CHARGE;
+    case SlaveEvent::IN_WAIT:
+      return heartbeat::SlaveState::WAIT_CHARGE;
+    case SlaveEvent::WALK_INTO_CHARGE:
+      return heartbeat::SlaveState::WALKING_INTO_CHARGE;
+    case SlaveEvent::IN_CHARGE:
+      return heartbeat::SlaveState::CHARGE;
+    case SlaveEvent::EXIT_CHARGE:
+      return heartbeat::SlaveState::EXITING_CHARGE;
+    default:
+      return heartbeat::SlaveState::WORK;
+    }
+  }
+
+  void send(double t, const beacon_power::BeaconReport *report) {
+    heartbeat::Status status;
+    if (report != nullptr) {
+      status.flags |= heartbeat::FLAG_REPORT | heartbeat::FLAG_DETECTED;
+      status.report = *report;
+      status.thetaCentiDeg = 1200;
+    }
+    scheduler_.take(node_, toMs(t), status);
+    char message[mesh_proto::MESSAGE_CAPACITY];
+    if (mesh_proto::encodeHeartbeat(status, message, sizeof(message)) > 0) {
+      frames_.push_back(Frame{t, node_, message});
+    }
+  }
+
+  uint32_t node_;
+  const HeartbeatBenchConfig &config_;
+  std::vector<Frame> &frames_;
+  heartbeat::HeartbeatScheduler scheduler_;
+  double stateSinceS_ = 0.0;
+  uint32_t reports_ = 0;
+  uint64_t urgent_ = 0;
+};
+
+void countTraffic(std::vector<Frame> &frames, double endS,
+                  ChannelTraffic &traffic) {
+  std::stable_sort(frames.begin(), frames.end(),
+                   [](const Frame &a, const Frame &b) { return a.atS < b.atS; });
+  std::vector<uint32_t> perSecond(static_cast<size_t>(std::ceil(endS)) + 1);
+  for (const Frame &frame : frames) {
+    traffic.messages++;
+    traffic.bytes += frame.text.size();
+    perSecond[std::min(static_cast<size_t>(frame.atS), perSecond.size() - 1)]++;
+  }
+  traffic.perSecond =
+      static_cast<float>(static_cast<double>(traffic.messages) / endS);
+  traffic.peakPerSecond =
+      *std::max_element(perSecond.begin(), perSecond.end());
+}
+
+// What the master keeps per slave without heartbeats: the dezibot Master
+// looks slaves up in a list.
+struct KnownSlave {
+  uint32_t node;
+  uint8_t lastSignal;
+};
+
+struct PerEventMaster {
+  std::vector<KnownSlave> slaves;
+  beacon_power::BeaconPowerController beaconPower;
+  uint32_t nowMs = 0;
+};
+
+void onSignal(void *context, const mesh_proto::Envelope &envelope,
+              mesh_proto::Reader &payload) {
+  (void)payload;
+  PerEventMaster &master = *static_cast<PerEventMaster *>(context);
+  for (KnownSlave &slave : master.slaves) {
+    if (slave.node == envelope.from) {
+      slave.lastSignal++;
+      return;
+    }
+  }
+  master.slaves.push_back(KnownSlave{envelope.from, 0});
+}
+
+void onReport(void *context, const mesh_proto::Envelope &envelope,
+              mesh_proto::Reader &payload) {
+  (void)envelope;
+  PerEventMaster &master = *static_cast<PerEventMaster *>(context);
+  beacon_power::BeaconReport report;
+  if (mesh_proto::readBeaconReport(payload, report)) {
+    master.beaconPower.onReport(report, master.nowMs);
+  }
+}
+
+struct HeartbeatMaster {
+  heartbeat::SlaveTable slaves;
+  beacon_power::BeaconPowerController beaconPower;
+  uint32_t nowMs = 0;
+  uint32_t changes = 0;
+};
+
+void onHeartbeat(void *context, const mesh_proto::Envelope &envelope,
+                 mesh_proto::Reader &payload) {
+  (void)envelope;
+  HeartbeatMaster &master = *static_cast<HeartbeatMaster *>(context);
+  heartbeat::Status status;
+  if (!mesh_proto::readHeartbeat(payload, status)) {
+    return;
+  }
+  if ((status.flags & heartbeat::FLAG_REPORT) != 0) {
+    master.beaconPower.onReport(status.report, master.nowMs);
+  }
+  master.changes += master.slaves.ingest(status, master.nowMs) != 0 ? 1 : 0;
+}
+
+// Feeds the whole run through a fresh master until minTimedMessages went
+// through; Master is rebuilt per pass so every pass sees the same state.
+template <typename Master, typename Setup>
+void timeIngest(const std::vector<Frame> &frames, double endS,
+                uint32_t minMessages, Setup setup, ChannelTraffic &traffic) {
+  if (frames.empty()) {
+    return;
+  }
+  const uint32_t passes = std::max<uint32_t>(
+      1, minMessages / static_cast<uint32_t>(frames.size()));
+  std::chrono::nanoseconds elapsed(0);
+  for (uint32_t pass = 0; pass < passes; ++pass) {
+    Master master;
+    mesh_proto::Dispatcher dispatcher;
+    setup(dispatcher, master);
+    const auto started = std::chrono::steady_clock::now();
+    for (const Frame &frame : frames) {
+      master.nowMs = toMs(frame.atS);
+      mesh_proto::Envelope envelope;
+      envelope.from = frame.node;
+      dispatcher.dispatchText(envelope, frame.text.data(), frame.text.size());
+    }
+    elapsed += std::chrono::steady_clock::now() - started;
+  }
+  const double totalNs = static_cast<double>(elapsed.count());
+  traffic.ingestNsPerMessage = static_cast<float>(
+      totalNs / static_cast<double>(passes) /
+      static_cast<double>(frames.size()));
+  traffic.ingestUsPerSecond = static_cast<float>(
+      totalNs / static_cast<double>(passes) / endS * 0.001);
+}
+} // namespace
+
+HeartbeatBenchResult benchHeartbeats(const FleetConfig &fleet,
+                                     const HeartbeatBenchConfig &config,
+                                     uint64_t seed) {
+  std::vector<std::vector<Transition>> transitions(fleet.robots);
+  const FleetResult run = simulateFleet(
+      fleet, seed, [&](double atS, uint32_t robot, SlaveEvent event) {
+        transitions[robot].push_back(Transition{atS, event});
+      });
+  const double endS = static_cast<double>(fleet.hours) * 3600.0;
+
+  HeartbeatBenchResult result;
+  result.slaves = fleet.robots;
+  result.bays = run.bays;
+  result.charges = run.charges;
+
+  std::vector<Frame> perEvent;
+  std::vector<Frame> heartbeats;
+  for (uint32_t robot = 0; robot < fleet.robots; ++robot) {
+    perEventFrames(transitions[robot], nodeOf(robot), endS, config, perEvent);
+    const double bootS = std::min(
+        transitions[robot].empty() ? endS : transitions[robot].front().atS,
+        config.bootSpreadS * (robot + 0.5) / fleet.robots);
+    HeartbeatSlave slave(nodeOf(robot), bootS, config, heartbeats);
+    slave.run(transitions[robot], endS);
+    result.urgentHeartbeats += slave.urgent();
+  }
+  countTraffic(perEvent, endS, result.perEvent);
+  countTraffic(heartbeats, endS, result.heartbeat);
+
+  timeIngest<PerEventMaster>(
+      perEvent, endS, config.minTimedMessages,
+      [](mesh_proto::Dispatcher &dispatcher, PerEventMaster &master) {
+        for (mesh_proto::Type type :
+             {mesh_proto::Type::REQUEST_CHARGE, mesh_proto::Type::STOP_CHARGE,
+              mesh_proto::Type::NOTIFY_WORK,
+              mesh_proto::Type::NOTIFY_WALK_TO_CHARGE,
+              mesh_proto::Type::NOTIFY_IN_WAIT,
+              mesh_proto::Type::NOTIFY_WALK_INTO_CHARGE,
+              mesh_proto::Type::NOTIFY_IN_CHARGE,
+              mesh_proto::Type::NOTIFY_EXIT_CHARGE}) {
+          dispatcher.on(type, onSignal, &master);
+        }
+        dispatcher.on(mesh_proto::Type::BEACON_REPORT, onReport, &master);
+      },
+      result.perEvent);
+  timeIngest<HeartbeatMaster>(
+      heartbeats, endS, config.minTimedMessages,
+      [](mesh_proto::Dispatcher &dispatcher, HeartbeatMaster &master) {
+        dispatcher.on(mesh_proto::Type::HEARTBEAT, onHeartbeat, &master);
+      },
+      result.heartbeat);
+  return result;
+}
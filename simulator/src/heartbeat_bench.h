@@ -0,0 +1,55 @@
+#pragma once
+
+#include "fleet_sim.h"
+
+#include <cstdint>
+
+// Slave-to-master traffic of one fleet run, sent two ways: as the per-event
+// messages the firmware sent before common/heartbeat, and as heartbeats.
+//
+// Per event: a notify frame per state change, requestCharge repeated by
+// step_work() until the robot is sent to a bay, stopCharge, and a beacon
+// report every reportPeriodS while walking to the charger.
+// Heartbeats: HeartbeatScheduler with its default periods, driven by the
+// same events; while walking, one per beacon report window, which is
+// reportSlowPeriodS until the last reportFastS of the walk.
+struct HeartbeatBenchConfig {
+  float requestRepeatS = 3.0f;
+  float reportPeriodS = 0.2f;
+  float reportSlowPeriodS = 0.5f;
+  // Time above BEACON_REPORT_FAST_SIGNAL at the end of a walk. At 1 s a
+  // 25 s walk sends the ~2.1 reports/s the --beacon-power Monte Carlo
+  // measures.
+  float reportFastS = 1.0f;
+  // Slaves are switched on one after the other over this time.
+  float bootSpreadS = 10.0f;
+  // Master ingest is timed over at least this many messages.
+  uint32_t minTimedMessages = 2000000;
+};
+
+struct ChannelTraffic {
+  uint64_t messages = 0;
+  // Armored frames as sent, terminator excluded.
+  uint64_t bytes = 0;
+  float perSecond = 0.0f;
+  // Busiest second of the run, whole fleet.
+  uint32_t peakPerSecond = 0;
+  // Decode, dispatch and the master's bookkeeping on this host.
+  float ingestNsPerMessage = 0.0f;
+  // Master time per second of fleet time.
+  float ingestUsPerSecond = 0.0f;
+};
+
+struct HeartbeatBenchResult {
+  uint32_t slaves = 0;
+  uint8_t bays = 0;
+  uint32_t charges = 0;
+  ChannelTraffic perEvent;
+  ChannelTraffic heartbeat;
+  // Heartbeats sent at once for a transition or request.
+  uint64_t urgentHeartbeats = 0;
+};
+
+HeartbeatBenchResult benchHeartbeats(const FleetConfig &fleet,
+                                     const HeartbeatBenchConfig &config,
+                                     uint64_t seed);
@@ -0,0 +1,80 @@
+#include "ir_sensor_model.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const float kChannelAxis[IR_CHANNEL_COUNT] = {0.0f, kPi, 0.5f * kPi,
+                                              -0.5f * kPi};
+
+float lobe(float angle, float exponent) {
+  const float c = std::cos(angle);
+  return c > 0.0f ? std::pow(c, exponent) : 0.0f;
+}
+} // namespace
+
+IrSensorModel::IrSensorModel(const IrSensorModelConfig &config,
+                             const ArenaConfig &arena, std::mt19937 &rng)
+    : config_(config), arena_(arena), rng_(rng),
+      noise_(0.0f, config.noiseSigma) {}
+
+void IrSensorModel::setBeaconDuty(float duty) { config_.beaconDuty = duty; }
+
+void IrSensorModel::setAmbientScale(float scale) { ambientScale_ = scale; }
+
+float IrSensorModel::contribution(float sensorX, float sensorY,
+                                  float sensorAxis, float sourceX,
+                                  float sourceY, float sourceHeading) const {
+  const float dx = sensorX - sourceX;
+  const float dy = sensorY - sourceY;
+  const float distanceSq =
+      dx * dx + dy * dy + config_.softeningM * config_.softeningM;
+
+  const float emitAngle = wrapAngle(std::atan2(dy, dx) - sourceHeading);
+  const float incidence = wrapAngle(std::atan2(-dy, -dx) - sensorAxis);
+  const float receive =
+      config_.sensorScatter + (1.0f - config_.sensorScatter) *
+                                  lobe(incidence, config_.sensorExponent);
+
+  return lobe(emitAngle, config_.beaconExponent) * receive / distanceSq;
+}
+
+float IrSensorModel::expected(const Pose &pose, IrChannel channel) const {
+  const float axis = wrapAngle(pose.heading + kChannelAxis[channel]);
+  const float sx = pose.x + config_.sensorOffsetM * std::cos(axis);
+  const float sy = pose.y + config_.sensorOffsetM * std::sin(axis);
+
+  const float bx = arena_.beaconX;
+  const float by = arena_.beaconY;
+  const float bh = arena_.beaconHeading;
+
+  float received = contribution(sx, sy, axis, bx, by, bh);
+
+  // First-order images; the beacon sits on the x = 0 wall, so that wall
+  // contributes no separate image.
+  const float rho = config_.wallReflectivity;
+  received += rho * contribution(sx, sy, axis, 2.0f * arena_.widthM - bx, by,
+                                 wrapAngle(kPi - bh));
+  received += rho * contribution(sx, sy, axis, bx, -by, -bh);
+  received +=
+      rho * contribution(sx, sy, axis, bx, 2.0f * arena_.depthM - by, -bh);
+
+  const float dutyScale = config_.beaconDuty / config_.referenceDuty;
+  return config_.beaconGain * dutyScale * received;
+}
+
+IrReading IrSensorModel::sample(const Pose &pose) {
+  IrReading reading;
+  for (uint8_t channel = 0; channel < IR_CHANNEL_COUNT; ++channel) {
+    const float value =
+        config_.darkOffset[channel] +
+        ambientScale_ * config_.ambient[channel] +
+        config_.channelGain[channel] *
+            expected(pose, static_cast<IrChannel>(channel)) +
+        noise_(rng_);
+    const float clamped =
+        std::min(std::max(value, 0.0f), static_cast<float>(config_.adcMax));
+    reading.raw[channel] = static_cast<uint32_t>(std::lround(clamped));
+  }
+  return reading;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "arena.h"
+
+#include <cstdint>
+#include <random>
+
+enum IrChannel : uint8_t { IR_CH_FRONT, IR_CH_BACK, IR_CH_LEFT, IR_CH_RIGHT };
+constexpr uint8_t IR_CHANNEL_COUNT = 4;
+
+// Phototransistor model: inverse-square falloff from the beacon and its
+// first-order wall images, cosine directivity on both ends, per-channel
+// ambient floor, Gaussian noise and a 12-bit ADC ceiling.
+struct IrSensorModelConfig {
+  // Front, back, left, right. Defaults are the 2nd percentile of each raw
+  // channel over evaluation/data (see `--calibrate`).
+  float ambient[IR_CHANNEL_COUNT] = {799.0f, 187.0f, 165.0f, 125.0f};
+  float noiseSigma = 14.7f;
+  // Counts * m^2 delivered on-axis at referenceDuty; fitted with the sensor
+  // 6 cm from the beacon when docked.
+  float beaconGain = 15.34f;
+  float beaconDuty = 256.0f;
+  float referenceDuty = 256.0f;
+  float softeningM = 0.02f;
+  float sensorOffsetM = 0.025f;
+  float sensorExponent = 1.5f;
+  float sensorScatter = 0.10f;
+  float beaconExponent = 1.0f;
+  float wallReflectivity = 0.20f;
+  // Channel mismatch: beacon sensitivity and a dark offset that does not
+  // scale with the room light. Matched channels by default.
+  float channelGain[IR_CHANNEL_COUNT] = {1.0f, 1.0f, 1.0f, 1.0f};
+  float darkOffset[IR_CHANNEL_COUNT] = {0.0f, 0.0f, 0.0f, 0.0f};
+  uint16_t adcMax = 4095;
+};
+
+struct IrReading {
+  uint32_t raw[IR_CHANNEL_COUNT] = {0, 0, 0, 0};
+};
+
+class IrSensorModel {
+public:
+  IrSensorModel(const IrSensorModelConfig &config, const ArenaConfig &arena,
+                std::mt19937 &rng);
+
+  IrReading sample(const Pose &pose);
+  // Noise-free beacon contribution (ambient excluded) for one channel.
+  float expected(const Pose &pose, IrChannel channel) const;
+
+  void setBeaconDuty(float duty);
+  // Scales the ambient floor, e.g. for room lights switched on or off.
+  void setAmbientScale(float scale);
+
+private:
+  float contribution(float sensorX, float sensorY, float sensorAxis,
+                     float sourceX, float sourceY, float sourceHeading) const;
+
+  IrSensorModelConfig config_;
+  ArenaConfig arena_;
+  std::mt19937 &rng_;
+  std::normal_distribution<float> noise_;
+  float ambientScale_ = 1.0f;
+};
@@ -0,0 +1,846 @@
+#include "beacon_recording.h"
+#include "detection_bench.h"
+#include "fleet_sim.h"
+#include "heading_bench.h"
+#include "heartbeat_bench.h"
+#include "monte_carlo.h"
+#include "multipath_bench.h"
+#include "navigation_config.h"
+#include "sensor_calibration.h"
+#include "spin_fit_bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr float RADIANS_TO_DEG = 57.29577951308232f;
+constexpr uint32_t HISTOGRAM_BINS = 12;
+constexpr float DETECTION_TRIAL_S = 120.0f;
+constexpr float SPIN_FIT_GAIN_SPREAD = 0.25f;
+constexpr float SPIN_FIT_MAX_DARK_OFFSET = 150.0f;
+// --heartbeat gives every this many slaves a bay, as --fleet 1 does for
+// its default 24.
+constexpr uint32_t SLAVES_PER_BAY = 24;
+
+struct Options {
+  uint32_t runs = 200;
+  uint64_t seed = 1;
+  unsigned threads = 0;
+  std::string runsCsv;
+  std::string tracePath;
+  uint32_t traceRun = 0;
+  std::vector<std::string> calibrateFiles;
+  float calibrationDistanceM = 0.06f;
+  bool detection = false;
+  std::vector<std::string> detectionFiles;
+  bool spinFit = false;
+  std::vector<std::string> spinFitFiles;
+  bool fleet = false;
+  std::vector<uint32_t> fleetBays = {1, 2, 3, 4};
+  FleetConfig fleetConfig;
+  bool fleetBattery = false;
+  bool heartbeat = false;
+  std::vector<uint32_t> heartbeatSlaves = {10, 50, 100};
+  bool headingStep = false;
+  bool multipath = false;
+  std::vector<std::string> multipathFiles;
+};
+
+void printUsage(const char *argv0) {
+  std::printf(
+      "usage: %s [options]\n"
+      "  --runs N              Monte Carlo runs (default 200)\n"
+      "  --seed N              base seed (default 1)\n"
+      "  --threads N           worker threads (default: all cores)\n"
+      "  --timeout-s S         per-run timeout (default 60)\n"
+      "  --runs-csv PATH       write one row per run\n"
+      "  --trace PATH          write a beacon_nav trace of one run\n"
+      "  --trace-run N         run index to trace (default 0)\n"
+      "  --ambient F,B,L,R     sensor ambient floor in counts\n"
+      "  --noise SIGMA         sensor noise in counts\n"
+      "  --gain G              beacon gain in counts*m^2\n"
+      "  --reflectivity R      wall reflectivity (0..1)\n"
+      "  --beacon-duty D       beacon duty cycle (/1023)\n"
+      "  --beacon-power        let the master adjust the beacon duty from\n"
+      "                        the slave's reports\n"
+      "  --mesh-latency-ms MS  one-way report/duty delay (default 30)\n"
+      "  --search flip|memory  beacon search strategy\n"
+      "  --signal-min S        tracker detection threshold\n"
+      "  --steering open|yaw_rate  turn from the bearing directly, or\n"
+      "                        through the gyro yaw rate loop (default)\n"
+      "  --motor-mismatch S    left/right motor gain spread (default 0.10)\n"
+      "  --drive-speed V       wheel speed at the top duty in m/s (default\n"
+      "                        0.06; lower for a flat battery)\n"
+      "  --stall-duty D        duty below which the wheels stall (default\n"
+      "                        3150)\n"
+      "  --gyro-bias R         gyro bias left uncorrected, rad/s\n"
+      "  --heading-step        steering response to a 45-135 deg bearing\n"
+      "                        step near the beacon (runs = trials), open\n"
+      "                        loop against the yaw rate loop\n"
+      "  --multipath [CSV...]  wall jitter against the tracker's multipath\n"
+      "                        checks, in the Monte Carlo and replayed\n"
+      "                        over recordings\n"
+      "  --calibrate CSV...    fit the sensor model to recordings and exit\n"
+      "  --calibration-distance M  docked sensor distance for --calibrate\n"
+      "  --detection [CSV...]  compare detection thresholds (runs = trials)\n"
+      "  --spin-fit [CSV...]   check the IR channel calibration fit (runs =\n"
+      "                        trials) and fit recordings as spins\n"
+      "  --fleet [K,K,...]     charging station throughput with K bays\n"
+      "                        (default 1,2,3,4)\n"
+      "  --robots N            fleet size for --fleet (default 24)\n"
+      "  --hours H             simulated time for --fleet (default 8)\n"
+      "  --work-s S            mean work time between charges (default 120)\n"
+      "  --abort-rate R        share of walks to the charger that give up\n"
+      "                        (default 0)\n"
+      "  --walk-spread P       predictive dispatch: walk estimate is the\n"
+      "                        mean + P%% of its deviation (default 100)\n"
+      "  --battery             with --fleet: the fixed charge against\n"
+      "                        ending it on the battery voltage\n"
+      "  --charge-target MV    battery charge target, 0 for the plateau\n"
+      "                        only (default 4150)\n"
+      "  --heartbeat [N,N,...] slave-to-master traffic and master ingest\n"
+      "                        with N slaves, per-event messages against\n"
+      "                        heartbeats (default 10,50,100)\n",
+      argv0);
+}
+
+bool parseFloatList(const char *text, float *out, size_t count) {
+  char *end = nullptr;
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = std::strtof(text, &end);
+    if (end == text) {
+      return false;
+    }
+    text = (*end == ',') ? end + 1 : end;
+  }
+  return *end == '\0';
+}
+
+bool parseCountList(const char *text, std::vector<uint32_t> &out) {
+  out.clear();
+  char *end = nullptr;
+  do {
+    const unsigned long value = std::strtoul(text, &end, 10);
+    if (end == text || value == 0) {
+      return false;
+    }
+    out.push_back(static_cast<uint32_t>(value));
+    text = (*end == ',') ? end + 1 : end;
+  } while (*end == ',');
+  return *end == '\0';
+}
+
+bool parseArgs(int argc, char **argv, Options &options,
+               SimulationConfig &config) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--help" || arg == "-h") {
+      return false;
+    } else if (arg == "--calibrate") {
+      while (i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0) {
+        options.calibrateFiles.push_back(argv[++i]);
+      }
+    } else if (arg == "--detection") {
+      options.detection = true;
+      while (i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0) {
+        options.detectionFiles.push_back(argv[++i]);
+      }
+    } else if (arg == "--fleet") {
+      options.fleet = true;
+      if (i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0 &&
+          !parseCountList(argv[++i], options.fleetBays)) {
+        std::fprintf(stderr, "--fleet expects comma-separated bay counts\n");
+        return false;
+      }
+    } else if (arg == "--heartbeat") {
+      options.heartbeat = true;
+      if (i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0 &&
+          !parseCountList(argv[++i], options.heartbeatSlaves)) {
+        std::fprintf(stderr, "--heartbeat expects comma-separated counts\n");
+        return false;
+      }
+    } else if (arg == "--beacon-power") {
+      config.beaconPower = true;
+    } else if (arg == "--heading-step") {
+      options.headingStep = true;
+    } else if (arg == "--battery") {
+      options.fleetBattery = true;
+    } else if (arg == "--multipath") {
+      options.multipath = true;
+      while (i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0) {
+        options.multipathFiles.push_back(argv[++i]);
+      }
+    } else if (arg == "--spin-fit") {
+      options.spinFit = true;
+      while (i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0) {
+        options.spinFitFiles.push_back(argv[++i]);
+      }
+    } else if (!hasValue) {
+      std::fprintf(stderr, "missing value for %s\n", arg.c_str());
+      return false;
+    } else if (arg == "--runs") {
+      options.runs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--seed") {
+      options.seed = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--threads") {
+      options.threads =
+          static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--timeout-s") {
+      config.timeoutMs =
+          static_cast<uint32_t>(std::strtof(argv[++i], nullptr) * 1000.0f);
+    } else if (arg == "--runs-csv") {
+      options.runsCsv = argv[++i];
+    } else if (arg == "--trace") {
+      options.tracePath = argv[++i];
+    } else if (arg == "--trace-run") {
+      options.traceRun =
+          static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--ambient") {
+      if (!parseFloatList(argv[++i], config.sensor.ambient, IR_CHANNEL_COUNT)) {
+        std::fprintf(stderr, "--ambient expects four comma-separated values\n");
+        return false;
+      }
+    } else if (arg == "--noise") {
+      config.sensor.noiseSigma = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--gain") {
+      config.sensor.beaconGain = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--reflectivity") {
+      config.sensor.wallReflectivity = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--beacon-duty") {
+      config.sensor.beaconDuty = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--mesh-latency-ms") {
+      config.meshLatencyMs =
+          static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--search") {
+      const std::string strategy = argv[++i];
+      if (strategy == "flip") {
+        config.navigator.searchStrategy = SearchStrategy::FLIP;
+      } else if (strategy == "memory") {
+        config.navigator.searchStrategy = SearchStrategy::SIGNAL_MEMORY;
+      } else {
+        std::fprintf(stderr, "--search expects flip or memory\n");
+        return false;
+      }
+    } else if (arg == "--signal-min") {
+      config.tracker.signalMin = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--steering") {
+      const std::string steering = argv[++i];
+      if (steering == "open") {
+        config.navigator.yawRateLoop = false;
+      } else if (steering == "yaw_rate") {
+        config.navigator.yawRateLoop = true;
+      } else {
+        std::fprintf(stderr, "--steering expects open or yaw_rate\n");
+        return false;
+      }
+    } else if (arg == "--motor-mismatch") {
+      config.drive.motorGainSpread = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--drive-speed") {
+      config.drive.speedAtReferenceMps = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--stall-duty") {
+      config.drive.stallDuty =
+          static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--gyro-bias") {
+      config.gyroBiasRadS = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--robots") {
+      options.fleetConfig.robots =
+          static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--hours") {
+      options.fleetConfig.hours = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--work-s") {
+      options.fleetConfig.workMeanS = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--abort-rate") {
+      options.fleetConfig.walkAbortRate = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--walk-spread") {
+      options.fleetConfig.walkSpreadPercent = static_cast<uint8_t>(
+          std::min<unsigned long>(std::strtoul(argv[++i], nullptr, 10), 255));
+    } else if (arg == "--charge-target") {
+      options.fleetConfig.charge.targetMv =
+          static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--calibration-distance") {
+      options.calibrationDistanceM = std::strtof(argv[++i], nullptr);
+    } else {
+      std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+int runCalibration(const Options &options, const SimulationConfig &config) {
+  std::vector<BeaconSample> samples;
+  for (const std::string &path : options.calibrateFiles) {
+    std::string error;
+    if (!loadBeaconRecording(path, samples, &error)) {
+      std::fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+  }
+
+  const SensorFit fit = fitSensorModel(samples, config.sensor,
+                                       options.calibrationDistanceM);
+  std::printf("samples=%zu saturated=%.1f%% peak_above_ambient=%.0f\n",
+              fit.samples, fit.saturatedFraction * 100.0f,
+              fit.peakAboveAmbient);
+  std::printf("--ambient %.0f,%.0f,%.0f,%.0f --noise %.1f --gain %.2f\n",
+              fit.model.ambient[IR_CH_FRONT], fit.model.ambient[IR_CH_BACK],
+              fit.model.ambient[IR_CH_LEFT], fit.model.ambient[IR_CH_RIGHT],
+              fit.model.noiseSigma, fit.model.beaconGain);
+  return 0;
+}
+
+// Fixed thresholds of the slave and the ir_meter against the adaptive floor
+// with the slave's settings.
+int runDetection(const Options &options, const SimulationConfig &config) {
+  struct Candidate {
+    const char *name;
+    BeaconTrackerConfig tracker;
+  };
+  const float fixedThresholds[] = {600.0f, 800.0f, 1500.0f};
+  std::vector<Candidate> candidates;
+  for (float threshold : fixedThresholds) {
+    Candidate candidate = {"", config.tracker};
+    candidate.tracker.detectionMode = DetectionMode::FIXED;
+    candidate.tracker.signalMin = threshold;
+    candidates.push_back(candidate);
+  }
+  candidates[0].name = "fixed_600";
+  candidates[1].name = "fixed_800";
+  candidates[2].name = "fixed_1500";
+  Candidate adaptive = {"adaptive", config.tracker};
+  adaptive.tracker.detectionMode = DetectionMode::ADAPTIVE_FLOOR;
+  candidates.push_back(adaptive);
+
+  std::vector<BeaconSample> recorded;
+  for (const std::string &path : options.detectionFiles) {
+    std::string error;
+    if (!loadBeaconRecording(path, recorded, &error)) {
+      std::fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+  }
+
+  std::printf("%u trials of %.0f s; beacon visible = on and >= %.0f counts\n",
+              options.runs, DETECTION_TRIAL_S, DETECTION_VISIBLE_COUNTS);
+  std::printf("%-10s %9s %9s %9s %9s %9s %11s\n", "threshold", "positives",
+              "negatives", "fn_rate", "strong_fn", "fp_rate", "recorded_fn");
+  for (const Candidate &candidate : candidates) {
+    const DetectionScore sim =
+        scoreDetectionScenarios(config, candidate.tracker, options.runs,
+                                DETECTION_TRIAL_S, options.seed);
+    std::printf("%-10s %9llu %9llu %8.2f%% %8.2f%% %8.2f%%", candidate.name,
+                static_cast<unsigned long long>(sim.positives),
+                static_cast<unsigned long long>(sim.negatives),
+                sim.falseNegativeRate() * 100.0f,
+                sim.strongFalseNegativeRate() * 100.0f,
+                sim.falsePositiveRate() * 100.0f);
+    if (recorded.empty()) {
+      std::printf(" %11s\n", "-");
+    } else {
+      const DetectionScore replay =
+          scoreDetectionRecording(recorded, candidate.tracker);
+      std::printf(" %10.2f%%\n", replay.falseNegativeRate() * 100.0f);
+    }
+  }
+  return 0;
+}
+
+float percentile(std::vector<float> values, float p) {
+  if (values.empty()) {
+    return 0.0f;
+  }
+  std::sort(values.begin(), values.end());
+  const size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5f);
+  return values[index];
+}
+
+void printStatusCounts(const char *name, const std::vector<uint32_t> &counts) {
+  std::printf("%s:", name);
+  for (size_t i = 0; i < counts.size(); ++i) {
+    if (counts[i] != 0) {
+      std::printf(" %s=%u",
+                  ir_calibration::fitStatusName(
+                      static_cast<ir_calibration::FitStatus>(i)),
+                  counts[i]);
+    }
+  }
+  std::printf("\n");
+}
+
+void printSpread(const char *name, const std::vector<float> &values) {
+  std::printf("%-24s p50=%7.3f p90=%7.3f max=%7.3f\n", name,
+              percentile(values, 0.5f), percentile(values, 0.9f),
+              percentile(values, 1.0f));
+}
+
+// Calibration fit against known channel mismatch, then every recording fed
+// to the spin fit as if it were a spin.
+int runSpinFit(const Options &options, const SimulationConfig &config) {
+  const SpinFitSummary summary =
+      runSpinFitTrials(config, options.runs, SPIN_FIT_GAIN_SPREAD,
+                       SPIN_FIT_MAX_DARK_OFFSET, options.seed);
+  std::printf("%u trials; channel gains 1 +- %.2f, dark offsets 0-%.0f\n",
+              summary.trials, SPIN_FIT_GAIN_SPREAD, SPIN_FIT_MAX_DARK_OFFSET);
+  printStatusCounts("dark", summary.darkStatus);
+  printStatusCounts("spin", summary.spinStatus);
+  printStatusCounts("ambient", summary.ambientStatus);
+  printSpread("gain_error", summary.gainErrors);
+  printSpread("offset_error_counts", summary.offsetErrors);
+  printSpread("bearing_rms_deg_uncal", summary.bearingUncalibratedDeg);
+  printSpread("bearing_rms_deg_fitted", summary.bearingFittedDeg);
+  printSpread("bearing_rms_deg_ideal", summary.bearingIdealDeg);
+
+  if (!options.spinFitFiles.empty()) {
+    std::printf("\n%-12s %7s %-16s %23s %23s\n", "recording", "samples",
+                "status", "peak f/b/l/r", "dominant f/b/l/r");
+  }
+  for (const std::string &path : options.spinFitFiles) {
+    std::vector<BeaconSample> samples;
+    std::string error;
+    if (!loadBeaconRecording(path, samples, &error)) {
+      std::fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    ir_calibration::SpinCapture capture;
+    ir_calibration::Calibration fit;
+    const ir_calibration::FitStatus status =
+        fitRecordedSpin(samples, capture, fit);
+    const size_t slash = path.find_last_of('/');
+    const std::string name =
+        slash == std::string::npos ? path : path.substr(slash + 1);
+    std::printf("%-12s %7zu %-16s %5.0f/%5.0f/%5.0f/%5.0f "
+                "%5.2f/%5.2f/%5.2f/%5.2f\n",
+                name.c_str(), samples.size(),
+                ir_calibration::fitStatusName(status), capture.peak(0),
+                capture.peak(1), capture.peak(2), capture.peak(3),
+                capture.dominantShare(0), capture.dominantShare(1),
+                capture.dominantShare(2), capture.dominantShare(3));
+  }
+  return 0;
+}
+
+// Station throughput for each bay count, on the same fleet and seed, with
+// the bay cycle run in sequence, pipelined, and pipelined with predictive
+// dispatch.
+int runFleet(const Options &options) {
+  const FleetConfig &base = options.fleetConfig;
+  std::printf("%u robots, %.1f h, work %.0f s mean, charge %.0f s, "
+              "%.0f%% of walks abort\n",
+              base.robots, base.hours, base.workMeanS, base.chargeS,
+              base.walkAbortRate * 100.0f);
+  std::printf("%4s %-10s %8s %9s %8s %8s %13s %17s %15s %13s\n", "bays",
+              "cycle", "charges", "charges/h", "scaling", "util",
+              "queue p50/p90", "turnaround p50/p90", "handover p50/p90",
+              "wait p50/p90");
+  float single = 0.0f;
+  for (uint32_t bays : options.fleetBays) {
+    for (int mode = 0; mode < 3; ++mode) {
+      static const char *const MODES[] = {"sequential", "pipelined",
+                                          "predictive"};
+      FleetConfig config = base;
+      config.bays = static_cast<uint8_t>(
+          std::min<uint32_t>(bays, station::MAX_BAYS));
+      config.pipelined = mode >= 1;
+      config.predictive = mode == 2;
+      const FleetResult result = simulateFleet(config, options.seed);
+      if (single == 0.0f) {
+        single = result.chargesPerHour / static_cast<float>(result.bays);
+      }
+      std::printf("%4u %-10s %8u %9.1f %7.2fx %7.1f%% %6.0f/%4.0f s "
+                  "%8.1f/%5.1f s %6.1f/%5.1f s %5.1f/%5.1f s\n",
+                  static_cast<unsigned>(result.bays), MODES[mode],
+                  result.charges,
+                  result.chargesPerHour,
+                  single > 0.0f ? result.chargesPerHour / single : 0.0f,
+                  result.chargeUtilization * 100.0f, result.queueP50S,
+                  result.queueP90S, result.turnaroundP50S,
+                  result.turnaroundP90S, result.handoverP50S,
+                  result.handoverP90S, result.waitP50S, result.waitP90S);
+      if (result.droppedActions > 0) {
+        std::printf("     dropped station actions: %u\n",
+                    result.droppedActions);
+      }
+    }
+  }
+  return 0;
+}
+
+// The fixed charge against charge_control on the battery model, for each
+// bay count and cycle, on the same fleet and seed. Predictive also runs
+// without the slaves' charge estimates, on the learned mean charge time.
+int runFleetBattery(const Options &options) {
+  const FleetConfig &base = options.fleetConfig;
+  std::printf("%u robots, %.1f h, work %.0f s mean, fixed charge %.0f s, "
+              "target %u mV, plateau %u mV/%lu s\n",
+              base.robots, base.hours, base.workMeanS, base.chargeS,
+              static_cast<unsigned>(base.charge.targetMv),
+              static_cast<unsigned>(base.charge.plateauRiseMv),
+              static_cast<unsigned long>(base.charge.plateauWindowMs / 1000));
+  std::printf("%4s %-10s %-11s %9s %7s %6s %17s %12s %13s %6s\n", "bays",
+              "cycle", "charge", "charges/h", "fills/h", "util",
+              "charge p50/p90", "soc in/out", "queue p50/p90", "flat");
+  struct Variant {
+    const char *name;
+    bool battery;
+    bool estimates;
+  };
+  static const Variant VARIANTS[] = {{"fixed", false, false},
+                                     {"battery", true, true},
+                                     {"battery,mean", true, false}};
+  static const char *const MODES[] = {"sequential", "pipelined",
+                                      "predictive"};
+  for (uint32_t bays : options.fleetBays) {
+    for (int mode = 0; mode < 3; ++mode) {
+      for (const Variant &variant : VARIANTS) {
+        // The estimates only matter to predictive dispatch.
+        if (variant.battery && !variant.estimates && mode != 2) {
+          continue;
+        }
+        FleetConfig config = base;
+        config.bays = static_cast<uint8_t>(
+            std::min<uint32_t>(bays, station::MAX_BAYS));
+        config.pipelined = mode >= 1;
+        config.predictive = mode == 2;
+        config.batteryCharge = variant.battery;
+        config.chargeEstimates = variant.estimates;
+        const FleetResult result = simulateFleet(config, options.seed);
+        std::printf("%4u %-10s %-11s %9.1f %7.1f %5.1f%% %7.1f/%5.1f s "
+                    "%4.0f/%3.0f%% %6.0f/%4.0f s %5.1f%%\n",
+                    static_cast<unsigned>(result.bays), MODES[mode],
+                    variant.name, result.chargesPerHour, result.fillsPerHour,
+                    result.chargeUtilization * 100.0f, result.chargeP50S,
+                    result.chargeP90S, result.socInP50 * 100.0f,
+                    result.socOutP50 * 100.0f, result.queueP50S,
+                    result.queueP90S, result.flatShare * 100.0f);
+      }
+    }
+  }
+  return 0;
+}
+
+// Both steering modes on the same start poses.
+int runHeadingStep(const Options &options, const SimulationConfig &config) {
+  std::printf("%u trials; bearing step 45-135 deg at 18-28 cm, drive at "
+              "%.3f m/s, stall duty %u\n",
+              options.runs, config.drive.speedAtReferenceMps,
+              static_cast<unsigned>(config.drive.stallDuty));
+  std::printf("%-9s %7s %7s %15s %15s %15s\n", "steering", "arrived",
+              "settled", "settle p50/p90", "arrival p50/p90", "path mean/p10");
+  const bool loops[] = {false, true};
+  for (bool loop : loops) {
+    SimulationConfig variant = config;
+    variant.navigator.yawRateLoop = loop;
+    const HeadingStepSummary summary =
+        runHeadingSteps(variant, options.runs, options.seed);
+    std::printf("%-9s %7u %7u %6.2f / %5.2f s %6.2f / %5.2f s %6.2f / %5.2f\n",
+                loop ? "yaw_rate" : "open", summary.arrived, summary.settled,
+                summary.settleP50S, summary.settleP90S, summary.arrivalP50S, summary.arrivalP90S,
+                summary.pathEfficiencyMean, summary.pathEfficiencyP10);
+  }
+  return 0;
+}
+
+// The wall jitter with and without the multipath checks, on the same start
+// poses, and the same variants replayed over the recordings.
+int runMultipath(const Options &options, const SimulationConfig &config) {
+  static const MultipathVariant VARIANTS[] = {
+      {"jitter", false, 1.0f},
+      {"off", false, -1.0f},
+      {"checks", true, -1.0f},
+      {"checks,jitter", true, navigation_config::WALL_JITTER_MAX_CONFIDENCE},
+  };
+  std::vector<std::vector<BeaconSample>> recordings;
+  for (const std::string &path : options.multipathFiles) {
+    std::vector<BeaconSample> samples;
+    std::string error;
+    if (!loadBeaconRecording(path, samples, &error)) {
+      std::fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    recordings.push_back(samples);
+  }
+  const unsigned threads = options.threads != 0
+                               ? options.threads
+                               : std::max(1U, std::thread::hardware_concurrency());
+
+  std::printf("%u runs, wall reflectivity %.2f\n", options.runs,
+              config.sensor.wallReflectivity);
+  std::printf("%-13s %8s %15s %15s %15s %17s %20s\n", "variant", "success",
+              "docking p50/p90", "jitter p50/p90", "held p50/p90",
+              "bearing p50/p90", "replay jitter/held");
+  for (const MultipathVariant &variant : VARIANTS) {
+    const SimulationConfig variantConfig =
+        applyMultipathVariant(config, variant);
+    const MultipathSummary sim =
+        runMultipathTrials(variantConfig, options.runs, options.seed, threads);
+    std::printf("%-13s %7.1f%% %6.2f/%5.2f s %6.2f/%5.2f s %6.2f/%5.2f s "
+                "%6.1f/%5.1f deg",
+                variant.name, sim.outcome.successRate * 100.0f,
+                sim.outcome.dockingP50S, sim.outcome.dockingP90S,
+                sim.wallJitterP50S, sim.wallJitterP90S, sim.reflectedP50S,
+                sim.reflectedP90S, sim.bearingRmsP50Rad * RADIANS_TO_DEG,
+                sim.bearingRmsP90Rad * RADIANS_TO_DEG);
+    if (recordings.empty()) {
+      std::printf(" %20s\n", "-");
+      continue;
+    }
+    uint32_t samples = 0;
+    uint32_t jitter = 0;
+    uint32_t held = 0;
+    for (const std::vector<BeaconSample> &recording : recordings) {
+      const MultipathReplay replay = replayMultipath(recording, variantConfig);
+      samples += replay.samples;
+      jitter += replay.wallJitter;
+      held += replay.reflected;
+    }
+    const float scale = samples > 0 ? 100.0f / static_cast<float>(samples)
+                                    : 0.0f;
+    std::printf(" %8.1f%% / %6.1f%%\n", static_cast<float>(jitter) * scale,
+                static_cast<float>(held) * scale);
+  }
+
+  if (!recordings.empty()) {
+    std::printf("\n%-12s %7s %9s %9s %9s\n", "recording", "samples",
+                "jitter", "held", "conf p10/p50");
+    const MultipathVariant &checks = VARIANTS[3];
+    const SimulationConfig checksConfig = applyMultipathVariant(config, checks);
+    for (size_t i = 0; i < recordings.size(); ++i) {
+      const MultipathReplay plain =
+          replayMultipath(recordings[i], applyMultipathVariant(config,
+                                                               VARIANTS[0]));
+      const MultipathReplay replay =
+          replayMultipath(recordings[i], checksConfig);
+      const std::string &path = options.multipathFiles[i];
+      const size_t slash = path.find_last_of('/');
+      const std::string name =
+          slash == std::string::npos ? path : path.substr(slash + 1);
+      const float scale =
+          replay.samples > 0 ? 100.0f / static_cast<float>(replay.samples)
+                             : 0.0f;
+      std::printf("%-12s %7u %3.0f->%3.0f%% %8.1f%% %5.2f/%4.2f\n",
+                  name.c_str(), replay.samples,
+                  static_cast<float>(plain.wallJitter) * scale,
+                  static_cast<float>(replay.wallJitter) * scale,
+                  static_cast<float>(replay.reflected) * scale,
+                  replay.confidenceP10, replay.confidenceP50);
+    }
+  }
+  return 0;
+}
+
+// Mesh messages and master ingest time of the same fleet, with and without
+// heartbeats; one bay per SLAVES_PER_BAY slaves.
+int runHeartbeat(const Options &options) {
+  const HeartbeatBenchConfig bench;
+  std::printf("%.1f h, work %.0f s mean; per-event -> heartbeat\n",
+              options.fleetConfig.hours, options.fleetConfig.workMeanS);
+  std::printf("%6s %4s %17s %15s %15s %17s %15s\n", "slaves", "bays",
+              "msgs/s", "peak msgs/s", "bytes/s", "ingest ns/msg",
+              "ingest us/s");
+  for (uint32_t slaves : options.heartbeatSlaves) {
+    FleetConfig fleet = options.fleetConfig;
+    fleet.robots = slaves;
+    fleet.bays = static_cast<uint8_t>(std::min<uint32_t>(
+        (slaves + SLAVES_PER_BAY - 1) / SLAVES_PER_BAY, station::MAX_BAYS));
+    const HeartbeatBenchResult result =
+        benchHeartbeats(fleet, bench, options.seed);
+    const ChannelTraffic &before = result.perEvent;
+    const ChannelTraffic &after = result.heartbeat;
+    const double seconds = static_cast<double>(fleet.hours) * 3600.0;
+    std::printf("%6u %4u %7.1f -> %6.1f %6u -> %5u %6.0f -> %5.0f %7.0f -> "
+                "%6.0f %6.1f -> %5.1f\n",
+                result.slaves, static_cast<unsigned>(result.bays),
+                before.perSecond, after.perSecond, before.peakPerSecond,
+                after.peakPerSecond,
+                static_cast<double>(before.bytes) / seconds,
+                static_cast<double>(after.bytes) / seconds,
+                before.ingestNsPerMessage, after.ingestNsPerMessage,
+                before.ingestUsPerSecond, after.ingestUsPerSecond);
+    std::printf("       %u charges, %llu urgent heartbeats (%.1f%%)\n",
+                result.charges,
+                static_cast<unsigned long long>(result.urgentHeartbeats),
+                after.messages > 0
+                    ? 100.0 * static_cast<double>(result.urgentHeartbeats) /
+                          static_cast<double>(after.messages)
+                    : 0.0);
+  }
+  return 0;
+}
+
+bool writeTrace(const Options &options, const SimulationConfig &config) {
+  FILE *out = std::fopen(options.tracePath.c_str(), "w");
+  if (out == nullptr) {
+    std::fprintf(stderr, "cannot write %s\n", options.tracePath.c_str());
+    return false;
+  }
+
+  std::fprintf(out, "t_ms,mode,raw_f,raw_b,raw_l,raw_r,A_F,A_B,A_L,A_R,"
+                    "theta_deg,S,detected,duty_l,duty_r,x_m,y_m,heading_deg,"
+                    "beacon_duty\n");
+  const RunResult result = simulateRun(
+      config, options.traceRun, options.seed, [out](const TickTrace &tick) {
+        const BeaconTrackerState &s = tick.state;
+        std::fprintf(
+            out,
+            "%lu,%s,%lu,%lu,%lu,%lu,%.1f,%.1f,%.1f,%.1f,%.2f,%.1f,%u,%u,%u,"
+            "%.4f,%.4f,%.2f,%u\n",
+            static_cast<unsigned long>(s.timestampMs),
+            tick.searchMode ? "search" : "track",
+            static_cast<unsigned long>(s.rawFront),
+            static_cast<unsigned long>(s.rawBack),
+            static_cast<unsigned long>(s.rawLeft),
+            static_cast<unsigned long>(s.rawRight), s.front, s.back, s.left,
+            s.right, s.filteredTheta * RADIANS_TO_DEG, s.totalSignal,
+            static_cast<unsigned>(s.detected ? 1 : 0),
+            static_cast<unsigned>(tick.leftDuty),
+            static_cast<unsigned>(tick.rightDuty), tick.pose.x, tick.pose.y,
+            tick.pose.heading * RADIANS_TO_DEG,
+            static_cast<unsigned>(tick.beaconDuty));
+      });
+  std::fclose(out);
+  std::printf("trace run %u: %s after %.2f s\n", result.index,
+              outcomeName(result.outcome),
+              static_cast<float>(result.timeMs) * 0.001f);
+  return true;
+}
+
+bool writeRunsCsv(const std::string &path,
+                  const std::vector<RunResult> &results) {
+  FILE *out = std::fopen(path.c_str(), "w");
+  if (out == nullptr) {
+    std::fprintf(stderr, "cannot write %s\n", path.c_str());
+    return false;
+  }
+  std::fprintf(out, "run,start_x_m,start_y_m,start_heading_deg,outcome,"
+                    "time_ms,final_distance_m,search_ms,saturated_ms,"
+                    "heading_held_ms,docking_ms,min_beacon_duty,"
+                    "heading_settle_ms,path_m,wall_jitter_ms,reflected_ms\n");
+  for (const RunResult &r : results) {
+    char settle[12] = "";
+    if (r.headingSettled) {
+      std::snprintf(settle, sizeof(settle), "%u", r.headingSettleMs);
+    }
+    std::fprintf(out,
+                 "%u,%.4f,%.4f,%.2f,%s,%u,%.4f,%u,%u,%u,%u,%u,%s,%.4f,%u,%u\n",
+                 r.index, r.start.x, r.start.y,
+                 r.start.heading * RADIANS_TO_DEG, outcomeName(r.outcome),
+                 r.timeMs, r.finalDistanceM, r.searchMs, r.saturatedMs,
+                 r.headingHeldMs, r.dockingMs,
+                 static_cast<unsigned>(r.minBeaconDuty), settle, r.pathM,
+                 r.wallJitterMs, r.reflectedMs);
+  }
+  std::fclose(out);
+  return true;
+}
+
+void printHistogram(const std::vector<RunResult> &results,
+                    const OutcomeSummary &summary) {
+  if (summary.arrived == 0) {
+    return;
+  }
+  const float binWidth =
+      std::max(1.0f, summary.maxS / static_cast<float>(HISTOGRAM_BINS));
+  uint32_t bins[HISTOGRAM_BINS] = {};
+  uint32_t tallest = 1;
+  for (const RunResult &r : results) {
+    if (r.outcome != RunOutcome::ARRIVED) {
+      continue;
+    }
+    uint32_t bin = static_cast<uint32_t>(static_cast<float>(r.timeMs) *
+                                         0.001f / binWidth);
+    bin = std::min(bin, HISTOGRAM_BINS - 1);
+    bins[bin]++;
+    tallest = std::max(tallest, bins[bin]);
+  }
+
+  std::printf("time-to-arrival histogram (s):\n");
+  for (uint32_t i = 0; i < HISTOGRAM_BINS; ++i) {
+    const uint32_t bar = bins[i] * 40U / tallest;
+    std::printf("  %5.1f-%5.1f %5u %s\n", binWidth * static_cast<float>(i),
+                binWidth * static_cast<float>(i + 1), bins[i],
+                std::string(bar, '#').c_str());
+  }
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  SimulationConfig config;
+  config.navigator = navigation_config::navigatorConfig();
+  // The firmware ships with the loop off until it is measured on hardware;
+  // the simulator evaluates it.
+  config.navigator.yawRateLoop = true;
+  config.tracker = navigation_config::trackerConfig();
+
+  Options options;
+  if (!parseArgs(argc, argv, options, config)) {
+    printUsage(argv[0]);
+    return 2;
+  }
+
+  if (!options.calibrateFiles.empty()) {
+    return runCalibration(options, config);
+  }
+  if (options.detection) {
+    return runDetection(options, config);
+  }
+  if (options.spinFit) {
+    return runSpinFit(options, config);
+  }
+  if (options.fleet) {
+    return options.fleetBattery ? runFleetBattery(options)
+                                : runFleet(options);
+  }
+  if (options.heartbeat) {
+    return runHeartbeat(options);
+  }
+  if (options.headingStep) {
+    return runHeadingStep(options, config);
+  }
+  if (options.multipath) {
+    return runMultipath(options, config);
+  }
+
+  if (!options.tracePath.empty() && !writeTrace(options, config)) {
+    return 1;
+  }
+
+  const unsigned threads = options.threads != 0
+                               ? options.threads
+                               : std::max(1U, std::thread::hardware_concurrency());
+  const std::vector<RunResult> results =
+      runMonteCarlo(config, options.runs, options.seed, threads);
+  const OutcomeSummary summary = summarize(results);
+
+  std::printf("runs=%u arrived=%u false_arrival=%u timeout=%u "
+              "success_rate=%.1f%%\n",
+              summary.runs, summary.arrived, summary.falseArrivals,
+              summary.timeouts, summary.successRate * 100.0f);
+  std::printf("time_to_arrival_s mean=%.2f p50=%.2f p90=%.2f p99=%.2f "
+              "max=%.2f\n",
+              summary.meanS, summary.p50S, summary.p90S, summary.p99S,
+              summary.maxS);
+  std::printf("reacquire_s episodes=%u unresolved=%u p50=%.2f p90=%.2f "
+              "max=%.2f\n",
+              summary.searchEpisodes, summary.unresolvedSearches,
+              summary.reacquireP50S, summary.reacquireP90S,
+              summary.reacquireMaxS);
+  std::printf("docking_s p50=%.2f p90=%.2f saturated_s p50=%.2f p90=%.2f "
+              "heading_held_s p50=%.2f p90=%.2f\n",
+              summary.dockingP50S, summary.dockingP90S, summary.saturatedP50S,
+              summary.saturatedP90S, summary.headingHeldP50S,
+              summary.headingHeldP90S);
+  std::printf("path_efficiency mean=%.2f p10=%.2f\n",
+              summary.pathEfficiencyMean, summary.pathEfficiencyP10);
+  printHistogram(results, summary);
+
+  if (!options.runsCsv.empty() && !writeRunsCsv(options.runsCsv, results)) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,351 @@
+#include "monte_carlo.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <random>
+#include <thread>
+
+namespace {
+class SimDrive final : public DriveOutput {
+public:
+  explicit SimDrive(DriveModel &model) : model_(model) {}
+  void setLeftDuty(uint16_t duty) override { model_.setLeftDuty(duty); }
+  void setRightDuty(uint16_t duty) override { model_.setRightDuty(duty); }
+  void stop() override { model_.stop(); }
+
+private:
+  DriveModel &model_;
+};
+
+Pose randomStartPose(const ArenaConfig &arena, std::mt19937 &rng) {
+  const float margin = arena.robotRadiusM;
+  std::uniform_real_distribution<float> x(margin, arena.widthM - margin);
+  std::uniform_real_distribution<float> y(margin, arena.depthM - margin);
+  std::uniform_real_distribution<float> heading(-kPi, kPi);
+
+  Pose pose;
+  do {
+    pose.x = x(rng);
+    pose.y = y(rng);
+  } while (distanceToBeacon(arena, pose) < arena.minStartDistanceM);
+  pose.heading = heading(rng);
+  return pose;
+}
+
+// Bearing of the beacon from the robot's axis, counter-clockwise positive,
+// as the tracker's theta.
+float trueBearing(const ArenaConfig &arena, const Pose &pose) {
+  return wrapAngle(std::atan2(arena.beaconY - pose.y, arena.beaconX - pose.x) -
+                   pose.heading);
+}
+
+float rmsOf(double sumSq, uint32_t count) {
+  return count > 0 ? static_cast<float>(
+                         std::sqrt(sumSq / static_cast<double>(count)))
+                   : 0.0f;
+}
+
+template <typename T> struct InFlight {
+  uint32_t arrivesAtMs;
+  T message;
+};
+
+// The master end of the beacon power loop plus the mesh in between: reports
+// and duty broadcasts arrive meshLatencyMs after they are sent.
+class BeaconPowerLink {
+public:
+  explicit BeaconPowerLink(const SimulationConfig &config)
+      : config_(config), controller_(config.beaconPowerConfig),
+        window_(config.reportPeriodMs, 40, config.reportSlowPeriodMs,
+                config.reportFastSignal),
+        appliedDuty_(config.beaconPower
+                         ? controller_.duty()
+                         : static_cast<uint16_t>(config.sensor.beaconDuty)),
+        advertisedDuty_(appliedDuty_) {}
+
+  uint16_t appliedDuty() const { return appliedDuty_; }
+
+  // Called every control tick after the tracker update.
+  void tick(const BeaconTrackerState &state, uint32_t nowMs,
+            IrSensorModel &sensor, BeaconNavigator &navigator) {
+    if (!config_.beaconPower) {
+      return;
+    }
+    if (window_.add(state.beaconSignal, state.saturated, nowMs)) {
+      reports_.push_back(
+          {nowMs + config_.meshLatencyMs, window_.take(1, advertisedDuty_)});
+    }
+    while (!reports_.empty() && reports_.front().arrivesAtMs <= nowMs) {
+      if (controller_.onReport(reports_.front().message, nowMs)) {
+        appliedDuty_ = controller_.duty();
+        sensor.setBeaconDuty(appliedDuty_);
+        duties_.push_back({nowMs + config_.meshLatencyMs, appliedDuty_});
+      }
+      reports_.pop_front();
+    }
+    while (!duties_.empty() && duties_.front().arrivesAtMs <= nowMs) {
+      advertisedDuty_ = duties_.front().message;
+      navigator.setBeaconDuty(advertisedDuty_);
+      duties_.pop_front();
+    }
+  }
+
+private:
+  const SimulationConfig &config_;
+  beacon_power::BeaconPowerController controller_;
+  beacon_power::ReportWindow window_;
+  std::deque<InFlight<beacon_power::BeaconReport>> reports_;
+  std::deque<InFlight<uint16_t>> duties_;
+  uint16_t appliedDuty_;
+  uint16_t advertisedDuty_;
+};
+
+float percentileOf(const std::vector<float> &sorted, float fraction) {
+  if (sorted.empty()) {
+    return 0.0f;
+  }
+  const size_t rank = static_cast<size_t>(
+      std::ceil(fraction * static_cast<float>(sorted.size())) - 1.0f);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+} // namespace
+
+RunResult simulateRun(const SimulationConfig &config, uint32_t index,
+                      uint64_t seed, const TraceCallback &trace,
+                      const Pose *start) {
+  std::seed_seq seq{static_cast<uint32_t>(seed),
+                    static_cast<uint32_t>(seed >> 32), index};
+  std::mt19937 rng(seq);
+
+  RunResult result;
+  result.index = index;
+  result.start =
+      start != nullptr ? *start : randomStartPose(config.arena, rng);
+  result.startDistanceM = distanceToBeacon(config.arena, result.start);
+
+  DriveModel drive(config.drive, config.arena, rng);
+  drive.setPose(result.start);
+  IrSensorModel sensor(config.sensor, config.arena, rng);
+  SimDrive output(drive);
+  BeaconNavigator navigator(&output, config.navigator, config.tracker);
+  BeaconPowerLink beaconPower(config);
+  sensor.setBeaconDuty(beaconPower.appliedDuty());
+  navigator.setBeaconDuty(beaconPower.appliedDuty());
+  result.minBeaconDuty = beaconPower.appliedDuty();
+  bool docking = false;
+  uint32_t dockingStartedAtMs = 0;
+  double bearingErrorSq = 0.0;
+  uint32_t bearingTicks = 0;
+
+  const uint32_t stepUs =
+      static_cast<uint32_t>(std::lround(config.physicsStepMs * 1000.0f));
+  uint64_t nowUs = 0;
+  uint32_t lastTickMs = 0;
+  uint32_t searchStartedAtMs = 0;
+  bool searching = false;
+  std::normal_distribution<float> gyroNoise(0.0f, config.gyroNoiseRadS);
+  HeadingSettle heading(HEADING_SETTLE_RAD, HEADING_SETTLE_HOLD_MS);
+  navigator.begin(0);
+
+  while (nowUs <= static_cast<uint64_t>(config.timeoutMs) * 1000U) {
+    const uint32_t nowMs = static_cast<uint32_t>(nowUs / 1000U);
+    if (navigator.shouldRunYawRate(nowMs)) {
+      navigator.updateYawRate(
+          drive.yawRate() + config.gyroBiasRadS + gyroNoise(rng), nowMs);
+    }
+    if (navigator.shouldRunControl(nowMs)) {
+      const IrReading reading = sensor.sample(drive.pose());
+      const bool arrived =
+          navigator.update(reading.raw[IR_CH_FRONT], reading.raw[IR_CH_BACK],
+                           reading.raw[IR_CH_LEFT], reading.raw[IR_CH_RIGHT],
+                           nowMs);
+      const BeaconTrackerState &state = navigator.state();
+      const uint32_t tickMs = nowMs - lastTickMs;
+      result.saturatedMs += state.saturated ? tickMs : 0;
+      result.headingHeldMs += state.headingHeld ? tickMs : 0;
+      result.wallJitterMs += navigator.wallJitterActive() ? tickMs : 0;
+      result.reflectedMs += state.reflected ? tickMs : 0;
+      if (!docking && distanceToBeacon(config.arena, drive.pose()) <=
+                          DOCKING_RADIUS_M) {
+        docking = true;
+        dockingStartedAtMs = nowMs;
+      }
+      if (docking && state.detected) {
+        const float error =
+            wrapAngle(state.filteredTheta - trueBearing(config.arena,
+                                                        drive.pose()));
+        bearingErrorSq += static_cast<double>(error) * error;
+        bearingTicks++;
+      }
+      heading.add(state.detected, state.filteredTheta, nowMs);
+      beaconPower.tick(state, nowMs, sensor, navigator);
+      result.minBeaconDuty =
+          std::min(result.minBeaconDuty, beaconPower.appliedDuty());
+      if (navigator.searchMode()) {
+        result.searchMs += tickMs;
+        if (!searching) {
+          searchStartedAtMs = nowMs;
+        }
+      } else if (searching) {
+        result.reacquireMs.push_back(nowMs - searchStartedAtMs);
+      }
+      searching = navigator.searchMode();
+      lastTickMs = nowMs;
+      if (trace) {
+        trace(TickTrace{navigator.state(), drive.pose(),
+                        navigator.searchMode(), navigator.leftDuty(),
+                        navigator.rightDuty(), beaconPower.appliedDuty()});
+      }
+
+      if (arrived) {
+        result.dockingBearingRmsRad = rmsOf(bearingErrorSq, bearingTicks);
+        navigator.reset();
+        heading.finish();
+        result.headingSettled = heading.settled();
+        result.headingSettleMs = heading.settleMs();
+        result.timeMs = nowMs;
+        result.dockingMs = docking ? nowMs - dockingStartedAtMs : 0;
+        result.finalDistanceM = distanceToBeacon(config.arena, drive.pose());
+        result.outcome = result.finalDistanceM <= config.arena.arrivalRadiusM
+                             ? RunOutcome::ARRIVED
+                             : RunOutcome::FALSE_ARRIVAL;
+        return result;
+      }
+    }
+
+    const Pose before = drive.pose();
+    drive.step(config.physicsStepMs);
+    result.pathM +=
+        std::hypot(drive.pose().x - before.x, drive.pose().y - before.y);
+    nowUs += stepUs;
+  }
+
+  result.dockingBearingRmsRad = rmsOf(bearingErrorSq, bearingTicks);
+  result.unresolvedSearches = searching ? 1U : 0U;
+  result.headingSettled = heading.settled();
+  result.headingSettleMs = heading.settleMs();
+  result.timeMs = config.timeoutMs;
+  result.dockingMs = docking ? config.timeoutMs - dockingStartedAtMs : 0;
+  result.finalDistanceM = distanceToBeacon(config.arena, drive.pose());
+  result.outcome = RunOutcome::TIMEOUT;
+  return result;
+}
+
+std::vector<RunResult> runMonteCarlo(const SimulationConfig &config,
+                                     uint32_t runs, uint64_t seed,
+                                     unsigned threads) {
+  std::vector<RunResult> results(runs);
+  std::atomic<uint32_t> next(0);
+
+  auto worker = [&]() {
+    for (uint32_t i = next.fetch_add(1); i < runs; i = next.fetch_add(1)) {
+      results[i] = simulateRun(config, i, seed);
+    }
+  };
+
+  threads = std::max(1U, std::min(threads, runs));
+  std::vector<std::thread> pool;
+  pool.reserve(threads);
+  for (unsigned t = 0; t < threads; ++t) {
+    pool.emplace_back(worker);
+  }
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+  return results;
+}
+
+OutcomeSummary summarize(const std::vector<RunResult> &results) {
+  OutcomeSummary summary;
+  summary.runs = static_cast<uint32_t>(results.size());
+
+  std::vector<float> times;
+  std::vector<float> reacquire;
+  std::vector<float> docking;
+  std::vector<float> saturated;
+  std::vector<float> headingHeld;
+  std::vector<float> efficiency;
+  times.reserve(results.size());
+  double sum = 0.0;
+  for (const RunResult &result : results) {
+    for (uint32_t ms : result.reacquireMs) {
+      reacquire.push_back(static_cast<float>(ms) * 0.001f);
+    }
+    summary.unresolvedSearches += result.unresolvedSearches;
+    switch (result.outcome) {
+    case RunOutcome::ARRIVED:
+      summary.arrived++;
+      times.push_back(static_cast<float>(result.timeMs) * 0.001f);
+      sum += times.back();
+      docking.push_back(static_cast<float>(result.dockingMs) * 0.001f);
+      saturated.push_back(static_cast<float>(result.saturatedMs) * 0.001f);
+      headingHeld.push_back(static_cast<float>(result.headingHeldMs) * 0.001f);
+      if (result.pathM > 0.0f) {
+        efficiency.push_back(
+            (result.startDistanceM - result.finalDistanceM) /
+            result.pathM);
+      }
+      break;
+    case RunOutcome::FALSE_ARRIVAL:
+      summary.falseArrivals++;
+      break;
+    case RunOutcome::TIMEOUT:
+      summary.timeouts++;
+      break;
+    }
+  }
+
+  if (summary.runs > 0) {
+    summary.successRate = static_cast<float>(summary.arrived) /
+                          static_cast<float>(summary.runs);
+  }
+  if (!times.empty()) {
+    std::sort(times.begin(), times.end());
+    summary.meanS = static_cast<float>(sum / static_cast<double>(times.size()));
+    summary.p50S = percentileOf(times, 0.50f);
+    summary.p90S = percentileOf(times, 0.90f);
+    summary.p99S = percentileOf(times, 0.99f);
+    summary.maxS = times.back();
+    std::sort(docking.begin(), docking.end());
+    std::sort(saturated.begin(), saturated.end());
+    std::sort(headingHeld.begin(), headingHeld.end());
+    summary.dockingP50S = percentileOf(docking, 0.50f);
+    summary.dockingP90S = percentileOf(docking, 0.90f);
+    summary.saturatedP50S = percentileOf(saturated, 0.50f);
+    summary.saturatedP90S = percentileOf(saturated, 0.90f);
+    summary.headingHeldP50S = percentileOf(headingHeld, 0.50f);
+    summary.headingHeldP90S = percentileOf(headingHeld, 0.90f);
+  }
+  if (!efficiency.empty()) {
+    std::sort(efficiency.begin(), efficiency.end());
+    double total = 0.0;
+    for (float value : efficiency) {
+      total += value;
+    }
+    summary.pathEfficiencyMean =
+        static_cast<float>(total / static_cast<double>(efficiency.size()));
+    summary.pathEfficiencyP10 = percentileOf(efficiency, 0.10f);
+  }
+  summary.searchEpisodes = static_cast<uint32_t>(reacquire.size());
+  if (!reacquire.empty()) {
+    std::sort(reacquire.begin(), reacquire.end());
+    summary.reacquireP50S = percentileOf(reacquire, 0.50f);
+    summary.reacquireP90S = percentileOf(reacquire, 0.90f);
+    summary.reacquireMaxS = reacquire.back();
+  }
+  return summary;
+}
+
+const char *outcomeName(RunOutcome outcome) {
+  switch (outcome) {
+  case RunOutcome::ARRIVED:
+    return "arrived";
+  case RunOutcome::FALSE_ARRIVAL:
+    return "false_arrival";
+  case RunOutcome::TIMEOUT:
+    return "timeout";
+  }
+  return "unknown";
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "arena.h"
+#include "beacon_navigator.h"
+#include "drive_model.h"
+#include "ir_sensor_model.h"
+#include "yaw_rate_loop.h"
+
+#include <beacon_power.h>
+#include <beacon_tracker.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct SimulationConfig {
+  ArenaConfig arena;
+  DriveModelConfig drive;
+  IrSensorModelConfig sensor;
+  BeaconNavigatorConfig navigator;
+  BeaconTrackerConfig tracker;
+  uint32_t timeoutMs = 60000;
+  float physicsStepMs = 2.0f;
+  // Closed-loop beacon power: the slave reports every reportPeriodMs (every
+  // reportSlowPeriodMs while the beacon signal is below reportFastSignal),
+  // the master sets the duty from it and advertises it back. Each message
+  // arrives meshLatencyMs after it is sent. Off keeps sensor.beaconDuty.
+  bool beaconPower = false;
+  beacon_power::BeaconPowerConfig beaconPowerConfig;
+  uint32_t reportPeriodMs = 200;
+  uint32_t reportSlowPeriodMs = 500;
+  float reportFastSignal = 300.0f;
+  uint32_t meshLatencyMs = 30;
+  // IMU gyro seen by the yaw rate loop (navigator.yawRateLoop): white noise
+  // per reading and the bias left after the slave's at-rest estimate, rad/s.
+  float gyroNoiseRadS = 0.02f;
+  float gyroBiasRadS = 0.0f;
+};
+
+enum class RunOutcome : uint8_t { ARRIVED, FALSE_ARRIVAL, TIMEOUT };
+
+struct RunResult {
+  uint32_t index = 0;
+  Pose start;
+  RunOutcome outcome = RunOutcome::TIMEOUT;
+  uint32_t timeMs = 0;
+  float finalDistanceM = 0.0f;
+  uint32_t searchMs = 0;
+  // Duration of every completed search episode (lost -> detected again).
+  std::vector<uint32_t> reacquireMs;
+  uint32_t unresolvedSearches = 0;
+  // Ticks with a saturated raw channel and ticks the guard held the
+  // heading, in ms.
+  uint32_t saturatedMs = 0;
+  uint32_t headingHeldMs = 0;
+  // Ticks the navigator's wall jitter steered and ticks the tracker took
+  // the bearing as reflected (BeaconTrackerState::reflected), in ms.
+  uint32_t wallJitterMs = 0;
+  uint32_t reflectedMs = 0;
+  // RMS error of the bearing estimate against the true bearing, over the
+  // detected ticks within DOCKING_RADIUS_M; 0 without any.
+  float dockingBearingRmsRad = 0.0f;
+  // From first coming within DOCKING_RADIUS_M of the beacon to the end of
+  // the run; 0 if the robot never got that close.
+  uint32_t dockingMs = 0;
+  uint16_t minBeaconDuty = 0;
+  // HeadingSettle over the bearing estimate, with HEADING_SETTLE_RAD and
+  // HEADING_SETTLE_HOLD_MS, as the slave reports it on the mat. Not the true
+  // bearing: near the beacon the front channel's ambient light pulls the
+  // estimate toward zero, and no steering can undo that.
+  bool headingSettled = false;
+  uint32_t headingSettleMs = 0;
+  // Distance driven; the start distance less the final one, over this, is
+  // the path efficiency.
+  float startDistanceM = 0.0f;
+  float pathM = 0.0f;
+};
+
+// The last stretch of the walk, where the beacon saturates the sensors at
+// the reference duty.
+constexpr float DOCKING_RADIUS_M = 0.30f;
+constexpr float HEADING_SETTLE_RAD = 0.1745f;
+constexpr uint32_t HEADING_SETTLE_HOLD_MS = 1000;
+
+struct TickTrace {
+  const BeaconTrackerState &state;
+  const Pose &pose;
+  bool searchMode;
+  uint16_t leftDuty;
+  uint16_t rightDuty;
+  uint16_t beaconDuty;
+};
+
+using TraceCallback = std::function<void(const TickTrace &)>;
+
+// Drives one BeaconNavigator from a start pose until it reports arrival or
+// the timeout elapses. Deterministic for a given (seed, index). The start
+// pose is drawn at random unless one is given.
+RunResult simulateRun(const SimulationConfig &config, uint32_t index,
+                      uint64_t seed, const TraceCallback &trace = nullptr,
+                      const Pose *start = nullptr);
+
+// Runs `runs` independent simulations on `threads` workers.
+std::vector<RunResult> runMonteCarlo(const SimulationConfig &config,
+                                     uint32_t runs, uint64_t seed,
+                                     unsigned threads);
+
+struct OutcomeSummary {
+  uint32_t runs = 0;
+  uint32_t arrived = 0;
+  uint32_t falseArrivals = 0;
+  uint32_t timeouts = 0;
+  float successRate = 0.0f;
+  // Time-to-arrival over successful runs, seconds.
+  float meanS = 0.0f;
+  float p50S = 0.0f;
+  float p90S = 0.0f;
+  float p99S = 0.0f;
+  float maxS = 0.0f;
+  // Re-acquisition time over all completed search episodes, seconds.
+  uint32_t searchEpisodes = 0;
+  uint32_t unresolvedSearches = 0;
+  float reacquireP50S = 0.0f;
+  float reacquireP90S = 0.0f;
+  float reacquireMaxS = 0.0f;
+  // Over successful runs, seconds.
+  float dockingP50S = 0.0f;
+  float dockingP90S = 0.0f;
+  float saturatedP50S = 0.0f;
+  float saturatedP90S = 0.0f;
+  float headingHeldP50S = 0.0f;
+  float headingHeldP90S = 0.0f;
+  // Over successful runs.
+  float pathEfficiencyMean = 0.0f;
+  float pathEfficiencyP10 = 0.0f;
+};
+
+OutcomeSummary summarize(const std::vector<RunResult> &results);
+const char *outcomeName(RunOutcome outcome);
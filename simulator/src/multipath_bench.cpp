@@ -0,0 +1,80 @@
+#include "multipath_bench.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+float percentileOf(std::vector<float> &values, float fraction) {
+  if (values.empty()) {
+    return 0.0f;
+  }
+  std::sort(values.begin(), values.end());
+  const size_t rank = static_cast<size_t>(
+      std::ceil(fraction * static_cast<float>(values.size())) - 1.0f);
+  return values[std::min(rank, values.size() - 1)];
+}
+} // namespace
+
+SimulationConfig applyMultipathVariant(const SimulationConfig &config,
+                                       const MultipathVariant &variant) {
+  SimulationConfig result = config;
+  result.tracker.multipathCheck = variant.multipathCheck;
+  result.navigator.wallJitterMaxConfidence = variant.wallJitterMaxConfidence;
+  return result;
+}
+
+MultipathSummary runMultipathTrials(const SimulationConfig &config,
+                                    uint32_t runs, uint64_t seed,
+                                    unsigned threads) {
+  const std::vector<RunResult> results =
+      runMonteCarlo(config, runs, seed, threads);
+  MultipathSummary summary;
+  summary.outcome = summarize(results);
+
+  std::vector<float> jitter;
+  std::vector<float> reflected;
+  std::vector<float> bearing;
+  for (const RunResult &result : results) {
+    jitter.push_back(static_cast<float>(result.wallJitterMs) * 0.001f);
+    reflected.push_back(static_cast<float>(result.reflectedMs) * 0.001f);
+    if (result.dockingMs > 0) {
+      bearing.push_back(result.dockingBearingRmsRad);
+    }
+  }
+  summary.wallJitterP50S = percentileOf(jitter, 0.50f);
+  summary.wallJitterP90S = percentileOf(jitter, 0.90f);
+  summary.reflectedP50S = percentileOf(reflected, 0.50f);
+  summary.reflectedP90S = percentileOf(reflected, 0.90f);
+  summary.bearingRmsP50Rad = percentileOf(bearing, 0.50f);
+  summary.bearingRmsP90Rad = percentileOf(bearing, 0.90f);
+  return summary;
+}
+
+MultipathReplay replayMultipath(const std::vector<BeaconSample> &samples,
+                                const SimulationConfig &config) {
+  MultipathReplay replay;
+  if (samples.empty()) {
+    return replay;
+  }
+  // No drive and no gyro: the recordings carry neither, so the bearing
+  // check is skipped and the navigator steers nothing.
+  BeaconNavigator navigator(nullptr, config.navigator, config.tracker);
+  navigator.begin(samples.front().tMs);
+  std::vector<float> confidence;
+  for (const BeaconSample &sample : samples) {
+    navigator.update(sample.raw[0], sample.raw[1], sample.raw[2],
+                     sample.raw[3], sample.tMs);
+    const BeaconTrackerState &state = navigator.state();
+    replay.samples++;
+    replay.wallJitter += navigator.wallJitterActive() ? 1U : 0U;
+    replay.reflected += state.reflected ? 1U : 0U;
+    if (state.detected && !state.saturated) {
+      confidence.push_back(state.confidence);
+    }
+  }
+  if (!confidence.empty()) {
+    replay.confidenceP10 = percentileOf(confidence, 0.10f);
+    replay.confidenceP50 = percentileOf(confidence, 0.50f);
+  }
+  return replay;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "beacon_recording.h"
+#include "monte_carlo.h"
+
+#include <cstdint>
+#include <vector>
+
+// Wall jitter against the tracker's multipath checks
+// (BeaconTrackerConfig::multipathCheck): the same Monte Carlo runs for each
+// variant, and the recordings replayed through the navigator, where the
+// time with the jitter on and the bearing held as reflected can be counted
+// but nothing steers.
+struct MultipathVariant {
+  const char *name;
+  bool multipathCheck;
+  // BeaconNavigatorConfig::wallJitterMaxConfidence.
+  float wallJitterMaxConfidence;
+};
+
+struct MultipathSummary {
+  OutcomeSummary outcome;
+  // Over all runs, seconds.
+  float wallJitterP50S = 0.0f;
+  float wallJitterP90S = 0.0f;
+  float reflectedP50S = 0.0f;
+  float reflectedP90S = 0.0f;
+  // RunResult::dockingBearingRmsRad over the runs that got that close.
+  float bearingRmsP50Rad = 0.0f;
+  float bearingRmsP90Rad = 0.0f;
+};
+
+struct MultipathReplay {
+  uint32_t samples = 0;
+  uint32_t wallJitter = 0;
+  uint32_t reflected = 0;
+  // Confidence over the detected, unsaturated samples.
+  float confidenceP10 = 1.0f;
+  float confidenceP50 = 1.0f;
+};
+
+SimulationConfig applyMultipathVariant(const SimulationConfig &config,
+                                       const MultipathVariant &variant);
+
+MultipathSummary runMultipathTrials(const SimulationConfig &config,
+                                    uint32_t runs, uint64_t seed,
+                                    unsigned threads);
+
+MultipathReplay replayMultipath(const std::vector<BeaconSample> &samples,
+                                const SimulationConfig &config);
@@ -0,0 +1,76 @@
+#include "sensor_calibration.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+float percentile(std::vector<float> values, float fraction) {
+  if (values.empty()) {
+    return 0.0f;
+  }
+  const size_t rank = static_cast<size_t>(
+      fraction * static_cast<float>(values.size() - 1) + 0.5f);
+  std::nth_element(values.begin(), values.begin() + rank, values.end());
+  return values[rank];
+}
+} // namespace
+
+SensorFit fitSensorModel(const std::vector<BeaconSample> &samples,
+                         const IrSensorModelConfig &base,
+                         float peakDistanceM) {
+  SensorFit fit;
+  fit.model = base;
+  fit.samples = samples.size();
+  if (samples.size() < 2) {
+    return fit;
+  }
+
+  std::vector<float> values;
+  values.reserve(samples.size());
+  std::vector<float> channelSigma;
+  size_t saturated = 0;
+
+  for (uint8_t ch = 0; ch < IR_CHANNEL_COUNT; ++ch) {
+    values.clear();
+    for (const BeaconSample &sample : samples) {
+      values.push_back(static_cast<float>(sample.raw[ch]));
+    }
+    fit.model.ambient[ch] = percentile(values, 0.02f);
+
+    // Robust sigma from first differences: MAD * 1.4826 / sqrt(2). Motion
+    // inflates the differences, so this is an upper bound on sensor noise.
+    values.clear();
+    for (size_t i = 1; i < samples.size(); ++i) {
+      values.push_back(static_cast<float>(samples[i].raw[ch]) -
+                       static_cast<float>(samples[i - 1].raw[ch]));
+    }
+    const float median = percentile(values, 0.5f);
+    for (float &value : values) {
+      value = std::fabs(value - median);
+    }
+    channelSigma.push_back(percentile(values, 0.5f) * 1.4826f /
+                           std::sqrt(2.0f));
+  }
+  fit.model.noiseSigma = percentile(channelSigma, 0.5f);
+
+  values.clear();
+  for (const BeaconSample &sample : samples) {
+    float peak = 0.0f;
+    bool isSaturated = false;
+    for (uint8_t ch = 0; ch < IR_CHANNEL_COUNT; ++ch) {
+      peak = std::max(peak, static_cast<float>(sample.raw[ch]) -
+                                fit.model.ambient[ch]);
+      isSaturated = isSaturated || sample.raw[ch] >= base.adcMax;
+    }
+    values.push_back(peak);
+    saturated += isSaturated ? 1U : 0U;
+  }
+  fit.peakAboveAmbient = percentile(values, 0.99f);
+  fit.saturatedFraction =
+      static_cast<float>(saturated) / static_cast<float>(samples.size());
+
+  const float distanceSq =
+      peakDistanceM * peakDistanceM + base.softeningM * base.softeningM;
+  fit.model.beaconGain = fit.peakAboveAmbient * distanceSq;
+  return fit;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "beacon_recording.h"
+#include "ir_sensor_model.h"
+
+#include <vector>
+
+struct SensorFit {
+  IrSensorModelConfig model;
+  size_t samples = 0;
+  float saturatedFraction = 0.0f;
+  float peakAboveAmbient = 0.0f;
+};
+
+// Fits ambient floor, noise and beacon gain of the IR model to recordings.
+// The gain is chosen so that the strongest observed channel level is reached
+// on-axis at `peakDistanceM`, the sensor-to-beacon distance when docked.
+SensorFit fitSensorModel(const std::vector<BeaconSample> &samples,
+                         const IrSensorModelConfig &base,
+                         float peakDistanceM);
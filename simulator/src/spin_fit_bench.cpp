@@ -0,0 +1,224 @@
+#include "spin_fit_bench.h"
+
+#include "drive_model.h"
+#include "ir_sensor_model.h"
+#include "navigation_config.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+constexpr uint32_t TICK_MS = navigation_config::CONTROL_PERIOD_MS;
+constexpr float SPIN_X_MIN_M = 0.10f;
+constexpr float SPIN_X_MAX_M = 0.25f;
+constexpr float SPIN_Y_SPREAD_M = 0.05f;
+constexpr uint32_t BEARING_HEADINGS = 72;
+constexpr uint32_t BEARING_SAMPLES = 10;
+// Samples the median prefilter needs before the output is steady.
+constexpr uint32_t BEARING_WARMUP = 3;
+constexpr float RADIANS_TO_DEGREES = 57.29577951308232f;
+
+constexpr size_t STATUS_COUNT =
+    static_cast<size_t>(ir_calibration::FitStatus::AMBIENT_UNEVEN) + 1;
+
+void toRaw(const IrReading &reading,
+           uint16_t (&raw)[ir_calibration::CHANNELS]) {
+  for (uint8_t i = 0; i < ir_calibration::CHANNELS; ++i) {
+    raw[i] = static_cast<uint16_t>(std::min<uint32_t>(reading.raw[i], 0xFFFF));
+  }
+}
+
+template <typename Capture>
+void captureStill(IrSensorModel &sensor, const Pose &pose, uint32_t durationMs,
+                  Capture &capture) {
+  uint16_t raw[ir_calibration::CHANNELS];
+  for (uint32_t nowMs = 0; nowMs <= durationMs; nowMs += TICK_MS) {
+    toRaw(sensor.sample(pose), raw);
+    capture.add(raw);
+  }
+}
+
+// Same schedule as SensorCalibrator: pivot on the left wheel, then on the
+// right one.
+void captureSpin(IrSensorModel &sensor, DriveModel &drive, float physicsStepMs,
+                 ir_calibration::SpinCapture &capture) {
+  const uint32_t spinMs = navigation_config::CALIBRATION_SPIN_MS;
+  const uint16_t duty = navigation_config::CALIBRATION_SPIN_DUTY;
+  uint16_t raw[ir_calibration::CHANNELS];
+  for (uint32_t nowMs = 0; nowMs <= spinMs; nowMs += TICK_MS) {
+    const bool pivotOnRight = nowMs >= spinMs / 2;
+    toRaw(sensor.sample(drive.pose()), raw);
+    capture.add(raw, pivotOnRight ? 1 : 0);
+    drive.setLeftDuty(pivotOnRight ? duty : 0);
+    drive.setRightDuty(pivotOnRight ? 0 : duty);
+    for (float t = 0.0f; t < static_cast<float>(TICK_MS); t += physicsStepMs) {
+      drive.step(physicsStepMs);
+    }
+  }
+  drive.stop();
+}
+
+BeaconTrackerConfig withChannels(BeaconTrackerConfig tracker,
+                                 const float (&offset)[4],
+                                 const float (&gain)[4]) {
+  SensorCalibration *channels[4] = {&tracker.front, &tracker.back,
+                                    &tracker.left, &tracker.right};
+  for (uint8_t i = 0; i < 4; ++i) {
+    channels[i]->offset = offset[i];
+    channels[i]->gain = gain[i];
+  }
+  return tracker;
+}
+
+// RMS error of the tracker's bearing over a full turn on the spot, in a
+// dark room so only the channel mismatch shows.
+float bearingRmsDeg(const SimulationConfig &config,
+                    const IrSensorModelConfig &model,
+                    const BeaconTrackerConfig &tracker, const Pose &center,
+                    std::mt19937 &rng) {
+  IrSensorModel sensor(model, config.arena, rng);
+  sensor.setAmbientScale(0.0f);
+  double sumSquares = 0.0;
+  for (uint32_t k = 0; k < BEARING_HEADINGS; ++k) {
+    Pose pose = center;
+    pose.heading = wrapAngle(kTwoPi * static_cast<float>(k) /
+                             static_cast<float>(BEARING_HEADINGS));
+    BeaconTracker bearing(tracker);
+    float vx = 0.0f;
+    float vy = 0.0f;
+    for (uint32_t n = 0; n < BEARING_SAMPLES; ++n) {
+      const IrReading reading = sensor.sample(pose);
+      const BeaconTrackerState &state = bearing.update(
+          reading.raw[IR_CH_FRONT], reading.raw[IR_CH_BACK],
+          reading.raw[IR_CH_LEFT], reading.raw[IR_CH_RIGHT], n * TICK_MS);
+      if (n >= BEARING_WARMUP) {
+        vx += state.vx;
+        vy += state.vy;
+      }
+    }
+    const float truth =
+        wrapAngle(std::atan2(config.arena.beaconY - pose.y,
+                             config.arena.beaconX - pose.x) -
+                  pose.heading);
+    const float error = wrapAngle(std::atan2(vy, vx) - truth);
+    sumSquares += static_cast<double>(error) * error;
+  }
+  return static_cast<float>(std::sqrt(sumSquares / BEARING_HEADINGS)) *
+         RADIANS_TO_DEGREES;
+}
+} // namespace
+
+SpinFitSummary runSpinFitTrials(const SimulationConfig &config,
+                                uint32_t trials, float gainSpread,
+                                float maxDarkOffset, uint64_t seed) {
+  using ir_calibration::FitStatus;
+  SpinFitSummary summary;
+  summary.trials = trials;
+  summary.darkStatus.assign(STATUS_COUNT, 0);
+  summary.spinStatus.assign(STATUS_COUNT, 0);
+  summary.ambientStatus.assign(STATUS_COUNT, 0);
+
+  for (uint32_t trial = 0; trial < trials; ++trial) {
+    std::seed_seq seq{static_cast<uint32_t>(seed),
+                      static_cast<uint32_t>(seed >> 32), trial};
+    std::mt19937 rng(seq);
+    std::uniform_real_distribution<float> gain(1.0f - gainSpread,
+                                               1.0f + gainSpread);
+    std::uniform_real_distribution<float> darkOffset(0.0f, maxDarkOffset);
+    std::uniform_real_distribution<float> x(SPIN_X_MIN_M, SPIN_X_MAX_M);
+    std::uniform_real_distribution<float> y(-SPIN_Y_SPREAD_M, SPIN_Y_SPREAD_M);
+    std::uniform_real_distribution<float> heading(-kPi, kPi);
+
+    IrSensorModelConfig model = config.sensor;
+    for (uint8_t i = 0; i < IR_CHANNEL_COUNT; ++i) {
+      model.channelGain[i] = gain(rng);
+      model.darkOffset[i] = darkOffset(rng);
+    }
+    Pose start;
+    start.x = x(rng);
+    start.y = config.arena.beaconY + y(rng);
+    start.heading = heading(rng);
+
+    IrSensorModel sensor(model, config.arena, rng);
+    ir_calibration::Calibration fit;
+
+    sensor.setBeaconDuty(0.0f);
+    sensor.setAmbientScale(0.0f);
+    ir_calibration::DarkCapture dark;
+    captureStill(sensor, start, navigation_config::CALIBRATION_CAPTURE_MS,
+                 dark);
+    const FitStatus darkStatus = dark.fit(fit);
+    summary.darkStatus[static_cast<size_t>(darkStatus)]++;
+
+    sensor.setAmbientScale(1.0f);
+    ir_calibration::AmbientCheck ambient;
+    captureStill(sensor, start, navigation_config::CALIBRATION_CAPTURE_MS,
+                 ambient);
+    summary.ambientStatus[static_cast<size_t>(ambient.fit(fit))]++;
+
+    sensor.setBeaconDuty(model.beaconDuty);
+    DriveModel drive(config.drive, config.arena, rng);
+    drive.setPose(start);
+    uint16_t baseline[ir_calibration::CHANNELS];
+    ambient.rawMean(baseline);
+    ir_calibration::SpinCapture spin;
+    spin.reset(baseline);
+    captureSpin(sensor, drive, config.physicsStepMs, spin);
+    const FitStatus spinStatus = spin.fit(fit);
+    summary.spinStatus[static_cast<size_t>(spinStatus)]++;
+
+    if (darkStatus != FitStatus::OK || spinStatus != FitStatus::OK) {
+      continue;
+    }
+
+    // Fitted gains are only defined up to a common factor.
+    float product[IR_CHANNEL_COUNT];
+    float meanProduct = 0.0f;
+    for (uint8_t i = 0; i < IR_CHANNEL_COUNT; ++i) {
+      product[i] = model.channelGain[i] * fit.gainQ12[i] /
+                   static_cast<float>(ir_calibration::GAIN_ONE);
+      meanProduct += product[i] / IR_CHANNEL_COUNT;
+    }
+    float fittedOffset[4];
+    float fittedGain[4];
+    float idealGain[4];
+    const float unit[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    const float zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (uint8_t i = 0; i < IR_CHANNEL_COUNT; ++i) {
+      summary.gainErrors.push_back(std::fabs(product[i] / meanProduct - 1.0f));
+      summary.offsetErrors.push_back(
+          std::fabs(static_cast<float>(fit.offset[i]) - model.darkOffset[i]));
+      fittedOffset[i] = fit.offset[i];
+      fittedGain[i] = fit.gainQ12[i] /
+                      static_cast<float>(ir_calibration::GAIN_ONE);
+      idealGain[i] = 1.0f / model.channelGain[i];
+    }
+
+    summary.bearingUncalibratedDeg.push_back(bearingRmsDeg(
+        config, model, withChannels(config.tracker, zero, unit), start, rng));
+    summary.bearingFittedDeg.push_back(bearingRmsDeg(
+        config, model, withChannels(config.tracker, fittedOffset, fittedGain),
+        start, rng));
+    summary.bearingIdealDeg.push_back(bearingRmsDeg(
+        config, model,
+        withChannels(config.tracker, model.darkOffset, idealGain), start,
+        rng));
+  }
+  return summary;
+}
+
+ir_calibration::FitStatus fitRecordedSpin(
+    const std::vector<BeaconSample> &samples,
+    ir_calibration::SpinCapture &capture, ir_calibration::Calibration &fit) {
+  fit = ir_calibration::Calibration();
+  capture.reset(fit.offset);
+  uint16_t raw[ir_calibration::CHANNELS];
+  for (const BeaconSample &sample : samples) {
+    for (uint8_t i = 0; i < ir_calibration::CHANNELS; ++i) {
+      raw[i] = static_cast<uint16_t>(std::min<uint32_t>(sample.raw[i], 0xFFFF));
+    }
+    capture.add(raw);
+  }
+  return capture.fit(fit);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "beacon_recording.h"
+#include "monte_carlo.h"
+
+#include <ir_calibration.h>
+
+#include <cstdint>
+#include <vector>
+
+// Checks the IR channel calibration fit (common/calibration) against a
+// sensor model with known channel mismatch: each trial draws channel gains
+// and dark offsets, runs the dark capture, the ambient check and the
+// two-wheel pivot spin the slave runs, and compares the fit with the truth.
+struct SpinFitSummary {
+  uint32_t trials = 0;
+  // Trials per FitStatus of the dark capture, the spin and the ambient check.
+  std::vector<uint32_t> darkStatus;
+  std::vector<uint32_t> spinStatus;
+  std::vector<uint32_t> ambientStatus;
+  // Over trials whose dark capture and spin fitted: relative gain error
+  // after normalizing to the mean channel, and offset error in counts.
+  std::vector<float> gainErrors;
+  std::vector<float> offsetErrors;
+  // RMS bearing error (degrees) over a full turn in front of the beacon, in
+  // the dark: uncalibrated, fitted, and with the true channel values.
+  std::vector<float> bearingUncalibratedDeg;
+  std::vector<float> bearingFittedDeg;
+  std::vector<float> bearingIdealDeg;
+};
+
+// Channel gains are drawn from 1 +- gainSpread, dark offsets from
+// [0, maxDarkOffset] counts.
+SpinFitSummary runSpinFitTrials(const SimulationConfig &config,
+                                uint32_t trials, float gainSpread,
+                                float maxDarkOffset, uint64_t seed);
+
+// Feeds a recording to a SpinCapture with a zero baseline, as if it were a
+// spin, and reports the fit.
+ir_calibration::FitStatus fitRecordedSpin(
+    const std::vector<BeaconSample> &samples,
+    ir_calibration::SpinCapture &capture, ir_calibration::Calibration &fit);
@@ -0,0 +1,344 @@
+#include "beacon_navigator.h"
+
+#include <cmath>
+
+namespace {
+constexpr float HALF_PI_RAD = 1.57079632679489661923f;
+// Gradient bearings beyond 135 deg count as "behind" in the search.
+constexpr float SEARCH_BEHIND_RAD = 1.5f * HALF_PI_RAD;
+
+float clampf(float value, float low, float high) {
+  if (value < low) {
+    return low;
+  }
+  if (value > high) {
+    return high;
+  }
+  return value;
+}
+
+bool isFrontDominant(const BeaconTrackerState &state) {
+  return state.front >= state.back && state.front >= state.left &&
+         state.front >= state.right;
+}
+} // namespace
+
+BeaconNavigator::BeaconNavigator(DriveOutput *drive,
+                                 const BeaconNavigatorConfig &config,
+                                 const BeaconTrackerConfig &trackerConfig)
+    : drive_(drive), config_(config), tracker_(trackerConfig),
+      yawRate_(config.yawRate) {}
+
+uint16_t BeaconNavigator::quantizeDuty(uint16_t duty) const {
+  if (duty == 0) {
+    return 0;
+  }
+
+  if (duty > config_.dutyMax) {
+    duty = config_.dutyMax;
+  }
+
+  uint16_t quantized = static_cast<uint16_t>(
+      ((duty + (config_.dutyQuantizeStep / 2)) / config_.dutyQuantizeStep) *
+      config_.dutyQuantizeStep);
+
+  if (quantized < config_.dutyDeadzone) {
+    quantized = config_.dutyDeadzone;
+  }
+  if (quantized > config_.dutyMax) {
+    quantized = config_.dutyMax;
+  }
+
+  return quantized;
+}
+
+uint16_t BeaconNavigator::mapNormalizedToDuty(float normalized) const {
+  if (normalized <= 0.0f) {
+    return 0;
+  }
+
+  normalized = clampf(normalized, 0.0f, 1.0f);
+  const float duty =
+      static_cast<float>(config_.dutyDeadzone) +
+      normalized * static_cast<float>(config_.dutyMax - config_.dutyDeadzone);
+  return quantizeDuty(static_cast<uint16_t>(duty));
+}
+
+void BeaconNavigator::applyMotorDuties(uint16_t leftDuty, uint16_t rightDuty) {
+  leftDuty = quantizeDuty(leftDuty);
+  rightDuty = quantizeDuty(rightDuty);
+
+  if (leftDuty != lastLeftDuty_) {
+    if (drive_ != nullptr) {
+      drive_->setLeftDuty(leftDuty);
+    }
+    lastLeftDuty_ = leftDuty;
+  }
+
+  if (rightDuty != lastRightDuty_) {
+    if (drive_ != nullptr) {
+      drive_->setRightDuty(rightDuty);
+    }
+    lastRightDuty_ = rightDuty;
+  }
+}
+
+void BeaconNavigator::reset() {
+  if ((active_ || lastLeftDuty_ != 0 || lastRightDuty_ != 0) &&
+      drive_ != nullptr) {
+    drive_->stop();
+  }
+
+  tracker_.reset();
+  yawRate_.reset();
+  forward_ = 0.0f;
+  active_ = false;
+  searchMode_ = false;
+  searchClockwise_ = true;
+  nextControlAtMs_ = 0;
+  lastSearchFlipAtMs_ = 0;
+  memoryValid_ = false;
+  memoryTheta_ = 0.0f;
+  memorySignal_ = 0.0f;
+  memoryAtMs_ = 0;
+  searchTurnLeft_ = true;
+  searchRecalling_ = false;
+  sweepIndex_ = 0;
+  sweepEndsAtMs_ = 0;
+  lastWallJitterFlipAtMs_ = 0;
+  wallJitterSign_ = 1;
+  wallJitterActive_ = false;
+  lastLeftDuty_ = 0;
+  lastRightDuty_ = 0;
+}
+
+void BeaconNavigator::begin(uint32_t now) {
+  reset();
+  active_ = true;
+  nextControlAtMs_ = now;
+  lastSearchFlipAtMs_ = now;
+  lastWallJitterFlipAtMs_ = now;
+}
+
+bool BeaconNavigator::active() const { return active_; }
+
+bool BeaconNavigator::shouldRunControl(uint32_t now) {
+  if (static_cast<int32_t>(now - nextControlAtMs_) < 0) {
+    return false;
+  }
+
+  nextControlAtMs_ += config_.controlPeriodMs;
+  if (static_cast<int32_t>(now - nextControlAtMs_) >
+      static_cast<int32_t>(config_.controlPeriodMs)) {
+    nextControlAtMs_ = now + config_.controlPeriodMs;
+  }
+
+  return true;
+}
+
+void BeaconNavigator::driveSearch(uint32_t now) {
+  if (now - lastSearchFlipAtMs_ >= config_.searchFlipPeriodMs) {
+    searchClockwise_ = !searchClockwise_;
+    lastSearchFlipAtMs_ = now;
+  }
+
+  if (searchClockwise_) {
+    applyMotorDuties(0, config_.dutySearch);
+  } else {
+    applyMotorDuties(config_.dutySearch, 0);
+  }
+}
+
+void BeaconNavigator::applySearchTurn(bool turnLeft, uint16_t innerDuty) {
+  // Raising the right motor turns the robot left.
+  if (turnLeft) {
+    applyMotorDuties(innerDuty, config_.dutySearch);
+  } else {
+    applyMotorDuties(config_.dutySearch, innerDuty);
+  }
+}
+
+void BeaconNavigator::driveMemorySearch(const BeaconTrackerState &state,
+                                        uint32_t now, bool entering) {
+  if (entering) {
+    sweepIndex_ = 0;
+    const bool recall =
+        memoryValid_ && now - memoryAtMs_ <= config_.searchMemoryMaxAgeMs &&
+        state.totalSignal >= memorySignal_ * config_.searchMemoryMinRetained;
+    if (recall) {
+      // Positive theta means the beacon was last seen on the left. Turn
+      // back toward it for a time proportional to how far off-axis it was.
+      searchRecalling_ = true;
+      searchTurnLeft_ = memoryTheta_ >= 0.0f;
+      const float share =
+          clampf(std::fabs(memoryTheta_) / HALF_PI_RAD, 0.25f, 1.0f);
+      sweepEndsAtMs_ =
+          now + static_cast<uint32_t>(share * config_.searchRecallMs);
+    } else {
+      searchRecalling_ = false;
+      sweepEndsAtMs_ = now + config_.searchSweepBaseMs;
+    }
+  } else if (static_cast<int32_t>(now - sweepEndsAtMs_) >= 0) {
+    // Each sweep reverses and covers a wider arc than the previous one; the
+    // first sweep after a recall swings back across the remembered bearing.
+    if (!searchRecalling_ && sweepIndex_ < 0xFF) {
+      sweepIndex_++;
+    }
+    searchRecalling_ = false;
+    searchTurnLeft_ = !searchTurnLeft_;
+    float duration = static_cast<float>(config_.searchSweepBaseMs);
+    for (uint8_t i = 0; i < sweepIndex_; ++i) {
+      duration *= config_.searchSweepGrowth;
+      if (duration >= static_cast<float>(config_.searchSweepMaxMs)) {
+        duration = static_cast<float>(config_.searchSweepMaxMs);
+        break;
+      }
+    }
+    sweepEndsAtMs_ = now + static_cast<uint32_t>(duration);
+  }
+
+  // Below the detection threshold the channel imbalance still points at the
+  // beacon; follow it once it clears the noise. With the beacon behind, the
+  // left/right part is mostly noise and either turn reaches it, so the
+  // current direction is kept.
+  const float gradientX = state.front - state.back;
+  const float gradientY = state.left - state.right;
+  if (!searchRecalling_ &&
+      std::hypot(gradientX, gradientY) >= config_.searchGradientMin) {
+    const float bearing = std::atan2(gradientY, gradientX);
+    if (std::fabs(bearing) <= SEARCH_BEHIND_RAD) {
+      searchTurnLeft_ = bearing > 0.0f;
+    }
+  }
+
+  const uint16_t innerDuty =
+      sweepIndex_ >= config_.searchSpiralAfterSweeps ? config_.dutyDeadzone
+                                                      : 0;
+  applySearchTurn(searchTurnLeft_, innerDuty);
+}
+
+float BeaconNavigator::wallJitterTerm(const BeaconTrackerState &state) {
+  const bool likelyNearWall =
+      state.detected && isFrontDominant(state) &&
+      state.totalSignal >= config_.wallJitterMinSignal &&
+      std::fabs(state.filteredTheta) <= config_.wallJitterMaxThetaRad &&
+      state.confidence <= config_.wallJitterMaxConfidence;
+  wallJitterActive_ = likelyNearWall;
+  if (!likelyNearWall) {
+    return 0.0f;
+  }
+
+  if (state.timestampMs - lastWallJitterFlipAtMs_ >=
+      config_.wallJitterPeriodMs) {
+    wallJitterSign_ = -wallJitterSign_;
+    lastWallJitterFlipAtMs_ = state.timestampMs;
+  }
+
+  return static_cast<float>(wallJitterSign_) * config_.wallJitterWAmplitude;
+}
+
+void BeaconNavigator::applyTurn(float forward, float turn) {
+  // For this drivetrain, increasing right motor turns the robot left.
+  // So steering mix is mirrored: right-turn intent must boost left motor.
+  const float mLeft = clampf(forward - turn, 0.0f, 1.0f);
+  const float mRight = clampf(forward + turn, 0.0f, 1.0f);
+
+  applyMotorDuties(mapNormalizedToDuty(mLeft), mapNormalizedToDuty(mRight));
+}
+
+bool BeaconNavigator::yawRateTracking() const {
+  return config_.yawRateLoop && active_ && !searchMode_;
+}
+
+void BeaconNavigator::driveTracking(const BeaconTrackerState &state) {
+  const float theta = state.filteredTheta;
+  float u = config_.uMax * std::fmax(0.0f, std::cos(theta));
+  if (std::fabs(theta) > HALF_PI_RAD) {
+    u = 0.0f;
+  }
+
+  if (!config_.yawRateLoop) {
+    const float w = clampf(config_.kpTheta * theta + wallJitterTerm(state),
+                           -config_.wMax, config_.wMax);
+    applyTurn(u, w);
+    return;
+  }
+
+  // The jitter is a turn; as a rate it is what the loop's model turns it
+  // into.
+  const float jitterRate =
+      wallJitterTerm(state) / config_.yawRate.feedforward;
+  yawRate_.setTarget(clampf(config_.kpBearing * theta + jitterRate,
+                            -config_.yawRateMaxRadS,
+                            config_.yawRateMaxRadS));
+  forward_ = u;
+  applyTurn(forward_, yawRate_.turn(config_.wMax));
+}
+
+bool BeaconNavigator::shouldRunYawRate(uint32_t now) {
+  return yawRateTracking() && yawRate_.due(now);
+}
+
+void BeaconNavigator::updateYawRate(float measuredRadS, uint32_t now) {
+  if (!yawRateTracking()) {
+    return;
+  }
+  tracker_.addTurn(measuredRadS *
+                   static_cast<float>(config_.yawRate.periodMs) * 0.001f);
+  applyTurn(forward_, yawRate_.update(measuredRadS, config_.wMax, now));
+}
+
+float BeaconNavigator::yawRateTarget() const { return yawRate_.target(); }
+
+float BeaconNavigator::yawRateMeasured() const { return yawRate_.measured(); }
+
+bool BeaconNavigator::reachedArrival(const BeaconTrackerState &state) const {
+  return state.detected && state.totalSignal >= config_.signalArrive &&
+         isFrontDominant(state);
+}
+
+bool BeaconNavigator::update(uint32_t rawFront, uint32_t rawBack,
+                             uint32_t rawLeft, uint32_t rawRight,
+                             uint32_t now) {
+  const BeaconTrackerState &state =
+      tracker_.update(rawFront, rawBack, rawLeft, rawRight, now);
+
+  const bool entering = !state.detected && !searchMode_;
+  searchMode_ = !state.detected;
+  wallJitterActive_ = false;
+  if (state.detected) {
+    memoryValid_ = true;
+    memoryTheta_ = state.filteredTheta;
+    memorySignal_ = state.totalSignal;
+    memoryAtMs_ = now;
+    driveTracking(state);
+  } else if (config_.searchStrategy == SearchStrategy::SIGNAL_MEMORY) {
+    driveMemorySearch(state, now, entering);
+  } else {
+    driveSearch(now);
+  }
+
+  return reachedArrival(state);
+}
+
+const BeaconTrackerState &BeaconNavigator::state() const {
+  return tracker_.state();
+}
+
+void BeaconNavigator::setBeaconDuty(uint16_t duty) {
+  tracker_.setBeaconDuty(duty);
+}
+
+bool BeaconNavigator::searchMode() const { return searchMode_; }
+
+bool BeaconNavigator::hasSignalMemory() const { return memoryValid_; }
+
+float BeaconNavigator::memoryTheta() const { return memoryTheta_; }
+
+float BeaconNavigator::memorySignal() const { return memorySignal_; }
+
+uint16_t BeaconNavigator::leftDuty() const { return lastLeftDuty_; }
+
+uint16_t BeaconNavigator::rightDuty() const { return lastRightDuty_; }
+
+bool BeaconNavigator::wallJitterActive() const { return wallJitterActive_; }
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "yaw_rate_loop.h"
+
+#include <beacon_tracker.h>
+#include <cstdint>
+
+enum class SearchStrategy : uint8_t {
+  // Spin in place, reversing direction every searchFlipPeriodMs.
+  FLIP,
+  // Turn toward the last good bearing first, then sweep with growing
+  // amplitude, follow the four-channel gradient when it is above the noise
+  // and open into a spiral after a few unsuccessful sweeps.
+  SIGNAL_MEMORY
+};
+
+struct BeaconNavigatorConfig {
+  uint32_t controlPeriodMs = 20;
+  SearchStrategy searchStrategy = SearchStrategy::SIGNAL_MEMORY;
+  uint32_t searchFlipPeriodMs = 1500;
+  uint32_t searchMemoryMaxAgeMs = 5000;
+  uint32_t searchRecallMs = 900;
+  // The remembered bearing is only recalled while the signal on losing the
+  // beacon is at least this share of the remembered signal. A sudden drop
+  // means the beacon was blocked or switched off, not turned away from.
+  float searchMemoryMinRetained = 0.25f;
+  uint32_t searchSweepBaseMs = 500;
+  uint32_t searchSweepMaxMs = 3000;
+  float searchSweepGrowth = 1.5f;
+  uint8_t searchSpiralAfterSweeps = 4;
+  float searchGradientMin = 60.0f;
+  float signalArrive = 4300.0f;
+  uint32_t wallJitterPeriodMs = 240;
+  float wallJitterMaxThetaRad = 0.28f;
+  float wallJitterMinSignal = 1800.0f;
+  float wallJitterWAmplitude = 0.14f;
+  // The jitter only runs while the tracker's confidence (see
+  // BeaconTrackerConfig::multipathCheck) is at most this; 1 runs it
+  // whenever the other conditions hold, a negative value never.
+  float wallJitterMaxConfidence = 1.0f;
+  float kpTheta = 0.70f;
+  // Steers through the gyro instead: the bearing sets a yaw rate of
+  // kpBearing * theta, up to yawRateMax, and YawRateLoop turns the robot at
+  // that rate (see updateYawRate). kpTheta is then unused.
+  bool yawRateLoop = false;
+  float kpBearing = 3.5f;
+  float yawRateMaxRadS = 1.5f;
+  YawRateLoopConfig yawRate;
+  float wMax = 0.65f;
+  float uMax = 0.75f;
+  uint16_t dutyDeadzone = 3300;
+  uint16_t dutyMax = 4600;
+  uint16_t dutySearch = 3560;
+  uint16_t dutyQuantizeStep = 40;
+};
+
+// Motor sink for the navigator. The firmware forwards to Dezibot motion, the
+// simulator forwards to its differential-drive model.
+class DriveOutput {
+public:
+  virtual void setLeftDuty(uint16_t duty) = 0;
+  virtual void setRightDuty(uint16_t duty) = 0;
+  virtual void stop() = 0;
+  virtual ~DriveOutput() = default;
+};
+
+class BeaconNavigator {
+public:
+  explicit BeaconNavigator(
+      DriveOutput *drive = nullptr,
+      const BeaconNavigatorConfig &config = BeaconNavigatorConfig(),
+      const BeaconTrackerConfig &trackerConfig = BeaconTrackerConfig());
+
+  void begin(uint32_t now);
+  void reset();
+  bool active() const;
+
+  // Returns true once per control period; keeps the tick grid phase-stable.
+  bool shouldRunControl(uint32_t now);
+
+  // Runs one control tick and returns true when the beacon has been reached.
+  bool update(uint32_t rawFront, uint32_t rawBack, uint32_t rawLeft,
+              uint32_t rawRight, uint32_t now);
+
+  // While tracking with yawRateLoop: true once per YawRateLoopConfig::
+  // periodMs, then pass the gyro's yaw rate (rad/s, counter-clockwise
+  // positive) to updateYawRate.
+  bool shouldRunYawRate(uint32_t now);
+  void updateYawRate(float measuredRadS, uint32_t now);
+  float yawRateTarget() const;
+  float yawRateMeasured() const;
+
+  const BeaconTrackerState &state() const;
+  // Forwarded to the tracker; see BeaconTracker::setBeaconDuty.
+  void setBeaconDuty(uint16_t duty);
+  bool searchMode() const;
+  // Last detected bearing and signal, kept while the beacon is lost.
+  bool hasSignalMemory() const;
+  float memoryTheta() const;
+  float memorySignal() const;
+  uint16_t leftDuty() const;
+  uint16_t rightDuty() const;
+  // The wall jitter steered the last control tick.
+  bool wallJitterActive() const;
+
+private:
+  uint16_t quantizeDuty(uint16_t duty) const;
+  uint16_t mapNormalizedToDuty(float normalized) const;
+  void applyMotorDuties(uint16_t leftDuty, uint16_t rightDuty);
+  void driveSearch(uint32_t now);
+  void driveMemorySearch(const BeaconTrackerState &state, uint32_t now,
+                         bool entering);
+  void applySearchTurn(bool turnLeft, uint16_t innerDuty);
+  float wallJitterTerm(const BeaconTrackerState &state);
+  void applyTurn(float forward, float turn);
+  bool yawRateTracking() const;
+  void driveTracking(const BeaconTrackerState &state);
+  bool reachedArrival(const BeaconTrackerState &state) const;
+
+  DriveOutput *drive_;
+  BeaconNavigatorConfig config_;
+  BeaconTracker tracker_;
+  YawRateLoop yawRate_;
+
+  bool active_ = false;
+  bool searchMode_ = false;
+  bool searchClockwise_ = true;
+  uint16_t lastLeftDuty_ = 0;
+  uint16_t lastRightDuty_ = 0;
+  uint32_t nextControlAtMs_ = 0;
+  uint32_t lastSearchFlipAtMs_ = 0;
+  bool memoryValid_ = false;
+  float memoryTheta_ = 0.0f;
+  float memorySignal_ = 0.0f;
+  uint32_t memoryAtMs_ = 0;
+  bool searchTurnLeft_ = true;
+  bool searchRecalling_ = false;
+  uint8_t sweepIndex_ = 0;
+  uint32_t sweepEndsAtMs_ = 0;
+  uint32_t lastWallJitterFlipAtMs_ = 0;
+  int8_t wallJitterSign_ = 1;
+  bool wallJitterActive_ = false;
+  // Forward term of the last control tick, kept for the yaw rate ticks.
+  float forward_ = 0.0f;
+};
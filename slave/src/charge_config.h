@@ -0,0 +1,45 @@
+#pragma once
+
+#include <charge_control.h>
+
+#include <cstdint>
+
+// When the slave ends a charge (common/charge_control). Shared with the
+// fleet simulator, which charges its battery model with the same settings.
+namespace charge_config {
+// ADC input on the tap of a divider across the battery, BATTERY_DIVIDER
+// to one. Without one (-1) there is no reading, and every charge lasts
+// NO_GAUGE_CHARGE_MS as before.
+constexpr int BATTERY_SENSE_PIN = -1;
+constexpr float BATTERY_DIVIDER = 2.0f;
+// ADC readings averaged per battery sample.
+constexpr uint8_t BATTERY_SENSE_READS = 16;
+constexpr uint32_t SAMPLE_PERIOD_MS = 500;
+// 4150 mV on the charger is about 80% charged with the charger's 4200 mV
+// constant voltage, where the taper starts; the plateau catches a battery
+// that gets there below the target.
+constexpr uint16_t TARGET_MV = 4150;
+constexpr uint32_t PLATEAU_WINDOW_MS = 10000;
+constexpr uint16_t PLATEAU_RISE_MV = 5;
+constexpr uint32_t MIN_CHARGE_MS = 3000;
+constexpr uint32_t MAX_CHARGE_MS = 120000;
+constexpr uint32_t NO_GAUGE_CHARGE_MS = 15000;
+// A `charge` progress line this often while charging.
+constexpr uint32_t PROGRESS_LOG_PERIOD_MS = 5000;
+// The stop request goes out again this often until the master answers
+// with end_chg; a lost mesh message would otherwise leave the slave on the
+// charger.
+constexpr uint32_t STOP_RESEND_PERIOD_MS = 3000;
+
+inline charge_control::ChargeConfig chargeConfig() {
+  charge_control::ChargeConfig config;
+  config.samplePeriodMs = SAMPLE_PERIOD_MS;
+  config.targetMv = TARGET_MV;
+  config.plateauWindowMs = PLATEAU_WINDOW_MS;
+  config.plateauRiseMv = PLATEAU_RISE_MV;
+  config.minChargeMs = MIN_CHARGE_MS;
+  config.maxChargeMs = MAX_CHARGE_MS;
+  config.noGaugeChargeMs = NO_GAUGE_CHARGE_MS;
+  return config;
+}
+} // namespace charge_config
@@ -0,0 +1,270 @@
+#include "flight_recorder.h"
+
+#include <LittleFS.h>
+#include <esp_heap_caps.h>
+
+namespace {
+constexpr uint32_t PSRAM_RING_BLOCKS = 128;   // 256 KiB
+constexpr uint32_t INTERNAL_RING_BLOCKS = 12; // 24 KiB
+constexpr uint32_t FILE_BLOCKS = 128;
+constexpr uint32_t SPILL_PERIOD_MS = 1000;
+constexpr uint32_t POST_TRIGGER_MS = 2000;
+constexpr uint8_t MAX_BLOCKS_PER_SPILL = 2;
+
+const char *const FLIGHT_FILE = "/flight.bin";
+const char *const FLIGHT_META_FILE = "/flight.meta";
+
+void printHex(Stream &out, const uint8_t *data, size_t length) {
+  static const char digits[] = "0123456789abcdef";
+  char chunk[65];
+  size_t fill = 0;
+  for (size_t i = 0; i < length; ++i) {
+    chunk[fill++] = digits[data[i] >> 4];
+    chunk[fill++] = digits[data[i] & 0x0F];
+    if (fill == sizeof(chunk) - 1) {
+      chunk[fill] = '\0';
+      out.print(chunk);
+      fill = 0;
+    }
+  }
+  chunk[fill] = '\0';
+  out.print(chunk);
+}
+} // namespace
+
+bool FlightRecorder::begin() {
+  if (psramFound()) {
+    ring_ = static_cast<uint8_t *>(heap_caps_malloc(
+        PSRAM_RING_BLOCKS * flight_block::SIZE, MALLOC_CAP_SPIRAM));
+    blockCount_ = ring_ != nullptr ? PSRAM_RING_BLOCKS : 0;
+  }
+  if (ring_ == nullptr) {
+    ring_ = static_cast<uint8_t *>(
+        malloc(INTERNAL_RING_BLOCKS * flight_block::SIZE));
+    blockCount_ = ring_ != nullptr ? INTERNAL_RING_BLOCKS : 0;
+  }
+  if (ring_ == nullptr) {
+    return false;
+  }
+
+  fsReady_ = LittleFS.begin(true);
+  if (fsReady_ && LittleFS.exists(FLIGHT_META_FILE)) {
+    File meta = LittleFS.open(FLIGHT_META_FILE, "r");
+    const int stored = meta.read();
+    meta.close();
+    if (stored > 0) {
+      frozen_ = true;
+      reason_ = static_cast<FlightTrigger>(stored);
+    }
+  }
+
+  if (fsReady_ && !frozen_) {
+    // Start a fresh session; only frozen recordings survive a reboot.
+    LittleFS.remove(FLIGHT_FILE);
+  }
+
+  startBlock(0);
+  return true;
+}
+
+size_t FlightRecorder::formatStatus(char *out, size_t size) const {
+  const int written =
+      snprintf(out, size, "Flight recorder: %lu blocks in %s, flash %s%s\n",
+               static_cast<unsigned long>(blockCount_),
+               blockCount_ == PSRAM_RING_BLOCKS ? "PSRAM" : "RAM",
+               fsReady_ ? "ready" : "unavailable",
+               frozen_ ? ", holding frozen recording" : "");
+  return written > 0 && static_cast<size_t>(written) < size
+             ? static_cast<size_t>(written)
+             : 0;
+}
+
+uint8_t *FlightRecorder::block(uint32_t sequence) const {
+  return ring_ + (sequence % blockCount_) * flight_block::SIZE;
+}
+
+void FlightRecorder::startBlock(uint32_t sequence) {
+  sequence_ = sequence;
+  used_ = 0;
+  recordCount_ = 0;
+  firstTMs_ = 0;
+  encoder_.reset();
+}
+
+void FlightRecorder::sealCurrentBlock() {
+  flight_block::Header header;
+  header.sequence = sequence_;
+  header.usedBytes = static_cast<uint16_t>(used_);
+  header.recordCount = recordCount_;
+  header.firstTMs = firstTMs_;
+  flight_block::writeHeader(header, block(sequence_));
+}
+
+void FlightRecorder::record(const FlightRecord &record) {
+  if (ring_ == nullptr || frozen_) {
+    return;
+  }
+
+  const size_t capacity = flight_block::SIZE - flight_block::HEADER_SIZE;
+  uint8_t *payload = block(sequence_) + flight_block::HEADER_SIZE;
+  size_t length = encoder_.encode(record, payload + used_, capacity - used_);
+  if (length == 0) {
+    sealCurrentBlock();
+    const uint32_t next = sequence_ + 1;
+    if (next - spilledSequence_ >= blockCount_) {
+      // The spill fell a whole ring behind; the oldest block is lost.
+      droppedBlocks_ += next - blockCount_ + 1 - spilledSequence_;
+      spilledSequence_ = next - blockCount_ + 1;
+    }
+    startBlock(sequence_ + 1);
+    payload = block(sequence_) + flight_block::HEADER_SIZE;
+    length = encoder_.encode(record, payload, capacity);
+  }
+
+  if (recordCount_ == 0) {
+    firstTMs_ = record.tMs;
+  }
+  used_ += length;
+  recordCount_++;
+}
+
+bool FlightRecorder::trigger(FlightTrigger reason, uint32_t now) {
+  if (frozen_ || triggered_) {
+    return false;
+  }
+  triggered_ = true;
+  reason_ = reason;
+  triggerAtMs_ = now;
+  return true;
+}
+
+void FlightRecorder::spill(uint32_t untilSequence) {
+  if (!fsReady_ || spilledSequence_ >= untilSequence) {
+    return;
+  }
+
+  if (!LittleFS.exists(FLIGHT_FILE)) {
+    File created = LittleFS.open(FLIGHT_FILE, "w");
+    created.close();
+  }
+  File file = LittleFS.open(FLIGHT_FILE, "r+");
+  if (!file) {
+    return;
+  }
+  while (spilledSequence_ < untilSequence) {
+    const uint32_t slot = spilledSequence_ % FILE_BLOCKS;
+    file.seek(slot * flight_block::SIZE);
+    file.write(block(spilledSequence_), flight_block::SIZE);
+    spilledSequence_++;
+  }
+  file.close();
+}
+
+void FlightRecorder::writeMeta() {
+  if (!fsReady_) {
+    return;
+  }
+  File meta = LittleFS.open(FLIGHT_META_FILE, "w");
+  meta.write(static_cast<uint8_t>(frozen_ ? reason_ : FlightTrigger::NONE));
+  meta.close();
+}
+
+void FlightRecorder::freeze() {
+  sealCurrentBlock();
+  // Flush everything, including the partially filled current block.
+  spill(sequence_ + 1);
+  frozen_ = true;
+  triggered_ = false;
+  writeMeta();
+}
+
+bool FlightRecorder::service(uint32_t now) {
+  if (ring_ == nullptr || frozen_) {
+    return false;
+  }
+
+  if (triggered_ && now - triggerAtMs_ >= POST_TRIGGER_MS) {
+    freeze();
+    return true;
+  }
+
+  if (now - lastSpillAtMs_ < SPILL_PERIOD_MS) {
+    return false;
+  }
+  lastSpillAtMs_ = now;
+  const uint32_t limit = spilledSequence_ + MAX_BLOCKS_PER_SPILL;
+  spill(sequence_ < limit ? sequence_ : limit);
+  return false;
+}
+
+void FlightRecorder::clear() {
+  frozen_ = false;
+  triggered_ = false;
+  reason_ = FlightTrigger::NONE;
+  droppedBlocks_ = 0;
+  spilledSequence_ = 0;
+  if (fsReady_) {
+    LittleFS.remove(FLIGHT_FILE);
+    writeMeta();
+  }
+  startBlock(0);
+}
+
+void FlightRecorder::dump(Stream &out) {
+  if (!frozen_ && ring_ != nullptr) {
+    sealCurrentBlock();
+    spill(sequence_ + 1);
+    // The current block keeps filling; spill it again once it is complete.
+    spilledSequence_ = sequence_;
+  }
+
+  File file;
+  uint32_t blocks = 0;
+  if (fsReady_ && LittleFS.exists(FLIGHT_FILE)) {
+    file = LittleFS.open(FLIGHT_FILE, "r");
+    blocks = static_cast<uint32_t>(file.size() / flight_block::SIZE);
+  }
+
+  out.printf("flight_dump,begin,%s,%lu\n", flightTriggerName(reason_),
+             static_cast<unsigned long>(blocks));
+  static uint8_t buffer[flight_block::SIZE];
+  for (uint32_t i = 0; i < blocks; ++i) {
+    if (file.read(buffer, sizeof(buffer)) != sizeof(buffer)) {
+      break;
+    }
+    flight_block::Header header;
+    if (!flight_block::readHeader(buffer, sizeof(buffer), header)) {
+      continue;
+    }
+    out.print("flight_block,");
+    printHex(out, buffer, flight_block::HEADER_SIZE + header.usedBytes);
+    out.print("\n");
+  }
+  if (file) {
+    file.close();
+  }
+  out.printf("flight_dump,end,dropped=%lu\n",
+             static_cast<unsigned long>(droppedBlocks_));
+}
+
+bool FlightRecorder::frozen() const { return frozen_; }
+
+FlightTrigger FlightRecorder::reason() const { return reason_; }
+
+uint32_t FlightRecorder::droppedBlocks() const { return droppedBlocks_; }
+
+uint32_t FlightRecorder::recordedBlocks() const { return sequence_ + 1; }
+
+const char *flightTriggerName(FlightTrigger reason) {
+  switch (reason) {
+  case FlightTrigger::NONE:
+    return "none";
+  case FlightTrigger::MANUAL:
+    return "manual";
+  case FlightTrigger::NAV_TIMEOUT:
+    return "nav_timeout";
+  case FlightTrigger::FAILED_ARRIVAL:
+    return "failed_arrival";
+  }
+  return "unknown";
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+#include <flight_record.h>
+
+enum class FlightTrigger : uint8_t {
+  NONE,
+  MANUAL,
+  NAV_TIMEOUT,
+  FAILED_ARRIVAL,
+};
+
+// Circular high-rate recorder for slave control ticks. Records are
+// delta-encoded into fixed-size blocks held in PSRAM (internal RAM when no
+// PSRAM is fitted). Completed blocks are spilled to a ring file on LittleFS
+// from loop(), never from the control tick. A trigger keeps recording for a
+// short post-trigger window, then freezes the ring and the file so the
+// failure can be dumped over USB later, even after a reboot.
+//
+// It prints nothing itself, so its status reaches the serial port through
+// the caller's output queue like every other line; only dump() writes to a
+// stream directly, and the caller holds that stream for it.
+class FlightRecorder {
+public:
+  // False when there is no memory for the ring; the recorder then stays
+  // off.
+  bool begin();
+
+  void record(const FlightRecord &record);
+  // Returns true if this call armed the trigger.
+  bool trigger(FlightTrigger reason, uint32_t now);
+  // Spills completed blocks and finishes a pending freeze. Call from loop().
+  // Returns true if this call froze the recording.
+  bool service(uint32_t now);
+
+  void clear();
+  // Prints the recording as `flight_dump`/`flight_block` hex lines.
+  void dump(Stream &out);
+
+  bool frozen() const;
+  FlightTrigger reason() const;
+  uint32_t droppedBlocks() const;
+  // Blocks written since the last clear, the current one included.
+  uint32_t recordedBlocks() const;
+  // `Flight recorder: <n> blocks in PSRAM|RAM, flash ready|unavailable
+  // [, holding frozen recording]`, newline-terminated.
+  size_t formatStatus(char *out, size_t size) const;
+
+private:
+  uint8_t *block(uint32_t sequence) const;
+  void sealCurrentBlock();
+  void startBlock(uint32_t sequence);
+  void spill(uint32_t untilSequence);
+  void writeMeta();
+  void freeze();
+
+  uint8_t *ring_ = nullptr;
+  uint32_t blockCount_ = 0;
+  uint32_t sequence_ = 0;
+  uint32_t spilledSequence_ = 0;
+  size_t used_ = 0;
+  uint16_t recordCount_ = 0;
+  uint32_t firstTMs_ = 0;
+  uint32_t droppedBlocks_ = 0;
+  FlightRecordEncoder encoder_;
+
+  bool fsReady_ = false;
+  bool frozen_ = false;
+  bool triggered_ = false;
+  FlightTrigger reason_ = FlightTrigger::NONE;
+  uint32_t triggerAtMs_ = 0;
+  uint32_t lastSpillAtMs_ = 0;
+};
+
+const char *flightTriggerName(FlightTrigger reason);
@@ -1,298 +1,923 @@
-#include "beacon_tracker.h"
+#include "beacon_navigator.h"
+#include "charge_config.h"
+#include "flight_recorder.h"
+#include "navigation_config.h"
+#include "sensor_calibrator.h"
+#include "yaw_rate_loop.h"
 #include <Arduino.h>
 #include <Dezibot.h>
+#include <atomic>
 #include <autocharge/Autocharge.hpp>
+#include <Preferences.h>
+#include <beacon_power.h>
+#include <beacon_tracker.h>
+#include <boot_timing.h>
+#include <charge_control.h>
+#include <clock_sync.h>
 #include <cmath>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <heartbeat.h>
+#include <mesh_bench.h>
+#include <mesh_messages.h>
+#include <nav_line.h>
+#include <serial_tx.h>
 
 namespace {
-constexpr uint32_t CONTROL_PERIOD_MS = 20;
 constexpr uint32_t LED_TOGGLE_PERIOD_MS = 500;
-constexpr uint32_t SEARCH_FLIP_PERIOD_MS = 1500;
 constexpr uint32_t NAV_LOG_PERIOD_MS = 200;
+// One keyframe per second at the 50 Hz control rate.
+constexpr uint16_t NAV_UPLINK_KEYFRAME_INTERVAL = 50;
+constexpr uint32_t NAV_TIMEOUT_MS = 90000;
+constexpr float RADIANS_TO_CENTI_DEG = 5729.577951308232f;
+constexpr uint8_t COMMAND_LINE_SIZE = 32;
+constexpr uint16_t SERIAL_OUT_SLOTS = 16;
+constexpr uint16_t SERIAL_OUT_SLOT_SIZE = 160;
+constexpr uint8_t CLOCK_RESPONSE_QUEUE_LENGTH = 4;
+constexpr uint8_t PONG_QUEUE_LENGTH = 16;
+constexpr uint8_t PENDING_EVENT_CAPACITY = 8;
+// The boot line goes out once the slave runs and hears the mesh, or after
+// this long without the mesh.
+constexpr uint32_t BOOT_REPORT_TIMEOUT_MS = 30000;
+constexpr uint32_t BOOT_TASK_STACK_SIZE = 4096;
+constexpr const char *BOOT_NVS_NAMESPACE = "boot";
+constexpr const char *BOOT_NVS_MASTER_KEY = "master";
+// A master id replaces the current one once this many beacon duty adverts
+// in a row carried it.
+constexpr uint8_t MASTER_ID_ADVERTS = 3;
 
-constexpr float THETA_ALPHA = 0.18f;
-constexpr float THETA_MAX_STEP_RAD = 0.35f;
-constexpr float SIGNAL_MIN = 600.0f;
-constexpr float SIGNAL_ARRIVE = 4300.0f;
-constexpr float SIGNAL_DROP_GUARD_RATIO = 0.22f;
-constexpr uint16_t SATURATION_RAW_THRESHOLD = 4080;
-constexpr uint16_t TRACKER_GUARD_HOLD_MS = 120;
-constexpr uint32_t WALL_JITTER_PERIOD_MS = 240;
-constexpr float WALL_JITTER_MAX_THETA_RAD = 0.28f;
-constexpr float WALL_JITTER_MIN_SIGNAL = 1800.0f;
-constexpr float WALL_JITTER_W_AMPLITUDE = 0.14f;
-constexpr float KP_THETA = 0.70f;
-constexpr float W_MAX = 0.65f;
-constexpr float U_MAX = 0.75f;
-constexpr float HALF_PI_RAD = 1.57079632679489661923f;
+class MotionDrive final : public DriveOutput {
+public:
+  void setLeftDuty(uint16_t duty) override { Motion::left.setSpeed(duty); }
+  void setRightDuty(uint16_t duty) override { Motion::right.setSpeed(duty); }
+  void stop() override { Motion::stop(); }
+};
 
-constexpr uint16_t DUTY_DEADZONE = 3300;
-constexpr uint16_t DUTY_MAX = 4600;
-constexpr uint16_t DUTY_SEARCH = 3560;
-constexpr uint16_t DUTY_QUANTIZE_STEP = 40;
+struct ClockAnswer {
+  clock_sync::ClockResponse response;
+  uint64_t receivedUs;
+};
 
-float clampf(float value, float low, float high) {
-  if (value < low) {
-    return low;
+struct PongArrival {
+  mesh_bench::Pong pong;
+  uint64_t receivedUs;
+};
+
+// Stamped with the local clock when it happens, sent once the clock is
+// synchronized.
+struct PendingEvent {
+  uint64_t localUs;
+  const char *name;
+};
+
+uint64_t localUs() { return static_cast<uint64_t>(esp_timer_get_time()); }
+} // namespace
+
+MotionDrive motionDrive;
+BeaconNavigator navigator;
+FlightRecorder flightRecorder;
+SensorCalibrator calibrator;
+// Everything printed from the step functions goes through the TX task.
+SerialTx<SERIAL_OUT_SLOTS, SERIAL_OUT_SLOT_SIZE> serialOut;
+NavLineWriter navUplink(NAV_UPLINK_KEYFRAME_INTERVAL);
+beacon_power::ReportWindow beaconReport(
+    navigation_config::BEACON_REPORT_PERIOD_MS, 40,
+    navigation_config::BEACON_REPORT_SLOW_PERIOD_MS,
+    navigation_config::BEACON_REPORT_FAST_SIGNAL);
+// State, bearing and beacon report go to the master as one heartbeat; see
+// common/heartbeat. A due beacon report sends one right away.
+heartbeat::HeartbeatScheduler heartbeats;
+// Written from the mesh task when the master advertises a new duty.
+std::atomic<uint16_t> advertisedBeaconDuty(
+    navigation_config::BEACON_REFERENCE_DUTY);
+uint16_t appliedBeaconDuty = navigation_config::BEACON_REFERENCE_DUTY;
+// Clock answers are stamped on the mesh task and handled in loop().
+clock_sync::ClockSyncClient clockSync;
+QueueHandle_t clockAnswers = nullptr;
+uint32_t nodeId = 0;
+PendingEvent pendingEvents[PENDING_EVENT_CAPACITY];
+uint8_t pendingEventCount = 0;
+uint32_t droppedEvents = 0;
+// Mesh latency benchmark (`bench`); pongs are stamped on the mesh task.
+mesh_bench::PingBench meshBench;
+QueueHandle_t pongArrivals = nullptr;
+// Typed mesh frames, routed by their tag; see common/mesh_proto.
+mesh_proto::Dispatcher meshMessages;
+
+// Boot: settings and the flight recorder's file system come up in a task
+// of their own while Dezibot's begin() joins the mesh; see common/
+// boot_timing for the timeline.
+boot_timing::BootTimeline bootTimeline;
+SemaphoreHandle_t settingsLoaded = nullptr;
+bool calibrationLoaded = false;
+uint32_t cachedMasterId = 0;
+std::atomic<bool> flightRecorderReady(false);
+// The master's node id from its beacon duty adverts, stored in loop().
+// The mesh task counts the adverts in a row that carry the same id.
+std::atomic<uint32_t> advertisedMasterId(0);
+uint32_t masterIdRun = 0;
+uint8_t masterIdRunLength = 0;
+bool firstTickDone = false;
+
+// Steering through the gyro (`yaw on|off`); see YawRateLoop. The bias is
+// learned while the robot stands.
+bool yawRateLoop = navigation_config::YAW_RATE_LOOP;
+float gyroBiasLsb = 0.0f;
+bool gyroBiasKnown = false;
+uint32_t lastGyroBiasAtMs = 0;
+// Settle time of the walk under way, reported on arrival, with the time
+// the wall jitter steered and the bearing was held as reflected.
+HeadingSettle walkHeading;
+uint32_t walkJitterMs = 0;
+uint32_t walkReflectedMs = 0;
+// Ends the charge on the battery voltage; see common/charge_control.
+charge_control::ChargeTerminator chargeTerminator(
+    charge_config::chargeConfig());
+bool charging = false;
+uint32_t lastChargeLogAtMs = 0;
+// The stop request went out and is repeated until the master answers.
+bool requestedStop = false;
+uint32_t lastStopRequestAtMs = 0;
+uint16_t stopResends = 0;
+
+bool ledsOn = false;
+uint32_t lastLedToggleAtMs = 0;
+uint32_t lastLogAtMs = 0;
+uint32_t navigationStartedAtMs = 0;
+bool navigationTimedOut = false;
+SlaveState lastStepState = SlaveState::WORK;
+bool stepSeen = false;
+char commandLine[COMMAND_LINE_SIZE];
+uint8_t commandLength = 0;
+uint32_t lastCalibrationTickAtMs = 0;
+
+const char *stepEventName(SlaveState state) {
+  switch (state) {
+  case SlaveState::WORK:
+    return "work";
+  case SlaveState::WALKING_TO_CHARGE:
+    return "walk_to_charge";
+  case SlaveState::WAIT_CHARGE:
+    return "wait_charge";
+  case SlaveState::WALKING_INTO_CHARGE:
+    return "walk_into_charge";
+  case SlaveState::CHARGE:
+    return "charge";
+  case SlaveState::EXITING_CHARGE:
+    return "exit_charge";
   }
-  if (value > high) {
-    return high;
+  return "unknown";
+}
+
+// Charging-cycle milestone for the mesh timeline; `name` must be a literal.
+void noteEvent(const char *name) {
+  if (pendingEventCount == PENDING_EVENT_CAPACITY) {
+    memmove(pendingEvents, pendingEvents + 1,
+            sizeof(pendingEvents) - sizeof(pendingEvents[0]));
+    pendingEventCount--;
+    droppedEvents++;
   }
-  return value;
+  pendingEvents[pendingEventCount].localUs = localUs();
+  pendingEvents[pendingEventCount].name = name;
+  pendingEventCount++;
 }
 
-uint16_t quantizeDuty(uint16_t duty) {
-  if (duty == 0) {
-    return 0;
+// Battery voltage through the sense divider, BATTERY_UNKNOWN without one.
+uint16_t readBatteryMv() {
+  if (charge_config::BATTERY_SENSE_PIN < 0) {
+    return heartbeat::BATTERY_UNKNOWN;
+  }
+  uint32_t sum = 0;
+  for (uint8_t i = 0; i < charge_config::BATTERY_SENSE_READS; ++i) {
+    sum += analogReadMilliVolts(charge_config::BATTERY_SENSE_PIN);
   }
+  return static_cast<uint16_t>(lroundf(
+      static_cast<float>(sum) / charge_config::BATTERY_SENSE_READS *
+      charge_config::BATTERY_DIVIDER));
+}
 
-  if (duty > DUTY_MAX) {
-    duty = DUTY_MAX;
+void sendHeartbeat(Slave *slave, uint32_t now,
+                   const beacon_power::BeaconReport *report = nullptr) {
+  heartbeat::Status status;
+  if (report != nullptr) {
+    status.flags |= heartbeat::FLAG_REPORT;
+    status.report = *report;
+  }
+  if (navigator.active() && navigator.state().detected) {
+    status.flags |= heartbeat::FLAG_DETECTED;
+    status.thetaCentiDeg = static_cast<int16_t>(
+        lroundf(navigator.state().filteredTheta * RADIANS_TO_CENTI_DEG));
+  }
+  if (charging) {
+    status.batteryMv = chargeTerminator.filteredMv();
+    const uint32_t remaining = chargeTerminator.remainingMs(now);
+    if (remaining != charge_control::REMAINING_UNKNOWN) {
+      status.flags |= heartbeat::FLAG_CHARGE_ESTIMATE;
+      const uint32_t remainingS = (remaining + 999U) / 1000U;
+      status.chargeRemainingS =
+          remainingS < heartbeat::CHARGE_REMAINING_UNKNOWN
+              ? static_cast<uint16_t>(remainingS)
+              : heartbeat::CHARGE_REMAINING_UNKNOWN - 1U;
+      status.chargePercent = chargeTerminator.progressPercent(now);
+    }
+  } else {
+    status.batteryMv = readBatteryMv();
   }
+  heartbeats.take(nodeId, now, status);
+  char message[mesh_proto::MESSAGE_CAPACITY];
+  if (mesh_proto::encodeHeartbeat(status, message, sizeof(message)) > 0) {
+    slave->communication.sendMessage(message);
+  }
+}
 
-  uint16_t quantized = static_cast<uint16_t>(
-      ((duty + (DUTY_QUANTIZE_STEP / 2)) / DUTY_QUANTIZE_STEP) *
-      DUTY_QUANTIZE_STEP);
+// Step functions block for seconds at a time, so this also runs from
+// noteStep() to get urgent transitions out before the step's delay.
+void serviceHeartbeat(Slave *slave) {
+  const uint32_t now = millis();
+  if (heartbeats.due(now)) {
+    sendHeartbeat(slave, now);
+  }
+}
 
-  if (quantized < DUTY_DEADZONE) {
-    quantized = DUTY_DEADZONE;
+void noteStep(Slave *slave, SlaveState state) {
+  if (!stepSeen || state != lastStepState) {
+    noteEvent(stepEventName(state));
+    // Requests are pending until the state they lead to is reached.
+    if (state != SlaveState::WORK) {
+      heartbeats.setRequest(heartbeat::FLAG_WANTS_CHARGE, false);
+    }
+    if (state != SlaveState::CHARGE) {
+      heartbeats.setRequest(heartbeat::FLAG_WANTS_STOP, false);
+      // However the charge was left (stopped, cancelled or reset to work),
+      // the next one starts over.
+      charging = false;
+      requestedStop = false;
+      stopResends = 0;
+    }
   }
-  if (quantized > DUTY_MAX) {
-    quantized = DUTY_MAX;
+  stepSeen = true;
+  lastStepState = state;
+  heartbeats.setState(
+      static_cast<heartbeat::SlaveState>(static_cast<uint8_t>(state)),
+      millis());
+  serviceHeartbeat(slave);
+}
+
+void resetNavigation(Slave *slave) {
+  (void)slave;
+  navigator.reset();
+  navUplink.reset();
+  beaconReport.reset();
+  ledsOn = false;
+  lastLedToggleAtMs = 0;
+  lastLogAtMs = 0;
+}
+
+void beginNavigation(Slave *slave, uint32_t now) {
+  navigator.begin(now);
+  walkHeading.reset();
+  walkJitterMs = 0;
+  walkReflectedMs = 0;
+  navigationStartedAtMs = now;
+  navigationTimedOut = false;
+  ledsOn = true;
+  lastLedToggleAtMs = now;
+  lastLogAtMs = now;
+  slave->multiColorLight.setTopLeds(YELLOW);
+}
+
+void toggleNavigationLed(Slave *slave, uint32_t now) {
+  if (now - lastLedToggleAtMs < LED_TOGGLE_PERIOD_MS) {
+    return;
   }
 
-  return quantized;
+  if (ledsOn) {
+    slave->multiColorLight.turnOffLed(TOP);
+  } else {
+    slave->multiColorLight.setTopLeds(YELLOW);
+  }
+  ledsOn = !ledsOn;
+  lastLedToggleAtMs = now;
 }
 
-uint16_t mapNormalizedToDuty(float normalized) {
-  if (normalized <= 0.0f) {
-    return 0;
+// Yaw rate from the IMU gyro in rad/s, counter-clockwise positive.
+float readYawRate(Slave *slave) {
+  const IMUResult rotation = slave->motion.detection.getRotation();
+  return (static_cast<float>(rotation.z) - gyroBiasLsb) *
+         navigation_config::GYRO_RAD_S_PER_LSB;
+}
+
+// Runs from loop() while nothing drives the wheels.
+void serviceGyroBias(Slave *slave) {
+  const uint32_t now = millis();
+  if (now - lastGyroBiasAtMs < navigation_config::GYRO_BIAS_PERIOD_MS) {
+    return;
+  }
+  lastGyroBiasAtMs = now;
+  const float raw =
+      static_cast<float>(slave->motion.detection.getRotation().z);
+  if (gyroBiasKnown) {
+    gyroBiasLsb += (raw - gyroBiasLsb) * navigation_config::GYRO_BIAS_ALPHA;
+  } else {
+    gyroBiasLsb = raw;
+    gyroBiasKnown = true;
   }
+}
 
-  normalized = clampf(normalized, 0.0f, 1.0f);
-  const float duty = static_cast<float>(DUTY_DEADZONE) +
-                     normalized * static_cast<float>(DUTY_MAX - DUTY_DEADZONE);
-  return quantizeDuty(static_cast<uint16_t>(duty));
+void triggerFlightRecorder(FlightTrigger reason, uint32_t now) {
+  if (flightRecorderReady.load() && flightRecorder.trigger(reason, now)) {
+    serialOut.printf("Flight recorder triggered: %s\n",
+                     flightTriggerName(reason));
+  }
 }
 
-bool isFrontDominant(const BeaconTrackerState &state) {
-  return state.front >= state.back && state.front >= state.left &&
-         state.front >= state.right;
+void recordFlightTick(const BeaconTrackerState &state, uint32_t tickUs) {
+  if (!flightRecorderReady.load()) {
+    return;
+  }
+  FlightRecord record;
+  record.tMs = state.timestampMs;
+  record.raw[0] = static_cast<uint16_t>(state.rawFront);
+  record.raw[1] = static_cast<uint16_t>(state.rawBack);
+  record.raw[2] = static_cast<uint16_t>(state.rawLeft);
+  record.raw[3] = static_cast<uint16_t>(state.rawRight);
+  record.amplitude[0] = static_cast<uint16_t>(state.front + 0.5f);
+  record.amplitude[1] = static_cast<uint16_t>(state.back + 0.5f);
+  record.amplitude[2] = static_cast<uint16_t>(state.left + 0.5f);
+  record.amplitude[3] = static_cast<uint16_t>(state.right + 0.5f);
+  record.thetaCentiDeg =
+      static_cast<int16_t>(lroundf(state.filteredTheta * RADIANS_TO_CENTI_DEG));
+  record.signal = static_cast<uint16_t>(state.totalSignal + 0.5f);
+  record.dutyLeft = navigator.leftDuty();
+  record.dutyRight = navigator.rightDuty();
+  record.tickUs = static_cast<uint16_t>(tickUs > 0xFFFF ? 0xFFFF : tickUs);
+  record.slaveState = static_cast<uint8_t>(lastStepState);
+
+  const uint32_t saturation = navigation_config::SATURATION_RAW_THRESHOLD;
+  if (state.detected) {
+    record.flags |= FlightRecord::FLAG_DETECTED;
+  }
+  if (navigator.searchMode()) {
+    record.flags |= FlightRecord::FLAG_SEARCH;
+  }
+  if (state.rawFront >= saturation || state.rawBack >= saturation ||
+      state.rawLeft >= saturation || state.rawRight >= saturation) {
+    record.flags |= FlightRecord::FLAG_SATURATED;
+  }
+  if (navigationTimedOut) {
+    record.flags |= FlightRecord::FLAG_EVENT;
+  }
+  flightRecorder.record(record);
 }
-} // namespace
 
-BeaconTrackerConfig trackerConfig;
-BeaconTracker tracker;
+BeaconTrackerConfig calibratedTrackerConfig() {
+  BeaconTrackerConfig config = navigation_config::trackerConfig();
+  calibrator.applyTo(config);
+  return config;
+}
 
-bool navigationActive = false;
-bool ledsOn = false;
-bool searchClockwise = true;
-uint16_t lastLeftDuty = 0;
-uint16_t lastRightDuty = 0;
-uint32_t nextControlAtMs = 0;
-uint32_t lastLedToggleAtMs = 0;
-uint32_t lastSearchFlipAtMs = 0;
-uint32_t lastLogAtMs = 0;
-uint32_t lastWallJitterFlipAtMs = 0;
-int8_t wallJitterSign = 1;
+BeaconNavigatorConfig steeringNavigatorConfig() {
+  BeaconNavigatorConfig config = navigation_config::navigatorConfig();
+  config.yawRateLoop = yawRateLoop;
+  return config;
+}
 
-void applyMotorDuties(Slave *slave, uint16_t leftDuty, uint16_t rightDuty) {
-  leftDuty = quantizeDuty(leftDuty);
-  rightDuty = quantizeDuty(rightDuty);
+void rebuildNavigator() {
+  navigator = BeaconNavigator(&motionDrive, steeringNavigatorConfig(),
+                              calibratedTrackerConfig());
+  navigator.setBeaconDuty(appliedBeaconDuty);
+}
 
-  if (leftDuty != lastLeftDuty) {
-    slave->motion.left.setSpeed(leftDuty);
-    lastLeftDuty = leftDuty;
+void onClockResponse(void *context, const mesh_proto::Envelope &envelope,
+                     mesh_proto::Reader &payload) {
+  (void)context;
+  ClockAnswer answer;
+  answer.receivedUs = envelope.receivedUs;
+  if (clockAnswers != nullptr &&
+      mesh_proto::readClockResponse(payload, answer.response) &&
+      answer.response.node == nodeId) {
+    xQueueSend(clockAnswers, &answer, 0);
   }
+}
 
-  if (rightDuty != lastRightDuty) {
-    slave->motion.right.setSpeed(rightDuty);
-    lastRightDuty = rightDuty;
+void onBeaconDuty(void *context, const mesh_proto::Envelope &envelope,
+                  mesh_proto::Reader &payload) {
+  (void)context;
+  uint16_t duty = 0;
+  uint32_t masterId = 0;
+  if (!mesh_proto::readBeaconDuty(payload, duty, masterId)) {
+    return;
+  }
+  advertisedBeaconDuty.store(duty);
+  // Only the master itself may name it. The mesh does not say who sent a
+  // broadcast (envelope.from is 0), so there the id has to come back in
+  // MASTER_ID_ADVERTS adverts in a row: a stray advert, or one from a
+  // node that only claims the id while the master keeps advertising its
+  // own, never gets that far.
+  if (masterId == 0 || (envelope.from != 0 && envelope.from != masterId)) {
+    masterIdRunLength = 0;
+    return;
+  }
+  if (masterId != masterIdRun) {
+    masterIdRun = masterId;
+    masterIdRunLength = 0;
+  }
+  if (masterIdRunLength < MASTER_ID_ADVERTS) {
+    masterIdRunLength++;
+  }
+  if (masterIdRunLength == MASTER_ID_ADVERTS) {
+    advertisedMasterId.store(masterId);
   }
 }
 
-void resetNavigation(Slave *slave) {
-  if (navigationActive || lastLeftDuty != 0 || lastRightDuty != 0) {
-    slave->motion.stop();
+void onBroadcast(String &message) {
+  mesh_proto::Envelope envelope;
+  envelope.receivedUs = localUs();
+  bootTimeline.mark(boot_timing::Phase::MESH_READY, envelope.receivedUs);
+  if (meshMessages.dispatchText(envelope, message.c_str(), message.length()) !=
+      mesh_proto::DispatchStatus::NOT_A_FRAME) {
+    return;
+  }
+  PongArrival arrival;
+  if (pongArrivals != nullptr &&
+      mesh_bench::parsePong(message.c_str(), arrival.pong) &&
+      arrival.pong.ping.node == nodeId) {
+    arrival.receivedUs = envelope.receivedUs;
+    xQueueSend(pongArrivals, &arrival, 0);
   }
+}
 
-  tracker.reset();
-  navigationActive = false;
-  ledsOn = false;
-  searchClockwise = true;
-  nextControlAtMs = 0;
-  lastLedToggleAtMs = 0;
-  lastSearchFlipAtMs = 0;
-  lastLogAtMs = 0;
-  lastWallJitterFlipAtMs = 0;
-  wallJitterSign = 1;
-  lastLeftDuty = 0;
-  lastRightDuty = 0;
+void followBeaconDuty() {
+  const uint16_t duty = advertisedBeaconDuty.load();
+  if (duty != appliedBeaconDuty) {
+    appliedBeaconDuty = duty;
+    navigator.setBeaconDuty(duty);
+  }
 }
 
-void beginNavigation(Slave *slave, uint32_t now) {
-  resetNavigation(slave);
-  navigationActive = true;
-  ledsOn = true;
-  searchClockwise = true;
-  nextControlAtMs = now;
-  lastLedToggleAtMs = now;
-  lastSearchFlipAtMs = now;
-  lastLogAtMs = now;
-  lastWallJitterFlipAtMs = now;
-  slave->multiColorLight.setTopLeds(YELLOW);
+// Tells the master what this slave sees of the beacon so it can set the
+// beacon power; see common/beacon_power. The report rides on a heartbeat,
+// so while walking the report window sets the heartbeat rate.
+void reportBeacon(Slave *slave, const BeaconTrackerState &state,
+                  uint32_t now) {
+  if (!beaconReport.add(state.beaconSignal, state.saturated, now)) {
+    return;
+  }
+  const beacon_power::BeaconReport report =
+      beaconReport.take(nodeId, appliedBeaconDuty);
+  sendHeartbeat(slave, now, &report);
 }
 
-bool shouldRunControl(uint32_t now) {
-  if (static_cast<int32_t>(now - nextControlAtMs) < 0) {
-    return false;
+// Pending events go out in the mesh timebase, locally and to the master;
+// until the first exchanges they wait.
+void sendEvents(Slave *slave, const MasterData &master) {
+  if (!clockSync.synced()) {
+    return;
   }
+  char line[clock_sync::EVENT_CAPACITY];
+  for (uint8_t i = 0; i < pendingEventCount; ++i) {
+    if (clock_sync::formatEvent(
+            nodeId, clockSync.toMesh(pendingEvents[i].localUs),
+            clockSync.errorUs(), pendingEvents[i].name, nodeId, line,
+            sizeof(line)) == 0) {
+      continue;
+    }
+    serialOut.println(line);
+    String meshMessage = "log:";
+    meshMessage += line;
+    slave->communication.unicast(master.id, meshMessage);
+  }
+  pendingEventCount = 0;
+  if (droppedEvents > 0) {
+    serialOut.printf("clock_sync,dropped_events=%lu\n",
+                     static_cast<unsigned long>(droppedEvents));
+    droppedEvents = 0;
+  }
+}
 
-  nextControlAtMs += CONTROL_PERIOD_MS;
-  if (static_cast<int32_t>(now - nextControlAtMs) >
-      static_cast<int32_t>(CONTROL_PERIOD_MS)) {
-    nextControlAtMs = now + CONTROL_PERIOD_MS;
+// Runs between state machine steps, which can block for seconds; answers
+// carry the time they arrived, so that only delays the next exchange.
+void serviceClockSync(Slave *slave, const MasterData &master) {
+  const bool wasSynced = clockSync.synced();
+  ClockAnswer answer;
+  while (xQueueReceive(clockAnswers, &answer, 0) == pdTRUE) {
+    if (clockSync.onResponse(answer.response, answer.receivedUs) &&
+        !wasSynced && clockSync.synced()) {
+      serialOut.printf("clock_sync,synced,offset_us=%lld,err_us=%lu\n",
+                       static_cast<long long>(clockSync.offsetUs(localUs())),
+                       static_cast<unsigned long>(clockSync.errorUs()));
+    }
   }
 
-  return true;
+  clock_sync::ClockRequest request;
+  char message[mesh_proto::MESSAGE_CAPACITY];
+  if (clockSync.poll(nodeId, localUs(), request) &&
+      mesh_proto::encodeClockRequest(request, message, sizeof(message)) > 0) {
+    slave->communication.sendMessage(message);
+  }
+  sendEvents(slave, master);
 }
 
-void toggleNavigationLed(Slave *slave, uint32_t now) {
-  if (now - lastLedToggleAtMs < LED_TOGGLE_PERIOD_MS) {
+void printCalibration() {
+  const ir_calibration::Calibration &calibration = calibrator.calibration();
+  serialOut.printf(
+      "ir_cal,flags=%u,offset=%u/%u/%u/%u,gain_q12=%u/%u/%u/%u,"
+      "ambient=%u/%u/%u/%u\n",
+      static_cast<unsigned>(calibration.flags),
+      static_cast<unsigned>(calibration.offset[0]),
+      static_cast<unsigned>(calibration.offset[1]),
+      static_cast<unsigned>(calibration.offset[2]),
+      static_cast<unsigned>(calibration.offset[3]),
+      static_cast<unsigned>(calibration.gainQ12[0]),
+      static_cast<unsigned>(calibration.gainQ12[1]),
+      static_cast<unsigned>(calibration.gainQ12[2]),
+      static_cast<unsigned>(calibration.gainQ12[3]),
+      static_cast<unsigned>(calibration.ambient[0]),
+      static_cast<unsigned>(calibration.ambient[1]),
+      static_cast<unsigned>(calibration.ambient[2]),
+      static_cast<unsigned>(calibration.ambient[3]));
+}
+
+void printCalibrationStep() {
+  const CalibrationStep step = calibrator.lastStep();
+  serialOut.printf("ir_cal_step,%s,%s\n", calibrationStepName(step),
+                   ir_calibration::fitStatusName(calibrator.status()));
+  if (step == CalibrationStep::DARK) {
+    const ir_calibration::DarkCapture &dark = calibrator.dark();
+    serialOut.printf("ir_cal_dark,mean=%.1f/%.1f/%.1f/%.1f,"
+                     "noise=%.1f/%.1f/%.1f/%.1f\n",
+                     dark.mean(0), dark.mean(1), dark.mean(2), dark.mean(3),
+                     dark.noise(0), dark.noise(1), dark.noise(2),
+                     dark.noise(3));
+  } else if (step == CalibrationStep::SPIN) {
+    const ir_calibration::SpinCapture &spin = calibrator.spin();
+    serialOut.printf("ir_cal_spin,peak=%.0f/%.0f/%.0f/%.0f,"
+                     "dominant=%.2f/%.2f/%.2f/%.2f,saturated=%.3f\n",
+                     spin.peak(0), spin.peak(1), spin.peak(2), spin.peak(3),
+                     spin.dominantShare(0), spin.dominantShare(1),
+                     spin.dominantShare(2), spin.dominantShare(3),
+                     spin.saturatedShare());
+  } else if (step == CalibrationStep::AMBIENT) {
+    const ir_calibration::AmbientCheck &ambient = calibrator.ambient();
+    const ir_calibration::Calibration &calibration = calibrator.calibration();
+    serialOut.printf("ir_cal_ambient,level=%u/%u/%u/%u\n",
+                     static_cast<unsigned>(ambient.level(calibration, 0)),
+                     static_cast<unsigned>(ambient.level(calibration, 1)),
+                     static_cast<unsigned>(ambient.level(calibration, 2)),
+                     static_cast<unsigned>(ambient.level(calibration, 3)));
+  }
+  printCalibration();
+}
+
+void startCalibration(CalibrationStep step) {
+  if (navigator.active()) {
+    serialOut.println("ir_cal: not while walking to the charger");
     return;
   }
+  const uint32_t now = millis();
+  calibrator.start(step, now);
+  lastCalibrationTickAtMs = now;
+  serialOut.printf("ir_cal: %s started\n", calibrationStepName(step));
+}
 
-  if (ledsOn) {
-    slave->multiColorLight.turnOffLed(TOP);
-  } else {
-    slave->multiColorLight.setTopLeds(YELLOW);
+// Runs instead of the slave state machine while a calibration step is
+// active, at the control rate.
+void serviceCalibration(Slave *slave) {
+  const uint32_t now = millis();
+  if (now - lastCalibrationTickAtMs < navigation_config::CONTROL_PERIOD_MS) {
+    return;
+  }
+  lastCalibrationTickAtMs = now;
+  const uint16_t raw[ir_calibration::CHANNELS] = {
+      static_cast<uint16_t>(slave->lightDetection.getValue(IR_FRONT)),
+      static_cast<uint16_t>(slave->lightDetection.getValue(IR_BACK)),
+      static_cast<uint16_t>(slave->lightDetection.getValue(IR_LEFT)),
+      static_cast<uint16_t>(slave->lightDetection.getValue(IR_RIGHT))};
+  if (calibrator.update(raw, now)) {
+    printCalibrationStep();
   }
-  ledsOn = !ledsOn;
-  lastLedToggleAtMs = now;
 }
 
-void driveSearch(Slave *slave, uint32_t now) {
-  if (now - lastSearchFlipAtMs >= SEARCH_FLIP_PERIOD_MS) {
-    searchClockwise = !searchClockwise;
-    lastSearchFlipAtMs = now;
+void startBench(const char *arguments) {
+  if (navigator.active() || calibrator.active()) {
+    serialOut.println("mesh_bench: not while walking or calibrating");
+    return;
   }
+  unsigned seconds = 30;
+  unsigned pingMs = 100;
+  unsigned loadHz = 0;
+  sscanf(arguments, "%u %u %u", &seconds, &pingMs, &loadHz);
+  mesh_bench::BenchConfig config;
+  config.durationMs = seconds * 1000U;
+  config.pingPeriodMs = pingMs > 0 ? pingMs : 1;
+  config.loadHz = loadHz;
+  xQueueReset(pongArrivals);
+  meshBench.start(config, localUs());
+  serialOut.printf("mesh_bench: started, %us, ping every %u ms, load %u Hz\n",
+                   seconds, config.pingPeriodMs, loadHz);
+}
 
-  if (searchClockwise) {
-    applyMotorDuties(slave, 0, DUTY_SEARCH);
-  } else {
-    applyMotorDuties(slave, DUTY_SEARCH, 0);
+void printBench() {
+  static const char *const DIRECTIONS[] = {"rtt", "up", "down"};
+  char line[mesh_bench::MESSAGE_CAPACITY];
+  for (size_t k = 0; k < mesh_bench::KIND_COUNT; ++k) {
+    const mesh_bench::Kind kind = static_cast<mesh_bench::Kind>(k);
+    const mesh_bench::KindStats &stats = meshBench.stats(kind);
+    const LatencyHistogram *histograms[] = {&stats.roundTrip, &stats.uplink,
+                                            &stats.downlink};
+    for (size_t d = 0; d < 3; ++d) {
+      if ((d == 0 || histograms[d]->count() > 0) &&
+          mesh_bench::formatSummary(kind, DIRECTIONS[d], *histograms[d], stats,
+                                    line, sizeof(line)) > 0) {
+        serialOut.println(line);
+      }
+    }
   }
+  serialOut.printf("mesh_bench: done, load_sent=%lu\n",
+                   static_cast<unsigned long>(meshBench.loadSent()));
 }
 
-float wallJitterTerm(const BeaconTrackerState &state) {
-  const bool likelyNearWall =
-      state.detected && isFrontDominant(state) &&
-      state.totalSignal >= WALL_JITTER_MIN_SIGNAL &&
-      std::fabs(state.filteredTheta) <= WALL_JITTER_MAX_THETA_RAD;
-  if (!likelyNearWall) {
-    return 0.0f;
+// Runs instead of the slave state machine while a benchmark is active.
+// Pings and their pongs go over the broadcast channel, load over the same
+// unicast uplink as the navz log.
+void serviceBench(Slave *slave, const MasterData &master) {
+  PongArrival arrival;
+  while (xQueueReceive(pongArrivals, &arrival, 0) == pdTRUE) {
+    if (clockSync.synced()) {
+      const int64_t offset = clockSync.offsetUs(arrival.receivedUs);
+      meshBench.onPong(arrival.pong, arrival.receivedUs, &offset);
+    } else {
+      meshBench.onPong(arrival.pong, arrival.receivedUs);
+    }
+  }
+
+  const uint64_t now = localUs();
+  char message[mesh_bench::MESSAGE_CAPACITY];
+  for (mesh_bench::PingBench::Send send = meshBench.poll(
+           nodeId, now, message, sizeof(message));
+       send != mesh_bench::PingBench::Send::NONE;
+       send = meshBench.poll(nodeId, now, message, sizeof(message))) {
+    if (send == mesh_bench::PingBench::Send::PING) {
+      slave->communication.sendMessage(message);
+    } else {
+      slave->communication.unicast(master.id, message);
+    }
+  }
+  if (meshBench.finished(now)) {
+    printBench();
   }
+}
 
-  if (state.timestampMs - lastWallJitterFlipAtMs >= WALL_JITTER_PERIOD_MS) {
-    wallJitterSign = -wallJitterSign;
-    lastWallJitterFlipAtMs = state.timestampMs;
+void printBootTimeline() {
+  const char *reason =
+      boot_timing::resetReasonName(static_cast<uint8_t>(esp_reset_reason()));
+  char line[boot_timing::LINE_CAPACITY];
+  if (bootTimeline.format(nodeId, reason, line, sizeof(line)) > 0) {
+    serialOut.print(line);
   }
+}
 
-  return static_cast<float>(wallJitterSign) * WALL_JITTER_W_AMPLITUDE;
+void setSteering(bool yawRate) {
+  if (navigator.active()) {
+    serialOut.println("steering: not while walking to the charger");
+    return;
+  }
+  yawRateLoop = yawRate;
+  rebuildNavigator();
+  serialOut.printf("steering: %s\n", yawRateLoop ? "yaw_rate" : "open");
 }
 
-void driveTracking(Slave *slave, const BeaconTrackerState &state) {
-  const float theta = state.filteredTheta;
-  const float w =
-      clampf(KP_THETA * theta + wallJitterTerm(state), -W_MAX, W_MAX);
+void handleCommand(const char *command) {
+  if (strncmp(command, "flight", 6) == 0 && !flightRecorderReady.load()) {
+    serialOut.println("Flight recorder: still starting");
+  } else if (strcmp(command, "flight dump") == 0) {
+    serialOut.lockOutput();
+    flightRecorder.dump(Serial);
+    serialOut.unlockOutput();
+  } else if (strcmp(command, "flight freeze") == 0) {
+    triggerFlightRecorder(FlightTrigger::MANUAL, millis());
+  } else if (strcmp(command, "flight clear") == 0) {
+    flightRecorder.clear();
+    serialOut.println("Flight recorder cleared");
+  } else if (strcmp(command, "boot") == 0) {
+    printBootTimeline();
+  } else if (strcmp(command, "yaw on") == 0 ||
+             strcmp(command, "yaw off") == 0) {
+    setSteering(strcmp(command, "yaw on") == 0);
+  } else if (strcmp(command, "yaw") == 0) {
+    serialOut.printf("steering: %s, gyro bias %.1f counts\n",
+                     yawRateLoop ? "yaw_rate" : "open", gyroBiasLsb);
+  } else if (strcmp(command, "cal dark") == 0) {
+    startCalibration(CalibrationStep::DARK);
+  } else if (strcmp(command, "cal spin") == 0) {
+    startCalibration(CalibrationStep::SPIN);
+  } else if (strcmp(command, "cal ambient") == 0) {
+    startCalibration(CalibrationStep::AMBIENT);
+  } else if (strcmp(command, "cal save") == 0) {
+    serialOut.println(calibrator.save() ? "ir_cal: saved"
+                                        : "ir_cal: save failed");
+    rebuildNavigator();
+  } else if (strcmp(command, "cal show") == 0) {
+    printCalibration();
+  } else if (strcmp(command, "cal clear") == 0) {
+    calibrator.clear();
+    rebuildNavigator();
+    serialOut.println("ir_cal: cleared");
+  } else if (strcmp(command, "bench stop") == 0) {
+    if (meshBench.active()) {
+      meshBench.stop();
+      printBench();
+    }
+  } else if (strncmp(command, "bench", 5) == 0 &&
+             (command[5] == '\0' || command[5] == ' ')) {
+    startBench(command + 5);
+  } else {
+    serialOut.printf("Unknown command: %s\n", command);
+  }
+}
 
-  float u = U_MAX * std::fmax(0.0f, std::cos(theta));
-  if (std::fabs(theta) > HALF_PI_RAD) {
-    u = 0.0f;
+void pollCommands() {
+  while (Serial.available() > 0) {
+    const char ch = static_cast<char>(Serial.read());
+    if (ch == '\r') {
+      continue;
+    }
+    if (ch != '\n') {
+      if (commandLength < COMMAND_LINE_SIZE - 1) {
+        commandLine[commandLength++] = ch;
+      }
+      continue;
+    }
+    commandLine[commandLength] = '\0';
+    if (commandLength > 0) {
+      handleCommand(commandLine);
+    }
+    commandLength = 0;
   }
+}
 
-  // For this drivetrain, increasing right motor turns the robot left.
-  // So steering mix is mirrored: right-turn intent must boost left motor.
-  const float mLeft = clampf(u - w, 0.0f, 1.0f);
-  const float mRight = clampf(u + w, 0.0f, 1.0f);
+void logNavigation(const BeaconTrackerState &state, bool searchMode) {
+  serialOut.printf(
+      "beacon_nav,%lu,%s,%lu,%lu,%lu,%lu,%.1f,%.1f,%.1f,%.1f,%.2f,%.1f,%u,%u,"
+      "%u\n",
+      static_cast<unsigned long>(state.timestampMs),
+      searchMode ? "search" : "track",
+      static_cast<unsigned long>(state.rawFront),
+      static_cast<unsigned long>(state.rawBack),
+      static_cast<unsigned long>(state.rawLeft),
+      static_cast<unsigned long>(state.rawRight), state.front, state.back,
+      state.left, state.right, state.filteredTheta * 57.29577951308232f,
+      state.totalSignal, static_cast<unsigned>(state.detected ? 1 : 0),
+      static_cast<unsigned>(navigator.leftDuty()),
+      static_cast<unsigned>(navigator.rightDuty()));
+  if (yawRateLoop && !searchMode) {
+    serialOut.printf("yaw_rate,%lu,%.1f,%.1f\n",
+                     static_cast<unsigned long>(state.timestampMs),
+                     navigator.yawRateTarget() * 57.29577951308232f,
+                     navigator.yawRateMeasured() * 57.29577951308232f);
+  }
+}
 
-  applyMotorDuties(slave, mapNormalizedToDuty(mLeft),
-                   mapNormalizedToDuty(mRight));
+// One line per walk that arrived, for comparing steering on the mat.
+void logWalk(uint32_t now) {
+  walkHeading.finish();
+  char settle[12] = "-";
+  if (walkHeading.settled()) {
+    snprintf(settle, sizeof(settle), "%lu",
+             static_cast<unsigned long>(walkHeading.settleMs()));
+  }
+  serialOut.printf("nav_walk,%s,%lu,%s,%lu,%lu\n",
+                   yawRateLoop ? "yaw_rate" : "open",
+                   static_cast<unsigned long>(now - navigationStartedAtMs),
+                   settle, static_cast<unsigned long>(walkJitterMs),
+                   static_cast<unsigned long>(walkReflectedMs));
 }
 
-bool reachedArrival(const BeaconTrackerState &state) {
-  return state.detected && state.totalSignal >= SIGNAL_ARRIVE &&
-         isFrontDominant(state);
+uint16_t toDeci(float value) {
+  return static_cast<uint16_t>(value <= 0.0f ? 0.0f : value * 10.0f + 0.5f);
 }
 
-void logNavigation(Slave *slave, const MasterData &master,
-                   const BeaconTrackerState &state, bool searchMode) {
-  char payload[224];
-  snprintf(payload, sizeof(payload),
-           "beacon_nav,%lu,%s,%lu,%lu,%lu,%lu,%.1f,%.1f,%.1f,%.1f,%.2f,%.1f,%u,"
-           "%u,%u",
-           static_cast<unsigned long>(state.timestampMs),
-           searchMode ? "search" : "track",
-           static_cast<unsigned long>(state.rawFront),
-           static_cast<unsigned long>(state.rawBack),
-           static_cast<unsigned long>(state.rawLeft),
-           static_cast<unsigned long>(state.rawRight), state.front, state.back,
-           state.left, state.right, state.filteredTheta * 57.29577951308232f,
-           state.totalSignal, static_cast<unsigned>(state.detected ? 1 : 0),
-           static_cast<unsigned>(lastLeftDuty),
-           static_cast<unsigned>(lastRightDuty));
+// A NAV_BATCH broadcast: the master folds it into per-slave summaries (see
+// common/nav_relay), and the other slaves turn it away from its header.
+void sendNavUplink(Slave *slave) {
+  if (navUplink.empty()) {
+    return;
+  }
+  const uint16_t frames = navUplink.frameCount();
+  uint8_t stream[mesh_proto::NAV_BATCH_CAPACITY];
+  const size_t length = navUplink.take(stream, sizeof(stream));
+  char message[mesh_proto::TEXT_CAPACITY];
+  if (length > 0 &&
+      mesh_proto::encodeNavBatch(
+          nodeId, static_cast<uint8_t>(frames > UINT8_MAX ? UINT8_MAX : frames),
+          stream, length, message, sizeof(message)) > 0) {
+    slave->communication.sendMessage(message);
+  }
+}
 
-  Serial.printf("%s\n", payload);
+// Every control tick goes to the master as a delta-encoded frame; a batch
+// of ~10 frames fits in one mesh message.
+void queueNavUplink(Slave *slave, const BeaconTrackerState &state,
+                    bool searchMode) {
+  NavFrame frame;
+  frame.tMs = state.timestampMs;
+  frame.raw[0] = static_cast<uint16_t>(state.rawFront);
+  frame.raw[1] = static_cast<uint16_t>(state.rawBack);
+  frame.raw[2] = static_cast<uint16_t>(state.rawLeft);
+  frame.raw[3] = static_cast<uint16_t>(state.rawRight);
+  frame.amplitudeDeci[0] = toDeci(state.front);
+  frame.amplitudeDeci[1] = toDeci(state.back);
+  frame.amplitudeDeci[2] = toDeci(state.left);
+  frame.amplitudeDeci[3] = toDeci(state.right);
+  frame.thetaCentiDeg =
+      static_cast<int16_t>(lroundf(state.filteredTheta * RADIANS_TO_CENTI_DEG));
+  frame.signalDeci = static_cast<uint32_t>(state.totalSignal * 10.0f + 0.5f);
+  frame.dutyLeft = navigator.leftDuty();
+  frame.dutyRight = navigator.rightDuty();
+  if (state.detected) {
+    frame.flags |= NavFrame::FLAG_DETECTED;
+  }
+  if (searchMode) {
+    frame.flags |= NavFrame::FLAG_SEARCH;
+  }
 
-  String meshMessage = "log:";
-  meshMessage += payload;
-  slave->communication.unicast(master.id, meshMessage);
+  if (!navUplink.add(frame)) {
+    sendNavUplink(slave);
+    navUplink.add(frame);
+  }
+  if (navUplink.full()) {
+    sendNavUplink(slave);
+  }
 }
 
 void step_work(Slave *slave) {
+  if (lastStepState == SlaveState::WAIT_CHARGE ||
+      lastStepState == SlaveState::WALKING_INTO_CHARGE) {
+    // Sent back to work after reporting arrival: the docking failed.
+    triggerFlightRecorder(FlightTrigger::FAILED_ARRIVAL, millis());
+  }
+  noteStep(slave, SlaveState::WORK);
   resetNavigation(slave);
-  Serial.printf("Execute 'step_work' for slave %u\n",
-                slave->communication.getNodeId());
+  serialOut.printf("Execute 'step_work' for slave %u\n",
+                   slave->communication.getNodeId());
   slave->requestCharge();
+  heartbeats.setRequest(heartbeat::FLAG_WANTS_CHARGE, true);
   slave->multiColorLight.setTopLeds(RED);
   delay(3000);
 }
 
 bool step_to_charge(Slave *slave, MasterData &master) {
   (void)master;
-
+  noteStep(slave, SlaveState::WALKING_TO_CHARGE);
   const uint32_t now = millis();
-  if (!navigationActive) {
+  if (!navigator.active()) {
     beginNavigation(slave, now);
   }
 
+  if (!navigationTimedOut && now - navigationStartedAtMs >= NAV_TIMEOUT_MS) {
+    navigationTimedOut = true;
+    triggerFlightRecorder(FlightTrigger::NAV_TIMEOUT, now);
+  }
+
   toggleNavigationLed(slave, now);
-  if (!shouldRunControl(now)) {
+  if (navigator.shouldRunYawRate(now)) {
+    navigator.updateYawRate(readYawRate(slave), now);
+  }
+  if (!navigator.shouldRunControl(now)) {
     return false;
   }
 
+  const uint32_t tickStartUs = micros();
   const uint32_t rawFront = slave->lightDetection.getValue(IR_FRONT);
   const uint32_t rawBack = slave->lightDetection.getValue(IR_BACK);
   const uint32_t rawLeft = slave->lightDetection.getValue(IR_LEFT);
   const uint32_t rawRight = slave->lightDetection.getValue(IR_RIGHT);
 
-  const BeaconTrackerState &state =
-      tracker.update(rawFront, rawBack, rawLeft, rawRight, now);
-
-  bool searchMode = false;
-  if (state.detected) {
-    driveTracking(slave, state);
-  } else {
-    driveSearch(slave, now);
-    searchMode = true;
+  followBeaconDuty();
+  const bool arrived =
+      navigator.update(rawFront, rawBack, rawLeft, rawRight, now);
+  recordFlightTick(navigator.state(), micros() - tickStartUs);
+  walkHeading.add(navigator.state().detected, navigator.state().filteredTheta,
+                  now);
+  if (navigator.wallJitterActive()) {
+    walkJitterMs += navigation_config::CONTROL_PERIOD_MS;
   }
+  if (navigator.state().reflected) {
+    walkReflectedMs += navigation_config::CONTROL_PERIOD_MS;
+  }
+  reportBeacon(slave, navigator.state(), now);
+  queueNavUplink(slave, navigator.state(), navigator.searchMode());
 
   if (now - lastLogAtMs >= NAV_LOG_PERIOD_MS) {
-    logNavigation(slave, master, state, searchMode);
+    logNavigation(navigator.state(), navigator.searchMode());
+    sendNavUplink(slave);
     lastLogAtMs = now;
   }
 
-  if (reachedArrival(state)) {
+  if (arrived) {
+    noteEvent("arrived");
+    logWalk(now);
+    sendNavUplink(slave);
     resetNavigation(slave);
     slave->multiColorLight.turnOffLed(TOP);
     return true;
@@ -303,35 +928,70 @@ bool step_to_charge(Slave *slave, MasterData &master) {
 
 void step_wait_charge(Slave *slave, MasterData &master) {
   (void)master;
+  noteStep(slave, SlaveState::WAIT_CHARGE);
   resetNavigation(slave);
   slave->multiColorLight.setTopLeds(YELLOW);
   delay(3000);
 }
 
-bool requestedStop = false;
-
 bool step_into_charge(Slave *slave, MasterData &master) {
   (void)master;
+  noteStep(slave, SlaveState::WALKING_INTO_CHARGE);
   resetNavigation(slave);
   slave->multiColorLight.blink(3, GREEN, TOP, 1000);
   slave->multiColorLight.turnOffLed(TOP);
-  requestedStop = false;
   return true;
 }
 
 void step_charge(Slave *slave, MasterData &master) {
   (void)master;
+  noteStep(slave, SlaveState::CHARGE);
   resetNavigation(slave);
   slave->multiColorLight.setTopLeds(GREEN);
-  delay(15000); // the dezibot should wait here until it is charged full
-  if (!requestedStop) {
+  if (!charging) {
+    chargeTerminator.begin(millis());
+    charging = true;
+    requestedStop = false;
+    stopResends = 0;
+    lastChargeLogAtMs = millis();
+  }
+  // One battery sample per step until the charge ends, then wait for the
+  // master to let the slave go, asking again until it does.
+  delay(charge_config::SAMPLE_PERIOD_MS);
+  const uint32_t now = millis();
+  if (requestedStop) {
+    if (now - lastStopRequestAtMs >= charge_config::STOP_RESEND_PERIOD_MS) {
+      lastStopRequestAtMs = now;
+      stopResends++;
+      serialOut.printf("charge_stop_resend,%u\n", stopResends);
+      slave->requestStopCharge();
+    }
+    return;
+  }
+  char line[SERIAL_OUT_SLOT_SIZE];
+  if (chargeTerminator.update(now, readBatteryMv())) {
+    if (charge_control::formatEnd(chargeTerminator, now, line,
+                                  sizeof(line)) > 0) {
+      serialOut.print(line);
+    }
+    noteEvent("stop_request");
     slave->requestStopCharge();
+    heartbeats.setRequest(heartbeat::FLAG_WANTS_STOP, true);
     requestedStop = true;
+    lastStopRequestAtMs = now;
+  } else if (now - lastChargeLogAtMs >=
+             charge_config::PROGRESS_LOG_PERIOD_MS) {
+    lastChargeLogAtMs = now;
+    if (charge_control::formatProgress(chargeTerminator, now, line,
+                                       sizeof(line)) > 0) {
+      serialOut.print(line);
+    }
   }
 }
 
 bool step_exit_charge(Slave *slave, MasterData &master) {
   (void)master;
+  noteStep(slave, SlaveState::EXITING_CHARGE);
   resetNavigation(slave);
   slave->multiColorLight.blink(3, RED, TOP, 1000);
   slave->multiColorLight.turnOffLed(TOP);
@@ -346,27 +1006,147 @@ Slave slave =
     Slave(SlaveState::WORK, master, step_work, step_to_charge, step_wait_charge,
           step_into_charge, step_charge, step_exit_charge);
 
+// Mounts the file system and allocates the ring, then reports through
+// serialOut; the serial_tx task may already be draining it.
+void startFlightRecorder() {
+  if (!flightRecorder.begin()) {
+    serialOut.println("Flight recorder disabled: no memory for ring");
+  } else {
+    char line[96];
+    if (flightRecorder.formatStatus(line, sizeof(line)) > 0) {
+      serialOut.print(line);
+    }
+  }
+  flightRecorderReady.store(true);
+}
+
+// Reads what boot needs from flash: the sensor calibration and the master
+// id saved by followMasterId().
+void loadBootSettings() {
+  calibrationLoaded = calibrator.load();
+  Preferences preferences;
+  if (preferences.begin(BOOT_NVS_NAMESPACE, true)) {
+    cachedMasterId = preferences.getULong(BOOT_NVS_MASTER_KEY, 0);
+    preferences.end();
+  }
+}
+
+// Loads the boot settings, then brings up the flight recorder, whose file
+// system mount (or first-time format) can take seconds. Runs alongside
+// Dezibot's begin(); the control loop only waits for the settings.
+void bootTask(void *arg) {
+  (void)arg;
+  loadBootSettings();
+  bootTimeline.mark(boot_timing::Phase::SETTINGS_LOADED, localUs());
+  xSemaphoreGive(settingsLoaded);
+
+  startFlightRecorder();
+  bootTimeline.mark(boot_timing::Phase::DEFERRED_DONE, localUs());
+  vTaskDelete(nullptr);
+}
+
+// The master's id is compiled in; one it advertises since replaces it,
+// here and in flash, so a slave moved to another station knows its master
+// from the first tick after a reboot.
+void followMasterId() {
+  const uint32_t advertised = advertisedMasterId.exchange(0);
+  if (advertised == 0 || advertised == master.id) {
+    return;
+  }
+  master.id = advertised;
+  Preferences preferences;
+  if (preferences.begin(BOOT_NVS_NAMESPACE, false)) {
+    preferences.putULong(BOOT_NVS_MASTER_KEY, advertised);
+    preferences.end();
+  }
+  serialOut.printf("master,%lu\n", static_cast<unsigned long>(advertised));
+}
+
+void serviceBoot() {
+  if (!firstTickDone) {
+    firstTickDone = true;
+    bootTimeline.mark(boot_timing::Phase::FIRST_TICK, localUs());
+  }
+  if (bootTimeline.due(localUs(), BOOT_REPORT_TIMEOUT_MS)) {
+    printBootTimeline();
+  }
+}
+
 void setup() {
-  delay(2000);
+  // No wait for a USB host: boot lines queue in serialOut until one reads
+  // them.
   Serial.begin(115200);
-  Serial.println("+------------------------+");
-  Serial.println("| Charging Station Slave |");
-  Serial.println("+------------------------+");
-  Serial.println();
+  serialOut.begin(Serial);
+  bootTimeline.mark(boot_timing::Phase::SERIAL_READY, localUs());
+  serialOut.println("+------------------------+");
+  serialOut.println("| Charging Station Slave |");
+  serialOut.println("+------------------------+");
+
+  calibrator.begin(&motionDrive, navigation_config::CALIBRATION_SPIN_DUTY,
+                   navigation_config::CALIBRATION_SPIN_MS,
+                   navigation_config::CALIBRATION_CAPTURE_MS);
+  settingsLoaded = xSemaphoreCreateBinary();
+  const bool bootTaskStarted =
+      settingsLoaded != nullptr &&
+      xTaskCreate(bootTask, "boot", BOOT_TASK_STACK_SIZE, nullptr, 1,
+                  nullptr) == pdPASS;
+  clockAnswers = xQueueCreate(CLOCK_RESPONSE_QUEUE_LENGTH, sizeof(ClockAnswer));
+  pongArrivals = xQueueCreate(PONG_QUEUE_LENGTH, sizeof(PongArrival));
+  meshMessages.on(mesh_proto::Type::CLOCK_RESPONSE, onClockResponse);
+  meshMessages.on(mesh_proto::Type::BEACON_DUTY, onBeaconDuty);
 
   slave.begin();
-  trackerConfig.signalMin = SIGNAL_MIN;
-  trackerConfig.angleAlpha = THETA_ALPHA;
-  trackerConfig.maxAngleStepRad = THETA_MAX_STEP_RAD;
-  trackerConfig.signalDropGuardRatio = SIGNAL_DROP_GUARD_RATIO;
-  trackerConfig.saturationRawThreshold = SATURATION_RAW_THRESHOLD;
-  trackerConfig.guardHoldMs = TRACKER_GUARD_HOLD_MS;
-  tracker = BeaconTracker(trackerConfig);
-
-  Serial.println("beacon_nav,t_ms,mode,raw_f,raw_b,raw_l,raw_r,A_F,A_B,A_L,A_R,"
-                 "theta_deg,S,detected,duty_l,duty_r");
-  Serial.println("Setup complete");
+  bootTimeline.mark(boot_timing::Phase::BEGIN_DONE, localUs());
+  nodeId = slave.communication.getNodeId();
+  // Drawn with Wi-Fi up, which feeds the hardware RNG.
+  heartbeats.setBootId(static_cast<uint16_t>(esp_random()));
+  slave.communication.onReceive(onBroadcast);
+
+  if (bootTaskStarted) {
+    xSemaphoreTake(settingsLoaded, portMAX_DELAY);
+  } else {
+    // No task: the same work, in line.
+    loadBootSettings();
+    startFlightRecorder();
+  }
+  if (cachedMasterId != 0) {
+    master.id = cachedMasterId;
+  }
+  rebuildNavigator();
+
+  serialOut.println(
+      "beacon_nav,t_ms,mode,raw_f,raw_b,raw_l,raw_r,A_F,A_B,A_L,A_R,"
+      "theta_deg,S,detected,duty_l,duty_r");
+  if (calibrationLoaded) {
+    printCalibration();
+  } else {
+    serialOut.println("ir_cal: none stored, using uncalibrated channels");
+  }
+  serialOut.println("Setup complete");
   slave.multiColorLight.setTopLeds(RED);
+  bootTimeline.mark(boot_timing::Phase::SETUP_DONE, localUs());
 }
 
-void loop() { slave.step(); }
+void loop() {
+  if (calibrator.active()) {
+    serviceCalibration(&slave);
+  } else if (meshBench.active()) {
+    serviceBench(&slave, master);
+  } else {
+    slave.step();
+  }
+  serviceBoot();
+  followMasterId();
+  serviceClockSync(&slave, master);
+  serviceHeartbeat(&slave);
+  if (flightRecorderReady.load() && flightRecorder.service(millis())) {
+    serialOut.printf("Flight recorder frozen (%s), %lu blocks\n",
+                     flightTriggerName(flightRecorder.reason()),
+                     static_cast<unsigned long>(
+                         flightRecorder.recordedBlocks()));
+  }
+  if (!navigator.active() && !calibrator.active()) {
+    serviceGyroBias(&slave);
+  }
+  pollCommands();
+}
@@ -0,0 +1,194 @@
+#include "sensor_calibrator.h"
+
+#include <Preferences.h>
+#include <string.h>
+
+namespace {
+const char *const NVS_NAMESPACE = "ir_cal";
+const char *const NVS_KEY = "channels";
+
+float toGain(uint16_t gainQ12) {
+  return static_cast<float>(gainQ12) / ir_calibration::GAIN_ONE;
+}
+} // namespace
+
+void SensorCalibrator::begin(DriveOutput *drive, uint16_t spinDuty,
+                             uint32_t spinMs, uint32_t captureMs) {
+  drive_ = drive;
+  spinDuty_ = spinDuty;
+  spinMs_ = spinMs;
+  captureMs_ = captureMs;
+}
+
+bool SensorCalibrator::load() {
+  Preferences preferences;
+  if (!preferences.begin(NVS_NAMESPACE, true)) {
+    return false;
+  }
+  uint8_t record[ir_calibration::RECORD_SIZE];
+  const bool found = preferences.getBytesLength(NVS_KEY) == sizeof(record) &&
+                     preferences.getBytes(NVS_KEY, record, sizeof(record)) ==
+                         sizeof(record);
+  preferences.end();
+  return found && ir_calibration::decode(record, calibration_);
+}
+
+bool SensorCalibrator::save() {
+  Preferences preferences;
+  if (!preferences.begin(NVS_NAMESPACE, false)) {
+    return false;
+  }
+  uint8_t record[ir_calibration::RECORD_SIZE];
+  ir_calibration::encode(calibration_, record);
+  const bool written =
+      preferences.putBytes(NVS_KEY, record, sizeof(record)) == sizeof(record);
+  preferences.end();
+  return written;
+}
+
+void SensorCalibrator::clear() {
+  Preferences preferences;
+  if (preferences.begin(NVS_NAMESPACE, false)) {
+    preferences.remove(NVS_KEY);
+    preferences.end();
+  }
+  calibration_ = ir_calibration::Calibration();
+}
+
+void SensorCalibrator::start(CalibrationStep step, uint32_t now) {
+  step_ = step;
+  startedAtMs_ = now;
+  switch (step) {
+  case CalibrationStep::DARK:
+    dark_.reset();
+    break;
+  case CalibrationStep::SPIN: {
+    // Measure the beacon against the room light of the last ambient check,
+    // or against the dark offsets without one.
+    uint16_t baseline[ir_calibration::CHANNELS];
+    if (ambient_.samples() >= ir_calibration::MIN_AMBIENT_SAMPLES) {
+      ambient_.rawMean(baseline);
+    } else {
+      memcpy(baseline, calibration_.offset, sizeof(baseline));
+    }
+    spin_.reset(baseline);
+    break;
+  }
+  case CalibrationStep::AMBIENT:
+    ambient_.reset();
+    break;
+  case CalibrationStep::IDLE:
+    break;
+  }
+}
+
+bool SensorCalibrator::active() const {
+  return step_ != CalibrationStep::IDLE;
+}
+
+bool SensorCalibrator::update(
+    const uint16_t (&raw)[ir_calibration::CHANNELS], uint32_t now) {
+  const uint32_t elapsed = now - startedAtMs_;
+  switch (step_) {
+  case CalibrationStep::DARK:
+    dark_.add(raw);
+    break;
+  case CalibrationStep::SPIN: {
+    // Half the spin on each wheel; see SpinCapture.
+    const bool pivotOnRight = elapsed >= spinMs_ / 2;
+    spin_.add(raw, pivotOnRight ? 1 : 0);
+    if (drive_ != nullptr) {
+      drive_->setLeftDuty(pivotOnRight ? spinDuty_ : 0);
+      drive_->setRightDuty(pivotOnRight ? 0 : spinDuty_);
+    }
+    break;
+  }
+  case CalibrationStep::AMBIENT:
+    ambient_.add(raw);
+    break;
+  case CalibrationStep::IDLE:
+    return false;
+  }
+
+  const uint32_t duration =
+      step_ == CalibrationStep::SPIN ? spinMs_ : captureMs_;
+  if (elapsed < duration) {
+    return false;
+  }
+  finish();
+  return true;
+}
+
+void SensorCalibrator::finish() {
+  switch (step_) {
+  case CalibrationStep::DARK:
+    status_ = dark_.fit(calibration_);
+    break;
+  case CalibrationStep::SPIN:
+    if (drive_ != nullptr) {
+      drive_->stop();
+    }
+    status_ = spin_.fit(calibration_);
+    break;
+  case CalibrationStep::AMBIENT:
+    status_ = ambient_.fit(calibration_);
+    break;
+  case CalibrationStep::IDLE:
+    break;
+  }
+  lastStep_ = step_;
+  step_ = CalibrationStep::IDLE;
+}
+
+CalibrationStep SensorCalibrator::lastStep() const { return lastStep_; }
+
+ir_calibration::FitStatus SensorCalibrator::status() const { return status_; }
+
+const ir_calibration::Calibration &SensorCalibrator::calibration() const {
+  return calibration_;
+}
+
+const ir_calibration::DarkCapture &SensorCalibrator::dark() const {
+  return dark_;
+}
+
+const ir_calibration::SpinCapture &SensorCalibrator::spin() const {
+  return spin_;
+}
+
+const ir_calibration::AmbientCheck &SensorCalibrator::ambient() const {
+  return ambient_;
+}
+
+void SensorCalibrator::applyTo(BeaconTrackerConfig &config) const {
+  SensorCalibration *channels[ir_calibration::CHANNELS] = {
+      &config.front, &config.back, &config.left, &config.right};
+  const bool ambient =
+      (calibration_.flags & ir_calibration::FLAG_AMBIENT) != 0;
+  float ambientSum = 0.0f;
+  for (uint8_t i = 0; i < ir_calibration::CHANNELS; ++i) {
+    channels[i]->offset = calibration_.offset[i];
+    channels[i]->gain = toGain(calibration_.gainQ12[i]);
+    if (ambient) {
+      channels[i]->ambient = calibration_.ambient[i];
+    }
+    ambientSum += calibration_.ambient[i];
+  }
+  if (ambient) {
+    config.floorPrior = ambientSum;
+  }
+}
+
+const char *calibrationStepName(CalibrationStep step) {
+  switch (step) {
+  case CalibrationStep::IDLE:
+    return "idle";
+  case CalibrationStep::DARK:
+    return "dark";
+  case CalibrationStep::SPIN:
+    return "spin";
+  case CalibrationStep::AMBIENT:
+    return "ambient";
+  }
+  return "unknown";
+}
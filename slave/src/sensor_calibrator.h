@@ -0,0 +1,72 @@
+#pragma once
+
+#include "beacon_navigator.h"
+
+#include <beacon_tracker.h>
+#include <ir_calibration.h>
+
+#include <cstdint>
+
+enum class CalibrationStep : uint8_t {
+  IDLE,
+  // Sensors covered or room dark, beacon off: per-channel offsets.
+  DARK,
+  // Room light on, beacon off: checks the ambient light per channel and
+  // records the baseline for the spin.
+  AMBIENT,
+  // Robot 10-25 cm in front of the beacon: pivots on one wheel, then on the
+  // other, and equalizes the channel gains.
+  SPIN,
+};
+
+// Runs the IR channel calibration one step at a time and keeps the result in
+// NVS, so every robot boots with its own channel offsets and gains. A step
+// only changes the working calibration when its fit succeeds; save() makes
+// it permanent.
+class SensorCalibrator {
+public:
+  void begin(DriveOutput *drive, uint16_t spinDuty, uint32_t spinMs,
+             uint32_t captureMs);
+
+  // Loads the stored calibration; false if there is none.
+  bool load();
+  bool save();
+  // Erases the stored calibration and returns to uncalibrated channels.
+  void clear();
+
+  void start(CalibrationStep step, uint32_t now);
+  bool active() const;
+  // Feeds one raw sample per control tick while active(). Returns true when
+  // the step has finished; status() then holds its result.
+  bool update(const uint16_t (&raw)[ir_calibration::CHANNELS], uint32_t now);
+
+  CalibrationStep lastStep() const;
+  ir_calibration::FitStatus status() const;
+  const ir_calibration::Calibration &calibration() const;
+  const ir_calibration::DarkCapture &dark() const;
+  const ir_calibration::SpinCapture &spin() const;
+  const ir_calibration::AmbientCheck &ambient() const;
+
+  // Channel offsets and gains; the ambient check, if any, also sets the
+  // channels' ambient levels and seeds the adaptive detection floor.
+  void applyTo(BeaconTrackerConfig &config) const;
+
+private:
+  void finish();
+
+  DriveOutput *drive_ = nullptr;
+  uint16_t spinDuty_ = 0;
+  uint32_t spinMs_ = 0;
+  uint32_t captureMs_ = 0;
+
+  ir_calibration::Calibration calibration_;
+  ir_calibration::DarkCapture dark_;
+  ir_calibration::SpinCapture spin_;
+  ir_calibration::AmbientCheck ambient_;
+  CalibrationStep step_ = CalibrationStep::IDLE;
+  CalibrationStep lastStep_ = CalibrationStep::IDLE;
+  ir_calibration::FitStatus status_ = ir_calibration::FitStatus::OK;
+  uint32_t startedAtMs_ = 0;
+};
+
+const char *calibrationStepName(CalibrationStep step);
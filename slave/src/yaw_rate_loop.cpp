@@ -0,0 +1,132 @@
+#include "yaw_rate_loop.h"
+
+#include <cmath>
+
+namespace {
+// Longest step the integral takes, so a loop that was not run for a while
+// does not jump.
+constexpr float MAX_STEP_S = 0.05f;
+
+float clampf(float value, float low, float high) {
+  if (value < low) {
+    return low;
+  }
+  if (value > high) {
+    return high;
+  }
+  return value;
+}
+} // namespace
+
+YawRateLoop::YawRateLoop(const YawRateLoopConfig &config) : config_(config) {}
+
+void YawRateLoop::reset() {
+  target_ = 0.0f;
+  measured_ = 0.0f;
+  integral_ = 0.0f;
+  started_ = false;
+  lastUpdateAtMs_ = 0;
+  scheduled_ = false;
+}
+
+bool YawRateLoop::due(uint32_t now) {
+  if (!scheduled_) {
+    scheduled_ = true;
+    nextAtMs_ = now;
+  }
+  if (static_cast<int32_t>(now - nextAtMs_) < 0) {
+    return false;
+  }
+
+  nextAtMs_ += config_.periodMs;
+  if (static_cast<int32_t>(now - nextAtMs_) >
+      static_cast<int32_t>(config_.periodMs)) {
+    nextAtMs_ = now + config_.periodMs;
+  }
+  return true;
+}
+
+void YawRateLoop::setTarget(float rateRadS) { target_ = rateRadS; }
+
+float YawRateLoop::target() const { return target_; }
+
+float YawRateLoop::model(float rateRadS) const {
+  const float magnitude = std::fabs(rateRadS);
+  float turn;
+  if (magnitude >= config_.minRateRadS) {
+    turn = config_.minTurn + config_.feedforward * magnitude;
+  } else {
+    turn = magnitude * (config_.minTurn / config_.minRateRadS +
+                        config_.feedforward);
+  }
+  return rateRadS < 0.0f ? -turn : turn;
+}
+
+float YawRateLoop::update(float measuredRadS, float limit, uint32_t now) {
+  const float dt =
+      started_ ? clampf(static_cast<float>(now - lastUpdateAtMs_) * 0.001f,
+                        0.0f, MAX_STEP_S)
+               : static_cast<float>(config_.periodMs) * 0.001f;
+  started_ = true;
+  lastUpdateAtMs_ = now;
+  measured_ = measuredRadS;
+
+  const float error = target_ - measuredRadS;
+  const float open = model(target_) + config_.kp * error;
+  const float unclamped = open + integral_;
+  const bool pushingHigh = unclamped >= limit && error > 0.0f;
+  const bool pushingLow = unclamped <= -limit && error < 0.0f;
+  if (!pushingHigh && !pushingLow) {
+    integral_ = clampf(integral_ + config_.ki * error * dt, -limit, limit);
+  }
+
+  return clampf(open + integral_, -limit, limit);
+}
+
+float YawRateLoop::turn(float limit) const {
+  const float error = started_ ? target_ - measured_ : 0.0f;
+  return clampf(model(target_) + config_.kp * error + integral_, -limit,
+                limit);
+}
+
+float YawRateLoop::measured() const { return measured_; }
+
+HeadingSettle::HeadingSettle(float bandRad, uint32_t holdMs)
+    : bandRad_(bandRad), holdMs_(holdMs) {}
+
+void HeadingSettle::reset() { *this = HeadingSettle(bandRad_, holdMs_); }
+
+void HeadingSettle::add(bool detected, float thetaRad, uint32_t now) {
+  if (!tracked_) {
+    if (!detected) {
+      return;
+    }
+    tracked_ = true;
+    trackedAtMs_ = now;
+  }
+  if (settled_) {
+    return;
+  }
+
+  if (std::fabs(thetaRad) > bandRad_) {
+    inBand_ = false;
+  } else if (!inBand_) {
+    inBand_ = true;
+    inBandAtMs_ = now;
+  }
+  if (inBand_ && now - inBandAtMs_ >= holdMs_) {
+    settled_ = true;
+    settleMs_ = inBandAtMs_ - trackedAtMs_;
+  }
+}
+
+void HeadingSettle::finish() {
+  if (!settled_ && inBand_) {
+    settled_ = true;
+    settleMs_ = inBandAtMs_ - trackedAtMs_;
+  }
+}
+
+bool HeadingSettle::settled() const { return settled_; }
+
+uint32_t HeadingSettle::settleMs() const { return settleMs_; }
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+
+// Inner loop of the walk-to-charge steering: tracks a commanded yaw rate
+// with the gyro, so the same bearing error turns the robot at the same rate
+// whatever the battery, the floor or the left/right motor mismatch. The
+// output is the navigator's normalized turn term (right minus left motor,
+// halved), which it mixes into the wheel duties.
+//
+// turn = feedforward model + kp * error + integral, where the model is
+// sign(target) * (minTurn + feedforward * |target|): minTurn is the
+// smallest turn that gets past the duty quantization, ramped in linearly
+// below minRateRadS so a target near zero does not chatter. The integral
+// absorbs what the model gets wrong and stops growing while the turn is at
+// its limit and the error would push it further.
+struct YawRateLoopConfig {
+  uint32_t periodMs = 5;
+  // Normalized turn per rad/s: the turn rate of a robot driving the nominal
+  // duty span, inverted.
+  float feedforward = 0.40f;
+  float kp = 0.10f;
+  // Per second.
+  float ki = 1.5f;
+  float minTurn = 0.03f;
+  float minRateRadS = 0.10f;
+};
+
+class YawRateLoop {
+public:
+  explicit YawRateLoop(const YawRateLoopConfig &config = YawRateLoopConfig());
+
+  // Clears the integral; the next update starts from the model alone.
+  void reset();
+  // True once per period on a phase-stable grid, as
+  // BeaconNavigator::shouldRunControl.
+  bool due(uint32_t now);
+
+  void setTarget(float rateRadS);
+  float target() const;
+
+  // One loop step with the measured yaw rate (counter-clockwise positive).
+  // `limit` bounds the turn the drive can take right now. Returns the turn.
+  float update(float measuredRadS, float limit, uint32_t now);
+  // The turn for the current target and the last measurement, without
+  // stepping the integral: what a new target gets until the next update.
+  float turn(float limit) const;
+  float measured() const;
+
+private:
+  float model(float rateRadS) const;
+
+  YawRateLoopConfig config_;
+  float target_ = 0.0f;
+  float measured_ = 0.0f;
+  float integral_ = 0.0f;
+  bool started_ = false;
+  uint32_t lastUpdateAtMs_ = 0;
+  uint32_t nextAtMs_ = 0;
+  bool scheduled_ = false;
+};
+
+// How long a walk took to point at the beacon, by the bearing the navigator
+// steers by: from the first tick with the beacon detected until |theta|
+// stays within bandRad for holdMs, or is within it when the walk ends.
+class HeadingSettle {
+public:
+  explicit HeadingSettle(float bandRad = 0.1745f, uint32_t holdMs = 1000);
+
+  void reset();
+  void add(bool detected, float thetaRad, uint32_t now);
+  void finish();
+
+  bool settled() const;
+  uint32_t settleMs() const;
+
+private:
+  float bandRad_;
+  uint32_t holdMs_;
+  bool tracked_ = false;
+  uint32_t trackedAtMs_ = 0;
+  bool inBand_ = false;
+  uint32_t inBandAtMs_ = 0;
+  bool settled_ = false;
+  uint32_t settleMs_ = 0;
+};
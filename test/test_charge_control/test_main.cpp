@@ -0,0 +1,180 @@
+#include <charge_control.h>
+
+#include <unity.h>
+
+#include <cstring>
+
+using namespace charge_control;
+
+namespace {
+constexpr uint32_t SAMPLE_MS = 500;
+
+// Feeds `mvAt(elapsed)` every SAMPLE_MS from `start` until the charge ends
+// or `untilMs` has passed; returns the elapsed time it ended at, or
+// untilMs + 1 if it did not.
+template <typename Fn>
+uint32_t runUntilDone(ChargeTerminator &charge, uint32_t start,
+                      uint32_t untilMs, Fn mvAt) {
+  charge.begin(start);
+  for (uint32_t elapsed = SAMPLE_MS; elapsed <= untilMs;
+       elapsed += SAMPLE_MS) {
+    if (charge.update(start + elapsed, mvAt(elapsed))) {
+      return elapsed;
+    }
+  }
+  return untilMs + 1;
+}
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_target_waits_for_the_contacts_to_settle() {
+  ChargeTerminator charge;
+  const uint32_t endedAt =
+      runUntilDone(charge, 0, 60000, [](uint32_t) { return 4200; });
+  TEST_ASSERT_EQUAL_UINT32(charge.config().minChargeMs, endedAt);
+  TEST_ASSERT_TRUE(charge.reason() == EndReason::TARGET);
+  TEST_ASSERT_EQUAL_UINT16(4200, charge.startMv());
+  // Done stays done, with nothing left.
+  TEST_ASSERT_TRUE(charge.update(endedAt + SAMPLE_MS, 3000));
+  TEST_ASSERT_EQUAL_UINT32(0, charge.remainingMs(endedAt + SAMPLE_MS));
+  TEST_ASSERT_EQUAL_UINT8(100, charge.progressPercent(endedAt + SAMPLE_MS));
+}
+
+void test_target_on_a_rising_battery() {
+  ChargeTerminator charge;
+  // 20 mV/s from 3900 mV: the filtered voltage reaches 4150 mV a little
+  // after the raw one, at 12.5 s.
+  const uint32_t endedAt = runUntilDone(
+      charge, 1000, 60000, [](uint32_t elapsed) {
+        return static_cast<uint16_t>(3900 + elapsed / 50);
+      });
+  TEST_ASSERT_TRUE(charge.reason() == EndReason::TARGET);
+  TEST_ASSERT_GREATER_OR_EQUAL(12500, endedAt);
+  TEST_ASSERT_LESS_OR_EQUAL(14000, endedAt);
+  TEST_ASSERT_GREATER_OR_EQUAL(4150, charge.filteredMv());
+}
+
+void test_plateau_below_the_target() {
+  ChargeTerminator charge;
+  const uint32_t endedAt =
+      runUntilDone(charge, 0, 60000, [](uint32_t) { return 4000; });
+  TEST_ASSERT_TRUE(charge.reason() == EndReason::PLATEAU);
+  // Only once the window is full: nine slots from the first sample, at
+  // least 1250 ms apart, which the 500 ms samples round up to 1500 ms.
+  TEST_ASSERT_GREATER_OR_EQUAL(charge.config().plateauWindowMs, endedAt);
+  TEST_ASSERT_EQUAL_UINT32(SAMPLE_MS + 8 * 1500, endedAt);
+  TEST_ASSERT_EQUAL_INT32(0, charge.windowRiseMv());
+}
+
+void test_plateau_needs_the_rise_to_stall() {
+  ChargeConfig config;
+  config.targetMv = 0; // plateau only
+  ChargeTerminator charge(config);
+  // 1 mV/s: 10 mV over the window, above plateauRiseMv, then flat.
+  const uint32_t endedAt =
+      runUntilDone(charge, 0, 60000, [](uint32_t elapsed) {
+        const uint32_t capped = elapsed < 30000 ? elapsed : 30000;
+        return static_cast<uint16_t>(3900 + capped / 1000);
+      });
+  TEST_ASSERT_TRUE(charge.reason() == EndReason::PLATEAU);
+  TEST_ASSERT_GREATER_THAN(30000, endedAt);
+}
+
+void test_no_gauge_falls_back_to_the_fixed_charge() {
+  ChargeTerminator charge;
+  const uint32_t endedAt = runUntilDone(
+      charge, 0, 60000, [](uint32_t) { return 0; });
+  TEST_ASSERT_EQUAL_UINT32(charge.config().noGaugeChargeMs, endedAt);
+  TEST_ASSERT_TRUE(charge.reason() == EndReason::NO_GAUGE);
+  TEST_ASSERT_EQUAL_UINT16(0, charge.filteredMv());
+
+  // An open sense input reads below minValidMv; that is no reading either.
+  ChargeTerminator open;
+  TEST_ASSERT_EQUAL_UINT32(
+      charge.config().noGaugeChargeMs,
+      runUntilDone(open, 0, 60000, [](uint32_t) { return 1200; }));
+  TEST_ASSERT_TRUE(open.reason() == EndReason::NO_GAUGE);
+}
+
+void test_time_limit() {
+  ChargeConfig config;
+  config.maxChargeMs = 20000;
+  ChargeTerminator charge(config);
+  // Rising too fast for a plateau, too slowly to reach the target.
+  const uint32_t endedAt =
+      runUntilDone(charge, 0, 60000, [](uint32_t elapsed) {
+        return static_cast<uint16_t>(3500 + elapsed / 50);
+      });
+  TEST_ASSERT_EQUAL_UINT32(20000, endedAt);
+  TEST_ASSERT_TRUE(charge.reason() == EndReason::TIME_LIMIT);
+
+  // The limit is the one thing that ends a charge before minChargeMs.
+  config.maxChargeMs = 1000;
+  ChargeTerminator early(config);
+  TEST_ASSERT_EQUAL_UINT32(
+      1000, runUntilDone(early, 0, 60000, [](uint32_t) { return 4200; }));
+  TEST_ASSERT_TRUE(early.reason() == EndReason::TIME_LIMIT);
+}
+
+void test_elapsed_across_the_millis_wrap() {
+  ChargeTerminator charge;
+  const uint32_t start = 0xFFFFFFFFU - 1000;
+  const uint32_t endedAt =
+      runUntilDone(charge, start, 60000, [](uint32_t) { return 0; });
+  TEST_ASSERT_EQUAL_UINT32(charge.config().noGaugeChargeMs, endedAt);
+  TEST_ASSERT_EQUAL_UINT32(endedAt, charge.elapsedMs(start + endedAt));
+}
+
+void test_remaining_on_a_linear_rise() {
+  ChargeTerminator charge;
+  charge.begin(0);
+  TEST_ASSERT_EQUAL_UINT32(REMAINING_UNKNOWN, charge.remainingMs(0));
+  TEST_ASSERT_EQUAL_UINT8(PROGRESS_UNKNOWN, charge.progressPercent(0));
+  uint32_t now = 0;
+  // 10 mV/s from 3900 mV, for 8 s.
+  for (; now < 8000;) {
+    now += SAMPLE_MS;
+    charge.update(now, static_cast<uint16_t>(3900 + now / 100));
+  }
+  const uint32_t remaining = charge.remainingMs(now);
+  TEST_ASSERT_NOT_EQUAL(REMAINING_UNKNOWN, remaining);
+  // The filter lags the reading by (1 - alpha) / alpha samples.
+  const float expectedMs = (4150.0f - charge.filteredMv()) / 10.0f * 1000.0f;
+  TEST_ASSERT_FLOAT_WITHIN(0.1f * expectedMs, expectedMs,
+                           static_cast<float>(remaining));
+  const uint8_t percent = charge.progressPercent(now);
+  TEST_ASSERT_GREATER_THAN(0, percent);
+  TEST_ASSERT_LESS_OR_EQUAL(100, percent);
+}
+
+void test_format_lines() {
+  ChargeTerminator charge;
+  char line[64];
+  runUntilDone(charge, 0, 60000, [](uint32_t) { return 0; });
+  TEST_ASSERT_GREATER_THAN(0, formatEnd(charge, 15000, line, sizeof(line)));
+  TEST_ASSERT_EQUAL_STRING("charge_end,no_gauge,15000,0,0\n", line);
+  // Too small for the line: nothing.
+  TEST_ASSERT_EQUAL(0, formatEnd(charge, 15000, line, 10));
+
+  charge.begin(0);
+  charge.update(500, 3950);
+  TEST_ASSERT_GREATER_THAN(0, formatProgress(charge, 500, line, sizeof(line)));
+  TEST_ASSERT_EQUAL_STRING("charge,500,3950,0,-,-\n", line);
+  TEST_ASSERT_EQUAL_STRING("plateau", endReasonName(EndReason::PLATEAU));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_target_waits_for_the_contacts_to_settle);
+  RUN_TEST(test_target_on_a_rising_battery);
+  RUN_TEST(test_plateau_below_the_target);
+  RUN_TEST(test_plateau_needs_the_rise_to_stall);
+  RUN_TEST(test_no_gauge_falls_back_to_the_fixed_charge);
+  RUN_TEST(test_time_limit);
+  RUN_TEST(test_elapsed_across_the_millis_wrap);
+  RUN_TEST(test_remaining_on_a_linear_rise);
+  RUN_TEST(test_format_lines);
+  return UNITY_END();
+}
@@ -0,0 +1,130 @@
+#include <heartbeat.h>
+
+#include <unity.h>
+
+using namespace heartbeat;
+
+namespace {
+constexpr uint32_t NODE = 0x5A17;
+
+// What a slave with scheduler `slave` would send at `now`.
+Status sent(HeartbeatScheduler &slave, SlaveState state, uint32_t now) {
+  slave.setState(state, now);
+  Status status;
+  slave.take(NODE, now, status);
+  return status;
+}
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_sequence_gaps_count_as_missed() {
+  HeartbeatScheduler slave;
+  SlaveTable table;
+  TEST_ASSERT_EQUAL_UINT8(CHANGE_NEW_SLAVE | CHANGE_STATE,
+                          table.ingest(sent(slave, SlaveState::WORK, 0), 0));
+  sent(slave, SlaveState::WORK, 10000); // lost
+  sent(slave, SlaveState::WORK, 20000); // lost
+  TEST_ASSERT_EQUAL_UINT8(
+      0, table.ingest(sent(slave, SlaveState::WORK, 30000), 30000));
+  const SlaveTable::Entry *entry = table.find(NODE);
+  TEST_ASSERT_NOT_NULL(entry);
+  TEST_ASSERT_EQUAL_UINT32(2, entry->received);
+  TEST_ASSERT_EQUAL_UINT32(2, entry->missed);
+}
+
+void test_late_heartbeat_is_stale() {
+  HeartbeatScheduler slave;
+  slave.setBootId(0x1111);
+  SlaveTable table;
+  table.ingest(sent(slave, SlaveState::WORK, 0), 0);
+  const Status walking = sent(slave, SlaveState::WALKING_TO_CHARGE, 1000);
+  const Status waiting = sent(slave, SlaveState::WAIT_CHARGE, 2000);
+  TEST_ASSERT_EQUAL_UINT8(CHANGE_STATE, table.ingest(waiting, 2010));
+  // The mesh delivers the earlier one after it.
+  TEST_ASSERT_EQUAL_UINT8(CHANGE_STALE, table.ingest(walking, 2020));
+  TEST_ASSERT_TRUE(table.find(NODE)->status.state ==
+                   SlaveState::WAIT_CHARGE);
+}
+
+void test_reboot_with_a_new_boot_id() {
+  HeartbeatScheduler before;
+  before.setBootId(0x1111);
+  SlaveTable table;
+  uint32_t now = 0;
+  Status last;
+  for (; now < 5000; now += 500) {
+    last = sent(before, SlaveState::WALKING_INTO_CHARGE, now);
+    table.ingest(last, now);
+  }
+  TEST_ASSERT_EQUAL_UINT16(9, last.seq);
+
+  // Back up after a reset: seq starts over, 9 behind the last one seen,
+  // and the first heartbeat is the urgent wait.
+  HeartbeatScheduler after;
+  after.setBootId(0x2222);
+  now += 3000;
+  const Status waiting = sent(after, SlaveState::WAIT_CHARGE, now);
+  TEST_ASSERT_EQUAL_UINT16(0, waiting.seq);
+  const uint8_t changes = table.ingest(waiting, now);
+  TEST_ASSERT_EQUAL_UINT8(CHANGE_RESTART, changes & CHANGE_RESTART);
+  TEST_ASSERT_EQUAL_UINT8(CHANGE_STATE, changes & CHANGE_STATE);
+  TEST_ASSERT_EQUAL_UINT8(0, changes & CHANGE_STALE);
+  const SlaveTable::Entry *entry = table.find(NODE);
+  TEST_ASSERT_TRUE(entry->status.state == SlaveState::WAIT_CHARGE);
+  TEST_ASSERT_EQUAL_UINT32(1, entry->restarts);
+  TEST_ASSERT_EQUAL_UINT32(0, entry->missed);
+  TEST_ASSERT_EQUAL_UINT32(0, entry->cycleMs[static_cast<size_t>(
+                                  SlaveState::WALKING_INTO_CHARGE)]);
+
+  // The next heartbeats follow on from seq 0.
+  now += 2000;
+  TEST_ASSERT_EQUAL_UINT8(
+      0, table.ingest(sent(after, SlaveState::WAIT_CHARGE, now), now));
+  TEST_ASSERT_EQUAL_UINT32(0, entry->missed);
+  // One from before the reset, delivered late, is stale.
+  last.seq = 10;
+  TEST_ASSERT_EQUAL_UINT8(CHANGE_STALE, table.ingest(last, now + 10));
+  TEST_ASSERT_EQUAL_UINT32(1, entry->restarts);
+}
+
+void test_reboot_without_boot_ids_is_stale() {
+  // Slaves that send no boot id: a restart within the reorder window
+  // looks like a late heartbeat, as before.
+  HeartbeatScheduler before;
+  SlaveTable table;
+  for (uint32_t now = 0; now < 5000; now += 500) {
+    table.ingest(sent(before, SlaveState::WORK, now), now);
+  }
+  HeartbeatScheduler after;
+  TEST_ASSERT_EQUAL_UINT8(
+      CHANGE_STALE,
+      table.ingest(sent(after, SlaveState::WAIT_CHARGE, 8000), 8000));
+}
+
+void test_cycle_after_a_charge() {
+  HeartbeatScheduler slave;
+  SlaveTable table;
+  table.ingest(sent(slave, SlaveState::WORK, 0), 0);
+  table.ingest(sent(slave, SlaveState::WALKING_TO_CHARGE, 1000), 1000);
+  table.ingest(sent(slave, SlaveState::CHARGE, 4000), 4000);
+  const uint8_t changes =
+      table.ingest(sent(slave, SlaveState::WORK, 9000), 9000);
+  TEST_ASSERT_EQUAL_UINT8(CHANGE_STATE | CHANGE_CYCLE, changes);
+  const SlaveTable::Entry *entry = table.find(NODE);
+  TEST_ASSERT_EQUAL_UINT32(3000, entry->cycleMs[static_cast<size_t>(
+                                     SlaveState::WALKING_TO_CHARGE)]);
+  TEST_ASSERT_EQUAL_UINT32(
+      5000, entry->cycleMs[static_cast<size_t>(SlaveState::CHARGE)]);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sequence_gaps_count_as_missed);
+  RUN_TEST(test_late_heartbeat_is_stale);
+  RUN_TEST(test_reboot_with_a_new_boot_id);
+  RUN_TEST(test_reboot_without_boot_ids_is_stale);
+  RUN_TEST(test_cycle_after_a_charge);
+  return UNITY_END();
+}
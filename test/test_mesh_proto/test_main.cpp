@@ -0,0 +1,343 @@
+#include <mesh_messages.h>
+#include <mesh_proto.h>
+
+#include <unity.h>
+
+#include <cstring>
+
+using namespace mesh_proto;
+
+namespace {
+// What the last handler call saw.
+struct Capture {
+  int calls = 0;
+  Envelope envelope;
+  uint8_t payload[MAX_FRAME];
+  size_t length = 0;
+};
+
+void capture(void *context, const Envelope &envelope, Reader &payload) {
+  Capture &seen = *static_cast<Capture *>(context);
+  seen.calls++;
+  seen.envelope = envelope;
+  seen.length = payload.remaining();
+  std::memcpy(seen.payload, payload.data(), seen.length);
+}
+
+// Dispatches an armored message to `seen` and leaves its payload there.
+DispatchStatus receive(Type type, const char *text, size_t length,
+                       Capture &seen) {
+  Dispatcher dispatcher;
+  dispatcher.on(type, capture, &seen);
+  Envelope envelope;
+  envelope.from = 0x1234;
+  return dispatcher.dispatchText(envelope, text, length);
+}
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_writer_reader_round_trip() {
+  uint8_t frame[32];
+  Writer writer(Type::CLOCK_REQUEST, frame, sizeof(frame));
+  writer.u8(0xAB).u16(0xBEEF).u32(0xDEADBEEF).u64(0x0123456789ABCDEFULL);
+  TEST_ASSERT_TRUE(writer.ok());
+  TEST_ASSERT_EQUAL(HEADER_SIZE + 15, writer.length());
+  TEST_ASSERT_EQUAL_UINT8(VERSION, frame[0]);
+  TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(Type::CLOCK_REQUEST), frame[1]);
+  // Little-endian on the wire.
+  TEST_ASSERT_EQUAL_UINT8(0xEF, frame[3]);
+  TEST_ASSERT_EQUAL_UINT8(0xBE, frame[4]);
+
+  Reader reader(frame + HEADER_SIZE, writer.length() - HEADER_SIZE);
+  TEST_ASSERT_EQUAL_UINT8(0xAB, reader.u8());
+  TEST_ASSERT_EQUAL_UINT16(0xBEEF, reader.u16());
+  TEST_ASSERT_EQUAL_UINT32(0xDEADBEEF, reader.u32());
+  TEST_ASSERT_EQUAL_UINT64(0x0123456789ABCDEFULL, reader.u64());
+  TEST_ASSERT_EQUAL(0, reader.remaining());
+  TEST_ASSERT_TRUE(reader.ok());
+}
+
+void test_writer_overflow_clears_ok() {
+  uint8_t frame[HEADER_SIZE + 3];
+  Writer writer(Type::LOG, frame, sizeof(frame));
+  writer.u16(1);
+  TEST_ASSERT_TRUE(writer.ok());
+  writer.u16(2); // one byte short
+  TEST_ASSERT_FALSE(writer.ok());
+  TEST_ASSERT_EQUAL(0, writer.length());
+  writer.u8(3); // still dropped, though it would fit
+  TEST_ASSERT_FALSE(writer.ok());
+
+  Writer tooSmall(Type::LOG, frame, HEADER_SIZE - 1);
+  TEST_ASSERT_FALSE(tooSmall.ok());
+}
+
+void test_reader_past_the_end() {
+  const uint8_t payload[3] = {1, 2, 3};
+  Reader reader(payload, sizeof(payload));
+  TEST_ASSERT_EQUAL_UINT16(0x0201, reader.u16());
+  TEST_ASSERT_EQUAL_UINT16(0, reader.u16());
+  TEST_ASSERT_FALSE(reader.ok());
+  // A failed read does not consume the byte that is left.
+  TEST_ASSERT_EQUAL(1, reader.remaining());
+}
+
+void test_armor_round_trip() {
+  uint8_t frame[MAX_FRAME];
+  for (size_t i = 0; i < sizeof(frame); ++i) {
+    frame[i] = static_cast<uint8_t>(i * 7);
+  }
+  char text[TEXT_CAPACITY];
+  const size_t length = armor(frame, sizeof(frame), text, sizeof(text));
+  TEST_ASSERT_GREATER_THAN(0, length);
+  TEST_ASSERT_EQUAL(TEXT_MARK, text[0]);
+
+  uint8_t decoded[MAX_FRAME];
+  TEST_ASSERT_EQUAL(sizeof(frame),
+                    unarmor(text, length, decoded, sizeof(decoded)));
+  TEST_ASSERT_EQUAL_MEMORY(frame, decoded, sizeof(frame));
+
+  TEST_ASSERT_EQUAL(0, armor(frame, sizeof(frame), text, TEXT_CAPACITY - 2));
+  TEST_ASSERT_EQUAL(0, unarmor("hello", 5, decoded, sizeof(decoded)));
+}
+
+void test_dispatch_statuses() {
+  Capture seen;
+  Dispatcher dispatcher;
+  TEST_ASSERT_FALSE(dispatcher.on(static_cast<Type>(0), capture, &seen));
+  TEST_ASSERT_FALSE(dispatcher.on(Type::COUNT, capture, &seen));
+  TEST_ASSERT_TRUE(dispatcher.on(Type::BEACON_DUTY, capture, &seen));
+
+  Envelope envelope;
+  const uint8_t duty[] = {VERSION, static_cast<uint8_t>(Type::BEACON_DUTY),
+                          0x00, 0x01, 0x78, 0x56, 0x34, 0x12, 0xFF};
+  TEST_ASSERT_TRUE(dispatcher.dispatch(envelope, duty, 4) ==
+                   DispatchStatus::HANDLED);
+  TEST_ASSERT_EQUAL(2, seen.length);
+  // With the optional master id.
+  TEST_ASSERT_TRUE(dispatcher.dispatch(envelope, duty, 8) ==
+                   DispatchStatus::HANDLED);
+  TEST_ASSERT_EQUAL(6, seen.length);
+  TEST_ASSERT_EQUAL(2, seen.calls);
+  // Short of the fixed part, and past the optional part.
+  TEST_ASSERT_TRUE(dispatcher.dispatch(envelope, duty, 3) ==
+                   DispatchStatus::BAD_LENGTH);
+  TEST_ASSERT_TRUE(dispatcher.dispatch(envelope, duty, 9) ==
+                   DispatchStatus::BAD_LENGTH);
+  TEST_ASSERT_TRUE(dispatcher.dispatch(envelope, duty, 1) ==
+                   DispatchStatus::NOT_A_FRAME);
+
+  const uint8_t badVersion[] = {VERSION + 1,
+                                static_cast<uint8_t>(Type::BEACON_DUTY), 0,
+                                0};
+  TEST_ASSERT_TRUE(dispatcher.dispatch(envelope, badVersion, 4) ==
+                   DispatchStatus::BAD_VERSION);
+  const uint8_t unknown[] = {VERSION, static_cast<uint8_t>(TYPE_COUNT)};
+  TEST_ASSERT_TRUE(dispatcher.dispatch(envelope, unknown, 2) ==
+                   DispatchStatus::UNKNOWN_TYPE);
+  const uint8_t noHandler[] = {VERSION,
+                               static_cast<uint8_t>(Type::REQUEST_CHARGE)};
+  TEST_ASSERT_TRUE(dispatcher.dispatch(envelope, noHandler, 2) ==
+                   DispatchStatus::NO_HANDLER);
+  TEST_ASSERT_TRUE(dispatcher.dispatchText(envelope, "request_charge", 14) ==
+                   DispatchStatus::NOT_A_FRAME);
+  TEST_ASSERT_EQUAL(2, seen.calls);
+}
+
+void test_signal_round_trip() {
+  char text[MESSAGE_CAPACITY];
+  const size_t length = encodeSignal(Type::STOP_CHARGE, text, sizeof(text));
+  TEST_ASSERT_GREATER_THAN(0, length);
+  Capture seen;
+  TEST_ASSERT_TRUE(receive(Type::STOP_CHARGE, text, length, seen) ==
+                   DispatchStatus::HANDLED);
+  TEST_ASSERT_EQUAL(0, seen.length);
+  TEST_ASSERT_EQUAL_UINT32(0x1234, seen.envelope.from);
+  // Only payload-less types are signals.
+  TEST_ASSERT_EQUAL(0,
+                    encodeSignal(Type::CLOCK_REQUEST, text, sizeof(text)));
+}
+
+void test_clock_response_round_trip() {
+  clock_sync::ClockRequest request;
+  request.node = 0xCAFEF00D;
+  request.seq = 77;
+  request.sentUs = 0xFFFFFFFF00000001ULL;
+  char text[MESSAGE_CAPACITY];
+  const size_t length =
+      encodeClockResponse(request, 1000, UINT64_MAX, text, sizeof(text));
+  TEST_ASSERT_GREATER_THAN(0, length);
+
+  Capture seen;
+  TEST_ASSERT_TRUE(receive(Type::CLOCK_RESPONSE, text, length, seen) ==
+                   DispatchStatus::HANDLED);
+  Reader reader(seen.payload, seen.length);
+  clock_sync::ClockResponse response;
+  TEST_ASSERT_TRUE(readClockResponse(reader, response));
+  TEST_ASSERT_EQUAL_UINT32(request.node, response.node);
+  TEST_ASSERT_EQUAL_UINT32(request.seq, response.seq);
+  TEST_ASSERT_EQUAL_UINT64(request.sentUs, response.requestSentUs);
+  TEST_ASSERT_EQUAL_UINT64(1000, response.receivedUs);
+  TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, response.sentUs);
+  // Out of space for the armored text.
+  TEST_ASSERT_EQUAL(0, encodeClockResponse(request, 1000, UINT64_MAX, text,
+                                           length - 1));
+}
+
+void test_beacon_duty_with_and_without_master() {
+  char text[MESSAGE_CAPACITY];
+  Capture seen;
+  uint16_t duty = 0;
+  uint32_t master = 1;
+
+  size_t length = encodeBeaconDuty(beacon_power::DUTY_MAX, text, sizeof(text));
+  TEST_ASSERT_TRUE(receive(Type::BEACON_DUTY, text, length, seen) ==
+                   DispatchStatus::HANDLED);
+  Reader plain(seen.payload, seen.length);
+  TEST_ASSERT_TRUE(readBeaconDuty(plain, duty, master));
+  TEST_ASSERT_EQUAL_UINT16(beacon_power::DUTY_MAX, duty);
+  TEST_ASSERT_EQUAL_UINT32(0, master);
+
+  length = encodeBeaconDuty(300, 0xA1B2C3D4, text, sizeof(text));
+  TEST_ASSERT_TRUE(receive(Type::BEACON_DUTY, text, length, seen) ==
+                   DispatchStatus::HANDLED);
+  Reader withMaster(seen.payload, seen.length);
+  TEST_ASSERT_TRUE(readBeaconDuty(withMaster, duty, master));
+  TEST_ASSERT_EQUAL_UINT16(300, duty);
+  TEST_ASSERT_EQUAL_UINT32(0xA1B2C3D4, master);
+
+  length = encodeBeaconDuty(beacon_power::DUTY_MAX + 1, text, sizeof(text));
+  TEST_ASSERT_TRUE(receive(Type::BEACON_DUTY, text, length, seen) ==
+                   DispatchStatus::HANDLED);
+  Reader tooHigh(seen.payload, seen.length);
+  TEST_ASSERT_FALSE(readBeaconDuty(tooHigh, duty));
+}
+
+void test_heartbeat_round_trip() {
+  heartbeat::Status status;
+  status.node = 0x89ABCDEF;
+  status.seq = UINT16_MAX;
+  status.state = heartbeat::SlaveState::CHARGE;
+  status.flags = heartbeat::FLAG_REPORT | heartbeat::FLAG_WANTS_STOP |
+                 heartbeat::FLAG_CHARGE_ESTIMATE | heartbeat::FLAG_BOOT_ID;
+  status.stateAgeMs = 123456;
+  status.batteryMv = 4123;
+  status.thetaCentiDeg = -17999;
+  status.report.duty = 512;
+  status.report.signal = 70000;
+  status.report.saturated = 3;
+  status.report.ticks = 50;
+  status.chargeRemainingS = 42;
+  status.chargePercent = 87;
+  status.bootId = 0xB007;
+
+  char text[MESSAGE_CAPACITY];
+  size_t length = encodeHeartbeat(status, text, sizeof(text));
+  TEST_ASSERT_GREATER_THAN(0, length);
+  Capture seen;
+  TEST_ASSERT_TRUE(receive(Type::HEARTBEAT, text, length, seen) ==
+                   DispatchStatus::HANDLED);
+  TEST_ASSERT_EQUAL(payloadSize(Type::HEARTBEAT) +
+                        optionalSize(Type::HEARTBEAT),
+                    seen.length);
+  Reader reader(seen.payload, seen.length);
+  heartbeat::Status parsed;
+  TEST_ASSERT_TRUE(readHeartbeat(reader, parsed));
+  TEST_ASSERT_EQUAL_UINT32(status.node, parsed.node);
+  TEST_ASSERT_EQUAL_UINT16(status.seq, parsed.seq);
+  TEST_ASSERT_TRUE(parsed.state == heartbeat::SlaveState::CHARGE);
+  TEST_ASSERT_EQUAL_UINT8(status.flags, parsed.flags);
+  TEST_ASSERT_EQUAL_UINT32(status.stateAgeMs, parsed.stateAgeMs);
+  TEST_ASSERT_EQUAL_UINT16(status.batteryMv, parsed.batteryMv);
+  TEST_ASSERT_EQUAL_INT16(status.thetaCentiDeg, parsed.thetaCentiDeg);
+  TEST_ASSERT_EQUAL_UINT32(status.node, parsed.report.node);
+  TEST_ASSERT_EQUAL_UINT16(512, parsed.report.duty);
+  TEST_ASSERT_EQUAL_UINT32(70000, parsed.report.signal);
+  TEST_ASSERT_EQUAL_UINT16(3, parsed.report.saturated);
+  TEST_ASSERT_EQUAL_UINT16(50, parsed.report.ticks);
+  TEST_ASSERT_EQUAL_UINT16(42, parsed.chargeRemainingS);
+  TEST_ASSERT_EQUAL_UINT8(87, parsed.chargePercent);
+  TEST_ASSERT_EQUAL_UINT16(0xB007, parsed.bootId);
+
+  // An older sender without the estimate and boot id: the frame is
+  // shorter and both read as unknown.
+  status.flags = heartbeat::FLAG_WANTS_STOP;
+  length = encodeHeartbeat(status, text, sizeof(text));
+  TEST_ASSERT_TRUE(receive(Type::HEARTBEAT, text, length, seen) ==
+                   DispatchStatus::HANDLED);
+  TEST_ASSERT_EQUAL(payloadSize(Type::HEARTBEAT), seen.length);
+  Reader shorter(seen.payload, seen.length);
+  TEST_ASSERT_TRUE(readHeartbeat(shorter, parsed));
+  TEST_ASSERT_EQUAL_UINT16(heartbeat::CHARGE_REMAINING_UNKNOWN,
+                           parsed.chargeRemainingS);
+  TEST_ASSERT_EQUAL_UINT16(0, parsed.bootId);
+  TEST_ASSERT_EQUAL_UINT8(0, parsed.flags & heartbeat::FLAG_BOOT_ID);
+  TEST_ASSERT_EQUAL_UINT16(0, parsed.report.ticks);
+}
+
+void test_heartbeat_rejects_bad_fields() {
+  heartbeat::Status status;
+  status.flags = heartbeat::FLAG_REPORT;
+  status.report.saturated = 5;
+  status.report.ticks = 4;
+  char text[MESSAGE_CAPACITY];
+  const size_t length = encodeHeartbeat(status, text, sizeof(text));
+  Capture seen;
+  TEST_ASSERT_TRUE(receive(Type::HEARTBEAT, text, length, seen) ==
+                   DispatchStatus::HANDLED);
+  Reader reader(seen.payload, seen.length);
+  heartbeat::Status parsed;
+  parsed.node = 99;
+  TEST_ASSERT_FALSE(readHeartbeat(reader, parsed));
+  TEST_ASSERT_EQUAL_UINT32(99, parsed.node);
+
+  // Saturated back to 0 it reads; then a state past the last one.
+  seen.payload[22] = 0;
+  Reader fixed(seen.payload, seen.length);
+  TEST_ASSERT_TRUE(readHeartbeat(fixed, parsed));
+  seen.payload[6] = heartbeat::STATE_COUNT;
+  Reader badState(seen.payload, seen.length);
+  TEST_ASSERT_FALSE(readHeartbeat(badState, parsed));
+}
+
+void test_nav_batch_boundaries() {
+  uint8_t stream[NAV_BATCH_CAPACITY];
+  for (size_t i = 0; i < sizeof(stream); ++i) {
+    stream[i] = static_cast<uint8_t>(i);
+  }
+  char text[TEXT_CAPACITY];
+  const size_t length =
+      encodeNavBatch(7, 10, stream, sizeof(stream), text, sizeof(text));
+  TEST_ASSERT_GREATER_THAN(0, length);
+  Capture seen;
+  TEST_ASSERT_TRUE(receive(Type::NAV_BATCH, text, length, seen) ==
+                   DispatchStatus::HANDLED);
+  Reader reader(seen.payload, seen.length);
+  NavBatch batch;
+  TEST_ASSERT_TRUE(readNavBatch(reader, batch));
+  TEST_ASSERT_EQUAL_UINT32(7, batch.node);
+  TEST_ASSERT_EQUAL_UINT8(10, batch.frames);
+  TEST_ASSERT_EQUAL(sizeof(stream), batch.length);
+  TEST_ASSERT_EQUAL_MEMORY(stream, batch.stream, sizeof(stream));
+
+  TEST_ASSERT_EQUAL(0, encodeNavBatch(7, 10, stream, sizeof(stream) + 1, text,
+                                      sizeof(text)));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_writer_reader_round_trip);
+  RUN_TEST(test_writer_overflow_clears_ok);
+  RUN_TEST(test_reader_past_the_end);
+  RUN_TEST(test_armor_round_trip);
+  RUN_TEST(test_dispatch_statuses);
+  RUN_TEST(test_signal_round_trip);
+  RUN_TEST(test_clock_response_round_trip);
+  RUN_TEST(test_beacon_duty_with_and_without_master);
+  RUN_TEST(test_heartbeat_round_trip);
+  RUN_TEST(test_heartbeat_rejects_bad_fields);
+  RUN_TEST(test_nav_batch_boundaries);
+  return UNITY_END();
+}
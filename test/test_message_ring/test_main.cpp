@@ -0,0 +1,126 @@
+#include <message_ring.h>
+
+#include <unity.h>
+
+#include <cstdio>
+#include <string>
+
+namespace {
+typedef MessageRing<4, 16> Ring;
+
+std::string popText(Ring &ring) {
+  char out[Ring::SLOT_SIZE];
+  const int length = ring.pop(out);
+  return length < 0 ? std::string("<empty>") : std::string(out, length);
+}
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_pop_on_empty() {
+  Ring ring;
+  char out[Ring::SLOT_SIZE];
+  TEST_ASSERT_TRUE(ring.empty());
+  TEST_ASSERT_EQUAL(-1, ring.pop(out));
+  TEST_ASSERT_EQUAL(0, ring.queued());
+}
+
+void test_fifo_order_across_wraparound() {
+  Ring ring;
+  // Ten times round the four slots, with the ring up to three deep.
+  uint32_t next = 0;
+  for (uint32_t i = 0; i < 40; ++i) {
+    char text[16];
+    std::snprintf(text, sizeof(text), "m%lu", static_cast<unsigned long>(i));
+    TEST_ASSERT_TRUE(ring.push(text));
+    if (i % 3 == 2) {
+      while (!ring.empty()) {
+        std::snprintf(text, sizeof(text), "m%lu",
+                      static_cast<unsigned long>(next++));
+        TEST_ASSERT_EQUAL_STRING(text, popText(ring).c_str());
+      }
+    }
+  }
+  while (!ring.empty()) {
+    char text[16];
+    std::snprintf(text, sizeof(text), "m%lu",
+                  static_cast<unsigned long>(next++));
+    TEST_ASSERT_EQUAL_STRING(text, popText(ring).c_str());
+  }
+  TEST_ASSERT_EQUAL_UINT32(40, next);
+  TEST_ASSERT_EQUAL_UINT32(0, ring.droppedNewest());
+  TEST_ASSERT_EQUAL_UINT32(0, ring.droppedOldest());
+}
+
+void test_drop_newest_keeps_the_queue() {
+  Ring ring(OverflowPolicy::DROP_NEWEST);
+  TEST_ASSERT_TRUE(ring.push("a"));
+  TEST_ASSERT_TRUE(ring.push("b"));
+  TEST_ASSERT_TRUE(ring.push("c"));
+  TEST_ASSERT_TRUE(ring.push("d"));
+  TEST_ASSERT_EQUAL(4, ring.queued());
+  TEST_ASSERT_FALSE(ring.push("e"));
+  TEST_ASSERT_FALSE(ring.printf("%s", "f"));
+  TEST_ASSERT_EQUAL_UINT32(2, ring.droppedNewest());
+  TEST_ASSERT_EQUAL_UINT32(0, ring.droppedOldest());
+
+  TEST_ASSERT_EQUAL_STRING("a", popText(ring).c_str());
+  TEST_ASSERT_TRUE(ring.push("g"));
+  TEST_ASSERT_EQUAL_STRING("b", popText(ring).c_str());
+  TEST_ASSERT_EQUAL_STRING("c", popText(ring).c_str());
+  TEST_ASSERT_EQUAL_STRING("d", popText(ring).c_str());
+  TEST_ASSERT_EQUAL_STRING("g", popText(ring).c_str());
+  TEST_ASSERT_TRUE(ring.empty());
+}
+
+void test_drop_oldest_keeps_the_latest() {
+  Ring ring(OverflowPolicy::DROP_OLDEST);
+  for (char c = 'a'; c <= 'f'; ++c) {
+    const char text[2] = {c, '\0'};
+    TEST_ASSERT_TRUE(ring.push(text));
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, ring.droppedOldest());
+  TEST_ASSERT_EQUAL_UINT32(0, ring.droppedNewest());
+  TEST_ASSERT_EQUAL(4, ring.queued());
+  TEST_ASSERT_EQUAL_STRING("c", popText(ring).c_str());
+  TEST_ASSERT_EQUAL_STRING("d", popText(ring).c_str());
+  TEST_ASSERT_EQUAL_STRING("e", popText(ring).c_str());
+  TEST_ASSERT_EQUAL_STRING("f", popText(ring).c_str());
+  TEST_ASSERT_TRUE(ring.empty());
+}
+
+void test_truncates_to_the_slot() {
+  Ring ring;
+  const char *exact = "0123456789abcdef";      // SLOT_SIZE characters
+  const char *longer = "0123456789abcdefXYZ"; // three past it
+  TEST_ASSERT_TRUE(ring.push(exact));
+  TEST_ASSERT_TRUE(ring.push(longer));
+  TEST_ASSERT_TRUE(ring.printf("%s-%d", longer, 42));
+  TEST_ASSERT_TRUE(ring.printf("%d", 7));
+  TEST_ASSERT_EQUAL_UINT32(2, ring.truncated());
+  TEST_ASSERT_EQUAL_STRING(exact, popText(ring).c_str());
+  TEST_ASSERT_EQUAL_STRING(exact, popText(ring).c_str());
+  TEST_ASSERT_EQUAL_STRING(exact, popText(ring).c_str());
+  TEST_ASSERT_EQUAL_STRING("7", popText(ring).c_str());
+}
+
+void test_empty_message() {
+  Ring ring;
+  TEST_ASSERT_TRUE(ring.push(""));
+  TEST_ASSERT_FALSE(ring.empty());
+  char out[Ring::SLOT_SIZE];
+  TEST_ASSERT_EQUAL(0, ring.pop(out));
+  TEST_ASSERT_TRUE(ring.empty());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_pop_on_empty);
+  RUN_TEST(test_fifo_order_across_wraparound);
+  RUN_TEST(test_drop_newest_keeps_the_queue);
+  RUN_TEST(test_drop_oldest_keeps_the_latest);
+  RUN_TEST(test_truncates_to_the_slot);
+  RUN_TEST(test_empty_message);
+  return UNITY_END();
+}
@@ -0,0 +1,236 @@
+#include <delta_fields.h>
+#include <nav_frame.h>
+#include <varint.h>
+
+#include <unity.h>
+
+#include <climits>
+#include <cstring>
+
+namespace {
+NavFrame lowFrame() {
+  NavFrame frame;
+  frame.thetaCentiDeg = INT16_MIN;
+  return frame;
+}
+
+// Every field as far from lowFrame() as its width allows.
+NavFrame highFrame() {
+  NavFrame frame;
+  frame.tMs = 0x80000000U;
+  for (int i = 0; i < 4; ++i) {
+    frame.raw[i] = UINT16_MAX;
+    frame.amplitudeDeci[i] = UINT16_MAX;
+  }
+  frame.thetaCentiDeg = INT16_MAX;
+  frame.signalDeci = 0x80000000U;
+  frame.dutyLeft = UINT16_MAX;
+  frame.dutyRight = UINT16_MAX;
+  frame.flags = UINT8_MAX;
+  return frame;
+}
+
+NavFrame walkingFrame(uint32_t i) {
+  NavFrame frame;
+  frame.tMs = 1000 + 20 * i;
+  frame.raw[0] = static_cast<uint16_t>(900 + i % 7);
+  frame.raw[1] = 310;
+  frame.raw[2] = static_cast<uint16_t>(420 + i % 3);
+  frame.raw[3] = 415;
+  frame.amplitudeDeci[0] = static_cast<uint16_t>(5800 + 10 * (i % 5));
+  frame.thetaCentiDeg = static_cast<int16_t>(-1200 + 10 * i);
+  frame.signalDeci = 12000 + i;
+  frame.dutyLeft = 3800;
+  frame.dutyRight = 3720;
+  frame.flags = NavFrame::FLAG_DETECTED;
+  return frame;
+}
+
+bool sameFrame(const NavFrame &a, const NavFrame &b) {
+  return a.tMs == b.tMs && std::memcmp(a.raw, b.raw, sizeof(a.raw)) == 0 &&
+         std::memcmp(a.amplitudeDeci, b.amplitudeDeci,
+                     sizeof(a.amplitudeDeci)) == 0 &&
+         a.thetaCentiDeg == b.thetaCentiDeg && a.signalDeci == b.signalDeci &&
+         a.dutyLeft == b.dutyLeft && a.dutyRight == b.dutyRight &&
+         a.flags == b.flags;
+}
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_varint_length_boundaries() {
+  uint8_t out[varint::MAX_BYTES_32];
+  TEST_ASSERT_EQUAL(1, varint::write(0, out, sizeof(out)));
+  TEST_ASSERT_EQUAL(1, varint::write(127, out, sizeof(out)));
+  TEST_ASSERT_EQUAL(2, varint::write(128, out, sizeof(out)));
+  TEST_ASSERT_EQUAL(5, varint::write(UINT32_MAX, out, sizeof(out)));
+  TEST_ASSERT_EQUAL(0, varint::write(UINT32_MAX, out, 4));
+
+  uint32_t value = 0;
+  TEST_ASSERT_EQUAL(5, varint::read(out, sizeof(out), value));
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, value);
+  // Truncated: the continuation bit of the last byte is still set.
+  TEST_ASSERT_EQUAL(0, varint::read(out, 4, value));
+}
+
+void test_zigzag_extremes() {
+  const int32_t values[] = {0, -1, 1, INT32_MIN, INT32_MAX};
+  for (int32_t value : values) {
+    TEST_ASSERT_EQUAL_INT32(value,
+                            varint::zigzagDecode(varint::zigzagEncode(value)));
+  }
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, varint::zigzagEncode(INT32_MIN));
+}
+
+void test_delta_fields_keyframe_then_delta() {
+  const uint32_t first[3] = {10, 20, 30};
+  const uint32_t second[3] = {10, 25, 30};
+  const uint32_t zero[3] = {0, 0, 0};
+  uint8_t out[32];
+  size_t length = delta_fields::encode(5, true, first, zero, 3, out,
+                                       sizeof(out));
+  TEST_ASSERT_EQUAL(5, length); // head, mask, three one-byte deltas
+
+  uint32_t fields[3] = {7, 7, 7};
+  uint8_t head = 0;
+  bool keyframe = false;
+  TEST_ASSERT_EQUAL(length, delta_fields::decode(out, length, fields, 3, head,
+                                                 keyframe));
+  TEST_ASSERT_TRUE(keyframe);
+  TEST_ASSERT_EQUAL_UINT8(5, head);
+  TEST_ASSERT_EQUAL_MEMORY(first, fields, sizeof(first));
+
+  length = delta_fields::encode(6, false, second, first, 3, out, sizeof(out));
+  TEST_ASSERT_EQUAL(3, length); // head, mask, one delta
+  TEST_ASSERT_EQUAL(length, delta_fields::decode(out, length, fields, 3, head,
+                                                 keyframe));
+  TEST_ASSERT_FALSE(keyframe);
+  TEST_ASSERT_EQUAL_MEMORY(second, fields, sizeof(second));
+
+  // Nothing changed: head and an empty mask.
+  TEST_ASSERT_EQUAL(2, delta_fields::encode(7, false, second, second, 3, out,
+                                            sizeof(out)));
+}
+
+void test_delta_fields_worst_case_is_the_bound() {
+  uint32_t current[NAV_FRAME_FIELD_COUNT];
+  uint32_t previous[NAV_FRAME_FIELD_COUNT];
+  for (uint8_t i = 0; i < NAV_FRAME_FIELD_COUNT; ++i) {
+    // A delta of INT32_MIN zig-zags to UINT32_MAX, five varint bytes.
+    current[i] = 0x80000000U;
+    previous[i] = 0;
+  }
+  uint8_t out[NAV_FRAME_MAX_BYTES + 8];
+  TEST_ASSERT_EQUAL(NAV_FRAME_MAX_BYTES,
+                    delta_fields::encode(0, false, current, previous,
+                                         NAV_FRAME_FIELD_COUNT, out,
+                                         sizeof(out)));
+  TEST_ASSERT_EQUAL(0, delta_fields::encode(0, false, current, previous,
+                                            NAV_FRAME_FIELD_COUNT, out,
+                                            NAV_FRAME_MAX_BYTES - 1));
+  TEST_ASSERT_EQUAL(73, NAV_FRAME_MAX_BYTES);
+  TEST_ASSERT_EQUAL(1 + 5 + 32 * varint::MAX_BYTES_32,
+                    delta_fields::maxEncodedSize(delta_fields::MAX_FIELDS));
+}
+
+void test_delta_fields_rejects_malformed() {
+  const uint32_t current[2] = {1, 2};
+  const uint32_t previous[2] = {0, 0};
+  uint8_t out[16];
+  const size_t length =
+      delta_fields::encode(0, false, current, previous, 2, out, sizeof(out));
+
+  uint32_t fields[2] = {40, 50};
+  uint8_t head = 0;
+  bool keyframe = false;
+  // Truncated record: the fields are left as they were.
+  TEST_ASSERT_EQUAL(0, delta_fields::decode(out, length - 1, fields, 2, head,
+                                            keyframe));
+  TEST_ASSERT_EQUAL_UINT32(40, fields[0]);
+  TEST_ASSERT_EQUAL_UINT32(50, fields[1]);
+  // A mask bit past the field count.
+  out[1] = 0x04;
+  TEST_ASSERT_EQUAL(0, delta_fields::decode(out, length, fields, 2, head,
+                                            keyframe));
+  TEST_ASSERT_EQUAL(0, delta_fields::encode(0, true, current, previous,
+                                            delta_fields::MAX_FIELDS + 1, out,
+                                            sizeof(out)));
+}
+
+void test_nav_stream_round_trip() {
+  NavStreamEncoder encoder(10);
+  NavStreamDecoder decoder;
+  uint8_t out[NAV_FRAME_MAX_BYTES];
+  // Past 128 frames, so the 7-bit sequence wraps.
+  for (uint32_t i = 0; i < 300; ++i) {
+    const NavFrame frame = walkingFrame(i);
+    const size_t length = encoder.encode(frame, out, sizeof(out));
+    TEST_ASSERT_GREATER_THAN(0, length);
+    NavFrame decoded;
+    size_t used = 0;
+    TEST_ASSERT_TRUE(decoder.decode(out, length, decoded, used) ==
+                     NavDecodeStatus::FRAME);
+    TEST_ASSERT_EQUAL(length, used);
+    TEST_ASSERT_TRUE(sameFrame(frame, decoded));
+    TEST_ASSERT_EQUAL(i % 10 == 0, decoder.keyframe());
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, decoder.lostFrames());
+}
+
+void test_nav_worst_case_frame_fits() {
+  const NavFrame frames[] = {highFrame(), lowFrame(), highFrame(), lowFrame()};
+  NavStreamEncoder encoder(50);
+  NavStreamDecoder decoder;
+  for (const NavFrame &frame : frames) {
+    uint8_t out[NAV_FRAME_MAX_BYTES];
+    const size_t length = encoder.encode(frame, out, sizeof(out));
+    TEST_ASSERT_GREATER_THAN(0, length);
+    TEST_ASSERT_LESS_OR_EQUAL(NAV_FRAME_MAX_BYTES, length);
+    NavFrame decoded;
+    size_t used = 0;
+    TEST_ASSERT_TRUE(decoder.decode(out, length, decoded, used) ==
+                     NavDecodeStatus::FRAME);
+    TEST_ASSERT_TRUE(sameFrame(frame, decoded));
+  }
+}
+
+void test_nav_decoder_resyncs_on_keyframe() {
+  NavStreamEncoder encoder(4);
+  NavStreamDecoder decoder;
+  uint8_t out[NAV_FRAME_MAX_BYTES];
+  NavFrame decoded;
+  size_t used = 0;
+  for (uint32_t i = 0; i < 8; ++i) {
+    const size_t length = encoder.encode(walkingFrame(i), out, sizeof(out));
+    if (i == 1) {
+      continue; // lost on the link
+    }
+    const NavDecodeStatus status = decoder.decode(out, length, decoded, used);
+    if (i == 0 || i >= 4) {
+      TEST_ASSERT_TRUE(status == NavDecodeStatus::FRAME);
+      TEST_ASSERT_TRUE(sameFrame(walkingFrame(i), decoded));
+    } else {
+      TEST_ASSERT_TRUE(status == NavDecodeStatus::WAITING_FOR_KEYFRAME);
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, decoder.lostFrames());
+  TEST_ASSERT_EQUAL_UINT32(2, decoder.skippedFrames());
+
+  const uint8_t garbage[] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  TEST_ASSERT_TRUE(decoder.decode(garbage, sizeof(garbage), decoded, used) ==
+                   NavDecodeStatus::MALFORMED);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_varint_length_boundaries);
+  RUN_TEST(test_zigzag_extremes);
+  RUN_TEST(test_delta_fields_keyframe_then_delta);
+  RUN_TEST(test_delta_fields_worst_case_is_the_bound);
+  RUN_TEST(test_delta_fields_rejects_malformed);
+  RUN_TEST(test_nav_stream_round_trip);
+  RUN_TEST(test_nav_worst_case_frame_fits);
+  RUN_TEST(test_nav_decoder_resyncs_on_keyframe);
+  return UNITY_END();
+}
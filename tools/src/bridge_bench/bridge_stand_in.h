@@ -0,0 +1,115 @@
+#pragma once
+
+#include <bridge_link.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// Host stand-in for the motor controller (motor/src/main.cpp), in
+// simulated time: the same commands, step targets and status strings, the
+// interrupt latch of common/bridge_link, and the I2C transactions timed at
+// the bus clock. The motions run at MultiStepper's constant speed.
+class BridgeStandIn {
+public:
+  // motor/src/main.cpp
+  static constexpr long RAISED_STEPS = 3500;
+  static constexpr long LOWERED_WALK_IN_STEPS = 2300;
+  static constexpr long LOWERED_CHARGE_STEPS = 2200;
+  static constexpr double MAX_RPM = 80.0;
+  static constexpr double STEPS_PER_REVOLUTION = 200.0;
+
+  struct Timing {
+    uint32_t busHz = 100000;
+    // Bytes the master asks for in a status read.
+    uint8_t readBytes = 18;
+    // From a finished motion to the line going low: the controller's loop
+    // sets the pin right after the stepper run that ended it.
+    uint32_t irqDelayUs = 20;
+  };
+
+  explicit BridgeStandIn(const Timing &timing) : timing_(timing) {}
+
+  // A command written over I2C: LOWER_WALK_IN, LOWER_CHARGE or RAISE.
+  // Returns when the write is off the bus.
+  uint64_t command(const char *text, uint64_t nowUs) {
+    const uint64_t doneUs = nowUs + transactionUs(strlen(text) + 1);
+    advance(doneUs);
+    if (notifier_.status() != bridge_link::Status::IDLE &&
+        !bridge_link::isTerminal(notifier_.status())) {
+      return doneUs; // busy: ignored, as the firmware does
+    }
+    long target = position_;
+    bridge_link::Status busy = bridge_link::Status::IDLE;
+    if (strcmp(text, "LOWER_WALK_IN") == 0) {
+      target = LOWERED_WALK_IN_STEPS;
+      busy = bridge_link::Status::BUSY_LOWER_WALK_IN;
+    } else if (strcmp(text, "LOWER_CHARGE") == 0) {
+      target = LOWERED_CHARGE_STEPS;
+      busy = bridge_link::Status::BUSY_LOWER_CHARGE;
+    } else if (strcmp(text, "RAISE") == 0) {
+      target = RAISED_STEPS;
+      busy = bridge_link::Status::BUSY_RAISE;
+    } else {
+      return doneUs;
+    }
+    const double stepsPerS = STEPS_PER_REVOLUTION * MAX_RPM / 60.0;
+    const long distance = target > position_ ? target - position_
+                                             : position_ - target;
+    motionDoneUs_ =
+        doneUs + static_cast<uint64_t>(1.0e6 * distance / stepsPerS);
+    position_ = target;
+    notifier_.set(busy);
+    busBusyUs_ += doneUs - nowUs;
+    return doneUs;
+  }
+
+  // A status read; `text` gets the string the master would see. Returns
+  // when the read is off the bus.
+  uint64_t read(uint64_t nowUs, char *text, size_t size) {
+    const uint64_t doneUs = nowUs + transactionUs(timing_.readBytes);
+    // The controller answers with the status at the start of the read.
+    advance(nowUs);
+    snprintf(text, size, "%s", bridge_link::statusText(notifier_.status()));
+    notifier_.acknowledge();
+    busBusyUs_ += doneUs - nowUs;
+    reads_++;
+    return doneUs;
+  }
+
+  // When the current motion ends, and when the line goes low for it.
+  uint64_t motionDoneUs() const { return motionDoneUs_; }
+  uint64_t irqAtUs() const { return motionDoneUs_ + timing_.irqDelayUs; }
+
+  uint64_t busBusyUs() const { return busBusyUs_; }
+  uint32_t reads() const { return reads_; }
+
+private:
+  void advance(uint64_t nowUs) {
+    const bridge_link::Status status = notifier_.status();
+    if (nowUs < motionDoneUs_ || bridge_link::isTerminal(status) ||
+        status == bridge_link::Status::IDLE) {
+      return;
+    }
+    notifier_.set(
+        status == bridge_link::Status::BUSY_LOWER_WALK_IN
+            ? bridge_link::Status::DONE_LOWER_WALK_IN
+        : status == bridge_link::Status::BUSY_LOWER_CHARGE
+            ? bridge_link::Status::DONE_LOWER_CHARGE
+            : bridge_link::Status::DONE_RAISE);
+  }
+
+  // Start, address byte, payload and stop, nine clocks per byte.
+  uint64_t transactionUs(size_t bytes) const {
+    return static_cast<uint64_t>((2.0 + 9.0 * (bytes + 1)) * 1.0e6 /
+                                 timing_.busHz);
+  }
+
+  Timing timing_;
+  bridge_link::StatusNotifier notifier_;
+  // Raised, as the bay is between cycles.
+  long position_ = RAISED_STEPS;
+  uint64_t motionDoneUs_ = 0;
+  uint64_t busBusyUs_ = 0;
+  uint32_t reads_ = 0;
+};
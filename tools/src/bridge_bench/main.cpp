@@ -0,0 +1,222 @@
+// Measures how long the master takes to see a bridge motion finish, and
+// how much of the I2C bus it spends finding out, against a stand-in for
+// the motor controller (bridge_stand_in.h) in simulated time. Every cycle
+// runs the three motions of a charge: LOWER_WALK_IN, LOWER_CHARGE, RAISE.
+// - poll: the master reads the status once per loop period until it says
+//   DONE, as dezibot's Master steps do.
+// - wake: the same polling, but the bridge interrupt cuts the loop's wait
+//   short (master/src/main.cpp); the next step reads at once.
+// - irq: the master reads only on the interrupt edge, plus a slow fallback
+//   poll for an edge it missed: what dropping the polling saves.
+// Latency runs from the motion's end to the end of the read that saw it.
+
+#include "bridge_stand_in.h"
+
+#include <latency_histogram.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+const char *const MOTIONS[] = {"LOWER_WALK_IN", "LOWER_CHARGE", "RAISE"};
+constexpr size_t MOTION_COUNT = sizeof(MOTIONS) / sizeof(MOTIONS[0]);
+// Between the motions of a cycle the bay waits on slaves for seconds; the
+// master's loop is at a random phase when the next one starts.
+constexpr uint64_t GAP_MIN_US = 1000000;
+constexpr uint64_t GAP_MAX_US = 10000000;
+
+enum class Mode : uint8_t { POLL, WAKE, IRQ };
+
+const char *modeName(Mode mode) {
+  switch (mode) {
+  case Mode::POLL:
+    return "poll";
+  case Mode::WAKE:
+    return "wake";
+  case Mode::IRQ:
+    return "irq";
+  }
+  return "unknown";
+}
+
+struct Options {
+  std::vector<uint32_t> pollMs{5, 20, 50};
+  uint32_t cycles = 2000;
+  // From the edge to the master's loop running: ISR, task notification
+  // and the switch to the loop task.
+  uint32_t wakeUs = 50;
+  uint32_t fallbackMs = 1000;
+  // Share of edges the master misses, e.g. with the wire off.
+  double edgeLoss = 0.0;
+  BridgeStandIn::Timing timing;
+  uint64_t seed = 1;
+};
+
+void usage(const char *program) {
+  std::fprintf(
+      stderr,
+      "usage: %s [options]\n"
+      "  --poll-ms P,P,...  master loop periods (5,20,50)\n"
+      "  --cycles N         charge cycles per run, 3 motions each (2000)\n"
+      "  --bus-hz HZ        I2C clock (100000)\n"
+      "  --read-bytes N     bytes per status read (18)\n"
+      "  --wake-us US       edge to master loop (50)\n"
+      "  --fallback-ms MS   irq mode: poll this often anyway (1000)\n"
+      "  --edge-loss P      share of edges missed (0)\n"
+      "  --seed N\n",
+      program);
+}
+
+bool parseArgs(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char *value = argv[++i];
+    if (arg == "--poll-ms") {
+      options.pollMs.clear();
+      for (const char *p = value; *p != '\0';) {
+        char *end = nullptr;
+        options.pollMs.push_back(
+            static_cast<uint32_t>(std::strtoul(p, &end, 10)));
+        if (end == p || options.pollMs.back() == 0) {
+          return false;
+        }
+        p = *end == ',' ? end + 1 : end;
+      }
+    } else if (arg == "--cycles") {
+      options.cycles = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    } else if (arg == "--bus-hz") {
+      options.timing.busHz =
+          static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    } else if (arg == "--read-bytes") {
+      options.timing.readBytes =
+          static_cast<uint8_t>(std::strtoul(value, nullptr, 10));
+    } else if (arg == "--wake-us") {
+      options.wakeUs = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    } else if (arg == "--fallback-ms") {
+      options.fallbackMs =
+          static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    } else if (arg == "--edge-loss") {
+      options.edgeLoss = std::atof(value);
+    } else if (arg == "--seed") {
+      options.seed = std::strtoull(value, nullptr, 10);
+    } else {
+      return false;
+    }
+  }
+  return !options.pollMs.empty() && options.cycles > 0 &&
+         options.timing.busHz > 0 && options.fallbackMs > 0;
+}
+
+bool isDone(const char *text) {
+  bridge_link::Status status;
+  return bridge_link::parseStatus(text, strlen(text), status) &&
+         bridge_link::isTerminal(status);
+}
+
+struct RunResult {
+  LatencyHistogram latency;
+  uint32_t motions = 0;
+  uint32_t reads = 0;
+  uint64_t busBusyUs = 0;
+  // From each command to the master seeing it done.
+  uint64_t watchedUs = 0;
+};
+
+// One motion: the command goes out at startUs, the master watches until a
+// read says DONE. Returns when it did.
+uint64_t watchMotion(Mode mode, uint64_t periodUs, const Options &options,
+                     BridgeStandIn &bridge, uint64_t startUs,
+                     std::mt19937_64 &rng, const char *motion) {
+  std::uniform_int_distribution<uint64_t> phase(0, periodUs - 1);
+  std::bernoulli_distribution lost(options.edgeLoss);
+  const uint64_t commandDoneUs = bridge.command(motion, startUs);
+  const uint64_t fallbackUs = options.fallbackMs * 1000ULL;
+  const uint64_t edgeUs = bridge.irqAtUs() + options.wakeUs;
+  const bool edgeSeen = mode != Mode::POLL && !lost(rng);
+
+  uint64_t nextPollUs = mode == Mode::IRQ ? commandDoneUs + fallbackUs
+                                          : commandDoneUs + phase(rng);
+  bool edgePending = edgeSeen;
+  char text[bridge_link::STATUS_TEXT_CAPACITY + 1];
+  while (true) {
+    uint64_t atUs = nextPollUs;
+    if (edgePending && edgeUs <= nextPollUs) {
+      atUs = edgeUs;
+      edgePending = false;
+    }
+    const uint64_t readDoneUs = bridge.read(atUs, text, sizeof(text));
+    if (isDone(text)) {
+      return readDoneUs;
+    }
+    // The loop waits its period from where it ran.
+    nextPollUs = atUs + (mode == Mode::IRQ ? fallbackUs : periodUs);
+    if (nextPollUs < readDoneUs) {
+      nextPollUs = readDoneUs;
+    }
+  }
+}
+
+RunResult run(Mode mode, uint32_t pollMs, const Options &options) {
+  RunResult result;
+  BridgeStandIn bridge(options.timing);
+  std::mt19937_64 rng(options.seed);
+  std::uniform_int_distribution<uint64_t> gap(GAP_MIN_US, GAP_MAX_US);
+  const uint64_t periodUs = pollMs * 1000ULL;
+  uint64_t nowUs = 0;
+  for (uint32_t cycle = 0; cycle < options.cycles; ++cycle) {
+    for (size_t i = 0; i < MOTION_COUNT; ++i) {
+      nowUs += gap(rng);
+      const uint32_t readsBefore = bridge.reads();
+      const uint64_t busBefore = bridge.busBusyUs();
+      const uint64_t seenUs = watchMotion(mode, periodUs, options, bridge,
+                                          nowUs, rng, MOTIONS[i]);
+      result.latency.add(
+          static_cast<uint32_t>(seenUs - bridge.motionDoneUs()));
+      result.motions++;
+      result.reads += bridge.reads() - readsBefore;
+      result.busBusyUs += bridge.busBusyUs() - busBefore;
+      result.watchedUs += seenUs - nowUs;
+      nowUs = seenUs;
+    }
+  }
+  return result;
+}
+
+void printRow(Mode mode, uint32_t pollMs, const RunResult &result) {
+  std::printf("%-5s %7lu %7lu %8.2f %8.2f %8.2f %8.2f %9.1f %6.2f\n",
+              modeName(mode), static_cast<unsigned long>(pollMs),
+              static_cast<unsigned long>(result.motions),
+              result.latency.percentile(0.50f) * 0.001,
+              result.latency.percentile(0.90f) * 0.001,
+              result.latency.percentile(0.99f) * 0.001,
+              result.latency.max() * 0.001,
+              static_cast<double>(result.reads) / result.motions,
+              100.0 * static_cast<double>(result.busBusyUs) /
+                  static_cast<double>(result.watchedUs));
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseArgs(argc, argv, options)) {
+    usage(argv[0]);
+    return 2;
+  }
+  std::printf("mode  poll_ms motions  lat_p50  lat_p90  lat_p99  lat_max "
+              "reads/mot  bus_%%   (ms)\n");
+  for (uint32_t pollMs : options.pollMs) {
+    printRow(Mode::POLL, pollMs, run(Mode::POLL, pollMs, options));
+    printRow(Mode::WAKE, pollMs, run(Mode::WAKE, pollMs, options));
+  }
+  printRow(Mode::IRQ, options.fallbackMs,
+           run(Mode::IRQ, options.fallbackMs, options));
+  return 0;
+}
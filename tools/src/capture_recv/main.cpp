@@ -0,0 +1,368 @@
+// Receiver for the ir_meter high-rate capture stream. Reads from the USB
+// serial device (and starts/stops the capture) or replays a saved raw
+// stream, checks CRC and sequence numbers, and writes CSV and/or a beacon
+// trace (common/trace_file) that is appended a second of samples at a time.
+
+#include "ir_meter_config.h"
+
+#include <beacon_tracker.h>
+#include <capture_block.h>
+#include <trace_writer.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+constexpr float RADIANS_TO_DEG = 57.29577951308232f;
+
+struct Options {
+  std::string input;
+  std::string output;
+  std::string saveRaw;
+  std::string trace;
+  uint32_t rateHz = 1000;
+  double seconds = 10.0;
+  bool raw = false;
+};
+
+struct Receiver {
+  std::FILE *out = nullptr;
+  trace_file::TraceWriter *trace = nullptr;
+  bool raw = false;
+  BeaconTracker tracker{ir_meter_config::trackerConfig()};
+
+  bool started = false;
+  uint32_t nextSequence = 0;
+  uint64_t blocks = 0;
+  uint64_t samples = 0;
+  uint64_t droppedBlocks = 0;
+  uint64_t overrunBlocks = 0;
+  uint64_t restarts = 0;
+  uint32_t lastSampleUs = 0;
+  uint64_t timeBaseUs = 0; // unwraps the 32-bit device clock
+  double firstTimeMs = -1.0;
+  double lastTimeMs = 0.0;
+};
+
+// The t_ms and raw_* columns both layouts start with.
+void writeTraceRow(trace_file::TraceWriter &trace, double tMs,
+                   const uint16_t *raw) {
+  trace.set(0, tMs);
+  for (uint8_t c = 0; c < capture_block::CHANNELS; ++c) {
+    trace.set(1 + c, raw[c]);
+  }
+}
+
+// The trace's header records what produced it: the capture settings and
+// the tracker tuning the A_*/theta/S columns were computed with.
+std::string traceMeta(const Options &options) {
+  std::string meta;
+  trace_file::addMeta(meta, "source", "capture_recv");
+  trace_file::addMeta(meta, "input", options.input);
+  trace_file::addMeta(meta, "rate_hz", std::to_string(options.rateHz));
+  if (options.raw) {
+    return meta;
+  }
+  trace_file::addMeta(meta, "firmware", "ir_meter");
+  trace_file::addMeta(meta, "tracker_signal_min",
+                      std::to_string(ir_meter_config::TRACKER_SIGNAL_MIN));
+  trace_file::addMeta(meta, "tracker_angle_alpha",
+                      std::to_string(ir_meter_config::TRACKER_ANGLE_ALPHA));
+  trace_file::addMeta(
+      meta, "tracker_max_angle_step_rad",
+      std::to_string(ir_meter_config::TRACKER_MAX_ANGLE_STEP_RAD));
+  trace_file::addMeta(
+      meta, "tracker_signal_drop_guard_ratio",
+      std::to_string(ir_meter_config::TRACKER_SIGNAL_DROP_GUARD_RATIO));
+  trace_file::addMeta(
+      meta, "tracker_saturation_raw_threshold",
+      std::to_string(ir_meter_config::TRACKER_SATURATION_RAW_THRESHOLD));
+  trace_file::addMeta(meta, "tracker_guard_hold_ms",
+                      std::to_string(ir_meter_config::TRACKER_GUARD_HOLD_MS));
+  return meta;
+}
+
+void onFrame(const capture_block::Header &header, const uint8_t *samples,
+             void *context) {
+  Receiver &rx = *static_cast<Receiver *>(context);
+  if (rx.started) {
+    if (header.sequence >= rx.nextSequence) {
+      rx.droppedBlocks += header.sequence - rx.nextSequence;
+    } else {
+      rx.restarts++; // device rebooted
+    }
+    if (header.firstSampleUs < rx.lastSampleUs) {
+      rx.timeBaseUs += 1ULL << 32;
+    }
+  }
+  rx.started = true;
+  rx.nextSequence = header.sequence + 1;
+  rx.lastSampleUs = header.firstSampleUs;
+  rx.blocks++;
+  if ((header.flags & capture_block::FLAG_TICK_OVERRUN) != 0) {
+    rx.overrunBlocks++;
+  }
+
+  for (uint16_t i = 0; i < header.sampleCount; ++i) {
+    uint16_t raw[capture_block::CHANNELS];
+    for (uint8_t c = 0; c < capture_block::CHANNELS; ++c) {
+      const uint8_t *p = samples + (i * capture_block::CHANNELS + c) * 2;
+      raw[c] = static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+    const uint64_t tUs = rx.timeBaseUs + header.firstSampleUs +
+                         static_cast<uint64_t>(i) * header.periodUs;
+    const double tMs = tUs / 1000.0;
+    if (rx.firstTimeMs < 0) {
+      rx.firstTimeMs = tMs;
+    }
+    rx.lastTimeMs = tMs;
+    rx.samples++;
+
+    if (rx.raw) {
+      if (rx.out != nullptr) {
+        std::fprintf(rx.out, "%.3f,%u,%u,%u,%u,%lu\n", tMs, raw[0], raw[1],
+                     raw[2], raw[3],
+                     static_cast<unsigned long>(header.sequence));
+      }
+      if (rx.trace != nullptr) {
+        writeTraceRow(*rx.trace, tMs, raw);
+        rx.trace->set(1 + capture_block::CHANNELS, header.sequence);
+        rx.trace->endRow();
+      }
+      continue;
+    }
+    const BeaconTrackerState &s = rx.tracker.update(
+        raw[0], raw[1], raw[2], raw[3], static_cast<uint32_t>(tUs / 1000));
+    if (rx.trace != nullptr) {
+      const float values[] = {s.front, s.back, s.left, s.right,
+                              s.vx,    s.vy,   s.filteredTheta,
+                              s.filteredTheta * RADIANS_TO_DEG,
+                              s.totalSignal};
+      writeTraceRow(*rx.trace, tMs, raw);
+      size_t column = 1 + capture_block::CHANNELS;
+      for (float value : values) {
+        rx.trace->set(column++, value);
+      }
+      rx.trace->set(column, s.detected ? 1.0 : 0.0);
+      rx.trace->endRow();
+    }
+    if (rx.out == nullptr) {
+      continue;
+    }
+    std::fprintf(rx.out,
+                 "%.3f,%u,%u,%u,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.4f,%.2f,"
+                 "%.1f,%u\n",
+                 tMs, raw[0], raw[1], raw[2], raw[3], s.front, s.back, s.left,
+                 s.right, s.vx, s.vy, s.filteredTheta,
+                 s.filteredTheta * RADIANS_TO_DEG, s.totalSignal,
+                 s.detected ? 1U : 0U);
+  }
+}
+
+bool configureSerial(int fd) {
+  termios tty;
+  if (tcgetattr(fd, &tty) != 0) {
+    return false;
+  }
+  cfmakeraw(&tty);
+  cfsetispeed(&tty, B115200); // ignored by USB CDC, required by termios
+  cfsetospeed(&tty, B115200);
+  tty.c_cc[VMIN] = 0;
+  tty.c_cc[VTIME] = 1; // reads return after 100 ms without data
+  return tcsetattr(fd, TCSANOW, &tty) == 0;
+}
+
+void sendCommand(int fd, const std::string &command) {
+  const std::string line = command + "\n";
+  if (write(fd, line.data(), line.size()) != static_cast<ssize_t>(line.size())) {
+    std::fprintf(stderr, "failed to send '%s'\n", command.c_str());
+  }
+}
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "usage: %s [options] DEVICE|RAW_FILE\n"
+               "  --rate HZ       capture rate for a device (default 1000)\n"
+               "  --seconds S     capture duration for a device (default 10)\n"
+               "  --out FILE      CSV output (default stdout, none with --trace)\n"
+               "  --trace FILE    beacon trace output, a chunk per second\n"
+               "  --raw           write t_ms,raw_f,raw_b,raw_l,raw_r,block only\n"
+               "  --save-raw FILE also save the received byte stream\n",
+               program);
+}
+
+bool parseArgs(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--rate" && hasValue) {
+      options.rateHz = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--seconds" && hasValue) {
+      options.seconds = std::atof(argv[++i]);
+    } else if (arg == "--out" && hasValue) {
+      options.output = argv[++i];
+    } else if (arg == "--trace" && hasValue) {
+      options.trace = argv[++i];
+    } else if (arg == "--save-raw" && hasValue) {
+      options.saveRaw = argv[++i];
+    } else if (arg == "--raw") {
+      options.raw = true;
+    } else if (!arg.empty() && arg[0] != '-' && options.input.empty()) {
+      options.input = arg;
+    } else {
+      return false;
+    }
+  }
+  return !options.input.empty();
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseArgs(argc, argv, options)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  const int fd = open(options.input.c_str(), O_RDWR | O_NOCTTY);
+  const int in = fd >= 0 ? fd : open(options.input.c_str(), O_RDONLY);
+  if (in < 0) {
+    std::fprintf(stderr, "cannot open %s\n", options.input.c_str());
+    return 1;
+  }
+  const bool device = isatty(in) != 0;
+  if (device && !configureSerial(in)) {
+    std::fprintf(stderr, "cannot configure %s\n", options.input.c_str());
+    return 1;
+  }
+
+  Receiver rx;
+  rx.raw = options.raw;
+  rx.out = options.trace.empty() ? stdout : nullptr;
+  if (!options.output.empty()) {
+    rx.out = std::fopen(options.output.c_str(), "w");
+    if (rx.out == nullptr) {
+      std::fprintf(stderr, "cannot write %s\n", options.output.c_str());
+      return 1;
+    }
+  }
+  std::FILE *saved = nullptr;
+  if (!options.saveRaw.empty()) {
+    saved = std::fopen(options.saveRaw.c_str(), "wb");
+  }
+
+  const char *const columns =
+      rx.raw ? "t_ms,raw_f,raw_b,raw_l,raw_r,block"
+             : "t_ms,raw_f,raw_b,raw_l,raw_r,A_F,A_B,A_L,A_R,vx,vy,theta_rad,"
+               "theta_deg,S,detected";
+  if (rx.out != nullptr) {
+    std::fprintf(rx.out, "%s\n", columns);
+  }
+  trace_file::TraceWriter trace;
+  if (!options.trace.empty()) {
+    std::vector<trace_file::Column> traceColumns;
+    std::string name;
+    for (const char *p = columns;; ++p) {
+      if (*p == ',' || *p == '\0') {
+        traceColumns.push_back(trace_file::beaconColumn(name));
+        name.clear();
+        if (*p == '\0') {
+          break;
+        }
+      } else {
+        name += *p;
+      }
+    }
+    // A reader following the capture is at most a second behind.
+    if (!trace.create(options.trace.c_str(), traceColumns, traceMeta(options),
+                      options.rateHz > 0 ? options.rateHz : 1000)) {
+      std::fprintf(stderr, "cannot write %s\n", options.trace.c_str());
+      return 1;
+    }
+    rx.trace = &trace;
+  }
+
+  static capture_block::FrameParser parser(onFrame, &rx);
+  if (device) {
+    tcflush(in, TCIFLUSH);
+    sendCommand(in, "capture start " + std::to_string(options.rateHz));
+  }
+
+  const auto startedAt = std::chrono::steady_clock::now();
+  uint8_t buffer[4096];
+  for (;;) {
+    if (device) {
+      const double elapsed = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - startedAt)
+                                 .count();
+      if (elapsed >= options.seconds) {
+        break;
+      }
+    }
+    const ssize_t n = read(in, buffer, sizeof(buffer));
+    if (n < 0) {
+      std::perror("read");
+      break;
+    }
+    if (n == 0) {
+      if (device) {
+        continue;
+      }
+      break;
+    }
+    if (saved != nullptr) {
+      std::fwrite(buffer, 1, static_cast<size_t>(n), saved);
+    }
+    parser.feed(buffer, static_cast<size_t>(n));
+  }
+
+  if (device) {
+    sendCommand(in, "capture stop");
+    // Drain the blocks still in flight.
+    for (int idle = 0; idle < 3;) {
+      const ssize_t n = read(in, buffer, sizeof(buffer));
+      if (n <= 0) {
+        idle++;
+        continue;
+      }
+      if (saved != nullptr) {
+        std::fwrite(buffer, 1, static_cast<size_t>(n), saved);
+      }
+      parser.feed(buffer, static_cast<size_t>(n));
+    }
+  }
+  close(in);
+  if (saved != nullptr) {
+    std::fclose(saved);
+  }
+  if (rx.out != nullptr && rx.out != stdout) {
+    std::fclose(rx.out);
+  }
+  if (rx.trace != nullptr && !trace.close()) {
+    std::fprintf(stderr, "write to %s failed\n", options.trace.c_str());
+  }
+
+  const double spanS = (rx.lastTimeMs - rx.firstTimeMs) / 1000.0;
+  std::fprintf(stderr,
+               "blocks=%llu samples=%llu rate=%.1f Hz dropped_blocks=%llu "
+               "overrun_blocks=%llu crc_errors=%u skipped_bytes=%llu "
+               "restarts=%llu\n",
+               static_cast<unsigned long long>(rx.blocks),
+               static_cast<unsigned long long>(rx.samples),
+               spanS > 0 ? (rx.samples - 1) / spanS : 0.0,
+               static_cast<unsigned long long>(rx.droppedBlocks),
+               static_cast<unsigned long long>(rx.overrunBlocks),
+               parser.crcErrors(),
+               static_cast<unsigned long long>(parser.skippedBytes()),
+               static_cast<unsigned long long>(rx.restarts));
+  return rx.droppedBlocks == 0 && parser.crcErrors() == 0 ? 0 : 3;
+}
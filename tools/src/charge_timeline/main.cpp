@@ -0,0 +1,267 @@
+// Rebuilds charging cycles from the `evt,...` lines that master and slaves
+// stamp in the mesh timebase (common/clock_sync) and breaks each cycle down
+// into the time spent between milestones.
+//
+// Input is any mix of master captures (own events plus slave events relayed
+// as `wireless_log,<from>,evt,...`) and slave USB captures; events seen in
+// more than one capture are counted once.
+
+#include <clock_sync.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+struct Milestone {
+  const char *event;
+  const char *label;
+};
+
+// One charging cycle, in the order the milestones happen. `enjoin` and
+// `cancel` come from the master, the rest from the slave. The master
+// enjoins twice: to walk to the station, and to walk in once the gear is
+// lowered.
+const Milestone MILESTONES[] = {
+    {"work", "work"},
+    {"enjoin", "enjoin_walk"},
+    {"walk_to_charge", "walk_to_charge"},
+    {"arrived", "arrived"},
+    {"wait_charge", "wait_charge"},
+    {"enjoin", "enjoin_into"},
+    {"walk_into_charge", "walk_into_charge"},
+    {"charge", "charge"},
+    {"stop_request", "stop_request"},
+    {"cancel", "cancel"},
+    {"exit_charge", "exit_charge"}};
+constexpr size_t MILESTONE_COUNT = sizeof(MILESTONES) / sizeof(MILESTONES[0]);
+
+struct Stamp {
+  bool seen = false;
+  uint64_t meshUs = 0;
+  uint32_t errorUs = 0;
+};
+
+struct Cycle {
+  uint32_t subject = 0;
+  uint32_t index = 0;
+  Stamp stamps[MILESTONE_COUNT];
+  // Last milestone reached; later events can only fill ones after it.
+  int last = -1;
+};
+
+struct Segment {
+  std::vector<double> ms;
+  // Negative by more than the two error bounds: out of order even allowing
+  // for the clock error.
+  size_t outOfOrder = 0;
+};
+
+// First milestone after `after` that `name` stands for, -1 if none.
+int milestoneOf(const char *name, int after = -1) {
+  for (size_t i = static_cast<size_t>(after + 1); i < MILESTONE_COUNT; ++i) {
+    if (std::strcmp(MILESTONES[i].event, name) == 0) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+// `evt,` at the start of the line or after the relay prefix.
+bool findEvent(const std::string &line, clock_sync::Event &event) {
+  size_t at = line.find(clock_sync::EVENT_PREFIX);
+  while (at != std::string::npos) {
+    if (at == 0 || line[at - 1] == ',') {
+      return clock_sync::parseEvent(line.c_str() + at, event);
+    }
+    at = line.find(clock_sync::EVENT_PREFIX, at + 1);
+  }
+  return false;
+}
+
+double percentileOf(const std::vector<double> &sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  const size_t rank = static_cast<size_t>(
+      std::ceil(fraction * static_cast<double>(sorted.size())) - 1.0);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+double msBetween(const Stamp &from, const Stamp &to) {
+  return (static_cast<double>(to.meshUs) - static_cast<double>(from.meshUs)) /
+         1000.0;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<const char *> inputs;
+  const char *output = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+  if (inputs.empty()) {
+    std::fprintf(stderr, "usage: %s [--out CYCLES.csv] CAPTURE.txt...\n",
+                 argv[0]);
+    return 2;
+  }
+
+  std::vector<clock_sync::Event> events;
+  std::set<std::tuple<uint32_t, uint64_t, std::string>> seen;
+  size_t duplicates = 0;
+  size_t unknown = 0;
+  for (const char *path : inputs) {
+    std::ifstream file(path);
+    if (!file) {
+      std::fprintf(stderr, "cannot open %s\n", path);
+      return 1;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+      clock_sync::Event event;
+      if (!findEvent(line, event)) {
+        continue;
+      }
+      if (milestoneOf(event.name) < 0) {
+        unknown++;
+        continue;
+      }
+      if (!seen.insert(std::make_tuple(event.node, event.meshUs,
+                                       std::string(event.name)))
+               .second) {
+        duplicates++;
+        continue;
+      }
+      events.push_back(event);
+    }
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const clock_sync::Event &a, const clock_sync::Event &b) {
+                     return a.meshUs < b.meshUs;
+                   });
+
+  // A cycle starts at `work`, or at a milestone the open cycle is already
+  // past when the capture missed the start.
+  std::vector<Cycle> cycles;
+  std::map<uint32_t, size_t> open;
+  std::map<uint32_t, uint32_t> counts;
+  for (const clock_sync::Event &event : events) {
+    auto current = open.find(event.subject);
+    int milestone = current == open.end()
+                        ? -1
+                        : milestoneOf(event.name,
+                                      cycles[current->second].last);
+    if (milestone <= 0) {
+      Cycle cycle;
+      cycle.subject = event.subject;
+      cycle.index = counts[event.subject]++;
+      cycles.push_back(cycle);
+      open[event.subject] = cycles.size() - 1;
+      current = open.find(event.subject);
+      milestone = milestoneOf(event.name);
+    }
+    Cycle &cycle = cycles[current->second];
+    cycle.last = milestone;
+    Stamp &stamp = cycle.stamps[milestone];
+    stamp.seen = true;
+    stamp.meshUs = event.meshUs;
+    stamp.errorUs = event.errorUs;
+  }
+
+  std::FILE *out = stdout;
+  if (output != nullptr) {
+    out = std::fopen(output, "w");
+    if (out == nullptr) {
+      std::fprintf(stderr, "cannot write %s\n", output);
+      return 1;
+    }
+  }
+  std::fprintf(out, "node,cycle,start_us");
+  for (size_t i = 1; i < MILESTONE_COUNT; ++i) {
+    std::fprintf(out, ",%s_ms", MILESTONES[i].label);
+  }
+  std::fprintf(out, ",err_ms\n");
+
+  Segment segments[MILESTONE_COUNT];
+  Segment total;
+  for (const Cycle &cycle : cycles) {
+    const Stamp &start = cycle.stamps[0];
+    uint32_t worstErrorUs = 0;
+    for (const Stamp &stamp : cycle.stamps) {
+      worstErrorUs = stamp.seen ? std::max(worstErrorUs, stamp.errorUs)
+                                : worstErrorUs;
+    }
+    std::fprintf(out, "%lu,%lu,", static_cast<unsigned long>(cycle.subject),
+                 static_cast<unsigned long>(cycle.index));
+    if (start.seen) {
+      std::fprintf(out, "%llu",
+                   static_cast<unsigned long long>(start.meshUs));
+    }
+    for (size_t i = 1; i < MILESTONE_COUNT; ++i) {
+      if (start.seen && cycle.stamps[i].seen) {
+        std::fprintf(out, ",%.1f", msBetween(start, cycle.stamps[i]));
+      } else {
+        std::fprintf(out, ",");
+      }
+    }
+    std::fprintf(out, ",%.1f\n", worstErrorUs / 1000.0);
+
+    // Segment i runs from milestone i-1 to milestone i.
+    for (size_t i = 1; i < MILESTONE_COUNT; ++i) {
+      const Stamp &from = cycle.stamps[i - 1];
+      const Stamp &to = cycle.stamps[i];
+      if (!from.seen || !to.seen) {
+        continue;
+      }
+      const double ms = msBetween(from, to);
+      segments[i].ms.push_back(ms);
+      if (-ms * 1000.0 > static_cast<double>(from.errorUs + to.errorUs)) {
+        segments[i].outOfOrder++;
+      }
+    }
+    const Stamp &end = cycle.stamps[MILESTONE_COUNT - 1];
+    if (start.seen && end.seen) {
+      total.ms.push_back(msBetween(start, end));
+    }
+  }
+  if (out != stdout) {
+    std::fclose(out);
+  }
+
+  std::fprintf(stderr, "%zu events, %zu cycles", events.size(), cycles.size());
+  if (duplicates > 0 || unknown > 0) {
+    std::fprintf(stderr, " (%zu duplicates, %zu unknown names skipped)",
+                 duplicates, unknown);
+  }
+  std::fprintf(stderr, "\n%-34s %5s %10s %10s %10s %s\n", "segment", "n",
+               "p50_ms", "p90_ms", "max_ms", "out_of_order");
+  for (size_t i = 1; i <= MILESTONE_COUNT; ++i) {
+    Segment &segment = i < MILESTONE_COUNT ? segments[i] : total;
+    if (segment.ms.empty()) {
+      continue;
+    }
+    std::sort(segment.ms.begin(), segment.ms.end());
+    const std::string name =
+        i < MILESTONE_COUNT
+            ? std::string(MILESTONES[i - 1].label) + " -> " +
+                  MILESTONES[i].label
+            : std::string("cycle (work -> exit_charge)");
+    std::fprintf(stderr, "%-34s %5zu %10.1f %10.1f %10.1f %zu\n",
+                 name.c_str(), segment.ms.size(),
+                 percentileOf(segment.ms, 0.50), percentileOf(segment.ms, 0.90),
+                 segment.ms.back(), segment.outOfOrder);
+  }
+  return 0;
+}
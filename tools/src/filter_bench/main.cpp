@@ -0,0 +1,457 @@
+// Checks and measures the window filters in common/filters:
+// - every median network against std::nth_element (all 0/1 inputs, which
+//   is sufficient for comparator networks, plus random inputs), the Hampel
+//   filter against a straightforward sort-based version and the moving
+//   average against a recomputed sum,
+// - host time per four-channel push, next to the branchy median3 the tracker
+//   used before,
+// - on recorded CSVs (evaluation/data), how many spikes survive each
+//   tracker prefilter and how much the filtered bearing jitters.
+
+
+#include <beacon_tracker.h>
+#include <window_filters.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr size_t LANES = 4;
+constexpr int TIMING_REPEATS = 15;
+// A prefiltered sample counts as a surviving spike when it is this far from
+// the centred 11-sample median of the raw channel.
+constexpr uint32_t SPIKE_COUNTS = 300;
+constexpr size_t REFERENCE_HALF_WINDOW = 5;
+
+typedef std::vector<uint32_t> Channel;
+
+struct Recording {
+  std::string path;
+  std::vector<uint32_t> tMs;
+  Channel raw[LANES];
+};
+
+bool loadRecording(const char *path, Recording &recording) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  recording.path = path;
+  std::string line;
+  std::getline(file, line); // header
+  while (std::getline(file, line)) {
+    std::stringstream row(line);
+    std::string cell;
+    uint32_t values[1 + LANES];
+    bool ok = true;
+    for (uint32_t &value : values) {
+      if (!std::getline(row, cell, ',') || cell.empty()) {
+        ok = false;
+        break;
+      }
+      value = static_cast<uint32_t>(std::strtoul(cell.c_str(), nullptr, 10));
+    }
+    if (!ok) {
+      continue;
+    }
+    recording.tMs.push_back(values[0]);
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      recording.raw[lane].push_back(values[1 + lane]);
+    }
+  }
+  return !recording.tMs.empty();
+}
+
+template <size_t N> bool checkMedianNetwork(std::mt19937 &rng) {
+  uint32_t window[N][LANES];
+  uint32_t out[LANES];
+  // 0/1 principle: a comparator network selects the median of every input
+  // if it does so for every binary input.
+  for (uint32_t bits = 0; bits < (1U << N); ++bits) {
+    size_t ones = 0;
+    for (size_t row = 0; row < N; ++row) {
+      const uint32_t bit = (bits >> row) & 1U;
+      ones += bit;
+      for (size_t lane = 0; lane < LANES; ++lane) {
+        window[row][lane] = bit;
+      }
+    }
+    window_filters::median(window, out);
+    const uint32_t expected = ones > N / 2 ? 1U : 0U;
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      if (out[lane] != expected) {
+        return false;
+      }
+    }
+  }
+  std::uniform_int_distribution<uint32_t> adc(0, 4095);
+  for (int trial = 0; trial < 20000; ++trial) {
+    std::vector<uint32_t> column[LANES];
+    for (size_t row = 0; row < N; ++row) {
+      for (size_t lane = 0; lane < LANES; ++lane) {
+        window[row][lane] = adc(rng);
+        column[lane].push_back(window[row][lane]);
+      }
+    }
+    window_filters::median(window, out);
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      std::nth_element(column[lane].begin(), column[lane].begin() + N / 2,
+                       column[lane].end());
+      if (out[lane] != column[lane][N / 2]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+uint32_t sortedMedian(std::vector<uint32_t> values) {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+bool checkHampel(std::mt19937 &rng) {
+  constexpr size_t N = 7;
+  constexpr uint32_t MIN_DEVIATION = 40;
+  window_filters::HampelFilter<uint32_t, N> filter(
+      window_filters::HAMPEL_DEFAULT_THRESHOLD_Q8, MIN_DEVIATION);
+  std::normal_distribution<double> noise(0.0, 30.0);
+  std::uniform_int_distribution<int> spike(0, 19);
+  std::vector<uint32_t> history[LANES];
+  for (int i = 0; i < 50000; ++i) {
+    uint32_t in[LANES];
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      double value = 2000.0 + 400.0 * std::sin(i * 0.01 + lane) + noise(rng);
+      if (spike(rng) == 0) {
+        value += 1500.0;
+      }
+      in[lane] = static_cast<uint32_t>(std::min(4095.0, std::max(0.0, value)));
+      history[lane].push_back(in[lane]);
+    }
+    uint32_t out[LANES];
+    filter.push(in, out);
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      uint32_t expected = in[lane];
+      if (history[lane].size() >= N) {
+        const std::vector<uint32_t> window(history[lane].end() - N,
+                                           history[lane].end());
+        const uint32_t center = sortedMedian(window);
+        std::vector<uint32_t> deviations;
+        for (uint32_t value : window) {
+          deviations.push_back(value > center ? value - center
+                                              : center - value);
+        }
+        const uint64_t limit = std::max<uint64_t>(
+            MIN_DEVIATION, (static_cast<uint64_t>(sortedMedian(deviations)) *
+                            window_filters::HAMPEL_DEFAULT_THRESHOLD_Q8) >>
+                               8);
+        const uint32_t deviation =
+            in[lane] > center ? in[lane] - center : center - in[lane];
+        expected = deviation > limit ? center : in[lane];
+      }
+      if (out[lane] != expected) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool checkMovingAverage(std::mt19937 &rng) {
+  constexpr size_t CAPACITY = 8;
+  window_filters::MovingAverage<uint32_t, CAPACITY> average;
+  std::uniform_int_distribution<uint32_t> adc(0, 4095);
+  std::vector<uint32_t> history[LANES];
+  for (int i = 0; i < 10000; ++i) {
+    uint32_t in[LANES];
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      in[lane] = adc(rng);
+      history[lane].push_back(in[lane]);
+    }
+    average.push(in);
+    uint32_t out[LANES];
+    average.average(out);
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      const size_t count = std::min(CAPACITY, history[lane].size());
+      uint64_t sum = 0;
+      for (size_t k = history[lane].size() - count; k < history[lane].size();
+           ++k) {
+        sum += history[lane][k];
+      }
+      if (out[lane] != sum / count) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// The tracker's previous prefilter: one history and a branchy median per
+// channel.
+struct LegacyMedian3 {
+  uint32_t values[LANES][3] = {};
+  uint8_t count = 0;
+  uint8_t index = 0;
+
+  static uint32_t median3(uint32_t a, uint32_t b, uint32_t c) {
+    if ((a <= b && b <= c) || (c <= b && b <= a)) {
+      return b;
+    }
+    if ((b <= a && a <= c) || (c <= a && a <= b)) {
+      return a;
+    }
+    return c;
+  }
+
+  void push(const uint32_t (&in)[LANES], uint32_t (&out)[LANES]) {
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      values[lane][index] = in[lane];
+    }
+    index = (index + 1U) % 3U;
+    if (count < 3U) {
+      count++;
+    }
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      out[lane] = count < 3U ? in[lane]
+                             : median3(values[lane][0], values[lane][1],
+                                       values[lane][2]);
+    }
+  }
+};
+
+struct AveragePush {
+  window_filters::MovingAverage<uint32_t, 4> average;
+  void push(const uint32_t (&in)[LANES], uint32_t (&out)[LANES]) {
+    average.push(in);
+    average.average(out);
+  }
+};
+
+// Median ns per four-channel push over the concatenated recordings.
+template <typename Filter>
+double nsPerPush(const std::vector<std::array<uint32_t, LANES>> &samples,
+                 Filter prototype) {
+  std::vector<double> runs;
+  uint32_t sink = 0;
+  for (int repeat = 0; repeat < TIMING_REPEATS; ++repeat) {
+    Filter filter = prototype;
+    const auto start = std::chrono::steady_clock::now();
+    for (const std::array<uint32_t, LANES> &sample : samples) {
+      uint32_t in[LANES] = {sample[0], sample[1], sample[2], sample[3]};
+      uint32_t out[LANES];
+      filter.push(in, out);
+      sink += out[0] ^ out[3];
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    runs.push_back(std::chrono::duration<double, std::nano>(elapsed).count() /
+                   static_cast<double>(samples.size()));
+  }
+  volatile uint32_t keep = sink;
+  (void)keep;
+  std::sort(runs.begin(), runs.end());
+  return runs[runs.size() / 2];
+}
+
+const char *prefilterName(RawPrefilter prefilter) {
+  switch (prefilter) {
+  case RawPrefilter::MEDIAN3:
+    return "median3";
+  case RawPrefilter::MEDIAN5:
+    return "median5";
+  case RawPrefilter::HAMPEL7:
+    return "hampel7";
+  }
+  return "?";
+}
+
+// Samples the prefilter delays by; the Hampel filter passes inliers
+// through as they are.
+size_t prefilterDelay(RawPrefilter prefilter) {
+  switch (prefilter) {
+  case RawPrefilter::MEDIAN3:
+    return 1;
+  case RawPrefilter::MEDIAN5:
+    return 2;
+  case RawPrefilter::HAMPEL7:
+    return 0;
+  }
+  return 0;
+}
+
+struct PrefilterScore {
+  size_t rawSpikes = 0;
+  size_t survivingSpikes = 0;
+  double errorSquares = 0.0;
+  size_t errorSamples = 0;
+  double thetaStepSquares = 0.0;
+  size_t thetaSteps = 0;
+};
+
+void scoreRecording(const Recording &recording, RawPrefilter prefilter,
+                    PrefilterScore &score) {
+  BeaconTrackerConfig config;
+  config.rawPrefilter = prefilter;
+  BeaconTracker tracker(config);
+  const size_t count = recording.tMs.size();
+  const size_t delay = prefilterDelay(prefilter);
+
+  // With the default calibration the amplitudes are the prefiltered raw
+  // counts.
+  std::vector<float> filtered[LANES];
+  float previousTheta = 0.0f;
+  bool havePrevious = false;
+  for (size_t i = 0; i < count; ++i) {
+    const BeaconTrackerState &state =
+        tracker.update(recording.raw[0][i], recording.raw[1][i],
+                       recording.raw[2][i], recording.raw[3][i],
+                       recording.tMs[i]);
+    filtered[0].push_back(state.front);
+    filtered[1].push_back(state.back);
+    filtered[2].push_back(state.left);
+    filtered[3].push_back(state.right);
+    if (state.detected) {
+      if (havePrevious) {
+        const double step = state.filteredTheta - previousTheta;
+        score.thetaStepSquares += step * step;
+        score.thetaSteps++;
+      }
+      previousTheta = state.filteredTheta;
+      havePrevious = true;
+    }
+  }
+
+  for (size_t lane = 0; lane < LANES; ++lane) {
+    const Channel &raw = recording.raw[lane];
+    for (size_t i = REFERENCE_HALF_WINDOW;
+         i + REFERENCE_HALF_WINDOW < count && i + delay < count; ++i) {
+      const std::vector<uint32_t> window(
+          raw.begin() + static_cast<long>(i - REFERENCE_HALF_WINDOW),
+          raw.begin() + static_cast<long>(i + REFERENCE_HALF_WINDOW + 1));
+      const double reference = sortedMedian(window);
+      // Error of what the tracker sees now, lag included.
+      const double error = filtered[lane][i] - reference;
+      score.errorSquares += error * error;
+      score.errorSamples++;
+      // A spike survives if the output that carries this sample is still
+      // off by as much.
+      if (std::fabs(raw[i] - reference) > SPIKE_COUNTS) {
+        score.rawSpikes++;
+        score.survivingSpikes +=
+            std::fabs(filtered[lane][i + delay] - reference) > SPIKE_COUNTS;
+      }
+    }
+  }
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  std::mt19937 rng(7);
+  const bool networksOk = checkMedianNetwork<3>(rng) &&
+                          checkMedianNetwork<5>(rng) &&
+                          checkMedianNetwork<7>(rng) &&
+                          checkMedianNetwork<9>(rng);
+  const bool hampelOk = checkHampel(rng);
+  const bool averageOk = checkMovingAverage(rng);
+  std::printf("median networks 3/5/7/9: %s\n", networksOk ? "ok" : "FAILED");
+  std::printf("hampel7 vs sort-based reference: %s\n",
+              hampelOk ? "ok" : "FAILED");
+  std::printf("moving average vs recomputed sum: %s\n",
+              averageOk ? "ok" : "FAILED");
+  if (!networksOk || !hampelOk || !averageOk) {
+    return 1;
+  }
+
+  std::vector<Recording> recordings;
+  std::vector<std::array<uint32_t, LANES>> samples;
+  for (int i = 1; i < argc; ++i) {
+    Recording recording;
+    if (!loadRecording(argv[i], recording)) {
+      std::fprintf(stderr, "skipping %s: no samples\n", argv[i]);
+      continue;
+    }
+    for (size_t k = 0; k < recording.tMs.size(); ++k) {
+      samples.push_back({recording.raw[0][k], recording.raw[1][k],
+                         recording.raw[2][k], recording.raw[3][k]});
+    }
+    recordings.push_back(recording);
+  }
+  if (samples.empty()) {
+    std::fprintf(stderr, "usage: %s <recording.csv>...\n", argv[0]);
+    return 2;
+  }
+
+  LegacyMedian3 legacy;
+  window_filters::MedianFilter<uint32_t, 3> median3;
+  size_t legacyMismatches = 0;
+  for (const std::array<uint32_t, LANES> &sample : samples) {
+    uint32_t in[LANES] = {sample[0], sample[1], sample[2], sample[3]};
+    uint32_t expected[LANES];
+    uint32_t out[LANES];
+    legacy.push(in, expected);
+    median3.push(in, out);
+    legacyMismatches += !std::equal(out, out + LANES, expected);
+  }
+  std::printf("median3 vs legacy prefilter on recordings: %s\n",
+              legacyMismatches == 0 ? "identical" : "DIFFERENT");
+
+  std::printf("\nns per 4-channel push (%zu samples, median of %d runs)\n",
+              samples.size(), TIMING_REPEATS);
+  std::printf("  legacy median3   %6.1f\n",
+              nsPerPush(samples, LegacyMedian3()));
+  std::printf("  median3          %6.1f\n",
+              nsPerPush(samples, window_filters::MedianFilter<uint32_t, 3>()));
+  std::printf("  median5          %6.1f\n",
+              nsPerPush(samples, window_filters::MedianFilter<uint32_t, 5>()));
+  std::printf("  median7          %6.1f\n",
+              nsPerPush(samples, window_filters::MedianFilter<uint32_t, 7>()));
+  std::printf("  median9          %6.1f\n",
+              nsPerPush(samples, window_filters::MedianFilter<uint32_t, 9>()));
+  std::printf("  hampel7          %6.1f\n",
+              nsPerPush(samples, window_filters::HampelFilter<uint32_t, 7>(
+                                     window_filters::HAMPEL_DEFAULT_THRESHOLD_Q8,
+                                     60)));
+  std::printf("  average4         %6.1f\n", nsPerPush(samples, AveragePush()));
+
+  const RawPrefilter prefilters[] = {RawPrefilter::MEDIAN3,
+                                     RawPrefilter::MEDIAN5,
+                                     RawPrefilter::HAMPEL7};
+  std::printf("\nspikes: samples > %u counts from the centred %zu-sample "
+              "median, before and after the prefilter\n"
+              "rms_err: prefiltered counts vs that median, lag included\n"
+              "theta_step: RMS filtered-theta change per tick (deg)\n",
+              SPIKE_COUNTS, 2 * REFERENCE_HALF_WINDOW + 1);
+  std::printf("%-12s %-8s %7s %7s %8s %10s\n", "recording", "filter",
+              "spikes", "left", "rms_err", "theta_step");
+  for (const Recording &recording : recordings) {
+    for (RawPrefilter prefilter : prefilters) {
+      PrefilterScore score;
+      scoreRecording(recording, prefilter, score);
+      const double rmsDeg =
+          score.thetaSteps == 0
+              ? 0.0
+              : std::sqrt(score.thetaStepSquares / score.thetaSteps) * 180.0 /
+                    M_PI;
+      const size_t slash = recording.path.find_last_of('/');
+      const double rmsError =
+          score.errorSamples == 0
+              ? 0.0
+              : std::sqrt(score.errorSquares / score.errorSamples);
+      std::printf("%-12s %-8s %7zu %7zu %8.1f %10.3f\n",
+                  recording.path.substr(slash == std::string::npos ? 0
+                                                                   : slash + 1)
+                      .c_str(),
+                  prefilterName(prefilter), score.rawSpikes,
+                  score.survivingSpikes, rmsError, rmsDeg);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,157 @@
+// Converts a slave flight-recorder dump (the `flight dump` serial command
+// output, captured to a file) into CSV with the evaluation/data columns.
+
+#include <flight_record.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr float CENTI_DEG_TO_RAD = 1.0f / 5729.577951308232f;
+
+const char *const SLAVE_STATE_NAMES[] = {
+    "WORK",        "WALKING_TO_CHARGE", "WAIT_CHARGE", "WALKING_INTO_CHARGE",
+    "CHARGE",      "EXITING_CHARGE"};
+
+int hexValue(char ch) {
+  if (ch >= '0' && ch <= '9') {
+    return ch - '0';
+  }
+  if (ch >= 'a' && ch <= 'f') {
+    return ch - 'a' + 10;
+  }
+  if (ch >= 'A' && ch <= 'F') {
+    return ch - 'A' + 10;
+  }
+  return -1;
+}
+
+bool decodeHex(const std::string &text, std::vector<uint8_t> &out) {
+  if (text.size() % 2 != 0) {
+    return false;
+  }
+  out.resize(text.size() / 2);
+  for (size_t i = 0; i < out.size(); ++i) {
+    const int high = hexValue(text[2 * i]);
+    const int low = hexValue(text[2 * i + 1]);
+    if (high < 0 || low < 0) {
+      return false;
+    }
+    out[i] = static_cast<uint8_t>((high << 4) | low);
+  }
+  return true;
+}
+
+void writeRecord(std::FILE *out, const FlightRecord &r) {
+  const float thetaRad = static_cast<float>(r.thetaCentiDeg) * CENTI_DEG_TO_RAD;
+  const char *state = r.slaveState < 6 ? SLAVE_STATE_NAMES[r.slaveState] : "?";
+  std::fprintf(
+      out,
+      "%lu,%u,%u,%u,%u,%u.0,%u.0,%u.0,%u.0,%d.0,%d.0,%.4f,%.2f,%u.0,%u,%s,%u,"
+      "%u,%s,%u,%u,%u\n",
+      static_cast<unsigned long>(r.tMs), r.raw[0], r.raw[1], r.raw[2],
+      r.raw[3], r.amplitude[0], r.amplitude[1], r.amplitude[2],
+      r.amplitude[3], static_cast<int>(r.amplitude[0]) - r.amplitude[1],
+      static_cast<int>(r.amplitude[2]) - r.amplitude[3], thetaRad,
+      static_cast<float>(r.thetaCentiDeg) / 100.0f, r.signal,
+      (r.flags & FlightRecord::FLAG_DETECTED) != 0 ? 1U : 0U,
+      (r.flags & FlightRecord::FLAG_SEARCH) != 0 ? "search" : "track",
+      r.dutyLeft, r.dutyRight, state, r.tickUs,
+      (r.flags & FlightRecord::FLAG_SATURATED) != 0 ? 1U : 0U,
+      (r.flags & FlightRecord::FLAG_EVENT) != 0 ? 1U : 0U);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    std::fprintf(stderr, "usage: %s DUMP.txt [OUT.csv]\n", argv[0]);
+    return 2;
+  }
+
+  std::ifstream input(argv[1]);
+  if (!input) {
+    std::fprintf(stderr, "cannot open %s\n", argv[1]);
+    return 1;
+  }
+
+  // Blocks are keyed by sequence number: the flash ring stores them by slot,
+  // so file order is not chronological once it has wrapped.
+  std::map<uint32_t, std::vector<uint8_t>> blocks;
+  std::string line;
+  size_t malformed = 0;
+  const std::string prefix = "flight_block,";
+  while (std::getline(input, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    const size_t at = line.find(prefix);
+    if (at == std::string::npos) {
+      continue;
+    }
+    std::vector<uint8_t> bytes;
+    flight_block::Header header;
+    if (!decodeHex(line.substr(at + prefix.size()), bytes) ||
+        !flight_block::readHeader(bytes.data(), bytes.size(), header)) {
+      malformed++;
+      continue;
+    }
+    blocks[header.sequence] = bytes;
+  }
+
+  std::FILE *out = stdout;
+  if (argc == 3) {
+    out = std::fopen(argv[2], "w");
+    if (out == nullptr) {
+      std::fprintf(stderr, "cannot write %s\n", argv[2]);
+      return 1;
+    }
+  }
+
+  std::fprintf(out, "t_ms,raw_f,raw_b,raw_l,raw_r,A_F,A_B,A_L,A_R,vx,vy,"
+                    "theta_rad,theta_deg,S,detected,mode,duty_l,duty_r,state,"
+                    "tick_us,saturated,event\n");
+
+  size_t records = 0;
+  size_t truncated = 0;
+  uint32_t expected = blocks.empty() ? 0 : blocks.begin()->first;
+  size_t gaps = 0;
+  for (const auto &entry : blocks) {
+    if (entry.first != expected) {
+      gaps++;
+    }
+    expected = entry.first + 1;
+
+    flight_block::Header header;
+    flight_block::readHeader(entry.second.data(), entry.second.size(), header);
+    const uint8_t *payload = entry.second.data() + flight_block::HEADER_SIZE;
+    size_t offset = 0;
+    FlightRecordDecoder decoder;
+    for (uint16_t i = 0; i < header.recordCount; ++i) {
+      FlightRecord record;
+      const size_t used =
+          decoder.decode(payload + offset, header.usedBytes - offset, record);
+      if (used == 0) {
+        truncated++;
+        break;
+      }
+      offset += used;
+      writeRecord(out, record);
+      records++;
+    }
+  }
+
+  if (out != stdout) {
+    std::fclose(out);
+  }
+  std::fprintf(stderr,
+               "blocks=%zu records=%zu sequence_gaps=%zu malformed_lines=%zu "
+               "truncated_blocks=%zu\n",
+               blocks.size(), records, gaps, malformed, truncated);
+  return 0;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+// In-process mesh for native builds. LoopbackCommunication offers the calls
+// of dezibot's Communication (sendMessage, unicast, onReceive,
+// onReceiveSingle, getNodeId) on std::string, so code written against it
+// runs on a desktop without radios. Messages travel in simulated time
+// through a simple model of the mesh:
+//
+// - one shared channel: a message holds it for its airtime, envelope
+//   included, so load queues everyone's traffic;
+// - a random extra delay per message (contention, retries);
+// - per receiving node, one mesh task that handles messages in arrival
+//   order, each taking a base time plus a per-byte time.
+//
+// The defaults are rough guesses for painlessMesh on an ESP32, not
+// measurements; the firmware benchmark measures the real thing.
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+struct LoopbackMeshConfig {
+  // painlessMesh wraps every message in a JSON envelope.
+  uint32_t envelopeBytes = 70;
+  float airtimeUsPerByte = 8.0f;
+  uint32_t airtimeBaseUs = 300;
+  float jitterMeanUs = 1500.0f;
+  uint32_t rxBaseUs = 400;
+  float rxUsPerByte = 3.0f;
+  float lossRate = 0.0f;
+};
+
+class LoopbackMesh {
+public:
+  using BroadcastHandler = std::function<void(std::string &)>;
+  using SingleHandler = std::function<void(uint32_t, std::string &)>;
+
+  LoopbackMesh(const LoopbackMeshConfig &config, uint64_t seed)
+      : config_(config), rng_(seed) {}
+
+  uint32_t addNode(uint32_t id) {
+    nodes_.push_back(Node{id, nullptr, nullptr, 0});
+    return id;
+  }
+
+  void setBroadcastHandler(uint32_t id, BroadcastHandler handler) {
+    node(id).onBroadcast = std::move(handler);
+  }
+
+  void setSingleHandler(uint32_t id, SingleHandler handler) {
+    node(id).onSingle = std::move(handler);
+  }
+
+  // `to` == 0 sends to every other node.
+  void send(uint32_t from, uint32_t to, const std::string &message) {
+    const double bytes =
+        static_cast<double>(message.size() + config_.envelopeBytes);
+    const uint64_t start = channelFreeAtUs_ > nowUs_ ? channelFreeAtUs_ : nowUs_;
+    channelFreeAtUs_ =
+        start + config_.airtimeBaseUs +
+        static_cast<uint64_t>(bytes * config_.airtimeUsPerByte);
+    std::exponential_distribution<double> jitter(
+        config_.jitterMeanUs > 0.0f ? 1.0 / config_.jitterMeanUs : 1e9);
+    std::uniform_real_distribution<float> loss(0.0f, 1.0f);
+    for (const Node &target : nodes_) {
+      if (target.id == from || (to != 0 && target.id != to)) {
+        continue;
+      }
+      if (loss(rng_) < config_.lossRate) {
+        dropped_++;
+        continue;
+      }
+      const uint64_t arrive =
+          channelFreeAtUs_ + static_cast<uint64_t>(jitter(rng_));
+      events_.push(Event{arrive, order_++, false, from, target.id, to != 0,
+                         message});
+    }
+  }
+
+  // Runs every arrival and delivery up to `untilUs`; handlers may send.
+  void runUntil(uint64_t untilUs) {
+    while (!events_.empty() && events_.top().atUs <= untilUs) {
+      Event event = events_.top();
+      events_.pop();
+      nowUs_ = event.atUs;
+      Node &target = node(event.to);
+      if (!event.handled) {
+        // Waits for the receiving node's mesh task.
+        const uint64_t start =
+            target.busyUntilUs > nowUs_ ? target.busyUntilUs : nowUs_;
+        target.busyUntilUs =
+            start + config_.rxBaseUs +
+            static_cast<uint64_t>(static_cast<float>(event.message.size() +
+                                                     config_.envelopeBytes) *
+                                  config_.rxUsPerByte);
+        event.atUs = target.busyUntilUs;
+        event.handled = true;
+        event.order = order_++;
+        events_.push(event);
+        continue;
+      }
+      delivered_++;
+      if (event.single) {
+        if (target.onSingle) {
+          target.onSingle(event.from, event.message);
+        }
+      } else if (target.onBroadcast) {
+        target.onBroadcast(event.message);
+      }
+    }
+    nowUs_ = untilUs;
+  }
+
+  // A handler that blocks, e.g. on a full serial port, holds its node's
+  // mesh task until `untilUs`; later messages to the node wait for it.
+  void occupy(uint32_t id, uint64_t untilUs) {
+    Node &target = node(id);
+    if (untilUs > target.busyUntilUs) {
+      target.busyUntilUs = untilUs;
+    }
+  }
+
+  uint64_t nowUs() const { return nowUs_; }
+  uint64_t delivered() const { return delivered_; }
+  uint64_t dropped() const { return dropped_; }
+
+private:
+  struct Node {
+    uint32_t id;
+    BroadcastHandler onBroadcast;
+    SingleHandler onSingle;
+    uint64_t busyUntilUs;
+  };
+
+  struct Event {
+    uint64_t atUs;
+    uint64_t order;
+    bool handled;
+    uint32_t from;
+    uint32_t to;
+    bool single;
+    std::string message;
+
+    bool operator>(const Event &other) const {
+      return atUs != other.atUs ? atUs > other.atUs : order > other.order;
+    }
+  };
+
+  Node &node(uint32_t id) {
+    for (Node &candidate : nodes_) {
+      if (candidate.id == id) {
+        return candidate;
+      }
+    }
+    return nodes_.front();
+  }
+
+  LoopbackMeshConfig config_;
+  std::mt19937_64 rng_;
+  std::vector<Node> nodes_;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+  uint64_t nowUs_ = 0;
+  uint64_t channelFreeAtUs_ = 0;
+  uint64_t order_ = 0;
+  uint64_t delivered_ = 0;
+  uint64_t dropped_ = 0;
+};
+
+class LoopbackCommunication {
+public:
+  LoopbackCommunication(LoopbackMesh &mesh, uint32_t nodeId)
+      : mesh_(mesh), nodeId_(mesh.addNode(nodeId)) {}
+
+  void begin() {}
+  uint32_t getNodeId() const { return nodeId_; }
+  void sendMessage(const std::string &message) {
+    mesh_.send(nodeId_, 0, message);
+  }
+  void unicast(uint32_t to, const std::string &message) {
+    mesh_.send(nodeId_, to, message);
+  }
+  void onReceive(LoopbackMesh::BroadcastHandler handler) {
+    mesh_.setBroadcastHandler(nodeId_, std::move(handler));
+  }
+  void onReceiveSingle(LoopbackMesh::SingleHandler handler) {
+    mesh_.setSingleHandler(nodeId_, std::move(handler));
+  }
+
+private:
+  LoopbackMesh &mesh_;
+  uint32_t nodeId_;
+};
@@ -0,0 +1,201 @@
+// Runs the mesh latency benchmark (common/mesh_bench) natively: one master
+// answering pings, the benchmarking slave, and a number of slaves that log
+// navz batches to the master, all on a LoopbackMesh in simulated time. The
+// same code runs on the robots with `bench` on the slave (slave/README.md).
+
+#include "loopback_mesh.h"
+
+#include <mesh_bench.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr uint32_t MASTER_NODE = 1;
+constexpr uint32_t BENCH_NODE = 2;
+constexpr uint32_t FIRST_LOGGER_NODE = 100;
+constexpr uint64_t STEP_US = 1000;
+
+struct Options {
+  mesh_bench::BenchConfig bench;
+  LoopbackMeshConfig mesh;
+  std::vector<uint32_t> loggers{0, 2, 8, 32, 64};
+  // A walking slave sends a navz batch every NAV_LOG_PERIOD_MS (200 ms).
+  uint32_t logHz = 5;
+  uint16_t logLength = 230;
+  uint64_t seed = 1;
+};
+
+void usage(const char *program) {
+  std::fprintf(
+      stderr,
+      "usage: %s [options]\n"
+      "  --seconds S        benchmark length per load level (30)\n"
+      "  --ping-ms MS       ping period, kinds alternate (100)\n"
+      "  --loggers N,N,...  logging slaves per run (0,1,2,4,8)\n"
+      "  --log-hz HZ        messages per logging slave per second (5)\n"
+      "  --log-bytes B      logging message length (230)\n"
+      "  --jitter-us US     mean random extra delay per message (1500)\n"
+      "  --rx-us US         receive handling per message (400)\n"
+      "  --loss P           message loss rate (0)\n"
+      "  --seed N\n",
+      program);
+}
+
+bool parseArgs(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char *value = argv[++i];
+    if (arg == "--seconds") {
+      options.bench.durationMs =
+          static_cast<uint32_t>(std::atof(value) * 1000.0);
+    } else if (arg == "--ping-ms") {
+      options.bench.pingPeriodMs =
+          static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    } else if (arg == "--loggers") {
+      options.loggers.clear();
+      for (const char *p = value; *p != '\0';) {
+        char *end = nullptr;
+        options.loggers.push_back(
+            static_cast<uint32_t>(std::strtoul(p, &end, 10)));
+        p = *end == ',' ? end + 1 : end;
+        if (end == p && *p != '\0') {
+          return false;
+        }
+      }
+    } else if (arg == "--log-hz") {
+      options.logHz = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    } else if (arg == "--log-bytes") {
+      options.logLength =
+          static_cast<uint16_t>(std::strtoul(value, nullptr, 10));
+    } else if (arg == "--jitter-us") {
+      options.mesh.jitterMeanUs = static_cast<float>(std::atof(value));
+    } else if (arg == "--rx-us") {
+      options.mesh.rxBaseUs =
+          static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    } else if (arg == "--loss") {
+      options.mesh.lossRate = static_cast<float>(std::atof(value));
+    } else if (arg == "--seed") {
+      options.seed = std::strtoull(value, nullptr, 10);
+    } else {
+      return false;
+    }
+  }
+  return !options.loggers.empty() && options.bench.pingPeriodMs > 0;
+}
+
+struct Logger {
+  LoopbackCommunication communication;
+  uint64_t nextAtUs;
+  uint32_t seq;
+};
+
+void runLevel(const Options &options, uint32_t loggerCount) {
+  LoopbackMesh mesh(options.mesh, options.seed + loggerCount);
+  LoopbackCommunication master(mesh, MASTER_NODE);
+  LoopbackCommunication slave(mesh, BENCH_NODE);
+  mesh_bench::PingBench bench;
+
+  // What the master firmware does with a ping: answer from the callback.
+  master.onReceive([&](std::string &message) {
+    char pong[mesh_bench::MESSAGE_CAPACITY];
+    if (mesh_bench::answerPing(message.c_str(), mesh.nowUs(), mesh.nowUs(),
+                               pong, sizeof(pong)) > 0) {
+      master.sendMessage(pong);
+    }
+  });
+  uint64_t relayed = 0;
+  master.onReceiveSingle([&](uint32_t, std::string &) { relayed++; });
+
+  // One clock for every node, so the mesh offset is zero.
+  const int64_t meshOffsetUs = 0;
+  slave.onReceive([&](std::string &message) {
+    mesh_bench::Pong pong;
+    if (mesh_bench::parsePong(message.c_str(), pong)) {
+      bench.onPong(pong, mesh.nowUs(), &meshOffsetUs);
+    }
+  });
+
+  // Independent slaves: Poisson arrivals at logHz each. Evenly phased
+  // periodic senders would never collide and hide the queueing.
+  std::mt19937_64 rng(options.seed * 7919U + loggerCount);
+  std::exponential_distribution<double> interval(
+      options.logHz > 0 ? options.logHz / 1e6 : 1.0);
+  std::vector<Logger> loggers;
+  loggers.reserve(loggerCount);
+  for (uint32_t i = 0; i < loggerCount; ++i) {
+    loggers.push_back(Logger{LoopbackCommunication(mesh, FIRST_LOGGER_NODE + i),
+                             static_cast<uint64_t>(interval(rng)), 0});
+  }
+
+  char message[mesh_bench::MESSAGE_CAPACITY];
+  bench.start(options.bench, 0);
+  for (uint64_t now = 0; !bench.finished(now); now += STEP_US) {
+    mesh.runUntil(now);
+    for (mesh_bench::PingBench::Send send =
+             bench.poll(BENCH_NODE, now, message, sizeof(message));
+         send != mesh_bench::PingBench::Send::NONE;
+         send = bench.poll(BENCH_NODE, now, message, sizeof(message))) {
+      if (send == mesh_bench::PingBench::Send::PING) {
+        slave.sendMessage(message);
+      } else {
+        slave.unicast(MASTER_NODE, message);
+      }
+    }
+    for (Logger &logger : loggers) {
+      if (options.logHz == 0 || now < logger.nextAtUs) {
+        continue;
+      }
+      logger.nextAtUs += static_cast<uint64_t>(interval(rng));
+      if (mesh_bench::formatLoad(logger.communication.getNodeId(),
+                                 ++logger.seq, options.logLength, message,
+                                 sizeof(message)) > 0) {
+        logger.communication.unicast(MASTER_NODE, message);
+      }
+    }
+  }
+
+  for (size_t k = 0; k < mesh_bench::KIND_COUNT; ++k) {
+    const mesh_bench::Kind kind = static_cast<mesh_bench::Kind>(k);
+    const mesh_bench::KindStats &stats = bench.stats(kind);
+    std::printf("%7u %-8s %6lu %8.2f %8.2f %8.2f %8.2f %6lu %8.2f %8.2f\n",
+                loggerCount, mesh_bench::kindName(kind),
+                static_cast<unsigned long>(stats.roundTrip.count()),
+                stats.roundTrip.percentile(0.50f) / 1000.0,
+                stats.roundTrip.percentile(0.90f) / 1000.0,
+                stats.roundTrip.percentile(0.99f) / 1000.0,
+                stats.roundTrip.max() / 1000.0,
+                static_cast<unsigned long>(stats.lost),
+                stats.uplink.percentile(0.50f) / 1000.0,
+                stats.downlink.percentile(0.50f) / 1000.0);
+  }
+  std::fflush(stdout);
+  std::fprintf(stderr, "loggers=%u delivered=%llu dropped=%llu relayed=%llu\n",
+               loggerCount, static_cast<unsigned long long>(mesh.delivered()),
+               static_cast<unsigned long long>(mesh.dropped()),
+               static_cast<unsigned long long>(relayed));
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseArgs(argc, argv, options)) {
+    usage(argv[0]);
+    return 2;
+  }
+  std::printf("loggers kind          n  rtt_p50  rtt_p90  rtt_p99  rtt_max   lost"
+              "   up_p50 down_p50   (ms)\n");
+  std::fflush(stdout);
+  for (uint32_t loggers : options.loggers) {
+    runLevel(options, loggers);
+  }
+  return 0;
+}
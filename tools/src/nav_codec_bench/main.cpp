@@ -0,0 +1,289 @@
+// Compression ratio and per-frame cost of the navz telemetry codec, measured
+// on recorded ir_meter CSVs (evaluation/data). Every file is also checked
+// for a lossless round trip at the codec's quantization, and a synthetic
+// worst-case frame against NAV_FRAME_MAX_BYTES.
+
+#include <base64.h>
+#include <nav_frame.h>
+#include <nav_line.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr uint16_t KEYFRAME_INTERVALS[] = {1, 10, 50, 250};
+constexpr uint16_t LINE_KEYFRAME_INTERVAL = 50;
+constexpr int TIMING_REPEATS = 25;
+
+struct Recording {
+  std::string path;
+  std::vector<NavFrame> frames;
+  size_t asciiBytes = 0; // CSV rows including the newline
+};
+
+bool parseRow(const std::string &line, NavFrame &frame) {
+  double v[15];
+  std::stringstream row(line);
+  std::string cell;
+  for (double &value : v) {
+    if (!std::getline(row, cell, ',') || cell.empty()) {
+      return false;
+    }
+    char *end = nullptr;
+    value = std::strtod(cell.c_str(), &end);
+    if (end == cell.c_str()) {
+      return false;
+    }
+  }
+  frame.tMs = static_cast<uint32_t>(v[0]);
+  for (int i = 0; i < 4; ++i) {
+    frame.raw[i] = static_cast<uint16_t>(v[1 + i]);
+    frame.amplitudeDeci[i] = static_cast<uint16_t>(std::lround(v[5 + i] * 10));
+  }
+  frame.thetaCentiDeg = static_cast<int16_t>(std::lround(v[12] * 100));
+  frame.signalDeci = static_cast<uint32_t>(std::lround(v[13] * 10));
+  frame.flags = v[14] != 0 ? NavFrame::FLAG_DETECTED : 0;
+  return true;
+}
+
+bool loadRecording(const char *path, Recording &recording) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  recording.path = path;
+  std::string line;
+  std::getline(file, line); // header
+  while (std::getline(file, line)) {
+    NavFrame frame;
+    if (parseRow(line, frame)) {
+      recording.frames.push_back(frame);
+      recording.asciiBytes += line.size() + 1;
+    }
+  }
+  return !recording.frames.empty();
+}
+
+bool sameFrame(const NavFrame &a, const NavFrame &b) {
+  return a.tMs == b.tMs && std::memcmp(a.raw, b.raw, sizeof(a.raw)) == 0 &&
+         std::memcmp(a.amplitudeDeci, b.amplitudeDeci,
+                     sizeof(a.amplitudeDeci)) == 0 &&
+         a.thetaCentiDeg == b.thetaCentiDeg && a.signalDeci == b.signalDeci &&
+         a.dutyLeft == b.dutyLeft && a.dutyRight == b.dutyRight &&
+         a.flags == b.flags;
+}
+
+std::vector<uint8_t> encodeAll(const std::vector<NavFrame> &frames,
+                               uint16_t keyframeInterval) {
+  std::vector<uint8_t> out(frames.size() * NAV_FRAME_MAX_BYTES);
+  NavStreamEncoder encoder(keyframeInterval);
+  size_t used = 0;
+  for (const NavFrame &frame : frames) {
+    used += encoder.encode(frame, out.data() + used, out.size() - used);
+  }
+  out.resize(used);
+  return out;
+}
+
+bool roundTrips(const std::vector<NavFrame> &frames,
+                const std::vector<uint8_t> &stream) {
+  NavStreamDecoder decoder;
+  size_t offset = 0;
+  for (const NavFrame &expected : frames) {
+    NavFrame decoded;
+    size_t used = 0;
+    if (decoder.decode(stream.data() + offset, stream.size() - offset, decoded,
+                       used) != NavDecodeStatus::FRAME ||
+        !sameFrame(decoded, expected)) {
+      return false;
+    }
+    offset += used;
+  }
+  return offset == stream.size();
+}
+
+// Encodes frames that alternate between opposite extremes, so every field
+// changes by the largest delta its width allows, and checks each record
+// against NAV_FRAME_MAX_BYTES and for a lossless round trip.
+bool worstCaseFits(size_t &largest) {
+  NavFrame low;
+  low.thetaCentiDeg = INT16_MIN;
+  NavFrame high;
+  high.tMs = 0x80000000U;
+  for (int i = 0; i < 4; ++i) {
+    high.raw[i] = UINT16_MAX;
+    high.amplitudeDeci[i] = UINT16_MAX;
+  }
+  high.thetaCentiDeg = INT16_MAX;
+  high.signalDeci = 0x80000000U;
+  high.dutyLeft = UINT16_MAX;
+  high.dutyRight = UINT16_MAX;
+  high.flags = UINT8_MAX;
+
+  // Keyframes of both extremes, then delta frames between them.
+  const std::vector<NavFrame> frames = {high, low, high, low, high};
+  std::vector<uint8_t> stream(frames.size() * NAV_FRAME_MAX_BYTES);
+  NavStreamEncoder encoder(LINE_KEYFRAME_INTERVAL);
+  size_t used = 0;
+  largest = 0;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    if (i < 2) {
+      encoder.reset();
+    }
+    const size_t length = encoder.encode(frames[i], stream.data() + used,
+                                         NAV_FRAME_MAX_BYTES);
+    if (length == 0) {
+      return false;
+    }
+    largest = std::max(largest, length);
+    used += length;
+  }
+  stream.resize(used);
+  return roundTrips(frames, stream);
+}
+
+// Median over repeats of the per-frame time, in nanoseconds.
+template <typename Fn> double medianNsPerFrame(size_t frames, Fn fn) {
+  std::vector<double> samples;
+  for (int r = 0; r < TIMING_REPEATS; ++r) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const auto stop = std::chrono::steady_clock::now();
+    samples.push_back(
+        std::chrono::duration<double, std::nano>(stop - start).count() /
+        static_cast<double>(frames));
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+size_t navzLineBytes(const std::vector<NavFrame> &frames) {
+  NavLineWriter writer(LINE_KEYFRAME_INTERVAL);
+  size_t bytes = 0;
+  for (const NavFrame &frame : frames) {
+    if (!writer.add(frame)) {
+      bytes += std::strlen(writer.flush()) + 1;
+      writer.add(frame);
+    }
+    // The firmware flushes every 200 ms, i.e. every 10 frames at 50 Hz.
+    if (writer.full() || writer.frameCount() == 10) {
+      bytes += std::strlen(writer.flush()) + 1;
+    }
+  }
+  if (!writer.empty()) {
+    bytes += std::strlen(writer.flush()) + 1;
+  }
+  return bytes;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: %s RECORDING.csv...\n", argv[0]);
+    return 2;
+  }
+
+  size_t worstCase = 0;
+  if (!worstCaseFits(worstCase)) {
+    std::fprintf(stderr, "worst-case frame exceeds NAV_FRAME_MAX_BYTES (%zu)\n",
+                 NAV_FRAME_MAX_BYTES);
+    return 1;
+  }
+  std::printf("worst-case frame: %zu of %zu bytes\n\n", worstCase,
+              NAV_FRAME_MAX_BYTES);
+
+  std::printf("%-28s %7s %8s", "file", "frames", "csv_B/f");
+  for (uint16_t interval : KEYFRAME_INTERVALS) {
+    std::printf("   k=%-3u B/f ratio", interval);
+  }
+  std::printf(" %9s %7s %7s %s\n", "navz_B/f", "enc_ns", "dec_ns", "lossless");
+
+  size_t totalFrames = 0;
+  size_t totalAscii = 0;
+  size_t totalBinary = 0;
+  size_t totalLine = 0;
+  bool allLossless = true;
+  for (int i = 1; i < argc; ++i) {
+    Recording recording;
+    if (!loadRecording(argv[i], recording)) {
+      std::fprintf(stderr, "skipping %s: no rows\n", argv[i]);
+      continue;
+    }
+    const std::vector<NavFrame> &frames = recording.frames;
+    const double asciiPerFrame =
+        static_cast<double>(recording.asciiBytes) / frames.size();
+
+    std::string name = recording.path;
+    const size_t slash = name.find_last_of('/');
+    if (slash != std::string::npos) {
+      name = name.substr(slash + 1);
+    }
+    std::printf("%-28s %7zu %8.1f", name.c_str(), frames.size(),
+                asciiPerFrame);
+
+    bool lossless = true;
+    for (uint16_t interval : KEYFRAME_INTERVALS) {
+      const std::vector<uint8_t> stream = encodeAll(frames, interval);
+      lossless = lossless && roundTrips(frames, stream);
+      const double perFrame = static_cast<double>(stream.size()) / frames.size();
+      std::printf("   %9.2f %5.1fx", perFrame, asciiPerFrame / perFrame);
+      if (interval == LINE_KEYFRAME_INTERVAL) {
+        totalBinary += stream.size();
+      }
+    }
+
+    const size_t lineBytes = navzLineBytes(frames);
+    std::vector<uint8_t> buffer(frames.size() * NAV_FRAME_MAX_BYTES);
+    const double encodeNs = medianNsPerFrame(frames.size(), [&] {
+      NavStreamEncoder encoder(LINE_KEYFRAME_INTERVAL);
+      size_t used = 0;
+      for (const NavFrame &frame : frames) {
+        used += encoder.encode(frame, buffer.data() + used,
+                               buffer.size() - used);
+      }
+    });
+    const std::vector<uint8_t> stream = encodeAll(frames, LINE_KEYFRAME_INTERVAL);
+    volatile uint32_t sink = 0;
+    const double decodeNs = medianNsPerFrame(frames.size(), [&] {
+      NavStreamDecoder decoder;
+      size_t offset = 0;
+      NavFrame frame;
+      while (offset < stream.size()) {
+        size_t used = 0;
+        decoder.decode(stream.data() + offset, stream.size() - offset, frame,
+                       used);
+        offset += used;
+      }
+      sink = sink + frame.tMs;
+    });
+
+    std::printf(" %9.2f %7.0f %7.0f %s\n",
+                static_cast<double>(lineBytes) / frames.size(), encodeNs,
+                decodeNs, lossless ? "yes" : "NO");
+    totalFrames += frames.size();
+    totalAscii += recording.asciiBytes;
+    totalLine += lineBytes;
+    allLossless = allLossless && lossless;
+  }
+
+  if (totalFrames == 0) {
+    return 1;
+  }
+  std::printf("\ntotal: %zu frames, csv %.1f B/f, binary (k=%u) %.2f B/f "
+              "(%.1fx), navz lines %.2f B/f (%.1fx)\n",
+              totalFrames, static_cast<double>(totalAscii) / totalFrames,
+              LINE_KEYFRAME_INTERVAL,
+              static_cast<double>(totalBinary) / totalFrames,
+              static_cast<double>(totalAscii) / totalBinary,
+              static_cast<double>(totalLine) / totalFrames,
+              static_cast<double>(totalAscii) / totalLine);
+  return allLossless ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Decodes `navz,<base64>` telemetry lines (ir_meter USB output, or slave
+// uplink as relayed by the master: `wireless_log,<from>,navz,...`) back to
+// CSV with the evaluation/data columns.
+
+#include <base64.h>
+#include <nav_frame.h>
+#include <nav_line.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+namespace {
+constexpr float CENTI_DEG_TO_RAD = 1.0f / 5729.577951308232f;
+
+struct Source {
+  NavStreamDecoder decoder;
+  size_t frames = 0;
+};
+
+void writeFrame(std::FILE *out, const std::string &node, const NavFrame &f) {
+  const int vx = static_cast<int>(f.amplitudeDeci[0]) - f.amplitudeDeci[1];
+  const int vy = static_cast<int>(f.amplitudeDeci[2]) - f.amplitudeDeci[3];
+  std::fprintf(out,
+               "%lu,%u,%u,%u,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.4f,%.2f,%.1f,"
+               "%u,%s,%u,%u,%s\n",
+               static_cast<unsigned long>(f.tMs), f.raw[0], f.raw[1], f.raw[2],
+               f.raw[3], f.amplitudeDeci[0] / 10.0, f.amplitudeDeci[1] / 10.0,
+               f.amplitudeDeci[2] / 10.0, f.amplitudeDeci[3] / 10.0, vx / 10.0,
+               vy / 10.0, f.thetaCentiDeg * CENTI_DEG_TO_RAD,
+               f.thetaCentiDeg / 100.0, f.signalDeci / 10.0,
+               (f.flags & NavFrame::FLAG_DETECTED) != 0 ? 1U : 0U,
+               (f.flags & NavFrame::FLAG_SEARCH) != 0 ? "search" : "track",
+               f.dutyLeft, f.dutyRight, node.c_str());
+}
+
+// Returns the node id for relayed lines, "local" otherwise.
+std::string sourceOf(const std::string &line, size_t navzAt) {
+  const std::string relay = "wireless_log,";
+  if (line.compare(0, relay.size(), relay) != 0) {
+    return "local";
+  }
+  const size_t comma = line.find(',', relay.size());
+  if (comma == std::string::npos || comma >= navzAt) {
+    return "local";
+  }
+  return line.substr(relay.size(), comma - relay.size());
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 3) {
+    std::fprintf(stderr, "usage: %s [CAPTURE.txt] [OUT.csv]\n", argv[0]);
+    return 2;
+  }
+
+  std::ifstream file;
+  std::istream *input = &std::cin;
+  if (argc >= 2 && std::strcmp(argv[1], "-") != 0) {
+    file.open(argv[1]);
+    if (!file) {
+      std::fprintf(stderr, "cannot open %s\n", argv[1]);
+      return 1;
+    }
+    input = &file;
+  }
+
+  std::FILE *out = stdout;
+  if (argc == 3) {
+    out = std::fopen(argv[2], "w");
+    if (out == nullptr) {
+      std::fprintf(stderr, "cannot write %s\n", argv[2]);
+      return 1;
+    }
+  }
+  std::fprintf(out, "t_ms,raw_f,raw_b,raw_l,raw_r,A_F,A_B,A_L,A_R,vx,vy,"
+                    "theta_rad,theta_deg,S,detected,mode,duty_l,duty_r,node\n");
+
+  std::map<std::string, Source> sources;
+  std::string line;
+  size_t malformed = 0;
+  uint8_t payload[NavLineWriter::PAYLOAD_CAPACITY];
+  while (std::getline(*input, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    const size_t at = line.find(NavLineWriter::PREFIX);
+    if (at == std::string::npos) {
+      continue;
+    }
+
+    Source &source = sources[sourceOf(line, at)];
+    const size_t start = at + NavLineWriter::PREFIX_LENGTH;
+    const size_t length = base64::decode(line.c_str() + start,
+                                         line.size() - start, payload,
+                                         sizeof(payload));
+    if (length == 0) {
+      malformed++;
+      continue;
+    }
+
+    size_t offset = 0;
+    while (offset < length) {
+      NavFrame frame;
+      size_t used = 0;
+      const NavDecodeStatus status = source.decoder.decode(
+          payload + offset, length - offset, frame, used);
+      if (status == NavDecodeStatus::MALFORMED) {
+        malformed++;
+        break;
+      }
+      offset += used;
+      if (status == NavDecodeStatus::FRAME) {
+        writeFrame(out, sourceOf(line, at), frame);
+        source.frames++;
+      }
+    }
+  }
+
+  if (out != stdout) {
+    std::fclose(out);
+  }
+  for (const auto &entry : sources) {
+    std::fprintf(stderr, "%s: frames=%zu lost=%lu skipped=%lu\n",
+                 entry.first.c_str(), entry.second.frames,
+                 static_cast<unsigned long>(entry.second.decoder.lostFrames()),
+                 static_cast<unsigned long>(
+                     entry.second.decoder.skippedFrames()));
+  }
+  if (malformed > 0) {
+    std::fprintf(stderr, "malformed lines: %zu\n", malformed);
+  }
+  return 0;
+}
@@ -0,0 +1,555 @@
+// Compares routing mesh messages as text with the typed frames of
+// common/mesh_proto:
+// - text: an if-chain of string compares over the charge-protocol commands
+//   and `log:` lines, the way the Master/Slave receive handlers route them,
+//   followed by the strtoul field parsers the clock and beacon messages
+//   used before they moved to frames,
+// - armored: TEXT_MARK + base64 frames through Dispatcher::dispatchText(),
+//   which is what travels over painlessMesh,
+// - raw: the same frames through Dispatcher::dispatch(), for a link that
+//   carries bytes.
+// Every encoded message is decoded again and compared field by field first.
+
+#include <mesh_messages.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr int TIMING_REPEATS = 15;
+constexpr size_t MESSAGES_PER_RUN = 20000;
+constexpr size_t LOG_LINE_LENGTH = 120;
+
+using mesh_proto::Type;
+
+// Tags 1..TEXT_TYPES-1 replaced a text message; later types never had a
+// text form to compare with.
+constexpr size_t TEXT_TYPES = static_cast<size_t>(Type::BEACON_DUTY) + 1;
+
+// The text forms the clock and beacon messages had, and their parsers.
+namespace legacy {
+bool startsWith(const char *text, const char *prefix, const char *&rest) {
+  const size_t length = strlen(prefix);
+  if (strncmp(text, prefix, length) != 0) {
+    return false;
+  }
+  rest = text + length;
+  return true;
+}
+
+bool readField(const char *&text, char separator, uint64_t max,
+               uint64_t &value) {
+  char *end = nullptr;
+  const unsigned long long parsed = strtoull(text, &end, 10);
+  if (end == text || *text == '-' || *end != separator || parsed > max) {
+    return false;
+  }
+  value = static_cast<uint64_t>(parsed);
+  text = *end == '\0' ? end : end + 1;
+  return true;
+}
+
+std::string formatClockRequest(const clock_sync::ClockRequest &request) {
+  char out[96];
+  snprintf(out, sizeof(out), "clk_req:%lu,%lu,%llu",
+           static_cast<unsigned long>(request.node),
+           static_cast<unsigned long>(request.seq),
+           static_cast<unsigned long long>(request.sentUs));
+  return out;
+}
+
+std::string formatClockResponse(const clock_sync::ClockResponse &response) {
+  char out[96];
+  snprintf(out, sizeof(out), "clk_rsp:%lu,%lu,%llu,%llu,%llu",
+           static_cast<unsigned long>(response.node),
+           static_cast<unsigned long>(response.seq),
+           static_cast<unsigned long long>(response.requestSentUs),
+           static_cast<unsigned long long>(response.receivedUs),
+           static_cast<unsigned long long>(response.sentUs));
+  return out;
+}
+
+std::string formatBeaconReport(const beacon_power::BeaconReport &report) {
+  char out[64];
+  snprintf(out, sizeof(out), "beacon_rx:%lu,%u,%lu,%u,%u",
+           static_cast<unsigned long>(report.node),
+           static_cast<unsigned>(report.duty),
+           static_cast<unsigned long>(report.signal),
+           static_cast<unsigned>(report.saturated),
+           static_cast<unsigned>(report.ticks));
+  return out;
+}
+
+bool parseClockRequest(const char *text, clock_sync::ClockRequest &request) {
+  uint64_t node = 0;
+  uint64_t seq = 0;
+  if (!readField(text, ',', UINT32_MAX, node) ||
+      !readField(text, ',', UINT32_MAX, seq) ||
+      !readField(text, '\0', UINT64_MAX, request.sentUs)) {
+    return false;
+  }
+  request.node = static_cast<uint32_t>(node);
+  request.seq = static_cast<uint32_t>(seq);
+  return true;
+}
+
+bool parseClockResponse(const char *text,
+                        clock_sync::ClockResponse &response) {
+  uint64_t node = 0;
+  uint64_t seq = 0;
+  if (!readField(text, ',', UINT32_MAX, node) ||
+      !readField(text, ',', UINT32_MAX, seq) ||
+      !readField(text, ',', UINT64_MAX, response.requestSentUs) ||
+      !readField(text, ',', UINT64_MAX, response.receivedUs) ||
+      !readField(text, '\0', UINT64_MAX, response.sentUs)) {
+    return false;
+  }
+  response.node = static_cast<uint32_t>(node);
+  response.seq = static_cast<uint32_t>(seq);
+  return true;
+}
+
+bool parseBeaconReport(const char *text, beacon_power::BeaconReport &report) {
+  uint64_t fields[5];
+  const uint64_t max[5] = {UINT32_MAX, beacon_power::DUTY_MAX, UINT32_MAX,
+                           UINT16_MAX, UINT16_MAX};
+  for (int i = 0; i < 5; ++i) {
+    if (!readField(text, i < 4 ? ',' : '\0', max[i], fields[i])) {
+      return false;
+    }
+  }
+  report.node = static_cast<uint32_t>(fields[0]);
+  report.duty = static_cast<uint16_t>(fields[1]);
+  report.signal = static_cast<uint32_t>(fields[2]);
+  report.saturated = static_cast<uint16_t>(fields[3]);
+  report.ticks = static_cast<uint16_t>(fields[4]);
+  return report.saturated <= report.ticks;
+}
+} // namespace legacy
+
+// Text name of each payload-less command, as sent on the text channel.
+const char *commandText(Type type) { return mesh_proto::typeName(type); }
+
+// What the handlers saw, so that no path can skip its work.
+struct Tally {
+  uint64_t sum = 0;
+  uint32_t handled = 0;
+};
+
+void count(Tally &tally, uint64_t value) {
+  tally.sum += value;
+  tally.handled++;
+}
+
+// The string path: commands compared one after the other, then the parsed
+// messages by prefix.
+void routeText(const std::string &message, Tally &tally) {
+  static const Type COMMANDS[] = {
+      Type::REQUEST_CHARGE,        Type::STOP_CHARGE,
+      Type::NOTIFY_WORK,           Type::NOTIFY_WALK_TO_CHARGE,
+      Type::NOTIFY_IN_WAIT,        Type::NOTIFY_WALK_INTO_CHARGE,
+      Type::NOTIFY_IN_CHARGE,      Type::NOTIFY_EXIT_CHARGE,
+      Type::ENJOIN_CHARGE,         Type::CANCEL_CHARGE};
+  for (Type command : COMMANDS) {
+    if (message == commandText(command)) {
+      count(tally, static_cast<uint64_t>(command));
+      return;
+    }
+  }
+  const char *text = nullptr;
+  if (legacy::startsWith(message.c_str(), "log:", text)) {
+    count(tally, strlen(text));
+    return;
+  }
+  clock_sync::ClockRequest request;
+  if (legacy::startsWith(message.c_str(), "clk_req:", text) &&
+      legacy::parseClockRequest(text, request)) {
+    count(tally, request.sentUs);
+    return;
+  }
+  clock_sync::ClockResponse response;
+  if (legacy::startsWith(message.c_str(), "clk_rsp:", text) &&
+      legacy::parseClockResponse(text, response)) {
+    count(tally, response.sentUs);
+    return;
+  }
+  beacon_power::BeaconReport report;
+  if (legacy::startsWith(message.c_str(), "beacon_rx:", text) &&
+      legacy::parseBeaconReport(text, report)) {
+    count(tally, report.signal);
+    return;
+  }
+  uint64_t duty = 0;
+  if (legacy::startsWith(message.c_str(), "beacon_duty:", text) &&
+      legacy::readField(text, '\0', beacon_power::DUTY_MAX, duty)) {
+    count(tally, duty);
+  }
+}
+
+void onCommand(void *context, const mesh_proto::Envelope &envelope,
+               mesh_proto::Reader &payload) {
+  (void)envelope;
+  (void)payload;
+  count(*static_cast<Tally *>(context), 1);
+}
+
+void onLog(void *context, const mesh_proto::Envelope &envelope,
+           mesh_proto::Reader &payload) {
+  (void)envelope;
+  count(*static_cast<Tally *>(context), payload.remaining());
+}
+
+void onClockRequest(void *context, const mesh_proto::Envelope &envelope,
+                    mesh_proto::Reader &payload) {
+  (void)envelope;
+  clock_sync::ClockRequest request;
+  if (mesh_proto::readClockRequest(payload, request)) {
+    count(*static_cast<Tally *>(context), request.sentUs);
+  }
+}
+
+void onClockResponse(void *context, const mesh_proto::Envelope &envelope,
+                     mesh_proto::Reader &payload) {
+  (void)envelope;
+  clock_sync::ClockResponse response;
+  if (mesh_proto::readClockResponse(payload, response)) {
+    count(*static_cast<Tally *>(context), response.sentUs);
+  }
+}
+
+void onBeaconReport(void *context, const mesh_proto::Envelope &envelope,
+                    mesh_proto::Reader &payload) {
+  (void)envelope;
+  beacon_power::BeaconReport report;
+  if (mesh_proto::readBeaconReport(payload, report)) {
+    count(*static_cast<Tally *>(context), report.signal);
+  }
+}
+
+void onBeaconDuty(void *context, const mesh_proto::Envelope &envelope,
+                  mesh_proto::Reader &payload) {
+  (void)envelope;
+  uint16_t duty = 0;
+  if (mesh_proto::readBeaconDuty(payload, duty)) {
+    count(*static_cast<Tally *>(context), duty);
+  }
+}
+
+mesh_proto::Dispatcher makeDispatcher(Tally &tally) {
+  mesh_proto::Dispatcher dispatcher;
+  for (size_t tag = 1; tag < mesh_proto::TYPE_COUNT; ++tag) {
+    dispatcher.on(static_cast<Type>(tag), onCommand, &tally);
+  }
+  dispatcher.on(Type::LOG, onLog, &tally);
+  dispatcher.on(Type::CLOCK_REQUEST, onClockRequest, &tally);
+  dispatcher.on(Type::CLOCK_RESPONSE, onClockResponse, &tally);
+  dispatcher.on(Type::BEACON_REPORT, onBeaconReport, &tally);
+  dispatcher.on(Type::BEACON_DUTY, onBeaconDuty, &tally);
+  return dispatcher;
+}
+
+// One message in its three forms.
+struct Message {
+  Type type;
+  std::string text;
+  std::string armored;
+  std::vector<uint8_t> frame;
+};
+
+std::vector<uint8_t> unarmored(const std::string &armored) {
+  std::vector<uint8_t> frame(mesh_proto::MAX_FRAME);
+  frame.resize(mesh_proto::unarmor(armored.data(), armored.size(),
+                                   frame.data(), frame.size()));
+  return frame;
+}
+
+std::string armoredLog(const std::string &line) {
+  uint8_t frame[mesh_proto::MAX_FRAME];
+  mesh_proto::Writer writer(Type::LOG, frame, sizeof(frame));
+  writer.bytes(line.data(), line.size());
+  char out[mesh_proto::TEXT_CAPACITY];
+  return std::string(out, mesh_proto::armor(frame, writer.length(), out,
+                                            sizeof(out)));
+}
+
+class MessageMaker {
+public:
+  explicit MessageMaker(uint32_t seed) : rng_(seed) {}
+
+  Message make(Type type) {
+    Message message;
+    message.type = type;
+    char out[mesh_proto::TEXT_CAPACITY];
+    size_t length = 0;
+    switch (type) {
+    case Type::LOG: {
+      std::string line = "navz,";
+      while (line.size() < LOG_LINE_LENGTH) {
+        line += static_cast<char>('A' + rng_() % 26);
+      }
+      message.text = "log:" + line;
+      message.armored = armoredLog(line);
+      break;
+    }
+    case Type::CLOCK_REQUEST: {
+      const clock_sync::ClockRequest request = clockRequest();
+      message.text = legacy::formatClockRequest(request);
+      length = mesh_proto::encodeClockRequest(request, out, sizeof(out));
+      break;
+    }
+    case Type::CLOCK_RESPONSE: {
+      clock_sync::ClockResponse response;
+      const clock_sync::ClockRequest request = clockRequest();
+      response.node = request.node;
+      response.seq = request.seq;
+      response.requestSentUs = request.sentUs;
+      response.receivedUs = request.sentUs + 1234567890ULL + rng_() % 5000;
+      response.sentUs = response.receivedUs + 40 + rng_() % 200;
+      message.text = legacy::formatClockResponse(response);
+      length = mesh_proto::encodeClockResponse(
+          request, response.receivedUs, response.sentUs, out, sizeof(out));
+      break;
+    }
+    case Type::BEACON_REPORT: {
+      beacon_power::BeaconReport report;
+      report.node = node();
+      report.duty = static_cast<uint16_t>(32 + rng_() % 992);
+      report.signal = rng_() % 60000;
+      report.ticks = static_cast<uint16_t>(5 + rng_() % 10);
+      report.saturated = static_cast<uint16_t>(rng_() % (report.ticks + 1));
+      message.text = legacy::formatBeaconReport(report);
+      length = mesh_proto::encodeBeaconReport(report, out, sizeof(out));
+      break;
+    }
+    case Type::BEACON_DUTY: {
+      const uint16_t duty = static_cast<uint16_t>(32 + rng_() % 992);
+      message.text = "beacon_duty:" + std::to_string(duty);
+      length = mesh_proto::encodeBeaconDuty(duty, out, sizeof(out));
+      break;
+    }
+    default:
+      message.text = commandText(type);
+      length = mesh_proto::encodeSignal(type, out, sizeof(out));
+      break;
+    }
+    if (message.armored.empty()) {
+      message.armored.assign(out, length);
+    }
+    message.frame = unarmored(message.armored);
+    return message;
+  }
+
+private:
+  uint32_t node() { return 100000000U + rng_() % 4000000000U; }
+
+  clock_sync::ClockRequest clockRequest() {
+    clock_sync::ClockRequest request;
+    request.node = node();
+    request.seq = rng_() % 100000;
+    request.sentUs = 1000000ULL + (static_cast<uint64_t>(rng_()) << 8);
+    return request;
+  }
+
+  std::mt19937 rng_;
+};
+
+// Encodes and decodes random messages of every type and compares them with
+// what the text parsers read from the text form.
+bool checkRoundTrip() {
+  MessageMaker maker(1);
+  std::mt19937 rng(2);
+  for (int i = 0; i < 20000; ++i) {
+    const Type type = static_cast<Type>(1 + i % (TEXT_TYPES - 1));
+    const Message message = maker.make(type);
+    if (message.frame.size() < mesh_proto::HEADER_SIZE ||
+        message.frame[1] != static_cast<uint8_t>(type)) {
+      return false;
+    }
+    mesh_proto::Reader payload(message.frame.data() + mesh_proto::HEADER_SIZE,
+                               message.frame.size() -
+                                   mesh_proto::HEADER_SIZE);
+    const char *text = message.text.c_str() + message.text.find(':') + 1;
+    bool ok = true;
+    switch (type) {
+    case Type::LOG:
+      ok = payload.remaining() + 4 == message.text.size() &&
+           memcmp(payload.data(), text, payload.remaining()) == 0;
+      break;
+    case Type::CLOCK_REQUEST: {
+      clock_sync::ClockRequest a;
+      clock_sync::ClockRequest b;
+      ok = mesh_proto::readClockRequest(payload, a) &&
+           legacy::parseClockRequest(text, b) && a.node == b.node &&
+           a.seq == b.seq && a.sentUs == b.sentUs;
+      break;
+    }
+    case Type::CLOCK_RESPONSE: {
+      clock_sync::ClockResponse a;
+      clock_sync::ClockResponse b;
+      ok = mesh_proto::readClockResponse(payload, a) &&
+           legacy::parseClockResponse(text, b) && a.node == b.node &&
+           a.seq == b.seq && a.requestSentUs == b.requestSentUs &&
+           a.receivedUs == b.receivedUs && a.sentUs == b.sentUs;
+      break;
+    }
+    case Type::BEACON_REPORT: {
+      beacon_power::BeaconReport a;
+      beacon_power::BeaconReport b;
+      ok = mesh_proto::readBeaconReport(payload, a) &&
+           legacy::parseBeaconReport(text, b) && a.node == b.node &&
+           a.duty == b.duty && a.signal == b.signal &&
+           a.saturated == b.saturated && a.ticks == b.ticks;
+      break;
+    }
+    case Type::BEACON_DUTY: {
+      uint16_t duty = 0;
+      ok = mesh_proto::readBeaconDuty(payload, duty) &&
+           std::to_string(duty) == text;
+      break;
+    }
+    default:
+      ok = payload.remaining() == 0;
+      break;
+    }
+    if (!ok) {
+      return false;
+    }
+  }
+
+  // Damaged frames are refused before any handler runs.
+  Tally tally;
+  const mesh_proto::Dispatcher dispatcher = makeDispatcher(tally);
+  const mesh_proto::Envelope envelope;
+  std::vector<uint8_t> frame = maker.make(Type::BEACON_REPORT).frame;
+  frame.pop_back();
+  if (dispatcher.dispatch(envelope, frame.data(), frame.size()) !=
+      mesh_proto::DispatchStatus::BAD_LENGTH) {
+    return false;
+  }
+  frame = maker.make(Type::CLOCK_REQUEST).frame;
+  frame[0] = mesh_proto::VERSION + 1;
+  if (dispatcher.dispatch(envelope, frame.data(), frame.size()) !=
+      mesh_proto::DispatchStatus::BAD_VERSION) {
+    return false;
+  }
+  frame[0] = mesh_proto::VERSION;
+  frame[1] = static_cast<uint8_t>(mesh_proto::TYPE_COUNT);
+  if (dispatcher.dispatch(envelope, frame.data(), frame.size()) !=
+      mesh_proto::DispatchStatus::UNKNOWN_TYPE) {
+    return false;
+  }
+  const char *text = "log:hello";
+  return dispatcher.dispatchText(envelope, text, strlen(text)) ==
+             mesh_proto::DispatchStatus::NOT_A_FRAME &&
+         tally.handled == 0;
+}
+
+enum class Path { TEXT, ARMORED, RAW };
+
+// Median ns per message over the run.
+double nsPerMessage(const std::vector<Message> &messages, Path path) {
+  Tally tally;
+  const mesh_proto::Dispatcher dispatcher = makeDispatcher(tally);
+  mesh_proto::Envelope envelope;
+  std::vector<double> runs;
+  for (int repeat = 0; repeat < TIMING_REPEATS; ++repeat) {
+    const auto start = std::chrono::steady_clock::now();
+    for (const Message &message : messages) {
+      envelope.receivedUs++;
+      switch (path) {
+      case Path::TEXT:
+        routeText(message.text, tally);
+        break;
+      case Path::ARMORED:
+        dispatcher.dispatchText(envelope, message.armored.data(),
+                                message.armored.size());
+        break;
+      case Path::RAW:
+        dispatcher.dispatch(envelope, message.frame.data(),
+                            message.frame.size());
+        break;
+      }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    runs.push_back(std::chrono::duration<double, std::nano>(elapsed).count() /
+                   static_cast<double>(messages.size()));
+  }
+  volatile uint64_t keep = tally.sum + tally.handled;
+  (void)keep;
+  if (tally.handled != messages.size() * TIMING_REPEATS) {
+    std::fprintf(stderr, "proto_bench: %u of %zu messages handled\n",
+                 tally.handled, messages.size() * TIMING_REPEATS);
+  }
+  std::sort(runs.begin(), runs.end());
+  return runs[runs.size() / 2];
+}
+
+double meanLength(const std::vector<Message> &messages, Path path) {
+  double total = 0.0;
+  for (const Message &message : messages) {
+    total += static_cast<double>(path == Path::TEXT      ? message.text.size()
+                                 : path == Path::ARMORED ? message.armored.size()
+                                                         : message.frame.size());
+  }
+  return total / static_cast<double>(messages.size());
+}
+
+void printRow(const char *name, const std::vector<Message> &messages) {
+  std::printf("%-24s %5.0f %5.0f %5.0f %9.1f %9.1f %9.1f\n", name,
+              meanLength(messages, Path::TEXT),
+              meanLength(messages, Path::ARMORED),
+              meanLength(messages, Path::RAW),
+              nsPerMessage(messages, Path::TEXT),
+              nsPerMessage(messages, Path::ARMORED),
+              nsPerMessage(messages, Path::RAW));
+}
+} // namespace
+
+int main() {
+  const bool roundTrip = checkRoundTrip();
+  std::printf("round trip and damaged frames: %s\n",
+              roundTrip ? "ok" : "FAILED");
+
+  std::printf("\nbytes and ns per message (%zu messages, median of %d runs)\n",
+              MESSAGES_PER_RUN, TIMING_REPEATS);
+  std::printf("%-24s %5s %5s %5s %9s %9s %9s\n", "type", "text", "armor",
+              "raw", "text_ns", "armor_ns", "raw_ns");
+  MessageMaker maker(3);
+  for (size_t tag = 1; tag < TEXT_TYPES; ++tag) {
+    std::vector<Message> messages;
+    messages.reserve(MESSAGES_PER_RUN);
+    for (size_t i = 0; i < MESSAGES_PER_RUN; ++i) {
+      messages.push_back(maker.make(static_cast<Type>(tag)));
+    }
+    printRow(mesh_proto::typeName(static_cast<Type>(tag)), messages);
+  }
+
+  // What a master hears while one slave walks to the charger: beacon
+  // reports at 5 Hz, navz log lines, clock requests and the odd command.
+  struct Share {
+    Type type;
+    uint32_t weight;
+  };
+  const Share MIX[] = {{Type::BEACON_REPORT, 10}, {Type::LOG, 10},
+                       {Type::CLOCK_REQUEST, 1},  {Type::NOTIFY_IN_WAIT, 1},
+                       {Type::REQUEST_CHARGE, 1}, {Type::CANCEL_CHARGE, 1}};
+  std::vector<Type> pool;
+  for (const Share &share : MIX) {
+    pool.insert(pool.end(), share.weight, share.type);
+  }
+  std::mt19937 rng(4);
+  std::vector<Message> mix;
+  mix.reserve(MESSAGES_PER_RUN);
+  for (size_t i = 0; i < MESSAGES_PER_RUN; ++i) {
+    mix.push_back(maker.make(pool[rng() % pool.size()]));
+  }
+  printRow("walking mix", mix);
+  return roundTrip ? 0 : 1;
+}
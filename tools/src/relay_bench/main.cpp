@@ -0,0 +1,544 @@
+// Measures the master's telemetry relay under load from walking slaves, on
+// a LoopbackMesh in simulated time, with the master's serial port modeled
+// as a 115200 baud UART behind a small driver buffer:
+// - relay: what the master did before, a `wireless_log,<from>,navz,...`
+//   line for every batch, written from the mesh callback. A full port
+//   blocks the callback and with it the master's mesh task.
+// - aggregate: NAV_BATCH frames copied to a queue by the callback and
+//   summarized in loop() by common/nav_relay, within its token buckets,
+//   through the SerialTx ring with slots kept free for control lines.
+// The control traffic is a heartbeat stream from one more node; its latency
+// runs from the send to the last byte of its slave_state line on the port.
+
+#include "../mesh_bench/loopback_mesh.h"
+
+#include <mesh_messages.h>
+#include <nav_line.h>
+#include <nav_relay.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr uint32_t MASTER_NODE = 1;
+constexpr uint32_t CONTROL_NODE = 2;
+constexpr uint32_t FIRST_SLAVE_NODE = 100;
+constexpr uint64_t STEP_US = 1000;
+// The master firmware's loop() delay.
+constexpr uint64_t LOOP_PERIOD_US = 5000;
+// Slave control tick and NAV_LOG_PERIOD_MS.
+constexpr uint32_t CONTROL_TICK_MS = 20;
+constexpr uint32_t BATCH_PERIOD_MS = 200;
+// Master firmware queue and ring sizes.
+constexpr size_t NAV_BATCH_QUEUE_LENGTH = 8;
+constexpr size_t HEARTBEAT_QUEUE_LENGTH = 16;
+constexpr size_t SERIAL_OUT_SLOTS = 16;
+constexpr size_t SERIAL_OUT_CONTROL_SLOTS = 6;
+constexpr size_t LINE_CAPACITY = 288;
+
+enum class Mode : uint8_t { RELAY, AGGREGATE };
+
+const char *modeName(Mode mode) {
+  return mode == Mode::RELAY ? "relay" : "aggregate";
+}
+
+struct Options {
+  std::vector<uint32_t> slaves{0, 2, 4, 8, 16, 32};
+  double seconds = 30.0;
+  uint32_t baud = 115200;
+  uint32_t uartBufferBytes = 256;
+  // Control heartbeats per second.
+  double controlHz = 10.0;
+  bool passthrough = true;
+  LoopbackMeshConfig mesh;
+  nav_relay::RelayConfig relay;
+  uint64_t seed = 1;
+};
+
+void usage(const char *program) {
+  std::fprintf(
+      stderr,
+      "usage: %s [options]\n"
+      "  --slaves N,N,...   walking slaves per run (0,2,4,8,16,32)\n"
+      "  --seconds S        simulated time per run (30)\n"
+      "  --baud B           master serial port (115200)\n"
+      "  --control-hz HZ    control heartbeats per second (10)\n"
+      "  --link-bps B       nav_relay link budget, bytes/s (6000)\n"
+      "  --slave-bps B      raw lines per slave, bytes/s (300)\n"
+      "  --no-passthrough   no slave relayed at full fidelity\n"
+      "  --seed N\n",
+      program);
+}
+
+bool parseArgs(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--no-passthrough") {
+      options.passthrough = false;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char *value = argv[++i];
+    if (arg == "--slaves") {
+      options.slaves.clear();
+      for (const char *p = value; *p != '\0';) {
+        char *end = nullptr;
+        options.slaves.push_back(
+            static_cast<uint32_t>(std::strtoul(p, &end, 10)));
+        if (end == p) {
+          return false;
+        }
+        p = *end == ',' ? end + 1 : end;
+      }
+    } else if (arg == "--seconds") {
+      options.seconds = std::atof(value);
+    } else if (arg == "--baud") {
+      options.baud = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    } else if (arg == "--control-hz") {
+      options.controlHz = std::atof(value);
+    } else if (arg == "--link-bps") {
+      options.relay.linkBytesPerS =
+          static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    } else if (arg == "--slave-bps") {
+      options.relay.slaveBytesPerS =
+          static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+    } else if (arg == "--seed") {
+      options.seed = std::strtoull(value, nullptr, 10);
+    } else {
+      return false;
+    }
+  }
+  return !options.slaves.empty() && options.seconds > 0.0 &&
+         options.baud > 0 && options.controlHz > 0.0;
+}
+
+// 8N1: ten bits per byte on the wire.
+class SerialPort {
+public:
+  SerialPort(uint32_t baud, uint32_t bufferBytes)
+      : usPerByte_(10.0e6 / baud),
+        bufferUs_(static_cast<uint64_t>(bufferBytes * usPerByte_)) {}
+
+  // Queues a line; returns when its last byte is out.
+  uint64_t write(uint64_t nowUs, size_t bytes) {
+    const uint64_t start = freeAtUs_ > nowUs ? freeAtUs_ : nowUs;
+    freeAtUs_ = start + static_cast<uint64_t>(bytes * usPerByte_);
+    written_ += bytes;
+    return freeAtUs_;
+  }
+  // A writer waits until the driver buffer has room again.
+  bool accepts(uint64_t nowUs) const { return freeAtUs_ <= nowUs + bufferUs_; }
+  uint64_t acceptsAt() const {
+    return freeAtUs_ > bufferUs_ ? freeAtUs_ - bufferUs_ : 0;
+  }
+  uint64_t written() const { return written_; }
+
+private:
+  double usPerByte_;
+  uint64_t bufferUs_;
+  uint64_t freeAtUs_ = 0;
+  uint64_t written_ = 0;
+};
+
+// A walking slave: a bearing that wanders, a signal that grows as it
+// closes in, and duties that steer.
+class WalkingSlave {
+public:
+  WalkingSlave(uint32_t node, uint64_t seed)
+      : node_(node), rng_(seed),
+        theta_(std::uniform_real_distribution<float>(-180.0f, 180.0f)(rng_)),
+        phaseMs_(std::uniform_int_distribution<uint32_t>(
+            0, BATCH_PERIOD_MS - 1)(rng_)) {}
+
+  uint32_t node() const { return node_; }
+  uint32_t phaseMs() const { return phaseMs_; }
+
+  NavFrame frame(uint32_t nowMs) {
+    std::normal_distribution<float> step(0.0f, 4.0f);
+    std::normal_distribution<float> noise(0.0f, 30.0f);
+    theta_ += step(rng_);
+    theta_ = theta_ > 180.0f ? theta_ - 360.0f : theta_;
+    theta_ = theta_ < -180.0f ? theta_ + 360.0f : theta_;
+    signal_ = std::min(signal_ * 1.002f, 3500.0f);
+
+    NavFrame frame;
+    frame.tMs = nowMs;
+    for (int c = 0; c < 4; ++c) {
+      const float raw =
+          600.0f + signal_ * (c == 0 ? 0.6f : 0.15f) + noise(rng_);
+      frame.raw[c] = static_cast<uint16_t>(std::max(raw, 0.0f));
+      frame.amplitudeDeci[c] =
+          static_cast<uint16_t>(std::max(raw - 600.0f, 0.0f) * 10.0f);
+    }
+    frame.thetaCentiDeg = static_cast<int16_t>(std::lround(theta_ * 100.0f));
+    frame.signalDeci = static_cast<uint32_t>(signal_ * 10.0f);
+    const int turn = static_cast<int>(theta_ * 2.0f);
+    frame.dutyLeft = static_cast<uint16_t>(std::max(0, 500 - turn));
+    frame.dutyRight = static_cast<uint16_t>(std::max(0, 500 + turn));
+    frame.flags = NavFrame::FLAG_DETECTED;
+    return frame;
+  }
+
+private:
+  uint32_t node_;
+  std::mt19937_64 rng_;
+  float theta_;
+  float signal_ = 400.0f;
+  uint32_t phaseMs_;
+};
+
+struct Stats {
+  std::vector<double> controlMs;
+  uint64_t controlSent = 0;
+  uint64_t framesSent = 0;
+  uint64_t framesRaw = 0;
+  uint64_t framesSummarized = 0;
+  uint64_t navBytes = 0;
+  uint64_t navLines = 0;
+  uint64_t dropped = 0;
+};
+
+double percentile(std::vector<double> &sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  const size_t rank =
+      static_cast<size_t>(std::ceil(fraction * sorted.size())) - 1;
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+struct Line {
+  size_t bytes;
+  // Send time of the heartbeat it reports, 0 for telemetry.
+  uint64_t controlSentUs;
+};
+
+struct Master {
+  Mode mode;
+  LoopbackMesh &mesh;
+  SerialPort port;
+  Stats &stats;
+  // Heartbeat send times by sequence number.
+  std::vector<uint64_t> &sentUs;
+  mesh_proto::Dispatcher dispatcher;
+  nav_relay::NavRelay relay;
+  std::deque<heartbeat::Status> heartbeats;
+  struct Batch {
+    uint32_t node;
+    uint8_t frames;
+    std::vector<uint8_t> stream;
+  };
+  std::deque<Batch> batches;
+  // SerialTx ring; the drain task writes one line at a time.
+  std::deque<Line> ring;
+  // Frames per relayed `log:` message, by sender, in send order.
+  std::vector<std::deque<uint16_t>> logFrames;
+  // Telemetry still in the port at the end of the run does not count.
+  uint64_t endUs = 0;
+
+  Master(Mode mode, LoopbackMesh &mesh, const Options &options, Stats &stats,
+         std::vector<uint64_t> &sentUs)
+      : mode(mode), mesh(mesh), port(options.baud, options.uartBufferBytes),
+        stats(stats), sentUs(sentUs), relay(options.relay) {}
+
+  size_t controlLine(const heartbeat::Status &status, char *line,
+                     size_t size) {
+    const int written = std::snprintf(
+        line, size, "slave_state,%lu,%s,%lu,%u,%u\n",
+        static_cast<unsigned long>(status.node),
+        heartbeat::stateName(status.state),
+        static_cast<unsigned long>(status.stateAgeMs),
+        static_cast<unsigned>(status.batteryMv),
+        static_cast<unsigned>(status.flags));
+    return written > 0 ? static_cast<size_t>(written) : 0;
+  }
+
+  void finishControl(uint64_t sent, uint64_t doneUs) {
+    stats.controlMs.push_back(static_cast<double>(doneUs - sent) / 1000.0);
+  }
+
+  // The old path: every write happens on the mesh task and waits for room
+  // in the UART driver buffer.
+  uint64_t writeBlocking(size_t bytes, uint64_t controlSentUs) {
+    const uint64_t now = mesh.nowUs();
+    const uint64_t start = std::max(now, port.acceptsAt());
+    const uint64_t done = port.write(start, bytes);
+    mesh.occupy(MASTER_NODE, start);
+    if (controlSentUs != 0) {
+      finishControl(controlSentUs, done);
+    }
+    return done;
+  }
+
+  static void onHeartbeat(void *context, const mesh_proto::Envelope &,
+                          mesh_proto::Reader &payload) {
+    Master &master = *static_cast<Master *>(context);
+    heartbeat::Status status;
+    if (!mesh_proto::readHeartbeat(payload, status)) {
+      return;
+    }
+    if (master.mode == Mode::RELAY) {
+      char line[LINE_CAPACITY];
+      master.writeBlocking(master.controlLine(status, line, sizeof(line)),
+                           master.sentUs[status.seq]);
+    } else if (master.heartbeats.size() < HEARTBEAT_QUEUE_LENGTH) {
+      master.heartbeats.push_back(status);
+    } else {
+      master.stats.dropped++;
+    }
+  }
+
+  static void onNavBatch(void *context, const mesh_proto::Envelope &,
+                         mesh_proto::Reader &payload) {
+    Master &master = *static_cast<Master *>(context);
+    mesh_proto::NavBatch batch;
+    if (!mesh_proto::readNavBatch(payload, batch)) {
+      return;
+    }
+    if (master.batches.size() >= NAV_BATCH_QUEUE_LENGTH) {
+      master.stats.dropped++;
+      return;
+    }
+    master.batches.push_back(
+        Batch{batch.node, batch.frames,
+              std::vector<uint8_t>(batch.stream, batch.stream + batch.length)});
+  }
+
+  void begin() {
+    dispatcher.on(mesh_proto::Type::HEARTBEAT, onHeartbeat, this);
+    if (mode == Mode::AGGREGATE) {
+      dispatcher.on(mesh_proto::Type::NAV_BATCH, onNavBatch, this);
+    }
+  }
+
+  void onBroadcast(std::string &message) {
+    mesh_proto::Envelope envelope;
+    envelope.receivedUs = mesh.nowUs();
+    dispatcher.dispatchText(envelope, message.c_str(), message.size());
+  }
+
+  // What dezibot's Master does with a `log:` unicast.
+  void onSingle(uint32_t from, std::string &message) {
+    if (message.compare(0, 4, "log:") != 0) {
+      return;
+    }
+    const size_t bytes = std::strlen("wireless_log,") +
+                         std::to_string(from).size() + 1 +
+                         (message.size() - 4) + 1;
+    std::deque<uint16_t> &pending = logFrames[from - FIRST_SLAVE_NODE];
+    const uint16_t frames = pending.empty() ? 0 : pending.front();
+    if (!pending.empty()) {
+      pending.pop_front();
+    }
+    if (writeBlocking(bytes, 0) <= endUs) {
+      stats.navBytes += bytes;
+      stats.navLines++;
+      stats.framesRaw += frames;
+    }
+  }
+
+  void push(const Line &line) {
+    if (ring.size() >= SERIAL_OUT_SLOTS) {
+      // DROP_OLDEST.
+      ring.pop_front();
+      stats.dropped++;
+    }
+    ring.push_back(line);
+  }
+
+  bool roomForRelay() const {
+    return ring.size() + SERIAL_OUT_CONTROL_SLOTS <= SERIAL_OUT_SLOTS;
+  }
+
+  void loop(uint64_t nowUs) {
+    const uint32_t now = static_cast<uint32_t>(nowUs / 1000);
+    char line[LINE_CAPACITY];
+    while (!heartbeats.empty()) {
+      const heartbeat::Status status = heartbeats.front();
+      heartbeats.pop_front();
+      push(Line{controlLine(status, line, sizeof(line)), sentUs[status.seq]});
+    }
+    while (!batches.empty()) {
+      const Batch batch = batches.front();
+      batches.pop_front();
+      if (relay.onBatch(batch.node, batch.stream.data(), batch.stream.size(),
+                        now) &&
+          roomForRelay()) {
+        const size_t bytes =
+            nav_relay::formatRaw(batch.node, batch.stream.data(),
+                                 batch.stream.size(), line, sizeof(line));
+        if (bytes > 0) {
+          push(Line{bytes, 0});
+          stats.framesRaw += batch.frames;
+        }
+      }
+    }
+    nav_relay::WindowSummary summary;
+    while (roomForRelay() && relay.poll(now, summary)) {
+      const size_t bytes =
+          nav_relay::formatSummary(summary, line, sizeof(line));
+      if (bytes > 0) {
+        push(Line{bytes, 0});
+        stats.framesSummarized += summary.frames;
+      }
+    }
+  }
+
+  void drain(uint64_t nowUs) {
+    while (!ring.empty() && port.accepts(nowUs)) {
+      const Line line = ring.front();
+      ring.pop_front();
+      const uint64_t done = port.write(nowUs, line.bytes);
+      if (line.controlSentUs != 0) {
+        finishControl(line.controlSentUs, done);
+      } else {
+        stats.navBytes += line.bytes;
+        stats.navLines++;
+      }
+    }
+  }
+};
+
+struct Sender {
+  WalkingSlave slave;
+  LoopbackCommunication communication;
+  NavLineWriter writer;
+};
+
+void runLevel(const Options &options, Mode mode, uint32_t slaveCount) {
+  LoopbackMesh mesh(options.mesh, options.seed + slaveCount);
+  LoopbackCommunication masterLink(mesh, MASTER_NODE);
+  LoopbackCommunication control(mesh, CONTROL_NODE);
+  Stats stats;
+  std::vector<uint64_t> sentUs(UINT16_MAX + 1, 0);
+  Master master(mode, mesh, options, stats, sentUs);
+  master.logFrames.resize(slaveCount);
+  master.endUs = static_cast<uint64_t>(options.seconds * 1e6);
+  master.begin();
+  if (options.passthrough && slaveCount > 0) {
+    master.relay.setPassthrough(FIRST_SLAVE_NODE);
+  }
+  masterLink.onReceive(
+      [&](std::string &message) { master.onBroadcast(message); });
+  masterLink.onReceiveSingle([&](uint32_t from, std::string &message) {
+    master.onSingle(from, message);
+  });
+
+  std::vector<Sender> senders;
+  senders.reserve(slaveCount);
+  for (uint32_t i = 0; i < slaveCount; ++i) {
+    const uint32_t node = FIRST_SLAVE_NODE + i;
+    senders.push_back(Sender{WalkingSlave(node, options.seed * 131U + node),
+                             LoopbackCommunication(mesh, node),
+                             NavLineWriter()});
+  }
+
+  std::mt19937_64 rng(options.seed * 7919U + slaveCount);
+  std::exponential_distribution<double> controlInterval(options.controlHz /
+                                                        1e6);
+  uint64_t nextControlUs = static_cast<uint64_t>(controlInterval(rng));
+  uint16_t controlSeq = 0;
+  uint64_t nextLoopUs = 0;
+  char message[mesh_proto::TEXT_CAPACITY];
+  uint8_t stream[mesh_proto::NAV_BATCH_CAPACITY];
+
+  for (uint64_t now = 0; now < master.endUs; now += STEP_US) {
+    mesh.runUntil(now);
+    const uint32_t nowMs = static_cast<uint32_t>(now / 1000);
+    for (Sender &sender : senders) {
+      const uint32_t local = nowMs + sender.slave.phaseMs();
+      if (local % CONTROL_TICK_MS != 0) {
+        continue;
+      }
+      sender.writer.add(sender.slave.frame(nowMs));
+      stats.framesSent++;
+      if (local % BATCH_PERIOD_MS != 0 && !sender.writer.full()) {
+        continue;
+      }
+      const uint16_t frames = sender.writer.frameCount();
+      if (mode == Mode::RELAY) {
+        master.logFrames[sender.slave.node() - FIRST_SLAVE_NODE].push_back(
+            frames);
+        sender.communication.unicast(
+            MASTER_NODE, std::string("log:") + sender.writer.flush());
+        continue;
+      }
+      const size_t length = sender.writer.take(stream, sizeof(stream));
+      if (mesh_proto::encodeNavBatch(sender.slave.node(),
+                                     static_cast<uint8_t>(frames), stream,
+                                     length, message, sizeof(message)) > 0) {
+        sender.communication.sendMessage(message);
+      }
+    }
+    if (now >= nextControlUs) {
+      nextControlUs += static_cast<uint64_t>(controlInterval(rng));
+      heartbeat::Status status;
+      status.node = CONTROL_NODE;
+      status.seq = ++controlSeq;
+      status.state = heartbeat::SlaveState::WAIT_CHARGE;
+      if (mesh_proto::encodeHeartbeat(status, message, sizeof(message)) > 0) {
+        sentUs[status.seq] = now;
+        stats.controlSent++;
+        control.sendMessage(message);
+      }
+    }
+    if (mode == Mode::AGGREGATE && now >= nextLoopUs) {
+      master.loop(now);
+      nextLoopUs += LOOP_PERIOD_US;
+    }
+    master.drain(now);
+  }
+
+  std::sort(stats.controlMs.begin(), stats.controlMs.end());
+  const double frames =
+      stats.framesSent > 0 ? static_cast<double>(stats.framesSent) : 1.0;
+  std::printf(
+      "%6u %-9s %6lu %7.1f %7.1f %7.1f %7.1f %8.0f %7.1f %6.1f %6.1f %5lu\n",
+      slaveCount, modeName(mode),
+      static_cast<unsigned long>(stats.controlMs.size()),
+      percentile(stats.controlMs, 0.50), percentile(stats.controlMs, 0.90),
+      percentile(stats.controlMs, 0.99),
+      stats.controlMs.empty() ? 0.0 : stats.controlMs.back(),
+      static_cast<double>(stats.navBytes) / options.seconds,
+      static_cast<double>(stats.navLines) / options.seconds,
+      100.0 * static_cast<double>(stats.framesRaw) / frames,
+      100.0 * static_cast<double>(stats.framesSummarized) / frames,
+      static_cast<unsigned long>(stats.dropped));
+  std::fflush(stdout);
+  std::fprintf(stderr,
+               "slaves=%u mode=%s control_sent=%lu serial_bytes=%llu "
+               "relayed=%lu refused=%lu untracked=%lu\n",
+               slaveCount, modeName(mode),
+               static_cast<unsigned long>(stats.controlSent),
+               static_cast<unsigned long long>(master.port.written()),
+               static_cast<unsigned long>(master.relay.relayed()),
+               static_cast<unsigned long>(master.relay.refused()),
+               static_cast<unsigned long>(master.relay.untracked()));
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseArgs(argc, argv, options)) {
+    usage(argv[0]);
+    return 2;
+  }
+  std::printf("slaves mode       ctl_n ctl_p50 ctl_p90 ctl_p99 ctl_max "
+              " nav_B/s lines/s  raw_%% summ_%% drops   (ms)\n");
+  std::fflush(stdout);
+  for (uint32_t slaves : options.slaves) {
+    runLevel(options, Mode::RELAY, slaves);
+    runLevel(options, Mode::AGGREGATE, slaves);
+  }
+  return 0;
+}
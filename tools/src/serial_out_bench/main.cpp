@@ -0,0 +1,204 @@
+// Shows that logging through MessageRing decouples the control loop from
+// the serial port: a simulated 500 Hz control tick logs one beacon_nav-sized
+// line per tick into either a blocking sink (direct Serial.printf) or the
+// ring drained by a TX thread, with the host either reading (attached) or
+// stalled (USB CDC blocks on every write). Also stress-tests the ring with
+// several producers and checks every delivered message.
+
+#include <message_ring.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr int TICKS = 300;
+constexpr auto TICK_PERIOD = std::chrono::microseconds(2000);
+constexpr auto TICK_WORK = std::chrono::microseconds(150);
+constexpr auto STALL_PER_WRITE = std::chrono::milliseconds(20);
+constexpr double ATTACHED_NS_PER_BYTE = 1000.0; // ~1 MB/s USB full speed
+
+typedef MessageRing<16, 160> LogRing;
+
+// Stand-in for Serial on USB CDC.
+struct Port {
+  bool stalled = false;
+  void write(const char *data, size_t length) {
+    (void)data;
+    if (stalled) {
+      std::this_thread::sleep_for(STALL_PER_WRITE);
+    } else {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(
+          static_cast<int64_t>(length * ATTACHED_NS_PER_BYTE)));
+    }
+  }
+};
+
+void spin(std::chrono::microseconds duration) {
+  const auto until = Clock::now() + duration;
+  while (Clock::now() < until) {
+  }
+}
+
+struct TickStats {
+  double p50Us = 0;
+  double p99Us = 0;
+  double maxUs = 0;
+};
+
+TickStats summarize(std::vector<double> &ticks) {
+  std::sort(ticks.begin(), ticks.end());
+  TickStats stats;
+  stats.p50Us = ticks[ticks.size() / 2];
+  stats.p99Us = ticks[ticks.size() * 99 / 100];
+  stats.maxUs = ticks.back();
+  return stats;
+}
+
+template <typename LogFn> std::vector<double> runControlLoop(LogFn log) {
+  std::vector<double> ticks;
+  auto next = Clock::now();
+  for (int i = 0; i < TICKS; ++i) {
+    std::this_thread::sleep_until(next);
+    next += TICK_PERIOD;
+    const auto start = Clock::now();
+    spin(TICK_WORK);
+    log(i);
+    ticks.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+            .count());
+  }
+  return ticks;
+}
+
+const char *const LINE_FORMAT =
+    "beacon_nav,%d,track,2750,791,795,777,2750.0,791.0,795.0,777.0,0.53,"
+    "5113.0,1,3560,3600\n";
+
+void runScenario(const char *name, bool useRing, bool stalled) {
+  Port port;
+  port.stalled = stalled;
+  std::vector<double> ticks;
+  uint32_t dropped = 0;
+
+  if (!useRing) {
+    char line[160];
+    ticks = runControlLoop([&](int i) {
+      const int length = snprintf(line, sizeof(line), LINE_FORMAT, i);
+      port.write(line, static_cast<size_t>(length));
+    });
+  } else {
+    LogRing ring(OverflowPolicy::DROP_OLDEST);
+    std::atomic<bool> running{true};
+    std::thread tx([&] {
+      char buffer[LogRing::SLOT_SIZE];
+      while (running.load() || !ring.empty()) {
+        const int length = ring.pop(buffer);
+        if (length < 0) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          continue;
+        }
+        port.write(buffer, static_cast<size_t>(length));
+      }
+    });
+    ticks = runControlLoop([&](int i) { ring.printf(LINE_FORMAT, i); });
+    running = false;
+    port.stalled = false; // let the TX thread finish quickly
+    tx.join();
+    dropped = ring.droppedOldest() + ring.droppedNewest();
+  }
+
+  const TickStats stats = summarize(ticks);
+  std::printf("%-26s p50 %8.1f us  p99 %8.1f us  max %8.1f us  dropped %u\n",
+              name, stats.p50Us, stats.p99Us, stats.maxUs, dropped);
+}
+
+// Producers tag each message with (producer, index) and a checksum; the
+// consumer verifies every message and counts what arrived.
+bool stressTest(OverflowPolicy policy) {
+  constexpr int PRODUCERS = 4;
+  constexpr int MESSAGES = 200000;
+  LogRing ring(policy);
+  std::atomic<int> finished{0};
+  std::vector<std::thread> producers;
+  for (int p = 0; p < PRODUCERS; ++p) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < MESSAGES; ++i) {
+        const unsigned check = (static_cast<unsigned>(p) * 2654435761U) ^
+                               static_cast<unsigned>(i);
+        ring.printf("%d,%d,%u,padding-padding-padding", p, i, check);
+      }
+      finished++;
+    });
+  }
+
+  uint64_t delivered = 0;
+  uint64_t corrupt = 0;
+  int lastIndex[PRODUCERS];
+  std::fill(lastIndex, lastIndex + PRODUCERS, -1);
+  uint64_t reordered = 0;
+  char buffer[LogRing::SLOT_SIZE + 1];
+  while (finished.load() < PRODUCERS || !ring.empty()) {
+    const int length = ring.pop(buffer);
+    if (length < 0) {
+      continue;
+    }
+    buffer[length] = '\0';
+    int p = 0;
+    int i = 0;
+    unsigned check = 0;
+    if (std::sscanf(buffer, "%d,%d,%u,", &p, &i, &check) != 3 || p < 0 ||
+        p >= PRODUCERS ||
+        check != ((static_cast<unsigned>(p) * 2654435761U) ^
+                  static_cast<unsigned>(i)) ||
+        std::strstr(buffer, "padding-padding-padding") == nullptr) {
+      corrupt++;
+      continue;
+    }
+    if (i <= lastIndex[p]) {
+      reordered++;
+    }
+    lastIndex[p] = i;
+    delivered++;
+  }
+  for (std::thread &t : producers) {
+    t.join();
+  }
+
+  const uint64_t dropped = ring.droppedOldest() + ring.droppedNewest();
+  const uint64_t total = static_cast<uint64_t>(PRODUCERS) * MESSAGES;
+  const bool ok =
+      corrupt == 0 && reordered == 0 && delivered + dropped == total;
+  std::printf("stress %-12s delivered %llu dropped_oldest %u dropped_newest "
+              "%u corrupt %llu reordered %llu -> %s\n",
+              policy == OverflowPolicy::DROP_OLDEST ? "drop-oldest"
+                                                    : "drop-newest",
+              static_cast<unsigned long long>(delivered), ring.droppedOldest(),
+              ring.droppedNewest(), static_cast<unsigned long long>(corrupt),
+              static_cast<unsigned long long>(reordered), ok ? "ok" : "FAILED");
+  return ok;
+}
+} // namespace
+
+int main() {
+  std::printf("control tick: %d ticks, %lld us work, stalled write blocks "
+              "%lld ms\n",
+              TICKS, static_cast<long long>(TICK_WORK.count()),
+              static_cast<long long>(STALL_PER_WRITE.count()));
+  runScenario("direct, host attached", false, false);
+  runScenario("direct, host stalled", false, true);
+  runScenario("ring, host attached", true, false);
+  runScenario("ring, host stalled", true, true);
+  std::printf("\n");
+  const bool oldestOk = stressTest(OverflowPolicy::DROP_OLDEST);
+  const bool newestOk = stressTest(OverflowPolicy::DROP_NEWEST);
+  return oldestOk && newestOk ? 0 : 1;
+}
@@ -0,0 +1,371 @@
+// Compares the time to load recordings as CSV against opening them as
+// memory-mapped traces (common/trace_file). Each CSV given is converted to
+// a temporary trace first; then every loader runs on every file in turn,
+// warm page cache, and the median per file is kept.
+// - csv_stream: getline + stringstream + strtod into per-column
+//   vectors, as the tools here load recordings (filter_bench).
+// - csv_strtod: the whole file read at once and walked with strtod.
+// - trace_open: map the trace and look up the column arrays.
+// - trace_scan: trace_open, then read every value of every column.
+// Each loader sums theta_deg and raw_f, so all of them produce a result.
+
+#include <trace_reader.h>
+#include <trace_writer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+constexpr size_t LOADER_COUNT = 4;
+const char *const LOADERS[LOADER_COUNT] = {"csv_stream", "csv_strtod",
+                                           "trace_open", "trace_scan"};
+
+struct Options {
+  std::vector<std::string> inputs;
+  uint32_t repeats = 25;
+  std::string tmpDir = "/tmp";
+};
+
+struct Table {
+  std::vector<std::string> names;
+  std::vector<std::vector<double>> columns;
+};
+
+struct Input {
+  std::string csv;
+  std::string trace;
+  size_t csvBytes = 0;
+  size_t traceBytes = 0;
+  uint64_t rows = 0;
+  double medianUs[LOADER_COUNT] = {};
+};
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "usage: %s [options] RECORDING.csv...\n"
+               "  --repeats N  loads per file and loader (25)\n"
+               "  --tmp DIR    where the traces are written (/tmp)\n",
+               program);
+}
+
+bool parseArgs(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--repeats" && hasValue) {
+      options.repeats =
+          static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--tmp" && hasValue) {
+      options.tmpDir = argv[++i];
+    } else if (!arg.empty() && arg[0] != '-') {
+      options.inputs.push_back(arg);
+    } else {
+      return false;
+    }
+  }
+  return !options.inputs.empty() && options.repeats > 0;
+}
+
+int indexOf(const std::vector<std::string> &names, const char *name) {
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (names[i] == name) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+double checksum(const Table &table) {
+  const int theta = indexOf(table.names, "theta_deg");
+  const int raw = indexOf(table.names, "raw_f");
+  double sum = 0.0;
+  for (int column : {theta, raw}) {
+    if (column >= 0) {
+      for (double value : table.columns[column]) {
+        sum += value;
+      }
+    }
+  }
+  return sum;
+}
+
+bool loadStream(const std::string &path, Table &table) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::string line;
+  std::getline(file, line);
+  std::stringstream header(line);
+  std::string cell;
+  table.names.clear();
+  while (std::getline(header, cell, ',')) {
+    table.names.push_back(cell);
+  }
+  table.columns.assign(table.names.size(), std::vector<double>());
+  while (std::getline(file, line)) {
+    std::stringstream row(line);
+    for (std::vector<double> &column : table.columns) {
+      if (!std::getline(row, cell, ',')) {
+        break;
+      }
+      column.push_back(std::strtod(cell.c_str(), nullptr));
+    }
+  }
+  return true;
+}
+
+bool loadStrtod(const std::string &path, Table &table) {
+  std::FILE *file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  std::fseek(file, 0, SEEK_END);
+  const long size = std::ftell(file);
+  std::fseek(file, 0, SEEK_SET);
+  std::string text(static_cast<size_t>(size), '\0');
+  const bool read =
+      std::fread(&text[0], 1, text.size(), file) == text.size();
+  std::fclose(file);
+  if (!read) {
+    return false;
+  }
+
+  const char *p = text.c_str();
+  const char *lineEnd = std::strchr(p, '\n');
+  if (lineEnd == nullptr) {
+    return false;
+  }
+  table.names.clear();
+  for (const char *start = p; start <= lineEnd;) {
+    const char *end = start;
+    while (end < lineEnd && *end != ',' && *end != '\r') {
+      ++end;
+    }
+    table.names.emplace_back(start, end);
+    start = end + 1;
+    if (*end != ',') {
+      break;
+    }
+  }
+  table.columns.assign(table.names.size(), std::vector<double>());
+  p = lineEnd + 1;
+  while (*p != '\0') {
+    for (size_t c = 0; c < table.columns.size(); ++c) {
+      char *end = nullptr;
+      table.columns[c].push_back(std::strtod(p, &end));
+      p = *end == ',' ? end + 1 : end;
+    }
+    while (*p != '\0' && *p != '\n') {
+      ++p;
+    }
+    if (*p == '\n') {
+      ++p;
+    }
+  }
+  return true;
+}
+
+double sumColumn(const trace_file::TraceReader &trace, int column) {
+  double sum = 0.0;
+  if (column < 0) {
+    return sum;
+  }
+  for (size_t chunk = 0; chunk < trace.chunkCount(); ++chunk) {
+    const uint32_t rows = trace.chunkRows(chunk);
+    if (const float *values = trace.array<float>(chunk, column)) {
+      for (uint32_t i = 0; i < rows; ++i) {
+        sum += values[i];
+      }
+    } else if (const uint16_t *values = trace.array<uint16_t>(chunk, column)) {
+      for (uint32_t i = 0; i < rows; ++i) {
+        sum += values[i];
+      }
+    } else {
+      for (uint32_t i = 0; i < rows; ++i) {
+        sum += trace.value(chunk, column, i);
+      }
+    }
+  }
+  return sum;
+}
+
+// Keeps trace_scan's reads from being optimized away.
+volatile double scanSink = 0.0;
+
+double openTrace(const std::string &path, bool scan) {
+  trace_file::TraceReader trace;
+  if (!trace.open(path.c_str())) {
+    return 0.0;
+  }
+  double sum = sumColumn(trace, trace.find("theta_deg")) +
+               sumColumn(trace, trace.find("raw_f"));
+  if (scan) {
+    double scanned = 0.0;
+    for (size_t c = 0; c < trace.columnCount(); ++c) {
+      scanned += sumColumn(trace, static_cast<int>(c));
+    }
+    scanSink = scanned;
+  }
+  return sum;
+}
+
+// Writes the trace the same way trace_convert does.
+bool convert(const Table &table, const std::string &path) {
+  std::vector<trace_file::Column> columns;
+  for (const std::string &name : table.names) {
+    columns.push_back(trace_file::beaconColumn(name));
+  }
+  trace_file::TraceWriter writer;
+  if (!writer.create(path.c_str(), columns, std::string())) {
+    return false;
+  }
+  const size_t rows = table.columns.empty() ? 0 : table.columns[0].size();
+  for (size_t row = 0; row < rows; ++row) {
+    for (size_t c = 0; c < table.columns.size(); ++c) {
+      writer.set(c, row < table.columns[c].size() ? table.columns[c][row]
+                                                   : 0.0);
+    }
+    writer.endRow();
+  }
+  return writer.close();
+}
+
+size_t fileBytes(const std::string &path) {
+  std::FILE *file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return 0;
+  }
+  std::fseek(file, 0, SEEK_END);
+  const long size = std::ftell(file);
+  std::fclose(file);
+  return size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+double load(size_t loader, const Input &input) {
+  Table table;
+  switch (loader) {
+  case 0:
+    return loadStream(input.csv, table) ? checksum(table) : 0.0;
+  case 1:
+    return loadStrtod(input.csv, table) ? checksum(table) : 0.0;
+  case 2:
+    return openTrace(input.trace, false);
+  default:
+    return openTrace(input.trace, true);
+  }
+}
+
+double median(std::vector<double> &values) {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+const char *baseName(const std::string &path) {
+  const size_t slash = path.rfind('/');
+  return path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseArgs(argc, argv, options)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::vector<Input> inputs;
+  for (size_t i = 0; i < options.inputs.size(); ++i) {
+    Input input;
+    input.csv = options.inputs[i];
+    input.trace = options.tmpDir + "/trace_bench_" +
+                  std::to_string(getpid()) + "_" + std::to_string(i) + ".btr";
+    Table table;
+    if (!loadStrtod(input.csv, table) || !convert(table, input.trace)) {
+      std::fprintf(stderr, "cannot convert %s\n", input.csv.c_str());
+      return 1;
+    }
+    input.rows = table.columns.empty() ? 0 : table.columns[0].size();
+    input.csvBytes = fileBytes(input.csv);
+    input.traceBytes = fileBytes(input.trace);
+    inputs.push_back(input);
+  }
+
+  // All loaders must agree before any of them is timed.
+  for (const Input &input : inputs) {
+    const double expected = load(0, input);
+    for (size_t loader = 1; loader < LOADER_COUNT; ++loader) {
+      const double sum = load(loader, input);
+      if (sum < expected - 1e-6 * (1.0 + expected) ||
+          sum > expected + 1e-6 * (1.0 + expected)) {
+        std::fprintf(stderr, "%s: %s disagrees (%.3f vs %.3f)\n",
+                     input.csv.c_str(), LOADERS[loader], sum, expected);
+        return 1;
+      }
+    }
+  }
+
+  std::vector<std::vector<double>> samples(
+      inputs.size() * LOADER_COUNT, std::vector<double>());
+  volatile double sink = 0.0;
+  for (uint32_t repeat = 0; repeat < options.repeats; ++repeat) {
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      for (size_t loader = 0; loader < LOADER_COUNT; ++loader) {
+        const auto start = std::chrono::steady_clock::now();
+        sink = sink + load(loader, inputs[i]);
+        const double us = std::chrono::duration<double, std::micro>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+        samples[i * LOADER_COUNT + loader].push_back(us);
+      }
+    }
+  }
+
+  std::printf("%-12s %7s %8s %8s", "file", "rows", "csv_kB", "btr_kB");
+  for (const char *loader : LOADERS) {
+    std::printf(" %11s", loader);
+  }
+  std::printf("   (us, median of %lu)\n",
+              static_cast<unsigned long>(options.repeats));
+  double totals[LOADER_COUNT] = {};
+  uint64_t rows = 0;
+  size_t csvBytes = 0;
+  size_t traceBytes = 0;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    Input &input = inputs[i];
+    std::printf("%-12s %7llu %8.1f %8.1f", baseName(input.csv),
+                static_cast<unsigned long long>(input.rows),
+                input.csvBytes / 1024.0, input.traceBytes / 1024.0);
+    for (size_t loader = 0; loader < LOADER_COUNT; ++loader) {
+      input.medianUs[loader] = median(samples[i * LOADER_COUNT + loader]);
+      totals[loader] += input.medianUs[loader];
+      std::printf(" %11.1f", input.medianUs[loader]);
+    }
+    std::printf("\n");
+    rows += input.rows;
+    csvBytes += input.csvBytes;
+    traceBytes += input.traceBytes;
+    unlink(input.trace.c_str());
+  }
+  std::printf("%-12s %7llu %8.1f %8.1f", "total",
+              static_cast<unsigned long long>(rows), csvBytes / 1024.0,
+              traceBytes / 1024.0);
+  for (double total : totals) {
+    std::printf(" %11.1f", total);
+  }
+  std::printf("\n%-12s %7s %8s %8s", "speedup", "", "", "");
+  for (double total : totals) {
+    std::printf(" %10.1fx", totals[0] / total);
+  }
+  std::printf("\n");
+  return 0;
+}
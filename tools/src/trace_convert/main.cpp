@@ -0,0 +1,258 @@
+// Converts recording CSVs (evaluation/data, capture_recv, nav_decode) to
+// memory-mapped beacon traces (common/trace_file) and back, and describes
+// a trace: columns, meta, chunks and their CRCs.
+
+#include <trace_reader.h>
+#include <trace_writer.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+enum class Action : uint8_t { TO_TRACE, TO_CSV, INFO };
+
+struct Options {
+  Action action = Action::TO_TRACE;
+  std::string input;
+  std::string output;
+  std::string meta;
+  uint32_t chunkRows = trace_file::TraceWriter::DEFAULT_CHUNK_ROWS;
+};
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "usage: %s IN.csv OUT.btr [--meta KEY=VALUE]... [--chunk-rows N]\n"
+               "       %s --csv IN.btr [OUT.csv]\n"
+               "       %s --info IN.btr\n",
+               program, program, program);
+}
+
+bool parseArgs(int argc, char **argv, Options &options) {
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--csv") {
+      options.action = Action::TO_CSV;
+    } else if (arg == "--info") {
+      options.action = Action::INFO;
+    } else if (arg == "--meta" && hasValue) {
+      const std::string entry = argv[++i];
+      const size_t equals = entry.find('=');
+      if (equals == std::string::npos || equals == 0 ||
+          entry.find('\n') != std::string::npos) {
+        return false;
+      }
+      trace_file::addMeta(options.meta, entry.substr(0, equals),
+                          entry.substr(equals + 1));
+    } else if (arg == "--chunk-rows" && hasValue) {
+      options.chunkRows =
+          static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (!arg.empty() && arg[0] != '-') {
+      files.push_back(arg);
+    } else {
+      return false;
+    }
+  }
+  if (files.empty() || files.size() > 2 || options.chunkRows == 0) {
+    return false;
+  }
+  options.input = files[0];
+  options.output = files.size() > 1 ? files[1] : std::string();
+  switch (options.action) {
+  case Action::TO_TRACE:
+    return !options.output.empty();
+  case Action::TO_CSV:
+    return true;
+  case Action::INFO:
+    return files.size() == 1;
+  }
+  return false;
+}
+
+std::vector<std::string> splitCells(const std::string &line) {
+  std::vector<std::string> cells;
+  size_t start = 0;
+  for (;;) {
+    const size_t comma = line.find(',', start);
+    cells.push_back(line.substr(start, comma - start));
+    if (comma == std::string::npos) {
+      return cells;
+    }
+    start = comma + 1;
+  }
+}
+
+bool parseNumber(const std::string &cell, double &value) {
+  char *end = nullptr;
+  value = std::strtod(cell.c_str(), &end);
+  return end != cell.c_str() && *end == '\0';
+}
+
+int toTrace(const Options &options) {
+  std::ifstream in(options.input);
+  if (!in) {
+    std::fprintf(stderr, "cannot open %s\n", options.input.c_str());
+    return 1;
+  }
+  std::string line;
+  std::getline(in, line);
+  if (!line.empty() && line.back() == '\r') {
+    line.pop_back();
+  }
+  const std::vector<std::string> names = splitCells(line);
+
+  // The first data row decides which columns are numbers; text columns
+  // (nav_decode's mode) are left out.
+  std::string first;
+  while (std::getline(in, first) && first.empty()) {
+  }
+  if (!first.empty() && first.back() == '\r') {
+    first.pop_back();
+  }
+  const std::vector<std::string> firstCells = splitCells(first);
+  std::vector<size_t> kept;
+  std::vector<trace_file::Column> columns;
+  for (size_t i = 0; i < names.size(); ++i) {
+    double value;
+    if (i < firstCells.size() && !parseNumber(firstCells[i], value)) {
+      std::fprintf(stderr, "skipping text column %s\n", names[i].c_str());
+      continue;
+    }
+    kept.push_back(i);
+    columns.push_back(trace_file::beaconColumn(names[i]));
+  }
+
+  std::string meta;
+  trace_file::addMeta(meta, "source", options.input);
+  meta += options.meta;
+  trace_file::TraceWriter writer;
+  if (!writer.create(options.output.c_str(), columns, meta,
+                     options.chunkRows)) {
+    std::fprintf(stderr, "cannot write %s\n", options.output.c_str());
+    return 1;
+  }
+
+  uint64_t badCells = 0;
+  uint64_t skippedRows = 0;
+  line = first;
+  do {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      continue;
+    }
+    const std::vector<std::string> cells = splitCells(line);
+    if (cells.size() != names.size()) {
+      skippedRows++;
+      continue;
+    }
+    for (size_t c = 0; c < kept.size(); ++c) {
+      double value = 0.0;
+      if (!parseNumber(cells[kept[c]], value)) {
+        badCells++;
+      }
+      writer.set(c, value);
+    }
+    writer.endRow();
+  } while (std::getline(in, line));
+
+  if (!writer.close()) {
+    std::fprintf(stderr, "write to %s failed\n", options.output.c_str());
+    return 1;
+  }
+  std::fprintf(stderr,
+               "rows=%llu columns=%zu chunks=%u skipped_rows=%llu "
+               "bad_cells=%llu\n",
+               static_cast<unsigned long long>(writer.rows()), columns.size(),
+               writer.chunks(),
+               static_cast<unsigned long long>(skippedRows),
+               static_cast<unsigned long long>(badCells));
+  return 0;
+}
+
+int toCsv(const trace_file::TraceReader &trace, const Options &options) {
+  std::FILE *out = stdout;
+  if (!options.output.empty()) {
+    out = std::fopen(options.output.c_str(), "w");
+    if (out == nullptr) {
+      std::fprintf(stderr, "cannot write %s\n", options.output.c_str());
+      return 1;
+    }
+  }
+  for (size_t c = 0; c < trace.columnCount(); ++c) {
+    std::fprintf(out, "%s%s", c == 0 ? "" : ",",
+                 trace_file::columnName(trace.column(c)).c_str());
+  }
+  std::fputc('\n', out);
+  for (size_t chunk = 0; chunk < trace.chunkCount(); ++chunk) {
+    for (uint32_t row = 0; row < trace.chunkRows(chunk); ++row) {
+      for (size_t c = 0; c < trace.columnCount(); ++c) {
+        // A float has about 7 significant digits.
+        const char *format =
+            trace.columnType(c) == trace_file::ColumnType::F32 ? "%s%.7g"
+                                                               : "%s%.15g";
+        std::fprintf(out, format, c == 0 ? "" : ",",
+                     trace.value(chunk, c, row));
+      }
+      std::fputc('\n', out);
+    }
+  }
+  if (out != stdout) {
+    std::fclose(out);
+  }
+  return 0;
+}
+
+int info(const trace_file::TraceReader &trace) {
+  std::printf("rows %llu, %zu chunks, %zu tail bytes\n",
+              static_cast<unsigned long long>(trace.rows()),
+              trace.chunkCount(), trace.tailBytes());
+  for (size_t c = 0; c < trace.columnCount(); ++c) {
+    std::printf("column %-12s %-4s %s\n",
+                trace_file::columnName(trace.column(c)).c_str(),
+                trace_file::typeName(trace.columnType(c)),
+                trace_file::columnUnit(trace.column(c)).c_str());
+  }
+  const std::string meta = trace.meta();
+  size_t line = 0;
+  while (line < meta.size()) {
+    const size_t end = meta.find('\n', line);
+    std::printf("meta   %s\n", meta.substr(line, end - line).c_str());
+    line = end == std::string::npos ? meta.size() : end + 1;
+  }
+  size_t bad = 0;
+  for (size_t chunk = 0; chunk < trace.chunkCount(); ++chunk) {
+    if (!trace.verifyChunk(chunk)) {
+      std::printf("chunk %zu: CRC mismatch\n", chunk);
+      bad++;
+    }
+  }
+  return bad == 0 ? 0 : 3;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseArgs(argc, argv, options)) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (options.action == Action::TO_TRACE) {
+    return toTrace(options);
+  }
+  trace_file::TraceReader trace;
+  if (!trace.open(options.input.c_str())) {
+    std::fprintf(stderr, "%s: %s\n", options.input.c_str(),
+                 trace.error().c_str());
+    return 1;
+  }
+  return options.action == Action::TO_CSV ? toCsv(trace, options)
+                                          : info(trace);
+}